@@ -299,6 +299,7 @@ exit 0
 %{_libdir}/pkgconfig/%{name}.pc
 
 %files swtok
+%config(noreplace) %{_sysconfdir}/%{name}/softtok.conf
 %{_libdir}/opencryptoki/stdll/libpkcs11_sw.*
 %{_libdir}/opencryptoki/stdll/PKCS11_SW.so
 %dir %attr(770,root,pkcs11) %{_sharedstatedir}/%{name}/swtok/
@@ -0,0 +1,289 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/* File: cca_keyinfo_bench.c
+ *
+ * Micro-benchmark of the CCA token's key token analysis cache. It is built
+ * from the CCA token sources and calls cca_get_key_info() directly on key
+ * objects with secure key tokens generated by the CCA host library named by
+ * OCK_CCA_LIBRARY (libcsulcca.so if unset), usually the CCA host library
+ * emulator (testcases/ccaemu).
+ *
+ * For each key type it reports the time per call when the facts are taken
+ * from the object's ex_data (hit), and when they are derived from the key
+ * token(s) again (miss), as happened on every operation before the cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "cca_stdll.h"
+
+#define BENCH_DEFAULT_ITERATIONS    1000000
+
+struct bench_key {
+    const char *name;
+    CK_KEY_TYPE key_type;
+    unsigned char key_type_1[CCA_KEYWORD_SIZE + 1];
+    unsigned char key_length[CCA_KEYWORD_SIZE + 1];
+    unsigned int num_tokens;
+};
+
+static const struct bench_key bench_keys[] = {
+    { "DES3",    CKK_DES3,    "DATA    ", "TRIPLE-O", 1 },
+    { "AES-256", CKK_AES,     "AESDATA ", "KEYLN32 ", 1 },
+    { "AES-XTS", CKK_AES_XTS, "AESDATA ", "KEYLN32 ", 2 },
+};
+
+static double elapsed_ns(const struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e9 +
+           (end.tv_nsec - start->tv_nsec);
+}
+
+static CK_RV bench_gen_tokens(CSNBKGN_t keygen, const struct bench_key *key,
+                              CK_BYTE *tokens)
+{
+    long return_code, reason_code;
+    unsigned char key_form[CCA_KEYWORD_SIZE + 1] = "OP      ";
+    unsigned char key_type_2[CCA_KEYWORD_SIZE] = { 0, };
+    unsigned char key_length[CCA_KEYWORD_SIZE];
+    unsigned char key_type_1[CCA_KEYWORD_SIZE];
+    unsigned char kek_key_identifier_1[CCA_KEY_ID_SIZE] = { 0, };
+    unsigned char kek_key_identifier_2[CCA_KEY_ID_SIZE] = { 0, };
+    unsigned char generated_key_identifier_2[CCA_KEY_ID_SIZE] = { 0, };
+    unsigned int i;
+
+    for (i = 0; i < key->num_tokens; i++) {
+        memcpy(key_length, key->key_length, CCA_KEYWORD_SIZE);
+        memcpy(key_type_1, key->key_type_1, CCA_KEYWORD_SIZE);
+        memset(tokens + i * CCA_KEY_ID_SIZE, 0, CCA_KEY_ID_SIZE);
+
+        keygen(&return_code, &reason_code, NULL, NULL, key_form, key_length,
+               key_type_1, key_type_2, kek_key_identifier_1,
+               kek_key_identifier_2, tokens + i * CCA_KEY_ID_SIZE,
+               generated_key_identifier_2);
+        if (return_code != CCA_SUCCESS) {
+            fprintf(stderr, "CSNBKGN for %s failed: return %ld, reason %ld\n",
+                    key->name, return_code, reason_code);
+            return CKR_FUNCTION_FAILED;
+        }
+    }
+
+    return CKR_OK;
+}
+
+static CK_RV bench_add_attr(TEMPLATE *tmpl, CK_ATTRIBUTE_TYPE type,
+                            void *value, CK_ULONG len)
+{
+    CK_ATTRIBUTE *attr;
+    CK_RV rc;
+
+    rc = build_attribute(type, value, len, &attr);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = template_update_attribute(tmpl, attr);
+    if (rc != CKR_OK)
+        free(attr);
+
+    return rc;
+}
+
+static CK_RV bench_create_obj(const struct bench_key *key, CK_BYTE *tokens,
+                              OBJECT **obj)
+{
+    CK_OBJECT_CLASS class = CKO_SECRET_KEY;
+    CK_KEY_TYPE key_type = key->key_type;
+    CK_BBOOL pkey_extractable = TRUE;
+    OBJECT *o;
+    CK_RV rc;
+
+    o = calloc(1, sizeof(*o));
+    if (o == NULL)
+        return CKR_HOST_MEMORY;
+
+    o->template = calloc(1, sizeof(*o->template));
+    if (o->template == NULL) {
+        free(o);
+        return CKR_HOST_MEMORY;
+    }
+
+    rc = object_init_lock(o);
+    if (rc != CKR_OK) {
+        template_free(o->template);
+        free(o);
+        return rc;
+    }
+
+    rc = object_init_ex_data_lock(o);
+    if (rc != CKR_OK) {
+        object_destroy_lock(o);
+        template_free(o->template);
+        free(o);
+        return rc;
+    }
+
+    rc = bench_add_attr(o->template, CKA_CLASS, &class, sizeof(class));
+    if (rc == CKR_OK)
+        rc = bench_add_attr(o->template, CKA_KEY_TYPE, &key_type,
+                            sizeof(key_type));
+    if (rc == CKR_OK)
+        rc = bench_add_attr(o->template, CKA_IBM_PROTKEY_EXTRACTABLE,
+                            &pkey_extractable, sizeof(pkey_extractable));
+    if (rc == CKR_OK)
+        rc = bench_add_attr(o->template, CKA_IBM_OPAQUE, tokens,
+                            key->num_tokens * CCA_KEY_ID_SIZE);
+    if (rc != CKR_OK) {
+        object_free(o);
+        return rc;
+    }
+
+    *obj = o;
+    return CKR_OK;
+}
+
+static CK_RV bench_key_info(STDLL_TokData_t *tokdata, OBJECT *obj,
+                            unsigned long iterations, CK_BBOOL miss,
+                            double *ns_per_call)
+{
+    struct cca_key_info info;
+    struct timespec start;
+    unsigned long i;
+    CK_RV rc;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < iterations; i++) {
+        if (miss) {
+            rc = object_ex_data_reload(obj);
+            if (rc != CKR_OK)
+                return rc;
+        }
+
+        rc = cca_get_key_info(tokdata, obj, &info);
+        if (rc != CKR_OK)
+            return rc;
+    }
+
+    *ns_per_call = elapsed_ns(&start) / iterations;
+
+    if (info.known == FALSE || info.num_tokens == 0) {
+        fprintf(stderr, "The key token(s) were not recognized\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
+
+static void cca_keyinfo_bench_usage(char *fct)
+{
+    printf("usage:  %s [-iterations <num>] [-h]\n\n", fct);
+    printf("Measures the time per cca_get_key_info() call with the key "
+           "token facts\ncached in the object (hit) and derived again "
+           "(miss). The key tokens are\ngenerated by the CCA host library "
+           "named by OCK_CCA_LIBRARY.\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    STDLL_TokData_t tokdata;
+    unsigned long iterations = BENCH_DEFAULT_ITERATIONS;
+    CK_BYTE tokens[2 * CCA_KEY_ID_SIZE];
+    const char *lib_name;
+    double hit, miss;
+    CSNBKGN_t keygen;
+    OBJECT *obj;
+    void *hdl;
+    size_t k;
+    int i, ret = 0;
+    CK_RV rc;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-iterations") == 0 && i + 1 < argc) {
+            iterations = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-h") == 0) {
+            cca_keyinfo_bench_usage(argv[0]);
+            return 0;
+        } else {
+            printf("unknown option '%s'\n", argv[i]);
+            cca_keyinfo_bench_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (iterations == 0) {
+        cca_keyinfo_bench_usage(argv[0]);
+        return 1;
+    }
+
+    lib_name = getenv("OCK_CCA_LIBRARY");
+    if (lib_name == NULL)
+        lib_name = "libcsulcca.so";
+
+    hdl = dlopen(lib_name, RTLD_NOW);
+    if (hdl == NULL) {
+        fprintf(stderr, "Failed to load %s: %s\n", lib_name, dlerror());
+        return 1;
+    }
+
+    *(void **)(&keygen) = dlsym(hdl, "CSNBKGN");
+    if (keygen == NULL) {
+        fprintf(stderr, "%s has no CSNBKGN: %s\n", lib_name, dlerror());
+        dlclose(hdl);
+        return 1;
+    }
+
+    memset(&tokdata, 0, sizeof(tokdata));
+
+    printf("%-10s %14s %14s %14s\n", "key", "hit [ns]", "miss [ns]",
+           "saved [ns]");
+
+    for (k = 0; k < sizeof(bench_keys) / sizeof(bench_keys[0]); k++) {
+        rc = bench_gen_tokens(keygen, &bench_keys[k], tokens);
+        if (rc == CKR_OK)
+            rc = bench_create_obj(&bench_keys[k], tokens, &obj);
+        if (rc != CKR_OK) {
+            fprintf(stderr, "Failed to create the %s key object: 0x%lx\n",
+                    bench_keys[k].name, rc);
+            ret = 1;
+            break;
+        }
+
+        rc = bench_key_info(&tokdata, obj, iterations, FALSE, &hit);
+        if (rc == CKR_OK)
+            rc = bench_key_info(&tokdata, obj, iterations, TRUE, &miss);
+        object_free(obj);
+        if (rc != CKR_OK) {
+            fprintf(stderr, "cca_get_key_info for %s failed: 0x%lx\n",
+                    bench_keys[k].name, rc);
+            ret = 1;
+            break;
+        }
+
+        printf("%-10s %14.1f %14.1f %14.1f\n", bench_keys[k].name, hit, miss,
+               miss - hit);
+    }
+
+    dlclose(hdl);
+
+    return ret;
+}
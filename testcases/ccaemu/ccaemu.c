@@ -0,0 +1,664 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Software CCA host library emulator: library setup, the adapter request
+ * queue, master keys, key material protection, adapter queries, random
+ * numbers and one-way hashes.
+ *
+ * Key material in key tokens is AES-256-CTR encrypted and protected by an
+ * HMAC-SHA256, both keys derived from the emulated master key of the key
+ * type. The MKVP in the token identifies the master key.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+
+#include "ccaemu.h"
+#include "csulincl.h"
+
+#define CEMU_DEFAULT_QUEUE_DEPTH    8
+#define CEMU_DEFAULT_MK_SEED        "ccaemu"
+#define CEMU_LIB_VERSION            "8.1.0c 2025-01-01"
+#define CEMU_CARD_VERSION           "8.1.00  "
+#define CEMU_HASH_MAGIC             0x43454d48  /* "CEMH" */
+
+struct cemu_config cemu_cfg;
+
+static pthread_once_t cemu_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t cemu_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cemu_queue_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int cemu_inflight;
+
+/* Multi-part state, referenced from the caller's chaining vector */
+struct cemu_chain {
+    uint32_t magic;
+    void *ctx;
+};
+
+static unsigned long cemu_env_ulong(const char *name, unsigned long def)
+{
+    const char *val = getenv(name);
+    char *end;
+    unsigned long num;
+
+    if (val == NULL || *val == '\0')
+        return def;
+
+    errno = 0;
+    num = strtoul(val, &end, 0);
+    if (errno != 0 || *end != '\0') {
+        fprintf(stderr, "ccaemu: ignoring invalid value '%s' of %s\n",
+                val, name);
+        return def;
+    }
+
+    return num;
+}
+
+static void cemu_sha256(const void *label, size_t label_len,
+                        const void *data, size_t data_len, unsigned char *out)
+{
+    EVP_MD_CTX *md = EVP_MD_CTX_new();
+
+    if (md == NULL ||
+        EVP_DigestInit_ex(md, EVP_sha256(), NULL) != 1 ||
+        EVP_DigestUpdate(md, label, label_len) != 1 ||
+        EVP_DigestUpdate(md, data, data_len) != 1 ||
+        EVP_DigestFinal_ex(md, out, NULL) != 1)
+        abort();
+
+    EVP_MD_CTX_free(md);
+}
+
+static void cemu_mk_derive(struct cemu_mk *mk, const char *seed,
+                           const char *type)
+{
+    unsigned char md[32];
+    char label[32];
+
+    snprintf(label, sizeof(label), "ccaemu-mk-%s", type);
+    cemu_sha256(label, strlen(label), seed, strlen(seed), mk->mk);
+    cemu_sha256("", 0, mk->mk, sizeof(mk->mk), md);
+    memcpy(mk->mkvp, md, sizeof(mk->mkvp));
+    cemu_sha256("enc", 3, mk->mk, sizeof(mk->mk), mk->enc_key);
+    cemu_sha256("mac", 3, mk->mk, sizeof(mk->mk), mk->mac_key);
+}
+
+static void cemu_do_init(void)
+{
+    const char *seed;
+
+    cemu_cfg.latency_us = cemu_env_ulong("CCAEMU_LATENCY_US", 0);
+    cemu_cfg.latency_per_kb_us = cemu_env_ulong("CCAEMU_LATENCY_PER_KB_US", 0);
+    cemu_cfg.queue_depth = cemu_env_ulong("CCAEMU_QUEUE_DEPTH",
+                                          CEMU_DEFAULT_QUEUE_DEPTH);
+    if (cemu_cfg.queue_depth == 0)
+        cemu_cfg.queue_depth = 1;
+
+    seed = getenv("CCAEMU_MK_SEED");
+    if (seed == NULL || *seed == '\0')
+        seed = CEMU_DEFAULT_MK_SEED;
+
+    cemu_mk_derive(&cemu_cfg.mks[CEMU_MK_SYM], seed, "sym");
+    cemu_mk_derive(&cemu_cfg.mks[CEMU_MK_AES], seed, "aes");
+    cemu_mk_derive(&cemu_cfg.mks[CEMU_MK_APKA], seed, "apka");
+}
+
+void cemu_init_once(void)
+{
+    pthread_once(&cemu_once, cemu_do_init);
+}
+
+static void cemu_sleep_us(unsigned long us)
+{
+    struct timespec ts;
+
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+void cemu_req_begin(size_t datalen)
+{
+    unsigned long latency;
+
+    cemu_init_once();
+
+    pthread_mutex_lock(&cemu_queue_mutex);
+    while (cemu_inflight >= cemu_cfg.queue_depth)
+        pthread_cond_wait(&cemu_queue_cond, &cemu_queue_mutex);
+    cemu_inflight++;
+    pthread_mutex_unlock(&cemu_queue_mutex);
+
+    latency = cemu_cfg.latency_us +
+              (cemu_cfg.latency_per_kb_us * datalen) / 1024;
+    if (latency > 0)
+        cemu_sleep_us(latency);
+}
+
+void cemu_req_end(void)
+{
+    pthread_mutex_lock(&cemu_queue_mutex);
+    cemu_inflight--;
+    pthread_cond_signal(&cemu_queue_cond);
+    pthread_mutex_unlock(&cemu_queue_mutex);
+}
+
+void cemu_set_rc(long *return_code, long *reason_code, long rc, long rs)
+{
+    *return_code = rc;
+    *reason_code = rs;
+}
+
+static int cemu_keyword_eq(const unsigned char *kw, const char *keyword)
+{
+    size_t len = strlen(keyword);
+    size_t i;
+
+    if (len > CEMU_KEYWORD_SIZE || memcmp(kw, keyword, len) != 0)
+        return 0;
+    for (i = len; i < CEMU_KEYWORD_SIZE; i++) {
+        if (kw[i] != ' ' && kw[i] != '\0')
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Returns 1 if the rule array contains the keyword */
+int cemu_keyword(const unsigned char *rule_array, long count,
+                 const char *keyword)
+{
+    long i;
+
+    if (rule_array == NULL)
+        return 0;
+
+    for (i = 0; i < count; i++) {
+        if (cemu_keyword_eq(rule_array + i * CEMU_KEYWORD_SIZE, keyword))
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Returns 1 if all keywords of the rule array are in the NULL-ended list */
+int cemu_rules_valid(const unsigned char *rule_array, long count,
+                     const char *const *valid)
+{
+    const char *const *v;
+    long i;
+
+    for (i = 0; i < count; i++) {
+        for (v = valid; *v != NULL; v++) {
+            if (cemu_keyword_eq(rule_array + i * CEMU_KEYWORD_SIZE, *v))
+                break;
+        }
+        if (*v == NULL)
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Returns 0 if the MKVP is the one of the current master key */
+int cemu_check_mkvp(enum cemu_mk_type type, const unsigned char *mkvp)
+{
+    cemu_init_once();
+
+    return CRYPTO_memcmp(mkvp, cemu_cfg.mks[type].mkvp,
+                         CEMU_MKVP_BYTES) != 0 ? -1 : 0;
+}
+
+static int cemu_ctr(const struct cemu_mk *mk, const unsigned char *nonce,
+                    const unsigned char *in, size_t len, unsigned char *out)
+{
+    unsigned char iv[16] = { 0 };
+    EVP_CIPHER_CTX *ctx;
+    int outl, ok;
+
+    memcpy(iv, nonce, CEMU_NONCE_BYTES);
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL)
+        return -1;
+
+    ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), NULL, mk->enc_key,
+                            iv) == 1 &&
+         EVP_EncryptUpdate(ctx, out, &outl, in, len) == 1;
+
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? 0 : -1;
+}
+
+static void cemu_tag(const struct cemu_mk *mk, const unsigned char *aad,
+                     size_t aad_len, const unsigned char *nonce,
+                     const unsigned char *enc, size_t len,
+                     unsigned char *tag)
+{
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0),
+        OSSL_PARAM_END
+    };
+    unsigned char mac[32];
+    size_t maclen;
+    EVP_MAC_CTX *ctx;
+    EVP_MAC *hmac;
+
+    hmac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+    ctx = hmac != NULL ? EVP_MAC_CTX_new(hmac) : NULL;
+    if (ctx == NULL ||
+        EVP_MAC_init(ctx, mk->mac_key, sizeof(mk->mac_key), params) != 1 ||
+        EVP_MAC_update(ctx, aad, aad_len) != 1 ||
+        EVP_MAC_update(ctx, nonce, CEMU_NONCE_BYTES) != 1 ||
+        EVP_MAC_update(ctx, enc, len) != 1 ||
+        EVP_MAC_final(ctx, mac, &maclen, sizeof(mac)) != 1)
+        abort();
+
+    EVP_MAC_CTX_free(ctx);
+    EVP_MAC_free(hmac);
+    memcpy(tag, mac, CEMU_TAG_BYTES);
+}
+
+/*
+ * Encrypts key material under the master key of the given type. A fresh
+ * nonce is returned in `nonce`, the tag covers the additional data, the
+ * nonce and the encrypted key material. Tokens with a fixed size keep only
+ * the first tag_len bytes of the tag.
+ */
+int cemu_seal(enum cemu_mk_type type, const unsigned char *aad,
+              size_t aad_len, const unsigned char *in, size_t len,
+              unsigned char *nonce, unsigned char *out,
+              unsigned char *tag, size_t tag_len)
+{
+    unsigned char mac[CEMU_TAG_BYTES];
+    const struct cemu_mk *mk;
+
+    cemu_init_once();
+    mk = &cemu_cfg.mks[type];
+
+    if (RAND_bytes(nonce, CEMU_NONCE_BYTES) != 1)
+        return -1;
+    if (cemu_ctr(mk, nonce, in, len, out) != 0)
+        return -1;
+
+    cemu_tag(mk, aad, aad_len, nonce, out, len, mac);
+    memcpy(tag, mac, tag_len);
+    return 0;
+}
+
+int cemu_unseal(enum cemu_mk_type type, const unsigned char *aad,
+                size_t aad_len, const unsigned char *nonce,
+                const unsigned char *in, size_t len,
+                const unsigned char *tag, size_t tag_len, unsigned char *out)
+{
+    unsigned char exp[CEMU_TAG_BYTES];
+    const struct cemu_mk *mk;
+
+    cemu_init_once();
+    mk = &cemu_cfg.mks[type];
+
+    cemu_tag(mk, aad, aad_len, nonce, in, len, exp);
+    if (tag_len > CEMU_TAG_BYTES || CRYPTO_memcmp(exp, tag, tag_len) != 0)
+        return -1;
+
+    return cemu_ctr(mk, nonce, in, len, out);
+}
+
+const EVP_MD *cemu_hash_md(const unsigned char *keyword)
+{
+    if (cemu_keyword_eq(keyword, "SHA-1"))
+        return EVP_sha1();
+    if (cemu_keyword_eq(keyword, "SHA-224"))
+        return EVP_sha224();
+    if (cemu_keyword_eq(keyword, "SHA-256"))
+        return EVP_sha256();
+    if (cemu_keyword_eq(keyword, "SHA-384"))
+        return EVP_sha384();
+    if (cemu_keyword_eq(keyword, "SHA-512"))
+        return EVP_sha512();
+    if (cemu_keyword_eq(keyword, "SHA3-224"))
+        return EVP_sha3_224();
+    if (cemu_keyword_eq(keyword, "SHA3-256"))
+        return EVP_sha3_256();
+    if (cemu_keyword_eq(keyword, "SHA3-384"))
+        return EVP_sha3_384();
+    if (cemu_keyword_eq(keyword, "SHA3-512"))
+        return EVP_sha3_512();
+
+    return NULL;
+}
+
+/*
+ * Multi-part operations keep their OpenSSL context in the emulator, the
+ * chaining vector of the caller only references it.
+ */
+void *cemu_chain_get(const unsigned char *chaining_vector,
+                     long chaining_vector_length, uint32_t magic)
+{
+    struct cemu_chain chain;
+
+    if (chaining_vector == NULL ||
+        chaining_vector_length < (long)sizeof(chain))
+        return NULL;
+
+    memcpy(&chain, chaining_vector, sizeof(chain));
+    return chain.magic == magic ? chain.ctx : NULL;
+}
+
+int cemu_chain_set(unsigned char *chaining_vector,
+                   long chaining_vector_length, uint32_t magic, void *ctx)
+{
+    struct cemu_chain chain = { .magic = magic, .ctx = ctx };
+
+    if (chaining_vector == NULL ||
+        chaining_vector_length < (long)sizeof(chain))
+        return -1;
+
+    memset(chaining_vector, 0, chaining_vector_length);
+    if (ctx != NULL)
+        memcpy(chaining_vector, &chain, sizeof(chain));
+    return 0;
+}
+
+/*
+ * Facility queries and adapter allocation
+ */
+
+void CSUACFV(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *version_data_length, unsigned char *version_data)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+
+    if (*version_data_length < (long)sizeof(CEMU_LIB_VERSION)) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    memcpy(version_data, CEMU_LIB_VERSION, sizeof(CEMU_LIB_VERSION));
+    *version_data_length = sizeof(CEMU_LIB_VERSION);
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+}
+
+static void cemu_put_state(unsigned char *field, char state)
+{
+    memset(field, ' ', CEMU_KEYWORD_SIZE);
+    field[0] = state;
+}
+
+static void cemu_put_mkvp(unsigned char *verb_data, unsigned int id_offset,
+                          uint16_t id, enum cemu_mk_type type)
+{
+    cemu_put_be16(verb_data + id_offset, id);
+    memcpy(verb_data + id_offset + 2, cemu_cfg.mks[type].mkvp,
+           CEMU_MKVP_BYTES);
+}
+
+/*
+ * Only the queries used by the CCA token are supported. All master keys
+ * are loaded, no new master keys are pending. The ICSB layout reports
+ * the current master key also as new master key.
+ */
+static void cemu_query(long *return_code, long *reason_code,
+                       long *rule_array_count, unsigned char *rule_array,
+                       long *verb_data_length, unsigned char *verb_data)
+{
+    if (*rule_array_count != 1) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (cemu_keyword(rule_array, 1, "STATCRD2")) {
+        memset(rule_array, ' ', 15 * CEMU_KEYWORD_SIZE);
+        rule_array[0] = '1';
+        memcpy(rule_array + 112, CEMU_SERIALNO, CEMU_KEYWORD_SIZE);
+        *rule_array_count = 15;
+    } else if (cemu_keyword(rule_array, 1, "STATCCA")) {
+        memset(rule_array, ' ', 8 * CEMU_KEYWORD_SIZE);
+        memcpy(rule_array + 24, CEMU_CARD_VERSION, CEMU_KEYWORD_SIZE);
+        *rule_array_count = 8;
+    } else if (cemu_keyword(rule_array, 1, "STATCCAE") ||
+               cemu_keyword(rule_array, 1, "STATAES") ||
+               cemu_keyword(rule_array, 1, "STATAPKA")) {
+        /* NMK state at offset 0: empty, CMK state at offset 8: full */
+        cemu_put_state(rule_array, '1');
+        cemu_put_state(rule_array + CEMU_KEYWORD_SIZE, '2');
+        *rule_array_count = 2;
+    } else if (cemu_keyword(rule_array, 1, "STATICSB")) {
+        if (verb_data == NULL || *verb_data_length < 256) {
+            cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                        CEMU_RS_LENGTH_INVALID);
+            return;
+        }
+        memset(verb_data, 0, 256);
+        cemu_put_mkvp(verb_data, 134, 0x0f07, CEMU_MK_SYM);
+        cemu_put_mkvp(verb_data, 146, 0x0f06, CEMU_MK_SYM);
+        cemu_put_mkvp(verb_data, 182, 0x0f0b, CEMU_MK_AES);
+        cemu_put_mkvp(verb_data, 194, 0x0f0a, CEMU_MK_AES);
+        cemu_put_mkvp(verb_data, 218, 0x0f0e, CEMU_MK_APKA);
+        cemu_put_mkvp(verb_data, 230, 0x0f0d, CEMU_MK_APKA);
+        *verb_data_length = 256;
+    } else {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+}
+
+void CSUACFQ(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *verb_data_length, unsigned char *verb_data)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+
+    CEMU_REQUEST(0, cemu_query(return_code, reason_code, rule_array_count,
+                               rule_array, verb_data_length, verb_data));
+}
+
+/* There is only the default adapter, any allocation succeeds */
+void CSUACRA(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *resource_name_length, unsigned char *resource_name)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)rule_array_count;
+    (void)rule_array;
+    (void)resource_name_length;
+    (void)resource_name;
+
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+}
+
+void CSUACRD(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *resource_name_length, unsigned char *resource_name)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)rule_array_count;
+    (void)rule_array;
+    (void)resource_name_length;
+    (void)resource_name;
+
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+}
+
+/*
+ * Random numbers
+ */
+
+static void cemu_random(long *return_code, long *reason_code,
+                        long *rule_array_count, unsigned char *rule_array,
+                        long *random_number_length,
+                        unsigned char *random_number)
+{
+    static const char *const rules[] = { "RANDOM", "ODD", "EVEN", NULL };
+
+    if (!cemu_rules_valid(rule_array, *rule_array_count, rules)) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (*random_number_length < 0 || *random_number_length > 8192) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    if (RAND_bytes(random_number, *random_number_length) != 1) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_CRYPTO_FAILED);
+        return;
+    }
+
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+}
+
+void CSNBRNGL(long *return_code, long *reason_code,
+              long *exit_data_length, unsigned char *exit_data,
+              long *rule_array_count, unsigned char *rule_array,
+              long *reserved_length, unsigned char *reserved,
+              long *random_number_length, unsigned char *random_number)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)reserved_length;
+    (void)reserved;
+
+    CEMU_REQUEST(*random_number_length,
+                 cemu_random(return_code, reason_code, rule_array_count,
+                             rule_array, random_number_length,
+                             random_number));
+}
+
+/*
+ * One-way hash
+ */
+
+static void cemu_hash(long *return_code, long *reason_code,
+                      long *rule_array_count, unsigned char *rule_array,
+                      long *text_length, unsigned char *text,
+                      long *chaining_vector_length,
+                      unsigned char *chaining_vector,
+                      long *hash_length, unsigned char *hash)
+{
+    const EVP_MD *md = NULL;
+    EVP_MD_CTX *ctx = NULL;
+    int first, last;
+    long i;
+
+    for (i = 0; i < *rule_array_count && md == NULL; i++)
+        md = cemu_hash_md(rule_array + i * CEMU_KEYWORD_SIZE);
+    if (md == NULL) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    first = cemu_keyword(rule_array, *rule_array_count, "ONLY") ||
+            cemu_keyword(rule_array, *rule_array_count, "FIRST");
+    last = cemu_keyword(rule_array, *rule_array_count, "ONLY") ||
+           cemu_keyword(rule_array, *rule_array_count, "LAST");
+    if (!first && !last &&
+        !cemu_keyword(rule_array, *rule_array_count, "MIDDLE")) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (last && *hash_length < EVP_MD_get_size(md)) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    if (first) {
+        ctx = EVP_MD_CTX_new();
+        if (ctx == NULL || EVP_DigestInit_ex(ctx, md, NULL) != 1)
+            goto error;
+    } else {
+        ctx = cemu_chain_get(chaining_vector, *chaining_vector_length,
+                             CEMU_HASH_MAGIC);
+        if (ctx == NULL) {
+            cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                        CEMU_RS_RULE_INVALID);
+            return;
+        }
+    }
+
+    if (*text_length > 0 && EVP_DigestUpdate(ctx, text, *text_length) != 1)
+        goto error;
+
+    if (last) {
+        if (EVP_DigestFinal_ex(ctx, hash, NULL) != 1)
+            goto error;
+        *hash_length = EVP_MD_get_size(md);
+        EVP_MD_CTX_free(ctx);
+        if (chaining_vector != NULL)
+            cemu_chain_set(chaining_vector, *chaining_vector_length,
+                           CEMU_HASH_MAGIC, NULL);
+    } else if (cemu_chain_set(chaining_vector, *chaining_vector_length,
+                              CEMU_HASH_MAGIC, ctx) != 0) {
+        EVP_MD_CTX_free(ctx);
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+    return;
+
+error:
+    EVP_MD_CTX_free(ctx);
+    if (chaining_vector != NULL)
+        cemu_chain_set(chaining_vector, *chaining_vector_length,
+                       CEMU_HASH_MAGIC, NULL);
+    cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                CEMU_RS_CRYPTO_FAILED);
+}
+
+void CSNBOWH(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *text_length, unsigned char *text,
+             long *chaining_vector_length, unsigned char *chaining_vector,
+             long *hash_length, unsigned char *hash)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+
+    CEMU_REQUEST(*text_length,
+                 cemu_hash(return_code, reason_code, rule_array_count,
+                           rule_array, text_length, text,
+                           chaining_vector_length, chaining_vector,
+                           hash_length, hash));
+}
@@ -0,0 +1,123 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Internal definitions of the software CCA host library emulator.
+ *
+ * The emulator implements the CCA verbs that the CCA token resolves from
+ * libcsulcca.so, backed by OpenSSL instead of a crypto express adapter.
+ * See testcases/ccaemu/README for usage.
+ */
+
+#ifndef CCAEMU_H
+#define CCAEMU_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include <openssl/evp.h>
+
+#define CEMU_KEYWORD_SIZE       8
+#define CEMU_MKVP_BYTES         8
+#define CEMU_MK_BYTES           32
+#define CEMU_NONCE_BYTES        8
+#define CEMU_TAG_BYTES          16
+#define CEMU_SERIALNO           "EMU00001"
+
+/*
+ * CCA return and reason codes. Where the CCA token evaluates a reason code
+ * the value of the CCA manual is used, the others are emulator specific.
+ */
+#define CEMU_RC_OK                  0
+#define CEMU_RC_WARNING             4
+#define CEMU_RC_ERROR               8
+#define CEMU_RS_OK                  0
+#define CEMU_RS_RULE_INVALID        33
+#define CEMU_RS_MKVP_MISMATCH       48
+#define CEMU_RS_KEY_TOKEN_INVALID   64
+#define CEMU_RS_DECRYPT_FAILED      66
+#define CEMU_RS_LENGTH_INVALID      72
+#define CEMU_RS_VERIFY_FAILED       429
+#define CEMU_RS_CURVE_NOT_SUPPORTED 874
+#define CEMU_RS_NOT_SUPPORTED       2150
+#define CEMU_RS_CRYPTO_FAILED       2151
+
+enum cemu_mk_type {
+    CEMU_MK_SYM,
+    CEMU_MK_AES,
+    CEMU_MK_APKA,
+    CEMU_NUM_MK,
+};
+
+/* An emulated master key with the keys derived from it */
+struct cemu_mk {
+    unsigned char mk[CEMU_MK_BYTES];
+    unsigned char mkvp[CEMU_MKVP_BYTES];
+    unsigned char enc_key[32];              /* key material encryption */
+    unsigned char mac_key[32];              /* key token MAC */
+};
+
+struct cemu_config {
+    unsigned long latency_us;
+    unsigned long latency_per_kb_us;
+    unsigned int queue_depth;
+    struct cemu_mk mks[CEMU_NUM_MK];
+};
+
+extern struct cemu_config cemu_cfg;
+
+/* ccaemu.c */
+void cemu_init_once(void);
+void cemu_req_begin(size_t datalen);
+void cemu_req_end(void);
+void cemu_set_rc(long *return_code, long *reason_code, long rc, long rs);
+int cemu_keyword(const unsigned char *rule_array, long count,
+                 const char *keyword);
+int cemu_rules_valid(const unsigned char *rule_array, long count,
+                     const char *const *valid);
+int cemu_check_mkvp(enum cemu_mk_type type, const unsigned char *mkvp);
+int cemu_seal(enum cemu_mk_type type, const unsigned char *aad,
+              size_t aad_len, const unsigned char *in, size_t len,
+              unsigned char *nonce, unsigned char *out,
+              unsigned char *tag, size_t tag_len);
+int cemu_unseal(enum cemu_mk_type type, const unsigned char *aad,
+                size_t aad_len, const unsigned char *nonce,
+                const unsigned char *in, size_t len,
+                const unsigned char *tag, size_t tag_len, unsigned char *out);
+const EVP_MD *cemu_hash_md(const unsigned char *keyword);
+void *cemu_chain_get(const unsigned char *chaining_vector,
+                     long chaining_vector_length, uint32_t magic);
+int cemu_chain_set(unsigned char *chaining_vector,
+                   long chaining_vector_length, uint32_t magic, void *ctx);
+
+/*
+ * Runs one emulated adapter request: waits for a free slot in the adapter
+ * queue, simulates the device latency and performs the call.
+ */
+#define CEMU_REQUEST(datalen, call)                                     \
+    do {                                                                \
+        cemu_req_begin(datalen);                                        \
+        call;                                                           \
+        cemu_req_end();                                                 \
+    } while (0)
+
+static inline uint16_t cemu_get_be16(const unsigned char *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline void cemu_put_be16(unsigned char *p, uint16_t val)
+{
+    p[0] = val >> 8;
+    p[1] = val & 0xff;
+}
+
+#endif
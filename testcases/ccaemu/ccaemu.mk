@@ -0,0 +1,29 @@
+# Software CCA host library emulator. It is not installed, point the CCA
+# token to it via OCK_CCA_LIBRARY (see testcases/ccaemu/README).
+noinst_LTLIBRARIES += testcases/ccaemu/libccaemu.la
+
+noinst_HEADERS += testcases/ccaemu/ccaemu.h
+EXTRA_DIST += testcases/ccaemu/README
+
+testcases_ccaemu_libccaemu_la_CFLAGS = ${testcases_inc}			\
+	-I${srcdir}/usr/lib/cca_stdll -fPIC
+testcases_ccaemu_libccaemu_la_LIBADD = -lcrypto -lpthread
+testcases_ccaemu_libccaemu_la_LDFLAGS = -module -shared -avoid-version	\
+	-rpath $(abs_builddir)/testcases/ccaemu
+testcases_ccaemu_libccaemu_la_SOURCES =					\
+	testcases/ccaemu/ccaemu.c testcases/ccaemu/ccaemu_sym.c		\
+	testcases/ccaemu/ccaemu_pka.c testcases/ccaemu/ccaemu_unsupported.c
+
+if ENABLE_CCATOK
+# Micro-benchmark of the CCA token's key token analysis cache. It is built
+# from the CCA token sources to call cca_get_key_info() directly.
+noinst_PROGRAMS += testcases/ccaemu/cca_keyinfo_bench
+
+testcases_ccaemu_cca_keyinfo_bench_CFLAGS =				\
+	${opencryptoki_stdll_libpkcs11_cca_la_CFLAGS}
+testcases_ccaemu_cca_keyinfo_bench_LDADD = -lcrypto -lpthread -lrt -ldl	\
+	-llber
+testcases_ccaemu_cca_keyinfo_bench_SOURCES =				\
+	testcases/ccaemu/cca_keyinfo_bench.c				\
+	${opencryptoki_stdll_libpkcs11_cca_la_SOURCES}
+endif
@@ -0,0 +1,1426 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Software CCA host library emulator: RSA and EC keys, digital signatures
+ * and RSA encryption.
+ *
+ * Private key tokens carry the sections and fields the CCA token reads
+ * (modulus, public exponent, EC point, curve, key size and MKVP) at their
+ * CCA offsets, the private key itself is kept as encrypted DER. Public key
+ * tokens follow the CCA external public key token layout. Skeleton tokens
+ * returned by CSNDPKB are emulator specific, they only carry the key values
+ * structure for CSNDPKG and CSNDPKI.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#include <openssl/param_build.h>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/rsa.h>
+
+#include "ccaemu.h"
+#include "csulincl.h"
+
+#define CEMU_PKA_MAX_TOKEN          8000
+#define CEMU_PKA_HDR                8
+
+#define CEMU_TOK_INTERNAL           0x1f
+#define CEMU_TOK_EXTERNAL           0x1e
+#define CEMU_SEC_RSA_CRT            0x31
+#define CEMU_SEC_RSA_PUBL           0x04
+#define CEMU_SEC_EC_PRIV            0x20
+#define CEMU_SEC_EC_PUBL            0x21
+#define CEMU_SEC_SKELETON           0xce
+
+/* RSA private key section (CRT) */
+#define CEMU_RSA_N_LEN              62
+#define CEMU_RSA_ENC_LEN            64
+#define CEMU_RSA_NONCE              66
+#define CEMU_RSA_TAG                74
+#define CEMU_RSA_MKVP               116
+#define CEMU_RSA_N                  134
+
+/* EC private key section */
+#define CEMU_EC_CURVE_TYPE          9
+#define CEMU_EC_BITS                12
+#define CEMU_EC_MKVP                16
+#define CEMU_EC_ENC_LEN             24
+#define CEMU_EC_NONCE               26
+#define CEMU_EC_TAG                 34
+#define CEMU_EC_ENC                 50
+
+/* EC public key section */
+#define CEMU_ECPUB_CURVE_TYPE       8
+#define CEMU_ECPUB_BITS             10
+#define CEMU_ECPUB_Q_LEN            12
+#define CEMU_ECPUB_Q                14
+
+enum cemu_skeleton_kind {
+    CEMU_SKEL_RSA_CRT = 1,
+    CEMU_SKEL_RSA_ME,
+    CEMU_SKEL_EC_PAIR,
+};
+
+struct cemu_curve {
+    uint8_t type;
+    uint16_t bits;
+    const char *name;
+};
+
+static const struct cemu_curve cemu_curves[] = {
+    { 0x00, 192, "prime192v1" },
+    { 0x00, 224, "secp224r1" },
+    { 0x00, 256, "prime256v1" },
+    { 0x00, 384, "secp384r1" },
+    { 0x00, 521, "secp521r1" },
+    { 0x01, 160, "brainpoolP160r1" },
+    { 0x01, 192, "brainpoolP192r1" },
+    { 0x01, 224, "brainpoolP224r1" },
+    { 0x01, 256, "brainpoolP256r1" },
+    { 0x01, 320, "brainpoolP320r1" },
+    { 0x01, 384, "brainpoolP384r1" },
+    { 0x01, 512, "brainpoolP512r1" },
+    { 0x03, 256, "secp256k1" },
+};
+
+static const char *cemu_curve_name(uint8_t type, uint16_t bits)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(cemu_curves) / sizeof(cemu_curves[0]); i++) {
+        if (cemu_curves[i].type == type && cemu_curves[i].bits == bits)
+            return cemu_curves[i].name;
+    }
+
+    return NULL;
+}
+
+static const struct cemu_curve *cemu_curve_of(const EVP_PKEY *pkey)
+{
+    char name[64];
+    size_t i;
+
+    if (!EVP_PKEY_get_utf8_string_param(pkey, OSSL_PKEY_PARAM_GROUP_NAME,
+                                        name, sizeof(name), NULL))
+        return NULL;
+
+    for (i = 0; i < sizeof(cemu_curves) / sizeof(cemu_curves[0]); i++) {
+        if (strcmp(cemu_curves[i].name, name) == 0)
+            return &cemu_curves[i];
+    }
+
+    return NULL;
+}
+
+static size_t cemu_bn_bin(const EVP_PKEY *pkey, const char *param,
+                          unsigned char *out, size_t max)
+{
+    BIGNUM *bn = NULL;
+    size_t len = 0;
+
+    if (EVP_PKEY_get_bn_param(pkey, param, &bn) && bn != NULL &&
+        (size_t)BN_num_bytes(bn) <= max)
+        len = BN_bn2bin(bn, out);
+
+    BN_free(bn);
+    return len;
+}
+
+static EVP_PKEY *cemu_pkey_fromdata(const char *type, int selection,
+                                    OSSL_PARAM_BLD *bld)
+{
+    EVP_PKEY_CTX *ctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    OSSL_PARAM *params;
+
+    params = OSSL_PARAM_BLD_to_param(bld);
+    if (params == NULL)
+        return NULL;
+
+    ctx = EVP_PKEY_CTX_new_from_name(NULL, type, NULL);
+    if (ctx == NULL || EVP_PKEY_fromdata_init(ctx) != 1 ||
+        EVP_PKEY_fromdata(ctx, &pkey, selection, params) != 1)
+        pkey = NULL;
+
+    EVP_PKEY_CTX_free(ctx);
+    OSSL_PARAM_free(params);
+    return pkey;
+}
+
+/*
+ * Key token construction. The builders return the token length, -1 if the
+ * key could not be processed and -2 if the token does not fit.
+ */
+
+static long cemu_seal_der(EVP_PKEY *pkey,
+                          const unsigned char *aad, size_t aad_len,
+                          unsigned char *enc, unsigned char *nonce,
+                          unsigned char *tag, size_t derlen)
+{
+    unsigned char *der = NULL, *p;
+    int rc;
+
+    der = OPENSSL_malloc(derlen);
+    if (der == NULL)
+        return -1;
+    p = der;
+    if ((size_t)i2d_PrivateKey(pkey, &p) != derlen) {
+        OPENSSL_clear_free(der, derlen);
+        return -1;
+    }
+
+    rc = cemu_seal(CEMU_MK_APKA, aad, aad_len, der, derlen, nonce, enc,
+                   tag, CEMU_TAG_BYTES);
+    OPENSSL_clear_free(der, derlen);
+    return rc;
+}
+
+static long cemu_rsa_priv_build(EVP_PKEY *pkey, unsigned char *t,
+                                long max_len)
+{
+    unsigned char n[512], e[8], *sec = t + CEMU_PKA_HDR, *pub;
+    size_t nlen, elen, seclen, len;
+    int derlen;
+
+    nlen = cemu_bn_bin(pkey, OSSL_PKEY_PARAM_RSA_N, n, sizeof(n));
+    elen = cemu_bn_bin(pkey, OSSL_PKEY_PARAM_RSA_E, e, sizeof(e));
+    derlen = i2d_PrivateKey(pkey, NULL);
+    if (nlen == 0 || elen == 0 || derlen <= 0)
+        return -1;
+
+    seclen = CEMU_RSA_N + nlen + derlen;
+    len = CEMU_PKA_HDR + seclen + 12 + elen;
+    if ((long)len > max_len || len > CEMU_PKA_MAX_TOKEN)
+        return -2;
+
+    memset(t, 0, CEMU_PKA_HDR + CEMU_RSA_N);
+    t[0] = CEMU_TOK_INTERNAL;
+    cemu_put_be16(t + 2, len);
+
+    sec[0] = CEMU_SEC_RSA_CRT;
+    cemu_put_be16(sec + 2, seclen);
+    cemu_put_be16(sec + CEMU_RSA_N_LEN, nlen);
+    cemu_put_be16(sec + CEMU_RSA_ENC_LEN, derlen);
+    memcpy(sec + CEMU_RSA_MKVP, cemu_cfg.mks[CEMU_MK_APKA].mkvp,
+           CEMU_MKVP_BYTES);
+    memcpy(sec + CEMU_RSA_N, n, nlen);
+
+    /* The tag covers the MKVP and the modulus */
+    if (cemu_seal_der(pkey, sec + CEMU_RSA_MKVP,
+                      CEMU_RSA_N - CEMU_RSA_MKVP + nlen,
+                      sec + CEMU_RSA_N + nlen, sec + CEMU_RSA_NONCE,
+                      sec + CEMU_RSA_TAG, derlen) != 0)
+        return -1;
+
+    pub = sec + seclen;
+    memset(pub, 0, 12);
+    pub[0] = CEMU_SEC_RSA_PUBL;
+    cemu_put_be16(pub + 2, 12 + elen);
+    cemu_put_be16(pub + 6, elen);
+    cemu_put_be16(pub + 8, EVP_PKEY_get_bits(pkey));
+    memcpy(pub + 12, e, elen);
+
+    return len;
+}
+
+static long cemu_rsa_publ_build(const unsigned char *n, size_t nlen,
+                                const unsigned char *e, size_t elen,
+                                uint16_t bits, unsigned char *t, long max_len)
+{
+    unsigned char *pub = t + CEMU_PKA_HDR;
+    size_t len = CEMU_PKA_HDR + 12 + elen + nlen;
+
+    if ((long)len > max_len || len > CEMU_PKA_MAX_TOKEN)
+        return -2;
+
+    memset(t, 0, CEMU_PKA_HDR + 12);
+    t[0] = CEMU_TOK_EXTERNAL;
+    cemu_put_be16(t + 2, len);
+    pub[0] = CEMU_SEC_RSA_PUBL;
+    cemu_put_be16(pub + 2, 12 + elen + nlen);
+    cemu_put_be16(pub + 6, elen);
+    cemu_put_be16(pub + 8, bits);
+    cemu_put_be16(pub + 10, nlen);
+    memcpy(pub + 12, e, elen);
+    memcpy(pub + 12 + elen, n, nlen);
+
+    return len;
+}
+
+static void cemu_ec_publ_section(unsigned char *pub, uint8_t type,
+                                 uint16_t bits, const unsigned char *q,
+                                 size_t qlen)
+{
+    memset(pub, 0, CEMU_ECPUB_Q);
+    pub[0] = CEMU_SEC_EC_PUBL;
+    cemu_put_be16(pub + 2, CEMU_ECPUB_Q + qlen);
+    pub[CEMU_ECPUB_CURVE_TYPE] = type;
+    cemu_put_be16(pub + CEMU_ECPUB_BITS, bits);
+    cemu_put_be16(pub + CEMU_ECPUB_Q_LEN, qlen);
+    memcpy(pub + CEMU_ECPUB_Q, q, qlen);
+}
+
+static long cemu_ec_priv_build(EVP_PKEY *pkey, unsigned char *t,
+                               long max_len)
+{
+    const struct cemu_curve *curve = cemu_curve_of(pkey);
+    unsigned char q[256], *sec = t + CEMU_PKA_HDR;
+    size_t qlen, seclen, len;
+    int derlen;
+
+    derlen = i2d_PrivateKey(pkey, NULL);
+    if (curve == NULL || derlen <= 0 ||
+        !EVP_PKEY_get_octet_string_param(pkey, OSSL_PKEY_PARAM_PUB_KEY,
+                                         q, sizeof(q), &qlen))
+        return -1;
+
+    seclen = CEMU_EC_ENC + derlen;
+    len = CEMU_PKA_HDR + seclen + CEMU_ECPUB_Q + qlen;
+    if ((long)len > max_len || len > CEMU_PKA_MAX_TOKEN)
+        return -2;
+
+    memset(t, 0, CEMU_PKA_HDR + CEMU_EC_ENC);
+    t[0] = CEMU_TOK_INTERNAL;
+    cemu_put_be16(t + 2, len);
+
+    sec[0] = CEMU_SEC_EC_PRIV;
+    cemu_put_be16(sec + 2, seclen);
+    sec[4] = 0x01;                          /* wrapping method */
+    sec[CEMU_EC_CURVE_TYPE] = curve->type;
+    sec[10] = 0x08;                         /* key format */
+    cemu_put_be16(sec + CEMU_EC_BITS, curve->bits);
+    memcpy(sec + CEMU_EC_MKVP, cemu_cfg.mks[CEMU_MK_APKA].mkvp,
+           CEMU_MKVP_BYTES);
+    cemu_put_be16(sec + CEMU_EC_ENC_LEN, derlen);
+
+    /* The tag covers the section up to the encrypted key length */
+    if (cemu_seal_der(pkey, sec, CEMU_EC_NONCE, sec + CEMU_EC_ENC,
+                      sec + CEMU_EC_NONCE, sec + CEMU_EC_TAG, derlen) != 0)
+        return -1;
+
+    cemu_ec_publ_section(sec + seclen, curve->type, curve->bits, q, qlen);
+    return len;
+}
+
+static long cemu_ec_publ_build(uint8_t type, uint16_t bits,
+                               const unsigned char *q, size_t qlen,
+                               unsigned char *t, long max_len)
+{
+    size_t len = CEMU_PKA_HDR + CEMU_ECPUB_Q + qlen;
+
+    if ((long)len > max_len || len > CEMU_PKA_MAX_TOKEN)
+        return -2;
+
+    memset(t, 0, CEMU_PKA_HDR);
+    t[0] = CEMU_TOK_EXTERNAL;
+    cemu_put_be16(t + 2, len);
+    cemu_ec_publ_section(t + CEMU_PKA_HDR, type, bits, q, qlen);
+
+    return len;
+}
+
+static void cemu_build_rc(long ret, long *return_code, long *reason_code)
+{
+    if (ret == -2)
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+    else if (ret < 0)
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_CRYPTO_FAILED);
+    else
+        cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+}
+
+/*
+ * Key token parsing
+ */
+
+static EVP_PKEY *cemu_unseal_der(const unsigned char *aad, size_t aad_len,
+                                 const unsigned char *nonce,
+                                 const unsigned char *enc, size_t len,
+                                 const unsigned char *tag)
+{
+    const unsigned char *p;
+    unsigned char *der;
+    EVP_PKEY *pkey = NULL;
+
+    der = OPENSSL_malloc(len);
+    if (der == NULL)
+        return NULL;
+
+    if (cemu_unseal(CEMU_MK_APKA, aad, aad_len, nonce, enc, len, tag,
+                    CEMU_TAG_BYTES, der) == 0) {
+        p = der;
+        pkey = d2i_AutoPrivateKey(NULL, &p, len);
+    }
+
+    OPENSSL_clear_free(der, len);
+    return pkey;
+}
+
+static EVP_PKEY *cemu_rsa_publ_key(const unsigned char *n, size_t nlen,
+                                   const unsigned char *e, size_t elen)
+{
+    BIGNUM *bn_n = BN_bin2bn(n, nlen, NULL), *bn_e = BN_bin2bn(e, elen, NULL);
+    OSSL_PARAM_BLD *bld = OSSL_PARAM_BLD_new();
+    EVP_PKEY *pkey = NULL;
+
+    if (bn_n != NULL && bn_e != NULL && bld != NULL &&
+        OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_RSA_N, bn_n) &&
+        OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_RSA_E, bn_e))
+        pkey = cemu_pkey_fromdata("RSA", EVP_PKEY_PUBLIC_KEY, bld);
+
+    OSSL_PARAM_BLD_free(bld);
+    BN_free(bn_n);
+    BN_free(bn_e);
+    return pkey;
+}
+
+static EVP_PKEY *cemu_ec_publ_key(const unsigned char *pub)
+{
+    const char *name = cemu_curve_name(pub[CEMU_ECPUB_CURVE_TYPE],
+                                       cemu_get_be16(pub + CEMU_ECPUB_BITS));
+    OSSL_PARAM_BLD *bld;
+    EVP_PKEY *pkey = NULL;
+
+    if (name == NULL)
+        return NULL;
+
+    bld = OSSL_PARAM_BLD_new();
+    if (bld != NULL &&
+        OSSL_PARAM_BLD_push_utf8_string(bld, OSSL_PKEY_PARAM_GROUP_NAME,
+                                        name, 0) &&
+        OSSL_PARAM_BLD_push_octet_string(bld, OSSL_PKEY_PARAM_PUB_KEY,
+                                         pub + CEMU_ECPUB_Q,
+                                         cemu_get_be16(pub +
+                                                       CEMU_ECPUB_Q_LEN)))
+        pkey = cemu_pkey_fromdata("EC", EVP_PKEY_PUBLIC_KEY, bld);
+
+    OSSL_PARAM_BLD_free(bld);
+    return pkey;
+}
+
+/*
+ * Returns the key of a private or public key token. Private key tokens
+ * are only accepted if the current APKA master key wraps them, public keys
+ * only if want_private is not set.
+ */
+static EVP_PKEY *cemu_pka_key(const unsigned char *t, long len,
+                              int want_private,
+                              long *return_code, long *reason_code)
+{
+    const unsigned char *sec = t + CEMU_PKA_HDR, *pub;
+    size_t tlen, seclen, nlen;
+    EVP_PKEY *pkey = NULL;
+
+    if (t == NULL || len < CEMU_PKA_HDR + 16)
+        goto invalid;
+    tlen = cemu_get_be16(t + 2);
+    if ((long)tlen > len || tlen < CEMU_PKA_HDR + 16)
+        goto invalid;
+    seclen = cemu_get_be16(sec + 2);
+
+    if (t[0] == CEMU_TOK_INTERNAL && sec[0] == CEMU_SEC_RSA_CRT) {
+        nlen = cemu_get_be16(sec + CEMU_RSA_N_LEN);
+        if (CEMU_PKA_HDR + seclen >= tlen ||
+            CEMU_RSA_N + nlen + cemu_get_be16(sec + CEMU_RSA_ENC_LEN) >
+                                                                    seclen)
+            goto invalid;
+        if (cemu_check_mkvp(CEMU_MK_APKA, sec + CEMU_RSA_MKVP) != 0)
+            goto mkvp_mismatch;
+        pkey = cemu_unseal_der(sec + CEMU_RSA_MKVP,
+                               CEMU_RSA_N - CEMU_RSA_MKVP + nlen,
+                               sec + CEMU_RSA_NONCE, sec + CEMU_RSA_N + nlen,
+                               cemu_get_be16(sec + CEMU_RSA_ENC_LEN),
+                               sec + CEMU_RSA_TAG);
+    } else if (t[0] == CEMU_TOK_INTERNAL && sec[0] == CEMU_SEC_EC_PRIV) {
+        if (CEMU_PKA_HDR + seclen >= tlen ||
+            CEMU_EC_ENC + (size_t)cemu_get_be16(sec + CEMU_EC_ENC_LEN) > seclen)
+            goto invalid;
+        if (cemu_check_mkvp(CEMU_MK_APKA, sec + CEMU_EC_MKVP) != 0)
+            goto mkvp_mismatch;
+        pkey = cemu_unseal_der(sec, CEMU_EC_NONCE, sec + CEMU_EC_NONCE,
+                               sec + CEMU_EC_ENC,
+                               cemu_get_be16(sec + CEMU_EC_ENC_LEN),
+                               sec + CEMU_EC_TAG);
+    } else if (!want_private && t[0] == CEMU_TOK_EXTERNAL &&
+               sec[0] == CEMU_SEC_RSA_PUBL) {
+        pub = sec + 12;
+        nlen = cemu_get_be16(sec + 10);
+        if (CEMU_PKA_HDR + 12 + cemu_get_be16(sec + 6) + nlen > tlen)
+            goto invalid;
+        pkey = cemu_rsa_publ_key(pub + cemu_get_be16(sec + 6), nlen,
+                                 pub, cemu_get_be16(sec + 6));
+    } else if (!want_private && t[0] == CEMU_TOK_EXTERNAL &&
+               sec[0] == CEMU_SEC_EC_PUBL) {
+        if (CEMU_PKA_HDR + CEMU_ECPUB_Q +
+                (size_t)cemu_get_be16(sec + CEMU_ECPUB_Q_LEN) > tlen)
+            goto invalid;
+        pkey = cemu_ec_publ_key(sec);
+    }
+
+    if (pkey == NULL)
+        goto invalid;
+    return pkey;
+
+invalid:
+    cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                CEMU_RS_KEY_TOKEN_INVALID);
+    return NULL;
+
+mkvp_mismatch:
+    cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                CEMU_RS_MKVP_MISMATCH);
+    return NULL;
+}
+
+/*
+ * Key token build. Public key tokens are built directly, key pair tokens
+ * are skeletons carrying the key values structure:
+ *   0: 0x1e, 2-3: token length, 8: 0xce, 9: kind, 10-11: structure length,
+ *   12-: key values structure
+ */
+
+static long cemu_kvs_length(enum cemu_skeleton_kind kind,
+                            const unsigned char *kvs, long max)
+{
+    long len = 0;
+    int i;
+
+    if (max < 8)
+        return -1;
+
+    switch (kind) {
+    case CEMU_SKEL_RSA_CRT:
+        if (max < 18)
+            return -1;
+        len = 18 + cemu_get_be16(kvs + 2) + cemu_get_be16(kvs + 4);
+        for (i = 8; i < 18; i += 2)
+            len += cemu_get_be16(kvs + i);
+        break;
+    case CEMU_SKEL_RSA_ME:
+        len = 8 + cemu_get_be16(kvs + 2) + cemu_get_be16(kvs + 4) +
+              cemu_get_be16(kvs + 6);
+        break;
+    case CEMU_SKEL_EC_PAIR:
+        len = 8 + cemu_get_be16(kvs + 4) + cemu_get_be16(kvs + 6);
+        break;
+    }
+
+    return len <= max ? len : -1;
+}
+
+static void cemu_pka_token_build(long *return_code, long *reason_code,
+                                 long *rule_array_count,
+                                 unsigned char *rule_array,
+                                 long *key_values_structure_length,
+                                 unsigned char *kvs,
+                                 long *token_length, unsigned char *token)
+{
+    static const char *const rules[] = {
+        "RSA-AESC", "RSA-AESM", "KEY-MGMT", "RSA-PUBL", "ECC-PAIR",
+        "ECC-PUBL", NULL
+    };
+    long cnt = *rule_array_count, kvs_len, ret;
+    enum cemu_skeleton_kind kind;
+    uint16_t nlen, elen;
+
+    if (!cemu_rules_valid(rule_array, cnt, rules)) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (cemu_keyword(rule_array, cnt, "RSA-PUBL")) {
+        nlen = cemu_get_be16(kvs + 2);
+        elen = cemu_get_be16(kvs + 4);
+        if (8 + nlen + elen > *key_values_structure_length) {
+            cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                        CEMU_RS_LENGTH_INVALID);
+            return;
+        }
+        ret = cemu_rsa_publ_build(kvs + 8, nlen, kvs + 8 + nlen, elen,
+                                  cemu_get_be16(kvs), token, *token_length);
+        goto out;
+    }
+
+    if (cemu_keyword(rule_array, cnt, "ECC-PUBL")) {
+        if (cemu_curve_name(kvs[0], cemu_get_be16(kvs + 2)) == NULL) {
+            cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                        CEMU_RS_CURVE_NOT_SUPPORTED);
+            return;
+        }
+        if (6 + cemu_get_be16(kvs + 4) > *key_values_structure_length) {
+            cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                        CEMU_RS_LENGTH_INVALID);
+            return;
+        }
+        ret = cemu_ec_publ_build(kvs[0], cemu_get_be16(kvs + 2), kvs + 6,
+                                 cemu_get_be16(kvs + 4), token,
+                                 *token_length);
+        goto out;
+    }
+
+    if (cemu_keyword(rule_array, cnt, "ECC-PAIR")) {
+        kind = CEMU_SKEL_EC_PAIR;
+        if (cemu_curve_name(kvs[0], cemu_get_be16(kvs + 2)) == NULL) {
+            cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                        CEMU_RS_CURVE_NOT_SUPPORTED);
+            return;
+        }
+    } else if (cemu_keyword(rule_array, cnt, "RSA-AESC") &&
+               cemu_keyword(rule_array, cnt, "KEY-MGMT")) {
+        kind = CEMU_SKEL_RSA_CRT;
+    } else if (cemu_keyword(rule_array, cnt, "RSA-AESM") &&
+               cemu_keyword(rule_array, cnt, "KEY-MGMT")) {
+        kind = CEMU_SKEL_RSA_ME;
+    } else {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    kvs_len = cemu_kvs_length(kind, kvs, *key_values_structure_length);
+    if (kvs_len < 0 || 12 + kvs_len > *token_length) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    memset(token, 0, 12);
+    token[0] = CEMU_TOK_EXTERNAL;
+    cemu_put_be16(token + 2, 12 + kvs_len);
+    token[8] = CEMU_SEC_SKELETON;
+    token[9] = kind;
+    cemu_put_be16(token + 10, kvs_len);
+    memcpy(token + 12, kvs, kvs_len);
+    ret = 12 + kvs_len;
+
+out:
+    cemu_build_rc(ret, return_code, reason_code);
+    if (ret > 0)
+        *token_length = ret;
+}
+
+void CSNDPKB(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *key_values_structure_length,
+             unsigned char *key_values_structure,
+             long *key_name_ln, unsigned char *key_name,
+             long *customer_data_length, unsigned char *customer_data,
+             long *reserved_2_length, unsigned char *reserved_2,
+             long *reserved_3_length, unsigned char *reserved_3,
+             long *reserved_4_length, unsigned char *reserved_4,
+             long *reserved_5_length, unsigned char *reserved_5,
+             long *token_length, unsigned char *token)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)key_name_ln;
+    (void)key_name;
+    (void)customer_data_length;
+    (void)customer_data;
+    (void)reserved_2_length;
+    (void)reserved_2;
+    (void)reserved_3_length;
+    (void)reserved_3;
+    (void)reserved_4_length;
+    (void)reserved_4;
+    (void)reserved_5_length;
+    (void)reserved_5;
+
+    cemu_init_once();
+    cemu_pka_token_build(return_code, reason_code, rule_array_count,
+                         rule_array, key_values_structure_length,
+                         key_values_structure, token_length, token);
+}
+
+/* Returns the key values structure of a skeleton token of the given kind */
+static const unsigned char *cemu_skeleton_kvs(const unsigned char *t,
+                                              long len, uint8_t *kind)
+{
+    if (t == NULL || len < 12 || t[0] != CEMU_TOK_EXTERNAL ||
+        t[8] != CEMU_SEC_SKELETON ||
+        12 + cemu_get_be16(t + 10) > cemu_get_be16(t + 2))
+        return NULL;
+
+    *kind = t[9];
+    return t + 12;
+}
+
+/*
+ * Key generation
+ */
+
+static EVP_PKEY *cemu_rsa_generate(const unsigned char *kvs)
+{
+    uint16_t bits = cemu_get_be16(kvs), elen = cemu_get_be16(kvs + 4);
+    EVP_PKEY_CTX *ctx;
+    EVP_PKEY *pkey = NULL;
+    BIGNUM *e;
+
+    e = elen > 0 ? BN_bin2bn(kvs + 18, elen, NULL) : BN_new();
+    if (e == NULL || (elen == 0 && !BN_set_word(e, RSA_F4))) {
+        BN_free(e);
+        return NULL;
+    }
+
+    ctx = EVP_PKEY_CTX_new_from_name(NULL, "RSA", NULL);
+    if (ctx == NULL || EVP_PKEY_keygen_init(ctx) != 1 ||
+        EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, bits) != 1 ||
+        EVP_PKEY_CTX_set1_rsa_keygen_pubexp(ctx, e) != 1 ||
+        EVP_PKEY_keygen(ctx, &pkey) != 1)
+        pkey = NULL;
+
+    EVP_PKEY_CTX_free(ctx);
+    BN_free(e);
+    return pkey;
+}
+
+static EVP_PKEY *cemu_ec_generate(const unsigned char *kvs)
+{
+    const char *name = cemu_curve_name(kvs[0], cemu_get_be16(kvs + 2));
+
+    if (name == NULL)
+        return NULL;
+
+    return EVP_PKEY_Q_keygen(NULL, NULL, "EC", name);
+}
+
+static void cemu_pka_keygen(long *return_code, long *reason_code,
+                            long *rule_array_count, unsigned char *rule_array,
+                            long *skeleton_key_token_length,
+                            unsigned char *skeleton_key_token,
+                            long *generated_key_identifier_length,
+                            unsigned char *generated_key_identifier)
+{
+    static const char *const rules[] = { "MASTER", NULL };
+    const unsigned char *kvs;
+    EVP_PKEY *pkey = NULL;
+    uint8_t kind;
+    long ret;
+
+    if (!cemu_rules_valid(rule_array, *rule_array_count, rules)) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    kvs = cemu_skeleton_kvs(skeleton_key_token, *skeleton_key_token_length,
+                            &kind);
+    if (kvs == NULL || kind == CEMU_SKEL_RSA_ME) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_KEY_TOKEN_INVALID);
+        return;
+    }
+
+    if (kind == CEMU_SKEL_EC_PAIR) {
+        pkey = cemu_ec_generate(kvs);
+        ret = pkey != NULL ? cemu_ec_priv_build(pkey, generated_key_identifier,
+                                *generated_key_identifier_length) : -1;
+    } else {
+        pkey = cemu_rsa_generate(kvs);
+        ret = pkey != NULL ?
+                cemu_rsa_priv_build(pkey, generated_key_identifier,
+                                    *generated_key_identifier_length) : -1;
+    }
+
+    EVP_PKEY_free(pkey);
+    cemu_build_rc(ret, return_code, reason_code);
+    if (ret > 0)
+        *generated_key_identifier_length = ret;
+}
+
+void CSNDPKG(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *regeneration_data_length, unsigned char *regeneration_data,
+             long *skeleton_key_token_length,
+             unsigned char *skeleton_key_token,
+             unsigned char *transport_key_identifier,
+             long *generated_key_identifier_length,
+             unsigned char *generated_key_identifier)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)regeneration_data_length;
+    (void)regeneration_data;
+    (void)transport_key_identifier;
+
+    CEMU_REQUEST(0, cemu_pka_keygen(return_code, reason_code,
+                                    rule_array_count, rule_array,
+                                    skeleton_key_token_length,
+                                    skeleton_key_token,
+                                    generated_key_identifier_length,
+                                    generated_key_identifier));
+}
+
+/*
+ * Key import of clear key values
+ */
+
+static int cemu_push_bn(OSSL_PARAM_BLD *bld, const char *key,
+                        const unsigned char *val, size_t len, BN_CTX *bnctx)
+{
+    BIGNUM *bn = BN_CTX_get(bnctx);
+
+    return bn != NULL && BN_bin2bn(val, len, bn) != NULL &&
+           OSSL_PARAM_BLD_push_BN(bld, key, bn);
+}
+
+enum {
+    CEMU_RSA_PARAM_N,
+    CEMU_RSA_PARAM_E,
+    CEMU_RSA_PARAM_D,
+    CEMU_RSA_PARAM_P,
+    CEMU_RSA_PARAM_Q,
+    CEMU_RSA_PARAM_DP,
+    CEMU_RSA_PARAM_DQ,
+    CEMU_RSA_PARAM_QINV,
+    CEMU_RSA_NUM_PARAMS,
+};
+
+static const char *const cemu_rsa_params[CEMU_RSA_NUM_PARAMS] = {
+    OSSL_PKEY_PARAM_RSA_N, OSSL_PKEY_PARAM_RSA_E, OSSL_PKEY_PARAM_RSA_D,
+    OSSL_PKEY_PARAM_RSA_FACTOR1, OSSL_PKEY_PARAM_RSA_FACTOR2,
+    OSSL_PKEY_PARAM_RSA_EXPONENT1, OSSL_PKEY_PARAM_RSA_EXPONENT2,
+    OSSL_PKEY_PARAM_RSA_COEFFICIENT1,
+};
+
+/*
+ * Recovers the primes of a key in modulus-exponent form: with
+ * d * e - 1 = 2^t * r, r odd, a square root of 1 mod n other than +-1 is
+ * found in the sequence g^r, g^2r, ... for most bases g, and it reveals a
+ * factor of n.
+ */
+static int cemu_rsa_factor(BIGNUM **c, BN_CTX *bnctx)
+{
+    BIGNUM *k = BN_CTX_get(bnctx), *r = BN_CTX_get(bnctx);
+    BIGNUM *g = BN_CTX_get(bnctx), *y = BN_CTX_get(bnctx);
+    BIGNUM *x = BN_CTX_get(bnctx), *nm1 = BN_CTX_get(bnctx);
+    BIGNUM *n = c[CEMU_RSA_PARAM_N];
+    int t, i, base;
+
+    if (nm1 == NULL ||
+        !BN_mul(k, c[CEMU_RSA_PARAM_D], c[CEMU_RSA_PARAM_E], bnctx) ||
+        !BN_sub_word(k, 1) || BN_is_zero(k) || BN_is_odd(k) ||
+        !BN_sub(nm1, n, BN_value_one()))
+        return 0;
+
+    for (t = 0; !BN_is_bit_set(k, t); t++)
+        ;
+    if (!BN_rshift(r, k, t))
+        return 0;
+
+    for (base = 2; base < 100; base++) {
+        if (!BN_set_word(g, base) || !BN_mod_exp(y, g, r, n, bnctx))
+            return 0;
+        if (BN_is_one(y) || BN_cmp(y, nm1) == 0)
+            continue;
+
+        for (i = 0; i < t; i++) {
+            if (!BN_mod_sqr(x, y, n, bnctx))
+                return 0;
+            if (BN_is_one(x))
+                return BN_sub_word(y, 1) &&
+                       BN_gcd(c[CEMU_RSA_PARAM_P], y, n, bnctx) &&
+                       BN_div(c[CEMU_RSA_PARAM_Q], NULL, n,
+                              c[CEMU_RSA_PARAM_P], bnctx);
+            if (BN_cmp(x, nm1) == 0 || BN_copy(y, x) == NULL)
+                break;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Keys are always imported with all CRT components, they are required to
+ * encode the key. The CRT key values structure does not carry the private
+ * exponent, the modulus-exponent one lacks the primes.
+ */
+static EVP_PKEY *cemu_rsa_import(uint8_t kind, const unsigned char *kvs)
+{
+    uint16_t nlen = cemu_get_be16(kvs + 2), elen = cemu_get_be16(kvs + 4);
+    BIGNUM *c[CEMU_RSA_NUM_PARAMS], *pm1, *qm1, *phi;
+    const unsigned char *data, *p;
+    OSSL_PARAM_BLD *bld;
+    EVP_PKEY *pkey = NULL;
+    BN_CTX *bnctx;
+    int i, ok;
+
+    bld = OSSL_PARAM_BLD_new();
+    bnctx = BN_CTX_new();
+    if (bld == NULL || bnctx == NULL)
+        goto out;
+    BN_CTX_start(bnctx);
+
+    for (i = 0; i < CEMU_RSA_NUM_PARAMS; i++) {
+        c[i] = BN_CTX_get(bnctx);
+        if (c[i] == NULL)
+            goto out;
+    }
+    pm1 = BN_CTX_get(bnctx);
+    qm1 = BN_CTX_get(bnctx);
+    phi = BN_CTX_get(bnctx);
+    if (phi == NULL)
+        goto out;
+
+    data = kvs + (kind == CEMU_SKEL_RSA_ME ? 8 : 18);
+    if (BN_bin2bn(data, nlen, c[CEMU_RSA_PARAM_N]) == NULL ||
+        BN_bin2bn(data + nlen, elen, c[CEMU_RSA_PARAM_E]) == NULL)
+        goto out;
+    p = data + nlen + elen;
+
+    if (kind == CEMU_SKEL_RSA_ME) {
+        ok = BN_bin2bn(p, cemu_get_be16(kvs + 6),
+                       c[CEMU_RSA_PARAM_D]) != NULL &&
+             cemu_rsa_factor(c, bnctx) &&
+             BN_sub(pm1, c[CEMU_RSA_PARAM_P], BN_value_one()) &&
+             BN_sub(qm1, c[CEMU_RSA_PARAM_Q], BN_value_one()) &&
+             BN_mod(c[CEMU_RSA_PARAM_DP], c[CEMU_RSA_PARAM_D], pm1,
+                    bnctx) &&
+             BN_mod(c[CEMU_RSA_PARAM_DQ], c[CEMU_RSA_PARAM_D], qm1,
+                    bnctx) &&
+             BN_mod_inverse(c[CEMU_RSA_PARAM_QINV], c[CEMU_RSA_PARAM_Q],
+                            c[CEMU_RSA_PARAM_P], bnctx) != NULL;
+    } else {
+        for (ok = 1, i = 0; ok && i < 5; i++) {
+            ok = BN_bin2bn(p, cemu_get_be16(kvs + 8 + 2 * i),
+                           c[CEMU_RSA_PARAM_P + i]) != NULL;
+            p += cemu_get_be16(kvs + 8 + 2 * i);
+        }
+        ok = ok &&
+             BN_sub(pm1, c[CEMU_RSA_PARAM_P], BN_value_one()) &&
+             BN_sub(qm1, c[CEMU_RSA_PARAM_Q], BN_value_one()) &&
+             BN_mul(phi, pm1, qm1, bnctx) &&
+             BN_mod_inverse(c[CEMU_RSA_PARAM_D], c[CEMU_RSA_PARAM_E], phi,
+                            bnctx) != NULL;
+    }
+
+    for (i = 0; ok && i < CEMU_RSA_NUM_PARAMS; i++)
+        ok = OSSL_PARAM_BLD_push_BN(bld, cemu_rsa_params[i], c[i]);
+    if (ok)
+        pkey = cemu_pkey_fromdata("RSA", EVP_PKEY_KEYPAIR, bld);
+
+out:
+    if (bnctx != NULL)
+        BN_CTX_end(bnctx);
+    BN_CTX_free(bnctx);
+    OSSL_PARAM_BLD_free(bld);
+    return pkey;
+}
+
+static EVP_PKEY *cemu_ec_import(const unsigned char *kvs)
+{
+    const char *name = cemu_curve_name(kvs[0], cemu_get_be16(kvs + 2));
+    uint16_t dlen = cemu_get_be16(kvs + 4), qlen = cemu_get_be16(kvs + 6);
+    OSSL_PARAM_BLD *bld;
+    EVP_PKEY *pkey = NULL;
+    BN_CTX *bnctx;
+
+    if (name == NULL)
+        return NULL;
+
+    bld = OSSL_PARAM_BLD_new();
+    bnctx = BN_CTX_new();
+    if (bld != NULL && bnctx != NULL) {
+        BN_CTX_start(bnctx);
+        if (OSSL_PARAM_BLD_push_utf8_string(bld, OSSL_PKEY_PARAM_GROUP_NAME,
+                                            name, 0) &&
+            cemu_push_bn(bld, OSSL_PKEY_PARAM_PRIV_KEY, kvs + 8, dlen,
+                         bnctx) &&
+            OSSL_PARAM_BLD_push_octet_string(bld, OSSL_PKEY_PARAM_PUB_KEY,
+                                             kvs + 8 + dlen, qlen))
+            pkey = cemu_pkey_fromdata("EC", EVP_PKEY_KEYPAIR, bld);
+        BN_CTX_end(bnctx);
+    }
+
+    BN_CTX_free(bnctx);
+    OSSL_PARAM_BLD_free(bld);
+    return pkey;
+}
+
+static void cemu_pka_import(long *return_code, long *reason_code,
+                            long *rule_array_count, unsigned char *rule_array,
+                            long *source_key_token_length,
+                            unsigned char *source_key_token,
+                            long *target_key_identifier_length,
+                            unsigned char *target_key_identifier)
+{
+    static const char *const rules[] = { "ECC", NULL };
+    const unsigned char *kvs;
+    EVP_PKEY *pkey;
+    uint8_t kind;
+    long ret;
+
+    if (!cemu_rules_valid(rule_array, *rule_array_count, rules)) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    kvs = cemu_skeleton_kvs(source_key_token, *source_key_token_length,
+                            &kind);
+    if (kvs == NULL) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_KEY_TOKEN_INVALID);
+        return;
+    }
+
+    if (kind == CEMU_SKEL_EC_PAIR) {
+        pkey = cemu_ec_import(kvs);
+        ret = pkey != NULL ? cemu_ec_priv_build(pkey, target_key_identifier,
+                                *target_key_identifier_length) : -1;
+    } else {
+        pkey = cemu_rsa_import(kind, kvs);
+        ret = pkey != NULL ? cemu_rsa_priv_build(pkey, target_key_identifier,
+                                *target_key_identifier_length) : -1;
+    }
+
+    EVP_PKEY_free(pkey);
+    cemu_build_rc(ret, return_code, reason_code);
+    if (ret > 0)
+        *target_key_identifier_length = ret;
+}
+
+void CSNDPKI(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *source_key_token_length, unsigned char *source_key_token,
+             unsigned char *importer_key_identifier,
+             long *target_key_identifier_length,
+             unsigned char *target_key_identifier)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)importer_key_identifier;
+
+    CEMU_REQUEST(0, cemu_pka_import(return_code, reason_code,
+                                    rule_array_count, rule_array,
+                                    source_key_token_length, source_key_token,
+                                    target_key_identifier_length,
+                                    target_key_identifier));
+}
+
+/* Public key extract, no adapter request is needed */
+void CSNDPKX(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *source_key_identifier_length,
+             unsigned char *source_key_identifier,
+             long *target_key_token_length, unsigned char *target_key_token)
+{
+    const unsigned char *t = source_key_identifier, *sec, *pub;
+    size_t seclen;
+    long ret;
+
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)rule_array_count;
+    (void)rule_array;
+
+    if (t == NULL || *source_key_identifier_length < CEMU_PKA_HDR + 4 ||
+        t[0] != CEMU_TOK_INTERNAL ||
+        cemu_get_be16(t + 2) > *source_key_identifier_length) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_KEY_TOKEN_INVALID);
+        return;
+    }
+
+    sec = t + CEMU_PKA_HDR;
+    seclen = cemu_get_be16(sec + 2);
+    pub = sec + seclen;
+    if (CEMU_PKA_HDR + seclen >= cemu_get_be16(t + 2)) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_KEY_TOKEN_INVALID);
+        return;
+    }
+
+    if (sec[0] == CEMU_SEC_RSA_CRT) {
+        ret = cemu_rsa_publ_build(sec + CEMU_RSA_N,
+                                  cemu_get_be16(sec + CEMU_RSA_N_LEN),
+                                  pub + 12, cemu_get_be16(pub + 6),
+                                  cemu_get_be16(pub + 8), target_key_token,
+                                  *target_key_token_length);
+    } else if (sec[0] == CEMU_SEC_EC_PRIV) {
+        ret = cemu_ec_publ_build(pub[CEMU_ECPUB_CURVE_TYPE],
+                                 cemu_get_be16(pub + CEMU_ECPUB_BITS),
+                                 pub + CEMU_ECPUB_Q,
+                                 cemu_get_be16(pub + CEMU_ECPUB_Q_LEN),
+                                 target_key_token, *target_key_token_length);
+    } else {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_KEY_TOKEN_INVALID);
+        return;
+    }
+
+    cemu_build_rc(ret, return_code, reason_code);
+    if (ret > 0)
+        *target_key_token_length = ret;
+}
+
+/*
+ * Digital signatures. PKCS-1.1 signs the given data with PKCS #1 v1.5
+ * block type 1 padding, PKCS-PSS expects the salt length (4 bytes, big
+ * endian) followed by the hash, ECDSA returns r || s.
+ */
+
+static int cemu_sig_setup(EVP_PKEY_CTX *ctx, long cnt,
+                          const unsigned char *rule_array, const EVP_MD *md,
+                          const unsigned char **data, long *data_len)
+{
+    int salt_len;
+
+    if (cemu_keyword(rule_array, cnt, "ECDSA"))
+        return EVP_PKEY_get_base_id(EVP_PKEY_CTX_get0_pkey(ctx)) ==
+                                                            EVP_PKEY_EC;
+    if (EVP_PKEY_get_base_id(EVP_PKEY_CTX_get0_pkey(ctx)) != EVP_PKEY_RSA)
+        return 0;
+
+    if (cemu_keyword(rule_array, cnt, "PKCS-1.1"))
+        return EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) == 1;
+
+    if (md == NULL || *data_len < 4)
+        return 0;
+    salt_len = ((*data)[0] << 24) | ((*data)[1] << 16) |
+               ((*data)[2] << 8) | (*data)[3];
+    *data += 4;
+    *data_len -= 4;
+
+    return EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PSS_PADDING) == 1 &&
+           EVP_PKEY_CTX_set_signature_md(ctx, md) == 1 &&
+           EVP_PKEY_CTX_set_rsa_mgf1_md(ctx, md) == 1 &&
+           EVP_PKEY_CTX_set_rsa_pss_saltlen(ctx, salt_len) == 1;
+}
+
+static const EVP_MD *cemu_rule_md(const unsigned char *rule_array, long cnt)
+{
+    const EVP_MD *md = NULL;
+    long i;
+
+    for (i = 0; i < cnt && md == NULL; i++)
+        md = cemu_hash_md(rule_array + i * CEMU_KEYWORD_SIZE);
+
+    return md;
+}
+
+static void cemu_sign(long *return_code, long *reason_code,
+                      long *rule_array_count, unsigned char *rule_array,
+                      long *key_id_length, unsigned char *key_id,
+                      long *hash_length, unsigned char *hash,
+                      long *signature_field_length,
+                      long *signature_bit_length,
+                      unsigned char *signature_field)
+{
+    static const char *const rules[] = {
+        "PKCS-1.1", "PKCS-PSS", "ECDSA", "SHA-1", "SHA-224", "SHA-256",
+        "SHA-384", "SHA-512", NULL
+    };
+    long cnt = *rule_array_count, data_len = *hash_length;
+    const unsigned char *data = hash;
+    unsigned char sig[1024];
+    EVP_PKEY_CTX *ctx = NULL;
+    EVP_PKEY *pkey;
+    ECDSA_SIG *ecsig = NULL;
+    const unsigned char *p;
+    size_t siglen = sizeof(sig), flen;
+    int ok = 0;
+
+    if (!cemu_rules_valid(rule_array, cnt, rules) ||
+        (!cemu_keyword(rule_array, cnt, "PKCS-1.1") &&
+         !cemu_keyword(rule_array, cnt, "PKCS-PSS") &&
+         !cemu_keyword(rule_array, cnt, "ECDSA"))) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    pkey = cemu_pka_key(key_id, *key_id_length, 1, return_code, reason_code);
+    if (pkey == NULL)
+        return;
+
+    ctx = EVP_PKEY_CTX_new_from_pkey(NULL, pkey, NULL);
+    if (ctx == NULL || EVP_PKEY_sign_init(ctx) != 1 ||
+        !cemu_sig_setup(ctx, cnt, rule_array, cemu_rule_md(rule_array, cnt),
+                        &data, &data_len) ||
+        EVP_PKEY_sign(ctx, sig, &siglen, data, data_len) != 1)
+        goto out;
+
+    if (EVP_PKEY_get_base_id(pkey) == EVP_PKEY_EC) {
+        /* Convert the DER encoded signature to r || s */
+        flen = (EVP_PKEY_get_bits(pkey) + 7) / 8;
+        p = sig;
+        ecsig = d2i_ECDSA_SIG(NULL, &p, siglen);
+        if (ecsig == NULL || *signature_field_length < (long)(2 * flen) ||
+            BN_bn2binpad(ECDSA_SIG_get0_r(ecsig), signature_field,
+                         flen) < 0 ||
+            BN_bn2binpad(ECDSA_SIG_get0_s(ecsig), signature_field + flen,
+                         flen) < 0)
+            goto out;
+        siglen = 2 * flen;
+    } else {
+        if (*signature_field_length < (long)siglen)
+            goto out;
+        memcpy(signature_field, sig, siglen);
+    }
+
+    *signature_field_length = siglen;
+    *signature_bit_length = siglen * 8;
+    ok = 1;
+
+out:
+    ECDSA_SIG_free(ecsig);
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(pkey);
+    if (ok)
+        cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+    else
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+}
+
+void CSNDDSG(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *PKA_private_key_id_length,
+             unsigned char *PKA_private_key_id,
+             long *hash_length, unsigned char *hash,
+             long *signature_field_length, long *signature_bit_length,
+             unsigned char *signature_field)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+
+    CEMU_REQUEST(*hash_length,
+                 cemu_sign(return_code, reason_code, rule_array_count,
+                           rule_array, PKA_private_key_id_length,
+                           PKA_private_key_id, hash_length, hash,
+                           signature_field_length, signature_bit_length,
+                           signature_field));
+}
+
+static void cemu_verify(long *return_code, long *reason_code,
+                        long *rule_array_count, unsigned char *rule_array,
+                        long *key_id_length, unsigned char *key_id,
+                        long *hash_length, unsigned char *hash,
+                        long *signature_field_length,
+                        unsigned char *signature_field)
+{
+    static const char *const rules[] = {
+        "PKCS-1.1", "PKCS-PSS", "ECDSA", "SHA-1", "SHA-224", "SHA-256",
+        "SHA-384", "SHA-512", NULL
+    };
+    long cnt = *rule_array_count, data_len = *hash_length;
+    const unsigned char *data = hash, *sig = signature_field;
+    size_t siglen = *signature_field_length, flen;
+    unsigned char *der = NULL;
+    EVP_PKEY_CTX *ctx = NULL;
+    ECDSA_SIG *ecsig = NULL;
+    BIGNUM *r = NULL, *s = NULL;
+    EVP_PKEY *pkey;
+    int derlen, rc;
+
+    if (!cemu_rules_valid(rule_array, cnt, rules) ||
+        (!cemu_keyword(rule_array, cnt, "PKCS-1.1") &&
+         !cemu_keyword(rule_array, cnt, "PKCS-PSS") &&
+         !cemu_keyword(rule_array, cnt, "ECDSA"))) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    pkey = cemu_pka_key(key_id, *key_id_length, 0, return_code, reason_code);
+    if (pkey == NULL)
+        return;
+
+    if (EVP_PKEY_get_base_id(pkey) == EVP_PKEY_EC) {
+        /* Convert r || s to a DER encoded signature */
+        flen = (EVP_PKEY_get_bits(pkey) + 7) / 8;
+        ecsig = ECDSA_SIG_new();
+        if (siglen != 2 * flen || ecsig == NULL ||
+            (r = BN_bin2bn(sig, flen, NULL)) == NULL ||
+            (s = BN_bin2bn(sig + flen, flen, NULL)) == NULL ||
+            ECDSA_SIG_set0(ecsig, r, s) != 1) {
+            BN_free(r);
+            BN_free(s);
+            rc = -1;
+            goto out;
+        }
+        derlen = i2d_ECDSA_SIG(ecsig, &der);
+        if (derlen <= 0) {
+            rc = -1;
+            goto out;
+        }
+        sig = der;
+        siglen = derlen;
+    }
+
+    ctx = EVP_PKEY_CTX_new_from_pkey(NULL, pkey, NULL);
+    if (ctx == NULL || EVP_PKEY_verify_init(ctx) != 1 ||
+        !cemu_sig_setup(ctx, cnt, rule_array, cemu_rule_md(rule_array, cnt),
+                        &data, &data_len)) {
+        rc = -2;
+        goto out;
+    }
+    rc = EVP_PKEY_verify(ctx, sig, siglen, data, data_len) == 1 ? 0 : -1;
+
+out:
+    OPENSSL_free(der);
+    ECDSA_SIG_free(ecsig);
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(pkey);
+    if (rc == 0)
+        cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+    else if (rc == -1)
+        cemu_set_rc(return_code, reason_code, CEMU_RC_WARNING,
+                    CEMU_RS_VERIFY_FAILED);
+    else
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+}
+
+void CSNDDSV(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *PKA_public_key_id_length, unsigned char *PKA_public_key_id,
+             long *hash_length, unsigned char *hash,
+             long *signature_field_length, unsigned char *signature_field)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+
+    CEMU_REQUEST(*hash_length,
+                 cemu_verify(return_code, reason_code, rule_array_count,
+                             rule_array, PKA_public_key_id_length,
+                             PKA_public_key_id, hash_length, hash,
+                             signature_field_length, signature_field));
+}
+
+/*
+ * RSA encryption with PKCS #1 v1.5 block type 2 or OAEP padding
+ */
+
+static void cemu_rsa_crypt(int encrypt, long *return_code, long *reason_code,
+                           long *rule_array_count, unsigned char *rule_array,
+                           long *in_length, unsigned char *in,
+                           long *key_length, unsigned char *key,
+                           long *out_length, unsigned char *out)
+{
+    static const char *const rules[] = {
+        "PKCS-1.2", "PKCSOAEP", "PKOAEP2", "SHA-1", "SHA-224", "SHA-256",
+        "SHA-384", "SHA-512", NULL
+    };
+    long cnt = *rule_array_count;
+    const EVP_MD *md = cemu_rule_md(rule_array, cnt);
+    int oaep = cemu_keyword(rule_array, cnt, "PKCSOAEP") ||
+               cemu_keyword(rule_array, cnt, "PKOAEP2");
+    EVP_PKEY_CTX *ctx = NULL;
+    EVP_PKEY *pkey;
+    size_t outlen;
+    int ok;
+
+    if (!cemu_rules_valid(rule_array, cnt, rules) ||
+        (oaep ? md == NULL : !cemu_keyword(rule_array, cnt, "PKCS-1.2"))) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    pkey = cemu_pka_key(key, *key_length, !encrypt, return_code,
+                        reason_code);
+    if (pkey == NULL)
+        return;
+
+    if (EVP_PKEY_get_base_id(pkey) != EVP_PKEY_RSA ||
+        *out_length < (encrypt ? EVP_PKEY_get_size(pkey) : 0)) {
+        EVP_PKEY_free(pkey);
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    outlen = *out_length;
+    ctx = EVP_PKEY_CTX_new_from_pkey(NULL, pkey, NULL);
+    ok = ctx != NULL && (encrypt ? EVP_PKEY_encrypt_init(ctx) :
+                                   EVP_PKEY_decrypt_init(ctx)) == 1;
+    if (ok && oaep)
+        ok = EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_OAEP_PADDING) == 1 &&
+             EVP_PKEY_CTX_set_rsa_oaep_md(ctx, md) == 1 &&
+             EVP_PKEY_CTX_set_rsa_mgf1_md(ctx, md) == 1;
+    else if (ok)
+        ok = EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) == 1;
+    if (ok)
+        ok = (encrypt ? EVP_PKEY_encrypt(ctx, out, &outlen, in, *in_length) :
+                        EVP_PKEY_decrypt(ctx, out, &outlen, in,
+                                         *in_length)) == 1;
+
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(pkey);
+    if (!ok) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    encrypt ? CEMU_RS_CRYPTO_FAILED : CEMU_RS_DECRYPT_FAILED);
+        return;
+    }
+
+    *out_length = outlen;
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+}
+
+void CSNDPKE(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *key_value_length, unsigned char *key_value,
+             long *data_struct_length, unsigned char *data_struct,
+             long *RSA_public_key_length, unsigned char *RSA_public_key,
+             long *RSA_encipher_length, unsigned char *RSA_encipher)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)data_struct_length;
+    (void)data_struct;
+
+    CEMU_REQUEST(*key_value_length,
+                 cemu_rsa_crypt(1, return_code, reason_code,
+                                rule_array_count, rule_array,
+                                key_value_length, key_value,
+                                RSA_public_key_length, RSA_public_key,
+                                RSA_encipher_length, RSA_encipher));
+}
+
+void CSNDPKD(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *enciphered_key_length, unsigned char *enciphered_key,
+             long *data_struct_length, unsigned char *data_struct,
+             long *RSA_private_key_length, unsigned char *RSA_private_key,
+             long *key_value_length, unsigned char *key_value)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)data_struct_length;
+    (void)data_struct;
+
+    CEMU_REQUEST(*enciphered_key_length,
+                 cemu_rsa_crypt(0, return_code, reason_code,
+                                rule_array_count, rule_array,
+                                enciphered_key_length, enciphered_key,
+                                RSA_private_key_length, RSA_private_key,
+                                key_value_length, key_value));
+}
@@ -0,0 +1,1216 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Software CCA host library emulator: DES, AES and HMAC keys, symmetric
+ * encryption and HMACs.
+ *
+ * The key tokens carry the header fields the CCA token evaluates (token
+ * type, key length, control vector and MKVP) at their CCA offsets. The
+ * remaining token bytes hold the emulator's protected key material and do
+ * not follow the CCA token formats.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+
+#include "ccaemu.h"
+#include "csulincl.h"
+
+#define CEMU_SKEY_TOKEN_SIZE        64
+#define CEMU_HMAC_MAGIC             0x43454d4d  /* "CEMM" */
+#define CEMU_HMAC_MAX_KEY_BITS      2048
+#define CEMU_HMAC_PAYLOAD_OFFSET    64
+#define CEMU_SHORT_TAG_BYTES        4
+
+enum cemu_skey_type {
+    CEMU_SKEY_DES,
+    CEMU_SKEY_AES,
+    CEMU_SKEY_HMAC,
+};
+
+/* A clear key recovered from a key token */
+struct cemu_skey {
+    enum cemu_skey_type type;
+    unsigned char key[CEMU_HMAC_MAX_KEY_BITS / 8];
+    size_t len;
+};
+
+/*
+ * DES DATA key token, version 0:
+ *   0: 0x01, 4: 0x00, 8-15: MKVP, 32-39: control vector,
+ *   16-31 and 40-47: encrypted key (24 bytes), 48-55: nonce, 60-63: tag
+ */
+
+static size_t cemu_des_keyform_len(uint8_t keyform)
+{
+    switch (keyform) {
+    case 0:
+        return 8;
+    case 2:
+    case 6:
+        return 16;
+    case 3:
+    case 7:
+        return 24;
+    default:
+        return 0;
+    }
+}
+
+static void cemu_des_aad(const unsigned char *t, unsigned char *aad)
+{
+    memcpy(aad, t, 16);
+    memcpy(aad + 16, t + 32, 8);
+}
+
+static int cemu_des_build(unsigned char *t, const unsigned char *key,
+                          size_t len, uint8_t keyform)
+{
+    unsigned char clear[24] = { 0 }, enc[24], aad[24];
+    uint64_t cv;
+
+    memset(t, 0, CEMU_SKEY_TOKEN_SIZE);
+    t[0] = 0x01;
+    t[4] = 0x00;
+    memcpy(t + 8, cemu_cfg.mks[CEMU_MK_SYM].mkvp, CEMU_MKVP_BYTES);
+    cv = htobe64((uint64_t)keyform << 21);
+    memcpy(t + 32, &cv, sizeof(cv));
+
+    memcpy(clear, key, len);
+    cemu_des_aad(t, aad);
+    if (cemu_seal(CEMU_MK_SYM, aad, sizeof(aad), clear, sizeof(clear),
+                  t + 48, enc, t + 60, CEMU_SHORT_TAG_BYTES) != 0)
+        return -1;
+
+    memcpy(t + 16, enc, 16);
+    memcpy(t + 40, enc + 16, 8);
+    OPENSSL_cleanse(clear, sizeof(clear));
+    return 0;
+}
+
+static int cemu_des_parse(const unsigned char *t, struct cemu_skey *key,
+                          long *return_code, long *reason_code)
+{
+    unsigned char clear[24], enc[24], aad[24];
+    uint64_t cv;
+
+    memcpy(&cv, t + 32, sizeof(cv));
+    key->len = cemu_des_keyform_len((be64toh(cv) >> 21) & 0x07);
+    if (key->len == 0)
+        goto invalid;
+
+    if (cemu_check_mkvp(CEMU_MK_SYM, t + 8) != 0) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_MKVP_MISMATCH);
+        return -1;
+    }
+
+    memcpy(enc, t + 16, 16);
+    memcpy(enc + 16, t + 40, 8);
+    cemu_des_aad(t, aad);
+    if (cemu_unseal(CEMU_MK_SYM, aad, sizeof(aad), t + 48, enc, sizeof(enc),
+                    t + 60, CEMU_SHORT_TAG_BYTES, clear) != 0)
+        goto invalid;
+
+    key->type = CEMU_SKEY_DES;
+    memcpy(key->key, clear, key->len);
+    OPENSSL_cleanse(clear, sizeof(clear));
+    return 0;
+
+invalid:
+    cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                CEMU_RS_KEY_TOKEN_INVALID);
+    return -1;
+}
+
+/*
+ * AES DATA key token, version 4:
+ *   0: 0x01, 4: 0x04, 7: 0x80 if a key is present, 8-15: MKVP,
+ *   16-47: encrypted key, 48-55: nonce, 56-57: key bit length, 60-63: tag
+ */
+
+static void cemu_aes_aad(const unsigned char *t, unsigned char *aad)
+{
+    memcpy(aad, t, 16);
+    memcpy(aad + 16, t + 56, 2);
+}
+
+static void cemu_aes_skeleton(unsigned char *t, uint16_t bits)
+{
+    memset(t, 0, CEMU_SKEY_TOKEN_SIZE);
+    t[0] = 0x01;
+    t[4] = 0x04;
+    cemu_put_be16(t + 56, bits);
+}
+
+static int cemu_aes_build(unsigned char *t, const unsigned char *key,
+                          size_t len)
+{
+    unsigned char clear[32] = { 0 }, aad[18];
+
+    cemu_aes_skeleton(t, len * 8);
+    t[7] = 0x80;
+    memcpy(t + 8, cemu_cfg.mks[CEMU_MK_AES].mkvp, CEMU_MKVP_BYTES);
+
+    memcpy(clear, key, len);
+    cemu_aes_aad(t, aad);
+    if (cemu_seal(CEMU_MK_AES, aad, sizeof(aad), clear, sizeof(clear),
+                  t + 48, t + 16, t + 60, CEMU_SHORT_TAG_BYTES) != 0)
+        return -1;
+
+    OPENSSL_cleanse(clear, sizeof(clear));
+    return 0;
+}
+
+static int cemu_aes_parse(const unsigned char *t, struct cemu_skey *key,
+                          long *return_code, long *reason_code)
+{
+    unsigned char clear[32], aad[18];
+    uint16_t bits = cemu_get_be16(t + 56);
+
+    if ((t[7] & 0x80) == 0 || (bits != 128 && bits != 192 && bits != 256))
+        goto invalid;
+
+    if (cemu_check_mkvp(CEMU_MK_AES, t + 8) != 0) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_MKVP_MISMATCH);
+        return -1;
+    }
+
+    cemu_aes_aad(t, aad);
+    if (cemu_unseal(CEMU_MK_AES, aad, sizeof(aad), t + 48, t + 16, 32,
+                    t + 60, CEMU_SHORT_TAG_BYTES, clear) != 0)
+        goto invalid;
+
+    key->type = CEMU_SKEY_AES;
+    key->len = bits / 8;
+    memcpy(key->key, clear, key->len);
+    OPENSSL_cleanse(clear, sizeof(clear));
+    return 0;
+
+invalid:
+    cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                CEMU_RS_KEY_TOKEN_INVALID);
+    return -1;
+}
+
+/*
+ * Variable length HMAC key token, version 5:
+ *   0: 0x01, 2-3: token length, 4: 0x05, 8: 0x03 (key present) or 0x00,
+ *   10-17: MKVP, 26-28: 0x02 0x02 0x00, 38-39: payload bit length,
+ *   41: 0x03, 42-43: 0x0002, 44-45: key bit length, 46-53: nonce,
+ *   64-: encrypted key and tag, padded to the payload length
+ */
+
+static uint16_t cemu_hmac_payload_bits(uint16_t bits)
+{
+    return (((bits + 32) + 63) & ~63) + 320;
+}
+
+static void cemu_hmac_skeleton(unsigned char *t)
+{
+    memset(t, 0, CEMU_HMAC_PAYLOAD_OFFSET);
+    t[0] = 0x01;
+    cemu_put_be16(t + 2, CEMU_HMAC_PAYLOAD_OFFSET);
+    t[4] = 0x05;
+    t[26] = 0x02;
+    t[27] = 0x02;
+    t[41] = 0x03;
+    cemu_put_be16(t + 42, 0x0002);
+}
+
+static int cemu_hmac_is_skeleton(const unsigned char *t, long len)
+{
+    return len >= CEMU_HMAC_PAYLOAD_OFFSET && t[0] == 0x01 && t[4] == 0x05 &&
+           t[41] == 0x03 && cemu_get_be16(t + 42) == 0x0002;
+}
+
+/* Returns the token length, or -1 */
+static long cemu_hmac_build(unsigned char *t, long max_len,
+                            const unsigned char *key, size_t bits)
+{
+    size_t keylen = (bits + 7) / 8;
+    uint16_t plbits = cemu_hmac_payload_bits(bits);
+    long len = CEMU_HMAC_PAYLOAD_OFFSET + plbits / 8;
+    unsigned char *payload = t + CEMU_HMAC_PAYLOAD_OFFSET;
+
+    if (len > max_len)
+        return -1;
+
+    cemu_hmac_skeleton(t);
+    cemu_put_be16(t + 2, len);
+    t[8] = 0x03;
+    memcpy(t + 10, cemu_cfg.mks[CEMU_MK_AES].mkvp, CEMU_MKVP_BYTES);
+    cemu_put_be16(t + 38, plbits);
+    cemu_put_be16(t + 44, bits);
+
+    memset(payload, 0, plbits / 8);
+    if (cemu_seal(CEMU_MK_AES, t, 46, key, keylen, t + 46, payload,
+                  payload + keylen, CEMU_TAG_BYTES) != 0)
+        return -1;
+
+    return len;
+}
+
+static int cemu_hmac_parse(const unsigned char *t, long len,
+                           struct cemu_skey *key,
+                           long *return_code, long *reason_code)
+{
+    size_t bits, keylen;
+
+    if (!cemu_hmac_is_skeleton(t, len) || t[8] != 0x03 ||
+        cemu_get_be16(t + 2) > len)
+        goto invalid;
+
+    bits = cemu_get_be16(t + 44);
+    keylen = (bits + 7) / 8;
+    if (bits == 0 || bits > CEMU_HMAC_MAX_KEY_BITS ||
+        CEMU_HMAC_PAYLOAD_OFFSET + keylen + CEMU_TAG_BYTES >
+                                            cemu_get_be16(t + 2))
+        goto invalid;
+
+    if (cemu_check_mkvp(CEMU_MK_AES, t + 10) != 0) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_MKVP_MISMATCH);
+        return -1;
+    }
+
+    if (cemu_unseal(CEMU_MK_AES, t, 46, t + 46, t + CEMU_HMAC_PAYLOAD_OFFSET,
+                    keylen, t + CEMU_HMAC_PAYLOAD_OFFSET + keylen,
+                    CEMU_TAG_BYTES, key->key) != 0)
+        goto invalid;
+
+    key->type = CEMU_SKEY_HMAC;
+    key->len = keylen;
+    return 0;
+
+invalid:
+    cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                CEMU_RS_KEY_TOKEN_INVALID);
+    return -1;
+}
+
+static int cemu_skey_parse(const unsigned char *t, long len,
+                           struct cemu_skey *key,
+                           long *return_code, long *reason_code)
+{
+    if (t != NULL && len >= CEMU_SKEY_TOKEN_SIZE && t[0] == 0x01) {
+        if (t[4] == 0x00)
+            return cemu_des_parse(t, key, return_code, reason_code);
+        if (t[4] == 0x04)
+            return cemu_aes_parse(t, key, return_code, reason_code);
+        if (t[4] == 0x05)
+            return cemu_hmac_parse(t, len, key, return_code, reason_code);
+    }
+
+    cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                CEMU_RS_KEY_TOKEN_INVALID);
+    return -1;
+}
+
+/* Sets odd parity on each byte of a DES key */
+static void cemu_des_parity(unsigned char *key, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        key[i] &= 0xfe;
+        if ((__builtin_popcount(key[i]) & 1) == 0)
+            key[i] |= 0x01;
+    }
+}
+
+/*
+ * Key token build and key generation
+ */
+
+void CSNBKTB(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             unsigned char *key_token, unsigned char *key_type,
+             long *rule_array_count, unsigned char *rule_array,
+             unsigned char *key_value, void *reserved_field_1,
+             long *reserved_field_2, unsigned char *reserved_field_3,
+             unsigned char *control_vector, unsigned char *reserved_field_4,
+             long *reserved_field_5, unsigned char *reserved_field_6,
+             unsigned char *master_key_verification_number)
+{
+    static const char *const rules[] = {
+        "INTERNAL", "AES", "NO-KEY", "KEYLN16", "KEYLN24", "KEYLN32", NULL
+    };
+    uint16_t bits = 256;
+
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)key_value;
+    (void)reserved_field_1;
+    (void)reserved_field_2;
+    (void)reserved_field_3;
+    (void)control_vector;
+    (void)reserved_field_4;
+    (void)reserved_field_5;
+    (void)reserved_field_6;
+    (void)master_key_verification_number;
+
+    /* Only AES DATA skeleton tokens, the key is generated by CSNBKGN */
+    if (!cemu_rules_valid(rule_array, *rule_array_count, rules) ||
+        !cemu_keyword(rule_array, *rule_array_count, "AES") ||
+        !cemu_keyword(rule_array, *rule_array_count, "NO-KEY") ||
+        !cemu_keyword(key_type, 1, "DATA")) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (cemu_keyword(rule_array, *rule_array_count, "KEYLN16"))
+        bits = 128;
+    else if (cemu_keyword(rule_array, *rule_array_count, "KEYLN24"))
+        bits = 192;
+
+    cemu_aes_skeleton(key_token, bits);
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+}
+
+void CSNBKTB2(long *return_code, long *reason_code,
+              long *exit_data_length, unsigned char *exit_data,
+              long *rule_array_count, unsigned char *rule_array,
+              long *clear_key_bit_length, unsigned char *clear_key_value,
+              long *key_name_length, unsigned char *key_name,
+              long *user_associated_data_length,
+              unsigned char *user_associated_data,
+              long *token_data_length, unsigned char *token_data,
+              long *reserved_length, unsigned char *reserved,
+              long *target_key_token_length, unsigned char *target_key_token)
+{
+    static const char *const rules[] = {
+        "INTERNAL", "NO-KEY", "HMAC", "MAC", "GENERATE", "VERIFY", NULL
+    };
+
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)clear_key_bit_length;
+    (void)clear_key_value;
+    (void)key_name_length;
+    (void)key_name;
+    (void)user_associated_data_length;
+    (void)user_associated_data;
+    (void)token_data_length;
+    (void)token_data;
+    (void)reserved_length;
+    (void)reserved;
+
+    /* Only HMAC skeleton tokens, AES CIPHER keys are not supported */
+    if (!cemu_rules_valid(rule_array, *rule_array_count, rules) ||
+        !cemu_keyword(rule_array, *rule_array_count, "HMAC")) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (*target_key_token_length < CEMU_HMAC_PAYLOAD_OFFSET) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    cemu_hmac_skeleton(target_key_token);
+    *target_key_token_length = CEMU_HMAC_PAYLOAD_OFFSET;
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+}
+
+static void cemu_keygen(long *return_code, long *reason_code,
+                        unsigned char *key_form, unsigned char *key_length,
+                        unsigned char *key_type_1,
+                        unsigned char *generated_key_identifier_1)
+{
+    unsigned char key[32];
+    uint8_t keyform;
+    size_t len;
+    int rc;
+
+    if (!cemu_keyword(key_form, 1, "OP")) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (cemu_keyword(key_type_1, 1, "AESTOKEN") ||
+        cemu_keyword(key_type_1, 1, "AESDATA")) {
+        if (cemu_keyword(key_length, 1, "KEYLN16"))
+            len = 16;
+        else if (cemu_keyword(key_length, 1, "KEYLN24"))
+            len = 24;
+        else if (cemu_keyword(key_length, 1, "KEYLN32"))
+            len = 32;
+        else if (cemu_keyword(key_length, 1, "") &&
+                 cemu_keyword(key_type_1, 1, "AESTOKEN"))
+            len = cemu_get_be16(generated_key_identifier_1 + 56) / 8;
+        else
+            len = 32;
+        if (len != 16 && len != 24 && len != 32)
+            goto rule_invalid;
+
+        if (RAND_bytes(key, len) != 1)
+            goto crypto_failed;
+        rc = cemu_aes_build(generated_key_identifier_1, key, len);
+    } else if (cemu_keyword(key_type_1, 1, "DATA")) {
+        if (cemu_keyword(key_length, 1, "KEYLN8") ||
+            cemu_keyword(key_length, 1, "SINGLE")) {
+            len = 8;
+            keyform = 0;
+        } else if (cemu_keyword(key_length, 1, "DOUBLE-O")) {
+            len = 16;
+            keyform = 6;
+        } else if (cemu_keyword(key_length, 1, "TRIPLE-O")) {
+            len = 24;
+            keyform = 7;
+        } else {
+            goto rule_invalid;
+        }
+
+        if (RAND_bytes(key, len) != 1)
+            goto crypto_failed;
+        cemu_des_parity(key, len);
+        rc = cemu_des_build(generated_key_identifier_1, key, len, keyform);
+    } else {
+        goto rule_invalid;
+    }
+
+    OPENSSL_cleanse(key, sizeof(key));
+    if (rc != 0)
+        goto crypto_failed;
+
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+    return;
+
+rule_invalid:
+    cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                CEMU_RS_RULE_INVALID);
+    return;
+
+crypto_failed:
+    cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                CEMU_RS_CRYPTO_FAILED);
+}
+
+void CSNBKGN(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             unsigned char *key_form, unsigned char *key_length,
+             unsigned char *key_type_1, unsigned char *key_type_2,
+             unsigned char *KEK_key_identifier_1,
+             unsigned char *KEK_key_identifier_2,
+             unsigned char *generated_key_identifier_1,
+             unsigned char *generated_key_identifier_2)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)key_type_2;
+    (void)KEK_key_identifier_1;
+    (void)KEK_key_identifier_2;
+    (void)generated_key_identifier_2;
+
+    CEMU_REQUEST(0, cemu_keygen(return_code, reason_code, key_form,
+                                key_length, key_type_1,
+                                generated_key_identifier_1));
+}
+
+static void cemu_keygen2(long *return_code, long *reason_code,
+                         long *rule_array_count, unsigned char *rule_array,
+                         long *clear_key_bit_length, unsigned char *key_type_1,
+                         long *generated_key_identifier_1_length,
+                         unsigned char *generated_key_identifier_1)
+{
+    static const char *const rules[] = { "HMAC", "OP", NULL };
+    unsigned char key[CEMU_HMAC_MAX_KEY_BITS / 8];
+    long bits = *clear_key_bit_length, len;
+
+    if (!cemu_rules_valid(rule_array, *rule_array_count, rules) ||
+        !cemu_keyword(rule_array, *rule_array_count, "HMAC") ||
+        !cemu_keyword(key_type_1, 1, "TOKEN")) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (bits < 80 || bits > CEMU_HMAC_MAX_KEY_BITS ||
+        !cemu_hmac_is_skeleton(generated_key_identifier_1,
+                               *generated_key_identifier_1_length)) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    if (RAND_bytes(key, (bits + 7) / 8) != 1) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_CRYPTO_FAILED);
+        return;
+    }
+
+    len = cemu_hmac_build(generated_key_identifier_1,
+                          *generated_key_identifier_1_length, key, bits);
+    OPENSSL_cleanse(key, sizeof(key));
+    if (len < 0) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    *generated_key_identifier_1_length = len;
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+}
+
+void CSNBKGN2(long *return_code, long *reason_code,
+              long *exit_data_length, unsigned char *exit_data,
+              long *rule_array_count, unsigned char *rule_array,
+              long *clear_key_bit_length, unsigned char *key_type_1,
+              unsigned char *key_type_2,
+              long *key_name_1_length, unsigned char *key_name_1,
+              long *key_name_2_length, unsigned char *key_name_2,
+              long *user_associated_data_1_length,
+              unsigned char *user_associated_data_1,
+              long *user_associated_data_2_length,
+              unsigned char *user_associated_data_2,
+              long *KEK_key_identifier_1_length,
+              unsigned char *KEK_key_identifier_1,
+              long *KEK_key_identifier_2_length,
+              unsigned char *KEK_key_identifier_2,
+              long *generated_key_identifier_1_length,
+              unsigned char *generated_key_identifier_1,
+              long *generated_key_identifier_2_length,
+              unsigned char *generated_key_identifier_2)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)key_type_2;
+    (void)key_name_1_length;
+    (void)key_name_1;
+    (void)key_name_2_length;
+    (void)key_name_2;
+    (void)user_associated_data_1_length;
+    (void)user_associated_data_1;
+    (void)user_associated_data_2_length;
+    (void)user_associated_data_2;
+    (void)KEK_key_identifier_1_length;
+    (void)KEK_key_identifier_1;
+    (void)KEK_key_identifier_2_length;
+    (void)KEK_key_identifier_2;
+    (void)generated_key_identifier_2_length;
+    (void)generated_key_identifier_2;
+
+    CEMU_REQUEST(0, cemu_keygen2(return_code, reason_code, rule_array_count,
+                                 rule_array, clear_key_bit_length, key_type_1,
+                                 generated_key_identifier_1_length,
+                                 generated_key_identifier_1));
+}
+
+/*
+ * Clear key import. HMAC keys are imported with a single FIRST part, the
+ * COMPLETE call only checks the token.
+ */
+
+static void cemu_key_part_import(long *return_code, long *reason_code,
+                                 long *rule_array_count,
+                                 unsigned char *rule_array,
+                                 long *clear_key_part_length,
+                                 unsigned char *clear_key_part,
+                                 long *key_identifier_length,
+                                 unsigned char *key_identifier)
+{
+    static const char *const rules[] = {
+        "HMAC", "FIRST", "MIN1PART", "COMPLETE", NULL
+    };
+    long bits = *clear_key_part_length, len;
+
+    if (!cemu_rules_valid(rule_array, *rule_array_count, rules) ||
+        !cemu_keyword(rule_array, *rule_array_count, "HMAC")) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (cemu_keyword(rule_array, *rule_array_count, "COMPLETE")) {
+        if (!cemu_hmac_is_skeleton(key_identifier, *key_identifier_length) ||
+            key_identifier[8] != 0x03) {
+            cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                        CEMU_RS_KEY_TOKEN_INVALID);
+            return;
+        }
+        *key_identifier_length = cemu_get_be16(key_identifier + 2);
+        cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+        return;
+    }
+
+    if (!cemu_keyword(rule_array, *rule_array_count, "FIRST") ||
+        !cemu_keyword(rule_array, *rule_array_count, "MIN1PART")) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (bits < 8 || bits > CEMU_HMAC_MAX_KEY_BITS ||
+        !cemu_hmac_is_skeleton(key_identifier, *key_identifier_length)) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    len = cemu_hmac_build(key_identifier, *key_identifier_length,
+                          clear_key_part, bits);
+    if (len < 0) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    *key_identifier_length = len;
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+}
+
+void CSNBKPI2(long *return_code, long *reason_code,
+              long *exit_data_length, unsigned char *exit_data,
+              long *rule_array_count, unsigned char *rule_array,
+              long *clear_key_part_length, unsigned char *clear_key_part,
+              long *key_identifier_length, unsigned char *key_identifier)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+
+    CEMU_REQUEST(0, cemu_key_part_import(return_code, reason_code,
+                                         rule_array_count, rule_array,
+                                         clear_key_part_length,
+                                         clear_key_part,
+                                         key_identifier_length,
+                                         key_identifier));
+}
+
+static void cemu_clear_key_import(long *return_code, long *reason_code,
+                                  long *rule_array_count,
+                                  unsigned char *rule_array,
+                                  long *clear_key_length,
+                                  unsigned char *clear_key,
+                                  unsigned char *target_key_identifier)
+{
+    static const char *const rules[] = { "AES", "DES", NULL };
+    long len = *clear_key_length;
+    int rc;
+
+    if (!cemu_rules_valid(rule_array, *rule_array_count, rules)) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (cemu_keyword(rule_array, *rule_array_count, "AES")) {
+        if (len != 16 && len != 24 && len != 32)
+            goto length_invalid;
+        rc = cemu_aes_build(target_key_identifier, clear_key, len);
+    } else {
+        if (len != 8 && len != 16 && len != 24)
+            goto length_invalid;
+        rc = cemu_des_build(target_key_identifier, clear_key, len,
+                            len == 8 ? 0 : len == 16 ? 2 : 3);
+    }
+
+    if (rc != 0) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_CRYPTO_FAILED);
+        return;
+    }
+
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+    return;
+
+length_invalid:
+    cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                CEMU_RS_LENGTH_INVALID);
+}
+
+void CSNBCKM(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *clear_key_length, unsigned char *clear_key,
+             unsigned char *target_key_identifier)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+
+    CEMU_REQUEST(0, cemu_clear_key_import(return_code, reason_code,
+                                          rule_array_count, rule_array,
+                                          clear_key_length, clear_key,
+                                          target_key_identifier));
+}
+
+/*
+ * Symmetric encryption
+ */
+
+/* Returns the output length, or -1 */
+static long cemu_cipher(const EVP_CIPHER *cipher, const unsigned char *key,
+                        const unsigned char *iv, int encrypt, int pad,
+                        const unsigned char *in, long in_len,
+                        unsigned char *out)
+{
+    EVP_CIPHER_CTX *ctx;
+    int len1 = 0, len2 = 0, ok;
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL)
+        return -1;
+
+    ok = EVP_CipherInit_ex(ctx, cipher, NULL, key, iv, encrypt) == 1 &&
+         EVP_CIPHER_CTX_set_padding(ctx, pad) == 1 &&
+         EVP_CipherUpdate(ctx, out, &len1, in, in_len) == 1 &&
+         EVP_CipherFinal_ex(ctx, out + len1, &len2) == 1;
+
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? len1 + len2 : -1;
+}
+
+static void cemu_des_crypt(int encrypt, long *return_code, long *reason_code,
+                           unsigned char *key_identifier, long *text_length,
+                           unsigned char *in, unsigned char *iv,
+                           long *rule_array_count, unsigned char *rule_array,
+                           unsigned char *chaining_vector, unsigned char *out)
+{
+    static const char *const rules[] = { "CBC", NULL };
+    struct cemu_skey key;
+    unsigned char k3[24], ocv[8];
+    long len;
+
+    if (!cemu_rules_valid(rule_array, *rule_array_count, rules)) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (*text_length <= 0 || *text_length % 8 != 0) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    if (cemu_skey_parse(key_identifier, CEMU_SKEY_TOKEN_SIZE, &key,
+                        return_code, reason_code) != 0)
+        return;
+    if (key.type != CEMU_SKEY_DES) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_KEY_TOKEN_INVALID);
+        return;
+    }
+
+    /* Single and double length keys as triple length key K1K1K1, K1K2K1 */
+    memcpy(k3, key.key, 8);
+    memcpy(k3 + 8, key.len == 8 ? key.key : key.key + 8, 8);
+    memcpy(k3 + 16, key.len == 24 ? key.key + 16 : key.key, 8);
+
+    if (!encrypt)
+        memcpy(ocv, in + *text_length - 8, 8);
+    len = cemu_cipher(EVP_des_ede3_cbc(), k3, iv, encrypt, 0, in,
+                      *text_length, out);
+    OPENSSL_cleanse(k3, sizeof(k3));
+    OPENSSL_cleanse(&key, sizeof(key));
+    if (len < 0) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_CRYPTO_FAILED);
+        return;
+    }
+
+    if (encrypt)
+        memcpy(ocv, out + len - 8, 8);
+    if (chaining_vector != NULL)
+        memcpy(chaining_vector, ocv, 8);
+    *text_length = len;
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+}
+
+void CSNBENC(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             unsigned char *key_identifier, long *text_length,
+             unsigned char *plaintext, unsigned char *initialization_vector,
+             long *rule_array_count, unsigned char *rule_array,
+             long *pad_character, unsigned char *chaining_vector,
+             unsigned char *ciphertext)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)pad_character;
+
+    CEMU_REQUEST(*text_length,
+                 cemu_des_crypt(1, return_code, reason_code, key_identifier,
+                                text_length, plaintext, initialization_vector,
+                                rule_array_count, rule_array,
+                                chaining_vector, ciphertext));
+}
+
+void CSNBDEC(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             unsigned char *key_identifier, long *text_length,
+             unsigned char *ciphertext, unsigned char *initialization_vector,
+             long *rule_array_count, unsigned char *rule_array,
+             unsigned char *chaining_vector, unsigned char *plaintext)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+
+    CEMU_REQUEST(*text_length,
+                 cemu_des_crypt(0, return_code, reason_code, key_identifier,
+                                text_length, ciphertext,
+                                initialization_vector, rule_array_count,
+                                rule_array, chaining_vector, plaintext));
+}
+
+static const EVP_CIPHER *cemu_aes_cipher(size_t keylen, int ecb)
+{
+    switch (keylen) {
+    case 16:
+        return ecb ? EVP_aes_128_ecb() : EVP_aes_128_cbc();
+    case 24:
+        return ecb ? EVP_aes_192_ecb() : EVP_aes_192_cbc();
+    default:
+        return ecb ? EVP_aes_256_ecb() : EVP_aes_256_cbc();
+    }
+}
+
+/*
+ * AES ECB and CBC with key identifiers. With CONTINUE, the IV is taken from
+ * the chain data of the previous call.
+ */
+static void cemu_aes_crypt(int encrypt, long *return_code, long *reason_code,
+                           long *rule_array_count, unsigned char *rule_array,
+                           long *key_length, unsigned char *key_identifier,
+                           long *block_size, long *iv_length,
+                           unsigned char *iv, long *chain_data_length,
+                           unsigned char *chain_data,
+                           long *in_length, unsigned char *in,
+                           long *out_length, unsigned char *out)
+{
+    static const char *const rules[] = {
+        "AES", "ECB", "CBC", "PKCS-PAD", "KEYIDENT", "INITIAL", "CONTINUE",
+        NULL
+    };
+    struct cemu_skey key;
+    unsigned char *use_iv = NULL, ocv[16] = { 0 };
+    long cnt = *rule_array_count, need, len;
+    int ecb, pad;
+
+    if (!cemu_rules_valid(rule_array, cnt, rules) ||
+        !cemu_keyword(rule_array, cnt, "AES")) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    ecb = cemu_keyword(rule_array, cnt, "ECB");
+    pad = cemu_keyword(rule_array, cnt, "PKCS-PAD");
+    if (ecb && pad) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (!ecb) {
+        if (cemu_keyword(rule_array, cnt, "CONTINUE")) {
+            if (chain_data == NULL || *chain_data_length < 16)
+                goto length_invalid;
+            use_iv = chain_data;
+        } else {
+            if (iv == NULL || *iv_length != 16)
+                goto length_invalid;
+            use_iv = iv;
+        }
+    }
+
+    need = *in_length;
+    if (pad && encrypt)
+        need = (*in_length / 16 + 1) * 16;
+    else if (*in_length % 16 != 0)
+        goto length_invalid;
+    if (*block_size != 16 || *out_length < need)
+        goto length_invalid;
+
+    if (cemu_skey_parse(key_identifier, *key_length, &key,
+                        return_code, reason_code) != 0)
+        return;
+    if (key.type != CEMU_SKEY_AES) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_KEY_TOKEN_INVALID);
+        return;
+    }
+
+    if (!encrypt && *in_length > 0)
+        memcpy(ocv, in + *in_length - 16, 16);
+    len = cemu_cipher(cemu_aes_cipher(key.len, ecb), key.key, use_iv,
+                      encrypt, pad, in, *in_length, out);
+    OPENSSL_cleanse(&key, sizeof(key));
+    if (len < 0) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_CRYPTO_FAILED);
+        return;
+    }
+
+    /* The last cipher block is the IV of a CONTINUE call */
+    if (encrypt && len > 0)
+        memcpy(ocv, out + len - 16, 16);
+    if (!ecb && chain_data != NULL && *chain_data_length >= 16 && len > 0)
+        memcpy(chain_data, ocv, 16);
+    *out_length = len;
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+    return;
+
+length_invalid:
+    cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                CEMU_RS_LENGTH_INVALID);
+}
+
+void CSNBSAE(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *key_length, unsigned char *key_identifier,
+             long *key_parms_length, unsigned char *key_parms,
+             long *block_size, long *initialization_vector_length,
+             unsigned char *initialization_vector,
+             long *chain_data_length, unsigned char *chain_data,
+             long *clear_text_length, unsigned char *clear_text,
+             long *cipher_text_length, unsigned char *cipher_text,
+             long *optional_data_length, unsigned char *optional_data)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)key_parms_length;
+    (void)key_parms;
+    (void)optional_data_length;
+    (void)optional_data;
+
+    CEMU_REQUEST(*clear_text_length,
+                 cemu_aes_crypt(1, return_code, reason_code,
+                                rule_array_count, rule_array, key_length,
+                                key_identifier, block_size,
+                                initialization_vector_length,
+                                initialization_vector, chain_data_length,
+                                chain_data, clear_text_length, clear_text,
+                                cipher_text_length, cipher_text));
+}
+
+void CSNBSAD(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *key_length, unsigned char *key_identifier,
+             long *key_parms_length, unsigned char *key_parms,
+             long *block_size, long *initialization_vector_length,
+             unsigned char *initialization_vector,
+             long *chain_data_length, unsigned char *chain_data,
+             long *cipher_text_length, unsigned char *cipher_text,
+             long *clear_text_length, unsigned char *clear_text,
+             long *optional_data_length, unsigned char *optional_data)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+    (void)key_parms_length;
+    (void)key_parms;
+    (void)optional_data_length;
+    (void)optional_data;
+
+    CEMU_REQUEST(*cipher_text_length,
+                 cemu_aes_crypt(0, return_code, reason_code,
+                                rule_array_count, rule_array, key_length,
+                                key_identifier, block_size,
+                                initialization_vector_length,
+                                initialization_vector, chain_data_length,
+                                chain_data, cipher_text_length, cipher_text,
+                                clear_text_length, clear_text));
+}
+
+/*
+ * HMAC generate and verify. Multi-part operations keep the MAC context in
+ * the emulator, like one-way hashes.
+ */
+
+static EVP_MAC_CTX *cemu_hmac_new(const struct cemu_skey *key,
+                                  const EVP_MD *md)
+{
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                               (char *)EVP_MD_get0_name(md), 0),
+        OSSL_PARAM_END
+    };
+    EVP_MAC_CTX *ctx = NULL;
+    EVP_MAC *hmac;
+
+    hmac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+    if (hmac == NULL)
+        return NULL;
+
+    ctx = EVP_MAC_CTX_new(hmac);
+    EVP_MAC_free(hmac);
+    if (ctx != NULL &&
+        EVP_MAC_init(ctx, key->key, key->len, params) != 1) {
+        EVP_MAC_CTX_free(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+static void cemu_hmac(int verify, long *return_code, long *reason_code,
+                      long *rule_array_count, unsigned char *rule_array,
+                      long *key_identifier_length,
+                      unsigned char *key_identifier,
+                      long *message_text_length, unsigned char *message_text,
+                      long *chaining_vector_length,
+                      unsigned char *chaining_vector,
+                      long *mac_length, unsigned char *mac_text)
+{
+    static const char *const rules[] = {
+        "HMAC", "SHA-1", "SHA-224", "SHA-256", "SHA-384", "SHA-512",
+        "ONLY", "FIRST", "MIDDLE", "LAST", NULL
+    };
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    long cnt = *rule_array_count, i;
+    const EVP_MD *md = NULL;
+    EVP_MAC_CTX *ctx = NULL;
+    struct cemu_skey key;
+    int first, last;
+    size_t maclen;
+
+    for (i = 0; i < cnt && md == NULL; i++)
+        md = cemu_hash_md(rule_array + i * CEMU_KEYWORD_SIZE);
+    first = cemu_keyword(rule_array, cnt, "ONLY") ||
+            cemu_keyword(rule_array, cnt, "FIRST");
+    last = cemu_keyword(rule_array, cnt, "ONLY") ||
+           cemu_keyword(rule_array, cnt, "LAST");
+    if (!cemu_rules_valid(rule_array, cnt, rules) || md == NULL ||
+        (!first && !last && !cemu_keyword(rule_array, cnt, "MIDDLE"))) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_RULE_INVALID);
+        return;
+    }
+
+    if (last && (*mac_length <= 0 ||
+                 (verify && *mac_length > EVP_MD_get_size(md)))) {
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                    CEMU_RS_LENGTH_INVALID);
+        return;
+    }
+
+    if (first) {
+        if (cemu_skey_parse(key_identifier, *key_identifier_length, &key,
+                            return_code, reason_code) != 0)
+            return;
+        if (key.type != CEMU_SKEY_HMAC) {
+            cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                        CEMU_RS_KEY_TOKEN_INVALID);
+            return;
+        }
+        ctx = cemu_hmac_new(&key, md);
+        OPENSSL_cleanse(&key, sizeof(key));
+        if (ctx == NULL)
+            goto error;
+    } else {
+        ctx = cemu_chain_get(chaining_vector, *chaining_vector_length,
+                             CEMU_HMAC_MAGIC);
+        if (ctx == NULL) {
+            cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                        CEMU_RS_RULE_INVALID);
+            return;
+        }
+    }
+
+    if (*message_text_length > 0 &&
+        EVP_MAC_update(ctx, message_text, *message_text_length) != 1)
+        goto error;
+
+    if (!last) {
+        if (cemu_chain_set(chaining_vector, *chaining_vector_length,
+                           CEMU_HMAC_MAGIC, ctx) != 0) {
+            EVP_MAC_CTX_free(ctx);
+            cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                        CEMU_RS_LENGTH_INVALID);
+            return;
+        }
+        cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+        return;
+    }
+
+    if (EVP_MAC_final(ctx, mac, &maclen, sizeof(mac)) != 1)
+        goto error;
+    EVP_MAC_CTX_free(ctx);
+    if (chaining_vector != NULL)
+        cemu_chain_set(chaining_vector, *chaining_vector_length,
+                       CEMU_HMAC_MAGIC, NULL);
+
+    /* Shorter MAC lengths return or verify a truncated MAC */
+    if (verify) {
+        if (CRYPTO_memcmp(mac, mac_text, *mac_length) != 0) {
+            cemu_set_rc(return_code, reason_code, CEMU_RC_WARNING,
+                        CEMU_RS_VERIFY_FAILED);
+            return;
+        }
+    } else {
+        if ((size_t)*mac_length > maclen)
+            *mac_length = maclen;
+        memcpy(mac_text, mac, *mac_length);
+    }
+
+    cemu_set_rc(return_code, reason_code, CEMU_RC_OK, CEMU_RS_OK);
+    return;
+
+error:
+    EVP_MAC_CTX_free(ctx);
+    if (chaining_vector != NULL)
+        cemu_chain_set(chaining_vector, *chaining_vector_length,
+                       CEMU_HMAC_MAGIC, NULL);
+    cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,
+                CEMU_RS_CRYPTO_FAILED);
+}
+
+void CSNBHMG(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *key_identifier_length, unsigned char *key_identifier,
+             long *message_text_length, unsigned char *message_text,
+             long *chaining_vector_length, unsigned char *chaining_vector,
+             long *MAC_length, unsigned char *MAC_text)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+
+    CEMU_REQUEST(*message_text_length,
+                 cemu_hmac(0, return_code, reason_code, rule_array_count,
+                           rule_array, key_identifier_length, key_identifier,
+                           message_text_length, message_text,
+                           chaining_vector_length, chaining_vector,
+                           MAC_length, MAC_text));
+}
+
+void CSNBHMV(long *return_code, long *reason_code,
+             long *exit_data_length, unsigned char *exit_data,
+             long *rule_array_count, unsigned char *rule_array,
+             long *key_identifier_length, unsigned char *key_identifier,
+             long *message_text_length, unsigned char *message_text,
+             long *chaining_vector_length, unsigned char *chaining_vector,
+             long *MAC_length, unsigned char *MAC_text)
+{
+    (void)exit_data_length;
+    (void)exit_data;
+
+    CEMU_REQUEST(*message_text_length,
+                 cemu_hmac(1, return_code, reason_code, rule_array_count,
+                           rule_array, key_identifier_length, key_identifier,
+                           message_text_length, message_text,
+                           chaining_vector_length, chaining_vector,
+                           MAC_length, MAC_text));
+}
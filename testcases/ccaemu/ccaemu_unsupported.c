@@ -0,0 +1,96 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Software CCA host library emulator: verbs that are not emulated.
+ *
+ * The CCA token resolves all verbs it may use when it is loaded, so each
+ * of them must be present. The verbs below fail with return code 8. Only
+ * the return and reason code, the first two parameters of every verb, are
+ * accessed, so csulincl.h is deliberately not included here.
+ */
+
+#include "ccaemu.h"
+
+#define CEMU_UNSUPPORTED(verb)                                          \
+    void verb(long *return_code, long *reason_code);                    \
+    void verb(long *return_code, long *reason_code)                     \
+    {                                                                   \
+        cemu_set_rc(return_code, reason_code, CEMU_RC_ERROR,            \
+                    CEMU_RS_NOT_SUPPORTED);                             \
+    }
+
+CEMU_UNSUPPORTED(CSNBCKI)
+CEMU_UNSUPPORTED(CSNBDKX)
+CEMU_UNSUPPORTED(CSNBDKM)
+CEMU_UNSUPPORTED(CSNBKEX)
+CEMU_UNSUPPORTED(CSNBKIM)
+CEMU_UNSUPPORTED(CSNBKPI)
+CEMU_UNSUPPORTED(CSNBKSI)
+CEMU_UNSUPPORTED(CSNBKRC)
+CEMU_UNSUPPORTED(CSNBAKRC)
+CEMU_UNSUPPORTED(CSNBKRD)
+CEMU_UNSUPPORTED(CSNBKRL)
+CEMU_UNSUPPORTED(CSNBKRR)
+CEMU_UNSUPPORTED(CSNBKRW)
+CEMU_UNSUPPORTED(CSNDKRC)
+CEMU_UNSUPPORTED(CSNDKRD)
+CEMU_UNSUPPORTED(CSNDKRL)
+CEMU_UNSUPPORTED(CSNDKRR)
+CEMU_UNSUPPORTED(CSNDKRW)
+CEMU_UNSUPPORTED(CSNBKYT)
+CEMU_UNSUPPORTED(CSNBKYTX)
+CEMU_UNSUPPORTED(CSNBKTC)
+CEMU_UNSUPPORTED(CSNBKTC2)
+CEMU_UNSUPPORTED(CSNBKTR)
+CEMU_UNSUPPORTED(CSNBRNG)
+CEMU_UNSUPPORTED(CSNBMGN)
+CEMU_UNSUPPORTED(CSNBMVR)
+CEMU_UNSUPPORTED(CSNDKTC)
+CEMU_UNSUPPORTED(CSNDSYI)
+CEMU_UNSUPPORTED(CSNDSYX)
+CEMU_UNSUPPORTED(CSUACFC)
+CEMU_UNSUPPORTED(CSNDSBC)
+CEMU_UNSUPPORTED(CSNDSBD)
+CEMU_UNSUPPORTED(CSUALCT)
+CEMU_UNSUPPORTED(CSUAACM)
+CEMU_UNSUPPORTED(CSUAACI)
+CEMU_UNSUPPORTED(CSNDPKH)
+CEMU_UNSUPPORTED(CSNDPKR)
+CEMU_UNSUPPORTED(CSUAMKD)
+CEMU_UNSUPPORTED(CSNDRKD)
+CEMU_UNSUPPORTED(CSNDRKL)
+CEMU_UNSUPPORTED(CSNDSYG)
+CEMU_UNSUPPORTED(CSNBPTR)
+CEMU_UNSUPPORTED(CSNBCPE)
+CEMU_UNSUPPORTED(CSNBCPA)
+CEMU_UNSUPPORTED(CSNBPGN)
+CEMU_UNSUPPORTED(CSNBPVR)
+CEMU_UNSUPPORTED(CSNBDKG)
+CEMU_UNSUPPORTED(CSNBEPG)
+CEMU_UNSUPPORTED(CSNBCVE)
+CEMU_UNSUPPORTED(CSNBCSG)
+CEMU_UNSUPPORTED(CSNBCSV)
+CEMU_UNSUPPORTED(CSNBCVG)
+CEMU_UNSUPPORTED(CSNBKTP)
+CEMU_UNSUPPORTED(CSNBPEX)
+CEMU_UNSUPPORTED(CSNBPEXX)
+CEMU_UNSUPPORTED(CSUARNT)
+CEMU_UNSUPPORTED(CSNBCVT)
+CEMU_UNSUPPORTED(CSNBMDG)
+CEMU_UNSUPPORTED(CSNBTRV)
+CEMU_UNSUPPORTED(CSNBSKY)
+CEMU_UNSUPPORTED(CSNBSPN)
+CEMU_UNSUPPORTED(CSNBPCU)
+CEMU_UNSUPPORTED(CSUAPRB)
+CEMU_UNSUPPORTED(CSNDTBC)
+CEMU_UNSUPPORTED(CSNDRKX)
+CEMU_UNSUPPORTED(CSNBKET)
+CEMU_UNSUPPORTED(CSNBCTT2)
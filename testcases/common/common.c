@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <dlfcn.h>
 
 #include "pkcs11types.h"
@@ -1494,6 +1495,16 @@ void print_hex(CK_BYTE * buf, CK_ULONG len)
     fprintf(stderr, "\n");
 }
 
+/* Returns the microseconds passed since start (CLOCK_MONOTONIC) */
+double elapsed_us(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e6 +
+           (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
 void usage(char *fct)
 {
     printf("usage:  %s [-securekey] [-noskip] [-noinit] [-h] -slot <num>\n\n",
@@ -1645,3 +1656,147 @@ ret:
     }
     return rv;
 }
+
+/*
+ * Common main() of the tests of IBM extension functions. Parses -slot, -bench,
+ * -h, and the test specific options, skips the test if the library does not
+ * export the extension functions, and runs the tests (and with -bench the
+ * benchmark) in a R/W session that is logged in as user.
+ */
+int do_ext_test_main(int argc, char **argv, const struct ext_test *test)
+{
+    CK_C_INITIALIZE_ARGS cinit_args;
+    CK_BYTE pin[PKCS11_MAX_PIN_LEN];
+    CK_BYTE *user_pin = test->user_pin != NULL ? test->user_pin : pin;
+    CK_ULONG user_pin_len;
+    CK_BBOOL bench = FALSE;
+    int i, rc, ret = 1;
+    CK_RV rv;
+    CK_FLAGS flags;
+
+    *test->slot_id = 1;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-slot") == 0) {
+            ++i;
+            if (i >= argc) {
+                printf("Slot number missing\n");
+                return -1;
+            }
+            *test->slot_id = atoi(argv[i]);
+            continue;
+        }
+
+        if (strcmp(argv[i], "-bench") == 0) {
+            bench = TRUE;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-h") == 0) {
+            if (test->bench_options != NULL)
+                printf("usage:  %s [-slot <num>] [-bench %s] [-h]\n\n",
+                       argv[0], test->bench_options);
+            else
+                printf("usage:  %s [-slot <num>] [-bench] [-h]\n\n",
+                       argv[0]);
+            printf("By default, Slot #1 is used\n");
+            printf("-bench %s\n\n", test->bench_help);
+            return -1;
+        }
+
+        if (test->parse_arg != NULL) {
+            rc = test->parse_arg(argc, argv, &i);
+            if (rc < 0)
+                return -1;
+        }
+    }
+
+    if (get_user_pin(user_pin))
+        return CKR_FUNCTION_FAILED;
+    user_pin_len = (CK_ULONG) strlen((char *) user_pin);
+    if (test->user_pin_len != NULL)
+        *test->user_pin_len = user_pin_len;
+
+    printf("Using slot #%lu...\n\n", *test->slot_id);
+
+    rv = do_GetFunctionList();
+    if (rv != TRUE) {
+        testcase_fail("do_GetFunctionList() rc = %s", p11_get_ckr(rv));
+        goto out;
+    }
+
+    for (i = 0; test->ext_funcs[i].name != NULL; i++) {
+        *test->ext_funcs[i].func = dlsym(pkcs11lib, test->ext_funcs[i].name);
+        if (*test->ext_funcs[i].func == NULL) {
+            testcase_skip("%s not supported", test->ext_funcs[i].name);
+            goto out;
+        }
+    }
+
+    testcase_setup();
+    testcase_begin("Starting...");
+
+    // Initialize
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+
+    if ((rv = funcs->C_Initialize(&cinit_args))) {
+        testcase_fail("C_Initialize rc = %s", p11_get_ckr(rv));
+        goto out;
+    }
+
+    flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+    rv = funcs->C_OpenSession(*test->slot_id, flags, NULL, NULL,
+                              test->session);
+    if (rv != CKR_OK) {
+        testcase_fail("C_OpenSession rc = %s", p11_get_ckr(rv));
+        goto finalize;
+    }
+
+    rv = funcs->C_Login(*test->session, CKU_USER, user_pin, user_pin_len);
+    if (rv != CKR_OK) {
+        testcase_fail("C_Login rc = %s", p11_get_ckr(rv));
+        goto close_session;
+    }
+
+    rv = test->run_tests();
+    if (rv != CKR_OK)
+        goto close_session;
+
+    if (bench && test->run_bench != NULL) {
+        rv = test->run_bench();
+        if (rv != CKR_OK)
+            goto close_session;
+    }
+
+    rv = funcs->C_CloseSession(*test->session);
+    if (rv != CKR_OK) {
+        testcase_fail("C_CloseSession rc = %s", p11_get_ckr(rv));
+        goto finalize;
+    }
+
+    rv = funcs->C_Finalize(NULL);
+    if (rv != CKR_OK) {
+        testcase_fail("C_Finalize rc = %s", p11_get_ckr(rv));
+        goto out;
+    }
+
+    ret = 0;
+    goto out;
+
+close_session:
+    rv = funcs->C_CloseSession(*test->session);
+    if (rv != CKR_OK) {
+        testcase_fail("C_CloseSession rc = %s", p11_get_ckr(rv));
+        ret = 1;
+    }
+finalize:
+    rv = funcs->C_Finalize(NULL);
+    if (rv != CKR_OK) {
+        testcase_fail("C_Finalize rc = %s", p11_get_ckr(rv));
+        ret = 1;
+    }
+out:
+    testcase_print_result();
+    return testcase_return(ret);
+}
@@ -5,7 +5,7 @@ noinst_PROGRAMS += testcases/crypto/aes_tests				\
 	testcases/crypto/ssl3_tests testcases/crypto/ec_tests		\
 	testcases/crypto/rsaupdate_tests				\
 	testcases/crypto/dilithium_tests testcases/crypto/ab_tests	\
-	testcases/crypto/kyber_tests
+	testcases/crypto/kyber_tests testcases/crypto/hash_sign_tests
 noinst_HEADERS +=							\
 	testcases/crypto/aes.h testcases/crypto/des.h			\
 	testcases/crypto/des3.h testcases/crypto/digest.h		\
@@ -54,6 +54,10 @@ testcases_crypto_dilithium_tests_CFLAGS = ${testcases_inc}
 testcases_crypto_dilithium_tests_LDADD = testcases/common/libcommon.la
 testcases_crypto_dilithium_tests_SOURCES = testcases/crypto/dilithium_func.c
 
+testcases_crypto_hash_sign_tests_CFLAGS = ${testcases_inc}
+testcases_crypto_hash_sign_tests_LDADD = testcases/common/libcommon.la
+testcases_crypto_hash_sign_tests_SOURCES = testcases/crypto/hash_sign_func.c
+
 testcases_crypto_rsaupdate_tests_CFLAGS = ${testcases_inc}
 testcases_crypto_rsaupdate_tests_LDADD = testcases/common/libcommon.la
 testcases_crypto_rsaupdate_tests_SOURCES = testcases/crypto/rsaupdate_func.c
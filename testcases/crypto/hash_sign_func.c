@@ -0,0 +1,392 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * openCryptoki testcase for the hash-and-sign mechanisms
+ *
+ * The message is signed and verified in multiple parts with a combined
+ * hash-and-sign mechanism (CKM_ECDSA_SHAx, CKM_SHAx_RSA_PKCS,
+ * CKM_SHAx_RSA_PKCS_PSS) and compared against the unfused result, i.e.
+ * C_Digest followed by a single part sign/verify with the raw mechanism
+ * (CKM_ECDSA, CKM_RSA_PKCS, CKM_RSA_PKCS_PSS).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pkcs11types.h"
+#include "regress.h"
+#include "common.c"
+#include "ec_curves.h"
+#include "mech_to_str.h"
+
+#define MSG_LEN         1000
+#define MAX_HASH_LEN    64
+#define MAX_SIG_LEN     512
+
+static const CK_BYTE digest_info_sha1[] = {
+    0x30, 0x21, 0x30, 0x09, 0x06, 0x05, 0x2b, 0x0e, 0x03, 0x02, 0x1a, 0x05,
+    0x00, 0x04, 0x14
+};
+static const CK_BYTE digest_info_sha224[] = {
+    0x30, 0x2d, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03,
+    0x04, 0x02, 0x04, 0x05, 0x00, 0x04, 0x1c
+};
+static const CK_BYTE digest_info_sha256[] = {
+    0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03,
+    0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20
+};
+static const CK_BYTE digest_info_sha384[] = {
+    0x30, 0x41, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03,
+    0x04, 0x02, 0x02, 0x05, 0x00, 0x04, 0x30
+};
+static const CK_BYTE digest_info_sha512[] = {
+    0x30, 0x51, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03,
+    0x04, 0x02, 0x03, 0x05, 0x00, 0x04, 0x40
+};
+
+struct hash_sign_test {
+    CK_MECHANISM_TYPE mech;
+    CK_MECHANISM_TYPE raw_mech;
+    CK_MECHANISM_TYPE hash_mech;
+    CK_KEY_TYPE key_type;
+    CK_RSA_PKCS_PSS_PARAMS pss;
+    const CK_BYTE *digest_info;
+    CK_ULONG digest_info_len;
+};
+
+#define ECDSA_TEST(_mech, _hash)                                        \
+    { _mech, CKM_ECDSA, _hash, CKK_EC, { 0, 0, 0 }, NULL, 0 }
+#define PKCS_TEST(_mech, _hash, _di)                                    \
+    { _mech, CKM_RSA_PKCS, _hash, CKK_RSA, { 0, 0, 0 }, _di, sizeof(_di) }
+#define PSS_TEST(_mech, _hash, _mgf, _slen)                             \
+    { _mech, CKM_RSA_PKCS_PSS, _hash, CKK_RSA, { _hash, _mgf, _slen },  \
+      NULL, 0 }
+
+static const struct hash_sign_test hash_sign_tests[] = {
+    ECDSA_TEST(CKM_ECDSA_SHA1, CKM_SHA_1),
+    ECDSA_TEST(CKM_ECDSA_SHA224, CKM_SHA224),
+    ECDSA_TEST(CKM_ECDSA_SHA256, CKM_SHA256),
+    ECDSA_TEST(CKM_ECDSA_SHA384, CKM_SHA384),
+    ECDSA_TEST(CKM_ECDSA_SHA512, CKM_SHA512),
+    PKCS_TEST(CKM_SHA1_RSA_PKCS, CKM_SHA_1, digest_info_sha1),
+    PKCS_TEST(CKM_SHA224_RSA_PKCS, CKM_SHA224, digest_info_sha224),
+    PKCS_TEST(CKM_SHA256_RSA_PKCS, CKM_SHA256, digest_info_sha256),
+    PKCS_TEST(CKM_SHA384_RSA_PKCS, CKM_SHA384, digest_info_sha384),
+    PKCS_TEST(CKM_SHA512_RSA_PKCS, CKM_SHA512, digest_info_sha512),
+    PSS_TEST(CKM_SHA1_RSA_PKCS_PSS, CKM_SHA_1, CKG_MGF1_SHA1, 20),
+    PSS_TEST(CKM_SHA224_RSA_PKCS_PSS, CKM_SHA224, CKG_MGF1_SHA224, 28),
+    PSS_TEST(CKM_SHA256_RSA_PKCS_PSS, CKM_SHA256, CKG_MGF1_SHA256, 32),
+    PSS_TEST(CKM_SHA384_RSA_PKCS_PSS, CKM_SHA384, CKG_MGF1_SHA384, 48),
+    PSS_TEST(CKM_SHA512_RSA_PKCS_PSS, CKM_SHA512, CKG_MGF1_SHA512, 64),
+};
+
+#define NUM_HASH_SIGN_TESTS \
+    (sizeof(hash_sign_tests) / sizeof(hash_sign_tests[0]))
+
+/* Uneven part sizes, so that the parts straddle the hash block boundaries */
+static const CK_ULONG part_sizes[] = { 1, 63, 64, 65, 127, 200 };
+
+static CK_RV sign_multipart(CK_SESSION_HANDLE session, CK_MECHANISM *mech,
+                            CK_OBJECT_HANDLE key, CK_BYTE *msg,
+                            CK_ULONG msg_len, CK_BYTE *sig,
+                            CK_ULONG *sig_len)
+{
+    CK_ULONG pos = 0, len, i = 0;
+    CK_RV rc;
+
+    rc = funcs->C_SignInit(session, mech, key);
+    if (rc != CKR_OK)
+        return rc;
+
+    while (pos < msg_len) {
+        len = part_sizes[i++ % (sizeof(part_sizes) / sizeof(part_sizes[0]))];
+        if (len > msg_len - pos)
+            len = msg_len - pos;
+        rc = funcs->C_SignUpdate(session, msg + pos, len);
+        if (rc != CKR_OK)
+            return rc;
+        pos += len;
+    }
+
+    return funcs->C_SignFinal(session, sig, sig_len);
+}
+
+static CK_RV verify_multipart(CK_SESSION_HANDLE session, CK_MECHANISM *mech,
+                              CK_OBJECT_HANDLE key, CK_BYTE *msg,
+                              CK_ULONG msg_len, CK_BYTE *sig,
+                              CK_ULONG sig_len)
+{
+    CK_ULONG pos = 0, len, i = 0;
+    CK_RV rc;
+
+    rc = funcs->C_VerifyInit(session, mech, key);
+    if (rc != CKR_OK)
+        return rc;
+
+    while (pos < msg_len) {
+        len = part_sizes[i++ % (sizeof(part_sizes) / sizeof(part_sizes[0]))];
+        if (len > msg_len - pos)
+            len = msg_len - pos;
+        rc = funcs->C_VerifyUpdate(session, msg + pos, len);
+        if (rc != CKR_OK)
+            return rc;
+        pos += len;
+    }
+
+    return funcs->C_VerifyFinal(session, sig, sig_len);
+}
+
+static CK_RV do_HashSignVerify(CK_SESSION_HANDLE session,
+                               const struct hash_sign_test *test,
+                               CK_OBJECT_HANDLE publ_key,
+                               CK_OBJECT_HANDLE priv_key)
+{
+    CK_RSA_PKCS_PSS_PARAMS pss = test->pss;
+    CK_MECHANISM mech = { test->mech, NULL, 0 };
+    CK_MECHANISM raw_mech = { test->raw_mech, NULL, 0 };
+    CK_MECHANISM hash_mech = { test->hash_mech, NULL, 0 };
+    CK_BYTE msg[MSG_LEN];
+    CK_BYTE data[sizeof(digest_info_sha512) + MAX_HASH_LEN];
+    CK_BYTE fused_sig[MAX_SIG_LEN], raw_sig[MAX_SIG_LEN];
+    CK_ULONG data_len, hash_len, fused_sig_len, raw_sig_len, i;
+    CK_RV rc;
+
+    testcase_begin("Multi-part %s against C_Digest and %s",
+                   mech_to_str(test->mech), mech_to_str(test->raw_mech));
+
+    if (!mech_supported(SLOT_ID, test->mech)) {
+        testcase_skip("Slot %lu doesn't support %s", SLOT_ID,
+                      mech_to_str(test->mech));
+        return CKR_OK;
+    }
+    if (!mech_supported(SLOT_ID, test->raw_mech) ||
+        !mech_supported(SLOT_ID, test->hash_mech)) {
+        testcase_skip("Slot %lu doesn't support %s or %s",
+                      SLOT_ID, mech_to_str(test->raw_mech),
+                      mech_to_str(test->hash_mech));
+        return CKR_OK;
+    }
+
+    if (test->raw_mech == CKM_RSA_PKCS_PSS) {
+        mech.pParameter = &pss;
+        mech.ulParameterLen = sizeof(pss);
+        raw_mech.pParameter = &pss;
+        raw_mech.ulParameterLen = sizeof(pss);
+    }
+
+    for (i = 0; i < sizeof(msg); i++)
+        msg[i] = i % 251;
+
+    /* The unfused way: digest, then sign the hash with the raw mechanism */
+    if (test->digest_info_len > 0)
+        memcpy(data, test->digest_info, test->digest_info_len);
+    hash_len = MAX_HASH_LEN;
+    rc = funcs->C_DigestInit(session, &hash_mech);
+    if (rc == CKR_OK)
+        rc = funcs->C_Digest(session, msg, sizeof(msg),
+                             data + test->digest_info_len, &hash_len);
+    if (rc != CKR_OK) {
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("%s is rejected by policy",
+                          mech_to_str(test->hash_mech));
+            return CKR_OK;
+        }
+        testcase_error("C_DigestInit/C_Digest rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    data_len = test->digest_info_len + hash_len;
+
+    raw_sig_len = sizeof(raw_sig);
+    rc = funcs->C_SignInit(session, &raw_mech, priv_key);
+    if (rc == CKR_OK)
+        rc = funcs->C_Sign(session, data, data_len, raw_sig, &raw_sig_len);
+    if (rc != CKR_OK) {
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("%s is rejected by policy",
+                          mech_to_str(test->raw_mech));
+            return CKR_OK;
+        }
+        testcase_error("C_SignInit/C_Sign with %s rc=%s",
+                       mech_to_str(test->raw_mech), p11_get_ckr(rc));
+        return rc;
+    }
+
+    fused_sig_len = sizeof(fused_sig);
+    rc = sign_multipart(session, &mech, priv_key, msg, sizeof(msg),
+                        fused_sig, &fused_sig_len);
+    if (rc != CKR_OK) {
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("%s is rejected by policy",
+                          mech_to_str(test->mech));
+            return CKR_OK;
+        }
+        testcase_fail("Multi-part sign with %s rc=%s",
+                      mech_to_str(test->mech), p11_get_ckr(rc));
+        return rc;
+    }
+
+    testcase_new_assertion();
+
+    if (fused_sig_len != raw_sig_len) {
+        testcase_fail("Signature length %lu differs from the unfused %lu",
+                      fused_sig_len, raw_sig_len);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    /* PKCS #1 v1.5 signatures are deterministic */
+    if (test->raw_mech == CKM_RSA_PKCS &&
+        memcmp(fused_sig, raw_sig, raw_sig_len) != 0) {
+        testcase_fail("Signature differs from the unfused signature");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    rc = funcs->C_VerifyInit(session, &raw_mech, publ_key);
+    if (rc == CKR_OK)
+        rc = funcs->C_Verify(session, data, data_len, fused_sig,
+                             fused_sig_len);
+    if (rc != CKR_OK) {
+        testcase_fail("Unfused verify of the multi-part signature rc=%s",
+                      p11_get_ckr(rc));
+        return rc;
+    }
+
+    rc = verify_multipart(session, &mech, publ_key, msg, sizeof(msg),
+                          raw_sig, raw_sig_len);
+    if (rc != CKR_OK) {
+        testcase_fail("Multi-part verify of the unfused signature rc=%s",
+                      p11_get_ckr(rc));
+        return rc;
+    }
+
+    raw_sig[raw_sig_len / 2] ^= 0x01;
+    rc = verify_multipart(session, &mech, publ_key, msg, sizeof(msg),
+                          raw_sig, raw_sig_len);
+    if (rc != CKR_SIGNATURE_INVALID) {
+        testcase_fail("Multi-part verify of a corrupted signature rc=%s, "
+                      "expected CKR_SIGNATURE_INVALID", p11_get_ckr(rc));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    testcase_pass("Multi-part %s against C_Digest and %s",
+                  mech_to_str(test->mech), mech_to_str(test->raw_mech));
+
+    return CKR_OK;
+}
+
+CK_RV hash_sign_funcs(void)
+{
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_SESSION_HANDLE session;
+    CK_FLAGS flags;
+    CK_BYTE ec_params[] = OCK_PRIME256V1;
+    CK_BYTE pub_exp[] = { 0x01, 0x00, 0x01 };
+    CK_OBJECT_HANDLE rsa_publ = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE rsa_priv = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE ec_publ = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE ec_priv = CK_INVALID_HANDLE;
+    CK_ULONG i;
+    CK_RV rc, rv = CKR_OK;
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    if (mech_supported(SLOT_ID, CKM_RSA_PKCS_KEY_PAIR_GEN)) {
+        rc = generate_RSA_PKCS_KeyPair(session, 2048, pub_exp,
+                                       sizeof(pub_exp), &rsa_publ, &rsa_priv);
+        if (rc != CKR_OK && !is_rejected_by_policy(rc, session)) {
+            testcase_error("generate_RSA_PKCS_KeyPair rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+
+    if (mech_supported(SLOT_ID, CKM_EC_KEY_PAIR_GEN)) {
+        rc = generate_EC_KeyPair(session, ec_params, sizeof(ec_params),
+                                 &ec_publ, &ec_priv, CK_TRUE);
+        if (rc != CKR_OK && !is_rejected_by_policy(rc, session)) {
+            testcase_error("generate_EC_KeyPair rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+    }
+
+    for (i = 0; i < NUM_HASH_SIGN_TESTS; i++) {
+        if (hash_sign_tests[i].key_type == CKK_RSA ?
+            rsa_priv == CK_INVALID_HANDLE : ec_priv == CK_INVALID_HANDLE) {
+            testcase_begin("Multi-part %s against C_Digest and %s",
+                           mech_to_str(hash_sign_tests[i].mech),
+                           mech_to_str(hash_sign_tests[i].raw_mech));
+            testcase_skip("No key pair for %s",
+                          mech_to_str(hash_sign_tests[i].mech));
+            continue;
+        }
+
+        if (hash_sign_tests[i].key_type == CKK_RSA)
+            rc = do_HashSignVerify(session, &hash_sign_tests[i], rsa_publ,
+                                   rsa_priv);
+        else
+            rc = do_HashSignVerify(session, &hash_sign_tests[i], ec_publ,
+                                   ec_priv);
+        if (rc != CKR_OK) {
+            rv = rc;
+            if (!no_stop)
+                break;
+        }
+    }
+
+testcase_cleanup:
+    if (rsa_publ != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, rsa_publ);
+    if (rsa_priv != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, rsa_priv);
+    if (ec_publ != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, ec_publ);
+    if (ec_priv != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, ec_priv);
+
+    testcase_user_logout();
+    testcase_close_session();
+
+    return rv;
+}
+
+int main(int argc, char **argv)
+{
+    int rc;
+    CK_C_INITIALIZE_ARGS cinit_args;
+    CK_RV rv;
+
+    rc = do_ParseArgs(argc, argv);
+    if (rc != 1)
+        return rc;
+
+    printf("Using slot #%lu...\n\n", SLOT_ID);
+    printf("With option: no_stop: %d\n", no_stop);
+
+    rc = do_GetFunctionList();
+    if (!rc) {
+        PRINT_ERR("ERROR do_GetFunctionList() Failed, rx = 0x%0x\n", rc);
+        return rc;
+    }
+
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+
+    funcs->C_Initialize(&cinit_args);
+
+    testcase_setup();
+    rv = hash_sign_funcs();
+    testcase_print_result();
+
+    funcs->C_Finalize(NULL);
+
+    return testcase_return(rv);
+}
@@ -1871,6 +1871,302 @@ testcase_cleanup:
     return rc;
 }
 
+/* This function should test:
+ * Wrapping of an RSA private key imported in ME-format, i.e. without the
+ * CRT components, and signing with the unwrapped key
+ *
+ * 1. Import the private key without CRT components
+ * 2. Wrap it with an AES key, CKM_AES_CBC_PAD
+ * 3. Unwrap it again
+ * 4. Sign the message with the unwrapped key
+ * 5. Compare the signature with the expected signature
+ *
+ */
+CK_RV do_WrapUnwrapImportRSA(struct PUBLISHED_TEST_SUITE_INFO * tsuite)
+{
+    unsigned int i, j;
+    CK_BYTE actual[MAX_SIGNATURE_SIZE];
+    CK_BYTE *wrapped_key = NULL;
+    CK_ULONG actual_len, wrapped_key_len;
+    CK_BYTE iv[16] = { 0 };
+    CK_MECHANISM wrap_mech = { CKM_AES_CBC_PAD, iv, sizeof(iv) };
+    CK_MECHANISM keygen_mech = { CKM_AES_KEY_GEN, NULL, 0 };
+    CK_MECHANISM mech;
+    CK_OBJECT_HANDLE priv_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE aes_key = CK_INVALID_HANDLE;
+    CK_OBJECT_HANDLE unwrapped_key = CK_INVALID_HANDLE;
+    CK_OBJECT_CLASS key_class = CKO_PRIVATE_KEY;
+    CK_KEY_TYPE key_type = CKK_RSA;
+    CK_BBOOL true = TRUE;
+    CK_BBOOL false = FALSE;
+    CK_ATTRIBUTE me_tmpl[] = {
+        {CKA_CLASS, &key_class, sizeof(key_class)},
+        {CKA_KEY_TYPE, &key_type, sizeof(key_type)},
+        {CKA_SENSITIVE, &false, sizeof(false)},
+        {CKA_SIGN, &true, sizeof(true)},
+        {CKA_MODULUS, NULL, 0},
+        {CKA_PUBLIC_EXPONENT, NULL, 0},
+        {CKA_PRIVATE_EXPONENT, NULL, 0},
+    };
+    CK_ATTRIBUTE crt_attrs[] = {
+        {CKA_PRIME_1, NULL, 0},
+        {CKA_PRIME_2, NULL, 0},
+        {CKA_EXPONENT_1, NULL, 0},
+        {CKA_EXPONENT_2, NULL, 0},
+        {CKA_COEFFICIENT, NULL, 0},
+    };
+    CK_ATTRIBUTE unwrap_tmpl[] = {
+        {CKA_CLASS, &key_class, sizeof(key_class)},
+        {CKA_KEY_TYPE, &key_type, sizeof(key_type)},
+        {CKA_SIGN, &true, sizeof(true)},
+    };
+
+    CK_SLOT_ID slot_id = SLOT_ID;
+    CK_SESSION_HANDLE session;
+    CK_FLAGS flags;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_RV rc, loc_rc;
+
+    // begin testsuite
+    testsuite_begin("%s Wrap/Unwrap (ME-format). ", tsuite->name);
+    testcase_rw_session();
+    testcase_user_login();
+
+    // skip tests if the slot doesn't support the mechanisms **/
+    if (!mech_supported(slot_id, tsuite->mech.mechanism)) {
+        testsuite_skip(tsuite->tvcount,
+                       "Slot %u doesn't support %s (0x%x)",
+                       (unsigned int) slot_id,
+                       mech_to_str(tsuite->mech.mechanism),
+                       (unsigned int) tsuite->mech.mechanism);
+        goto testcase_cleanup;
+    }
+    if (!mech_supported_flags(slot_id, wrap_mech.mechanism,
+                              CKF_WRAP | CKF_UNWRAP)) {
+        testsuite_skip(tsuite->tvcount,
+                       "Slot %u doesn't support %s (0x%x) for wrapping",
+                       (unsigned int) slot_id,
+                       mech_to_str(wrap_mech.mechanism),
+                       (unsigned int) wrap_mech.mechanism);
+        goto testcase_cleanup;
+    }
+
+    rc = generate_AESKey(session, 32, TRUE, &keygen_mech, &aes_key);
+    if (rc != CKR_OK) {
+        if (rc == CKR_POLICY_VIOLATION) {
+            testsuite_skip(tsuite->tvcount,
+                           "AES key generation is not allowed by policy");
+            goto testcase_cleanup;
+        }
+        testcase_error("generate_AESKey(), rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    // iterate over test vectors
+    for (i = 0; i < tsuite->tvcount; i++) {
+        testcase_begin("%s Wrap/Unwrap (ME-format) with test vector %u.",
+                       tsuite->name, i);
+
+        rc = CKR_OK;            // set return value
+
+        if (!keysize_supported(slot_id, tsuite->mech.mechanism,
+                               tsuite->tv[i].mod_len * 8)) {
+            testcase_skip("Token in slot %lu cannot be used with modbits='%lu'",
+                          SLOT_ID, tsuite->tv[i].mod_len * 8);
+            continue;
+        }
+
+        if (is_ep11_token(slot_id) || is_icsf_token(slot_id)) {
+            if ((tsuite->tv[i].mod_len % 128) != 0) {
+                testcase_skip("EP11/ICSF Token cannot be used with this test vector.");
+                continue;
+            }
+        }
+
+        if (is_tpm_token(slot_id)) {
+            if ((!is_valid_tpm_pubexp(tsuite->tv[i].pub_exp,
+                                      tsuite->tv[i].pubexp_len))
+                || (!is_valid_tpm_modbits(tsuite->tv[i].mod_len))) {
+                testcase_skip("TPM Token cannot be used with this test vector.");
+                continue;
+            }
+        }
+
+        if (is_cca_token(slot_id)) {
+            if (!is_valid_cca_pubexp(tsuite->tv[i].pub_exp,
+                                     tsuite->tv[i].pubexp_len)) {
+                testcase_skip("CCA Token cannot be used with this test vector.");
+                continue;
+            }
+        }
+
+        if (is_soft_token(slot_id)) {
+            if (!is_valid_soft_pubexp(tsuite->tv[i].pub_exp,
+                                      tsuite->tv[i].pubexp_len)) {
+                testcase_skip("Soft Token cannot be used with this test vector.");
+                continue;
+            }
+        }
+
+        // create a non-sensitive (private) key without the CRT components,
+        // so that the CRT attributes can be queried below
+        me_tmpl[4].pValue = tsuite->tv[i].mod;
+        me_tmpl[4].ulValueLen = tsuite->tv[i].mod_len;
+        me_tmpl[5].pValue = tsuite->tv[i].pub_exp;
+        me_tmpl[5].ulValueLen = tsuite->tv[i].pubexp_len;
+        me_tmpl[6].pValue = tsuite->tv[i].priv_exp;
+        me_tmpl[6].ulValueLen = tsuite->tv[i].privexp_len;
+
+        rc = funcs->C_CreateObject(session, me_tmpl,
+                                   sizeof(me_tmpl) / sizeof(CK_ATTRIBUTE),
+                                   &priv_key);
+        if (rc != CKR_OK) {
+            if (is_rejected_by_policy(rc, session)) {
+                testcase_skip("RSA key import is not allowed by policy");
+                continue;
+            }
+
+            testcase_error("C_CreateObject(), rc=%s", p11_get_ckr(rc));
+            goto error;
+        }
+
+        // wrap key (length only)
+        rc = funcs->C_WrapKey(session, &wrap_mech, aes_key, priv_key,
+                              NULL, &wrapped_key_len);
+        if (rc == CKR_KEY_NOT_WRAPPABLE || rc == CKR_KEY_UNEXTRACTABLE) {
+            testcase_skip("Token can not wrap RSA private keys");
+            goto skip;
+        }
+        if (rc != CKR_OK) {
+            testcase_error("C_WrapKey(), rc=%s.", p11_get_ckr(rc));
+            goto error;
+        }
+
+        wrapped_key = calloc(wrapped_key_len, 1);
+        if (wrapped_key == NULL) {
+            testcase_error("Can't allocate memory for %lu bytes.",
+                           wrapped_key_len);
+            rc = CKR_HOST_MEMORY;
+            goto error;
+        }
+
+        // wrap key
+        rc = funcs->C_WrapKey(session, &wrap_mech, aes_key, priv_key,
+                              wrapped_key, &wrapped_key_len);
+        if (rc != CKR_OK) {
+            testcase_error("C_WrapKey(), rc=%s.", p11_get_ckr(rc));
+            goto error;
+        }
+
+        // unwrap key
+        rc = funcs->C_UnwrapKey(session, &wrap_mech, aes_key,
+                                wrapped_key, wrapped_key_len,
+                                unwrap_tmpl,
+                                sizeof(unwrap_tmpl) / sizeof(CK_ATTRIBUTE),
+                                &unwrapped_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_UnwrapKey(), rc=%s.", p11_get_ckr(rc));
+            goto error;
+        }
+
+        // sign with the unwrapped key
+        mech = tsuite->mech;
+        actual_len = MAX_SIGNATURE_SIZE;
+
+        rc = funcs->C_SignInit(session, &mech, unwrapped_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_SignInit(), rc=%s.", p11_get_ckr(rc));
+            goto error;
+        }
+
+        rc = funcs->C_Sign(session, tsuite->tv[i].msg, tsuite->tv[i].msg_len,
+                           actual, &actual_len);
+        if (rc != CKR_OK) {
+            testcase_error("C_Sign(), rc=%s.", p11_get_ckr(rc));
+            goto error;
+        }
+
+        // check results
+        testcase_new_assertion();
+
+        if (actual_len != tsuite->tv[i].sig_len ||
+            memcmp(actual, tsuite->tv[i].sig, actual_len) != 0) {
+            testcase_fail("%s Sign with unwrapped key of test vector %u "
+                          "failed.", tsuite->name, i);
+        } else {
+            testcase_pass("C_WrapKey/C_UnwrapKey (ME-format).");
+        }
+
+        // the CRT components recovered for the wrap must not have been
+        // added to the key, it keeps the attributes it was created with
+        testcase_new_assertion();
+
+        for (j = 0; j < sizeof(crt_attrs) / sizeof(CK_ATTRIBUTE); j++)
+            crt_attrs[j].ulValueLen = 0;
+
+        rc = funcs->C_GetAttributeValue(session, priv_key, crt_attrs,
+                                        sizeof(crt_attrs) /
+                                                sizeof(CK_ATTRIBUTE));
+        for (j = 0; j < sizeof(crt_attrs) / sizeof(CK_ATTRIBUTE); j++) {
+            if (crt_attrs[j].ulValueLen != CK_UNAVAILABLE_INFORMATION)
+                break;
+        }
+
+        if (rc != CKR_ATTRIBUTE_TYPE_INVALID ||
+            j < sizeof(crt_attrs) / sizeof(CK_ATTRIBUTE)) {
+            testcase_fail("%s ME-format key of test vector %u has CRT "
+                          "attributes, rc=%s.", tsuite->name, i,
+                          p11_get_ckr(rc));
+        } else {
+            testcase_pass("ME-format key has no CRT attributes.");
+        }
+
+skip:
+        // clean up
+        free(wrapped_key);
+        wrapped_key = NULL;
+
+        if (unwrapped_key != CK_INVALID_HANDLE) {
+            rc = funcs->C_DestroyObject(session, unwrapped_key);
+            if (rc != CKR_OK)
+                testcase_error("C_DestroyObject(), rc=%s.", p11_get_ckr(rc));
+            unwrapped_key = CK_INVALID_HANDLE;
+        }
+
+        rc = funcs->C_DestroyObject(session, priv_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_DestroyObject(), rc=%s.", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        priv_key = CK_INVALID_HANDLE;
+    }
+    goto testcase_cleanup;
+error:
+    free(wrapped_key);
+    if (unwrapped_key != CK_INVALID_HANDLE) {
+        loc_rc = funcs->C_DestroyObject(session, unwrapped_key);
+        if (loc_rc != CKR_OK)
+            testcase_error("C_DestroyObject, rc=%s.", p11_get_ckr(loc_rc));
+    }
+    if (priv_key != CK_INVALID_HANDLE) {
+        loc_rc = funcs->C_DestroyObject(session, priv_key);
+        if (loc_rc != CKR_OK)
+            testcase_error("C_DestroyObject, rc=%s.", p11_get_ckr(loc_rc));
+    }
+testcase_cleanup:
+    if (aes_key != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, aes_key);
+
+    testcase_user_logout();
+    loc_rc = funcs->C_CloseAllSessions(slot_id);
+    if (loc_rc != CKR_OK) {
+        testcase_error("C_CloseAllSessions, rc=%s.", p11_get_ckr(loc_rc));
+    }
+
+    return rc;
+}
+
 /* This function should test:
  * C_Verify, mechanism chosen by caller
  *
@@ -2211,6 +2507,10 @@ CK_RV rsa_funcs(void)
         if (rv != CKR_OK && (!no_stop))
             break;
 
+        rv = do_WrapUnwrapImportRSA(&published_test_suites[i]);
+        if (rv != CKR_OK && (!no_stop))
+            break;
+
         rv = do_VerifyRSA(&published_test_suites[i]);
         if (rv != CKR_OK && (!no_stop))
             break;
@@ -0,0 +1,1222 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Software EP11 host library emulator: library setup, targets and the
+ * per-APQN request queues, module queries, administrative requests, logins
+ * and the exported m_* entry points.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <openssl/rand.h>
+#include <openssl/hmac.h>
+#include <openssl/crypto.h>
+
+#include "ep11emu.h"
+
+#define EMU_DEFAULT_QUEUE_DEPTH     8
+#define EMU_DEFAULT_WK_SEED         "ep11emu"
+#define EMU_HOST_VERSION            0x00040000  /* 4.0.0 */
+#define EMU_FIRMWARE_API            4
+#define EMU_TARGET_SHIFT            32
+
+#define EMU_ADM_MAGIC               0x454d5541  /* "EMUA" */
+
+struct emu_config emu_cfg;
+
+struct emu_target {
+    struct emu_apqn **apqns;
+    unsigned int num_apqns;
+    unsigned long next;
+};
+
+static pthread_once_t emu_once = PTHREAD_ONCE_INIT;
+static pthread_rwlock_t emu_lock = PTHREAD_RWLOCK_INITIALIZER;
+static struct emu_apqn **emu_apqns;
+static unsigned int emu_num_apqns;
+static unsigned long emu_next_apqn;
+static struct emu_target **emu_targets;
+static unsigned int emu_num_targets;
+
+static unsigned long emu_env_ulong(const char *name, unsigned long def)
+{
+    const char *val = getenv(name);
+    char *end;
+    unsigned long num;
+
+    if (val == NULL || *val == '\0')
+        return def;
+
+    errno = 0;
+    num = strtoul(val, &end, 0);
+    if (errno != 0 || *end != '\0') {
+        fprintf(stderr, "ep11emu: ignoring invalid value '%s' of %s\n",
+                val, name);
+        return def;
+    }
+
+    return num;
+}
+
+/* Must be called with the write lock held */
+static struct emu_apqn *emu_apqn_add(uint32_t adapter, uint32_t domain)
+{
+    struct emu_apqn **tmp, *apqn;
+    unsigned int i;
+
+    for (i = 0; i < emu_num_apqns; i++) {
+        if (emu_apqns[i]->adapter == adapter &&
+            emu_apqns[i]->domain == domain)
+            return emu_apqns[i];
+    }
+
+    apqn = calloc(1, sizeof(*apqn));
+    if (apqn == NULL)
+        return NULL;
+
+    tmp = realloc(emu_apqns, (emu_num_apqns + 1) * sizeof(*tmp));
+    if (tmp == NULL) {
+        free(apqn);
+        return NULL;
+    }
+    emu_apqns = tmp;
+
+    apqn->adapter = adapter;
+    apqn->domain = domain;
+    apqn->latency_us = -1;
+    pthread_mutex_init(&apqn->mutex, NULL);
+    pthread_cond_init(&apqn->cond, NULL);
+    emu_apqns[emu_num_apqns++] = apqn;
+
+    return apqn;
+}
+
+/*
+ * EP11EMU_APQNS is a list of APQNs in the form "AA.DDDD[:LATENCY]", separated
+ * by commas or blanks. Adapter and domain are hexadecimal as in lszcrypt, the
+ * optional latency in microseconds overrides EP11EMU_LATENCY_US for the APQN.
+ */
+static void emu_parse_apqns(const char *list)
+{
+    char *copy, *tok, *save = NULL;
+    unsigned int adapter, domain;
+    struct emu_apqn *apqn;
+    unsigned long latency;
+    int n;
+
+    copy = strdup(list);
+    if (copy == NULL)
+        return;
+
+    for (tok = strtok_r(copy, ", \t", &save); tok != NULL;
+         tok = strtok_r(NULL, ", \t", &save)) {
+        n = sscanf(tok, "%x.%x:%lu", &adapter, &domain, &latency);
+        if (n < 2 || adapter > 0xff || domain >= XCP_DOMAINS) {
+            fprintf(stderr, "ep11emu: ignoring invalid APQN '%s'\n", tok);
+            continue;
+        }
+        apqn = emu_apqn_add(adapter, domain);
+        if (apqn != NULL && n == 3)
+            apqn->latency_us = latency;
+    }
+
+    free(copy);
+}
+
+static void emu_do_init(void)
+{
+    const char *val;
+
+    emu_cfg.latency_us = emu_env_ulong("EP11EMU_LATENCY_US", 0);
+    emu_cfg.latency_per_kb_us = emu_env_ulong("EP11EMU_LATENCY_PER_KB_US", 0);
+    emu_cfg.queue_depth = emu_env_ulong("EP11EMU_QUEUE_DEPTH",
+                                        EMU_DEFAULT_QUEUE_DEPTH);
+    if (emu_cfg.queue_depth == 0)
+        emu_cfg.queue_depth = 1;
+
+    val = getenv("EP11EMU_WK_SEED");
+    emu_wk_derive(&emu_cfg.cur_wk, val != NULL ? val : EMU_DEFAULT_WK_SEED);
+    val = getenv("EP11EMU_NEW_WK_SEED");
+    if (val != NULL && *val != '\0')
+        emu_wk_derive(&emu_cfg.next_wk, val);
+
+    pthread_rwlock_wrlock(&emu_lock);
+    val = getenv("EP11EMU_APQNS");
+    if (val != NULL)
+        emu_parse_apqns(val);
+    if (emu_num_apqns == 0)
+        emu_apqn_add(0, 0);
+    pthread_rwlock_unlock(&emu_lock);
+}
+
+void emu_init_once(void)
+{
+    pthread_once(&emu_once, emu_do_init);
+}
+
+static struct emu_target *emu_target_get(target_t target)
+{
+    uint64_t idx = target >> EMU_TARGET_SHIFT;
+
+    if (idx == 0 || idx > emu_num_targets)
+        return NULL;
+
+    return emu_targets[idx - 1];
+}
+
+/*
+ * Selects the APQN to run a request on. Groups (and the default target 0)
+ * distribute their requests round-robin over their APQNs, an empty group
+ * (APQN_ANY) uses all known APQNs.
+ */
+static struct emu_apqn *emu_select_apqn(target_t target)
+{
+    struct emu_target *tgt = NULL;
+    struct emu_apqn *apqn = NULL;
+    unsigned long n;
+
+    pthread_rwlock_rdlock(&emu_lock);
+
+    if ((target >> EMU_TARGET_SHIFT) != 0) {
+        tgt = emu_target_get(target);
+        if (tgt == NULL)
+            goto out;
+    }
+
+    if (tgt != NULL && tgt->num_apqns > 0) {
+        n = __sync_fetch_and_add(&tgt->next, 1);
+        apqn = tgt->apqns[n % tgt->num_apqns];
+    } else if (emu_num_apqns > 0) {
+        n = __sync_fetch_and_add(&emu_next_apqn, 1);
+        apqn = emu_apqns[n % emu_num_apqns];
+    }
+
+out:
+    pthread_rwlock_unlock(&emu_lock);
+    return apqn;
+}
+
+static void emu_sleep_us(unsigned long us)
+{
+    struct timespec ts;
+
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+CK_RV emu_req_begin(target_t target, size_t datalen, struct emu_apqn **apqn)
+{
+    unsigned long latency;
+
+    emu_init_once();
+
+    *apqn = emu_select_apqn(target);
+    if (*apqn == NULL)
+        return CKR_DEVICE_ERROR;
+
+    pthread_mutex_lock(&(*apqn)->mutex);
+    while ((*apqn)->inflight >= emu_cfg.queue_depth)
+        pthread_cond_wait(&(*apqn)->cond, &(*apqn)->mutex);
+    (*apqn)->inflight++;
+    (*apqn)->requests++;
+    pthread_mutex_unlock(&(*apqn)->mutex);
+
+    latency = (*apqn)->latency_us >= 0 ? (unsigned long)(*apqn)->latency_us
+                                       : emu_cfg.latency_us;
+    latency += (emu_cfg.latency_per_kb_us * datalen) / 1024;
+    if (latency > 0)
+        emu_sleep_us(latency);
+
+    return CKR_OK;
+}
+
+void emu_req_end(struct emu_apqn *apqn)
+{
+    pthread_mutex_lock(&apqn->mutex);
+    apqn->inflight--;
+    pthread_cond_signal(&apqn->cond);
+    pthread_mutex_unlock(&apqn->mutex);
+}
+
+/*
+ * Library setup and targets
+ */
+
+int m_init(void)
+{
+    emu_init_once();
+    return XCP_OK;
+}
+
+int m_shutdown(void)
+{
+    return XCP_OK;
+}
+
+int m_add_backend(const char *name, unsigned int port)
+{
+    (void)name;
+    (void)port;
+
+    emu_init_once();
+    return XCP_OK;
+}
+
+int m_add_module(XCP_Module_t module, target_t *target)
+{
+    struct emu_target *tgt, **tmp;
+    struct emu_apqn *apqn, **apqns;
+    unsigned int domain;
+    int rc = XCP_OK;
+
+    if (module == NULL || target == NULL || module->version == 0)
+        return XCP_EARG;
+
+    emu_init_once();
+
+    pthread_rwlock_wrlock(&emu_lock);
+
+    if (*target == XCP_TGT_INIT) {
+        tgt = calloc(1, sizeof(*tgt));
+        if (tgt == NULL) {
+            rc = XCP_EMEMORY;
+            goto out;
+        }
+        tmp = realloc(emu_targets, (emu_num_targets + 1) * sizeof(*tmp));
+        if (tmp == NULL) {
+            free(tgt);
+            rc = XCP_EMEMORY;
+            goto out;
+        }
+        emu_targets = tmp;
+        emu_targets[emu_num_targets++] = tgt;
+        *target = (target_t)emu_num_targets << EMU_TARGET_SHIFT;
+    } else {
+        tgt = emu_target_get(*target);
+        if (tgt == NULL) {
+            rc = XCP_ETARGET;
+            goto out;
+        }
+    }
+
+    if ((module->flags & XCP_MFL_MODULE) == 0)
+        goto out;
+
+    for (domain = 0; domain < XCP_DOMAINS; domain++) {
+        if (!XCPTGTMASK_DOM_IS_SET(module->domainmask, domain))
+            continue;
+
+        apqn = emu_apqn_add(module->module_nr, domain);
+        if (apqn == NULL) {
+            rc = XCP_EMEMORY;
+            goto out;
+        }
+
+        apqns = realloc(tgt->apqns, (tgt->num_apqns + 1) * sizeof(*apqns));
+        if (apqns == NULL) {
+            rc = XCP_EMEMORY;
+            goto out;
+        }
+        tgt->apqns = apqns;
+        tgt->apqns[tgt->num_apqns++] = apqn;
+    }
+
+out:
+    pthread_rwlock_unlock(&emu_lock);
+    return rc;
+}
+
+int m_rm_module(XCP_Module_t module, target_t target)
+{
+    struct emu_target *tgt;
+    uint64_t idx = target >> EMU_TARGET_SHIFT;
+    unsigned int i;
+
+    pthread_rwlock_wrlock(&emu_lock);
+
+    tgt = emu_target_get(target);
+    if (tgt == NULL) {
+        pthread_rwlock_unlock(&emu_lock);
+        return XCP_ETARGET;
+    }
+
+    if (module == NULL) {
+        /* Slots of removed targets are not reused, handles stay unique */
+        free(tgt->apqns);
+        free(tgt);
+        emu_targets[idx - 1] = NULL;
+    } else {
+        for (i = 0; i < tgt->num_apqns; i++) {
+            if (tgt->apqns[i]->adapter == module->module_nr &&
+                XCPTGTMASK_DOM_IS_SET(module->domainmask,
+                                      tgt->apqns[i]->domain)) {
+                tgt->apqns[i] = tgt->apqns[--tgt->num_apqns];
+                i--;
+            }
+        }
+    }
+
+    pthread_rwlock_unlock(&emu_lock);
+    return XCP_OK;
+}
+
+/*
+ * Module queries
+ */
+
+static CK_RV emu_copy_info(CK_VOID_PTR pinfo, CK_ULONG_PTR infbytes,
+                           const void *data, CK_ULONG len)
+{
+    if (pinfo == NULL) {
+        *infbytes = len;
+        return CKR_OK;
+    }
+    if (*infbytes < len) {
+        *infbytes = len;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(pinfo, data, len);
+    *infbytes = len;
+    return CKR_OK;
+}
+
+static CK_RV emu_query(CK_VOID_PTR pinfo, CK_ULONG_PTR infbytes,
+                       unsigned int query, unsigned int subquery,
+                       const struct emu_apqn *apqn)
+{
+    CK_IBM_XCP_INFO info;
+    CK_IBM_DOMAIN_INFO dom;
+    unsigned char fnlist[(__FNID_MAX + 8) / 8];
+    uint32_t caps[4];
+    unsigned char pqc[16];
+    char serial[sizeof(info.serialNumber) + 1];
+    unsigned int i;
+
+    switch (query) {
+    case CK_IBM_XCPQ_MODULE:
+        if (subquery == CK_IBM_XCPMSQ_FNLIST) {
+            memset(fnlist, 0, sizeof(fnlist));
+            for (i = 0; i <= __FNID_MAX; i++)
+                fnlist[i / 8] |= 0x80 >> (i % 8);
+            return emu_copy_info(pinfo, infbytes, fnlist, sizeof(fnlist));
+        }
+        if (subquery != 0)
+            return CKR_ARGUMENTS_BAD;
+
+        memset(&info, 0, sizeof(info));
+        info.firmwareApi = EMU_FIRMWARE_API;
+        info.firmwareVersion.major = 7;
+        info.firmwareVersion.minor = 21;
+        info.cspVersion.major = 7;
+        snprintf(serial, sizeof(serial), "EMU%02X%04X",
+                 apqn->adapter & 0xff, apqn->domain & 0xffff);
+        memset(info.serialNumber, ' ', sizeof(info.serialNumber));
+        memcpy(info.serialNumber, serial, strlen(serial));
+        info.domains = XCP_DOMAINS;
+        info.symmStateBytes = EMU_MAX_BLOBSIZE;
+        info.digestStateBytes = EMU_MAX_BLOBSIZE;
+        info.pinBlockBytes = XCP_PINBLOB_BYTES;
+        info.symmKeyBytes = EMU_MAX_BLOBSIZE;
+        info.spkiBytes = EMU_MAX_BLOBSIZE;
+        info.prvkeyBytes = EMU_MAX_BLOBSIZE;
+        info.maxPayloadBytes = 1024 * 1024;
+        info.controlPoints = XCP_CPBITS_MAX + 1;
+        return emu_copy_info(pinfo, infbytes, &info, sizeof(info));
+
+    case CK_IBM_XCPQ_DOMAIN:
+        memset(&dom, 0, sizeof(dom));
+        dom.domain = apqn->domain;
+        memcpy(dom.wk, emu_cfg.cur_wk.wkvp, sizeof(dom.wk));
+        dom.flags = CK_IBM_DOM_ADMIND | CK_IBM_DOM_CURR_WK;
+        if (emu_cfg.next_wk.set) {
+            memcpy(dom.nextwk, emu_cfg.next_wk.wkvp, sizeof(dom.nextwk));
+            dom.flags |= CK_IBM_DOM_NEXT_WK | CK_IBM_DOM_COMMITTED_NWK;
+        }
+        return emu_copy_info(pinfo, infbytes, &dom, sizeof(dom));
+
+    case CK_IBM_XCPQ_EXT_CAPS:
+        caps[0] = 2;
+        return emu_copy_info(pinfo, infbytes, caps, sizeof(caps[0]));
+
+    case CK_IBM_XCPQ_EXT_CAPLIST:
+        caps[0] = CK_IBM_XCPXQ_LOGIN_ALG;
+        caps[1] = 0x80000000 >> XCP_LOGIN_ALG_F2021;
+        caps[2] = CK_IBM_XCPXQ_LOGIN_KEYTYPES;
+        caps[3] = 0x80000000 >> XCP_LOGIN_IMPR_EC_P521;
+        return emu_copy_info(pinfo, infbytes, caps, sizeof(caps));
+
+    case CK_IBM_XCPQ_PQC_STRENGTHS:
+        /* No PQC algorithms are emulated */
+        memset(pqc, 0, sizeof(pqc));
+        return emu_copy_info(pinfo, infbytes, pqc,
+                             *infbytes < sizeof(pqc) ? *infbytes
+                                                     : sizeof(pqc));
+
+    default:
+        return CKR_ARGUMENTS_BAD;
+    }
+}
+
+CK_RV m_get_xcp_info(CK_VOID_PTR pinfo, CK_ULONG_PTR infbytes,
+                     unsigned int query, unsigned int subquery,
+                     target_t target)
+{
+    unsigned int version = EMU_HOST_VERSION;
+    struct emu_apqn *apqn;
+    CK_RV rc;
+
+    if (infbytes == NULL)
+        return CKR_ARGUMENTS_BAD;
+
+    /* Host queries are answered by the library itself */
+    if (query == CK_IBM_XCPHQ_VERSION)
+        return emu_copy_info(pinfo, infbytes, &version, sizeof(version));
+
+    rc = emu_req_begin(target, 0, &apqn);
+    if (rc != CKR_OK)
+        return rc;
+    rc = emu_query(pinfo, infbytes, query, subquery, apqn);
+    emu_req_end(apqn);
+
+    return rc;
+}
+
+/*
+ * Administrative requests. The emulator uses its own simple block format:
+ *   request:  magic, function, domain, payload length, payload
+ *   response: magic, function, return value, reason, payload length, payload
+ * all numbers being 32 bit in host byte order.
+ */
+
+#define EMU_ADM_REQ_HDR     (4 * sizeof(uint32_t))
+#define EMU_ADM_RSP_HDR     (5 * sizeof(uint32_t))
+
+static long emu_adm_block(unsigned char *blk, size_t blen, unsigned int fn,
+                          uint32_t domain, const unsigned char *payload,
+                          size_t plen)
+{
+    uint32_t hdr[4] = { EMU_ADM_MAGIC, fn, domain, (uint32_t)plen };
+
+    if (blk == NULL)
+        return EMU_ADM_REQ_HDR + plen;
+    if (blen < EMU_ADM_REQ_HDR + plen)
+        return XCP_ESIZE;
+
+    memcpy(blk, hdr, sizeof(hdr));
+    if (plen > 0)
+        memcpy(blk + EMU_ADM_REQ_HDR, payload, plen);
+
+    return EMU_ADM_REQ_HDR + plen;
+}
+
+long xcpa_cmdblock(unsigned char *blk, size_t blen, unsigned int fn,
+                   const struct XCPadmresp *minf, const unsigned char *tctr,
+                   const unsigned char *payload, size_t plen)
+{
+    (void)tctr;
+
+    return emu_adm_block(blk, blen, fn, minf != NULL ? minf->domain : 0,
+                         payload, plen);
+}
+
+long xcpa_queryblock(unsigned char *blk, size_t blen, unsigned int fn,
+                     uint64_t domain, const unsigned char *payload,
+                     size_t plen)
+{
+    /* domain is (adapter << 32 | domain) */
+    return emu_adm_block(blk, blen, fn, (uint32_t)domain, payload, plen);
+}
+
+long xcpa_internal_rv(const unsigned char *rsp, size_t rlen,
+                      struct XCPadmresp *rb, CK_RV *rv)
+{
+    uint32_t hdr[5];
+
+    if (rsp == NULL || rb == NULL || rlen < EMU_ADM_RSP_HDR)
+        return XCP_EARG;
+
+    memcpy(hdr, rsp, sizeof(hdr));
+    if (hdr[0] != EMU_ADM_MAGIC || rlen < EMU_ADM_RSP_HDR + hdr[4])
+        return XCP_ERESPONSE;
+
+    rb->fn = hdr[1];
+    rb->rv = hdr[2];
+    rb->reason = hdr[3];
+    rb->payload = hdr[4] > 0 ? rsp + EMU_ADM_RSP_HDR : NULL;
+    rb->pllen = hdr[4];
+    if (rv != NULL)
+        *rv = hdr[2];
+
+    return EMU_ADM_RSP_HDR + hdr[4];
+}
+
+static CK_RV emu_admin(unsigned char *rsp, size_t *rlen,
+                       const unsigned char *cmd, size_t clen)
+{
+    uint32_t req[4], hdr[5];
+    unsigned char *payload;
+    size_t plen, maxlen;
+    unsigned int i;
+    CK_RV rv = CKR_OK;
+
+    if (cmd == NULL || clen < EMU_ADM_REQ_HDR || rsp == NULL || rlen == NULL)
+        return CKR_ARGUMENTS_BAD;
+
+    memcpy(req, cmd, sizeof(req));
+    if (req[0] != EMU_ADM_MAGIC || clen < EMU_ADM_REQ_HDR + req[3])
+        return CKR_ARGUMENTS_BAD;
+    if (*rlen < EMU_ADM_RSP_HDR)
+        return CKR_BUFFER_TOO_SMALL;
+
+    payload = rsp + EMU_ADM_RSP_HDR;
+    maxlen = *rlen - EMU_ADM_RSP_HDR;
+    plen = 0;
+
+    switch (req[1]) {
+    case XCP_ADMQ_DOM_CTRLPOINTS:
+        /* All control points are set, i.e. everything is allowed */
+        if (maxlen < XCP_CP_BYTES)
+            return CKR_BUFFER_TOO_SMALL;
+        memset(payload, 0, XCP_CP_BYTES);
+        for (i = 0; i <= XCP_CPBITS_MAX; i++)
+            payload[i / 8] |= 0x80 >> (i % 8);
+        plen = XCP_CP_BYTES;
+        break;
+    case XCP_ADM_REENCRYPT:
+        plen = maxlen;
+        rv = emu_blob_reencrypt(cmd + EMU_ADM_REQ_HDR, req[3], payload, &plen);
+        if (rv != CKR_OK)
+            plen = 0;
+        break;
+    default:
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+        break;
+    }
+
+    hdr[0] = EMU_ADM_MAGIC;
+    hdr[1] = req[1];
+    hdr[2] = rv;
+    hdr[3] = 0;
+    hdr[4] = plen;
+    memcpy(rsp, hdr, sizeof(hdr));
+    *rlen = EMU_ADM_RSP_HDR + plen;
+
+    return CKR_OK;
+}
+
+CK_RV m_admin(unsigned char *response1, size_t *r1len,
+              unsigned char *response2, size_t *r2len,
+              const unsigned char *cmd, size_t clen,
+              const unsigned char *sigs, size_t slen, target_t target)
+{
+    (void)sigs;
+    (void)slen;
+
+    if (r2len != NULL)
+        *r2len = 0;
+    (void)response2;
+
+    EMU_REQUEST(target, clen, emu_admin(response1, r1len, cmd, clen));
+}
+
+/*
+ * Logins: the PIN blob is the session identifier derived from PIN and nonce,
+ * followed by a salt and a MAC. Sessions are not tracked, keys bound to a
+ * session can be used as long as their blob verifies.
+ */
+
+static CK_RV emu_login(CK_UTF8CHAR_PTR pin, CK_ULONG pinlen,
+                       const unsigned char *nonce, size_t nlen,
+                       unsigned char *pinblob, size_t *pinbloblen)
+{
+    unsigned char blob[XCP_PINBLOB_BYTES];
+    unsigned int maclen = EMU_MAC_BYTES;
+    EVP_MD_CTX *md;
+
+    if (pinbloblen == NULL)
+        return CKR_ARGUMENTS_BAD;
+    if (pinblob == NULL) {
+        *pinbloblen = sizeof(blob);
+        return CKR_OK;
+    }
+    if (*pinbloblen < sizeof(blob)) {
+        *pinbloblen = sizeof(blob);
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    md = EVP_MD_CTX_new();
+    if (md == NULL)
+        return CKR_HOST_MEMORY;
+
+    memset(blob, 0, sizeof(blob));
+    if (EVP_DigestInit_ex(md, EVP_sha256(), NULL) != 1 ||
+        EVP_DigestUpdate(md, "ep11emu-session", 15) != 1 ||
+        (pin != NULL && EVP_DigestUpdate(md, pin, pinlen) != 1) ||
+        (nonce != NULL && EVP_DigestUpdate(md, nonce, nlen) != 1) ||
+        EVP_DigestFinal_ex(md, blob, NULL) != 1) {
+        EVP_MD_CTX_free(md);
+        return CKR_FUNCTION_FAILED;
+    }
+    EVP_MD_CTX_free(md);
+    /* Session identifiers never start with 0x30, see check_expected_mkvp */
+    if (blob[0] == 0x30)
+        blob[0] ^= 0x80;
+
+    HMAC(EVP_sha256(), emu_cfg.cur_wk.mac_key, sizeof(emu_cfg.cur_wk.mac_key),
+         blob, EMU_SESSION_BYTES + XCP_PIN_SALT_BYTES,
+         blob + EMU_SESSION_BYTES + XCP_PIN_SALT_BYTES, &maclen);
+
+    memcpy(pinblob, blob, sizeof(blob));
+    *pinbloblen = sizeof(blob);
+    return CKR_OK;
+}
+
+CK_RV m_Login(CK_UTF8CHAR_PTR pin, CK_ULONG pinlen,
+              const unsigned char *nonce, size_t nlen,
+              unsigned char *pinblob, size_t *pinbloblen, target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_login(pin, pinlen, nonce, nlen, pinblob, pinbloblen));
+}
+
+CK_RV m_Logout(const unsigned char *pin, size_t len, target_t target)
+{
+    (void)pin;
+    (void)len;
+
+    EMU_REQUEST(target, 0, CKR_OK);
+}
+
+CK_RV m_LoginExtended(CK_UTF8CHAR_PTR pin, CK_ULONG pinlen,
+                      const unsigned char *nonce, size_t nlen,
+                      const unsigned char *xstruct, size_t xslen,
+                      unsigned char *pinblob, size_t *pinbloblen,
+                      target_t target)
+{
+    (void)xstruct;
+    (void)xslen;
+
+    EMU_REQUEST(target, 0,
+                emu_login(pin, pinlen, nonce, nlen, pinblob, pinbloblen));
+}
+
+CK_RV m_LogoutExtended(CK_UTF8CHAR_PTR pin, CK_ULONG pinlen,
+                       const unsigned char *nonce, size_t nlen,
+                       const unsigned char *xstruct, size_t xslen,
+                       target_t target)
+{
+    (void)pin;
+    (void)pinlen;
+    (void)nonce;
+    (void)nlen;
+    (void)xstruct;
+    (void)xslen;
+
+    EMU_REQUEST(target, 0, CKR_OK);
+}
+
+/*
+ * Mechanisms
+ */
+
+#define EMU_EC_FLAGS    (CKF_EC_F_P | CKF_EC_OID | CKF_EC_UNCOMPRESS)
+#define EMU_HMAC_FLAGS  (CKF_HW | CKF_SIGN | CKF_VERIFY)
+#define EMU_AES_FLAGS   (CKF_HW | CKF_ENCRYPT | CKF_DECRYPT | CKF_WRAP | \
+                         CKF_UNWRAP)
+
+static const struct {
+    CK_MECHANISM_TYPE mech;
+    CK_MECHANISM_INFO info;
+} emu_mechs[] = {
+    { CKM_AES_KEY_GEN, { 16, 32, CKF_HW | CKF_GENERATE } },
+    { CKM_AES_ECB, { 16, 32, EMU_AES_FLAGS } },
+    { CKM_AES_CBC, { 16, 32, EMU_AES_FLAGS } },
+    { CKM_AES_CBC_PAD, { 16, 32, EMU_AES_FLAGS } },
+    { CKM_GENERIC_SECRET_KEY_GEN, { 80, 2048, CKF_HW | CKF_GENERATE } },
+    { CKM_SHA_1, { 0, 0, CKF_HW | CKF_DIGEST } },
+    { CKM_SHA224, { 0, 0, CKF_HW | CKF_DIGEST } },
+    { CKM_SHA256, { 0, 0, CKF_HW | CKF_DIGEST } },
+    { CKM_SHA384, { 0, 0, CKF_HW | CKF_DIGEST } },
+    { CKM_SHA512, { 0, 0, CKF_HW | CKF_DIGEST } },
+    { CKM_SHA_1_HMAC, { 8, 2048, EMU_HMAC_FLAGS } },
+    { CKM_SHA224_HMAC, { 8, 2048, EMU_HMAC_FLAGS } },
+    { CKM_SHA256_HMAC, { 8, 2048, EMU_HMAC_FLAGS } },
+    { CKM_SHA384_HMAC, { 8, 2048, EMU_HMAC_FLAGS } },
+    { CKM_SHA512_HMAC, { 8, 2048, EMU_HMAC_FLAGS } },
+    { CKM_RSA_PKCS_KEY_PAIR_GEN, { 512, 4096,
+                                   CKF_HW | CKF_GENERATE_KEY_PAIR } },
+    { CKM_RSA_PKCS, { 512, 4096, CKF_HW | CKF_ENCRYPT | CKF_DECRYPT |
+                                 CKF_SIGN | CKF_VERIFY | CKF_WRAP |
+                                 CKF_UNWRAP } },
+    { CKM_SHA1_RSA_PKCS, { 512, 4096, CKF_HW | CKF_SIGN | CKF_VERIFY } },
+    { CKM_SHA224_RSA_PKCS, { 512, 4096, CKF_HW | CKF_SIGN | CKF_VERIFY } },
+    { CKM_SHA256_RSA_PKCS, { 512, 4096, CKF_HW | CKF_SIGN | CKF_VERIFY } },
+    { CKM_SHA384_RSA_PKCS, { 512, 4096, CKF_HW | CKF_SIGN | CKF_VERIFY } },
+    { CKM_SHA512_RSA_PKCS, { 512, 4096, CKF_HW | CKF_SIGN | CKF_VERIFY } },
+    { CKM_EC_KEY_PAIR_GEN, { 192, 521, CKF_HW | CKF_GENERATE_KEY_PAIR |
+                                       EMU_EC_FLAGS } },
+    { CKM_ECDSA, { 192, 521, CKF_HW | CKF_SIGN | CKF_VERIFY |
+                             EMU_EC_FLAGS } },
+    { CKM_ECDSA_SHA1, { 192, 521, CKF_HW | CKF_SIGN | CKF_VERIFY |
+                                  EMU_EC_FLAGS } },
+    { CKM_ECDSA_SHA224, { 192, 521, CKF_HW | CKF_SIGN | CKF_VERIFY |
+                                    EMU_EC_FLAGS } },
+    { CKM_ECDSA_SHA256, { 192, 521, CKF_HW | CKF_SIGN | CKF_VERIFY |
+                                    EMU_EC_FLAGS } },
+    { CKM_ECDSA_SHA384, { 192, 521, CKF_HW | CKF_SIGN | CKF_VERIFY |
+                                    EMU_EC_FLAGS } },
+    { CKM_ECDSA_SHA512, { 192, 521, CKF_HW | CKF_SIGN | CKF_VERIFY |
+                                    EMU_EC_FLAGS } },
+};
+
+#define EMU_NUM_MECHS   (sizeof(emu_mechs) / sizeof(emu_mechs[0]))
+
+static CK_RV emu_mechanism_list(CK_MECHANISM_TYPE_PTR mechs,
+                                CK_ULONG_PTR count)
+{
+    CK_ULONG i;
+
+    if (count == NULL)
+        return CKR_ARGUMENTS_BAD;
+    if (mechs == NULL) {
+        *count = EMU_NUM_MECHS;
+        return CKR_OK;
+    }
+    if (*count < EMU_NUM_MECHS) {
+        *count = EMU_NUM_MECHS;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    for (i = 0; i < EMU_NUM_MECHS; i++)
+        mechs[i] = emu_mechs[i].mech;
+    *count = EMU_NUM_MECHS;
+
+    return CKR_OK;
+}
+
+static CK_RV emu_mechanism_info(CK_MECHANISM_TYPE mech,
+                                CK_MECHANISM_INFO_PTR info)
+{
+    CK_ULONG i;
+
+    if (info == NULL)
+        return CKR_ARGUMENTS_BAD;
+
+    for (i = 0; i < EMU_NUM_MECHS; i++) {
+        if (emu_mechs[i].mech == mech) {
+            *info = emu_mechs[i].info;
+            return CKR_OK;
+        }
+    }
+
+    return CKR_MECHANISM_INVALID;
+}
+
+CK_RV m_GetMechanismList(CK_SLOT_ID slot, CK_MECHANISM_TYPE_PTR mechs,
+                         CK_ULONG_PTR count, target_t target)
+{
+    (void)slot;
+
+    EMU_REQUEST(target, 0, emu_mechanism_list(mechs, count));
+}
+
+CK_RV m_GetMechanismInfo(CK_SLOT_ID slot, CK_MECHANISM_TYPE mech,
+                         CK_MECHANISM_INFO_PTR pmechinfo, target_t target)
+{
+    (void)slot;
+
+    EMU_REQUEST(target, 0, emu_mechanism_info(mech, pmechinfo));
+}
+
+/*
+ * Random numbers
+ */
+
+static CK_RV emu_random(CK_BYTE_PTR rnd, CK_ULONG len)
+{
+    if (rnd == NULL && len > 0)
+        return CKR_ARGUMENTS_BAD;
+
+    return RAND_bytes(rnd, len) == 1 ? CKR_OK : CKR_FUNCTION_FAILED;
+}
+
+CK_RV m_GenerateRandom(CK_BYTE_PTR rnd, CK_ULONG len, target_t target)
+{
+    EMU_REQUEST(target, len, emu_random(rnd, len));
+}
+
+CK_RV m_SeedRandom(CK_BYTE_PTR pSeed, CK_ULONG ulSeedLen, target_t target)
+{
+    if (pSeed != NULL)
+        RAND_seed(pSeed, ulSeedLen);
+
+    EMU_REQUEST(target, ulSeedLen, CKR_OK);
+}
+
+/*
+ * Digest
+ */
+
+CK_RV m_DigestInit(unsigned char *state, size_t *len,
+                   const CK_MECHANISM_PTR pmech, target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_op_init(EMU_OP_DIGEST, state, len, pmech, NULL, 0));
+}
+
+CK_RV m_Digest(const unsigned char *state, size_t slen,
+               CK_BYTE_PTR data, CK_ULONG len,
+               CK_BYTE_PTR digest, CK_ULONG_PTR dglen, target_t target)
+{
+    EMU_REQUEST(target, len,
+                emu_op_single(EMU_OP_DIGEST, state, slen, data, len,
+                              digest, dglen));
+}
+
+CK_RV m_DigestUpdate(unsigned char *state, size_t slen,
+                     CK_BYTE_PTR data, CK_ULONG dlen, target_t target)
+{
+    EMU_REQUEST(target, dlen,
+                emu_op_update(EMU_OP_DIGEST, state, slen, data, dlen,
+                              NULL, NULL));
+}
+
+CK_RV m_DigestKey(unsigned char *state, size_t slen,
+                  const unsigned char *key, size_t klen, target_t target)
+{
+    EMU_REQUEST(target, 0, emu_op_digest_key(state, slen, key, klen));
+}
+
+CK_RV m_DigestFinal(const unsigned char *state, size_t slen,
+                    CK_BYTE_PTR digest, CK_ULONG_PTR dlen, target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_op_final(EMU_OP_DIGEST, state, slen, digest, dlen));
+}
+
+CK_RV m_DigestSingle(CK_MECHANISM_PTR pmech, CK_BYTE_PTR data, CK_ULONG len,
+                     CK_BYTE_PTR digest, CK_ULONG_PTR dlen, target_t target)
+{
+    EMU_REQUEST(target, len,
+                emu_digest_oneshot(pmech, data, len, digest, dlen));
+}
+
+/*
+ * Encrypt and decrypt
+ */
+
+CK_RV m_EncryptInit(unsigned char *state, size_t *slen,
+                    CK_MECHANISM_PTR pmech, const unsigned char *key,
+                    size_t klen, target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_op_init(EMU_OP_ENCRYPT, state, slen, pmech, key, klen));
+}
+
+CK_RV m_DecryptInit(unsigned char *state, size_t *slen,
+                    CK_MECHANISM_PTR pmech, const unsigned char *key,
+                    size_t klen, target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_op_init(EMU_OP_DECRYPT, state, slen, pmech, key, klen));
+}
+
+CK_RV m_EncryptUpdate(unsigned char *state, size_t slen,
+                      CK_BYTE_PTR plain, CK_ULONG plen,
+                      CK_BYTE_PTR cipher, CK_ULONG_PTR clen, target_t target)
+{
+    EMU_REQUEST(target, plen,
+                emu_op_update(EMU_OP_ENCRYPT, state, slen, plain, plen,
+                              cipher, clen));
+}
+
+CK_RV m_DecryptUpdate(unsigned char *state, size_t slen,
+                      CK_BYTE_PTR cipher, CK_ULONG clen,
+                      CK_BYTE_PTR plain, CK_ULONG_PTR plen, target_t target)
+{
+    EMU_REQUEST(target, clen,
+                emu_op_update(EMU_OP_DECRYPT, state, slen, cipher, clen,
+                              plain, plen));
+}
+
+CK_RV m_Encrypt(const unsigned char *state, size_t slen,
+                CK_BYTE_PTR plain, CK_ULONG plen,
+                CK_BYTE_PTR cipher, CK_ULONG_PTR clen, target_t target)
+{
+    EMU_REQUEST(target, plen,
+                emu_op_single(EMU_OP_ENCRYPT, state, slen, plain, plen,
+                              cipher, clen));
+}
+
+CK_RV m_Decrypt(const unsigned char *state, size_t slen,
+                CK_BYTE_PTR cipher, CK_ULONG clen,
+                CK_BYTE_PTR plain, CK_ULONG_PTR plen, target_t target)
+{
+    EMU_REQUEST(target, clen,
+                emu_op_single(EMU_OP_DECRYPT, state, slen, cipher, clen,
+                              plain, plen));
+}
+
+CK_RV m_EncryptFinal(const unsigned char *state, size_t slen,
+                     CK_BYTE_PTR output, CK_ULONG_PTR len, target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_op_final(EMU_OP_ENCRYPT, state, slen, output, len));
+}
+
+CK_RV m_DecryptFinal(const unsigned char *state, size_t slen,
+                     CK_BYTE_PTR output, CK_ULONG_PTR len, target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_op_final(EMU_OP_DECRYPT, state, slen, output, len));
+}
+
+CK_RV m_EncryptSingle(const unsigned char *key, size_t klen,
+                      CK_MECHANISM_PTR mech, CK_BYTE_PTR plain, CK_ULONG plen,
+                      CK_BYTE_PTR cipher, CK_ULONG_PTR clen, target_t target)
+{
+    EMU_REQUEST(target, plen,
+                emu_key_oneshot(EMU_OP_ENCRYPT, mech, key, klen, plain, plen,
+                                cipher, clen));
+}
+
+CK_RV m_DecryptSingle(const unsigned char *key, size_t klen,
+                      CK_MECHANISM_PTR mech, CK_BYTE_PTR cipher, CK_ULONG clen,
+                      CK_BYTE_PTR plain, CK_ULONG_PTR plen, target_t target)
+{
+    EMU_REQUEST(target, clen,
+                emu_key_oneshot(EMU_OP_DECRYPT, mech, key, klen, cipher, clen,
+                                plain, plen));
+}
+
+static CK_RV emu_reencrypt_single(const unsigned char *dkey, size_t dklen,
+                                  const unsigned char *ekey, size_t eklen,
+                                  CK_MECHANISM_PTR pdecrmech,
+                                  CK_MECHANISM_PTR pencrmech,
+                                  CK_BYTE_PTR in, CK_ULONG ilen,
+                                  CK_BYTE_PTR out, CK_ULONG_PTR olen)
+{
+    unsigned char *clear;
+    CK_ULONG clear_len = ilen;
+    CK_RV rc;
+
+    clear = malloc(ilen > 0 ? ilen : 1);
+    if (clear == NULL)
+        return CKR_HOST_MEMORY;
+
+    rc = emu_key_oneshot(EMU_OP_DECRYPT, pdecrmech, dkey, dklen, in, ilen,
+                         clear, &clear_len);
+    if (rc == CKR_OK)
+        rc = emu_key_oneshot(EMU_OP_ENCRYPT, pencrmech, ekey, eklen,
+                             clear, clear_len, out, olen);
+
+    OPENSSL_cleanse(clear, ilen);
+    free(clear);
+    return rc;
+}
+
+CK_RV m_ReencryptSingle(const unsigned char *dkey, size_t dklen,
+                        const unsigned char *ekey, size_t eklen,
+                        CK_MECHANISM_PTR pdecrmech, CK_MECHANISM_PTR pencrmech,
+                        CK_BYTE_PTR in, CK_ULONG ilen,
+                        CK_BYTE_PTR out, CK_ULONG_PTR olen, target_t target)
+{
+    EMU_REQUEST(target, ilen,
+                emu_reencrypt_single(dkey, dklen, ekey, eklen, pdecrmech,
+                                     pencrmech, in, ilen, out, olen));
+}
+
+/*
+ * Sign and verify
+ */
+
+CK_RV m_SignInit(unsigned char *state, size_t *slen, CK_MECHANISM_PTR alg,
+                 const unsigned char *key, size_t klen, target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_op_init(EMU_OP_SIGN, state, slen, alg, key, klen));
+}
+
+CK_RV m_VerifyInit(unsigned char *state, size_t *slen, CK_MECHANISM_PTR alg,
+                   const unsigned char *key, size_t klen, target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_op_init(EMU_OP_VERIFY, state, slen, alg, key, klen));
+}
+
+CK_RV m_SignUpdate(unsigned char *state, size_t slen,
+                   CK_BYTE_PTR data, CK_ULONG dlen, target_t target)
+{
+    EMU_REQUEST(target, dlen,
+                emu_op_update(EMU_OP_SIGN, state, slen, data, dlen,
+                              NULL, NULL));
+}
+
+CK_RV m_VerifyUpdate(unsigned char *state, size_t slen,
+                     CK_BYTE_PTR data, CK_ULONG dlen, target_t target)
+{
+    EMU_REQUEST(target, dlen,
+                emu_op_update(EMU_OP_VERIFY, state, slen, data, dlen,
+                              NULL, NULL));
+}
+
+CK_RV m_SignFinal(const unsigned char *state, size_t stlen,
+                  CK_BYTE_PTR sig, CK_ULONG_PTR siglen, target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_op_final(EMU_OP_SIGN, state, stlen, sig, siglen));
+}
+
+CK_RV m_VerifyFinal(const unsigned char *state, size_t stlen,
+                    CK_BYTE_PTR sig, CK_ULONG siglen, target_t target)
+{
+    EMU_REQUEST(target, 0, emu_op_verify_final(state, stlen, sig, siglen));
+}
+
+CK_RV m_Sign(const unsigned char *state, size_t stlen,
+             CK_BYTE_PTR data, CK_ULONG dlen,
+             CK_BYTE_PTR sig, CK_ULONG_PTR siglen, target_t target)
+{
+    EMU_REQUEST(target, dlen,
+                emu_op_single(EMU_OP_SIGN, state, stlen, data, dlen,
+                              sig, siglen));
+}
+
+CK_RV m_Verify(const unsigned char *state, size_t stlen,
+               CK_BYTE_PTR data, CK_ULONG dlen,
+               CK_BYTE_PTR sig, CK_ULONG siglen, target_t target)
+{
+    EMU_REQUEST(target, dlen,
+                emu_op_verify_single(state, stlen, data, dlen, sig, siglen));
+}
+
+CK_RV m_SignSingle(const unsigned char *key, size_t klen,
+                   CK_MECHANISM_PTR pmech, CK_BYTE_PTR data, CK_ULONG dlen,
+                   CK_BYTE_PTR sig, CK_ULONG_PTR slen, target_t target)
+{
+    EMU_REQUEST(target, dlen,
+                emu_key_oneshot(EMU_OP_SIGN, pmech, key, klen, data, dlen,
+                                sig, slen));
+}
+
+CK_RV m_VerifySingle(const unsigned char *key, size_t klen,
+                     CK_MECHANISM_PTR pmech, CK_BYTE_PTR data, CK_ULONG dlen,
+                     CK_BYTE_PTR sig, CK_ULONG slen, target_t target)
+{
+    EMU_REQUEST(target, dlen,
+                emu_verify_oneshot(pmech, key, klen, data, dlen, sig, slen));
+}
+
+/*
+ * Key management
+ */
+
+CK_RV m_GenerateKey(CK_MECHANISM_PTR pmech, CK_ATTRIBUTE_PTR ptempl,
+                    CK_ULONG templcount, const unsigned char *pin,
+                    size_t pinlen, unsigned char *key, size_t *klen,
+                    unsigned char *csum, size_t *clen, target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_generate_key(pmech, ptempl, templcount, pin, pinlen,
+                                 key, klen, csum, clen));
+}
+
+CK_RV m_GenerateKeyPair(CK_MECHANISM_PTR pmech,
+                        CK_ATTRIBUTE_PTR ppublic, CK_ULONG pubattrs,
+                        CK_ATTRIBUTE_PTR pprivate, CK_ULONG prvattrs,
+                        const unsigned char *pin, size_t pinlen,
+                        unsigned char *key, size_t *klen,
+                        unsigned char *pubkey, size_t *pklen, target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_generate_key_pair(pmech, ppublic, pubattrs, pprivate,
+                                      prvattrs, pin, pinlen, key, klen,
+                                      pubkey, pklen));
+}
+
+CK_RV m_WrapKey(const unsigned char *key, size_t keylen,
+                const unsigned char *kek, size_t keklen,
+                const unsigned char *mackey, size_t mklen,
+                const CK_MECHANISM_PTR pmech,
+                CK_BYTE_PTR wrapped, CK_ULONG_PTR wlen, target_t target)
+{
+    (void)mackey;
+    (void)mklen;
+
+    EMU_REQUEST(target, keylen,
+                emu_wrap_key(key, keylen, kek, keklen, pmech, wrapped, wlen));
+}
+
+CK_RV m_UnwrapKey(const CK_BYTE_PTR wrapped, CK_ULONG wlen,
+                  const unsigned char *kek, size_t keklen,
+                  const unsigned char *mackey, size_t mklen,
+                  const unsigned char *pin, size_t pinlen,
+                  const CK_MECHANISM_PTR uwmech,
+                  const CK_ATTRIBUTE_PTR ptempl, CK_ULONG pcount,
+                  unsigned char *unwrapped, size_t *uwlen,
+                  CK_BYTE_PTR csum, CK_ULONG *cslen, target_t target)
+{
+    (void)mackey;
+    (void)mklen;
+
+    EMU_REQUEST(target, wlen,
+                emu_unwrap_key(wrapped, wlen, kek, keklen, pin, pinlen,
+                               uwmech, ptempl, pcount, unwrapped, uwlen,
+                               csum, cslen));
+}
+
+CK_RV m_DeriveKey(CK_MECHANISM_PTR pderivemech, CK_ATTRIBUTE_PTR ptempl,
+                  CK_ULONG templcount, const unsigned char *basekey,
+                  size_t bklen, const unsigned char *data, size_t dlen,
+                  const unsigned char *pin, size_t pinlen,
+                  unsigned char *newkey, size_t *nklen,
+                  unsigned char *csum, size_t *cslen, target_t target)
+{
+    (void)pderivemech;
+    (void)ptempl;
+    (void)templcount;
+    (void)basekey;
+    (void)bklen;
+    (void)data;
+    (void)dlen;
+    (void)pin;
+    (void)pinlen;
+    (void)newkey;
+    (void)nklen;
+    (void)csum;
+    (void)cslen;
+
+    /* No key derivation mechanisms are emulated */
+    EMU_REQUEST(target, 0, CKR_MECHANISM_INVALID);
+}
+
+CK_RV m_GetAttributeValue(const unsigned char *obj, size_t olen,
+                          CK_ATTRIBUTE_PTR pTemplate, CK_ULONG ulCount,
+                          target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_get_attribute_value(obj, olen, pTemplate, ulCount));
+}
+
+CK_RV m_SetAttributeValue(unsigned char *obj, size_t olen,
+                          CK_ATTRIBUTE_PTR pTemplate, CK_ULONG ulCount,
+                          target_t target)
+{
+    EMU_REQUEST(target, 0,
+                emu_set_attribute_value(obj, olen, pTemplate, ulCount));
+}
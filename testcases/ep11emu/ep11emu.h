@@ -0,0 +1,218 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Internal definitions of the software EP11 host library emulator.
+ *
+ * The emulator implements the m_* and xcpa_* entry points that the EP11
+ * token resolves from its host library, backed by OpenSSL instead of a
+ * crypto express adapter. See testcases/ep11emu/README for usage.
+ */
+
+#ifndef EP11EMU_H
+#define EP11EMU_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include <openssl/evp.h>
+
+#define OCK_NO_EP11_DEFINES
+#include "pkcs11types.h"
+#include "ep11_func.h"
+
+#define EMU_SESSION_BYTES       32
+#define EMU_MAC_BYTES           32
+#define EMU_WK_BYTES            32
+#define EMU_MAX_BLOBSIZE        (8192 * 2)
+#define EMU_CSUM_BYTES          7
+#define EMU_CHECK_VALUE_BYTES   3
+
+/* Boolean key attributes kept in the blob flags */
+#define EMU_F_ENCRYPT               0x00000001
+#define EMU_F_DECRYPT               0x00000002
+#define EMU_F_SIGN                  0x00000004
+#define EMU_F_VERIFY                0x00000008
+#define EMU_F_WRAP                  0x00000010
+#define EMU_F_UNWRAP                0x00000020
+#define EMU_F_DERIVE                0x00000040
+#define EMU_F_EXTRACTABLE           0x00000080
+#define EMU_F_NEVER_EXTRACTABLE     0x00000100
+#define EMU_F_SENSITIVE             0x00000200
+#define EMU_F_ALWAYS_SENSITIVE      0x00000400
+#define EMU_F_MODIFIABLE            0x00000800
+#define EMU_F_LOCAL                 0x00001000
+#define EMU_F_TRUSTED               0x00002000
+#define EMU_F_WRAP_WITH_TRUSTED     0x00004000
+#define EMU_F_SIGN_RECOVER          0x00008000
+#define EMU_F_VERIFY_RECOVER        0x00010000
+#define EMU_F_RESTRICTABLE          0x00020000
+#define EMU_F_ATTRBOUND             0x00040000
+#define EMU_F_USE_AS_DATA           0x00080000
+#define EMU_F_PROTKEY_EXTRACTABLE   0x00100000
+#define EMU_F_PROTKEY_NEVER_EXTR    0x00200000
+
+#define EMU_F_DEFAULT   (EMU_F_ENCRYPT | EMU_F_DECRYPT | EMU_F_SIGN |       \
+                         EMU_F_VERIFY | EMU_F_WRAP | EMU_F_UNWRAP |         \
+                         EMU_F_DERIVE | EMU_F_EXTRACTABLE | EMU_F_MODIFIABLE)
+
+/* A wrapping key (WK) of the emulated domains */
+struct emu_wk {
+    int set;
+    unsigned char wk[EMU_WK_BYTES];
+    unsigned char wkvp[XCP_KEYCSUM_BYTES];  /* first XCP_WKID_BYTES = WKID */
+    unsigned char enc_key[32];              /* derived blob encryption key */
+    unsigned char mac_key[32];              /* derived blob MAC key */
+};
+
+/* One emulated adapter/domain pair with its request queue */
+struct emu_apqn {
+    uint32_t adapter;
+    uint32_t domain;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    unsigned int inflight;
+    unsigned long requests;
+    long latency_us; /* -1: use EP11EMU_LATENCY_US */
+};
+
+struct emu_config {
+    unsigned long latency_us;
+    unsigned long latency_per_kb_us;
+    unsigned int queue_depth;
+    struct emu_wk cur_wk;
+    struct emu_wk next_wk;
+};
+
+extern struct emu_config emu_cfg;
+
+/* A decoded key blob or MACed SPKI */
+struct emu_key {
+    CK_OBJECT_CLASS kclass;
+    CK_KEY_TYPE ktype;
+    CK_ULONG bits;
+    uint32_t flags;
+    unsigned char session[EMU_SESSION_BYTES];
+    unsigned char *value;       /* secret keys: raw key value */
+    size_t value_len;
+    EVP_PKEY *pkey;             /* private and public keys */
+};
+
+/* ep11emu.c */
+void emu_init_once(void);
+CK_RV emu_req_begin(target_t target, size_t datalen, struct emu_apqn **apqn);
+void emu_req_end(struct emu_apqn *apqn);
+
+/*
+ * Runs one emulated adapter request: waits for a free slot in the queue of
+ * the APQN selected by the target, simulates the device latency, performs
+ * the call and returns its result from the enclosing function.
+ */
+#define EMU_REQUEST(target, datalen, call)                              \
+    do {                                                                \
+        struct emu_apqn *apqn_;                                         \
+        CK_RV rc_;                                                      \
+                                                                        \
+        rc_ = emu_req_begin((target), (datalen), &apqn_);               \
+        if (rc_ != CKR_OK)                                              \
+            return rc_;                                                 \
+        rc_ = (call);                                                   \
+        emu_req_end(apqn_);                                             \
+        return rc_;                                                     \
+    } while (0)
+
+/* ep11emu_keys.c */
+void emu_wk_derive(struct emu_wk *wk, const char *seed);
+void emu_key_free(struct emu_key *key);
+CK_RV emu_key_decode(const unsigned char *blob, size_t blob_len,
+                     struct emu_key *key);
+CK_RV emu_key_encode(const struct emu_wk *wk, const struct emu_key *key,
+                     unsigned char *blob, size_t *blob_len);
+CK_RV emu_blob_reencrypt(const unsigned char *blob, size_t blob_len,
+                         unsigned char *out, size_t *out_len);
+const CK_ATTRIBUTE *emu_find_attr(const CK_ATTRIBUTE *templ, CK_ULONG count,
+                                  CK_ATTRIBUTE_TYPE type);
+CK_RV emu_get_ulong_attr(const CK_ATTRIBUTE *templ, CK_ULONG count,
+                         CK_ATTRIBUTE_TYPE type, CK_ULONG *value);
+uint32_t emu_flags_from_template(uint32_t flags, const CK_ATTRIBUTE *templ,
+                                 CK_ULONG count);
+
+CK_RV emu_generate_key(CK_MECHANISM_PTR mech, CK_ATTRIBUTE_PTR templ,
+                       CK_ULONG count, const unsigned char *pin,
+                       size_t pinlen, unsigned char *key, size_t *klen,
+                       unsigned char *csum, size_t *clen);
+CK_RV emu_generate_key_pair(CK_MECHANISM_PTR mech,
+                            CK_ATTRIBUTE_PTR pub, CK_ULONG pubcount,
+                            CK_ATTRIBUTE_PTR priv, CK_ULONG privcount,
+                            const unsigned char *pin, size_t pinlen,
+                            unsigned char *key, size_t *klen,
+                            unsigned char *pubkey, size_t *pklen);
+CK_RV emu_wrap_key(const unsigned char *key, size_t keylen,
+                   const unsigned char *kek, size_t keklen,
+                   CK_MECHANISM_PTR mech,
+                   CK_BYTE_PTR wrapped, CK_ULONG_PTR wlen);
+CK_RV emu_unwrap_key(const CK_BYTE_PTR wrapped, CK_ULONG wlen,
+                     const unsigned char *kek, size_t keklen,
+                     const unsigned char *pin, size_t pinlen,
+                     CK_MECHANISM_PTR mech,
+                     CK_ATTRIBUTE_PTR templ, CK_ULONG count,
+                     unsigned char *unwrapped, size_t *uwlen,
+                     CK_BYTE_PTR csum, CK_ULONG *cslen);
+CK_RV emu_get_attribute_value(const unsigned char *obj, size_t olen,
+                              CK_ATTRIBUTE_PTR templ, CK_ULONG count);
+CK_RV emu_set_attribute_value(unsigned char *obj, size_t olen,
+                              CK_ATTRIBUTE_PTR templ, CK_ULONG count);
+
+/* ep11emu_crypto.c */
+enum emu_op_kind {
+    EMU_OP_DIGEST = 1,
+    EMU_OP_ENCRYPT,
+    EMU_OP_DECRYPT,
+    EMU_OP_SIGN,
+    EMU_OP_VERIFY,
+};
+
+CK_RV emu_op_init(enum emu_op_kind kind, unsigned char *state, size_t *slen,
+                  CK_MECHANISM_PTR mech, const unsigned char *key,
+                  size_t klen);
+CK_RV emu_op_update(enum emu_op_kind kind, const unsigned char *state,
+                    size_t slen, const unsigned char *in, size_t inlen,
+                    unsigned char *out, CK_ULONG_PTR outlen);
+CK_RV emu_op_final(enum emu_op_kind kind, const unsigned char *state,
+                   size_t slen, unsigned char *out, CK_ULONG_PTR outlen);
+CK_RV emu_op_single(enum emu_op_kind kind, const unsigned char *state,
+                    size_t slen, const unsigned char *in, size_t inlen,
+                    unsigned char *out, CK_ULONG_PTR outlen);
+CK_RV emu_op_verify_final(const unsigned char *state, size_t slen,
+                          const unsigned char *sig, size_t siglen);
+CK_RV emu_op_verify_single(const unsigned char *state, size_t slen,
+                           const unsigned char *data, size_t dlen,
+                           const unsigned char *sig, size_t siglen);
+CK_RV emu_op_digest_key(const unsigned char *state, size_t slen,
+                        const unsigned char *key, size_t klen);
+CK_RV emu_crypt_oneshot(enum emu_op_kind kind, CK_MECHANISM_PTR mech,
+                        const struct emu_key *key,
+                        const unsigned char *in, size_t inlen,
+                        unsigned char *out, CK_ULONG_PTR outlen);
+CK_RV emu_key_oneshot(enum emu_op_kind kind, CK_MECHANISM_PTR mech,
+                      const unsigned char *key, size_t klen,
+                      const unsigned char *in, size_t inlen,
+                      unsigned char *out, CK_ULONG_PTR outlen);
+CK_RV emu_verify_oneshot(CK_MECHANISM_PTR mech,
+                         const unsigned char *key, size_t klen,
+                         const unsigned char *data, size_t dlen,
+                         const unsigned char *sig, size_t siglen);
+CK_RV emu_digest_oneshot(CK_MECHANISM_PTR mech,
+                         const unsigned char *data, size_t dlen,
+                         unsigned char *digest, CK_ULONG_PTR dlenp);
+CK_RV emu_check_value(const struct emu_key *key, unsigned char *csum);
+
+#endif
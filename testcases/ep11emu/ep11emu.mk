@@ -0,0 +1,15 @@
+# Software EP11 host library emulator. It is not installed, point the EP11
+# token to it via OCK_EP11_LIBRARY (see testcases/ep11emu/README).
+noinst_LTLIBRARIES += testcases/ep11emu/libep11emu.la
+
+noinst_HEADERS += testcases/ep11emu/ep11emu.h
+EXTRA_DIST += testcases/ep11emu/README
+
+testcases_ep11emu_libep11emu_la_CFLAGS = ${testcases_inc}		\
+	-I${srcdir}/usr/lib/ep11_stdll -fPIC
+testcases_ep11emu_libep11emu_la_LIBADD = -lcrypto -lpthread
+testcases_ep11emu_libep11emu_la_LDFLAGS = -module -shared -avoid-version \
+	-rpath $(abs_builddir)/testcases/ep11emu
+testcases_ep11emu_libep11emu_la_SOURCES =				\
+	testcases/ep11emu/ep11emu.c testcases/ep11emu/ep11emu_keys.c	\
+	testcases/ep11emu/ep11emu_crypto.c
@@ -0,0 +1,1236 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Software EP11 host library emulator: digest, encrypt, decrypt, sign and
+ * verify operations.
+ *
+ * A real adapter returns the complete operation context as state blob. The
+ * emulator keeps the OpenSSL contexts in a process local table instead and
+ * only returns a handle to it as state. A context is released when the
+ * operation completes (final or single part call). Operations that are
+ * abandoned by the caller without completing them are never released, which
+ * is acceptable for a test and benchmark library.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/crypto.h>
+#include <openssl/ecdsa.h>
+#include <openssl/rsa.h>
+
+#include "ep11emu.h"
+
+#define EMU_STATE_MAGIC     0x454d5553  /* "EMUS" */
+#define EMU_AES_BLOCK       16
+
+struct emu_state_blob {
+    uint32_t magic;
+    uint32_t kind;
+    uint64_t handle;
+};
+
+enum emu_alg {
+    EMU_ALG_DIGEST = 1,
+    EMU_ALG_AES,
+    EMU_ALG_RSA,
+    EMU_ALG_HMAC,
+    EMU_ALG_RSA_SIG,
+    EMU_ALG_ECDSA,
+};
+
+struct emu_op {
+    enum emu_op_kind kind;
+    enum emu_alg alg;
+    int pad;                    /* AES: PKCS#7 padding */
+    int raw;                    /* RSA/ECDSA sign without hashing */
+    size_t buffered;            /* AES: input bytes not yet output */
+    size_t out_len;             /* digest, MAC or signature length */
+    EVP_CIPHER_CTX *cctx;
+    EVP_MD_CTX *mdctx;
+    EVP_PKEY *pkey;
+    /* handle table */
+    uint32_t gen;
+    int in_use;
+};
+
+static pthread_mutex_t emu_op_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct emu_op **emu_ops;
+static size_t emu_ops_num;
+
+static const struct {
+    CK_MECHANISM_TYPE mech;
+    enum emu_alg alg;
+    const EVP_MD *(*md)(void);
+} emu_mechs[] = {
+    { CKM_SHA_1, EMU_ALG_DIGEST, EVP_sha1 },
+    { CKM_SHA224, EMU_ALG_DIGEST, EVP_sha224 },
+    { CKM_SHA256, EMU_ALG_DIGEST, EVP_sha256 },
+    { CKM_SHA384, EMU_ALG_DIGEST, EVP_sha384 },
+    { CKM_SHA512, EMU_ALG_DIGEST, EVP_sha512 },
+    { CKM_AES_ECB, EMU_ALG_AES, NULL },
+    { CKM_AES_CBC, EMU_ALG_AES, NULL },
+    { CKM_AES_CBC_PAD, EMU_ALG_AES, NULL },
+    { CKM_RSA_PKCS, EMU_ALG_RSA, NULL },
+    { CKM_SHA_1_HMAC, EMU_ALG_HMAC, EVP_sha1 },
+    { CKM_SHA224_HMAC, EMU_ALG_HMAC, EVP_sha224 },
+    { CKM_SHA256_HMAC, EMU_ALG_HMAC, EVP_sha256 },
+    { CKM_SHA384_HMAC, EMU_ALG_HMAC, EVP_sha384 },
+    { CKM_SHA512_HMAC, EMU_ALG_HMAC, EVP_sha512 },
+    { CKM_SHA1_RSA_PKCS, EMU_ALG_RSA_SIG, EVP_sha1 },
+    { CKM_SHA224_RSA_PKCS, EMU_ALG_RSA_SIG, EVP_sha224 },
+    { CKM_SHA256_RSA_PKCS, EMU_ALG_RSA_SIG, EVP_sha256 },
+    { CKM_SHA384_RSA_PKCS, EMU_ALG_RSA_SIG, EVP_sha384 },
+    { CKM_SHA512_RSA_PKCS, EMU_ALG_RSA_SIG, EVP_sha512 },
+    { CKM_ECDSA, EMU_ALG_ECDSA, NULL },
+    { CKM_ECDSA_SHA1, EMU_ALG_ECDSA, EVP_sha1 },
+    { CKM_ECDSA_SHA224, EMU_ALG_ECDSA, EVP_sha224 },
+    { CKM_ECDSA_SHA256, EMU_ALG_ECDSA, EVP_sha256 },
+    { CKM_ECDSA_SHA384, EMU_ALG_ECDSA, EVP_sha384 },
+    { CKM_ECDSA_SHA512, EMU_ALG_ECDSA, EVP_sha512 },
+};
+
+#define EMU_NUM_MECHS   (sizeof(emu_mechs) / sizeof(emu_mechs[0]))
+
+static void emu_op_cleanup(struct emu_op *op)
+{
+    EVP_CIPHER_CTX_free(op->cctx);
+    EVP_MD_CTX_free(op->mdctx);
+    EVP_PKEY_free(op->pkey);
+    op->cctx = NULL;
+    op->mdctx = NULL;
+    op->pkey = NULL;
+}
+
+/*
+ * Operation handle table
+ */
+
+static CK_RV emu_op_alloc(struct emu_op **op, uint64_t *handle)
+{
+    struct emu_op **ops;
+    size_t i, num;
+    CK_RV rc = CKR_OK;
+
+    pthread_mutex_lock(&emu_op_mutex);
+
+    for (i = 0; i < emu_ops_num; i++) {
+        if (!emu_ops[i]->in_use)
+            break;
+    }
+
+    if (i == emu_ops_num) {
+        num = emu_ops_num > 0 ? emu_ops_num * 2 : 64;
+        ops = realloc(emu_ops, num * sizeof(*ops));
+        if (ops == NULL) {
+            rc = CKR_HOST_MEMORY;
+            goto out;
+        }
+        emu_ops = ops;
+
+        for (; emu_ops_num < num; emu_ops_num++) {
+            emu_ops[emu_ops_num] = calloc(1, sizeof(struct emu_op));
+            if (emu_ops[emu_ops_num] == NULL) {
+                rc = CKR_HOST_MEMORY;
+                goto out;
+            }
+        }
+    }
+
+    emu_ops[i]->in_use = 1;
+    *op = emu_ops[i];
+    *handle = ((uint64_t)emu_ops[i]->gen << 32) | i;
+
+out:
+    pthread_mutex_unlock(&emu_op_mutex);
+    return rc;
+}
+
+static void emu_op_release(struct emu_op *op)
+{
+    uint32_t gen;
+
+    emu_op_cleanup(op);
+
+    pthread_mutex_lock(&emu_op_mutex);
+    gen = op->gen + 1;
+    memset(op, 0, sizeof(*op));
+    op->gen = gen;
+    pthread_mutex_unlock(&emu_op_mutex);
+}
+
+static CK_RV emu_op_lookup(enum emu_op_kind kind, const unsigned char *state,
+                           size_t slen, struct emu_op **op)
+{
+    struct emu_state_blob sb;
+    size_t idx;
+    CK_RV rc = CKR_OPERATION_NOT_INITIALIZED;
+
+    if (state == NULL || slen != sizeof(sb))
+        return CKR_ARGUMENTS_BAD;
+
+    memcpy(&sb, state, sizeof(sb));
+    if (sb.magic != EMU_STATE_MAGIC || sb.kind != (uint32_t)kind)
+        return CKR_OPERATION_NOT_INITIALIZED;
+
+    idx = sb.handle & 0xffffffff;
+
+    pthread_mutex_lock(&emu_op_mutex);
+    if (idx < emu_ops_num && emu_ops[idx]->in_use &&
+        emu_ops[idx]->gen == (uint32_t)(sb.handle >> 32)) {
+        *op = emu_ops[idx];
+        rc = CKR_OK;
+    }
+    pthread_mutex_unlock(&emu_op_mutex);
+
+    return rc;
+}
+
+/*
+ * Operation setup
+ */
+
+static const EVP_CIPHER *emu_aes_cipher(CK_MECHANISM_TYPE mech,
+                                        size_t keylen)
+{
+    int ecb = (mech == CKM_AES_ECB);
+
+    switch (keylen) {
+    case 16:
+        return ecb ? EVP_aes_128_ecb() : EVP_aes_128_cbc();
+    case 24:
+        return ecb ? EVP_aes_192_ecb() : EVP_aes_192_cbc();
+    case 32:
+        return ecb ? EVP_aes_256_ecb() : EVP_aes_256_cbc();
+    default:
+        return NULL;
+    }
+}
+
+static CK_RV emu_setup_aes(struct emu_op *op, CK_MECHANISM_PTR mech,
+                           const struct emu_key *key)
+{
+    const EVP_CIPHER *cipher;
+    const unsigned char *iv = NULL;
+
+    if (key->kclass != CKO_SECRET_KEY || key->ktype != CKK_AES)
+        return CKR_KEY_TYPE_INCONSISTENT;
+
+    if (op->kind != EMU_OP_ENCRYPT && op->kind != EMU_OP_DECRYPT)
+        return CKR_MECHANISM_INVALID;
+
+    if (mech->mechanism != CKM_AES_ECB) {
+        if (mech->pParameter == NULL ||
+            mech->ulParameterLen != EMU_AES_BLOCK)
+            return CKR_MECHANISM_PARAM_INVALID;
+        iv = mech->pParameter;
+    }
+
+    cipher = emu_aes_cipher(mech->mechanism, key->value_len);
+    if (cipher == NULL)
+        return CKR_KEY_SIZE_RANGE;
+
+    op->cctx = EVP_CIPHER_CTX_new();
+    if (op->cctx == NULL)
+        return CKR_HOST_MEMORY;
+
+    if (EVP_CipherInit_ex(op->cctx, cipher, NULL, key->value, iv,
+                          op->kind == EMU_OP_ENCRYPT ? 1 : 0) != 1)
+        return CKR_FUNCTION_FAILED;
+
+    op->pad = (mech->mechanism == CKM_AES_CBC_PAD);
+    EVP_CIPHER_CTX_set_padding(op->cctx, op->pad);
+
+    return CKR_OK;
+}
+
+static CK_RV emu_setup_hmac(struct emu_op *op, const EVP_MD *md,
+                            const struct emu_key *key)
+{
+    EVP_PKEY *pkey;
+
+    if (key->kclass != CKO_SECRET_KEY)
+        return CKR_KEY_TYPE_INCONSISTENT;
+
+    if (op->kind != EMU_OP_SIGN && op->kind != EMU_OP_VERIFY)
+        return CKR_MECHANISM_INVALID;
+
+    pkey = EVP_PKEY_new_raw_private_key(EVP_PKEY_HMAC, NULL, key->value,
+                                        key->value_len);
+    if (pkey == NULL)
+        return CKR_HOST_MEMORY;
+
+    op->mdctx = EVP_MD_CTX_new();
+    if (op->mdctx == NULL) {
+        EVP_PKEY_free(pkey);
+        return CKR_HOST_MEMORY;
+    }
+
+    /* The MAC is computed for verify as well and compared afterwards */
+    if (EVP_DigestSignInit(op->mdctx, NULL, md, NULL, pkey) != 1) {
+        EVP_PKEY_free(pkey);
+        return CKR_FUNCTION_FAILED;
+    }
+    EVP_PKEY_free(pkey);
+
+    op->out_len = EVP_MD_size(md);
+    return CKR_OK;
+}
+
+static CK_RV emu_setup_pkey(struct emu_op *op, enum emu_alg alg,
+                            const EVP_MD *md, const struct emu_key *key)
+{
+    CK_KEY_TYPE ktype = (alg == EMU_ALG_ECDSA) ? CKK_EC : CKK_RSA;
+    CK_OBJECT_CLASS kclass;
+    EVP_PKEY_CTX *pctx = NULL;
+    int rv;
+
+    if (key->pkey == NULL || key->ktype != ktype)
+        return CKR_KEY_TYPE_INCONSISTENT;
+
+    switch (op->kind) {
+    case EMU_OP_ENCRYPT:
+    case EMU_OP_VERIFY:
+        kclass = CKO_PUBLIC_KEY;
+        break;
+    case EMU_OP_DECRYPT:
+    case EMU_OP_SIGN:
+        kclass = CKO_PRIVATE_KEY;
+        break;
+    default:
+        return CKR_MECHANISM_INVALID;
+    }
+    if (key->kclass != kclass)
+        return CKR_KEY_TYPE_INCONSISTENT;
+
+    if (alg == EMU_ALG_RSA &&
+        op->kind != EMU_OP_ENCRYPT && op->kind != EMU_OP_DECRYPT)
+        alg = EMU_ALG_RSA_SIG;
+    if (alg != EMU_ALG_RSA &&
+        op->kind != EMU_OP_SIGN && op->kind != EMU_OP_VERIFY)
+        return CKR_MECHANISM_INVALID;
+
+    op->alg = alg;
+    op->raw = (md == NULL);
+    op->pkey = key->pkey;
+    EVP_PKEY_up_ref(op->pkey);
+
+    if (alg == EMU_ALG_ECDSA)
+        op->out_len = 2 * ((EVP_PKEY_bits(op->pkey) + 7) / 8);
+    else
+        op->out_len = EVP_PKEY_size(op->pkey);
+
+    if (op->raw || alg == EMU_ALG_RSA)
+        return CKR_OK;
+
+    op->mdctx = EVP_MD_CTX_new();
+    if (op->mdctx == NULL)
+        return CKR_HOST_MEMORY;
+
+    if (op->kind == EMU_OP_SIGN)
+        rv = EVP_DigestSignInit(op->mdctx, &pctx, md, NULL, op->pkey);
+    else
+        rv = EVP_DigestVerifyInit(op->mdctx, &pctx, md, NULL, op->pkey);
+    if (rv != 1)
+        return CKR_FUNCTION_FAILED;
+
+    if (alg == EMU_ALG_RSA_SIG &&
+        EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PADDING) != 1)
+        return CKR_FUNCTION_FAILED;
+
+    return CKR_OK;
+}
+
+static CK_RV emu_op_setup(struct emu_op *op, enum emu_op_kind kind,
+                          CK_MECHANISM_PTR mech, const struct emu_key *key)
+{
+    size_t i;
+    CK_RV rc;
+
+    if (mech == NULL)
+        return CKR_ARGUMENTS_BAD;
+
+    for (i = 0; i < EMU_NUM_MECHS; i++) {
+        if (emu_mechs[i].mech == mech->mechanism)
+            break;
+    }
+    if (i == EMU_NUM_MECHS)
+        return CKR_MECHANISM_INVALID;
+
+    op->kind = kind;
+    op->alg = emu_mechs[i].alg;
+
+    switch (op->alg) {
+    case EMU_ALG_DIGEST:
+        if (kind != EMU_OP_DIGEST)
+            return CKR_MECHANISM_INVALID;
+        op->mdctx = EVP_MD_CTX_new();
+        if (op->mdctx == NULL)
+            return CKR_HOST_MEMORY;
+        if (EVP_DigestInit_ex(op->mdctx, emu_mechs[i].md(), NULL) != 1)
+            return CKR_FUNCTION_FAILED;
+        op->out_len = EVP_MD_size(emu_mechs[i].md());
+        return CKR_OK;
+    case EMU_ALG_AES:
+        rc = emu_setup_aes(op, mech, key);
+        break;
+    case EMU_ALG_HMAC:
+        rc = emu_setup_hmac(op, emu_mechs[i].md(), key);
+        break;
+    default:
+        rc = emu_setup_pkey(op, op->alg,
+                            emu_mechs[i].md != NULL ? emu_mechs[i].md() : NULL,
+                            key);
+        break;
+    }
+
+    return rc;
+}
+
+static CK_RV emu_check_usage(enum emu_op_kind kind, const struct emu_key *key)
+{
+    static const uint32_t usage[] = {
+        [EMU_OP_ENCRYPT] = EMU_F_ENCRYPT,
+        [EMU_OP_DECRYPT] = EMU_F_DECRYPT,
+        [EMU_OP_SIGN] = EMU_F_SIGN,
+        [EMU_OP_VERIFY] = EMU_F_VERIFY,
+    };
+
+    if (kind == EMU_OP_DIGEST)
+        return CKR_OK;
+
+    return (key->flags & usage[kind]) ? CKR_OK :
+                                        CKR_KEY_FUNCTION_NOT_PERMITTED;
+}
+
+/*
+ * Data processing
+ */
+
+/*
+ * Runs an AES update or final step. The required output length is computed
+ * from the number of buffered input bytes. If it is only an upper bound
+ * (final decryption with padding) and the caller's buffer is smaller, the
+ * step is run on a copy of the context, so that the operation is not
+ * consumed if the output does not fit.
+ */
+static CK_RV emu_aes_step(struct emu_op *op, const unsigned char *in,
+                          size_t inlen, int final, unsigned char *out,
+                          CK_ULONG_PTR outlen)
+{
+    EVP_CIPHER_CTX *ctx = op->cctx, *copy = NULL;
+    unsigned char tmp[EMU_AES_BLOCK];
+    size_t total = op->buffered + inlen, need;
+    unsigned char *dst = out;
+    int len = 0, rv;
+    CK_RV rc = CKR_OK;
+
+    if (final) {
+        if (!op->pad && op->buffered != 0)
+            return op->kind == EMU_OP_ENCRYPT ? CKR_DATA_LEN_RANGE :
+                                                CKR_ENCRYPTED_DATA_LEN_RANGE;
+        if (op->pad && op->kind == EMU_OP_DECRYPT && op->buffered == 0)
+            return CKR_ENCRYPTED_DATA_LEN_RANGE;
+        need = op->pad ? EMU_AES_BLOCK : 0;
+    } else if (op->pad && op->kind == EMU_OP_DECRYPT) {
+        /* the last block is held back until the final step */
+        need = total > 0 ? ((total - 1) / EMU_AES_BLOCK) * EMU_AES_BLOCK : 0;
+    } else {
+        need = (total / EMU_AES_BLOCK) * EMU_AES_BLOCK;
+    }
+
+    if (out == NULL) {
+        *outlen = need;
+        return CKR_OK;
+    }
+
+    if (*outlen < need) {
+        if (!final || op->kind != EMU_OP_DECRYPT) {
+            *outlen = need;
+            return CKR_BUFFER_TOO_SMALL;
+        }
+        copy = EVP_CIPHER_CTX_new();
+        if (copy == NULL)
+            return CKR_HOST_MEMORY;
+        if (EVP_CIPHER_CTX_copy(copy, ctx) != 1) {
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+        ctx = copy;
+        dst = tmp;
+    }
+
+    if (final)
+        rv = EVP_CipherFinal_ex(ctx, dst, &len);
+    else
+        rv = EVP_CipherUpdate(ctx, dst, &len, in, inlen);
+    if (rv != 1) {
+        rc = op->kind == EMU_OP_DECRYPT ? CKR_ENCRYPTED_DATA_INVALID :
+                                          CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    if (copy != NULL) {
+        if ((size_t)len > *outlen) {
+            *outlen = len;
+            rc = CKR_BUFFER_TOO_SMALL;
+            goto out;
+        }
+        memcpy(out, tmp, len);
+        EVP_CIPHER_CTX_free(op->cctx);
+        op->cctx = copy;
+        copy = NULL;
+    }
+
+    op->buffered = final ? 0 : total - len;
+    *outlen = len;
+
+out:
+    EVP_CIPHER_CTX_free(copy);
+    OPENSSL_cleanse(tmp, sizeof(tmp));
+    return rc;
+}
+
+static CK_RV emu_aes_run(struct emu_op *op, const unsigned char *in,
+                         size_t inlen, unsigned char *out, CK_ULONG_PTR outlen)
+{
+    CK_ULONG len = *outlen, len2;
+    CK_RV rc;
+
+    rc = emu_aes_step(op, in, inlen, 0, out, &len);
+    if (rc != CKR_OK)
+        return rc;
+
+    len2 = *outlen - len;
+    rc = emu_aes_step(op, NULL, 0, 1, out + len, &len2);
+    *outlen = len + len2;
+
+    return rc;
+}
+
+/*
+ * Single part AES. With decryption and padding the plaintext length is only
+ * known afterwards, so a buffer that is smaller than the ciphertext is
+ * served from a temporary buffer and a context copy, which is restored if
+ * the plaintext does not fit.
+ */
+static CK_RV emu_aes_single(struct emu_op *op, const unsigned char *in,
+                            size_t inlen, unsigned char *out,
+                            CK_ULONG_PTR outlen)
+{
+    EVP_CIPHER_CTX *saved;
+    unsigned char *tmp;
+    CK_ULONG need, len;
+    CK_RV rc;
+
+    if ((!op->pad || op->kind == EMU_OP_DECRYPT) &&
+        (inlen % EMU_AES_BLOCK) != 0)
+        return op->kind == EMU_OP_ENCRYPT ? CKR_DATA_LEN_RANGE :
+                                            CKR_ENCRYPTED_DATA_LEN_RANGE;
+    if (op->pad && op->kind == EMU_OP_DECRYPT && inlen == 0)
+        return CKR_ENCRYPTED_DATA_LEN_RANGE;
+
+    need = inlen;
+    if (op->pad && op->kind == EMU_OP_ENCRYPT)
+        need = (inlen / EMU_AES_BLOCK + 1) * EMU_AES_BLOCK;
+
+    if (out == NULL) {
+        *outlen = need;
+        return CKR_OK;
+    }
+    if (*outlen >= need)
+        return emu_aes_run(op, in, inlen, out, outlen);
+    if (!op->pad || op->kind == EMU_OP_ENCRYPT) {
+        *outlen = need;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    tmp = malloc(need);
+    saved = EVP_CIPHER_CTX_new();
+    if (tmp == NULL || saved == NULL ||
+        EVP_CIPHER_CTX_copy(saved, op->cctx) != 1) {
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    len = need;
+    rc = emu_aes_run(op, in, inlen, tmp, &len);
+    if (rc == CKR_OK && len > *outlen) {
+        EVP_CIPHER_CTX_free(op->cctx);
+        op->cctx = saved;
+        op->buffered = 0;
+        saved = NULL;
+        rc = CKR_BUFFER_TOO_SMALL;
+    } else if (rc == CKR_OK) {
+        memcpy(out, tmp, len);
+    }
+    *outlen = len;
+
+out:
+    if (tmp != NULL) {
+        OPENSSL_cleanse(tmp, need);
+        free(tmp);
+    }
+    EVP_CIPHER_CTX_free(saved);
+    return rc;
+}
+
+static CK_RV emu_rsa_crypt(struct emu_op *op, const unsigned char *in,
+                           size_t inlen, unsigned char *out,
+                           CK_ULONG_PTR outlen)
+{
+    EVP_PKEY_CTX *pctx;
+    unsigned char *tmp = NULL;
+    size_t len = op->out_len;
+    int rv;
+    CK_RV rc = CKR_OK;
+
+    if (out == NULL) {
+        *outlen = op->out_len;
+        return CKR_OK;
+    }
+    if (op->kind == EMU_OP_ENCRYPT && *outlen < op->out_len) {
+        *outlen = op->out_len;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    pctx = EVP_PKEY_CTX_new(op->pkey, NULL);
+    if (pctx == NULL)
+        return CKR_HOST_MEMORY;
+
+    if (op->kind == EMU_OP_ENCRYPT) {
+        if (EVP_PKEY_encrypt_init(pctx) != 1 ||
+            EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PADDING) != 1) {
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+        if (EVP_PKEY_encrypt(pctx, out, &len, in, inlen) != 1) {
+            rc = CKR_DATA_LEN_RANGE;
+            goto out;
+        }
+        *outlen = len;
+        goto out;
+    }
+
+    if (inlen != op->out_len) {
+        rc = CKR_ENCRYPTED_DATA_LEN_RANGE;
+        goto out;
+    }
+
+    /* The plaintext length is only known after decryption */
+    tmp = malloc(op->out_len);
+    if (tmp == NULL) {
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    rv = EVP_PKEY_decrypt_init(pctx);
+    if (rv == 1)
+        rv = EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PADDING);
+    if (rv != 1) {
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+    if (EVP_PKEY_decrypt(pctx, tmp, &len, in, inlen) != 1) {
+        rc = CKR_ENCRYPTED_DATA_INVALID;
+        goto out;
+    }
+
+    if (len > *outlen) {
+        rc = CKR_BUFFER_TOO_SMALL;
+    } else {
+        memcpy(out, tmp, len);
+    }
+    *outlen = len;
+
+out:
+    if (tmp != NULL) {
+        OPENSSL_cleanse(tmp, op->out_len);
+        free(tmp);
+    }
+    EVP_PKEY_CTX_free(pctx);
+    return rc;
+}
+
+/* Converts a DER encoded ECDSA signature into r || s */
+static CK_RV emu_ecdsa_der2raw(const unsigned char *der, size_t der_len,
+                               unsigned char *raw, size_t raw_len)
+{
+    const unsigned char *p = der;
+    const BIGNUM *r, *s;
+    ECDSA_SIG *sig;
+    CK_RV rc = CKR_OK;
+
+    sig = d2i_ECDSA_SIG(NULL, &p, der_len);
+    if (sig == NULL)
+        return CKR_FUNCTION_FAILED;
+
+    ECDSA_SIG_get0(sig, &r, &s);
+    if (BN_bn2binpad(r, raw, raw_len / 2) <= 0 ||
+        BN_bn2binpad(s, raw + raw_len / 2, raw_len / 2) <= 0)
+        rc = CKR_FUNCTION_FAILED;
+
+    ECDSA_SIG_free(sig);
+    return rc;
+}
+
+/* Converts r || s into a DER encoded ECDSA signature */
+static CK_RV emu_ecdsa_raw2der(const unsigned char *raw, size_t raw_len,
+                               unsigned char **der, int *der_len)
+{
+    BIGNUM *r, *s;
+    ECDSA_SIG *sig;
+
+    r = BN_bin2bn(raw, raw_len / 2, NULL);
+    s = BN_bin2bn(raw + raw_len / 2, raw_len / 2, NULL);
+    sig = ECDSA_SIG_new();
+    if (r == NULL || s == NULL || sig == NULL ||
+        ECDSA_SIG_set0(sig, r, s) != 1) {
+        BN_free(r);
+        BN_free(s);
+        ECDSA_SIG_free(sig);
+        return CKR_HOST_MEMORY;
+    }
+
+    *der = NULL;
+    *der_len = i2d_ECDSA_SIG(sig, der);
+    ECDSA_SIG_free(sig);
+
+    return *der_len > 0 ? CKR_OK : CKR_FUNCTION_FAILED;
+}
+
+/*
+ * Computes a signature or MAC. For raw RSA and ECDSA the data is passed in
+ * with the call, otherwise it has been fed into the digest context before.
+ */
+static CK_RV emu_sign_final(struct emu_op *op, const unsigned char *data,
+                            size_t dlen, unsigned char *sig,
+                            CK_ULONG_PTR siglen)
+{
+    EVP_PKEY_CTX *pctx = NULL;
+    unsigned char *buf;
+    size_t len;
+    CK_RV rc = CKR_OK;
+    int rv;
+
+    if (sig == NULL) {
+        *siglen = op->out_len;
+        return CKR_OK;
+    }
+    if (*siglen < op->out_len) {
+        *siglen = op->out_len;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    if (op->raw) {
+        pctx = EVP_PKEY_CTX_new(op->pkey, NULL);
+        if (pctx == NULL)
+            return CKR_HOST_MEMORY;
+        rv = EVP_PKEY_sign_init(pctx);
+        if (rv == 1 && op->alg == EMU_ALG_RSA_SIG)
+            rv = EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PADDING);
+        if (rv != 1 || EVP_PKEY_sign(pctx, NULL, &len, data, dlen) != 1) {
+            EVP_PKEY_CTX_free(pctx);
+            return CKR_FUNCTION_FAILED;
+        }
+    } else if (EVP_DigestSignFinal(op->mdctx, NULL, &len) != 1) {
+        return CKR_FUNCTION_FAILED;
+    }
+
+    buf = malloc(len);
+    if (buf == NULL) {
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    if (op->raw)
+        rv = EVP_PKEY_sign(pctx, buf, &len, data, dlen);
+    else
+        rv = EVP_DigestSignFinal(op->mdctx, buf, &len);
+    if (rv != 1) {
+        rc = op->raw ? CKR_DATA_LEN_RANGE : CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    if (op->alg == EMU_ALG_ECDSA) {
+        rc = emu_ecdsa_der2raw(buf, len, sig, op->out_len);
+        len = op->out_len;
+    } else {
+        memcpy(sig, buf, len);
+    }
+    *siglen = len;
+
+out:
+    free(buf);
+    EVP_PKEY_CTX_free(pctx);
+    return rc;
+}
+
+static CK_RV emu_verify_final(struct emu_op *op, const unsigned char *data,
+                              size_t dlen, const unsigned char *sig,
+                              size_t siglen)
+{
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    EVP_PKEY_CTX *pctx = NULL;
+    unsigned char *der = NULL, *rec = NULL;
+    size_t maclen = sizeof(mac), rec_len = op->out_len;
+    int der_len, rv;
+    CK_RV rc;
+
+    if (op->alg == EMU_ALG_HMAC) {
+        if (EVP_DigestSignFinal(op->mdctx, mac, &maclen) != 1)
+            return CKR_FUNCTION_FAILED;
+        if (siglen != maclen)
+            return CKR_SIGNATURE_LEN_RANGE;
+        return CRYPTO_memcmp(mac, sig, maclen) == 0 ? CKR_OK :
+                                                      CKR_SIGNATURE_INVALID;
+    }
+
+    if (siglen != op->out_len)
+        return CKR_SIGNATURE_LEN_RANGE;
+
+    if (op->alg == EMU_ALG_ECDSA) {
+        rc = emu_ecdsa_raw2der(sig, siglen, &der, &der_len);
+        if (rc != CKR_OK)
+            return rc;
+        sig = der;
+        siglen = der_len;
+    }
+
+    if (op->raw) {
+        pctx = EVP_PKEY_CTX_new(op->pkey, NULL);
+        if (pctx == NULL) {
+            rc = CKR_HOST_MEMORY;
+            goto out;
+        }
+        if (op->alg == EMU_ALG_RSA_SIG) {
+            /*
+             * Recover and compare the data, EVP_PKEY_verify() rejects
+             * signatures over empty data.
+             */
+            rec = malloc(op->out_len);
+            if (rec == NULL) {
+                rc = CKR_HOST_MEMORY;
+                goto out;
+            }
+            rv = EVP_PKEY_verify_recover_init(pctx);
+            if (rv == 1)
+                rv = EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PADDING);
+            if (rv == 1)
+                rv = EVP_PKEY_verify_recover(pctx, rec, &rec_len, sig, siglen);
+            if (rv == 1 && (rec_len != dlen ||
+                            CRYPTO_memcmp(rec, data, dlen) != 0))
+                rv = 0;
+        } else {
+            rv = EVP_PKEY_verify_init(pctx);
+            if (rv == 1)
+                rv = EVP_PKEY_verify(pctx, sig, siglen, data, dlen);
+        }
+    } else {
+        rv = EVP_DigestVerifyFinal(op->mdctx, sig, siglen);
+    }
+
+    rc = (rv == 1) ? CKR_OK : CKR_SIGNATURE_INVALID;
+
+out:
+    free(rec);
+    OPENSSL_free(der);
+    EVP_PKEY_CTX_free(pctx);
+    return rc;
+}
+
+static CK_RV emu_op_do_update(struct emu_op *op, const unsigned char *in,
+                              size_t inlen, unsigned char *out,
+                              CK_ULONG_PTR outlen)
+{
+    switch (op->alg) {
+    case EMU_ALG_DIGEST:
+        return EVP_DigestUpdate(op->mdctx, in, inlen) == 1 ?
+                                            CKR_OK : CKR_FUNCTION_FAILED;
+    case EMU_ALG_AES:
+        return emu_aes_step(op, in, inlen, 0, out, outlen);
+    case EMU_ALG_HMAC:
+        return EVP_DigestSignUpdate(op->mdctx, in, inlen) == 1 ?
+                                            CKR_OK : CKR_FUNCTION_FAILED;
+    case EMU_ALG_RSA_SIG:
+    case EMU_ALG_ECDSA:
+        if (op->raw)
+            break;
+        if (op->kind == EMU_OP_SIGN)
+            return EVP_DigestSignUpdate(op->mdctx, in, inlen) == 1 ?
+                                            CKR_OK : CKR_FUNCTION_FAILED;
+        return EVP_DigestVerifyUpdate(op->mdctx, in, inlen) == 1 ?
+                                            CKR_OK : CKR_FUNCTION_FAILED;
+    default:
+        break;
+    }
+
+    /* single part only mechanisms */
+    return CKR_MECHANISM_INVALID;
+}
+
+static CK_RV emu_op_do_final(struct emu_op *op, unsigned char *out,
+                             CK_ULONG_PTR outlen)
+{
+    unsigned int len;
+
+    switch (op->alg) {
+    case EMU_ALG_DIGEST:
+        if (out == NULL) {
+            *outlen = op->out_len;
+            return CKR_OK;
+        }
+        if (*outlen < op->out_len) {
+            *outlen = op->out_len;
+            return CKR_BUFFER_TOO_SMALL;
+        }
+        if (EVP_DigestFinal_ex(op->mdctx, out, &len) != 1)
+            return CKR_FUNCTION_FAILED;
+        *outlen = len;
+        return CKR_OK;
+    case EMU_ALG_AES:
+        return emu_aes_step(op, NULL, 0, 1, out, outlen);
+    case EMU_ALG_HMAC:
+        return emu_sign_final(op, NULL, 0, out, outlen);
+    default:
+        if (op->raw)
+            break;
+        return emu_sign_final(op, NULL, 0, out, outlen);
+    }
+
+    return CKR_MECHANISM_INVALID;
+}
+
+static CK_RV emu_op_do_single(struct emu_op *op, const unsigned char *in,
+                              size_t inlen, unsigned char *out,
+                              CK_ULONG_PTR outlen)
+{
+    CK_RV rc;
+
+    switch (op->alg) {
+    case EMU_ALG_RSA:
+        return emu_rsa_crypt(op, in, inlen, out, outlen);
+    case EMU_ALG_AES:
+        return emu_aes_single(op, in, inlen, out, outlen);
+    case EMU_ALG_DIGEST:
+        if (out != NULL && *outlen >= op->out_len) {
+            rc = emu_op_do_update(op, in, inlen, NULL, NULL);
+            if (rc != CKR_OK)
+                return rc;
+        }
+        return emu_op_do_final(op, out, outlen);
+    default:
+        break;
+    }
+
+    /* sign */
+    if (op->raw)
+        return emu_sign_final(op, in, inlen, out, outlen);
+
+    if (out != NULL && *outlen >= op->out_len) {
+        rc = emu_op_do_update(op, in, inlen, NULL, NULL);
+        if (rc != CKR_OK)
+            return rc;
+    }
+    return emu_sign_final(op, NULL, 0, out, outlen);
+}
+
+/*
+ * State based operations
+ */
+
+CK_RV emu_op_init(enum emu_op_kind kind, unsigned char *state, size_t *slen,
+                  CK_MECHANISM_PTR mech, const unsigned char *key,
+                  size_t klen)
+{
+    struct emu_state_blob sb;
+    struct emu_key k;
+    struct emu_op *op;
+    uint64_t handle;
+    CK_RV rc;
+
+    if (slen == NULL)
+        return CKR_ARGUMENTS_BAD;
+    if (state == NULL) {
+        *slen = sizeof(sb);
+        return CKR_OK;
+    }
+    if (*slen < sizeof(sb)) {
+        *slen = sizeof(sb);
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memset(&k, 0, sizeof(k));
+    if (kind != EMU_OP_DIGEST) {
+        rc = emu_key_decode(key, klen, &k);
+        if (rc != CKR_OK)
+            return rc;
+        rc = emu_check_usage(kind, &k);
+        if (rc != CKR_OK)
+            goto out;
+    }
+
+    rc = emu_op_alloc(&op, &handle);
+    if (rc != CKR_OK)
+        goto out;
+
+    rc = emu_op_setup(op, kind, mech, &k);
+    if (rc != CKR_OK) {
+        emu_op_release(op);
+        goto out;
+    }
+
+    sb.magic = EMU_STATE_MAGIC;
+    sb.kind = kind;
+    sb.handle = handle;
+    memcpy(state, &sb, sizeof(sb));
+    *slen = sizeof(sb);
+
+out:
+    emu_key_free(&k);
+    return rc;
+}
+
+CK_RV emu_op_update(enum emu_op_kind kind, const unsigned char *state,
+                    size_t slen, const unsigned char *in, size_t inlen,
+                    unsigned char *out, CK_ULONG_PTR outlen)
+{
+    struct emu_op *op;
+    CK_ULONG dummy = 0;
+    CK_RV rc;
+
+    rc = emu_op_lookup(kind, state, slen, &op);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (in == NULL && inlen > 0)
+        return CKR_ARGUMENTS_BAD;
+
+    return emu_op_do_update(op, in, inlen, out,
+                            outlen != NULL ? outlen : &dummy);
+}
+
+static int emu_op_done(const unsigned char *out, CK_RV rc)
+{
+    /* length queries and too small buffers keep the operation active */
+    return out != NULL && rc != CKR_BUFFER_TOO_SMALL;
+}
+
+CK_RV emu_op_final(enum emu_op_kind kind, const unsigned char *state,
+                   size_t slen, unsigned char *out, CK_ULONG_PTR outlen)
+{
+    struct emu_op *op;
+    CK_RV rc;
+
+    if (outlen == NULL)
+        return CKR_ARGUMENTS_BAD;
+
+    rc = emu_op_lookup(kind, state, slen, &op);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = emu_op_do_final(op, out, outlen);
+    if (emu_op_done(out, rc))
+        emu_op_release(op);
+
+    return rc;
+}
+
+CK_RV emu_op_single(enum emu_op_kind kind, const unsigned char *state,
+                    size_t slen, const unsigned char *in, size_t inlen,
+                    unsigned char *out, CK_ULONG_PTR outlen)
+{
+    struct emu_op *op;
+    CK_RV rc;
+
+    if (outlen == NULL || (in == NULL && inlen > 0))
+        return CKR_ARGUMENTS_BAD;
+
+    rc = emu_op_lookup(kind, state, slen, &op);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = emu_op_do_single(op, in, inlen, out, outlen);
+    if (emu_op_done(out, rc))
+        emu_op_release(op);
+
+    return rc;
+}
+
+CK_RV emu_op_verify_final(const unsigned char *state, size_t slen,
+                          const unsigned char *sig, size_t siglen)
+{
+    struct emu_op *op;
+    CK_RV rc;
+
+    rc = emu_op_lookup(EMU_OP_VERIFY, state, slen, &op);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (op->raw)
+        rc = CKR_MECHANISM_INVALID;
+    else
+        rc = emu_verify_final(op, NULL, 0, sig, siglen);
+
+    emu_op_release(op);
+    return rc;
+}
+
+CK_RV emu_op_verify_single(const unsigned char *state, size_t slen,
+                           const unsigned char *data, size_t dlen,
+                           const unsigned char *sig, size_t siglen)
+{
+    struct emu_op *op;
+    CK_RV rc = CKR_OK;
+
+    rc = emu_op_lookup(EMU_OP_VERIFY, state, slen, &op);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (!op->raw)
+        rc = emu_op_do_update(op, data, dlen, NULL, NULL);
+    if (rc == CKR_OK)
+        rc = emu_verify_final(op, data, dlen, sig, siglen);
+
+    emu_op_release(op);
+    return rc;
+}
+
+CK_RV emu_op_digest_key(const unsigned char *state, size_t slen,
+                        const unsigned char *key, size_t klen)
+{
+    struct emu_key k;
+    struct emu_op *op;
+    CK_RV rc;
+
+    rc = emu_op_lookup(EMU_OP_DIGEST, state, slen, &op);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = emu_key_decode(key, klen, &k);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (k.kclass != CKO_SECRET_KEY)
+        rc = CKR_KEY_INDIGESTIBLE;
+    else
+        rc = emu_op_do_update(op, k.value, k.value_len, NULL, NULL);
+
+    emu_key_free(&k);
+    return rc;
+}
+
+/*
+ * Key based single part operations
+ */
+
+CK_RV emu_crypt_oneshot(enum emu_op_kind kind, CK_MECHANISM_PTR mech,
+                        const struct emu_key *key,
+                        const unsigned char *in, size_t inlen,
+                        unsigned char *out, CK_ULONG_PTR outlen)
+{
+    struct emu_op op;
+    CK_RV rc;
+
+    if (outlen == NULL || (in == NULL && inlen > 0))
+        return CKR_ARGUMENTS_BAD;
+
+    memset(&op, 0, sizeof(op));
+    rc = emu_op_setup(&op, kind, mech, key);
+    if (rc == CKR_OK)
+        rc = emu_op_do_single(&op, in, inlen, out, outlen);
+
+    emu_op_cleanup(&op);
+    return rc;
+}
+
+CK_RV emu_key_oneshot(enum emu_op_kind kind, CK_MECHANISM_PTR mech,
+                      const unsigned char *key, size_t klen,
+                      const unsigned char *in, size_t inlen,
+                      unsigned char *out, CK_ULONG_PTR outlen)
+{
+    struct emu_key k;
+    CK_RV rc;
+
+    rc = emu_key_decode(key, klen, &k);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = emu_check_usage(kind, &k);
+    if (rc == CKR_OK)
+        rc = emu_crypt_oneshot(kind, mech, &k, in, inlen, out, outlen);
+
+    emu_key_free(&k);
+    return rc;
+}
+
+CK_RV emu_verify_oneshot(CK_MECHANISM_PTR mech,
+                         const unsigned char *key, size_t klen,
+                         const unsigned char *data, size_t dlen,
+                         const unsigned char *sig, size_t siglen)
+{
+    struct emu_key k;
+    struct emu_op op;
+    CK_RV rc;
+
+    if ((data == NULL && dlen > 0) || sig == NULL)
+        return CKR_ARGUMENTS_BAD;
+
+    rc = emu_key_decode(key, klen, &k);
+    if (rc != CKR_OK)
+        return rc;
+
+    memset(&op, 0, sizeof(op));
+    rc = emu_check_usage(EMU_OP_VERIFY, &k);
+    if (rc == CKR_OK)
+        rc = emu_op_setup(&op, EMU_OP_VERIFY, mech, &k);
+    if (rc == CKR_OK && !op.raw)
+        rc = emu_op_do_update(&op, data, dlen, NULL, NULL);
+    if (rc == CKR_OK)
+        rc = emu_verify_final(&op, data, dlen, sig, siglen);
+
+    emu_op_cleanup(&op);
+    emu_key_free(&k);
+    return rc;
+}
+
+CK_RV emu_digest_oneshot(CK_MECHANISM_PTR mech,
+                         const unsigned char *data, size_t dlen,
+                         unsigned char *digest, CK_ULONG_PTR dlenp)
+{
+    return emu_crypt_oneshot(EMU_OP_DIGEST, mech, NULL, data, dlen,
+                             digest, dlenp);
+}
+
+/*
+ * Check value of a secret key: the first bytes of an encrypted zero block
+ * for AES keys, and of the SHA-256 digest of the key value otherwise.
+ */
+CK_RV emu_check_value(const struct emu_key *key, unsigned char *csum)
+{
+    unsigned char zero[EMU_AES_BLOCK] = { 0 }, buf[EVP_MAX_MD_SIZE];
+    CK_MECHANISM mech = { CKM_AES_ECB, NULL, 0 };
+    CK_ULONG len = sizeof(buf);
+    CK_RV rc;
+
+    if (key->ktype == CKK_AES) {
+        rc = emu_crypt_oneshot(EMU_OP_ENCRYPT, &mech, key, zero, sizeof(zero),
+                               buf, &len);
+    } else {
+        mech.mechanism = CKM_SHA256;
+        rc = emu_digest_oneshot(&mech, key->value, key->value_len, buf, &len);
+    }
+    if (rc != CKR_OK)
+        return rc;
+
+    memcpy(csum, buf, EMU_CHECK_VALUE_BYTES);
+    return CKR_OK;
+}
@@ -0,0 +1,1164 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Software EP11 host library emulator: key blobs, MACed SPKIs, key
+ * generation, wrapping and blob attributes.
+ *
+ * A key blob is laid out like a real EP11 blob as far as the token looks
+ * into it: the session identifier in bytes 0..31 and the WKID at offset 32.
+ * The key value follows AES-256-CTR encrypted and the blob is protected by
+ * an HMAC-SHA256, both keys derived from the current wrapping key.
+ *
+ * A MACed SPKI is the DER encoded SPKI followed by the WKID as OCTET STRING,
+ * the boolean attributes and an HMAC-SHA256.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/rand.h>
+#include <openssl/hmac.h>
+#include <openssl/crypto.h>
+#include <openssl/objects.h>
+#include <openssl/x509.h>
+#include <openssl/ec.h>
+#include <openssl/rsa.h>
+
+#include "ep11emu.h"
+
+#define EMU_BLOB_MAGIC      0x454d554b  /* "EMUK" */
+#define EMU_SPKI_MAGIC      0x454d5550  /* "EMUP" */
+
+struct emu_blob_hdr {
+    unsigned char session[EMU_SESSION_BYTES];
+    unsigned char wkid[XCP_WKID_BYTES];     /* EP11_BLOB_WKID_OFFSET */
+    uint32_t magic;
+    uint32_t kclass;
+    uint32_t ktype;
+    uint32_t bits;
+    uint32_t flags;
+    unsigned char iv[16];
+    uint32_t value_len;
+};
+
+/* Trailer of a MACed SPKI after the DER encoded SPKI */
+struct emu_spki_trailer {
+    unsigned char tag[2];                   /* OCTET STRING, 16 bytes */
+    unsigned char wkid[XCP_WKID_BYTES];
+    uint32_t magic;
+    uint32_t flags;
+};
+
+static const struct {
+    CK_ATTRIBUTE_TYPE type;
+    uint32_t flag;
+} emu_bool_attrs[] = {
+    { CKA_ENCRYPT, EMU_F_ENCRYPT },
+    { CKA_DECRYPT, EMU_F_DECRYPT },
+    { CKA_SIGN, EMU_F_SIGN },
+    { CKA_VERIFY, EMU_F_VERIFY },
+    { CKA_WRAP, EMU_F_WRAP },
+    { CKA_UNWRAP, EMU_F_UNWRAP },
+    { CKA_DERIVE, EMU_F_DERIVE },
+    { CKA_EXTRACTABLE, EMU_F_EXTRACTABLE },
+    { CKA_NEVER_EXTRACTABLE, EMU_F_NEVER_EXTRACTABLE },
+    { CKA_SENSITIVE, EMU_F_SENSITIVE },
+    { CKA_ALWAYS_SENSITIVE, EMU_F_ALWAYS_SENSITIVE },
+    { CKA_MODIFIABLE, EMU_F_MODIFIABLE },
+    { CKA_LOCAL, EMU_F_LOCAL },
+    { CKA_TRUSTED, EMU_F_TRUSTED },
+    { CKA_WRAP_WITH_TRUSTED, EMU_F_WRAP_WITH_TRUSTED },
+    { CKA_SIGN_RECOVER, EMU_F_SIGN_RECOVER },
+    { CKA_VERIFY_RECOVER, EMU_F_VERIFY_RECOVER },
+    { CKA_IBM_RESTRICTABLE, EMU_F_RESTRICTABLE },
+    { CKA_IBM_ATTRBOUND, EMU_F_ATTRBOUND },
+    { CKA_IBM_USE_AS_DATA, EMU_F_USE_AS_DATA },
+    { CKA_IBM_PROTKEY_EXTRACTABLE, EMU_F_PROTKEY_EXTRACTABLE },
+    { CKA_IBM_PROTKEY_NEVER_EXTRACTABLE, EMU_F_PROTKEY_NEVER_EXTR },
+};
+
+#define EMU_NUM_BOOL_ATTRS  (sizeof(emu_bool_attrs) / sizeof(emu_bool_attrs[0]))
+
+static void emu_sha256(const void *label, size_t label_len,
+                       const void *data, size_t data_len, unsigned char *out)
+{
+    EVP_MD_CTX *md = EVP_MD_CTX_new();
+
+    if (md == NULL ||
+        EVP_DigestInit_ex(md, EVP_sha256(), NULL) != 1 ||
+        EVP_DigestUpdate(md, label, label_len) != 1 ||
+        EVP_DigestUpdate(md, data, data_len) != 1 ||
+        EVP_DigestFinal_ex(md, out, NULL) != 1)
+        abort();
+
+    EVP_MD_CTX_free(md);
+}
+
+void emu_wk_derive(struct emu_wk *wk, const char *seed)
+{
+    emu_sha256("ep11emu-wk", 10, seed, strlen(seed), wk->wk);
+    emu_sha256("", 0, wk->wk, sizeof(wk->wk), wk->wkvp);
+    emu_sha256("enc", 3, wk->wk, sizeof(wk->wk), wk->enc_key);
+    emu_sha256("mac", 3, wk->wk, sizeof(wk->wk), wk->mac_key);
+    wk->set = 1;
+}
+
+static void emu_mac(const struct emu_wk *wk, const unsigned char *data,
+                    size_t len, unsigned char *mac)
+{
+    unsigned int maclen = EMU_MAC_BYTES;
+
+    HMAC(EVP_sha256(), wk->mac_key, sizeof(wk->mac_key), data, len,
+         mac, &maclen);
+}
+
+static CK_RV emu_ctr_crypt(const struct emu_wk *wk, const unsigned char *iv,
+                           const unsigned char *in, size_t len,
+                           unsigned char *out)
+{
+    EVP_CIPHER_CTX *ctx;
+    int outl;
+    CK_RV rc = CKR_OK;
+
+    if (len == 0)
+        return CKR_OK;
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL)
+        return CKR_HOST_MEMORY;
+
+    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), NULL, wk->enc_key,
+                           iv) != 1 ||
+        EVP_EncryptUpdate(ctx, out, &outl, in, len) != 1)
+        rc = CKR_FUNCTION_FAILED;
+
+    EVP_CIPHER_CTX_free(ctx);
+    return rc;
+}
+
+void emu_key_free(struct emu_key *key)
+{
+    if (key->value != NULL) {
+        OPENSSL_cleanse(key->value, key->value_len);
+        free(key->value);
+    }
+    EVP_PKEY_free(key->pkey);
+    memset(key, 0, sizeof(*key));
+}
+
+static int emu_is_spki(const unsigned char *blob, size_t blob_len)
+{
+    /* Session identifiers never start with 0x30 (SEQUENCE) */
+    return blob_len > 5 && blob[0] == 0x30;
+}
+
+static CK_RV emu_check_wkid(const unsigned char *wkid)
+{
+    if (memcmp(wkid, emu_cfg.cur_wk.wkvp, XCP_WKID_BYTES) != 0)
+        return CKR_IBM_WKID_MISMATCH;
+
+    return CKR_OK;
+}
+
+/*
+ * Verifies a MACed SPKI and returns the length of the SPKI part and the
+ * trailer. The public key is returned in *pkey if pkey is not NULL.
+ */
+static CK_RV emu_spki_open(const unsigned char *blob, size_t blob_len,
+                           size_t *spki_len, struct emu_spki_trailer *trl,
+                           EVP_PKEY **pkey)
+{
+    const unsigned char *p = blob;
+    unsigned char mac[EMU_MAC_BYTES];
+    EVP_PKEY *pub;
+    CK_RV rc;
+
+    pub = d2i_PUBKEY(NULL, &p, blob_len);
+    if (pub == NULL)
+        return CKR_KEY_HANDLE_INVALID;
+    *spki_len = p - blob;
+
+    if (blob_len != *spki_len + sizeof(*trl) + EMU_MAC_BYTES) {
+        rc = CKR_KEY_HANDLE_INVALID;
+        goto err;
+    }
+
+    memcpy(trl, blob + *spki_len, sizeof(*trl));
+    if (trl->magic != EMU_SPKI_MAGIC) {
+        rc = CKR_KEY_HANDLE_INVALID;
+        goto err;
+    }
+
+    rc = emu_check_wkid(trl->wkid);
+    if (rc != CKR_OK)
+        goto err;
+
+    emu_mac(&emu_cfg.cur_wk, blob, blob_len - EMU_MAC_BYTES, mac);
+    if (CRYPTO_memcmp(mac, blob + blob_len - EMU_MAC_BYTES,
+                      EMU_MAC_BYTES) != 0) {
+        rc = CKR_KEY_HANDLE_INVALID;
+        goto err;
+    }
+
+    if (pkey != NULL)
+        *pkey = pub;
+    else
+        EVP_PKEY_free(pub);
+    return CKR_OK;
+
+err:
+    EVP_PKEY_free(pub);
+    return rc;
+}
+
+static CK_RV emu_spki_seal(const struct emu_wk *wk,
+                           const unsigned char *spki, size_t spki_len,
+                           uint32_t flags, unsigned char *blob,
+                           size_t *blob_len)
+{
+    struct emu_spki_trailer trl;
+    size_t len = spki_len + sizeof(trl) + EMU_MAC_BYTES;
+
+    if (blob == NULL) {
+        *blob_len = len;
+        return CKR_OK;
+    }
+    if (*blob_len < len) {
+        *blob_len = len;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memset(&trl, 0, sizeof(trl));
+    trl.tag[0] = 0x04;
+    trl.tag[1] = XCP_WKID_BYTES;
+    memcpy(trl.wkid, wk->wkvp, XCP_WKID_BYTES);
+    trl.magic = EMU_SPKI_MAGIC;
+    trl.flags = flags;
+
+    memmove(blob, spki, spki_len);
+    memcpy(blob + spki_len, &trl, sizeof(trl));
+    emu_mac(wk, blob, len - EMU_MAC_BYTES, blob + len - EMU_MAC_BYTES);
+    *blob_len = len;
+
+    return CKR_OK;
+}
+
+/*
+ * Verifies a key blob and returns its header and the decrypted key value.
+ */
+static CK_RV emu_blob_open(const unsigned char *blob, size_t blob_len,
+                           struct emu_blob_hdr *hdr, unsigned char **value)
+{
+    unsigned char mac[EMU_MAC_BYTES];
+    CK_RV rc;
+
+    *value = NULL;
+
+    if (blob == NULL || blob_len < sizeof(*hdr) + EMU_MAC_BYTES)
+        return CKR_KEY_HANDLE_INVALID;
+
+    memcpy(hdr, blob, sizeof(*hdr));
+    if (hdr->magic != EMU_BLOB_MAGIC ||
+        blob_len != sizeof(*hdr) + hdr->value_len + EMU_MAC_BYTES)
+        return CKR_KEY_HANDLE_INVALID;
+
+    rc = emu_check_wkid(hdr->wkid);
+    if (rc != CKR_OK)
+        return rc;
+
+    emu_mac(&emu_cfg.cur_wk, blob, blob_len - EMU_MAC_BYTES, mac);
+    if (CRYPTO_memcmp(mac, blob + blob_len - EMU_MAC_BYTES,
+                      EMU_MAC_BYTES) != 0)
+        return CKR_KEY_HANDLE_INVALID;
+
+    *value = malloc(hdr->value_len > 0 ? hdr->value_len : 1);
+    if (*value == NULL)
+        return CKR_HOST_MEMORY;
+
+    rc = emu_ctr_crypt(&emu_cfg.cur_wk, hdr->iv, blob + sizeof(*hdr),
+                       hdr->value_len, *value);
+    if (rc != CKR_OK) {
+        free(*value);
+        *value = NULL;
+    }
+
+    return rc;
+}
+
+static CK_RV emu_blob_seal(const struct emu_wk *wk, struct emu_blob_hdr *hdr,
+                           const unsigned char *value, unsigned char *blob,
+                           size_t *blob_len)
+{
+    size_t len = sizeof(*hdr) + hdr->value_len + EMU_MAC_BYTES;
+    CK_RV rc;
+
+    if (blob == NULL) {
+        *blob_len = len;
+        return CKR_OK;
+    }
+    if (*blob_len < len) {
+        *blob_len = len;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(hdr->wkid, wk->wkvp, XCP_WKID_BYTES);
+    hdr->magic = EMU_BLOB_MAGIC;
+    if (RAND_bytes(hdr->iv, sizeof(hdr->iv)) != 1)
+        return CKR_FUNCTION_FAILED;
+
+    memcpy(blob, hdr, sizeof(*hdr));
+    rc = emu_ctr_crypt(wk, hdr->iv, value, hdr->value_len,
+                       blob + sizeof(*hdr));
+    if (rc != CKR_OK)
+        return rc;
+
+    emu_mac(wk, blob, len - EMU_MAC_BYTES, blob + len - EMU_MAC_BYTES);
+    *blob_len = len;
+
+    return CKR_OK;
+}
+
+static CK_KEY_TYPE emu_pkey_type(const EVP_PKEY *pkey)
+{
+    switch (EVP_PKEY_id(pkey)) {
+    case EVP_PKEY_RSA:
+        return CKK_RSA;
+    case EVP_PKEY_EC:
+        return CKK_EC;
+    default:
+        return CK_UNAVAILABLE_INFORMATION;
+    }
+}
+
+CK_RV emu_key_decode(const unsigned char *blob, size_t blob_len,
+                     struct emu_key *key)
+{
+    struct emu_spki_trailer trl;
+    struct emu_blob_hdr hdr;
+    const unsigned char *p;
+    unsigned char *value;
+    size_t spki_len;
+    CK_RV rc;
+
+    memset(key, 0, sizeof(*key));
+
+    if (blob == NULL)
+        return CKR_KEY_HANDLE_INVALID;
+
+    if (emu_is_spki(blob, blob_len)) {
+        rc = emu_spki_open(blob, blob_len, &spki_len, &trl, &key->pkey);
+        if (rc != CKR_OK)
+            return rc;
+
+        key->kclass = CKO_PUBLIC_KEY;
+        key->ktype = emu_pkey_type(key->pkey);
+        key->bits = EVP_PKEY_bits(key->pkey);
+        key->flags = trl.flags;
+        return CKR_OK;
+    }
+
+    rc = emu_blob_open(blob, blob_len, &hdr, &value);
+    if (rc != CKR_OK)
+        return rc;
+
+    key->kclass = hdr.kclass;
+    key->ktype = hdr.ktype;
+    key->bits = hdr.bits;
+    key->flags = hdr.flags;
+    memcpy(key->session, hdr.session, sizeof(key->session));
+
+    if (hdr.kclass == CKO_PRIVATE_KEY) {
+        p = value;
+        key->pkey = d2i_AutoPrivateKey(NULL, &p, hdr.value_len);
+        OPENSSL_cleanse(value, hdr.value_len);
+        free(value);
+        if (key->pkey == NULL)
+            return CKR_KEY_HANDLE_INVALID;
+    } else {
+        key->value = value;
+        key->value_len = hdr.value_len;
+    }
+
+    return CKR_OK;
+}
+
+CK_RV emu_key_encode(const struct emu_wk *wk, const struct emu_key *key,
+                     unsigned char *blob, size_t *blob_len)
+{
+    struct emu_blob_hdr hdr;
+    unsigned char *der = NULL;
+    int der_len;
+    CK_RV rc;
+
+    if (key->kclass == CKO_PUBLIC_KEY) {
+        der_len = i2d_PUBKEY(key->pkey, &der);
+        if (der_len <= 0)
+            return CKR_FUNCTION_FAILED;
+
+        rc = emu_spki_seal(wk, der, der_len, key->flags, blob, blob_len);
+        OPENSSL_free(der);
+        return rc;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.session, key->session, sizeof(hdr.session));
+    hdr.kclass = key->kclass;
+    hdr.ktype = key->ktype;
+    hdr.bits = key->bits;
+    hdr.flags = key->flags;
+
+    if (key->kclass == CKO_PRIVATE_KEY) {
+        der_len = i2d_PrivateKey(key->pkey, &der);
+        if (der_len <= 0)
+            return CKR_FUNCTION_FAILED;
+
+        hdr.value_len = der_len;
+        rc = emu_blob_seal(wk, &hdr, der, blob, blob_len);
+        OPENSSL_clear_free(der, der_len);
+        return rc;
+    }
+
+    hdr.value_len = key->value_len;
+    return emu_blob_seal(wk, &hdr, key->value, blob, blob_len);
+}
+
+/*
+ * Re-enciphers a key blob or MACed SPKI from the current to the next WK,
+ * as done by the XCP_ADM_REENCRYPT administrative command.
+ */
+CK_RV emu_blob_reencrypt(const unsigned char *blob, size_t blob_len,
+                         unsigned char *out, size_t *out_len)
+{
+    struct emu_spki_trailer trl;
+    struct emu_blob_hdr hdr;
+    unsigned char *value;
+    size_t spki_len;
+    CK_RV rc;
+
+    if (!emu_cfg.next_wk.set)
+        return CKR_IBM_WK_NOT_INITIALIZED;
+
+    if (emu_is_spki(blob, blob_len)) {
+        rc = emu_spki_open(blob, blob_len, &spki_len, &trl, NULL);
+        if (rc != CKR_OK)
+            return rc;
+
+        return emu_spki_seal(&emu_cfg.next_wk, blob, spki_len, trl.flags,
+                             out, out_len);
+    }
+
+    rc = emu_blob_open(blob, blob_len, &hdr, &value);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = emu_blob_seal(&emu_cfg.next_wk, &hdr, value, out, out_len);
+    OPENSSL_cleanse(value, hdr.value_len);
+    free(value);
+
+    return rc;
+}
+
+/*
+ * Templates
+ */
+
+const CK_ATTRIBUTE *emu_find_attr(const CK_ATTRIBUTE *templ, CK_ULONG count,
+                                  CK_ATTRIBUTE_TYPE type)
+{
+    CK_ULONG i;
+
+    for (i = 0; templ != NULL && i < count; i++) {
+        if (templ[i].type == type)
+            return &templ[i];
+    }
+
+    return NULL;
+}
+
+CK_RV emu_get_ulong_attr(const CK_ATTRIBUTE *templ, CK_ULONG count,
+                         CK_ATTRIBUTE_TYPE type, CK_ULONG *value)
+{
+    const CK_ATTRIBUTE *attr = emu_find_attr(templ, count, type);
+
+    if (attr == NULL)
+        return CKR_TEMPLATE_INCOMPLETE;
+    if (attr->pValue == NULL || attr->ulValueLen != sizeof(CK_ULONG))
+        return CKR_ATTRIBUTE_VALUE_INVALID;
+
+    *value = *(CK_ULONG *)attr->pValue;
+    return CKR_OK;
+}
+
+uint32_t emu_flags_from_template(uint32_t flags, const CK_ATTRIBUTE *templ,
+                                 CK_ULONG count)
+{
+    const CK_ATTRIBUTE *attr;
+    CK_ULONG i;
+
+    for (i = 0; i < EMU_NUM_BOOL_ATTRS; i++) {
+        attr = emu_find_attr(templ, count, emu_bool_attrs[i].type);
+        if (attr == NULL || attr->pValue == NULL ||
+            attr->ulValueLen != sizeof(CK_BBOOL))
+            continue;
+
+        if (*(CK_BBOOL *)attr->pValue)
+            flags |= emu_bool_attrs[i].flag;
+        else
+            flags &= ~emu_bool_attrs[i].flag;
+    }
+
+    return flags;
+}
+
+static uint32_t emu_new_key_flags(const CK_ATTRIBUTE *templ, CK_ULONG count,
+                                  CK_BBOOL local)
+{
+    uint32_t flags;
+
+    flags = emu_flags_from_template(EMU_F_DEFAULT, templ, count);
+    flags &= ~(EMU_F_LOCAL | EMU_F_NEVER_EXTRACTABLE |
+               EMU_F_ALWAYS_SENSITIVE);
+
+    if (local) {
+        flags |= EMU_F_LOCAL;
+        if ((flags & EMU_F_EXTRACTABLE) == 0)
+            flags |= EMU_F_NEVER_EXTRACTABLE;
+        if (flags & EMU_F_SENSITIVE)
+            flags |= EMU_F_ALWAYS_SENSITIVE;
+    }
+
+    return flags;
+}
+
+static void emu_session_from_pin(const unsigned char *pin, size_t pinlen,
+                                 unsigned char *session)
+{
+    memset(session, 0, EMU_SESSION_BYTES);
+    if (pin != NULL && pinlen >= EMU_SESSION_BYTES)
+        memcpy(session, pin, EMU_SESSION_BYTES);
+}
+
+static CK_RV emu_secret_csum(const struct emu_key *key, unsigned char *csum,
+                             size_t *clen)
+{
+    CK_RV rc;
+
+    if (csum == NULL || clen == NULL)
+        return CKR_OK;
+    if (*clen < EMU_CSUM_BYTES) {
+        *clen = EMU_CSUM_BYTES;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    /* check value, followed by the key bit length in big endian */
+    rc = emu_check_value(key, csum);
+    if (rc != CKR_OK)
+        return rc;
+    csum[3] = (key->bits >> 24) & 0xff;
+    csum[4] = (key->bits >> 16) & 0xff;
+    csum[5] = (key->bits >> 8) & 0xff;
+    csum[6] = key->bits & 0xff;
+    *clen = EMU_CSUM_BYTES;
+
+    return CKR_OK;
+}
+
+/*
+ * Key generation
+ */
+
+CK_RV emu_generate_key(CK_MECHANISM_PTR mech, CK_ATTRIBUTE_PTR templ,
+                       CK_ULONG count, const unsigned char *pin,
+                       size_t pinlen, unsigned char *key, size_t *klen,
+                       unsigned char *csum, size_t *clen)
+{
+    struct emu_key k;
+    CK_ULONG len, ktype;
+    CK_RV rc;
+
+    if (mech == NULL || klen == NULL)
+        return CKR_ARGUMENTS_BAD;
+
+    memset(&k, 0, sizeof(k));
+
+    rc = emu_get_ulong_attr(templ, count, CKA_VALUE_LEN, &len);
+    if (rc != CKR_OK)
+        return rc;
+
+    switch (mech->mechanism) {
+    case CKM_AES_KEY_GEN:
+        if (len != 16 && len != 24 && len != 32)
+            return CKR_ATTRIBUTE_VALUE_INVALID;
+        ktype = CKK_AES;
+        break;
+    case CKM_GENERIC_SECRET_KEY_GEN:
+        if (len == 0 || len > 256)
+            return CKR_ATTRIBUTE_VALUE_INVALID;
+        if (emu_get_ulong_attr(templ, count, CKA_KEY_TYPE,
+                               &ktype) != CKR_OK)
+            ktype = CKK_GENERIC_SECRET;
+        break;
+    default:
+        return CKR_MECHANISM_INVALID;
+    }
+
+    k.kclass = CKO_SECRET_KEY;
+    k.ktype = ktype;
+    k.bits = len * 8;
+    k.flags = emu_new_key_flags(templ, count, TRUE);
+    emu_session_from_pin(pin, pinlen, k.session);
+
+    k.value = malloc(len);
+    if (k.value == NULL)
+        return CKR_HOST_MEMORY;
+    k.value_len = len;
+
+    if (RAND_bytes(k.value, len) != 1) {
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    rc = emu_key_encode(&emu_cfg.cur_wk, &k, key, klen);
+    if (rc != CKR_OK || key == NULL)
+        goto out;
+
+    rc = emu_secret_csum(&k, csum, clen);
+
+out:
+    emu_key_free(&k);
+    return rc;
+}
+
+static CK_RV emu_rsa_keygen(EVP_PKEY_CTX *ctx, const CK_ATTRIBUTE *pub,
+                            CK_ULONG pubcount)
+{
+    const CK_ATTRIBUTE *exp;
+    CK_ULONG bits;
+    BIGNUM *e;
+    CK_RV rc;
+
+    rc = emu_get_ulong_attr(pub, pubcount, CKA_MODULUS_BITS, &bits);
+    if (rc != CKR_OK)
+        return rc;
+    if (bits < 512 || bits > 4096)
+        return CKR_KEY_SIZE_RANGE;
+
+    if (EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, bits) <= 0)
+        return CKR_FUNCTION_FAILED;
+
+    exp = emu_find_attr(pub, pubcount, CKA_PUBLIC_EXPONENT);
+    if (exp == NULL || exp->ulValueLen == 0)
+        return CKR_OK;
+
+    e = BN_bin2bn(exp->pValue, exp->ulValueLen, NULL);
+    if (e == NULL)
+        return CKR_HOST_MEMORY;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    rc = EVP_PKEY_CTX_set1_rsa_keygen_pubexp(ctx, e) <= 0 ?
+                                        CKR_ATTRIBUTE_VALUE_INVALID : CKR_OK;
+    BN_free(e);
+#else
+    /* ctx takes ownership of e on success */
+    if (EVP_PKEY_CTX_set_rsa_keygen_pubexp(ctx, e) <= 0) {
+        BN_free(e);
+        return CKR_ATTRIBUTE_VALUE_INVALID;
+    }
+    rc = CKR_OK;
+#endif
+
+    return rc;
+}
+
+static CK_RV emu_ec_keygen(EVP_PKEY_CTX *ctx, const CK_ATTRIBUTE *pub,
+                           CK_ULONG pubcount)
+{
+    const CK_ATTRIBUTE *params;
+    const unsigned char *p;
+    ASN1_OBJECT *oid;
+    EC_GROUP *group;
+    int nid;
+
+    params = emu_find_attr(pub, pubcount, CKA_EC_PARAMS);
+    if (params == NULL || params->pValue == NULL)
+        return CKR_TEMPLATE_INCOMPLETE;
+
+    p = params->pValue;
+    oid = d2i_ASN1_OBJECT(NULL, &p, params->ulValueLen);
+    if (oid == NULL)
+        return CKR_CURVE_NOT_SUPPORTED;
+    nid = OBJ_obj2nid(oid);
+    ASN1_OBJECT_free(oid);
+
+    /* only Weierstrass curves are emulated */
+    group = EC_GROUP_new_by_curve_name(nid);
+    if (group == NULL)
+        return CKR_CURVE_NOT_SUPPORTED;
+    EC_GROUP_free(group);
+
+    if (
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, nid) <= 0 ||
+        EVP_PKEY_CTX_set_ec_param_enc(ctx, OPENSSL_EC_NAMED_CURVE) <= 0)
+        return CKR_CURVE_NOT_SUPPORTED;
+
+    return CKR_OK;
+}
+
+CK_RV emu_generate_key_pair(CK_MECHANISM_PTR mech,
+                            CK_ATTRIBUTE_PTR pub, CK_ULONG pubcount,
+                            CK_ATTRIBUTE_PTR priv, CK_ULONG privcount,
+                            const unsigned char *pin, size_t pinlen,
+                            unsigned char *key, size_t *klen,
+                            unsigned char *pubkey, size_t *pklen)
+{
+    struct emu_key privk, pubk;
+    EVP_PKEY_CTX *ctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    CK_KEY_TYPE ktype;
+    CK_RV rc;
+
+    if (mech == NULL || klen == NULL || pklen == NULL)
+        return CKR_ARGUMENTS_BAD;
+
+    switch (mech->mechanism) {
+    case CKM_RSA_PKCS_KEY_PAIR_GEN:
+        ktype = CKK_RSA;
+        ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+        break;
+    case CKM_EC_KEY_PAIR_GEN:
+        ktype = CKK_EC;
+        ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+        break;
+    default:
+        return CKR_MECHANISM_INVALID;
+    }
+
+    if (ctx == NULL)
+        return CKR_HOST_MEMORY;
+
+    if (EVP_PKEY_keygen_init(ctx) <= 0) {
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    if (ktype == CKK_RSA)
+        rc = emu_rsa_keygen(ctx, pub, pubcount);
+    else
+        rc = emu_ec_keygen(ctx, pub, pubcount);
+    if (rc != CKR_OK)
+        goto out;
+
+    if (EVP_PKEY_keygen(ctx, &pkey) <= 0) {
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    memset(&privk, 0, sizeof(privk));
+    privk.kclass = CKO_PRIVATE_KEY;
+    privk.ktype = ktype;
+    privk.bits = EVP_PKEY_bits(pkey);
+    privk.flags = emu_new_key_flags(priv, privcount, TRUE);
+    privk.pkey = pkey;
+    emu_session_from_pin(pin, pinlen, privk.session);
+
+    pubk = privk;
+    pubk.kclass = CKO_PUBLIC_KEY;
+    pubk.flags = emu_new_key_flags(pub, pubcount, TRUE);
+
+    rc = emu_key_encode(&emu_cfg.cur_wk, &privk, key, klen);
+    if (rc != CKR_OK)
+        goto out;
+
+    rc = emu_key_encode(&emu_cfg.cur_wk, &pubk, pubkey, pklen);
+
+out:
+    EVP_PKEY_free(pkey);
+    EVP_PKEY_CTX_free(ctx);
+    return rc;
+}
+
+/*
+ * Wrapping
+ */
+
+static CK_RV emu_private_key_der(EVP_PKEY *pkey, unsigned char **der,
+                                 int *der_len)
+{
+    PKCS8_PRIV_KEY_INFO *p8;
+
+    p8 = EVP_PKEY2PKCS8(pkey);
+    if (p8 == NULL)
+        return CKR_FUNCTION_FAILED;
+
+    *der = NULL;
+    *der_len = i2d_PKCS8_PRIV_KEY_INFO(p8, der);
+    PKCS8_PRIV_KEY_INFO_free(p8);
+
+    return *der_len > 0 ? CKR_OK : CKR_FUNCTION_FAILED;
+}
+
+CK_RV emu_wrap_key(const unsigned char *key, size_t keylen,
+                   const unsigned char *kek, size_t keklen,
+                   CK_MECHANISM_PTR mech,
+                   CK_BYTE_PTR wrapped, CK_ULONG_PTR wlen)
+{
+    struct emu_key k, w;
+    unsigned char *der = NULL;
+    const unsigned char *clear;
+    size_t clear_len;
+    int der_len = 0;
+    CK_RV rc;
+
+    if (mech == NULL || wlen == NULL)
+        return CKR_ARGUMENTS_BAD;
+
+    rc = emu_key_decode(key, keylen, &k);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = emu_key_decode(kek, keklen, &w);
+    if (rc != CKR_OK) {
+        emu_key_free(&k);
+        return rc == CKR_KEY_HANDLE_INVALID ?
+                        CKR_WRAPPING_KEY_HANDLE_INVALID : rc;
+    }
+
+    if ((k.flags & EMU_F_EXTRACTABLE) == 0) {
+        rc = CKR_KEY_UNEXTRACTABLE;
+        goto out;
+    }
+    if ((w.flags & EMU_F_WRAP) == 0) {
+        rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
+        goto out;
+    }
+
+    switch (k.kclass) {
+    case CKO_SECRET_KEY:
+        clear = k.value;
+        clear_len = k.value_len;
+        break;
+    case CKO_PRIVATE_KEY:
+        rc = emu_private_key_der(k.pkey, &der, &der_len);
+        if (rc != CKR_OK)
+            goto out;
+        clear = der;
+        clear_len = der_len;
+        break;
+    default:
+        rc = CKR_KEY_NOT_WRAPPABLE;
+        goto out;
+    }
+
+    rc = emu_crypt_oneshot(EMU_OP_ENCRYPT, mech, &w, clear, clear_len,
+                           wrapped, wlen);
+
+out:
+    if (der != NULL)
+        OPENSSL_clear_free(der, der_len);
+    emu_key_free(&k);
+    emu_key_free(&w);
+    return rc;
+}
+
+static CK_RV emu_unwrap_spki(const CK_BYTE_PTR spki, CK_ULONG spki_len,
+                             CK_ATTRIBUTE_PTR templ, CK_ULONG count,
+                             unsigned char *unwrapped, size_t *uwlen,
+                             CK_ULONG *cslen)
+{
+    const unsigned char *p = spki;
+    EVP_PKEY *pkey;
+    uint32_t flags;
+
+    pkey = d2i_PUBKEY(NULL, &p, spki_len);
+    if (pkey == NULL)
+        return CKR_WRAPPED_KEY_INVALID;
+    EVP_PKEY_free(pkey);
+
+    if (cslen != NULL)
+        *cslen = 0;
+
+    flags = emu_new_key_flags(templ, count, FALSE);
+    return emu_spki_seal(&emu_cfg.cur_wk, spki, p - spki, flags,
+                         unwrapped, uwlen);
+}
+
+CK_RV emu_unwrap_key(const CK_BYTE_PTR wrapped, CK_ULONG wlen,
+                     const unsigned char *kek, size_t keklen,
+                     const unsigned char *pin, size_t pinlen,
+                     CK_MECHANISM_PTR mech,
+                     CK_ATTRIBUTE_PTR templ, CK_ULONG count,
+                     unsigned char *unwrapped, size_t *uwlen,
+                     CK_BYTE_PTR csum, CK_ULONG *cslen)
+{
+    struct emu_key k, w, pubk;
+    unsigned char *clear = NULL;
+    const unsigned char *p;
+    CK_ULONG clear_len = wlen, len;
+    size_t spki_len;
+    CK_RV rc;
+
+    if (mech == NULL || wrapped == NULL || uwlen == NULL)
+        return CKR_ARGUMENTS_BAD;
+
+    if (mech->mechanism == CKM_IBM_TRANSPORTKEY)
+        return emu_unwrap_spki(wrapped, wlen, templ, count, unwrapped, uwlen,
+                               cslen);
+
+    memset(&k, 0, sizeof(k));
+
+    rc = emu_key_decode(kek, keklen, &w);
+    if (rc != CKR_OK)
+        return rc == CKR_KEY_HANDLE_INVALID ?
+                        CKR_UNWRAPPING_KEY_HANDLE_INVALID : rc;
+
+    if ((w.flags & EMU_F_UNWRAP) == 0) {
+        rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
+        goto out;
+    }
+
+    if (emu_get_ulong_attr(templ, count, CKA_CLASS, &k.kclass) != CKR_OK)
+        k.kclass = CKO_SECRET_KEY;
+    rc = emu_get_ulong_attr(templ, count, CKA_KEY_TYPE, &k.ktype);
+    if (rc != CKR_OK)
+        goto out;
+
+    clear = malloc(wlen > 0 ? wlen : 1);
+    if (clear == NULL) {
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    rc = emu_crypt_oneshot(EMU_OP_DECRYPT, mech, &w, wrapped, wlen,
+                           clear, &clear_len);
+    if (rc != CKR_OK)
+        goto out;
+
+    k.flags = emu_new_key_flags(templ, count, FALSE);
+    emu_session_from_pin(pin, pinlen, k.session);
+
+    switch (k.kclass) {
+    case CKO_SECRET_KEY:
+        /* a zero CKA_VALUE_LEN means the length of the unwrapped data */
+        if (emu_get_ulong_attr(templ, count, CKA_VALUE_LEN, &len) == CKR_OK &&
+            len != 0) {
+            if (len > clear_len) {
+                rc = CKR_WRAPPED_KEY_LEN_RANGE;
+                goto out;
+            }
+            clear_len = len;
+        }
+        if (k.ktype == CKK_AES && clear_len != 16 && clear_len != 24 &&
+            clear_len != 32) {
+            rc = CKR_WRAPPED_KEY_LEN_RANGE;
+            goto out;
+        }
+
+        k.value = clear;
+        k.value_len = clear_len;
+        k.bits = clear_len * 8;
+        clear = NULL;
+
+        rc = emu_key_encode(&emu_cfg.cur_wk, &k, unwrapped, uwlen);
+        if (rc == CKR_OK && unwrapped != NULL && cslen != NULL) {
+            spki_len = *cslen;
+            rc = emu_secret_csum(&k, csum, &spki_len);
+            *cslen = spki_len;
+        }
+        break;
+
+    case CKO_PRIVATE_KEY:
+        p = clear;
+        k.pkey = d2i_AutoPrivateKey(NULL, &p, clear_len);
+        if (k.pkey == NULL || emu_pkey_type(k.pkey) != k.ktype) {
+            /* Edwards and Montgomery curves are not emulated */
+            rc = k.ktype == CKK_EC ? CKR_CURVE_NOT_SUPPORTED :
+                                     CKR_WRAPPED_KEY_INVALID;
+            goto out;
+        }
+        k.bits = EVP_PKEY_bits(k.pkey);
+
+        rc = emu_key_encode(&emu_cfg.cur_wk, &k, unwrapped, uwlen);
+        if (rc != CKR_OK || unwrapped == NULL || cslen == NULL)
+            break;
+
+        /* The checksum of an unwrapped private key is its MACed SPKI */
+        pubk = k;
+        pubk.kclass = CKO_PUBLIC_KEY;
+        pubk.flags = EMU_F_DEFAULT;
+        spki_len = *cslen;
+        rc = emu_key_encode(&emu_cfg.cur_wk, &pubk, csum, &spki_len);
+        *cslen = spki_len;
+        break;
+
+    default:
+        rc = CKR_TEMPLATE_INCONSISTENT;
+        break;
+    }
+
+out:
+    if (clear != NULL) {
+        OPENSSL_cleanse(clear, wlen);
+        free(clear);
+    }
+    emu_key_free(&k);
+    emu_key_free(&w);
+    return rc;
+}
+
+/*
+ * Blob attributes
+ */
+
+static CK_RV emu_set_attr_value(CK_ATTRIBUTE_PTR attr, const void *value,
+                                CK_ULONG len)
+{
+    if (attr->pValue == NULL) {
+        attr->ulValueLen = len;
+        return CKR_OK;
+    }
+    if (attr->ulValueLen < len) {
+        attr->ulValueLen = CK_UNAVAILABLE_INFORMATION;
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(attr->pValue, value, len);
+    attr->ulValueLen = len;
+    return CKR_OK;
+}
+
+static CK_RV emu_get_attr(const struct emu_key *key, CK_ATTRIBUTE_PTR attr)
+{
+    unsigned char *der = NULL;
+    CK_ULONG ulval;
+    CK_BBOOL bval;
+    CK_ULONG i;
+    int der_len;
+    CK_RV rc;
+
+    for (i = 0; i < EMU_NUM_BOOL_ATTRS; i++) {
+        if (emu_bool_attrs[i].type == attr->type) {
+            bval = (key->flags & emu_bool_attrs[i].flag) ? CK_TRUE : CK_FALSE;
+            return emu_set_attr_value(attr, &bval, sizeof(bval));
+        }
+    }
+
+    switch (attr->type) {
+    case CKA_CLASS:
+        return emu_set_attr_value(attr, &key->kclass, sizeof(CK_ULONG));
+    case CKA_KEY_TYPE:
+        return emu_set_attr_value(attr, &key->ktype, sizeof(CK_ULONG));
+    case CKA_VALUE_LEN:
+        if (key->kclass != CKO_SECRET_KEY)
+            break;
+        ulval = key->value_len;
+        return emu_set_attr_value(attr, &ulval, sizeof(ulval));
+    case CKA_MODULUS_BITS:
+        if (key->ktype != CKK_RSA)
+            break;
+        return emu_set_attr_value(attr, &key->bits, sizeof(CK_ULONG));
+    case CKA_IBM_STD_COMPLIANCE1:
+        ulval = 0;
+        return emu_set_attr_value(attr, &ulval, sizeof(ulval));
+    case CKA_PUBLIC_KEY_INFO:
+        if (key->pkey == NULL)
+            break;
+        der_len = i2d_PUBKEY(key->pkey, &der);
+        if (der_len <= 0)
+            return CKR_FUNCTION_FAILED;
+        rc = emu_set_attr_value(attr, der, der_len);
+        OPENSSL_free(der);
+        return rc;
+    default:
+        break;
+    }
+
+    attr->ulValueLen = CK_UNAVAILABLE_INFORMATION;
+    return CKR_OK;
+}
+
+CK_RV emu_get_attribute_value(const unsigned char *obj, size_t olen,
+                              CK_ATTRIBUTE_PTR templ, CK_ULONG count)
+{
+    struct emu_key key;
+    CK_RV rc, rc2 = CKR_OK;
+    CK_ULONG i;
+
+    if (templ == NULL && count > 0)
+        return CKR_ARGUMENTS_BAD;
+
+    rc = emu_key_decode(obj, olen, &key);
+    if (rc != CKR_OK)
+        return rc;
+
+    for (i = 0; i < count; i++) {
+        rc = emu_get_attr(&key, &templ[i]);
+        if (rc == CKR_BUFFER_TOO_SMALL)
+            rc2 = rc;
+        else if (rc != CKR_OK)
+            break;
+        rc = CKR_OK;
+    }
+
+    emu_key_free(&key);
+    return rc != CKR_OK ? rc : rc2;
+}
+
+CK_RV emu_set_attribute_value(unsigned char *obj, size_t olen,
+                              CK_ATTRIBUTE_PTR templ, CK_ULONG count)
+{
+    struct emu_spki_trailer trl;
+    struct emu_blob_hdr hdr;
+    unsigned char *value;
+    size_t spki_len, len = olen;
+    CK_ULONG i;
+    CK_RV rc;
+
+    if (obj == NULL || (templ == NULL && count > 0))
+        return CKR_ARGUMENTS_BAD;
+
+    /* Only boolean attributes can be changed */
+    for (i = 0; i < count; i++) {
+        if (templ[i].ulValueLen != sizeof(CK_BBOOL) ||
+            emu_flags_from_template(0, &templ[i], 1) ==
+                        emu_flags_from_template(~0U, &templ[i], 1))
+            return CKR_ATTRIBUTE_TYPE_INVALID;
+    }
+
+    if (emu_is_spki(obj, olen)) {
+        rc = emu_spki_open(obj, olen, &spki_len, &trl, NULL);
+        if (rc != CKR_OK)
+            return rc;
+
+        if ((trl.flags & EMU_F_MODIFIABLE) == 0)
+            return CKR_ATTRIBUTE_READ_ONLY;
+
+        return emu_spki_seal(&emu_cfg.cur_wk, obj, spki_len,
+                             emu_flags_from_template(trl.flags, templ, count),
+                             obj, &len);
+    }
+
+    rc = emu_blob_open(obj, olen, &hdr, &value);
+    if (rc != CKR_OK)
+        return rc;
+
+    if ((hdr.flags & EMU_F_MODIFIABLE) == 0) {
+        rc = CKR_ATTRIBUTE_READ_ONLY;
+        goto out;
+    }
+
+    hdr.flags = emu_flags_from_template(hdr.flags, templ, count);
+    rc = emu_blob_seal(&emu_cfg.cur_wk, &hdr, value, obj, &len);
+
+out:
+    OPENSSL_cleanse(value, hdr.value_len);
+    free(value);
+    return rc;
+}
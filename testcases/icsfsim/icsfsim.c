@@ -0,0 +1,581 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * ICSF stand-in server: a minimal LDAPv3 server that accepts simple binds,
+ * answers the root DSE search for the supported extensions and serves the
+ * ICSF extended operation.
+ *
+ * Each connection has a reader thread. Extended operations are processed by
+ * a worker thread each, so that requests pipelined on one connection are
+ * served concurrently and their responses may be sent out of order, like
+ * a real LDAP server does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "icsfsim.h"
+
+#define LDAP_REQ_BIND           0x60
+#define LDAP_RES_BIND           0x61
+#define LDAP_REQ_UNBIND         0x42
+#define LDAP_REQ_SEARCH         0x63
+#define LDAP_RES_SEARCH_ENTRY   0x64
+#define LDAP_RES_SEARCH_RESULT  0x65
+#define LDAP_REQ_EXTENDED       0x77
+#define LDAP_RES_EXTENDED       0x78
+#define LDAP_TAG_EXOP_RES_OID   0x8a
+#define LDAP_TAG_EXOP_RES_VALUE 0x8b
+
+#define LDAP_RC_SUCCESS         0
+#define LDAP_RC_PROTOCOL_ERROR  2
+
+#define SIM_MAX_PDU_LEN         (16 * 1024 * 1024)
+
+struct sim_conn {
+    int fd;
+    pthread_mutex_t mutex;      /* serializes writes, protects the counts */
+    unsigned long refs;
+    unsigned long inflight;
+};
+
+struct sim_job {
+    struct sim_conn *conn;
+    ber_int_t msgid;
+    struct berval *value;
+};
+
+int sim_verbose;
+static unsigned long sim_latency_us;
+
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long stats_conns, stats_binds, stats_requests;
+static unsigned long stats_max_inflight;
+
+static void conn_put(struct sim_conn *conn)
+{
+    unsigned long refs;
+
+    pthread_mutex_lock(&conn->mutex);
+    refs = --conn->refs;
+    pthread_mutex_unlock(&conn->mutex);
+
+    if (refs > 0)
+        return;
+
+    close(conn->fd);
+    pthread_mutex_destroy(&conn->mutex);
+    free(conn);
+}
+
+static int read_full(int fd, void *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = read(fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        buf = (char *)buf + n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        buf = (const char *)buf + n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+/*
+ * Read one LDAPMessage. Only the definite length form is used by LDAP.
+ */
+static BerElement *read_pdu(int fd)
+{
+    unsigned char hdr[6];
+    size_t hdr_len = 2, len = 0, i;
+    struct berval bv;
+    BerElement *ber;
+
+    if (read_full(fd, hdr, 2))
+        return NULL;
+
+    if (hdr[1] & 0x80) {
+        hdr_len += hdr[1] & 0x7f;
+        if (hdr_len > sizeof(hdr) || read_full(fd, hdr + 2, hdr_len - 2))
+            return NULL;
+        for (i = 2; i < hdr_len; i++)
+            len = (len << 8) | hdr[i];
+    } else {
+        len = hdr[1];
+    }
+    if (len > SIM_MAX_PDU_LEN)
+        return NULL;
+
+    bv.bv_len = hdr_len + len;
+    bv.bv_val = malloc(bv.bv_len);
+    if (bv.bv_val == NULL)
+        return NULL;
+    memcpy(bv.bv_val, hdr, hdr_len);
+    if (read_full(fd, bv.bv_val + hdr_len, len)) {
+        free(bv.bv_val);
+        return NULL;
+    }
+
+    ber = ber_init(&bv);
+    free(bv.bv_val);
+
+    return ber;
+}
+
+static int send_pdu(struct sim_conn *conn, BerElement *ber)
+{
+    struct berval *bv = NULL;
+    int rc;
+
+    if (ber_flatten(ber, &bv) != 0)
+        return -1;
+
+    pthread_mutex_lock(&conn->mutex);
+    rc = write_full(conn->fd, bv->bv_val, bv->bv_len);
+    pthread_mutex_unlock(&conn->mutex);
+
+    ber_bvfree(bv);
+
+    return rc;
+}
+
+static int send_result(struct sim_conn *conn, ber_int_t msgid, ber_tag_t tag,
+                       ber_int_t result)
+{
+    BerElement *ber;
+    int rc = -1;
+
+    ber = ber_alloc_t(LBER_USE_DER);
+    if (ber == NULL)
+        return -1;
+
+    if (ber_printf(ber, "{it{ess}}", msgid, tag, result, "", "") >= 0)
+        rc = send_pdu(conn, ber);
+    ber_free(ber, 1);
+
+    return rc;
+}
+
+static int send_root_dse(struct sim_conn *conn, ber_int_t msgid)
+{
+    BerElement *ber;
+    int rc = -1;
+
+    ber = ber_alloc_t(LBER_USE_DER);
+    if (ber == NULL)
+        return -1;
+
+    if (ber_printf(ber, "{it{s{{s[s]}}}}", msgid, LDAP_RES_SEARCH_ENTRY, "",
+                   "supportedextension", ICSF_REQ_OID) >= 0)
+        rc = send_pdu(conn, ber);
+    ber_free(ber, 1);
+    if (rc)
+        return rc;
+
+    return send_result(conn, msgid, LDAP_RES_SEARCH_RESULT, LDAP_RC_SUCCESS);
+}
+
+/*
+ * Decode the ICSF request, process it and encode the response:
+ *
+ * requestValue ::= SEQUENCE {
+ *      version, exitData, handle, { ruleArrayCount, ruleArray },
+ *      [service] CSFPInput
+ * }
+ *
+ * responseValue ::= SEQUENCE {
+ *      version, returnCode, reasonCode, exitData, handle,
+ *      [service] CSFPOutput OPTIONAL
+ * }
+ */
+static struct berval *icsf_request(struct berval *value)
+{
+    struct sim_request req = { 0 };
+    struct berval exit_data, handle, rules, input;
+    struct berval *out_bv = NULL, *res_bv = NULL;
+    BerElement *ber, *res = NULL;
+    ber_int_t version, rule_count;
+    ber_tag_t tag;
+    ber_len_t len;
+
+    ber = ber_init(value);
+    if (ber == NULL)
+        return NULL;
+
+    req.out = ber_alloc_t(LBER_USE_DER);
+    if (req.out == NULL)
+        goto out;
+
+    if (ber_scanf(ber, "{imm{im}", &version, &exit_data, &handle,
+                  &rule_count, &rules) == LBER_ERROR ||
+        handle.bv_len != ICSF_HANDLE_LEN ||
+        rules.bv_len != (ber_len_t)rule_count * ICSF_RULE_ITEM_LEN ||
+        (tag = ber_peek_tag(ber, &len)) == LBER_DEFAULT ||
+        ber_scanf(ber, "m", &input) == LBER_ERROR) {
+        sim_log("malformed ICSF request\n");
+        goto out;
+    }
+
+    req.service = tag & LBER_BIG_TAG_MASK;
+    memcpy(req.handle, handle.bv_val, ICSF_HANDLE_LEN);
+    req.rules = rules.bv_val;
+    req.rule_count = rule_count;
+
+    if (input.bv_len > 0) {
+        req.in = ber_init(&input);
+    } else {
+        req.in = ber_alloc_t(LBER_USE_DER);
+    }
+    if (req.in == NULL)
+        goto out;
+
+    if (sim_latency_us)
+        usleep(sim_latency_us);
+
+    sim_process(&req);
+
+    if (ber_flatten(req.out, &out_bv) != 0)
+        goto out;
+
+    res = ber_alloc_t(LBER_USE_DER);
+    if (res == NULL ||
+        ber_printf(res, "{iiioo", 1, req.rc, req.reason, "", (ber_len_t)0,
+                   req.handle, (ber_len_t)ICSF_HANDLE_LEN) < 0)
+        goto out;
+
+    if ((req.rc == ICSF_RC_SUCCESS ||
+         req.reason == SIM_REASON_OUTPUT_TOO_SHORT) && out_bv->bv_len > 0 &&
+        ber_printf(res, "to", req.service | LBER_CLASS_CONTEXT |
+                   LBER_CONSTRUCTED, out_bv->bv_val, out_bv->bv_len) < 0)
+        goto out;
+
+    if (ber_printf(res, "}") < 0 || ber_flatten(res, &res_bv) != 0)
+        res_bv = NULL;
+
+out:
+    if (out_bv)
+        ber_bvfree(out_bv);
+    if (res)
+        ber_free(res, 1);
+    if (req.in)
+        ber_free(req.in, 1);
+    if (req.out)
+        ber_free(req.out, 1);
+    ber_free(ber, 1);
+
+    return res_bv;
+}
+
+static void *worker(void *arg)
+{
+    struct sim_job *job = arg;
+    struct sim_conn *conn = job->conn;
+    struct berval *res_bv;
+    BerElement *ber;
+    int rc = -1;
+
+    res_bv = icsf_request(job->value);
+
+    ber = ber_alloc_t(LBER_USE_DER);
+    if (ber != NULL) {
+        if (res_bv != NULL)
+            rc = ber_printf(ber, "{it{esststo}}", job->msgid,
+                            LDAP_RES_EXTENDED, LDAP_RC_SUCCESS, "", "",
+                            LDAP_TAG_EXOP_RES_OID, ICSF_RES_OID,
+                            LDAP_TAG_EXOP_RES_VALUE, res_bv->bv_val,
+                            res_bv->bv_len);
+        else
+            rc = ber_printf(ber, "{it{ess}}", job->msgid, LDAP_RES_EXTENDED,
+                            LDAP_RC_PROTOCOL_ERROR, "", "");
+        if (rc >= 0)
+            send_pdu(conn, ber);
+        ber_free(ber, 1);
+    }
+
+    pthread_mutex_lock(&conn->mutex);
+    conn->inflight--;
+    pthread_mutex_unlock(&conn->mutex);
+
+    if (res_bv)
+        ber_bvfree(res_bv);
+    ber_bvfree(job->value);
+    free(job);
+    conn_put(conn);
+
+    return NULL;
+}
+
+static int start_job(struct sim_conn *conn, ber_int_t msgid, BerElement *ber)
+{
+    struct berval oid, value = { 0, NULL };
+    struct sim_job *job;
+    unsigned long inflight;
+    pthread_t thread;
+    ber_len_t len;
+
+    if (ber_scanf(ber, "{m", &oid) == LBER_ERROR)
+        return -1;
+    if (ber_peek_tag(ber, &len) != LBER_DEFAULT &&
+        ber_scanf(ber, "m", &value) == LBER_ERROR)
+        return -1;
+
+    if (oid.bv_len != strlen(ICSF_REQ_OID) ||
+        memcmp(oid.bv_val, ICSF_REQ_OID, oid.bv_len) != 0)
+        return send_result(conn, msgid, LDAP_RES_EXTENDED,
+                           LDAP_RC_PROTOCOL_ERROR);
+
+    job = calloc(1, sizeof(*job));
+    if (job == NULL)
+        return -1;
+    job->conn = conn;
+    job->msgid = msgid;
+    job->value = ber_bvdup(&value);
+    if (job->value == NULL) {
+        free(job);
+        return -1;
+    }
+
+    pthread_mutex_lock(&conn->mutex);
+    conn->refs++;
+    inflight = ++conn->inflight;
+    pthread_mutex_unlock(&conn->mutex);
+
+    pthread_mutex_lock(&stats_mutex);
+    stats_requests++;
+    if (inflight > stats_max_inflight)
+        stats_max_inflight = inflight;
+    pthread_mutex_unlock(&stats_mutex);
+
+    if (pthread_create(&thread, NULL, worker, job) != 0) {
+        pthread_mutex_lock(&conn->mutex);
+        conn->refs--;
+        conn->inflight--;
+        pthread_mutex_unlock(&conn->mutex);
+        ber_bvfree(job->value);
+        free(job);
+        return -1;
+    }
+    pthread_detach(thread);
+
+    return 0;
+}
+
+static void *reader(void *arg)
+{
+    struct sim_conn *conn = arg;
+    BerElement *ber;
+    ber_int_t msgid;
+    ber_tag_t op;
+    int rc;
+
+    while ((ber = read_pdu(conn->fd)) != NULL) {
+        if (ber_scanf(ber, "{it", &msgid, &op) == LBER_ERROR) {
+            ber_free(ber, 1);
+            break;
+        }
+
+        switch (op) {
+        case LDAP_REQ_BIND:
+            pthread_mutex_lock(&stats_mutex);
+            stats_binds++;
+            pthread_mutex_unlock(&stats_mutex);
+            rc = send_result(conn, msgid, LDAP_RES_BIND, LDAP_RC_SUCCESS);
+            break;
+        case LDAP_REQ_SEARCH:
+            rc = send_root_dse(conn, msgid);
+            break;
+        case LDAP_REQ_EXTENDED:
+            rc = start_job(conn, msgid, ber);
+            break;
+        case LDAP_REQ_UNBIND:
+            rc = -1;
+            break;
+        default:
+            /* Abandon and anything else are ignored */
+            rc = 0;
+            break;
+        }
+        ber_free(ber, 1);
+        if (rc)
+            break;
+    }
+
+    sim_log("connection closed\n");
+    shutdown(conn->fd, SHUT_RD);
+    conn_put(conn);
+
+    return NULL;
+}
+
+static void print_stats(void)
+{
+    pthread_mutex_lock(&stats_mutex);
+    fprintf(stderr, "icsfsim: connections %lu binds %lu requests %lu "
+            "max pipelined %lu\n", stats_conns, stats_binds, stats_requests,
+            stats_max_inflight);
+    pthread_mutex_unlock(&stats_mutex);
+}
+
+static void *signal_handler(void *arg)
+{
+    sigset_t *set = arg;
+    int sig;
+
+    while (sigwait(set, &sig) == 0) {
+        print_stats();
+        if (sig != SIGUSR1)
+            exit(0);
+    }
+
+    return NULL;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-p PORT] [-t TOKEN]... [-l LATENCY_US] [-v]\n\n"
+           "  -p PORT        TCP port on 127.0.0.1 to listen on, 0 selects\n"
+           "                 a free port (default: 0)\n"
+           "  -t TOKEN       create the ICSF token TOKEN at start up\n"
+           "  -l LATENCY_US  simulated service latency per request\n"
+           "  -v             trace connections and requests\n\n"
+           "The port is printed to stdout once the server is ready. SIGUSR1\n"
+           "prints statistics, SIGTERM prints statistics and terminates.\n",
+           prog);
+}
+
+int main(int argc, char **argv)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    static sigset_t set;
+    struct sim_conn *conn;
+    pthread_t thread;
+    int port = 0, opt, fd, cfd, one = 1;
+
+    while ((opt = getopt(argc, argv, "p:t:l:vh")) != -1) {
+        switch (opt) {
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 't':
+            if (strlen(optarg) > ICSF_TOKEN_NAME_LEN ||
+                sim_store_init(optarg) != 0) {
+                fprintf(stderr, "icsfsim: invalid token name '%s'\n",
+                        optarg);
+                return 1;
+            }
+            break;
+        case 'l':
+            sim_latency_us = strtoul(optarg, NULL, 10);
+            break;
+        case 'v':
+            sim_verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    if (pthread_create(&thread, NULL, signal_handler, &set) != 0)
+        return 1;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("icsfsim: socket");
+        return 1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 64) != 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        perror("icsfsim: bind");
+        return 1;
+    }
+
+    printf("%d\n", ntohs(addr.sin_port));
+    fflush(stdout);
+
+    while (1) {
+        cfd = accept(fd, NULL, NULL);
+        if (cfd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            perror("icsfsim: accept");
+            return 1;
+        }
+        setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        conn = calloc(1, sizeof(*conn));
+        if (conn == NULL) {
+            close(cfd);
+            continue;
+        }
+        conn->fd = cfd;
+        conn->refs = 1;
+        pthread_mutex_init(&conn->mutex, NULL);
+
+        pthread_mutex_lock(&stats_mutex);
+        stats_conns++;
+        pthread_mutex_unlock(&stats_mutex);
+        sim_log("new connection\n");
+
+        if (pthread_create(&thread, NULL, reader, conn) != 0) {
+            conn_put(conn);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Internal definitions of the ICSF stand-in server.
+ *
+ * icsfsim is a minimal LDAP server that implements the ICSF PKCS #11
+ * extended operation used by the ICSF token, backed by an in-memory object
+ * store and OpenSSL. See testcases/icsfsim/README for usage.
+ */
+
+#ifndef ICSFSIM_H
+#define ICSFSIM_H
+
+#include <lber.h>
+
+#include "pkcs11types.h"
+#include "icsf.h"
+
+/* ICSF return and reason codes used by the server */
+#define SIM_REASON_OUTPUT_TOO_SHORT         3003
+#define SIM_REASON_TEMPLATE_INCONSISTENT    3009
+#define SIM_REASON_ATTRIBUTE_INVALID        3029
+#define SIM_REASON_ATTRIBUTE_VALUE_INVALID  3030
+#define SIM_REASON_ATTRIBUTE_READ_ONLY      3034
+#define SIM_REASON_KEY_TYPE_INCONSISTENT    3039
+#define SIM_REASON_HANDLE_INVALID           3043
+#define SIM_REASON_DATA_LEN_RANGE           11000
+#define SIM_REASON_NOT_SUPPORTED            0
+
+/*
+ * A single ICSF request. The service-specific input is decoded from `in`,
+ * the service-specific output (the content of the CSFPOutput element) is
+ * encoded into `out`. `handle` is both input and output.
+ */
+struct sim_request {
+    int service;
+    char handle[ICSF_HANDLE_LEN];
+    const char *rules;
+    int rule_count;
+    BerElement *in;
+    BerElement *out;
+    int rc;
+    int reason;
+};
+
+int sim_store_init(const char *name);
+void sim_process(struct sim_request *req);
+
+extern int sim_verbose;
+
+#define sim_log(...)                                                    \
+    do {                                                                \
+        if (sim_verbose)                                                \
+            fprintf(stderr, "icsfsim: " __VA_ARGS__);                   \
+    } while (0)
+
+#endif
@@ -0,0 +1,14 @@
+# ICSF stand-in server. It is not installed, point the URI of an ICSF token
+# configuration to it (see testcases/icsfsim/README).
+if ENABLE_ICSFTOK
+noinst_PROGRAMS += testcases/icsfsim/icsfsim
+
+noinst_HEADERS += testcases/icsfsim/icsfsim.h
+EXTRA_DIST += testcases/icsfsim/README
+
+testcases_icsfsim_icsfsim_CFLAGS = ${testcases_inc}			\
+	-I${srcdir}/usr/lib/icsf_stdll
+testcases_icsfsim_icsfsim_LDADD = -llber -lcrypto -lpthread
+testcases_icsfsim_icsfsim_SOURCES =					\
+	testcases/icsfsim/icsfsim.c testcases/icsfsim/icsfsim_services.c
+endif
@@ -0,0 +1,1101 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * ICSF services of the ICSF stand-in server: an in-memory token and object
+ * store (CSFPTRC, CSFPTRD, CSFPTRL, CSFPGAV, CSFPSAV), secret key generation
+ * (CSFPGSK) and symmetric encryption (CSFPSKE, CSFPSKD).
+ *
+ * The encoding of the service input and output follows the one expected by
+ * usr/lib/icsf_stdll/icsf.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include "icsfsim.h"
+
+struct sim_attr {
+    CK_ATTRIBUTE_TYPE type;
+    int is_int;
+    unsigned long ulval;
+    unsigned char *val;
+    unsigned long len;
+};
+
+struct sim_object {
+    unsigned long seq;
+    char id;
+    struct sim_attr *attrs;
+    unsigned long num_attrs;
+    struct sim_object *next;
+};
+
+struct sim_token {
+    char name[ICSF_TOKEN_NAME_LEN + 1];
+    char record[ICSF_TOKEN_RECORD_LEN];
+    unsigned long next_seq;
+    struct sim_object *objects;
+    struct sim_token *next;
+};
+
+/*
+ * A single lock protects the whole store. Crypto operations copy the key
+ * value and run outside of it.
+ */
+static pthread_mutex_t store_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct sim_token *tokens;
+
+static int rule_present(const struct sim_request *req, const char *keyword)
+{
+    char item[ICSF_RULE_ITEM_LEN];
+    size_t len = strlen(keyword);
+    int i;
+
+    memset(item, ' ', sizeof(item));
+    memcpy(item, keyword, len < sizeof(item) ? len : sizeof(item));
+
+    for (i = 0; i < req->rule_count; i++) {
+        if (memcmp(req->rules + i * ICSF_RULE_ITEM_LEN, item,
+                   ICSF_RULE_ITEM_LEN) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+static void set_error(struct sim_request *req, int reason)
+{
+    req->rc = ICSF_RC_ERROR;
+    req->reason = reason;
+}
+
+static void pad_copy(char *dest, const char *src, size_t len)
+{
+    size_t src_len = strnlen(src, len);
+
+    memcpy(dest, src, src_len);
+    memset(dest + src_len, ' ', len - src_len);
+}
+
+static void unpad_copy(char *dest, const char *src, size_t len)
+{
+    while (len > 0 && src[len - 1] == ' ')
+        len--;
+    memcpy(dest, src, len);
+    dest[len] = '\0';
+}
+
+/*
+ * Attributes
+ */
+
+static struct sim_attr *find_attr(struct sim_object *obj,
+                                  CK_ATTRIBUTE_TYPE type)
+{
+    unsigned long i;
+
+    for (i = 0; i < obj->num_attrs; i++) {
+        if (obj->attrs[i].type == type)
+            return &obj->attrs[i];
+    }
+
+    return NULL;
+}
+
+static unsigned long attr_ulong(struct sim_object *obj, CK_ATTRIBUTE_TYPE type,
+                                unsigned long def)
+{
+    struct sim_attr *attr = find_attr(obj, type);
+
+    if (attr == NULL)
+        return def;
+    if (attr->is_int)
+        return attr->ulval;
+    if (attr->len == 1)
+        return attr->val[0];
+
+    return def;
+}
+
+static int set_attr(struct sim_object *obj, CK_ATTRIBUTE_TYPE type,
+                    int is_int, unsigned long ulval,
+                    const void *val, unsigned long len)
+{
+    struct sim_attr *attr = find_attr(obj, type);
+    unsigned char *copy = NULL;
+
+    if (!is_int && len > 0) {
+        copy = malloc(len);
+        if (copy == NULL)
+            return -1;
+        memcpy(copy, val, len);
+    }
+
+    if (attr == NULL) {
+        attr = realloc(obj->attrs, (obj->num_attrs + 1) * sizeof(*attr));
+        if (attr == NULL) {
+            free(copy);
+            return -1;
+        }
+        obj->attrs = attr;
+        attr = &obj->attrs[obj->num_attrs++];
+    } else {
+        free(attr->val);
+    }
+
+    attr->type = type;
+    attr->is_int = is_int;
+    attr->ulval = ulval;
+    attr->val = copy;
+    attr->len = is_int ? 0 : len;
+
+    return 0;
+}
+
+static int set_default_bool(struct sim_object *obj, CK_ATTRIBUTE_TYPE type,
+                            CK_BBOOL value)
+{
+    if (find_attr(obj, type) != NULL)
+        return 0;
+
+    return set_attr(obj, type, 0, 0, &value, sizeof(value));
+}
+
+static void free_object(struct sim_object *obj)
+{
+    unsigned long i;
+
+    if (obj == NULL)
+        return;
+
+    for (i = 0; i < obj->num_attrs; i++)
+        free(obj->attrs[i].val);
+    free(obj->attrs);
+    free(obj);
+}
+
+/*
+ * Decode a list of attributes:
+ *
+ * Attributes ::= SEQUENCE OF SEQUENCE {
+ *    attrName          INTEGER,
+ *    attrValue         CHOICE { [0] OCTET STRING, [1] INTEGER }
+ * }
+ *
+ * The attributes are read until the end of `ber` or until an element that
+ * is not a sequence is found.
+ */
+static int decode_attrs(BerElement *ber, struct sim_object *obj)
+{
+    ber_len_t len;
+    ber_tag_t tag;
+    ber_int_t type, intval;
+    struct berval bv;
+
+    while ((tag = ber_peek_tag(ber, &len)) ==
+           (LBER_CLASS_UNIVERSAL | LBER_CONSTRUCTED | LBER_SEQUENCE)) {
+        if (ber_scanf(ber, "{i", &type) == LBER_ERROR)
+            return -1;
+
+        tag = ber_peek_tag(ber, &len);
+        if (tag == LBER_DEFAULT)
+            return -1;
+
+        if ((tag & LBER_BIG_TAG_MASK) == 0) {
+            if (ber_scanf(ber, "m}", &bv) == LBER_ERROR)
+                return -1;
+            if (set_attr(obj, (CK_ULONG)type, 0, 0, bv.bv_val, bv.bv_len))
+                return -1;
+        } else {
+            if (ber_scanf(ber, "i}", &intval) == LBER_ERROR)
+                return -1;
+            if (set_attr(obj, (CK_ULONG)type, 1, (CK_ULONG)intval, NULL, 0))
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int decode_attrs_bv(struct berval *bv, struct sim_object *obj)
+{
+    BerElement *ber;
+    int rc;
+
+    if (bv->bv_len == 0)
+        return 0;
+
+    ber = ber_init(bv);
+    if (ber == NULL)
+        return -1;
+    rc = decode_attrs(ber, obj);
+    ber_free(ber, 1);
+
+    return rc;
+}
+
+static int hidden_attr(struct sim_object *obj, CK_ATTRIBUTE_TYPE type)
+{
+    CK_OBJECT_CLASS class = attr_ulong(obj, CKA_CLASS, CKO_DATA);
+
+    if (class != CKO_SECRET_KEY && class != CKO_PRIVATE_KEY)
+        return 0;
+
+    switch (type) {
+    case CKA_VALUE:
+    case CKA_PRIVATE_EXPONENT:
+    case CKA_PRIME_1:
+    case CKA_PRIME_2:
+    case CKA_EXPONENT_1:
+    case CKA_EXPONENT_2:
+    case CKA_COEFFICIENT:
+        return attr_ulong(obj, CKA_SENSITIVE, FALSE) ||
+               !attr_ulong(obj, CKA_EXTRACTABLE, TRUE);
+    }
+
+    return 0;
+}
+
+static int encode_attrs(BerElement *ber, struct sim_object *obj)
+{
+    struct sim_attr *attr;
+    unsigned long i;
+    int rc;
+
+    for (i = 0; i < obj->num_attrs; i++) {
+        attr = &obj->attrs[i];
+        if (hidden_attr(obj, attr->type))
+            continue;
+
+        if (attr->is_int)
+            rc = ber_printf(ber, "{iti}", (ber_int_t)attr->type,
+                            1 | LBER_CLASS_CONTEXT, (ber_int_t)attr->ulval);
+        else
+            rc = ber_printf(ber, "{ito}", (ber_int_t)attr->type,
+                            0 | LBER_CLASS_CONTEXT,
+                            attr->val ? (char *)attr->val : "",
+                            (ber_len_t)attr->len);
+        if (rc < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Apply the defaults for the attributes that are not given in the template.
+ */
+static int apply_defaults(struct sim_object *obj)
+{
+    CK_OBJECT_CLASS class = attr_ulong(obj, CKA_CLASS, CKO_DATA);
+    struct sim_attr *value;
+    int is_key = (class == CKO_SECRET_KEY || class == CKO_PRIVATE_KEY);
+
+    if (set_default_bool(obj, CKA_TOKEN, FALSE) ||
+        set_default_bool(obj, CKA_PRIVATE, is_key) ||
+        set_default_bool(obj, CKA_MODIFIABLE, TRUE) ||
+        set_default_bool(obj, CKA_COPYABLE, TRUE) ||
+        set_default_bool(obj, CKA_DESTROYABLE, TRUE))
+        return -1;
+
+    if (find_attr(obj, CKA_LABEL) == NULL &&
+        set_attr(obj, CKA_LABEL, 0, 0, "", 0))
+        return -1;
+
+    if (class != CKO_SECRET_KEY)
+        return 0;
+
+    if (set_default_bool(obj, CKA_SENSITIVE, FALSE) ||
+        set_default_bool(obj, CKA_EXTRACTABLE, TRUE) ||
+        set_default_bool(obj, CKA_ENCRYPT, TRUE) ||
+        set_default_bool(obj, CKA_DECRYPT, TRUE) ||
+        set_default_bool(obj, CKA_SIGN, TRUE) ||
+        set_default_bool(obj, CKA_VERIFY, TRUE) ||
+        set_default_bool(obj, CKA_WRAP, TRUE) ||
+        set_default_bool(obj, CKA_UNWRAP, TRUE) ||
+        set_default_bool(obj, CKA_DERIVE, FALSE) ||
+        set_default_bool(obj, CKA_LOCAL, FALSE) ||
+        set_default_bool(obj, CKA_ALWAYS_SENSITIVE,
+                         attr_ulong(obj, CKA_SENSITIVE, FALSE)) ||
+        set_default_bool(obj, CKA_NEVER_EXTRACTABLE,
+                         !attr_ulong(obj, CKA_EXTRACTABLE, TRUE)))
+        return -1;
+
+    value = find_attr(obj, CKA_VALUE);
+    if (value != NULL && find_attr(obj, CKA_VALUE_LEN) == NULL &&
+        set_attr(obj, CKA_VALUE_LEN, 1, value->len, NULL, 0))
+        return -1;
+
+    return 0;
+}
+
+/*
+ * Store
+ */
+
+static void fill_token_record(struct sim_token *token, const char *attrs)
+{
+    char stamp[ICSF_DATE_LEN + ICSF_TIME_LEN + 1];
+    size_t offset = 0;
+    struct tm tm;
+    time_t now = time(NULL);
+
+    gmtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%Y%m%d%H%M%S00", &tm);
+
+    pad_copy(token->record, token->name, ICSF_TOKEN_NAME_LEN);
+    offset += ICSF_TOKEN_NAME_LEN;
+    memcpy(token->record + offset, attrs,
+           ICSF_MANUFACTURER_LEN + ICSF_MODEL_LEN + ICSF_SERIAL_LEN);
+    offset += ICSF_MANUFACTURER_LEN + ICSF_MODEL_LEN + ICSF_SERIAL_LEN;
+    memcpy(token->record + offset, stamp, ICSF_DATE_LEN + ICSF_TIME_LEN);
+    offset += ICSF_DATE_LEN + ICSF_TIME_LEN;
+    memset(token->record + offset, 0, ICSF_FLAGS_LEN);
+}
+
+static struct sim_token *find_token(const char *name)
+{
+    struct sim_token *token;
+
+    for (token = tokens; token != NULL; token = token->next) {
+        if (strcmp(token->name, name) == 0)
+            return token;
+    }
+
+    return NULL;
+}
+
+static void clear_token(struct sim_token *token)
+{
+    struct sim_object *obj, *next;
+
+    for (obj = token->objects; obj != NULL; obj = next) {
+        next = obj->next;
+        free_object(obj);
+    }
+    token->objects = NULL;
+}
+
+/* Tokens are kept sorted by name, for the continuation of CSFPTRL. */
+static struct sim_token *create_token(const char *name, const char *attrs)
+{
+    struct sim_token *token, **pos;
+
+    token = find_token(name);
+    if (token != NULL) {
+        clear_token(token);
+        fill_token_record(token, attrs);
+        return token;
+    }
+
+    token = calloc(1, sizeof(*token));
+    if (token == NULL)
+        return NULL;
+    strncpy(token->name, name, ICSF_TOKEN_NAME_LEN);
+    token->next_seq = 1;
+    fill_token_record(token, attrs);
+
+    for (pos = &tokens; *pos != NULL; pos = &(*pos)->next) {
+        if (strcmp((*pos)->name, name) > 0)
+            break;
+    }
+    token->next = *pos;
+    *pos = token;
+
+    return token;
+}
+
+/*
+ * Resolve an object handle: 32 bytes token name, 8 bytes hexadecimal
+ * sequence number and the object type.
+ */
+static struct sim_object *find_object(const char *handle,
+                                      struct sim_token **token_out)
+{
+    char name[ICSF_TOKEN_NAME_LEN + 1];
+    char hex_seq[ICSF_SEQUENCE_LEN + 1];
+    struct sim_token *token;
+    struct sim_object *obj;
+    unsigned long seq;
+    char *end;
+
+    unpad_copy(name, handle, ICSF_TOKEN_NAME_LEN);
+    memcpy(hex_seq, handle + ICSF_TOKEN_NAME_LEN, ICSF_SEQUENCE_LEN);
+    hex_seq[ICSF_SEQUENCE_LEN] = '\0';
+    seq = strtoul(hex_seq, &end, 16);
+    if (*end != '\0')
+        return NULL;
+
+    token = find_token(name);
+    if (token == NULL)
+        return NULL;
+
+    for (obj = token->objects; obj != NULL; obj = obj->next) {
+        if (obj->seq == seq &&
+            obj->id == handle[ICSF_TOKEN_NAME_LEN + ICSF_SEQUENCE_LEN])
+            break;
+    }
+    if (token_out)
+        *token_out = token;
+
+    return obj;
+}
+
+static void object_handle(char *handle, struct sim_token *token,
+                          struct sim_object *obj)
+{
+    char hex_seq[ICSF_SEQUENCE_LEN + 1];
+
+    memset(handle, ' ', ICSF_HANDLE_LEN);
+    pad_copy(handle, token->name, ICSF_TOKEN_NAME_LEN);
+    snprintf(hex_seq, sizeof(hex_seq), "%0*lX", ICSF_SEQUENCE_LEN, obj->seq);
+    memcpy(handle + ICSF_TOKEN_NAME_LEN, hex_seq, ICSF_SEQUENCE_LEN);
+    handle[ICSF_TOKEN_NAME_LEN + ICSF_SEQUENCE_LEN] = obj->id;
+}
+
+/* Objects are kept sorted by sequence number. */
+static void add_object(struct sim_token *token, struct sim_object *obj,
+                       char *handle)
+{
+    struct sim_object **pos;
+
+    obj->seq = token->next_seq++;
+    obj->id = attr_ulong(obj, CKA_TOKEN, FALSE) ? ICSF_TOKEN_OBJECT :
+                                                  ICSF_SESSION_OBJECT;
+
+    for (pos = &token->objects; *pos != NULL; pos = &(*pos)->next)
+        ;
+    *pos = obj;
+
+    object_handle(handle, token, obj);
+}
+
+static struct sim_object *copy_object(struct sim_object *src)
+{
+    struct sim_object *obj;
+    unsigned long i;
+
+    obj = calloc(1, sizeof(*obj));
+    if (obj == NULL)
+        return NULL;
+
+    for (i = 0; i < src->num_attrs; i++) {
+        if (set_attr(obj, src->attrs[i].type, src->attrs[i].is_int,
+                     src->attrs[i].ulval, src->attrs[i].val,
+                     src->attrs[i].len)) {
+            free_object(obj);
+            return NULL;
+        }
+    }
+
+    return obj;
+}
+
+static int template_matches(struct sim_object *obj, struct sim_object *tmpl)
+{
+    struct sim_attr *want, *have;
+    unsigned long i;
+
+    for (i = 0; i < tmpl->num_attrs; i++) {
+        want = &tmpl->attrs[i];
+        have = find_attr(obj, want->type);
+        if (have == NULL || hidden_attr(obj, want->type))
+            return 0;
+        if (want->is_int || have->is_int) {
+            if (attr_ulong(obj, want->type, ~0UL) !=
+                (want->is_int ? want->ulval :
+                 (want->len == 1 ? want->val[0] : ~1UL)))
+                return 0;
+            continue;
+        }
+        if (have->len != want->len ||
+            (want->len > 0 && memcmp(have->val, want->val, want->len) != 0))
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * CSFPTRC: create a token, create an object or copy an object.
+ */
+static void service_trc(struct sim_request *req)
+{
+    char name[ICSF_TOKEN_NAME_LEN + 1];
+    struct sim_token *token;
+    struct sim_object *obj, *src;
+    struct berval bv;
+    ber_len_t len;
+
+    if (rule_present(req, "TOKEN")) {
+        if (ber_scanf(req->in, "m", &bv) == LBER_ERROR ||
+            bv.bv_len < ICSF_MANUFACTURER_LEN + ICSF_MODEL_LEN +
+                        ICSF_SERIAL_LEN) {
+            set_error(req, SIM_REASON_TEMPLATE_INCONSISTENT);
+            return;
+        }
+        unpad_copy(name, req->handle, ICSF_TOKEN_NAME_LEN);
+        if (create_token(name, bv.bv_val) == NULL)
+            set_error(req, SIM_REASON_NOT_SUPPORTED);
+        return;
+    }
+
+    if (!rule_present(req, "OBJECT")) {
+        set_error(req, SIM_REASON_NOT_SUPPORTED);
+        return;
+    }
+
+    obj = calloc(1, sizeof(*obj));
+    if (obj == NULL) {
+        set_error(req, SIM_REASON_NOT_SUPPORTED);
+        return;
+    }
+
+    if (rule_present(req, "COPY")) {
+        free(obj);
+        src = find_object(req->handle, &token);
+        if (src == NULL) {
+            set_error(req, SIM_REASON_HANDLE_INVALID);
+            return;
+        }
+        if (!attr_ulong(src, CKA_COPYABLE, TRUE)) {
+            set_error(req, SIM_REASON_ATTRIBUTE_READ_ONLY);
+            return;
+        }
+        obj = copy_object(src);
+        if (obj == NULL) {
+            set_error(req, SIM_REASON_NOT_SUPPORTED);
+            return;
+        }
+    } else {
+        unpad_copy(name, req->handle, ICSF_TOKEN_NAME_LEN);
+        token = find_token(name);
+        if (token == NULL) {
+            free(obj);
+            set_error(req, SIM_REASON_HANDLE_INVALID);
+            return;
+        }
+    }
+
+    if (ber_peek_tag(req->in, &len) != LBER_DEFAULT &&
+        (ber_scanf(req->in, "m", &bv) == LBER_ERROR ||
+         decode_attrs_bv(&bv, obj) != 0 || apply_defaults(obj) != 0)) {
+        free_object(obj);
+        set_error(req, SIM_REASON_TEMPLATE_INCONSISTENT);
+        return;
+    }
+
+    /* Unique IDs are assigned by the token, hardware features are fixed */
+    if (find_attr(obj, CKA_UNIQUE_ID) != NULL ||
+        attr_ulong(obj, CKA_CLASS, CKO_DATA) == CKO_HW_FEATURE) {
+        free_object(obj);
+        set_error(req, SIM_REASON_ATTRIBUTE_READ_ONLY);
+        return;
+    }
+
+    add_object(token, obj, req->handle);
+}
+
+/*
+ * CSFPTRD: delete a token or an object.
+ */
+static void service_trd(struct sim_request *req)
+{
+    char name[ICSF_TOKEN_NAME_LEN + 1];
+    struct sim_token *token, **tpos;
+    struct sim_object *obj, **opos;
+
+    if (rule_present(req, "TOKEN")) {
+        unpad_copy(name, req->handle, ICSF_TOKEN_NAME_LEN);
+        for (tpos = &tokens; *tpos != NULL; tpos = &(*tpos)->next) {
+            if (strcmp((*tpos)->name, name) == 0)
+                break;
+        }
+        if (*tpos == NULL) {
+            set_error(req, SIM_REASON_HANDLE_INVALID);
+            return;
+        }
+        token = *tpos;
+        *tpos = token->next;
+        clear_token(token);
+        free(token);
+        return;
+    }
+
+    obj = find_object(req->handle, &token);
+    if (obj == NULL) {
+        set_error(req, SIM_REASON_HANDLE_INVALID);
+        return;
+    }
+    if (!attr_ulong(obj, CKA_DESTROYABLE, TRUE)) {
+        set_error(req, SIM_REASON_ATTRIBUTE_READ_ONLY);
+        return;
+    }
+
+    for (opos = &token->objects; *opos != obj; opos = &(*opos)->next)
+        ;
+    *opos = obj->next;
+    free_object(obj);
+}
+
+/*
+ * CSFPTRL: list tokens or objects, starting after the one in the handle.
+ */
+static void service_trl(struct sim_request *req)
+{
+    char name[ICSF_TOKEN_NAME_LEN + 1];
+    char hex_seq[ICSF_SEQUENCE_LEN + 1];
+    ber_int_t in_list_len, max_count;
+    struct sim_object tmpl = { 0 };
+    struct sim_token *token;
+    struct sim_object *obj;
+    struct berval bv;
+    ber_len_t len;
+    unsigned long count = 0, after = 0, out_len = 0;
+    char *list = NULL;
+    int objects;
+
+    if (ber_scanf(req->in, "ii", &in_list_len, &max_count) == LBER_ERROR) {
+        set_error(req, SIM_REASON_NOT_SUPPORTED);
+        return;
+    }
+
+    objects = rule_present(req, "OBJECT");
+    if (objects && ber_peek_tag(req->in, &len) != LBER_DEFAULT &&
+        (ber_scanf(req->in, "m", &bv) == LBER_ERROR ||
+         decode_attrs_bv(&bv, &tmpl) != 0)) {
+        set_error(req, SIM_REASON_TEMPLATE_INCONSISTENT);
+        goto out;
+    }
+
+    if (in_list_len > 0) {
+        list = malloc(in_list_len);
+        if (list == NULL) {
+            set_error(req, SIM_REASON_NOT_SUPPORTED);
+            goto out;
+        }
+    }
+
+    unpad_copy(name, req->handle, ICSF_TOKEN_NAME_LEN);
+    if (!objects) {
+        for (token = tokens; token != NULL; token = token->next) {
+            if (name[0] != '\0' && strcmp(token->name, name) <= 0)
+                continue;
+            if (count >= (unsigned long)max_count ||
+                out_len + ICSF_TOKEN_RECORD_LEN > (unsigned long)in_list_len)
+                break;
+            memcpy(list + out_len, token->record, ICSF_TOKEN_RECORD_LEN);
+            out_len += ICSF_TOKEN_RECORD_LEN;
+            count++;
+        }
+    } else {
+        token = find_token(name);
+        if (token == NULL) {
+            set_error(req, SIM_REASON_HANDLE_INVALID);
+            goto out;
+        }
+
+        /* A token handle lists from the start */
+        memcpy(hex_seq, req->handle + ICSF_TOKEN_NAME_LEN, ICSF_SEQUENCE_LEN);
+        hex_seq[ICSF_SEQUENCE_LEN] = '\0';
+        if (hex_seq[0] != ' ')
+            after = strtoul(hex_seq, NULL, 16);
+
+        for (obj = token->objects; obj != NULL; obj = obj->next) {
+            if (obj->seq <= after || !template_matches(obj, &tmpl))
+                continue;
+            if (count >= (unsigned long)max_count ||
+                out_len + ICSF_HANDLE_LEN > (unsigned long)in_list_len)
+                break;
+            object_handle(list + out_len, token, obj);
+            out_len += ICSF_HANDLE_LEN;
+            count++;
+        }
+    }
+
+    /* TRLOutput ::= SEQUENCE { outList CHOICE {...}, outListLen INTEGER } */
+    if (ber_printf(req->out, "toi",
+                   (objects ? 1 : 0) | LBER_CLASS_CONTEXT,
+                   list ? list : "", (ber_len_t)out_len,
+                   (ber_int_t)out_len) < 0)
+        set_error(req, SIM_REASON_NOT_SUPPORTED);
+
+out:
+    free(list);
+    while (tmpl.num_attrs > 0)
+        free(tmpl.attrs[--tmpl.num_attrs].val);
+    free(tmpl.attrs);
+}
+
+/*
+ * CSFPGAV: return all attributes of an object.
+ */
+static void service_gav(struct sim_request *req)
+{
+    struct sim_object *obj;
+
+    obj = find_object(req->handle, NULL);
+    if (obj == NULL) {
+        set_error(req, SIM_REASON_HANDLE_INVALID);
+        return;
+    }
+
+    /* GAVOutput ::= SEQUENCE { attrList Attributes, attrListLen INTEGER } */
+    if (ber_printf(req->out, "{") < 0 || encode_attrs(req->out, obj) < 0 ||
+        ber_printf(req->out, "}i", (ber_int_t)obj->num_attrs) < 0)
+        set_error(req, SIM_REASON_NOT_SUPPORTED);
+}
+
+/*
+ * CSFPSAV: update attributes of an object.
+ */
+static void service_sav(struct sim_request *req)
+{
+    struct sim_object *obj, changes = { 0 };
+    unsigned long i;
+
+    obj = find_object(req->handle, NULL);
+    if (obj == NULL) {
+        set_error(req, SIM_REASON_HANDLE_INVALID);
+        return;
+    }
+
+    if (decode_attrs(req->in, &changes) != 0) {
+        set_error(req, SIM_REASON_ATTRIBUTE_VALUE_INVALID);
+        goto out;
+    }
+
+    if (!attr_ulong(obj, CKA_MODIFIABLE, TRUE)) {
+        set_error(req, SIM_REASON_ATTRIBUTE_READ_ONLY);
+        goto out;
+    }
+
+    for (i = 0; i < changes.num_attrs; i++) {
+        switch (changes.attrs[i].type) {
+        case CKA_CLASS:
+        case CKA_KEY_TYPE:
+        case CKA_TOKEN:
+        case CKA_VALUE:
+        case CKA_VALUE_LEN:
+            set_error(req, SIM_REASON_ATTRIBUTE_READ_ONLY);
+            goto out;
+        }
+    }
+
+    for (i = 0; i < changes.num_attrs; i++) {
+        if (set_attr(obj, changes.attrs[i].type, changes.attrs[i].is_int,
+                     changes.attrs[i].ulval, changes.attrs[i].val,
+                     changes.attrs[i].len)) {
+            set_error(req, SIM_REASON_NOT_SUPPORTED);
+            goto out;
+        }
+    }
+
+out:
+    for (i = 0; i < changes.num_attrs; i++)
+        free(changes.attrs[i].val);
+    free(changes.attrs);
+}
+
+/*
+ * CSFPGSK: generate a secret key.
+ */
+static void service_gsk(struct sim_request *req)
+{
+    char name[ICSF_TOKEN_NAME_LEN + 1];
+    unsigned char value[64];
+    unsigned long value_len;
+    struct sim_token *token;
+    struct sim_object *obj;
+    struct berval bv;
+
+    if (!rule_present(req, "KEY")) {
+        set_error(req, SIM_REASON_NOT_SUPPORTED);
+        return;
+    }
+
+    unpad_copy(name, req->handle, ICSF_TOKEN_NAME_LEN);
+    token = find_token(name);
+    if (token == NULL) {
+        set_error(req, SIM_REASON_HANDLE_INVALID);
+        return;
+    }
+
+    obj = calloc(1, sizeof(*obj));
+    if (obj == NULL) {
+        set_error(req, SIM_REASON_NOT_SUPPORTED);
+        return;
+    }
+
+    if (ber_scanf(req->in, "m", &bv) == LBER_ERROR ||
+        decode_attrs_bv(&bv, obj) != 0) {
+        set_error(req, SIM_REASON_TEMPLATE_INCONSISTENT);
+        goto err;
+    }
+
+    switch (attr_ulong(obj, CKA_KEY_TYPE, CK_UNAVAILABLE_INFORMATION)) {
+    case CKK_DES:
+        value_len = 8;
+        break;
+    case CKK_DES3:
+        value_len = 24;
+        break;
+    case CKK_AES:
+    case CKK_GENERIC_SECRET:
+        value_len = attr_ulong(obj, CKA_VALUE_LEN, 0);
+        break;
+    default:
+        set_error(req, SIM_REASON_KEY_TYPE_INCONSISTENT);
+        goto err;
+    }
+    if (value_len == 0 || value_len > sizeof(value)) {
+        set_error(req, SIM_REASON_ATTRIBUTE_VALUE_INVALID);
+        goto err;
+    }
+
+    if (RAND_bytes(value, value_len) != 1 ||
+        set_attr(obj, CKA_VALUE, 0, 0, value, value_len) ||
+        set_attr(obj, CKA_VALUE_LEN, 1, value_len, NULL, 0) ||
+        set_default_bool(obj, CKA_LOCAL, TRUE) ||
+        apply_defaults(obj)) {
+        set_error(req, SIM_REASON_NOT_SUPPORTED);
+        goto err;
+    }
+
+    add_object(token, obj, req->handle);
+    return;
+
+err:
+    free_object(obj);
+}
+
+/*
+ * CSFPSKE and CSFPSKD: symmetric encryption and decryption.
+ *
+ * The chaining data returned to the client is the IV for the next part.
+ */
+static const EVP_CIPHER *get_cipher(const struct sim_request *req,
+                                    CK_KEY_TYPE key_type, size_t key_len,
+                                    int *cbc, int *pad)
+{
+    *cbc = rule_present(req, "CBC") || rule_present(req, "CBC-PAD");
+    *pad = rule_present(req, "CBC-PAD");
+
+    if (rule_present(req, "AES") && key_type == CKK_AES) {
+        switch (key_len) {
+        case 16:
+            return *cbc ? EVP_aes_128_cbc() : EVP_aes_128_ecb();
+        case 24:
+            return *cbc ? EVP_aes_192_cbc() : EVP_aes_192_ecb();
+        case 32:
+            return *cbc ? EVP_aes_256_cbc() : EVP_aes_256_ecb();
+        }
+    } else if (rule_present(req, "DES3") && key_type == CKK_DES3 &&
+               key_len == 24) {
+        return *cbc ? EVP_des_ede3_cbc() : EVP_des_ede3_ecb();
+    }
+
+    return NULL;
+}
+
+static void service_crypt(struct sim_request *req, int encrypt)
+{
+    unsigned char key[32], iv[EVP_MAX_BLOCK_LENGTH];
+    struct berval bv_iv, bv_chain, bv_data;
+    ber_int_t out_buf_len;
+    unsigned char *out = NULL;
+    const EVP_CIPHER *cipher;
+    EVP_CIPHER_CTX *ctx = NULL;
+    struct sim_object *obj;
+    struct sim_attr *value;
+    CK_KEY_TYPE key_type;
+    size_t key_len, block, out_len, i;
+    int cbc, pad, last, first, len;
+
+    pthread_mutex_lock(&store_mutex);
+    obj = find_object(req->handle, NULL);
+    value = obj ? find_attr(obj, CKA_VALUE) : NULL;
+    if (value == NULL || value->len > sizeof(key) ||
+        attr_ulong(obj, CKA_CLASS, CKO_DATA) != CKO_SECRET_KEY ||
+        !attr_ulong(obj, encrypt ? CKA_ENCRYPT : CKA_DECRYPT, TRUE)) {
+        pthread_mutex_unlock(&store_mutex);
+        set_error(req, SIM_REASON_HANDLE_INVALID);
+        return;
+    }
+    key_type = attr_ulong(obj, CKA_KEY_TYPE, CK_UNAVAILABLE_INFORMATION);
+    key_len = value->len;
+    memcpy(key, value->val, key_len);
+    pthread_mutex_unlock(&store_mutex);
+
+    cipher = get_cipher(req, key_type, key_len, &cbc, &pad);
+    if (cipher == NULL) {
+        set_error(req, SIM_REASON_KEY_TYPE_INCONSISTENT);
+        goto out;
+    }
+    block = EVP_CIPHER_get_block_size(cipher);
+    first = !rule_present(req, "CONTINUE") && !rule_present(req, "FINAL");
+    last = !rule_present(req, "INITIAL") && !rule_present(req, "CONTINUE");
+
+    /* SKEInput and SKDInput: IV, chaining data, data, output length */
+    if (ber_scanf(req->in, "mmmi", &bv_iv, &bv_chain, &bv_data,
+                  &out_buf_len) == LBER_ERROR) {
+        set_error(req, SIM_REASON_NOT_SUPPORTED);
+        goto out;
+    }
+
+    memset(iv, 0, sizeof(iv));
+    if (cbc) {
+        if (first && bv_iv.bv_len >= block)
+            memcpy(iv, bv_iv.bv_val, block);
+        else if (!first && bv_chain.bv_len >= block)
+            memcpy(iv, bv_chain.bv_val, block);
+    }
+
+    if (bv_data.bv_len % block != 0 && !(pad && last && encrypt)) {
+        set_error(req, SIM_REASON_DATA_LEN_RANGE);
+        goto out;
+    }
+
+    out_len = bv_data.bv_len;
+    if (pad && last && encrypt)
+        out_len = (bv_data.bv_len / block + 1) * block;
+    if ((size_t)out_buf_len < out_len) {
+        set_error(req, SIM_REASON_OUTPUT_TOO_SHORT);
+        bv_chain.bv_len = 0;
+        goto reply;
+    }
+
+    out = malloc(out_len + block);
+    ctx = EVP_CIPHER_CTX_new();
+    if (out == NULL || ctx == NULL ||
+        EVP_CipherInit_ex(ctx, cipher, NULL, key, cbc ? iv : NULL,
+                          encrypt) != 1 ||
+        EVP_CIPHER_CTX_set_padding(ctx, 0) != 1) {
+        set_error(req, SIM_REASON_NOT_SUPPORTED);
+        goto out;
+    }
+
+    if (pad && last && encrypt) {
+        /* PKCS #7 padding of the final part */
+        memcpy(out, bv_data.bv_val, bv_data.bv_len);
+        for (i = bv_data.bv_len; i < out_len; i++)
+            out[i] = out_len - bv_data.bv_len;
+        if (EVP_CipherUpdate(ctx, out, &len, out, out_len) != 1) {
+            set_error(req, SIM_REASON_NOT_SUPPORTED);
+            goto out;
+        }
+    } else if (out_len > 0 &&
+               EVP_CipherUpdate(ctx, out, &len, (unsigned char *)
+                                bv_data.bv_val, bv_data.bv_len) != 1) {
+        set_error(req, SIM_REASON_NOT_SUPPORTED);
+        goto out;
+    }
+
+    /* The last cipher text block is the IV of the next part */
+    if (cbc && out_len >= block)
+        memcpy(iv, encrypt ? out + out_len - block :
+                             (unsigned char *)bv_data.bv_val + out_len - block,
+               block);
+
+    if (pad && last && !encrypt) {
+        if (out_len == 0 || out[out_len - 1] == 0 ||
+            out[out_len - 1] > block) {
+            set_error(req, SIM_REASON_DATA_LEN_RANGE);
+            goto out;
+        }
+        out_len -= out[out_len - 1];
+    }
+
+    bv_chain.bv_val = (char *)iv;
+    bv_chain.bv_len = cbc ? block : 0;
+
+reply:
+    /* SKEOutput and SKDOutput: chaining data, data, data length */
+    if (ber_printf(req->out, "ooi", bv_chain.bv_len ? bv_chain.bv_val : "",
+                   bv_chain.bv_len, out ? (char *)out : "",
+                   out ? (ber_len_t)out_len : 0,
+                   (ber_int_t)out_len) < 0)
+        set_error(req, SIM_REASON_NOT_SUPPORTED);
+
+out:
+    OPENSSL_cleanse(key, sizeof(key));
+    EVP_CIPHER_CTX_free(ctx);
+    free(out);
+}
+
+int sim_store_init(const char *name)
+{
+    char attrs[ICSF_MANUFACTURER_LEN + ICSF_MODEL_LEN + ICSF_SERIAL_LEN];
+    int rc = 0;
+
+    pad_copy(attrs, "IBM", ICSF_MANUFACTURER_LEN);
+    pad_copy(attrs + ICSF_MANUFACTURER_LEN, "ICSFSIM", ICSF_MODEL_LEN);
+    pad_copy(attrs + ICSF_MANUFACTURER_LEN + ICSF_MODEL_LEN, "0",
+             ICSF_SERIAL_LEN);
+
+    pthread_mutex_lock(&store_mutex);
+    if (create_token(name, attrs) == NULL)
+        rc = -1;
+    pthread_mutex_unlock(&store_mutex);
+
+    return rc;
+}
+
+void sim_process(struct sim_request *req)
+{
+    req->rc = ICSF_RC_SUCCESS;
+    req->reason = 0;
+
+    switch (req->service) {
+    case ICSF_TAG_CSFPSKE:
+        service_crypt(req, 1);
+        break;
+    case ICSF_TAG_CSFPSKD:
+        service_crypt(req, 0);
+        break;
+    default:
+        pthread_mutex_lock(&store_mutex);
+        switch (req->service) {
+        case ICSF_TAG_CSFPTRC:
+            service_trc(req);
+            break;
+        case ICSF_TAG_CSFPTRD:
+            service_trd(req);
+            break;
+        case ICSF_TAG_CSFPTRL:
+            service_trl(req);
+            break;
+        case ICSF_TAG_CSFPGAV:
+            service_gav(req);
+            break;
+        case ICSF_TAG_CSFPSAV:
+            service_sav(req);
+            break;
+        case ICSF_TAG_CSFPGSK:
+            service_gsk(req);
+            break;
+        default:
+            set_error(req, SIM_REASON_NOT_SUPPORTED);
+            break;
+        }
+        pthread_mutex_unlock(&store_mutex);
+        break;
+    }
+
+    sim_log("service %d: rc %d reason %d\n", req->service, req->rc,
+            req->reason);
+}
@@ -31,6 +31,7 @@
 #define MIN(a, b)       ( (a) < (b) ? (a) : (b) )
 
 #include <sys/time.h>
+#include <time.h>
 #define SYSTEMTIME   struct timeval
 #define GetSystemTime(x) gettimeofday((x), NULL)
 
@@ -88,6 +89,35 @@ extern CK_SLOT_ID SLOT_ID;
 void usage(char *fct);
 int do_ParseArgs(int argc, char **argv);
 
+double elapsed_us(const struct timespec *start);
+
+struct ext_test_func {
+    const char *name;
+    void **func;                    /* receives the address of the function */
+};
+
+/*
+ * A test run by do_ext_test_main(), usually of IBM extension functions
+ * (C_IBM_*), which are looked up in the library. The pointers refer to the
+ * test's own globals, which are set up before run_tests() is called.
+ * run_bench() runs after run_tests() with -bench only.
+ */
+struct ext_test {
+    const struct ext_test_func *ext_funcs;  /* terminated by a NULL name */
+    const char *bench_options;      /* usage of -bench sub-options, or NULL */
+    const char *bench_help;         /* what -bench does */
+    /* Parses a test specific option at argv[*i]: 1 if consumed, -1 on error */
+    int (*parse_arg)(int argc, char **argv, int *i);
+    CK_RV (*run_tests)(void);
+    CK_RV (*run_bench)(void);
+    CK_SLOT_ID *slot_id;
+    CK_SESSION_HANDLE *session;
+    CK_BYTE *user_pin;              /* PKCS11_MAX_PIN_LEN bytes, or NULL */
+    CK_ULONG *user_pin_len;
+};
+
+int do_ext_test_main(int argc, char **argv, const struct ext_test *test);
+
 // these values are required when generating a PKCS DSA value.  they were
 // obtained by generating a DSA key pair on the 4758 with the default (random)
 // values.  these values are in big-endian format
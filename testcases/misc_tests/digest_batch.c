@@ -0,0 +1,338 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/* File: digest_batch.c
+ *
+ * Test driver for the C_IBM_DigestBatch vendor function. The digests of a
+ * batch are compared with single message C_Digest results, and the batch
+ * call is benchmarked against a C_DigestInit/C_Digest loop.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pkcs11types.h"
+#include "regress.h"
+#include "mech_to_str.h"
+#include "common.c"
+
+#define MAX_HASH_SIZE       64
+#define BATCH_COUNT         100
+#define MAX_MSG_LEN         4096
+#define BENCH_TOTAL_LEN     (4 * 1024 * 1024)
+
+CK_SLOT_ID slot_id = 1;
+
+CK_SESSION_HANDLE session;
+
+CK_C_IBM_DigestBatch _C_IBM_DigestBatch;
+
+static const CK_MECHANISM_TYPE digest_mechs[] = {
+    CKM_MD5,
+    CKM_SHA_1,
+    CKM_SHA224,
+    CKM_SHA256,
+    CKM_SHA384,
+    CKM_SHA512,
+    CKM_SHA512_224,
+    CKM_SHA512_256,
+    CKM_SHA3_224,
+    CKM_SHA3_256,
+    CKM_SHA3_384,
+    CKM_SHA3_512,
+};
+
+static const CK_ULONG bench_sizes[] = {
+    32, 64, 256, 1024, 4096, 16384, 65536,
+};
+
+static CK_RV digest_single(CK_MECHANISM *mech, CK_BYTE *data, CK_ULONG len,
+                           CK_BYTE *hash, CK_ULONG *hash_len)
+{
+    CK_RV rc;
+
+    rc = funcs->C_DigestInit(session, mech);
+    if (rc != CKR_OK)
+        return rc;
+
+    return funcs->C_Digest(session, data, len, hash, hash_len);
+}
+
+static CK_RV do_digest_batch_mech(CK_MECHANISM_TYPE mech_type)
+{
+    CK_MECHANISM mech = { mech_type, NULL, 0 };
+    CK_BYTE *msgs[BATCH_COUNT];
+    CK_ULONG lens[BATCH_COUNT];
+    CK_BYTE *data = NULL, *digests = NULL;
+    CK_BYTE hash[MAX_HASH_SIZE];
+    CK_ULONG hash_len, digests_len, i;
+    CK_RV rc = CKR_OK;
+
+    testcase_begin("C_IBM_DigestBatch with %s", mech_to_str(mech_type));
+
+    if (!mech_supported(slot_id, mech_type)) {
+        testcase_skip("Slot %lu doesn't support %s", slot_id,
+                      mech_to_str(mech_type));
+        return CKR_OK;
+    }
+
+    data = malloc(MAX_MSG_LEN);
+    if (data == NULL) {
+        testcase_error("malloc failed");
+        return CKR_HOST_MEMORY;
+    }
+    for (i = 0; i < MAX_MSG_LEN; i++)
+        data[i] = random();
+
+    /* Lengths around the block boundaries and random ones */
+    for (i = 0; i < BATCH_COUNT; i++) {
+        lens[i] = (i < 50) ? i * 3 : (CK_ULONG)(random() % MAX_MSG_LEN);
+        msgs[i] = data + random() % (MAX_MSG_LEN - lens[i] + 1);
+    }
+
+    hash_len = sizeof(hash);
+    rc = digest_single(&mech, data, 0, hash, &hash_len);
+    if (rc != CKR_OK) {
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("%s is rejected by policy", mech_to_str(mech_type));
+            rc = CKR_OK;
+            goto out;
+        }
+        testcase_error("C_DigestInit/C_Digest rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    testcase_new_assertion();
+
+    /* Length query */
+    digests_len = 0;
+    rc = _C_IBM_DigestBatch(session, &mech, BATCH_COUNT, msgs, lens, NULL,
+                            &digests_len);
+    if (rc != CKR_OK) {
+        if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+            testcase_skip("Slot %lu does not support C_IBM_DigestBatch",
+                          slot_id);
+            rc = CKR_OK;
+            goto out;
+        }
+        testcase_fail("C_IBM_DigestBatch (length query) rc=%s",
+                      p11_get_ckr(rc));
+        goto out;
+    }
+    if (digests_len != BATCH_COUNT * hash_len) {
+        testcase_fail("C_IBM_DigestBatch returned length %lu, expected %lu",
+                      digests_len, BATCH_COUNT * hash_len);
+        goto out;
+    }
+
+    digests = calloc(BATCH_COUNT, hash_len);
+    if (digests == NULL) {
+        testcase_error("calloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    /* Buffer too small */
+    digests_len = BATCH_COUNT * hash_len - 1;
+    rc = _C_IBM_DigestBatch(session, &mech, BATCH_COUNT, msgs, lens, digests,
+                            &digests_len);
+    if (rc != CKR_BUFFER_TOO_SMALL || digests_len != BATCH_COUNT * hash_len) {
+        testcase_fail("C_IBM_DigestBatch with a short buffer rc=%s, len=%lu",
+                      p11_get_ckr(rc), digests_len);
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    rc = _C_IBM_DigestBatch(session, &mech, BATCH_COUNT, msgs, lens, digests,
+                            &digests_len);
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_DigestBatch rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    for (i = 0; i < BATCH_COUNT; i++) {
+        hash_len = sizeof(hash);
+        rc = digest_single(&mech, msgs[i], lens[i], hash, &hash_len);
+        if (rc != CKR_OK) {
+            testcase_error("C_DigestInit/C_Digest rc=%s", p11_get_ckr(rc));
+            goto out;
+        }
+        if (memcmp(digests + i * hash_len, hash, hash_len) != 0) {
+            testcase_fail("Digest of message %lu (%lu bytes) differs", i,
+                          lens[i]);
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+    }
+
+    /* An empty batch */
+    digests_len = 0;
+    rc = _C_IBM_DigestBatch(session, &mech, 0, NULL, NULL, digests,
+                            &digests_len);
+    if (rc != CKR_OK || digests_len != 0) {
+        testcase_fail("C_IBM_DigestBatch of an empty batch rc=%s, len=%lu",
+                      p11_get_ckr(rc), digests_len);
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    /* A message without data but with a length */
+    msgs[BATCH_COUNT / 2] = NULL;
+    lens[BATCH_COUNT / 2] = 1;
+    digests_len = BATCH_COUNT * hash_len;
+    rc = _C_IBM_DigestBatch(session, &mech, BATCH_COUNT, msgs, lens, digests,
+                            &digests_len);
+    if (rc != CKR_ARGUMENTS_BAD) {
+        testcase_fail("C_IBM_DigestBatch with a NULL message rc=%s, "
+                      "expected CKR_ARGUMENTS_BAD", p11_get_ckr(rc));
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+    rc = CKR_OK;
+
+    testcase_pass("C_IBM_DigestBatch with %s", mech_to_str(mech_type));
+
+out:
+    free(data);
+    free(digests);
+    return rc;
+}
+
+static CK_RV do_digest_batch_bench(CK_MECHANISM_TYPE mech_type)
+{
+    CK_MECHANISM mech = { mech_type, NULL, 0 };
+    CK_BYTE **msgs = NULL, *data = NULL, *digests = NULL;
+    CK_ULONG *lens = NULL, count, digests_len, hash_len, i, k;
+    CK_BYTE hash[MAX_HASH_SIZE];
+    struct timespec start;
+    double loop_us, batch_us;
+    CK_RV rc = CKR_OK;
+
+    testcase_begin("C_IBM_DigestBatch benchmark with %s",
+                   mech_to_str(mech_type));
+
+    if (!mech_supported(slot_id, mech_type)) {
+        testcase_skip("Slot %lu doesn't support %s", slot_id,
+                      mech_to_str(mech_type));
+        return CKR_OK;
+    }
+
+    count = BENCH_TOTAL_LEN / bench_sizes[0];
+    data = malloc(BENCH_TOTAL_LEN);
+    msgs = calloc(count, sizeof(*msgs));
+    lens = calloc(count, sizeof(*lens));
+    digests = calloc(count, MAX_HASH_SIZE);
+    if (data == NULL || msgs == NULL || lens == NULL || digests == NULL) {
+        testcase_error("malloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+    memset(data, 0x5a, BENCH_TOTAL_LEN);
+
+    testcase_new_assertion();
+    printf("%10s %10s %14s %14s %8s\n", "size", "count", "loop MB/s",
+           "batch MB/s", "speedup");
+
+    for (k = 0; k < (sizeof(bench_sizes) / sizeof(bench_sizes[0])); k++) {
+        count = BENCH_TOTAL_LEN / bench_sizes[k];
+        for (i = 0; i < count; i++) {
+            msgs[i] = data + i * bench_sizes[k];
+            lens[i] = bench_sizes[k];
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < count; i++) {
+            hash_len = sizeof(hash);
+            rc = digest_single(&mech, msgs[i], lens[i], hash, &hash_len);
+            if (rc != CKR_OK) {
+                testcase_error("C_DigestInit/C_Digest rc=%s",
+                               p11_get_ckr(rc));
+                goto out;
+            }
+        }
+        loop_us = elapsed_us(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        digests_len = count * MAX_HASH_SIZE;
+        rc = _C_IBM_DigestBatch(session, &mech, count, msgs, lens, digests,
+                                &digests_len);
+        if (rc != CKR_OK) {
+            if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+                testcase_skip("Slot %lu does not support C_IBM_DigestBatch",
+                              slot_id);
+                rc = CKR_OK;
+                goto out;
+            }
+            testcase_fail("C_IBM_DigestBatch rc=%s", p11_get_ckr(rc));
+            goto out;
+        }
+        batch_us = elapsed_us(&start);
+
+        printf("%10lu %10lu %14.1f %14.1f %7.2fx\n", bench_sizes[k], count,
+               BENCH_TOTAL_LEN / loop_us, BENCH_TOTAL_LEN / batch_us,
+               loop_us / batch_us);
+    }
+
+    testcase_pass("C_IBM_DigestBatch benchmark with %s",
+                  mech_to_str(mech_type));
+
+out:
+    free(data);
+    free(msgs);
+    free(lens);
+    free(digests);
+    return rc;
+}
+
+static CK_RV do_digest_batch_tests(void)
+{
+    CK_ULONG i;
+    CK_RV rc;
+
+    for (i = 0; i < (sizeof(digest_mechs) / sizeof(digest_mechs[0])); i++) {
+        rc = do_digest_batch_mech(digest_mechs[i]);
+        if (rc != CKR_OK)
+            return rc;
+    }
+
+    return CKR_OK;
+}
+
+static CK_RV do_digest_batch_benches(void)
+{
+    CK_RV rc;
+
+    rc = do_digest_batch_bench(CKM_SHA256);
+    if (rc != CKR_OK)
+        return rc;
+
+    return do_digest_batch_bench(CKM_SHA512);
+}
+
+static const struct ext_test_func digest_batch_funcs[] = {
+    { "C_IBM_DigestBatch", (void **)&_C_IBM_DigestBatch },
+    { NULL, NULL },
+};
+
+int main(int argc, char **argv)
+{
+    struct ext_test test = {
+        .ext_funcs = digest_batch_funcs,
+        .bench_help = "also compares the batch call with single digests",
+        .run_tests = do_digest_batch_tests,
+        .run_bench = do_digest_batch_benches,
+        .slot_id = &slot_id,
+        .session = &session,
+    };
+
+    return do_ext_test_main(argc, argv, &test);
+}
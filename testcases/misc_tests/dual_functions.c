@@ -37,6 +37,9 @@ CK_MECHANISM digest_mech = { CKM_SHA256, NULL, 0 };
 CK_BYTE data1[512];
 CK_BYTE data2[512];
 
+/* Larger than the chunks of the fused dual-function update, 16 byte aligned */
+#define LARGE_DATA_LEN  (100 * 1024 + 64)
+
 
 CK_RV do_digest_encrypt_decrypt_digest(void)
 {
@@ -986,6 +989,219 @@ testcase_cleanup:
 
 }
 
+/*
+ * Large buffers are processed in chunks by the fused dual-function update,
+ * the results must match the single-function operations, also when the
+ * data is encrypted and decrypted in place.
+ */
+CK_RV do_digest_encrypt_large_in_place(void)
+{
+    CK_SESSION_HANDLE session;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_RV rc = CKR_OK, loc_rc;
+    CK_FLAGS flags;
+    CK_OBJECT_HANDLE aes_key = CK_INVALID_HANDLE;
+    CK_BYTE *data = NULL, *buf = NULL, *expected = NULL;
+    CK_ULONG data_len = LARGE_DATA_LEN, buf_len, expected_len, final_len;
+    CK_BYTE digest1[32], digest2[32], final[16];
+    CK_ULONG digest1_len, digest2_len, i;
+
+    testcase_begin("C_DigestEncryptUpdate in place with %lu bytes", data_len);
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    if (!mech_supported(SLOT_ID, digest_mech.mechanism) ||
+        !mech_supported(SLOT_ID, endecrypt_mech.mechanism) ||
+        !mech_supported(SLOT_ID, aeskeygen_mech.mechanism)) {
+        testcase_skip("Slot %u doesn't support %s, %s or %s",
+                      (unsigned int)SLOT_ID,
+                      mech_to_str(digest_mech.mechanism),
+                      mech_to_str(endecrypt_mech.mechanism),
+                      mech_to_str(aeskeygen_mech.mechanism));
+        goto testcase_cleanup;
+    }
+
+    data = malloc(data_len);
+    buf = malloc(data_len);
+    expected = malloc(data_len);
+    if (data == NULL || buf == NULL || expected == NULL) {
+        testcase_error("malloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto testcase_cleanup;
+    }
+    for (i = 0; i < data_len; i++)
+        data[i] = i * 7;
+
+    rc = generate_AESKey(session, 256 / 8, CK_TRUE, &aeskeygen_mech, &aes_key);
+    if (rc != CKR_OK) {
+        if (rc == CKR_POLICY_VIOLATION) {
+            testcase_skip("generate key with mech %s (%u) in slot %lu "
+                          "is not allowed by policy",
+                          mech_to_str(aeskeygen_mech.mechanism),
+                          (unsigned int)aeskeygen_mech.mechanism,
+                          SLOT_ID);
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+
+        testcase_error("generate key with mech %s (%u) in slot %lu failed, rc=%s",
+                       mech_to_str(aeskeygen_mech.mechanism),
+                       (unsigned int)aeskeygen_mech.mechanism,
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    testcase_new_assertion();
+
+    /* Reference results of the single-function operations */
+    rc = funcs->C_EncryptInit(session, &endecrypt_mech, aes_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_EncryptInit in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    expected_len = data_len;
+    rc = funcs->C_Encrypt(session, data, data_len, expected, &expected_len);
+    if (rc != CKR_OK) {
+        testcase_error("C_Encrypt in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    rc = funcs->C_DigestInit(session, &digest_mech);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestInit in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    digest1_len = sizeof(digest1);
+    rc = funcs->C_Digest(session, data, data_len, digest1, &digest1_len);
+    if (rc != CKR_OK) {
+        testcase_error("C_Digest in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    /* Digest and encrypt in place */
+    rc = funcs->C_EncryptInit(session, &endecrypt_mech, aes_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_EncryptInit in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    rc = funcs->C_DigestInit(session, &digest_mech);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestInit in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    memcpy(buf, data, data_len);
+    buf_len = data_len;
+    rc = funcs->C_DigestEncryptUpdate(session, buf, data_len, buf, &buf_len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestEncryptUpdate in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    final_len = sizeof(final);
+    rc = funcs->C_EncryptFinal(session, final, &final_len);
+    if (rc != CKR_OK) {
+        testcase_error("C_EncryptFinal in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    digest2_len = sizeof(digest2);
+    rc = funcs->C_DigestFinal(session, digest2, &digest2_len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestFinal in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    if (buf_len != expected_len || final_len != 0 ||
+        memcmp(buf, expected, expected_len) != 0) {
+        testcase_fail("Wrong encrypted data from C_DigestEncryptUpdate");
+        goto testcase_cleanup;
+    }
+    if (digest2_len != digest1_len ||
+        memcmp(digest1, digest2, digest1_len) != 0) {
+        testcase_fail("Wrong digest after C_DigestEncryptUpdate");
+        goto testcase_cleanup;
+    }
+
+    /* Decrypt and digest in place */
+    rc = funcs->C_DecryptInit(session, &endecrypt_mech, aes_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_DecryptInit in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    rc = funcs->C_DigestInit(session, &digest_mech);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestInit in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    buf_len = data_len;
+    rc = funcs->C_DecryptDigestUpdate(session, buf, expected_len, buf,
+                                      &buf_len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DecryptDigestUpdate in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    final_len = sizeof(final);
+    rc = funcs->C_DecryptFinal(session, final, &final_len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DecryptFinal in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+    digest2_len = sizeof(digest2);
+    rc = funcs->C_DigestFinal(session, digest2, &digest2_len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestFinal in slot %lu failed, rc=%s",
+                       SLOT_ID, p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    if (buf_len != data_len || final_len != 0 ||
+        memcmp(buf, data, data_len) != 0) {
+        testcase_fail("Wrong decrypted data from C_DecryptDigestUpdate");
+        goto testcase_cleanup;
+    }
+    if (digest2_len != digest1_len ||
+        memcmp(digest1, digest2, digest1_len) != 0) {
+        testcase_fail("Wrong digest after C_DecryptDigestUpdate");
+        goto testcase_cleanup;
+    }
+
+    testcase_pass("C_DigestEncryptUpdate in place with %lu bytes", data_len);
+
+testcase_cleanup:
+    if (aes_key != CK_INVALID_HANDLE) {
+        loc_rc = funcs->C_DestroyObject(session, aes_key);
+        if (loc_rc != CKR_OK)
+            testcase_error("C_DestroyObject(), rc=%s.", p11_get_ckr(loc_rc));
+    }
+
+    free(data);
+    free(buf);
+    free(expected);
+
+    testcase_user_logout();
+    rc = funcs->C_CloseAllSessions(SLOT_ID);
+    if (rc != CKR_OK) {
+        testcase_error("C_CloseAllSessions rc=%s", p11_get_ckr(rc));
+    }
+
+    return rc;
+}
+
 CK_RV do_dual_functions_tests(void)
 {
     CK_RV rc = CKR_OK;
@@ -996,6 +1212,8 @@ CK_RV do_dual_functions_tests(void)
 
     rc |= do_save_restore_dual_state();
 
+    rc |= do_digest_encrypt_large_in_place();
+
     return rc;
 }
 
@@ -0,0 +1,559 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/* File: getattr_batch.c
+ *
+ * Test driver for the C_IBM_GetAttributeValueBatch vendor function. The
+ * templates returned for a batch of objects are compared with the results
+ * of C_GetAttributeValue per object, and the batch call is benchmarked
+ * against a C_GetAttributeValue loop. A token object that has been changed
+ * by another process and whose handle is given twice in a batch must be
+ * reloaded and returned correctly for both entries.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "pkcs11types.h"
+#include "regress.h"
+#include "common.c"
+
+#define NUM_TEST_OBJS       40
+#define NUM_TEST_ATTRS      6
+#define BENCH_COUNT         10000
+#define BENCH_CHUNK         64
+/* Stay well below the token object limit of the shared memory segment */
+#define BENCH_MAX_TOK_OBJS  1000
+
+CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+CK_ULONG user_pin_len;
+CK_SLOT_ID slot_id = 1;
+CK_ULONG bench_count = BENCH_COUNT;
+
+CK_SESSION_HANDLE session;
+
+CK_C_IBM_GetAttributeValueBatch _C_IBM_GetAttributeValueBatch;
+
+static CK_RV create_aes_key(CK_ULONG idx, CK_BBOOL token, CK_BBOOL private,
+                            CK_BBOOL sensitive, CK_OBJECT_HANDLE *key)
+{
+    CK_OBJECT_CLASS class = CKO_SECRET_KEY;
+    CK_KEY_TYPE type = CKK_AES;
+    CK_BYTE value[32];
+    char label[64];
+    CK_ATTRIBUTE tmpl[] = {
+        { CKA_CLASS, &class, sizeof(class) },
+        { CKA_KEY_TYPE, &type, sizeof(type) },
+        { CKA_TOKEN, &token, sizeof(token) },
+        { CKA_PRIVATE, &private, sizeof(private) },
+        { CKA_SENSITIVE, &sensitive, sizeof(sensitive) },
+        { CKA_VALUE, value, 16 + (idx % 3) * 8 },
+        { CKA_LABEL, label, 0 },
+    };
+
+    memset(value, idx & 0xff, sizeof(value));
+    snprintf(label, sizeof(label), "getattr_batch key %lu", idx);
+    tmpl[6].ulValueLen = strlen(label);
+
+    return funcs->C_CreateObject(session, tmpl,
+                                 sizeof(tmpl) / sizeof(tmpl[0]), key);
+}
+
+static void destroy_objects(CK_OBJECT_HANDLE *objs, CK_ULONG num)
+{
+    CK_ULONG i;
+
+    for (i = 0; i < num; i++) {
+        if (objs[i] != CK_INVALID_HANDLE)
+            funcs->C_DestroyObject(session, objs[i]);
+    }
+}
+
+/*
+ * Sets up the template of an object. Depending on the object, the template
+ * contains a length query, a buffer that is too small, a sensitive or an
+ * invalid attribute.
+ */
+static void setup_template(CK_ULONG idx, CK_ATTRIBUTE *attrs, CK_BYTE *bufs,
+                           CK_ULONG buf_len)
+{
+    CK_ULONG i;
+
+    attrs[0].type = CKA_CLASS;
+    attrs[1].type = CKA_KEY_TYPE;
+    attrs[2].type = CKA_LABEL;
+    attrs[3].type = CKA_VALUE_LEN;
+    switch (idx % 4) {
+    case 0:
+        /* Sensitive for these keys */
+        attrs[4].type = CKA_VALUE;
+        break;
+    case 1:
+        /* Not valid for AES keys */
+        attrs[4].type = CKA_MODULUS;
+        break;
+    default:
+        attrs[4].type = CKA_ID;
+        break;
+    }
+    attrs[5].type = CKA_SENSITIVE;
+
+    for (i = 0; i < NUM_TEST_ATTRS; i++) {
+        memset(bufs + i * buf_len, 0, buf_len);
+        attrs[i].pValue = bufs + i * buf_len;
+        attrs[i].ulValueLen = buf_len;
+    }
+
+    switch (idx % 5) {
+    case 1:
+        /* Length query for the label */
+        attrs[2].pValue = NULL;
+        attrs[2].ulValueLen = 0;
+        break;
+    case 2:
+        /* Label buffer too small */
+        attrs[2].ulValueLen = 3;
+        break;
+    default:
+        break;
+    }
+}
+
+static int compare_templates(CK_ATTRIBUTE *attrs1, CK_ATTRIBUTE *attrs2)
+{
+    CK_ULONG i;
+
+    for (i = 0; i < NUM_TEST_ATTRS; i++) {
+        if (attrs1[i].ulValueLen != attrs2[i].ulValueLen)
+            return -1;
+        if (attrs1[i].pValue == NULL || attrs2[i].pValue == NULL ||
+            attrs1[i].ulValueLen == CK_UNAVAILABLE_INFORMATION)
+            continue;
+        if (memcmp(attrs1[i].pValue, attrs2[i].pValue,
+                   attrs1[i].ulValueLen) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static CK_RV do_getattr_batch_test(void)
+{
+    CK_OBJECT_HANDLE objs[NUM_TEST_OBJS + 1];
+    CK_ATTRIBUTE attrs[NUM_TEST_OBJS + 1][NUM_TEST_ATTRS];
+    CK_ATTRIBUTE single[NUM_TEST_ATTRS];
+    CK_ATTRIBUTE *templates[NUM_TEST_OBJS + 1];
+    CK_ULONG counts[NUM_TEST_OBJS + 1];
+    CK_RV results[NUM_TEST_OBJS + 1];
+    CK_BYTE bufs[NUM_TEST_OBJS + 1][NUM_TEST_ATTRS * 64];
+    CK_BYTE single_bufs[NUM_TEST_ATTRS * 64];
+    CK_ULONG i;
+    CK_RV rc;
+
+    testcase_begin("C_IBM_GetAttributeValueBatch compared with "
+                   "C_GetAttributeValue");
+
+    for (i = 0; i <= NUM_TEST_OBJS; i++)
+        objs[i] = CK_INVALID_HANDLE;
+
+    /* Token and session objects, public and private, sensitive or not */
+    for (i = 0; i < NUM_TEST_OBJS; i++) {
+        rc = create_aes_key(i, i % 2 == 0, i % 3 == 0, i % 4 == 0, &objs[i]);
+        if (rc != CKR_OK) {
+            if (is_rejected_by_policy(rc, session)) {
+                testcase_skip("AES keys are rejected by policy");
+                rc = CKR_OK;
+                goto out;
+            }
+            testcase_error("C_CreateObject rc=%s", p11_get_ckr(rc));
+            goto out;
+        }
+    }
+    /* An invalid handle, the last object is destroyed below */
+    rc = create_aes_key(NUM_TEST_OBJS, TRUE, FALSE, FALSE,
+                        &objs[NUM_TEST_OBJS]);
+    if (rc != CKR_OK) {
+        testcase_error("C_CreateObject rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+    funcs->C_DestroyObject(session, objs[NUM_TEST_OBJS]);
+
+    for (i = 0; i <= NUM_TEST_OBJS; i++) {
+        setup_template(i, attrs[i], bufs[i], 64);
+        templates[i] = attrs[i];
+        counts[i] = NUM_TEST_ATTRS;
+        results[i] = CKR_FUNCTION_FAILED;
+    }
+
+    testcase_new_assertion();
+
+    rc = _C_IBM_GetAttributeValueBatch(session, NUM_TEST_OBJS + 1, objs,
+                                       templates, counts, results);
+    if (rc != CKR_OK) {
+        if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+            testcase_skip("Slot %lu does not support "
+                          "C_IBM_GetAttributeValueBatch", slot_id);
+            rc = CKR_OK;
+            goto out;
+        }
+        testcase_fail("C_IBM_GetAttributeValueBatch rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    for (i = 0; i <= NUM_TEST_OBJS; i++) {
+        setup_template(i, single, single_bufs, 64);
+        rc = funcs->C_GetAttributeValue(session, objs[i], single,
+                                        NUM_TEST_ATTRS);
+        if (rc != results[i]) {
+            testcase_fail("Object %lu: batch rc=%s, single rc=%s", i,
+                          p11_get_ckr(results[i]), p11_get_ckr(rc));
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+        if (rc != CKR_OBJECT_HANDLE_INVALID &&
+            compare_templates(attrs[i], single) != 0) {
+            testcase_fail("Object %lu: the templates differ", i);
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+    }
+
+    if (results[NUM_TEST_OBJS] != CKR_OBJECT_HANDLE_INVALID ||
+        results[2] != CKR_BUFFER_TOO_SMALL || results[3] != CKR_OK ||
+        results[4] != CKR_ATTRIBUTE_SENSITIVE ||
+        results[5] != CKR_ATTRIBUTE_TYPE_INVALID) {
+        testcase_fail("Unexpected results: %s, %s, %s, %s, %s",
+                      p11_get_ckr(results[NUM_TEST_OBJS]),
+                      p11_get_ckr(results[2]), p11_get_ckr(results[3]),
+                      p11_get_ckr(results[4]), p11_get_ckr(results[5]));
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    /* An empty batch */
+    rc = _C_IBM_GetAttributeValueBatch(session, 0, NULL, NULL, NULL, NULL);
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_GetAttributeValueBatch of an empty batch rc=%s",
+                      p11_get_ckr(rc));
+        goto out;
+    }
+
+    testcase_pass("C_IBM_GetAttributeValueBatch compared with "
+                  "C_GetAttributeValue");
+
+out:
+    destroy_objects(objs, NUM_TEST_OBJS);
+    return rc;
+}
+
+/*
+ * Changes the label of a token object in a child process, so that the object
+ * is stale in this process.
+ */
+static int change_label_in_child(const char *old_label, const char *new_label)
+{
+    CK_C_INITIALIZE_ARGS cinit_args;
+    CK_SESSION_HANDLE sess;
+    CK_OBJECT_HANDLE obj;
+    CK_ULONG num = 0;
+    CK_ATTRIBUTE find_tmpl[] = {
+        { CKA_LABEL, (CK_VOID_PTR)old_label, strlen(old_label) },
+    };
+    CK_ATTRIBUTE set_tmpl[] = {
+        { CKA_LABEL, (CK_VOID_PTR)new_label, strlen(new_label) },
+    };
+    int status;
+    pid_t pid;
+    CK_RV rc;
+
+    pid = fork();
+    if (pid < 0)
+        return -1;
+
+    if (pid == 0) {
+        memset(&cinit_args, 0, sizeof(cinit_args));
+        cinit_args.flags = CKF_OS_LOCKING_OK;
+        if (funcs->C_Initialize(&cinit_args) != CKR_OK)
+            _exit(1);
+
+        if (funcs->C_OpenSession(slot_id, CKF_SERIAL_SESSION | CKF_RW_SESSION,
+                                 NULL, NULL, &sess) != CKR_OK)
+            _exit(1);
+
+        rc = funcs->C_Login(sess, CKU_USER, user_pin, user_pin_len);
+        if (rc != CKR_OK && rc != CKR_USER_ALREADY_LOGGED_IN)
+            _exit(1);
+
+        /* Object handles are only valid within a process */
+        if (funcs->C_FindObjectsInit(sess, find_tmpl, 1) != CKR_OK ||
+            funcs->C_FindObjects(sess, &obj, 1, &num) != CKR_OK ||
+            funcs->C_FindObjectsFinal(sess) != CKR_OK || num != 1)
+            _exit(1);
+
+        if (funcs->C_SetAttributeValue(sess, obj, set_tmpl, 1) != CKR_OK)
+            _exit(1);
+
+        funcs->C_Finalize(NULL);
+        _exit(0);
+    }
+
+    if (waitpid(pid, &status, 0) != pid)
+        return -1;
+
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+static CK_RV do_getattr_batch_stale_test(void)
+{
+    CK_OBJECT_HANDLE obj = CK_INVALID_HANDLE, objs[2];
+    CK_BYTE labels[2][64];
+    CK_ATTRIBUTE attrs[2][1];
+    CK_ATTRIBUTE *templates[2];
+    CK_ULONG counts[2], i;
+    CK_RV results[2];
+    const char *new_label = "getattr_batch changed";
+    CK_RV rc;
+
+    testcase_begin("C_IBM_GetAttributeValueBatch with a duplicated handle "
+                   "of a stale token object");
+
+    rc = create_aes_key(NUM_TEST_OBJS + 1, TRUE, FALSE, FALSE, &obj);
+    if (rc != CKR_OK) {
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("AES keys are rejected by policy");
+            rc = CKR_OK;
+            goto out;
+        }
+        testcase_error("C_CreateObject rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    testcase_new_assertion();
+
+    snprintf((char *)labels[0], sizeof(labels[0]), "getattr_batch key %u",
+             NUM_TEST_OBJS + 1);
+    if (change_label_in_child((char *)labels[0], new_label) != 0) {
+        testcase_error("Changing the label in a child process failed");
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    for (i = 0; i < 2; i++) {
+        memset(labels[i], 0, sizeof(labels[i]));
+        attrs[i][0].type = CKA_LABEL;
+        attrs[i][0].pValue = labels[i];
+        attrs[i][0].ulValueLen = sizeof(labels[i]);
+        templates[i] = attrs[i];
+        counts[i] = 1;
+        results[i] = CKR_FUNCTION_FAILED;
+        objs[i] = obj;
+    }
+
+    rc = _C_IBM_GetAttributeValueBatch(session, 2, objs, templates, counts,
+                                       results);
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_GetAttributeValueBatch rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    for (i = 0; i < 2; i++) {
+        if (results[i] != CKR_OK ||
+            attrs[i][0].ulValueLen != strlen(new_label) ||
+            memcmp(labels[i], new_label, strlen(new_label)) != 0) {
+            testcase_fail("Entry %lu: rc=%s, the changed label is not "
+                          "returned", i, p11_get_ckr(results[i]));
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+    }
+
+    testcase_pass("C_IBM_GetAttributeValueBatch with a duplicated handle "
+                  "of a stale token object");
+
+out:
+    if (obj != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, obj);
+    return rc;
+}
+
+static CK_RV do_getattr_batch_bench(void)
+{
+    CK_OBJECT_HANDLE *objs = NULL;
+    CK_OBJECT_CLASS *classes = NULL;
+    CK_KEY_TYPE *types = NULL;
+    CK_ULONG *lens = NULL;
+    CK_ATTRIBUTE *attrs = NULL, **templates = NULL;
+    CK_ULONG *counts = NULL, i, k, n;
+    CK_RV *results = NULL;
+    struct timespec start;
+    double loop_us, batch_us;
+    CK_RV rc = CKR_OK;
+
+    testcase_begin("C_IBM_GetAttributeValueBatch benchmark with %lu "
+                   "objects", bench_count);
+
+    objs = calloc(bench_count, sizeof(*objs));
+    classes = calloc(bench_count, sizeof(*classes));
+    types = calloc(bench_count, sizeof(*types));
+    lens = calloc(bench_count, sizeof(*lens));
+    attrs = calloc(bench_count * 3, sizeof(*attrs));
+    templates = calloc(bench_count, sizeof(*templates));
+    counts = calloc(bench_count, sizeof(*counts));
+    results = calloc(bench_count, sizeof(*results));
+    if (objs == NULL || classes == NULL || types == NULL || lens == NULL ||
+        attrs == NULL || templates == NULL || counts == NULL ||
+        results == NULL) {
+        testcase_error("malloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    for (i = 0; i < bench_count; i++) {
+        rc = create_aes_key(i, i < BENCH_MAX_TOK_OBJS, FALSE, FALSE,
+                            &objs[i]);
+        if (rc != CKR_OK) {
+            testcase_error("C_CreateObject rc=%s", p11_get_ckr(rc));
+            goto out;
+        }
+    }
+
+    for (i = 0; i < bench_count; i++) {
+        attrs[i * 3] = (CK_ATTRIBUTE){ CKA_CLASS, &classes[i],
+                                       sizeof(classes[i]) };
+        attrs[i * 3 + 1] = (CK_ATTRIBUTE){ CKA_KEY_TYPE, &types[i],
+                                           sizeof(types[i]) };
+        attrs[i * 3 + 2] = (CK_ATTRIBUTE){ CKA_VALUE_LEN, &lens[i],
+                                           sizeof(lens[i]) };
+        templates[i] = &attrs[i * 3];
+        counts[i] = 3;
+    }
+
+    testcase_new_assertion();
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_count; i++) {
+        rc = funcs->C_GetAttributeValue(session, objs[i], templates[i],
+                                        counts[i]);
+        if (rc != CKR_OK) {
+            testcase_error("C_GetAttributeValue rc=%s", p11_get_ckr(rc));
+            goto out;
+        }
+    }
+    loop_us = elapsed_us(&start);
+
+    /* In chunks, as C_FindObjects returns them to p11sak */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (k = 0; k < bench_count; k += n) {
+        n = bench_count - k < BENCH_CHUNK ? bench_count - k : BENCH_CHUNK;
+        rc = _C_IBM_GetAttributeValueBatch(session, n, &objs[k],
+                                           &templates[k], &counts[k],
+                                           &results[k]);
+        if (rc != CKR_OK) {
+            testcase_fail("C_IBM_GetAttributeValueBatch rc=%s",
+                          p11_get_ckr(rc));
+            goto out;
+        }
+    }
+    batch_us = elapsed_us(&start);
+
+    for (i = 0; i < bench_count; i++) {
+        if (results[i] != CKR_OK || classes[i] != CKO_SECRET_KEY ||
+            types[i] != CKK_AES) {
+            testcase_fail("Object %lu: rc=%s", i, p11_get_ckr(results[i]));
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+    }
+
+    printf("%10s %14s %14s %8s\n", "objects", "loop objs/s", "batch objs/s",
+           "speedup");
+    printf("%10lu %14.1f %14.1f %7.2fx\n", bench_count,
+           bench_count * 1e6 / loop_us, bench_count * 1e6 / batch_us,
+           loop_us / batch_us);
+
+    testcase_pass("C_IBM_GetAttributeValueBatch benchmark with %lu "
+                  "objects", bench_count);
+
+out:
+    if (objs != NULL)
+        destroy_objects(objs, bench_count);
+    free(objs);
+    free(classes);
+    free(types);
+    free(lens);
+    free(attrs);
+    free(templates);
+    free(counts);
+    free(results);
+    return rc;
+}
+
+static CK_RV do_getattr_batch_tests(void)
+{
+    CK_RV rc;
+
+    rc = do_getattr_batch_test();
+    if (rc != CKR_OK)
+        return rc;
+
+    return do_getattr_batch_stale_test();
+}
+
+static int parse_getattr_batch_arg(int argc, char **argv, int *i)
+{
+    if (strcmp(argv[*i], "-count") != 0)
+        return 0;
+
+    ++(*i);
+    if (*i >= argc) {
+        printf("Object count missing\n");
+        return -1;
+    }
+    bench_count = strtoul(argv[*i], NULL, 10);
+    if (bench_count == 0) {
+        printf("Invalid -count value\n");
+        return -1;
+    }
+
+    return 1;
+}
+
+static const struct ext_test_func getattr_batch_funcs[] = {
+    { "C_IBM_GetAttributeValueBatch",
+      (void **)&_C_IBM_GetAttributeValueBatch },
+    { NULL, NULL },
+};
+
+int main(int argc, char **argv)
+{
+    static char bench_help[200];
+    struct ext_test test = {
+        .ext_funcs = getattr_batch_funcs,
+        .bench_options = "[-count <num>]",
+        .bench_help = bench_help,
+        .parse_arg = parse_getattr_batch_arg,
+        .run_tests = do_getattr_batch_tests,
+        .run_bench = do_getattr_batch_bench,
+        .slot_id = &slot_id,
+        .session = &session,
+        .user_pin = user_pin,
+        .user_pin_len = &user_pin_len,
+    };
+
+    snprintf(bench_help, sizeof(bench_help), "also compares the batch call "
+             "with single calls on <num> objects (default %u), the first %u "
+             "of them\nbeing token objects", BENCH_COUNT, BENCH_MAX_TOK_OBJS);
+
+    return do_ext_test_main(argc, argv, &test);
+}
@@ -9,7 +9,9 @@ noinst_PROGRAMS +=							\
 	testcases/misc_tests/obj_lock testcases/misc_tests/reencrypt    \
 	testcases/misc_tests/cca_export_import_test			\
 	testcases/misc_tests/events testcases/misc_tests/dual_functions \
-	testcases/misc_tests/always_auth
+	testcases/misc_tests/always_auth testcases/misc_tests/tok_bench	\
+	testcases/misc_tests/digest_batch testcases/misc_tests/reencrypt_batch \
+	testcases/misc_tests/getattr_batch testcases/misc_tests/op_ctx_arena
 
 EXTRA_DIST += testcases/misc_tests/dh-key.pem				\
 	testcases/misc_tests/dsa-key.pem				\
@@ -102,6 +104,26 @@ testcases_misc_tests_reencrypt_LDADD = testcases/common/libcommon.la
 testcases_misc_tests_reencrypt_SOURCES = 			\
 	testcases/misc_tests/reencrypt.c
 
+testcases_misc_tests_digest_batch_CFLAGS = ${testcases_inc}
+testcases_misc_tests_digest_batch_LDADD = testcases/common/libcommon.la
+testcases_misc_tests_digest_batch_SOURCES = 			\
+	testcases/misc_tests/digest_batch.c
+
+testcases_misc_tests_reencrypt_batch_CFLAGS = ${testcases_inc}
+testcases_misc_tests_reencrypt_batch_LDADD = testcases/common/libcommon.la
+testcases_misc_tests_reencrypt_batch_SOURCES = 			\
+	testcases/misc_tests/reencrypt_batch.c
+
+testcases_misc_tests_getattr_batch_CFLAGS = ${testcases_inc}
+testcases_misc_tests_getattr_batch_LDADD = testcases/common/libcommon.la
+testcases_misc_tests_getattr_batch_SOURCES = 			\
+	testcases/misc_tests/getattr_batch.c
+
+testcases_misc_tests_op_ctx_arena_CFLAGS = ${testcases_inc}
+testcases_misc_tests_op_ctx_arena_LDADD = testcases/common/libcommon.la
+testcases_misc_tests_op_ctx_arena_SOURCES = 			\
+	testcases/misc_tests/op_ctx_arena.c
+
 testcases_misc_tests_cca_export_import_test_CFLAGS = ${testcases_inc}
 testcases_misc_tests_cca_export_import_test_LDADD =			\
 	testcases/common/libcommon.la
@@ -122,3 +144,7 @@ testcases_misc_tests_always_auth_CFLAGS = ${testcases_inc}
 testcases_misc_tests_always_auth_LDADD = testcases/common/libcommon.la
 testcases_misc_tests_always_auth_SOURCES = 				\
 	testcases/misc_tests/always_auth.c
+
+testcases_misc_tests_tok_bench_CFLAGS = ${testcases_inc}
+testcases_misc_tests_tok_bench_LDADD = testcases/common/libcommon.la
+testcases_misc_tests_tok_bench_SOURCES = testcases/misc_tests/tok_bench.c
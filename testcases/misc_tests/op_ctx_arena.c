@@ -0,0 +1,842 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/* File: op_ctx_arena.c
+ *
+ * Test driver for the per-session operation context arena. Operations with
+ * nested contexts (a hash-and-sign operation holds a digest context), several
+ * operations active at the same time, dual-function operations and repeated
+ * operations reusing the arena chunks are run in sessions opened with
+ * OPENCRYPTOKI_OP_CONTEXT_ARENA=0 (contexts are malloc'ed), =1 and =mlock.
+ * The results must be the same in all of them.
+ *
+ * With -bench, threads with their own session each run short AES-ECB encrypt
+ * and AES-MAC sign operations with malloc'ed contexts and with the arena, to
+ * show the allocator contention of the operation contexts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pkcs11types.h"
+#include "regress.h"
+#include "common.c"
+
+#define OP_CONTEXT_ARENA_ENV    "OPENCRYPTOKI_OP_CONTEXT_ARENA"
+
+#define DATA_LEN            1000
+#define NUM_PARTS           3
+#define BLOCK_LEN           16
+#define REUSE_LOOPS         50
+
+#define BENCH_THREADS       8
+#define BENCH_SECONDS       2
+
+CK_SLOT_ID slot_id = 1;
+unsigned long bench_threads = BENCH_THREADS;
+unsigned long bench_seconds = BENCH_SECONDS;
+
+CK_SESSION_HANDLE session;
+CK_OBJECT_HANDLE aes_key = CK_INVALID_HANDLE;
+CK_OBJECT_HANDLE rsa_publ_key = CK_INVALID_HANDLE;
+CK_OBJECT_HANDLE rsa_priv_key = CK_INVALID_HANDLE;
+CK_MECHANISM_TYPE rsa_hash_mech = CKM_MD5_RSA_PKCS;
+
+CK_BYTE data[DATA_LEN];
+CK_BYTE iv[BLOCK_LEN];
+
+const char *arena_modes[] = { "0", "1", "mlock" };
+
+enum {
+    OUT_SIGNATURE = 0,
+    OUT_DIGEST,
+    OUT_CIPHERTEXT,
+    OUT_CMAC,
+    OUT_DUAL_DIGEST,
+    OUT_DUAL_DIGEST_CIPHERTEXT,
+    OUT_DUAL_SIGN_CIPHERTEXT,
+    OUT_DUAL_CMAC,
+    NUM_OUTPUTS,
+};
+
+const char *output_names[NUM_OUTPUTS] = {
+    "signature", "digest", "ciphertext", "CMAC", "dual-function digest",
+    "dual-function digest ciphertext", "dual-function sign ciphertext",
+    "dual-function CMAC",
+};
+
+struct op_output {
+    CK_BYTE buf[DATA_LEN + 2 * BLOCK_LEN];
+    CK_ULONG len;
+};
+
+struct op_outputs {
+    struct op_output out[NUM_OUTPUTS];
+};
+
+static CK_RV open_session(const char *mode, CK_SESSION_HANDLE *sess)
+{
+    CK_RV rc;
+
+    if (setenv(OP_CONTEXT_ARENA_ENV, mode, 1) != 0) {
+        testcase_error("setenv failed");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    /* The arena mode is taken when the session is opened */
+    rc = funcs->C_OpenSession(slot_id, CKF_SERIAL_SESSION | CKF_RW_SESSION,
+                              NULL, NULL, sess);
+    if (rc != CKR_OK)
+        testcase_error("C_OpenSession rc=%s", p11_get_ckr(rc));
+
+    unsetenv(OP_CONTEXT_ARENA_ENV);
+    return rc;
+}
+
+static CK_RV generate_keys(void)
+{
+    CK_MECHANISM aes_mech = { CKM_AES_KEY_GEN, NULL, 0 };
+    CK_MECHANISM rsa_mech = { CKM_RSA_PKCS_KEY_PAIR_GEN, NULL, 0 };
+    CK_ULONG aes_len = 32, bits = 2048;
+    CK_BYTE pub_exp[] = { 0x01, 0x00, 0x01 };
+    CK_BBOOL true = TRUE;
+    CK_ATTRIBUTE aes_tmpl[] = {
+        { CKA_VALUE_LEN, &aes_len, sizeof(aes_len) },
+        { CKA_ENCRYPT, &true, sizeof(true) },
+        { CKA_DECRYPT, &true, sizeof(true) },
+        { CKA_SIGN, &true, sizeof(true) },
+        { CKA_VERIFY, &true, sizeof(true) },
+    };
+    CK_ATTRIBUTE publ_tmpl[] = {
+        { CKA_VERIFY, &true, sizeof(true) },
+        { CKA_MODULUS_BITS, &bits, sizeof(bits) },
+        { CKA_PUBLIC_EXPONENT, pub_exp, sizeof(pub_exp) },
+    };
+    CK_ATTRIBUTE priv_tmpl[] = {
+        { CKA_SIGN, &true, sizeof(true) },
+    };
+    CK_RV rc;
+
+    rc = funcs->C_GenerateKey(session, &aes_mech, aes_tmpl,
+                              sizeof(aes_tmpl) / sizeof(aes_tmpl[0]),
+                              &aes_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_GenerateKey rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    rc = funcs->C_GenerateKeyPair(session, &rsa_mech, publ_tmpl,
+                                  sizeof(publ_tmpl) / sizeof(publ_tmpl[0]),
+                                  priv_tmpl,
+                                  sizeof(priv_tmpl) / sizeof(priv_tmpl[0]),
+                                  &rsa_publ_key, &rsa_priv_key);
+    if (rc != CKR_OK)
+        testcase_error("C_GenerateKeyPair rc=%s", p11_get_ckr(rc));
+
+    return rc;
+}
+
+static CK_ULONG part_len(CK_ULONG part)
+{
+    return part < NUM_PARTS - 1 ? DATA_LEN / NUM_PARTS :
+                                  DATA_LEN - (NUM_PARTS - 1) *
+                                                (DATA_LEN / NUM_PARTS);
+}
+
+/*
+ * Runs a hash-and-sign and a hash-and-verify operation, whose contexts hold
+ * a nested digest context, together with a digest and an encrypt operation,
+ * all active at the same time in the session.
+ */
+static CK_RV run_nested(CK_SESSION_HANDLE sess, struct op_outputs *res)
+{
+    CK_MECHANISM rsa_mech = { rsa_hash_mech, NULL, 0 };
+    CK_MECHANISM digest_mech = { CKM_SHA256, NULL, 0 };
+    CK_MECHANISM aes_mech = { CKM_AES_CBC_PAD, iv, sizeof(iv) };
+    struct op_output *sig = &res->out[OUT_SIGNATURE];
+    struct op_output *dig = &res->out[OUT_DIGEST];
+    struct op_output *enc = &res->out[OUT_CIPHERTEXT];
+    CK_ULONG i, offs = 0, len;
+    CK_RV rc;
+
+    rc = funcs->C_SignInit(sess, &rsa_mech, rsa_priv_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_SignInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    rc = funcs->C_VerifyInit(sess, &rsa_mech, rsa_publ_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_VerifyInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    rc = funcs->C_DigestInit(sess, &digest_mech);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    rc = funcs->C_EncryptInit(sess, &aes_mech, aes_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_EncryptInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    enc->len = 0;
+    for (i = 0; i < NUM_PARTS; i++) {
+        rc = funcs->C_SignUpdate(sess, data + offs, part_len(i));
+        if (rc != CKR_OK) {
+            testcase_error("C_SignUpdate rc=%s", p11_get_ckr(rc));
+            return rc;
+        }
+        rc = funcs->C_VerifyUpdate(sess, data + offs, part_len(i));
+        if (rc != CKR_OK) {
+            testcase_error("C_VerifyUpdate rc=%s", p11_get_ckr(rc));
+            return rc;
+        }
+        rc = funcs->C_DigestUpdate(sess, data + offs, part_len(i));
+        if (rc != CKR_OK) {
+            testcase_error("C_DigestUpdate rc=%s", p11_get_ckr(rc));
+            return rc;
+        }
+        len = sizeof(enc->buf) - enc->len;
+        rc = funcs->C_EncryptUpdate(sess, data + offs, part_len(i),
+                                    enc->buf + enc->len, &len);
+        if (rc != CKR_OK) {
+            testcase_error("C_EncryptUpdate rc=%s", p11_get_ckr(rc));
+            return rc;
+        }
+        enc->len += len;
+        offs += part_len(i);
+    }
+
+    len = sizeof(enc->buf) - enc->len;
+    rc = funcs->C_EncryptFinal(sess, enc->buf + enc->len, &len);
+    if (rc != CKR_OK) {
+        testcase_error("C_EncryptFinal rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    enc->len += len;
+
+    dig->len = sizeof(dig->buf);
+    rc = funcs->C_DigestFinal(sess, dig->buf, &dig->len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestFinal rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    sig->len = sizeof(sig->buf);
+    rc = funcs->C_SignFinal(sess, sig->buf, &sig->len);
+    if (rc != CKR_OK) {
+        testcase_error("C_SignFinal rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    rc = funcs->C_VerifyFinal(sess, sig->buf, sig->len);
+    if (rc != CKR_OK)
+        testcase_error("C_VerifyFinal rc=%s", p11_get_ckr(rc));
+
+    return rc;
+}
+
+static CK_RV run_cmac(CK_SESSION_HANDLE sess, struct op_output *mac)
+{
+    CK_MECHANISM cmac_mech = { CKM_AES_CMAC, NULL, 0 };
+    CK_RV rc;
+
+    rc = funcs->C_SignInit(sess, &cmac_mech, aes_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_SignInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    mac->len = sizeof(mac->buf);
+    rc = funcs->C_Sign(sess, data, sizeof(data), mac->buf, &mac->len);
+    if (rc != CKR_OK)
+        testcase_error("C_Sign rc=%s", p11_get_ckr(rc));
+
+    return rc;
+}
+
+/*
+ * Runs C_DigestEncryptUpdate and C_SignEncryptUpdate, and decrypts their
+ * ciphertexts again with C_DecryptDigestUpdate and C_DecryptVerifyUpdate.
+ */
+static CK_RV run_dual(CK_SESSION_HANDLE sess, struct op_outputs *res)
+{
+    CK_MECHANISM digest_mech = { CKM_SHA256, NULL, 0 };
+    CK_MECHANISM cmac_mech = { CKM_AES_CMAC, NULL, 0 };
+    CK_MECHANISM aes_mech = { CKM_AES_CBC_PAD, iv, sizeof(iv) };
+    struct op_output *dig = &res->out[OUT_DUAL_DIGEST];
+    struct op_output *dig_enc = &res->out[OUT_DUAL_DIGEST_CIPHERTEXT];
+    struct op_output *sign_enc = &res->out[OUT_DUAL_SIGN_CIPHERTEXT];
+    struct op_output *mac = &res->out[OUT_DUAL_CMAC];
+    struct op_output clear, digest;
+    CK_ULONG i, offs, len;
+    CK_RV rc;
+
+    /* C_DigestEncryptUpdate */
+    rc = funcs->C_DigestInit(sess, &digest_mech);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    rc = funcs->C_EncryptInit(sess, &aes_mech, aes_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_EncryptInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    for (i = 0, offs = 0, dig_enc->len = 0; i < NUM_PARTS; i++) {
+        len = sizeof(dig_enc->buf) - dig_enc->len;
+        rc = funcs->C_DigestEncryptUpdate(sess, data + offs, part_len(i),
+                                          dig_enc->buf + dig_enc->len, &len);
+        if (rc != CKR_OK) {
+            testcase_error("C_DigestEncryptUpdate rc=%s", p11_get_ckr(rc));
+            return rc;
+        }
+        dig_enc->len += len;
+        offs += part_len(i);
+    }
+
+    len = sizeof(dig_enc->buf) - dig_enc->len;
+    rc = funcs->C_EncryptFinal(sess, dig_enc->buf + dig_enc->len, &len);
+    if (rc != CKR_OK) {
+        testcase_error("C_EncryptFinal rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    dig_enc->len += len;
+
+    dig->len = sizeof(dig->buf);
+    rc = funcs->C_DigestFinal(sess, dig->buf, &dig->len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestFinal rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    /* C_SignEncryptUpdate */
+    rc = funcs->C_SignInit(sess, &cmac_mech, aes_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_SignInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    rc = funcs->C_EncryptInit(sess, &aes_mech, aes_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_EncryptInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    for (i = 0, offs = 0, sign_enc->len = 0; i < NUM_PARTS; i++) {
+        len = sizeof(sign_enc->buf) - sign_enc->len;
+        rc = funcs->C_SignEncryptUpdate(sess, data + offs, part_len(i),
+                                        sign_enc->buf + sign_enc->len, &len);
+        if (rc != CKR_OK) {
+            testcase_error("C_SignEncryptUpdate rc=%s", p11_get_ckr(rc));
+            return rc;
+        }
+        sign_enc->len += len;
+        offs += part_len(i);
+    }
+
+    len = sizeof(sign_enc->buf) - sign_enc->len;
+    rc = funcs->C_EncryptFinal(sess, sign_enc->buf + sign_enc->len, &len);
+    if (rc != CKR_OK) {
+        testcase_error("C_EncryptFinal rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    sign_enc->len += len;
+
+    mac->len = sizeof(mac->buf);
+    rc = funcs->C_SignFinal(sess, mac->buf, &mac->len);
+    if (rc != CKR_OK) {
+        testcase_error("C_SignFinal rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    /* C_DecryptDigestUpdate */
+    rc = funcs->C_DecryptInit(sess, &aes_mech, aes_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_DecryptInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    rc = funcs->C_DigestInit(sess, &digest_mech);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    clear.len = sizeof(clear.buf);
+    rc = funcs->C_DecryptDigestUpdate(sess, dig_enc->buf, dig_enc->len,
+                                      clear.buf, &clear.len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DecryptDigestUpdate rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    /* C_DecryptFinal returns the last block, which is digested separately */
+    offs = clear.len;
+    len = sizeof(clear.buf) - offs;
+    rc = funcs->C_DecryptFinal(sess, clear.buf + offs, &len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DecryptFinal rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    clear.len += len;
+
+    if (clear.len != sizeof(data) ||
+        memcmp(clear.buf, data, sizeof(data)) != 0) {
+        testcase_fail("C_DecryptDigestUpdate returned wrong clear text");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    rc = funcs->C_DigestUpdate(sess, clear.buf + offs, len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestUpdate rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    digest.len = sizeof(digest.buf);
+    rc = funcs->C_DigestFinal(sess, digest.buf, &digest.len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestFinal rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    if (digest.len != dig->len || memcmp(digest.buf, dig->buf, dig->len) != 0) {
+        testcase_fail("C_DecryptDigestUpdate returned a wrong digest");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    /* C_DecryptVerifyUpdate */
+    rc = funcs->C_DecryptInit(sess, &aes_mech, aes_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_DecryptInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    rc = funcs->C_VerifyInit(sess, &cmac_mech, aes_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_VerifyInit rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    clear.len = sizeof(clear.buf);
+    rc = funcs->C_DecryptVerifyUpdate(sess, sign_enc->buf, sign_enc->len,
+                                      clear.buf, &clear.len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DecryptVerifyUpdate rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    offs = clear.len;
+    len = sizeof(clear.buf) - offs;
+    rc = funcs->C_DecryptFinal(sess, clear.buf + offs, &len);
+    if (rc != CKR_OK) {
+        testcase_error("C_DecryptFinal rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+    clear.len += len;
+
+    if (clear.len != sizeof(data) ||
+        memcmp(clear.buf, data, sizeof(data)) != 0) {
+        testcase_fail("C_DecryptVerifyUpdate returned wrong clear text");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    rc = funcs->C_VerifyUpdate(sess, clear.buf + offs, len);
+    if (rc != CKR_OK) {
+        testcase_error("C_VerifyUpdate rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    rc = funcs->C_VerifyFinal(sess, mac->buf, mac->len);
+    if (rc != CKR_OK)
+        testcase_fail("C_VerifyFinal rc=%s", p11_get_ckr(rc));
+
+    return rc;
+}
+
+static CK_RV compare_outputs(const struct op_outputs *ref,
+                             const struct op_outputs *res,
+                             int first, int last, const char *mode)
+{
+    int i;
+
+    for (i = first; i <= last; i++) {
+        if (ref->out[i].len != res->out[i].len ||
+            memcmp(ref->out[i].buf, res->out[i].buf, ref->out[i].len) != 0) {
+            testcase_fail("Arena mode '%s': %s differs", mode,
+                          output_names[i]);
+            return CKR_FUNCTION_FAILED;
+        }
+    }
+
+    return CKR_OK;
+}
+
+static CK_RV compare_output(const struct op_outputs *res, int i, int j)
+{
+    if (res->out[i].len != res->out[j].len ||
+        memcmp(res->out[i].buf, res->out[j].buf, res->out[i].len) != 0) {
+        testcase_fail("The %s differs from the %s", output_names[j],
+                      output_names[i]);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
+
+/*
+ * Runs all operations in a new session with the given arena mode. The
+ * operations are then repeated, so that the contexts are carved from reused
+ * arena chunks. The session is closed with operations still active.
+ */
+static CK_RV run_arena_mode(const char *mode, struct op_outputs *res)
+{
+    CK_MECHANISM rsa_mech = { rsa_hash_mech, NULL, 0 };
+    CK_MECHANISM aes_mech = { CKM_AES_CBC_PAD, iv, sizeof(iv) };
+    struct op_outputs *loop = NULL;
+    CK_SESSION_HANDLE sess;
+    CK_RV rc, rc2;
+    int i;
+
+    rc = open_session(mode, &sess);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = run_nested(sess, res);
+    if (rc != CKR_OK)
+        goto out;
+    rc = run_cmac(sess, &res->out[OUT_CMAC]);
+    if (rc != CKR_OK)
+        goto out;
+    rc = run_dual(sess, res);
+    if (rc != CKR_OK)
+        goto out;
+
+    loop = calloc(1, sizeof(*loop));
+    if (loop == NULL) {
+        testcase_error("malloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    for (i = 0; i < REUSE_LOOPS; i++) {
+        rc = run_nested(sess, loop);
+        if (rc != CKR_OK)
+            goto out;
+        rc = run_cmac(sess, &loop->out[OUT_CMAC]);
+        if (rc != CKR_OK)
+            goto out;
+        rc = compare_outputs(res, loop, OUT_SIGNATURE, OUT_CMAC, mode);
+        if (rc != CKR_OK)
+            goto out;
+    }
+
+    /* Leave a hash-and-sign and an encrypt operation active */
+    rc = funcs->C_SignInit(sess, &rsa_mech, rsa_priv_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_SignInit rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+    rc = funcs->C_SignUpdate(sess, data, sizeof(data));
+    if (rc != CKR_OK) {
+        testcase_error("C_SignUpdate rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+    rc = funcs->C_EncryptInit(sess, &aes_mech, aes_key);
+    if (rc != CKR_OK)
+        testcase_error("C_EncryptInit rc=%s", p11_get_ckr(rc));
+
+out:
+    free(loop);
+    rc2 = funcs->C_CloseSession(sess);
+    if (rc2 != CKR_OK) {
+        testcase_error("C_CloseSession rc=%s", p11_get_ckr(rc2));
+        if (rc == CKR_OK)
+            rc = rc2;
+    }
+
+    return rc;
+}
+
+static CK_RV do_op_ctx_arena_test(void)
+{
+    struct op_outputs *ref = NULL, *res = NULL;
+    size_t i;
+    CK_RV rc;
+
+    testcase_begin("Nested and dual-function operation contexts with "
+                   "arena modes 0, 1 and mlock");
+
+    ref = calloc(1, sizeof(*ref));
+    res = calloc(1, sizeof(*res));
+    if (ref == NULL || res == NULL) {
+        testcase_error("malloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    testcase_new_assertion();
+
+    /* The first mode, with malloc'ed contexts, gives the reference */
+    rc = run_arena_mode(arena_modes[0], ref);
+    if (rc != CKR_OK)
+        goto out;
+
+    rc = compare_output(ref, OUT_DIGEST, OUT_DUAL_DIGEST);
+    if (rc == CKR_OK)
+        rc = compare_output(ref, OUT_CIPHERTEXT, OUT_DUAL_DIGEST_CIPHERTEXT);
+    if (rc == CKR_OK)
+        rc = compare_output(ref, OUT_CIPHERTEXT, OUT_DUAL_SIGN_CIPHERTEXT);
+    if (rc == CKR_OK)
+        rc = compare_output(ref, OUT_CMAC, OUT_DUAL_CMAC);
+    if (rc != CKR_OK)
+        goto out;
+
+    for (i = 1; i < sizeof(arena_modes) / sizeof(arena_modes[0]); i++) {
+        memset(res, 0, sizeof(*res));
+        rc = run_arena_mode(arena_modes[i], res);
+        if (rc != CKR_OK)
+            goto out;
+
+        rc = compare_outputs(ref, res, 0, NUM_OUTPUTS - 1, arena_modes[i]);
+        if (rc != CKR_OK)
+            goto out;
+    }
+
+    testcase_pass("Nested and dual-function operation contexts with "
+                  "arena modes 0, 1 and mlock");
+
+out:
+    free(ref);
+    free(res);
+    return rc;
+}
+
+struct bench_thread {
+    pthread_t id;
+    CK_SESSION_HANDLE session;
+    unsigned long ops;
+    CK_RV rc;
+};
+
+volatile int bench_stop;
+
+static void *bench_thread_func(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_MECHANISM ecb_mech = { CKM_AES_ECB, NULL, 0 };
+    CK_MECHANISM mac_mech = { CKM_AES_MAC, NULL, 0 };
+    CK_BYTE out[BLOCK_LEN];
+    CK_ULONG len;
+
+    while (!bench_stop) {
+        t->rc = funcs->C_EncryptInit(t->session, &ecb_mech, aes_key);
+        if (t->rc != CKR_OK)
+            break;
+        len = sizeof(out);
+        t->rc = funcs->C_Encrypt(t->session, data, BLOCK_LEN, out, &len);
+        if (t->rc != CKR_OK)
+            break;
+
+        t->rc = funcs->C_SignInit(t->session, &mac_mech, aes_key);
+        if (t->rc != CKR_OK)
+            break;
+        len = sizeof(out);
+        t->rc = funcs->C_Sign(t->session, data, BLOCK_LEN, out, &len);
+        if (t->rc != CKR_OK)
+            break;
+
+        t->ops += 2;
+    }
+
+    return NULL;
+}
+
+static CK_RV run_bench(const char *mode, double *ops_per_sec)
+{
+    struct bench_thread *threads;
+    struct timespec start, end;
+    unsigned long i, started = 0, ops = 0;
+    double secs;
+    CK_RV rc = CKR_OK;
+
+    threads = calloc(bench_threads, sizeof(*threads));
+    if (threads == NULL) {
+        testcase_error("malloc failed");
+        return CKR_HOST_MEMORY;
+    }
+
+    for (i = 0; i < bench_threads; i++) {
+        rc = open_session(mode, &threads[i].session);
+        if (rc != CKR_OK)
+            goto out;
+    }
+
+    bench_stop = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (started = 0; started < bench_threads; started++) {
+        if (pthread_create(&threads[started].id, NULL, bench_thread_func,
+                           &threads[started]) != 0) {
+            testcase_error("pthread_create failed");
+            rc = CKR_FUNCTION_FAILED;
+            break;
+        }
+    }
+
+    if (rc == CKR_OK)
+        sleep(bench_seconds);
+    bench_stop = 1;
+
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i].id, NULL);
+        if (threads[i].rc != CKR_OK && rc == CKR_OK) {
+            testcase_error("Thread %lu: rc=%s", i, p11_get_ckr(threads[i].rc));
+            rc = threads[i].rc;
+        }
+        ops += threads[i].ops;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    *ops_per_sec = ops / secs;
+
+out:
+    for (i = 0; i < bench_threads; i++) {
+        if (threads[i].session != CK_INVALID_HANDLE)
+            funcs->C_CloseSession(threads[i].session);
+    }
+    free(threads);
+    return rc;
+}
+
+static CK_RV do_op_ctx_arena_bench(void)
+{
+    double malloc_ops, arena_ops;
+    CK_RV rc;
+
+    testcase_begin("Operation context arena benchmark with %lu threads",
+                   bench_threads);
+
+    if (aes_key == CK_INVALID_HANDLE) {
+        testcase_skip("The AES key was not generated");
+        return CKR_OK;
+    }
+
+    if (!mech_supported(slot_id, CKM_AES_ECB) ||
+        !mech_supported(slot_id, CKM_AES_MAC)) {
+        testcase_skip("Slot %lu does not support CKM_AES_ECB and CKM_AES_MAC",
+                      slot_id);
+        return CKR_OK;
+    }
+
+    testcase_new_assertion();
+
+    rc = run_bench("0", &malloc_ops);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = run_bench("1", &arena_ops);
+    if (rc != CKR_OK)
+        return rc;
+
+    printf("%8s %16s %16s %8s\n", "threads", "malloc ops/s", "arena ops/s",
+           "speedup");
+    printf("%8lu %16.1f %16.1f %7.2fx\n", bench_threads, malloc_ops,
+           arena_ops, arena_ops / malloc_ops);
+
+    testcase_pass("Operation context arena benchmark with %lu threads",
+                  bench_threads);
+
+    return CKR_OK;
+}
+
+static CK_RV do_op_ctx_arena_tests(void)
+{
+    CK_RV rc;
+    int i;
+
+    if (!mech_supported(slot_id, CKM_AES_KEY_GEN) ||
+        !mech_supported(slot_id, CKM_AES_CBC_PAD) ||
+        !mech_supported(slot_id, CKM_AES_CMAC) ||
+        !mech_supported(slot_id, CKM_SHA256) ||
+        !mech_supported(slot_id, CKM_RSA_PKCS_KEY_PAIR_GEN)) {
+        testcase_skip("Slot %lu does not support the required mechanisms",
+                      slot_id);
+        return CKR_OK;
+    }
+
+    /* MD5 is not available via OpenSSL's EVP, which uses a nested context */
+    if (!mech_supported(slot_id, rsa_hash_mech))
+        rsa_hash_mech = CKM_SHA256_RSA_PKCS;
+
+    for (i = 0; i < DATA_LEN; i++)
+        data[i] = i & 0xff;
+    memset(iv, 0x5a, sizeof(iv));
+
+    rc = generate_keys();
+    if (rc != CKR_OK)
+        return rc;
+
+    return do_op_ctx_arena_test();
+}
+
+static int parse_op_ctx_arena_arg(int argc, char **argv, int *i)
+{
+    unsigned long *val;
+
+    if (strcmp(argv[*i], "-threads") == 0)
+        val = &bench_threads;
+    else if (strcmp(argv[*i], "-seconds") == 0)
+        val = &bench_seconds;
+    else
+        return 0;
+
+    ++(*i);
+    if (*i >= argc) {
+        printf("%s value missing\n", argv[*i - 1]);
+        return -1;
+    }
+    *val = strtoul(argv[*i], NULL, 10);
+    if (*val == 0) {
+        printf("Invalid %s value\n", argv[*i - 1]);
+        return -1;
+    }
+
+    return 1;
+}
+
+static const struct ext_test_func op_ctx_arena_funcs[] = {
+    { NULL, NULL },
+};
+
+int main(int argc, char **argv)
+{
+    static char bench_help[200];
+    struct ext_test test = {
+        .ext_funcs = op_ctx_arena_funcs,
+        .bench_options = "[-threads <num>] [-seconds <num>]",
+        .bench_help = bench_help,
+        .parse_arg = parse_op_ctx_arena_arg,
+        .run_tests = do_op_ctx_arena_tests,
+        .run_bench = do_op_ctx_arena_bench,
+        .slot_id = &slot_id,
+        .session = &session,
+    };
+
+    snprintf(bench_help, sizeof(bench_help), "also runs short operations "
+             "in -threads (default %u) sessions for\n-seconds (default %u) "
+             "with malloc'ed operation contexts and with the arena",
+             BENCH_THREADS, BENCH_SECONDS);
+
+    return do_ext_test_main(argc, argv, &test);
+}
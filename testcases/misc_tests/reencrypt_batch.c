@@ -0,0 +1,453 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/* File: reencrypt_batch.c
+ *
+ * Test driver for the C_IBM_ReencryptBatch vendor function. A batch of
+ * ciphertexts with per-item IVs is re-encrypted from one AES key to another
+ * and the results are compared with the clear data. The batch call is
+ * benchmarked against a C_IBM_ReencryptSingle loop.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pkcs11types.h"
+#include "regress.h"
+#include "mech_to_str.h"
+#include "common.c"
+
+#define BATCH_COUNT         64
+#define MAX_DATA_LEN        1024
+#define PAD_LEN             16
+#define BENCH_COUNT         10000
+
+CK_SLOT_ID slot_id = 1;
+
+CK_SESSION_HANDLE session;
+CK_OBJECT_HANDLE old_key = CK_INVALID_HANDLE;
+CK_OBJECT_HANDLE new_key = CK_INVALID_HANDLE;
+
+CK_C_IBM_ReencryptSingle _C_IBM_ReencryptSingle;
+CK_C_IBM_ReencryptBatch _C_IBM_ReencryptBatch;
+
+static const CK_ULONG bench_sizes[] = {
+    16, 64, 256, 1024, 4096,
+};
+
+/* Generates old_key and new_key, leaves them invalid if the test is skipped */
+static CK_RV generate_keys(void)
+{
+    CK_MECHANISM keygen_mech = { CKM_AES_KEY_GEN, NULL, 0 };
+    CK_RV rc;
+
+    if (!mech_supported(slot_id, CKM_AES_KEY_GEN)) {
+        testcase_skip("Slot %lu doesn't support %s", slot_id,
+                      mech_to_str(CKM_AES_KEY_GEN));
+        return CKR_OK;
+    }
+
+    rc = generate_AESKey(session, 32, TRUE, &keygen_mech, &old_key);
+    if (rc == CKR_OK)
+        rc = generate_AESKey(session, 32, TRUE, &keygen_mech, &new_key);
+    if (rc != CKR_OK) {
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("AES key generation is rejected by policy");
+            rc = CKR_OK;
+        } else {
+            testcase_error("generate_AESKey rc=%s", p11_get_ckr(rc));
+        }
+    }
+
+    return rc;
+}
+
+static void destroy_keys(void)
+{
+    if (old_key != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, old_key);
+    if (new_key != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(session, new_key);
+    old_key = CK_INVALID_HANDLE;
+    new_key = CK_INVALID_HANDLE;
+}
+
+static CK_RV encrypt_single(CK_MECHANISM *mech, CK_OBJECT_HANDLE key,
+                            CK_BYTE *data, CK_ULONG len,
+                            CK_BYTE *out, CK_ULONG *out_len)
+{
+    CK_RV rc;
+
+    rc = funcs->C_EncryptInit(session, mech, key);
+    if (rc != CKR_OK)
+        return rc;
+
+    return funcs->C_Encrypt(session, data, len, out, out_len);
+}
+
+static CK_RV decrypt_single(CK_MECHANISM *mech, CK_OBJECT_HANDLE key,
+                            CK_BYTE *data, CK_ULONG len,
+                            CK_BYTE *out, CK_ULONG *out_len)
+{
+    CK_RV rc;
+
+    rc = funcs->C_DecryptInit(session, mech, key);
+    if (rc != CKR_OK)
+        return rc;
+
+    return funcs->C_Decrypt(session, data, len, out, out_len);
+}
+
+static CK_RV do_reencrypt_batch_test(CK_MECHANISM_TYPE decr_mech_type,
+                                     CK_MECHANISM_TYPE encr_mech_type)
+{
+    CK_MECHANISM decr_mech = { decr_mech_type, NULL, 0 };
+    CK_MECHANISM encr_mech = { encr_mech_type, NULL, 0 };
+    CK_BYTE decr_ivs[BATCH_COUNT][16], encr_ivs[BATCH_COUNT][16];
+    CK_VOID_PTR decr_params[BATCH_COUNT], encr_params[BATCH_COUNT];
+    CK_BYTE *clear = NULL, *enc = NULL, *reenc = NULL;
+    CK_BYTE *enc_ptrs[BATCH_COUNT], *reenc_ptrs[BATCH_COUNT];
+    CK_ULONG clear_lens[BATCH_COUNT], enc_lens[BATCH_COUNT];
+    CK_ULONG reenc_lens[BATCH_COUNT];
+    CK_RV results[BATCH_COUNT];
+    CK_BYTE dec[MAX_DATA_LEN + PAD_LEN];
+    CK_ULONG i, j, dec_len, stride = MAX_DATA_LEN + PAD_LEN;
+    CK_BBOOL decr_pad = (decr_mech_type == CKM_AES_CBC_PAD);
+    CK_BBOOL encr_pad = (encr_mech_type == CKM_AES_CBC_PAD);
+    CK_RV rc = CKR_OK;
+
+    testcase_begin("C_IBM_ReencryptBatch from %s to %s",
+                   mech_to_str(decr_mech_type), mech_to_str(encr_mech_type));
+
+    if (!mech_supported(slot_id, decr_mech_type) ||
+        !mech_supported(slot_id, encr_mech_type)) {
+        testcase_skip("Slot %lu doesn't support %s or %s", slot_id,
+                      mech_to_str(decr_mech_type),
+                      mech_to_str(encr_mech_type));
+        return CKR_OK;
+    }
+
+    clear = malloc(BATCH_COUNT * stride);
+    enc = malloc(BATCH_COUNT * stride);
+    reenc = malloc(BATCH_COUNT * stride);
+    if (clear == NULL || enc == NULL || reenc == NULL) {
+        testcase_error("malloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    for (i = 0; i < BATCH_COUNT; i++) {
+        /* Padded mechanisms get any length, the others full blocks */
+        clear_lens[i] = PAD_LEN + random() % (MAX_DATA_LEN - PAD_LEN);
+        if (!decr_pad || !encr_pad)
+            clear_lens[i] &= ~15UL;
+        for (j = 0; j < clear_lens[i]; j++)
+            clear[i * stride + j] = random();
+        for (j = 0; j < 16; j++) {
+            decr_ivs[i][j] = random();
+            encr_ivs[i][j] = random();
+        }
+        decr_params[i] = decr_ivs[i];
+        encr_params[i] = encr_ivs[i];
+        enc_ptrs[i] = enc + i * stride;
+        reenc_ptrs[i] = reenc + i * stride;
+
+        if (decr_mech_type != CKM_AES_ECB) {
+            decr_mech.pParameter = decr_ivs[i];
+            decr_mech.ulParameterLen = 16;
+        }
+        enc_lens[i] = stride;
+        rc = encrypt_single(&decr_mech, old_key, clear + i * stride,
+                            clear_lens[i], enc_ptrs[i], &enc_lens[i]);
+        if (rc != CKR_OK) {
+            if (is_rejected_by_policy(rc, session)) {
+                testcase_skip("%s is rejected by policy",
+                              mech_to_str(decr_mech_type));
+                rc = CKR_OK;
+                goto out;
+            }
+            testcase_error("C_EncryptInit/C_Encrypt rc=%s", p11_get_ckr(rc));
+            goto out;
+        }
+    }
+
+    if (decr_mech_type != CKM_AES_ECB)
+        decr_mech.ulParameterLen = 16;
+    if (encr_mech_type != CKM_AES_ECB)
+        encr_mech.ulParameterLen = 16;
+
+    testcase_new_assertion();
+
+    /* Length query */
+    for (i = 0; i < BATCH_COUNT; i++)
+        reenc_lens[i] = 0;
+    rc = _C_IBM_ReencryptBatch(session, &decr_mech, old_key, &encr_mech,
+                               new_key, BATCH_COUNT,
+                               decr_mech_type != CKM_AES_ECB ?
+                                                   decr_params : NULL,
+                               encr_mech_type != CKM_AES_ECB ?
+                                                   encr_params : NULL,
+                               enc_ptrs, enc_lens, NULL, reenc_lens, results);
+    if (rc != CKR_OK) {
+        if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+            testcase_skip("Slot %lu does not support C_IBM_ReencryptBatch",
+                          slot_id);
+            rc = CKR_OK;
+            goto out;
+        }
+        if (is_rejected_by_policy(rc, session)) {
+            testcase_skip("%s or %s is rejected by policy",
+                          mech_to_str(decr_mech_type),
+                          mech_to_str(encr_mech_type));
+            rc = CKR_OK;
+            goto out;
+        }
+        testcase_fail("C_IBM_ReencryptBatch (length query) rc=%s",
+                      p11_get_ckr(rc));
+        goto out;
+    }
+    for (i = 0; i < BATCH_COUNT; i++) {
+        if (results[i] != CKR_OK || reenc_lens[i] < clear_lens[i]) {
+            testcase_fail("C_IBM_ReencryptBatch (length query) item %lu "
+                          "rc=%s, len=%lu", i, p11_get_ckr(results[i]),
+                          reenc_lens[i]);
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+    }
+
+    /*
+     * Item 1 gets a buffer that is too small, and item 2 a ciphertext of
+     * an invalid length. The other items must not be affected.
+     */
+    for (i = 0; i < BATCH_COUNT; i++)
+        reenc_lens[i] = stride;
+    reenc_lens[1] = 0;
+    enc_lens[2] += 1;
+
+    rc = _C_IBM_ReencryptBatch(session, &decr_mech, old_key, &encr_mech,
+                               new_key, BATCH_COUNT,
+                               decr_mech_type != CKM_AES_ECB ?
+                                                   decr_params : NULL,
+                               encr_mech_type != CKM_AES_ECB ?
+                                                   encr_params : NULL,
+                               enc_ptrs, enc_lens, reenc_ptrs, reenc_lens,
+                               results);
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_ReencryptBatch rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+    if (results[1] != CKR_BUFFER_TOO_SMALL || reenc_lens[1] == 0) {
+        testcase_fail("Item with a short buffer rc=%s, len=%lu",
+                      p11_get_ckr(results[1]), reenc_lens[1]);
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+    if (results[2] == CKR_OK) {
+        testcase_fail("Item with an invalid ciphertext length succeeded");
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    for (i = 0; i < BATCH_COUNT; i++) {
+        if (i == 1 || i == 2)
+            continue;
+        if (results[i] != CKR_OK) {
+            testcase_fail("C_IBM_ReencryptBatch item %lu rc=%s", i,
+                          p11_get_ckr(results[i]));
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+
+        if (encr_mech_type != CKM_AES_ECB)
+            encr_mech.pParameter = encr_ivs[i];
+        dec_len = sizeof(dec);
+        rc = decrypt_single(&encr_mech, new_key, reenc_ptrs[i],
+                            reenc_lens[i], dec, &dec_len);
+        if (rc != CKR_OK) {
+            testcase_error("C_DecryptInit/C_Decrypt rc=%s", p11_get_ckr(rc));
+            goto out;
+        }
+        if (dec_len != clear_lens[i] ||
+            memcmp(dec, clear + i * stride, dec_len) != 0) {
+            testcase_fail("Item %lu (%lu bytes) differs after "
+                          "re-encryption", i, clear_lens[i]);
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+    }
+    encr_mech.pParameter = NULL;
+
+    /* An empty batch */
+    rc = _C_IBM_ReencryptBatch(session, &decr_mech, old_key, &encr_mech,
+                               new_key, 0, NULL, NULL, NULL, NULL, NULL, NULL,
+                               NULL);
+    if (rc != CKR_OK) {
+        testcase_fail("C_IBM_ReencryptBatch of an empty batch rc=%s",
+                      p11_get_ckr(rc));
+        goto out;
+    }
+
+    testcase_pass("C_IBM_ReencryptBatch from %s to %s",
+                  mech_to_str(decr_mech_type), mech_to_str(encr_mech_type));
+
+out:
+    free(clear);
+    free(enc);
+    free(reenc);
+    return rc;
+}
+
+static CK_RV do_reencrypt_batch_bench(void)
+{
+    CK_BYTE iv[16] = { 0 };
+    CK_MECHANISM mech = { CKM_AES_CBC, iv, sizeof(iv) };
+    CK_BYTE **enc_ptrs = NULL, **reenc_ptrs = NULL, *data = NULL;
+    CK_ULONG *enc_lens = NULL, *reenc_lens = NULL, i, k, len;
+    CK_RV *results = NULL;
+    struct timespec start;
+    double loop_us, batch_us;
+    CK_RV rc = CKR_OK;
+
+    testcase_begin("C_IBM_ReencryptBatch benchmark with %s",
+                   mech_to_str(CKM_AES_CBC));
+
+    if (!mech_supported(slot_id, CKM_AES_CBC)) {
+        testcase_skip("Slot %lu doesn't support %s", slot_id,
+                      mech_to_str(CKM_AES_CBC));
+        return CKR_OK;
+    }
+
+    rc = generate_keys();
+    if (rc != CKR_OK || new_key == CK_INVALID_HANDLE)
+        goto out;
+
+    data = calloc(2, 4096);
+    enc_ptrs = calloc(BENCH_COUNT, sizeof(*enc_ptrs));
+    reenc_ptrs = calloc(BENCH_COUNT, sizeof(*reenc_ptrs));
+    enc_lens = calloc(BENCH_COUNT, sizeof(*enc_lens));
+    reenc_lens = calloc(BENCH_COUNT, sizeof(*reenc_lens));
+    results = calloc(BENCH_COUNT, sizeof(*results));
+    if (data == NULL || enc_ptrs == NULL || reenc_ptrs == NULL ||
+        enc_lens == NULL || reenc_lens == NULL || results == NULL) {
+        testcase_error("malloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    testcase_new_assertion();
+    printf("%10s %10s %14s %14s %8s\n", "size", "count", "loop ops/s",
+           "batch ops/s", "speedup");
+
+    for (k = 0; k < (sizeof(bench_sizes) / sizeof(bench_sizes[0])); k++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < BENCH_COUNT; i++) {
+            len = 4096;
+            rc = _C_IBM_ReencryptSingle(session, &mech, old_key, &mech,
+                                        new_key, data, bench_sizes[k],
+                                        data + 4096, &len);
+            if (rc != CKR_OK) {
+                testcase_error("C_IBM_ReencryptSingle rc=%s",
+                               p11_get_ckr(rc));
+                goto out;
+            }
+        }
+        loop_us = elapsed_us(&start);
+
+        for (i = 0; i < BENCH_COUNT; i++) {
+            enc_ptrs[i] = data;
+            enc_lens[i] = bench_sizes[k];
+            reenc_ptrs[i] = data + 4096;
+            reenc_lens[i] = 4096;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        rc = _C_IBM_ReencryptBatch(session, &mech, old_key, &mech, new_key,
+                                   BENCH_COUNT, NULL, NULL, enc_ptrs,
+                                   enc_lens, reenc_ptrs, reenc_lens, results);
+        if (rc != CKR_OK) {
+            if (rc == CKR_FUNCTION_NOT_SUPPORTED) {
+                testcase_skip("Slot %lu does not support "
+                              "C_IBM_ReencryptBatch", slot_id);
+                rc = CKR_OK;
+                goto out;
+            }
+            testcase_fail("C_IBM_ReencryptBatch rc=%s", p11_get_ckr(rc));
+            goto out;
+        }
+        batch_us = elapsed_us(&start);
+
+        printf("%10lu %10u %14.1f %14.1f %7.2fx\n", bench_sizes[k],
+               BENCH_COUNT, BENCH_COUNT * 1e6 / loop_us,
+               BENCH_COUNT * 1e6 / batch_us, loop_us / batch_us);
+    }
+
+    testcase_pass("C_IBM_ReencryptBatch benchmark with %s",
+                  mech_to_str(CKM_AES_CBC));
+
+out:
+    destroy_keys();
+    free(data);
+    free(enc_ptrs);
+    free(reenc_ptrs);
+    free(enc_lens);
+    free(reenc_lens);
+    free(results);
+    return rc;
+}
+
+static CK_RV do_reencrypt_batch_tests(void)
+{
+    CK_RV rc;
+
+    testcase_begin("Generate AES keys");
+
+    rc = generate_keys();
+    if (rc != CKR_OK || new_key == CK_INVALID_HANDLE)
+        goto out;
+
+    rc = do_reencrypt_batch_test(CKM_AES_CBC_PAD, CKM_AES_CBC_PAD);
+    if (rc != CKR_OK)
+        goto out;
+
+    rc = do_reencrypt_batch_test(CKM_AES_ECB, CKM_AES_CBC);
+    if (rc != CKR_OK)
+        goto out;
+
+    rc = do_reencrypt_batch_test(CKM_AES_CBC_PAD, CKM_AES_ECB);
+
+out:
+    destroy_keys();
+
+    return rc;
+}
+
+static const struct ext_test_func reencrypt_batch_funcs[] = {
+    { "C_IBM_ReencryptSingle", (void **)&_C_IBM_ReencryptSingle },
+    { "C_IBM_ReencryptBatch", (void **)&_C_IBM_ReencryptBatch },
+    { NULL, NULL },
+};
+
+int main(int argc, char **argv)
+{
+    struct ext_test test = {
+        .ext_funcs = reencrypt_batch_funcs,
+        .bench_help = "also compares the batch call with single "
+                      "re-encryptions",
+        .run_tests = do_reencrypt_batch_tests,
+        .run_bench = do_reencrypt_batch_bench,
+        .slot_id = &slot_id,
+        .session = &session,
+    };
+
+    return do_ext_test_main(argc, argv, &test);
+}
@@ -18,6 +18,7 @@
  *    DES3 encrypt and decrypt (with modes ECB and CBC)
  *    AES encrypt and decrypt (with modes ECB and CBC, with keylength 128, 192,
  *    256), SHA1, SHA256, SHA512
+ *    AES-XTS multi-part encrypt and decrypt (with keylength 256, 512)
  */
 
 
@@ -37,6 +38,9 @@
 #define SHA512_HASH_LEN 64
 #define MAX_HASH_LEN SHA512_HASH_LEN
 
+#define XTS_REQUEST     (64 * 1024)
+#define XTS_CHUNK       (16 * 1024)
+
 
 // the GetSystemTime and SYSTEMTIME implementation
 // from regress.h only has a ms resolution
@@ -886,6 +890,230 @@ testcase_cleanup:
     return TRUE;
 }
 
+// keylength: 256, 512 (2 AES keys)
+int do_AES_XTS_EncrDecrUpdate(int keylength)
+{
+    CK_SESSION_HANDLE session;
+    CK_MECHANISM mech;
+    CK_FLAGS flags;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_RV rc;
+
+    CK_OBJECT_HANDLE h_key;
+    CK_BYTE *original = NULL, *cipher = NULL, *clear = NULL;
+    CK_ULONG len, in_pos, out_pos = 0;
+    CK_ULONG key_len = keylength / 8;
+
+    CK_BYTE tweak[16] = {
+        0x01, 0x02, 0x03, 0x04, 0x05,
+        0x06, 0x07, 0x08, 0x09, 0x0A,
+        0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+        0x10
+    };
+
+    CK_ULONG i, iterations = 5000;
+    SYSTEMTIME t1, t2;
+    CK_ULONG avg_time, tot_time, min_time, max_time, diff;
+
+    testcase_begin("AES-XTS EncryptUpdate with keylen=%lu datalen=%d "
+                   "chunklen=%d", key_len * 8, XTS_REQUEST, XTS_CHUNK);
+
+    if (!mech_supported(SLOT_ID, CKM_AES_XTS_KEY_GEN)) {
+        testcase_skip("Slot %lu doesn't support CKM_AES_XTS_KEY_GEN (0x%x)",
+                      SLOT_ID, CKM_AES_XTS_KEY_GEN);
+        return TRUE;
+    }
+    if (!mech_supported(SLOT_ID, CKM_AES_XTS)) {
+        testcase_skip("Slot %lu doesn't support CKM_AES_XTS (0x%x)",
+                      SLOT_ID, CKM_AES_XTS);
+        return TRUE;
+    }
+
+    testcase_new_assertion();
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    original = calloc(1, XTS_REQUEST);
+    cipher = calloc(1, XTS_REQUEST);
+    clear = calloc(1, XTS_REQUEST);
+    if (original == NULL || cipher == NULL || clear == NULL) {
+        testcase_error("calloc failed");
+        rc = CKR_HOST_MEMORY;
+        goto testcase_cleanup;
+    }
+
+    mech.mechanism = CKM_AES_XTS_KEY_GEN;
+    mech.ulParameterLen = 0;
+    mech.pParameter = NULL;
+
+    rc = generate_AESKey(session, key_len, CK_TRUE, &mech, &h_key);
+    if (rc != CKR_OK) {
+        if (rc == CKR_POLICY_VIOLATION) {
+            testcase_skip("AES-XTS key generation is not allowed by policy");
+            rc = CKR_OK;
+            goto testcase_cleanup;
+        }
+        testcase_error("C_GenerateKey rc=%s", p11_get_ckr(rc));
+        goto testcase_cleanup;
+    }
+
+    for (i = 0; i < XTS_REQUEST; i++)
+        original[i] = i % 255;
+
+    mech.mechanism = CKM_AES_XTS;
+    mech.ulParameterLen = sizeof(tweak);
+    mech.pParameter = tweak;
+
+    tot_time = 0;
+    max_time = 0;
+    min_time = 0xFFFFFFFF;
+
+    for (i = 0; i < iterations + 2; i++) {
+        GetSystemTime(&t1);
+        rc = funcs->C_EncryptInit(session, &mech, h_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_EncryptInit rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+
+        out_pos = 0;
+        for (in_pos = 0; in_pos < XTS_REQUEST; in_pos += XTS_CHUNK) {
+            len = XTS_REQUEST - out_pos;
+            rc = funcs->C_EncryptUpdate(session, original + in_pos, XTS_CHUNK,
+                                     cipher + out_pos, &len);
+            if (rc != CKR_OK) {
+                testcase_error("C_EncryptUpdate rc=%s", p11_get_ckr(rc));
+                goto testcase_cleanup;
+            }
+            out_pos += len;
+        }
+
+        len = XTS_REQUEST - out_pos;
+        rc = funcs->C_EncryptFinal(session, cipher + out_pos, &len);
+        if (rc != CKR_OK) {
+            testcase_error("C_EncryptFinal rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        out_pos += len;
+
+        GetSystemTime(&t2);
+        diff = delta_time_us(&t1, &t2);
+        tot_time += diff;
+        if (diff < min_time)
+            min_time = diff;
+
+        if (diff > max_time)
+            max_time = diff;
+    }
+
+    if (out_pos != XTS_REQUEST) {
+        testcase_fail("Encrypt output length %lu, expected %d", out_pos,
+                      XTS_REQUEST);
+        goto testcase_cleanup;
+    }
+
+    tot_time -= min_time;
+    tot_time -= max_time;
+    avg_time = tot_time / iterations;
+
+    // us -> ms
+    tot_time /= 1000;
+
+    printf("%lu iterations: total=%lums min=%luus max=%luus avg=%luus "
+           "op/s=%.3f %.3fMB/s\n", iterations, tot_time, min_time, max_time,
+           avg_time, (double) (iterations * 1000) / (double) tot_time,
+           (((double) (iterations * 1000) / (double) (1024 * 1024)) *
+            XTS_REQUEST) / (double) tot_time);
+
+    testcase_pass("AES-XTS EncryptUpdate with keylen=%lu datalen=%d "
+                  "chunklen=%d", key_len * 8, XTS_REQUEST, XTS_CHUNK);
+
+    testcase_begin("AES-XTS DecryptUpdate with keylen=%lu datalen=%d "
+                   "chunklen=%d", key_len * 8, XTS_REQUEST, XTS_CHUNK);
+    testcase_new_assertion();
+
+    tot_time = 0;
+    max_time = 0;
+    min_time = 0xFFFFFFFF;
+
+    for (i = 0; i < iterations + 2; i++) {
+        GetSystemTime(&t1);
+        rc = funcs->C_DecryptInit(session, &mech, h_key);
+        if (rc != CKR_OK) {
+            testcase_error("C_DecryptInit rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+
+        out_pos = 0;
+        for (in_pos = 0; in_pos < XTS_REQUEST; in_pos += XTS_CHUNK) {
+            len = XTS_REQUEST - out_pos;
+            rc = funcs->C_DecryptUpdate(session, cipher + in_pos, XTS_CHUNK,
+                                     clear + out_pos, &len);
+            if (rc != CKR_OK) {
+                testcase_error("C_DecryptUpdate rc=%s", p11_get_ckr(rc));
+                goto testcase_cleanup;
+            }
+            out_pos += len;
+        }
+
+        len = XTS_REQUEST - out_pos;
+        rc = funcs->C_DecryptFinal(session, clear + out_pos, &len);
+        if (rc != CKR_OK) {
+            testcase_error("C_DecryptFinal rc=%s", p11_get_ckr(rc));
+            goto testcase_cleanup;
+        }
+        out_pos += len;
+
+        GetSystemTime(&t2);
+        diff = delta_time_us(&t1, &t2);
+        tot_time += diff;
+        if (diff < min_time)
+            min_time = diff;
+
+        if (diff > max_time)
+            max_time = diff;
+    }
+
+    if (out_pos != XTS_REQUEST) {
+        testcase_fail("Decrypt output length %lu, expected %d", out_pos,
+                      XTS_REQUEST);
+        goto testcase_cleanup;
+    }
+
+    tot_time -= min_time;
+    tot_time -= max_time;
+    avg_time = tot_time / iterations;
+
+    // us -> ms
+    tot_time /= 1000;
+
+    printf("%lu iterations: total=%lums min=%luus max=%luus avg=%luus "
+           "op/s=%.3f %.3fMB/s\n", iterations, tot_time, min_time, max_time,
+           avg_time, (double) (iterations * 1000) / (double) tot_time,
+           (((double) (iterations * 1000) / (double) (1024 * 1024)) *
+            XTS_REQUEST) / (double) tot_time);
+
+    if (memcmp(original, clear, XTS_REQUEST) != 0) {
+        testcase_fail("decrypted data does not match original data");
+        goto testcase_cleanup;
+    }
+
+    testcase_pass("AES-XTS DecryptUpdate with keylen=%lu datalen=%d "
+                  "chunklen=%d", key_len * 8, XTS_REQUEST, XTS_CHUNK);
+
+testcase_cleanup:
+    free(original);
+    free(cipher);
+    free(clear);
+    testcase_closeall_session();
+    if (rc != CKR_OK)
+        return FALSE;
+
+    return TRUE;
+}
+
 int do_SHA(const char *mode)
 {
     CK_SESSION_HANDLE session;
@@ -1163,6 +1391,12 @@ int main(int argc, char **argv)
         rc = do_AES_EncrDecr(256, "CBC");
         if (!rc)
             goto out;
+        rc = do_AES_XTS_EncrDecrUpdate(256);
+        if (!rc)
+            goto out;
+        rc = do_AES_XTS_EncrDecrUpdate(512);
+        if (!rc)
+            goto out;
     }
 
     if (do_sha) {
@@ -0,0 +1,589 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/* File: tok_bench.c
+ *
+ * Multi-threaded throughput benchmark driving a token through the PKCS#11
+ * API. Each thread uses its own session and runs the selected operation
+ * for a fixed time:
+ *
+ *    AES-CBC encrypt, SHA-256 digest, SHA-256 HMAC sign,
+ *    SHA256-RSA-PKCS sign (2048 bit), ECDSA-SHA256 sign (P-256),
+ *    AES key generation,
+ *    AES-CBC + SHA-256 and AES-CTR + SHA256-HMAC dual-function updates,
+ *    fused (C_DigestEncryptUpdate, C_SignEncryptUpdate) and sequential
+ *    (C_EncryptUpdate followed by C_DigestUpdate or C_SignUpdate),
+ *    AES-CBC-PAD wrapping of an RSA (2048 bit) or EC (P-256) private key
+ *
+ * With -rsa_me the RSA private key is imported in modular-exponent format,
+ * i.e. without the CRT components, instead of being generated.
+ *
+ * Together with the EP11 host library emulator (testcases/ep11emu) or the
+ * CCA host library emulator (testcases/ccaemu) this measures the token side
+ * overhead of the EP11 or CCA token and how it scales with threads and
+ * simulated adapter latency.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "pkcs11types.h"
+#include "regress.h"
+#include "common.c"
+
+#define BENCH_MAX_THREADS   256
+#define BENCH_MAX_DATALEN   (1024 * 1024)
+#define BENCH_AES_BLOCK     16
+
+enum bench_op {
+    BENCH_AES_CBC,
+    BENCH_SHA256,
+    BENCH_HMAC,
+    BENCH_RSA_SIGN,
+    BENCH_ECDSA_SIGN,
+    BENCH_AES_KEYGEN,
+    BENCH_GETATTR,
+    BENCH_DUAL_CBC_SHA256,
+    BENCH_SEQ_CBC_SHA256,
+    BENCH_DUAL_CTR_HMAC,
+    BENCH_SEQ_CTR_HMAC,
+    BENCH_RSA_WRAP,
+    BENCH_EC_WRAP,
+    BENCH_NUM_OPS,
+};
+
+static const char *bench_names[BENCH_NUM_OPS] = {
+    "aes_cbc", "sha256", "hmac", "rsa_sign", "ecdsa_sign", "aes_keygen",
+    "getattr", "dual_cbc_sha256", "seq_cbc_sha256", "dual_ctr_hmac",
+    "seq_ctr_hmac", "rsa_wrap", "ec_wrap",
+};
+
+static CK_BYTE prime256v1[] = {
+    0x06, 0x08, 0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x03, 0x01, 0x07
+};
+
+struct bench_keys {
+    CK_OBJECT_HANDLE aes;
+    CK_OBJECT_HANDLE hmac;
+    CK_OBJECT_HANDLE rsa_publ, rsa_priv;
+    CK_OBJECT_HANDLE ec_publ, ec_priv;
+};
+
+struct bench_thread {
+    pthread_t id;
+    enum bench_op op;
+    struct bench_keys *keys;
+    CK_ULONG datalen;
+    unsigned long ops;
+    unsigned long long busy_ns;
+    CK_RV rc;
+};
+
+static volatile int bench_stop;
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Encrypts the data and digests (AES-CBC + SHA-256) or MACs (AES-CTR +
+ * SHA256-HMAC) it, either with one dual-function update or with the two
+ * single-function updates.
+ */
+static CK_RV bench_dual(CK_SESSION_HANDLE session, struct bench_thread *t,
+                        CK_BYTE *data, CK_BYTE *out, CK_BBOOL hmac,
+                        CK_BBOOL fused)
+{
+    CK_BYTE iv[BENCH_AES_BLOCK] = { 0 };
+    CK_AES_CTR_PARAMS ctr_param = { .ulCounterBits = BENCH_AES_BLOCK };
+    CK_MECHANISM encr_mech = { CKM_AES_CBC, iv, sizeof(iv) };
+    CK_MECHANISM mech = { CKM_SHA256, NULL, 0 };
+    CK_BYTE mac[64];
+    CK_ULONG outlen = BENCH_MAX_DATALEN + 1024, maclen = sizeof(mac);
+    CK_RV rc;
+
+    if (hmac) {
+        encr_mech.mechanism = CKM_AES_CTR;
+        encr_mech.pParameter = &ctr_param;
+        encr_mech.ulParameterLen = sizeof(ctr_param);
+        mech.mechanism = CKM_SHA256_HMAC;
+        rc = funcs->C_SignInit(session, &mech, t->keys->hmac);
+    } else {
+        rc = funcs->C_DigestInit(session, &mech);
+    }
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = funcs->C_EncryptInit(session, &encr_mech, t->keys->aes);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (fused && hmac) {
+        rc = funcs->C_SignEncryptUpdate(session, data, t->datalen, out,
+                                        &outlen);
+    } else if (fused) {
+        rc = funcs->C_DigestEncryptUpdate(session, data, t->datalen, out,
+                                          &outlen);
+    } else {
+        rc = hmac ? funcs->C_SignUpdate(session, data, t->datalen) :
+                    funcs->C_DigestUpdate(session, data, t->datalen);
+        if (rc != CKR_OK)
+            return rc;
+        rc = funcs->C_EncryptUpdate(session, data, t->datalen, out, &outlen);
+    }
+    if (rc != CKR_OK)
+        return rc;
+
+    outlen = BENCH_MAX_DATALEN + 1024;
+    rc = funcs->C_EncryptFinal(session, out, &outlen);
+    if (rc != CKR_OK)
+        return rc;
+
+    return hmac ? funcs->C_SignFinal(session, mac, &maclen) :
+                  funcs->C_DigestFinal(session, mac, &maclen);
+}
+
+static CK_RV bench_one(CK_SESSION_HANDLE session, struct bench_thread *t,
+                       CK_BYTE *data, CK_BYTE *out)
+{
+    CK_BYTE iv[BENCH_AES_BLOCK] = { 0 };
+    CK_MECHANISM mech = { 0, NULL, 0 };
+    CK_ULONG outlen = BENCH_MAX_DATALEN + 1024;
+    CK_ULONG keylen = 32;
+    CK_KEY_TYPE key_type;
+    CK_BYTE label[64];
+    CK_ATTRIBUTE attrs[] = {
+        { CKA_KEY_TYPE, &key_type, sizeof(key_type) },
+        { CKA_VALUE_LEN, &keylen, sizeof(keylen) },
+        { CKA_LABEL, label, sizeof(label) },
+    };
+    CK_OBJECT_HANDLE key;
+    CK_RV rc;
+
+    switch (t->op) {
+    case BENCH_AES_CBC:
+        mech.mechanism = CKM_AES_CBC;
+        mech.pParameter = iv;
+        mech.ulParameterLen = sizeof(iv);
+        rc = funcs->C_EncryptInit(session, &mech, t->keys->aes);
+        if (rc != CKR_OK)
+            return rc;
+        return funcs->C_Encrypt(session, data, t->datalen, out, &outlen);
+    case BENCH_SHA256:
+        mech.mechanism = CKM_SHA256;
+        rc = funcs->C_DigestInit(session, &mech);
+        if (rc != CKR_OK)
+            return rc;
+        return funcs->C_Digest(session, data, t->datalen, out, &outlen);
+    case BENCH_HMAC:
+        mech.mechanism = CKM_SHA256_HMAC;
+        key = t->keys->hmac;
+        break;
+    case BENCH_RSA_SIGN:
+        mech.mechanism = CKM_SHA256_RSA_PKCS;
+        key = t->keys->rsa_priv;
+        break;
+    case BENCH_ECDSA_SIGN:
+        mech.mechanism = CKM_ECDSA_SHA256;
+        key = t->keys->ec_priv;
+        break;
+    case BENCH_AES_KEYGEN:
+        mech.mechanism = CKM_AES_KEY_GEN;
+        rc = generate_AESKey(session, keylen, TRUE, &mech, &key);
+        if (rc != CKR_OK)
+            return rc;
+        return funcs->C_DestroyObject(session, key);
+    case BENCH_GETATTR:
+        return funcs->C_GetAttributeValue(session, t->keys->aes, attrs,
+                                          sizeof(attrs) / sizeof(attrs[0]));
+    case BENCH_DUAL_CBC_SHA256:
+        return bench_dual(session, t, data, out, FALSE, TRUE);
+    case BENCH_SEQ_CBC_SHA256:
+        return bench_dual(session, t, data, out, FALSE, FALSE);
+    case BENCH_DUAL_CTR_HMAC:
+        return bench_dual(session, t, data, out, TRUE, TRUE);
+    case BENCH_SEQ_CTR_HMAC:
+        return bench_dual(session, t, data, out, TRUE, FALSE);
+    case BENCH_RSA_WRAP:
+    case BENCH_EC_WRAP:
+        mech.mechanism = CKM_AES_CBC_PAD;
+        mech.pParameter = iv;
+        mech.ulParameterLen = sizeof(iv);
+        key = t->op == BENCH_RSA_WRAP ? t->keys->rsa_priv : t->keys->ec_priv;
+        return funcs->C_WrapKey(session, &mech, t->keys->aes, key, out,
+                                &outlen);
+    default:
+        return CKR_FUNCTION_FAILED;
+    }
+
+    rc = funcs->C_SignInit(session, &mech, key);
+    if (rc != CKR_OK)
+        return rc;
+    return funcs->C_Sign(session, data, t->datalen, out, &outlen);
+}
+
+static void *bench_thread_func(void *arg)
+{
+    struct bench_thread *t = arg;
+    CK_SESSION_HANDLE session;
+    unsigned long long start;
+    CK_BYTE *data, *out;
+
+    data = calloc(1, BENCH_MAX_DATALEN);
+    out = calloc(1, BENCH_MAX_DATALEN + 1024);
+    if (data == NULL || out == NULL) {
+        t->rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    t->rc = funcs->C_OpenSession(SLOT_ID, CKF_SERIAL_SESSION | CKF_RW_SESSION,
+                                 NULL, NULL, &session);
+    if (t->rc != CKR_OK)
+        goto out;
+
+    while (!bench_stop) {
+        start = now_ns();
+        t->rc = bench_one(session, t, data, out);
+        if (t->rc != CKR_OK)
+            break;
+        t->busy_ns += now_ns() - start;
+        t->ops++;
+    }
+
+    funcs->C_CloseSession(session);
+
+out:
+    free(data);
+    free(out);
+    return NULL;
+}
+
+static int bench_run(enum bench_op op, struct bench_keys *keys,
+                     CK_ULONG num_threads, CK_ULONG seconds,
+                     CK_ULONG datalen, double min_ops)
+{
+    struct bench_thread *threads;
+    unsigned long long start, elapsed, busy_ns = 0;
+    unsigned long ops = 0;
+    double ops_per_sec;
+    CK_RV rc = CKR_OK;
+    CK_ULONG i;
+
+    testcase_begin("%s with %lu threads, datalen=%lu", bench_names[op],
+                   num_threads, datalen);
+
+    threads = calloc(num_threads, sizeof(*threads));
+    if (threads == NULL) {
+        testcase_error("calloc failed");
+        return FALSE;
+    }
+
+    bench_stop = 0;
+    start = now_ns();
+
+    for (i = 0; i < num_threads; i++) {
+        threads[i].op = op;
+        threads[i].keys = keys;
+        threads[i].datalen = datalen;
+        if (pthread_create(&threads[i].id, NULL, bench_thread_func,
+                           &threads[i]) != 0) {
+            testcase_error("pthread_create failed");
+            bench_stop = 1;
+            num_threads = i;
+            break;
+        }
+    }
+
+    sleep(seconds);
+    bench_stop = 1;
+
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i].id, NULL);
+        if (threads[i].rc != CKR_OK && rc == CKR_OK)
+            rc = threads[i].rc;
+        ops += threads[i].ops;
+        busy_ns += threads[i].busy_ns;
+    }
+    elapsed = now_ns() - start;
+    free(threads);
+
+    testcase_new_assertion();
+    if (rc != CKR_OK) {
+        testcase_fail("%s failed, rc=%s", bench_names[op], p11_get_ckr(rc));
+        return FALSE;
+    }
+
+    ops_per_sec = (double)ops * 1000000000.0 / elapsed;
+    printf("%-15s threads=%-4lu ops=%-9lu ops/s=%-11.1f MB/s=%-9.1f "
+           "avg_us=%.1f\n", bench_names[op], num_threads, ops, ops_per_sec,
+           ops_per_sec * datalen / (1024.0 * 1024.0),
+           ops > 0 ? (double)busy_ns / ops / 1000.0 : 0.0);
+
+    if (ops_per_sec < min_ops) {
+        testcase_fail("%s: %.1f ops/s below the minimum of %.1f ops/s",
+                      bench_names[op], ops_per_sec, min_ops);
+        return FALSE;
+    }
+
+    testcase_pass("%s: %.1f ops/s", bench_names[op], ops_per_sec);
+    return TRUE;
+}
+
+/*
+ * Generates an extractable RSA key pair and imports its private key again
+ * with the modulus and the exponents only.
+ */
+static CK_RV bench_create_rsa_me_key(CK_SESSION_HANDLE session,
+                                     struct bench_keys *keys)
+{
+    CK_MECHANISM mech = { CKM_RSA_PKCS_KEY_PAIR_GEN, NULL, 0 };
+    CK_ULONG modulus_bits = 2048;
+    CK_BYTE exp[] = { 0x01, 0x00, 0x01 };
+    CK_BBOOL true = TRUE, false = FALSE;
+    CK_ATTRIBUTE publ_tmpl[] = {
+        {CKA_VERIFY, &true, sizeof(true)},
+        {CKA_MODULUS_BITS, &modulus_bits, sizeof(modulus_bits)},
+        {CKA_PUBLIC_EXPONENT, exp, sizeof(exp)},
+    };
+    CK_ATTRIBUTE priv_tmpl[] = {
+        {CKA_SENSITIVE, &false, sizeof(false)},
+        {CKA_SIGN, &true, sizeof(true)},
+    };
+    CK_BYTE modulus[512], pub_exp[16], priv_exp[512];
+    CK_ATTRIBUTE attrs[] = {
+        {CKA_MODULUS, modulus, sizeof(modulus)},
+        {CKA_PUBLIC_EXPONENT, pub_exp, sizeof(pub_exp)},
+        {CKA_PRIVATE_EXPONENT, priv_exp, sizeof(priv_exp)},
+    };
+    CK_OBJECT_HANDLE priv_key;
+    CK_RV rc;
+
+    rc = funcs->C_GenerateKeyPair(session, &mech, publ_tmpl, 3, priv_tmpl, 2,
+                                  &keys->rsa_publ, &priv_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_GenerateKeyPair rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    rc = funcs->C_GetAttributeValue(session, priv_key, attrs, 3);
+    funcs->C_DestroyObject(session, priv_key);
+    if (rc != CKR_OK) {
+        testcase_error("C_GetAttributeValue rc=%s", p11_get_ckr(rc));
+        return rc;
+    }
+
+    return create_RSAPrivateKey(session, modulus, pub_exp, priv_exp,
+                                NULL, NULL, NULL, NULL, NULL,
+                                attrs[0].ulValueLen, attrs[1].ulValueLen,
+                                attrs[2].ulValueLen, 0, 0, 0, 0, 0,
+                                &keys->rsa_priv);
+}
+
+static CK_RV bench_create_keys(CK_SESSION_HANDLE session,
+                               struct bench_keys *keys, int *selected,
+                               CK_BBOOL rsa_me)
+{
+    CK_MECHANISM mech = { CKM_AES_KEY_GEN, NULL, 0 };
+    CK_BYTE exp[] = { 0x01, 0x00, 0x01 };
+    CK_BYTE hmac_key[32];
+    CK_RV rc;
+
+    if (selected[BENCH_AES_CBC] || selected[BENCH_GETATTR] ||
+        selected[BENCH_DUAL_CBC_SHA256] || selected[BENCH_SEQ_CBC_SHA256] ||
+        selected[BENCH_DUAL_CTR_HMAC] || selected[BENCH_SEQ_CTR_HMAC] ||
+        selected[BENCH_RSA_WRAP] || selected[BENCH_EC_WRAP]) {
+        rc = generate_AESKey(session, 32, TRUE, &mech, &keys->aes);
+        if (rc != CKR_OK)
+            return rc;
+    }
+
+    if (selected[BENCH_HMAC] || selected[BENCH_DUAL_CTR_HMAC] ||
+        selected[BENCH_SEQ_CTR_HMAC]) {
+        memset(hmac_key, 0x5a, sizeof(hmac_key));
+        rc = create_GenericSecretKey(session, hmac_key, sizeof(hmac_key),
+                                     &keys->hmac);
+        if (rc != CKR_OK)
+            return rc;
+    }
+
+    if (selected[BENCH_RSA_SIGN] || selected[BENCH_RSA_WRAP]) {
+        if (rsa_me)
+            rc = bench_create_rsa_me_key(session, keys);
+        else
+            rc = generate_RSA_PKCS_KeyPair(session, 2048, exp, sizeof(exp),
+                                           &keys->rsa_publ, &keys->rsa_priv);
+        if (rc != CKR_OK)
+            return rc;
+    }
+
+    if (selected[BENCH_ECDSA_SIGN] || selected[BENCH_EC_WRAP]) {
+        rc = generate_EC_KeyPair(session, prime256v1, sizeof(prime256v1),
+                                 &keys->ec_publ, &keys->ec_priv, TRUE);
+        if (rc != CKR_OK)
+            return rc;
+    }
+
+    return CKR_OK;
+}
+
+static void bench_destroy_keys(CK_SESSION_HANDLE session,
+                               struct bench_keys *keys)
+{
+    CK_OBJECT_HANDLE handles[] = { keys->aes, keys->hmac, keys->rsa_publ,
+                                   keys->rsa_priv, keys->ec_publ,
+                                   keys->ec_priv };
+    CK_ULONG i;
+
+    for (i = 0; i < sizeof(handles) / sizeof(handles[0]); i++) {
+        if (handles[i] != CK_INVALID_HANDLE)
+            funcs->C_DestroyObject(session, handles[i]);
+    }
+}
+
+static void tok_bench_usage(char *fct)
+{
+    printf("usage:  %s -slot <num> [-threads <num>] [-seconds <num>]", fct);
+    printf(" [-datalen <num>] [-min_ops <num>]");
+    printf(" [-aes_cbc] [-sha256] [-hmac] [-rsa_sign] [-ecdsa_sign]");
+    printf(" [-aes_keygen] [-getattr] [-dual_cbc_sha256] [-seq_cbc_sha256]");
+    printf(" [-dual_ctr_hmac] [-seq_ctr_hmac] [-rsa_wrap] [-ec_wrap]");
+    printf(" [-rsa_me] [-h]\n\n");
+    printf("Runs each selected operation (all by default) for -seconds "
+           "(default 5) in\n-threads (default 1) parallel sessions and "
+           "reports the throughput. With\n-min_ops the test fails if an "
+           "operation is slower than the given ops/s.\n"
+           "Compare -dual_* with -seq_* on large -datalen values (e.g. "
+           "1048576) for the\nbenefit of the fused dual-function "
+           "updates.\nWith -rsa_me the RSA private key is imported without "
+           "its CRT components.\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    CK_C_INITIALIZE_ARGS cinit_args;
+    CK_SESSION_HANDLE session = CK_INVALID_HANDLE;
+    CK_BYTE user_pin[PKCS11_MAX_PIN_LEN];
+    CK_ULONG user_pin_len;
+    CK_FLAGS flags;
+    CK_ULONG num_threads = 1, seconds = 5, datalen = 1024;
+    double min_ops = 0;
+    int selected[BENCH_NUM_OPS] = { 0 };
+    struct bench_keys keys;
+    int i, any = 0, ret = TRUE;
+    CK_BBOOL rsa_me = FALSE;
+    CK_RV rc;
+
+    SLOT_ID = 1000;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-slot") == 0 && i + 1 < argc) {
+            SLOT_ID = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            num_threads = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-seconds") == 0 && i + 1 < argc) {
+            seconds = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-datalen") == 0 && i + 1 < argc) {
+            datalen = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-min_ops") == 0 && i + 1 < argc) {
+            min_ops = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "-rsa_me") == 0) {
+            rsa_me = TRUE;
+        } else if (strcmp(argv[i], "-h") == 0) {
+            tok_bench_usage(argv[0]);
+            return 0;
+        } else {
+            int op;
+
+            for (op = 0; op < BENCH_NUM_OPS; op++) {
+                if (argv[i][0] == '-' &&
+                    strcmp(argv[i] + 1, bench_names[op]) == 0)
+                    break;
+            }
+            if (op == BENCH_NUM_OPS) {
+                printf("unknown option '%s'\n", argv[i]);
+                tok_bench_usage(argv[0]);
+                return 1;
+            }
+            selected[op] = 1;
+            any = 1;
+        }
+    }
+
+    if (SLOT_ID == 1000) {
+        printf("Please specify the slot to be tested.\n");
+        tok_bench_usage(argv[0]);
+        return 1;
+    }
+
+    if (num_threads == 0 || num_threads > BENCH_MAX_THREADS ||
+        seconds == 0 || datalen == 0 || datalen > BENCH_MAX_DATALEN ||
+        (datalen % BENCH_AES_BLOCK) != 0) {
+        printf("Invalid -threads, -seconds or -datalen value (datalen must "
+               "be a multiple of %u, at most %u)\n", BENCH_AES_BLOCK,
+               BENCH_MAX_DATALEN);
+        return 1;
+    }
+
+    for (i = 0; i < BENCH_NUM_OPS && !any; i++)
+        selected[i] = 1;
+
+    printf("Using slot #%lu...\n\n", SLOT_ID);
+    memset(&keys, 0, sizeof(keys));
+
+    rc = do_GetFunctionList();
+    if (!rc)
+        return rc;
+
+    memset(&cinit_args, 0x0, sizeof(cinit_args));
+    cinit_args.flags = CKF_OS_LOCKING_OK;
+
+    funcs->C_Initialize(&cinit_args);
+
+    testcase_setup();
+    testsuite_begin("Token throughput benchmark");
+
+    testcase_rw_session();
+    testcase_user_login();
+
+    /* Session objects of this session are usable by all sessions */
+    rc = bench_create_keys(session, &keys, selected, rsa_me);
+    if (rc != CKR_OK) {
+        testcase_error("creating the benchmark keys failed, rc=%s",
+                       p11_get_ckr(rc));
+        ret = FALSE;
+        goto testcase_cleanup;
+    }
+
+    for (i = 0; i < BENCH_NUM_OPS; i++) {
+        if (!selected[i])
+            continue;
+        if (!bench_run(i, &keys, num_threads, seconds, datalen, min_ops))
+            ret = FALSE;
+    }
+
+testcase_cleanup:
+    bench_destroy_keys(session, &keys);
+    testcase_user_logout();
+    testcase_close_session();
+    funcs->C_Finalize(NULL);
+
+    testcase_print_result();
+
+    return testcase_return(ret ? CKR_OK : CKR_FUNCTION_FAILED);
+}
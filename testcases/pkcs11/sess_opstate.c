@@ -18,9 +18,12 @@
 #include <string.h>
 #include <memory.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "pkcs11types.h"
 #include "regress.h"
+#include "mech_to_str.h"
 #include "common.c"
 
 
@@ -251,6 +254,559 @@ out:
     return rc;
 }
 
+#define MAX_HASH_SIZE       64
+#define SPLIT_DATA_LEN      4096
+#define BENCH_PREFIX_LEN    (16 * 1024 * 1024)
+#define BENCH_RESUMES       1000
+
+static const CK_MECHANISM_TYPE split_digests[] = {
+    CKM_SHA_1, CKM_SHA224, CKM_SHA256, CKM_SHA384, CKM_SHA512,
+    CKM_SHA512_224, CKM_SHA512_256, CKM_SHA3_224, CKM_SHA3_256,
+    CKM_SHA3_384, CKM_SHA3_512,
+};
+
+static const CK_MECHANISM_TYPE split_hmacs[] = {
+    CKM_SHA_1_HMAC, CKM_SHA256_HMAC, CKM_SHA512_HMAC, CKM_SHA3_256_HMAC,
+    CKM_SHA256_HMAC_GENERAL,
+};
+
+/*
+ * Returns the operation state of a session in a malloc'ed buffer. Returns
+ * NULL with *rc = CKR_STATE_UNSAVEABLE if the state can not be saved.
+ */
+static CK_BYTE *get_op_state(CK_SESSION_HANDLE sess, CK_ULONG *len, CK_RV *rc)
+{
+    CK_BYTE *state;
+
+    *len = 0;
+    *rc = funcs->C_GetOperationState(sess, NULL, len);
+    if (*rc != CKR_OK) {
+        if (*rc != CKR_STATE_UNSAVEABLE)
+            testcase_error("C_GetOperationState rc=%s", p11_get_ckr(*rc));
+        return NULL;
+    }
+
+    state = malloc(*len);
+    if (state == NULL) {
+        testcase_error("malloc(%lu) failed", *len);
+        *rc = CKR_HOST_MEMORY;
+        return NULL;
+    }
+
+    *rc = funcs->C_GetOperationState(sess, state, len);
+    if (*rc != CKR_OK) {
+        if (*rc != CKR_STATE_UNSAVEABLE)
+            testcase_error("C_GetOperationState rc=%s", p11_get_ckr(*rc));
+        free(state);
+        return NULL;
+    }
+
+    return state;
+}
+
+/*
+ * Splits digests at random points: the first part is digested in session 1,
+ * the remaining part in session 2 after restoring the state of session 1.
+ */
+int sess_opstate_split(int loops)
+{
+    CK_SESSION_HANDLE s1, s2;
+    CK_SLOT_ID slot_id = SLOT_ID;
+    CK_FLAGS flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+    CK_MECHANISM mech = { 0, NULL, 0 };
+    CK_BYTE hash[MAX_HASH_SIZE], ref[MAX_HASH_SIZE];
+    CK_ULONG hlen, reflen, statelen, split;
+    CK_BYTE *data = NULL, *state = NULL;
+    unsigned int i;
+    int n;
+    CK_RV rc;
+
+    testcase_begin("Get/SetOperationState digest split test");
+
+    rc = funcs->C_OpenSession(slot_id, flags, NULL, NULL, &s1);
+    if (rc != CKR_OK) {
+        testcase_error("C_OpenSession() rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    rc = funcs->C_OpenSession(slot_id, flags, NULL, NULL, &s2);
+    if (rc != CKR_OK) {
+        testcase_error("C_OpenSession() rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    data = alloc_random_buf(s1, SPLIT_DATA_LEN);
+    if (data == NULL)
+        goto out;
+
+    for (i = 0; i < sizeof(split_digests) / sizeof(split_digests[0]); i++) {
+        mech.mechanism = split_digests[i];
+        if (!mech_supported(SLOT_ID, mech.mechanism)) {
+            testcase_skip("Mechanism %s is not supported with slot %lu",
+                          mech_to_str(mech.mechanism), SLOT_ID);
+            continue;
+        }
+
+        testcase_new_assertion();
+        for (n = 0; n < loops; n++) {
+            split = random() % (SPLIT_DATA_LEN + 1);
+
+            rc = funcs->C_DigestInit(s1, &mech);
+            if (rc == CKR_OK)
+                rc = funcs->C_DigestUpdate(s1, data, split);
+            if (rc != CKR_OK) {
+                testcase_error("C_DigestInit/Update rc=%s", p11_get_ckr(rc));
+                goto out;
+            }
+
+            state = get_op_state(s1, &statelen, &rc);
+            if (state == NULL)
+                break;
+
+            rc = funcs->C_SetOperationState(s2, state, statelen, 0, 0);
+            if (rc != CKR_OK) {
+                testcase_error("C_SetOperationState rc=%s", p11_get_ckr(rc));
+                goto out;
+            }
+            free(state);
+            state = NULL;
+
+            /* Finish the operation of session 1, the state is in session 2 */
+            hlen = sizeof(hash);
+            rc = funcs->C_DigestFinal(s1, hash, &hlen);
+            if (rc != CKR_OK) {
+                testcase_error("C_DigestFinal rc=%s", p11_get_ckr(rc));
+                goto out;
+            }
+
+            hlen = sizeof(hash);
+            rc = funcs->C_DigestUpdate(s2, data + split,
+                                       SPLIT_DATA_LEN - split);
+            if (rc == CKR_OK)
+                rc = funcs->C_DigestFinal(s2, hash, &hlen);
+            if (rc != CKR_OK) {
+                testcase_error("C_DigestUpdate/Final rc=%s", p11_get_ckr(rc));
+                goto out;
+            }
+
+            reflen = sizeof(ref);
+            rc = funcs->C_DigestInit(s1, &mech);
+            if (rc == CKR_OK)
+                rc = funcs->C_Digest(s1, data, SPLIT_DATA_LEN, ref, &reflen);
+            if (rc != CKR_OK) {
+                testcase_error("C_Digest rc=%s", p11_get_ckr(rc));
+                goto out;
+            }
+
+            if (hlen != reflen || memcmp(hash, ref, hlen) != 0) {
+                testcase_fail("%s digest split at %lu differs",
+                              mech_to_str(mech.mechanism), split);
+                goto out;
+            }
+        }
+
+        if (rc == CKR_STATE_UNSAVEABLE) {
+            testcase_skip("%s: state unsaveable",
+                          mech_to_str(mech.mechanism));
+            hlen = sizeof(hash);
+            funcs->C_DigestFinal(s1, hash, &hlen);
+            rc = CKR_OK;
+            continue;
+        }
+
+        testcase_pass("%s digest split test",
+                      mech_to_str(mech.mechanism));
+    }
+
+out:
+    free(state);
+    free(data);
+    funcs->C_CloseAllSessions(slot_id);
+
+    return rc;
+}
+
+/*
+ * Splits HMAC sign operations at random points across two sessions.
+ */
+int sess_opstate_hmac_split(int loops)
+{
+    CK_SESSION_HANDLE s1, s2;
+    CK_SLOT_ID slot_id = SLOT_ID;
+    CK_FLAGS flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+    CK_MAC_GENERAL_PARAMS mac_len = 16;
+    CK_MECHANISM mech = { 0, NULL, 0 };
+    CK_OBJECT_HANDLE key = CK_INVALID_HANDLE;
+    CK_BYTE mac[MAX_HASH_SIZE], ref[MAX_HASH_SIZE];
+    CK_ULONG maclen, reflen, statelen, split;
+    CK_BYTE *data = NULL, *state = NULL, *key_value = NULL;
+    unsigned int i;
+    int n;
+    CK_RV rc;
+
+    testcase_begin("Get/SetOperationState HMAC split test");
+
+    rc = funcs->C_OpenSession(slot_id, flags, NULL, NULL, &s1);
+    if (rc != CKR_OK) {
+        testcase_error("C_OpenSession() rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    rc = funcs->C_OpenSession(slot_id, flags, NULL, NULL, &s2);
+    if (rc != CKR_OK) {
+        testcase_error("C_OpenSession() rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    data = alloc_random_buf(s1, SPLIT_DATA_LEN);
+    key_value = alloc_random_buf(s1, 32);
+    if (data == NULL || key_value == NULL)
+        goto out;
+
+    rc = create_GenericSecretKey(s1, key_value, 32, &key);
+    if (rc != CKR_OK) {
+        if (rc == CKR_POLICY_VIOLATION) {
+            testcase_skip("Generic secret key not allowed by policy");
+            rc = CKR_OK;
+        }
+        goto out;
+    }
+
+    for (i = 0; i < sizeof(split_hmacs) / sizeof(split_hmacs[0]); i++) {
+        mech.mechanism = split_hmacs[i];
+        if (mech.mechanism == CKM_SHA256_HMAC_GENERAL) {
+            mech.pParameter = &mac_len;
+            mech.ulParameterLen = sizeof(mac_len);
+        } else {
+            mech.pParameter = NULL;
+            mech.ulParameterLen = 0;
+        }
+
+        if (!mech_supported(SLOT_ID, mech.mechanism)) {
+            testcase_skip("Mechanism %s is not supported with slot %lu",
+                          mech_to_str(mech.mechanism), SLOT_ID);
+            continue;
+        }
+
+        testcase_new_assertion();
+        for (n = 0; n < loops; n++) {
+            split = random() % (SPLIT_DATA_LEN + 1);
+
+            rc = funcs->C_SignInit(s1, &mech, key);
+            if (rc == CKR_OK)
+                rc = funcs->C_SignUpdate(s1, data, split);
+            if (rc != CKR_OK) {
+                testcase_error("C_SignInit/Update rc=%s", p11_get_ckr(rc));
+                goto out;
+            }
+
+            state = get_op_state(s1, &statelen, &rc);
+            if (state == NULL)
+                break;
+
+            rc = funcs->C_SetOperationState(s2, state, statelen, 0, key);
+            if (rc != CKR_OK) {
+                testcase_error("C_SetOperationState rc=%s", p11_get_ckr(rc));
+                goto out;
+            }
+            free(state);
+            state = NULL;
+
+            maclen = sizeof(mac);
+            rc = funcs->C_SignFinal(s1, mac, &maclen);
+            if (rc != CKR_OK) {
+                testcase_error("C_SignFinal rc=%s", p11_get_ckr(rc));
+                goto out;
+            }
+
+            maclen = sizeof(mac);
+            rc = funcs->C_SignUpdate(s2, data + split, SPLIT_DATA_LEN - split);
+            if (rc == CKR_OK)
+                rc = funcs->C_SignFinal(s2, mac, &maclen);
+            if (rc != CKR_OK) {
+                testcase_error("C_SignUpdate/Final rc=%s", p11_get_ckr(rc));
+                goto out;
+            }
+
+            reflen = sizeof(ref);
+            rc = funcs->C_SignInit(s1, &mech, key);
+            if (rc == CKR_OK)
+                rc = funcs->C_Sign(s1, data, SPLIT_DATA_LEN, ref, &reflen);
+            if (rc != CKR_OK) {
+                testcase_error("C_Sign rc=%s", p11_get_ckr(rc));
+                goto out;
+            }
+
+            if (maclen != reflen || memcmp(mac, ref, maclen) != 0) {
+                testcase_fail("%s split at %lu differs",
+                              mech_to_str(mech.mechanism), split);
+                goto out;
+            }
+        }
+
+        if (rc == CKR_STATE_UNSAVEABLE) {
+            testcase_skip("%s: state unsaveable",
+                          mech_to_str(mech.mechanism));
+            maclen = sizeof(mac);
+            funcs->C_SignFinal(s1, mac, &maclen);
+            rc = CKR_OK;
+            continue;
+        }
+
+        testcase_pass("%s split test",
+                      mech_to_str(mech.mechanism));
+    }
+
+out:
+    free(state);
+    free(data);
+    free(key_value);
+    if (key != CK_INVALID_HANDLE)
+        funcs->C_DestroyObject(s1, key);
+    funcs->C_CloseAllSessions(slot_id);
+
+    return rc;
+}
+
+/*
+ * Continues a digest in a child process: the child process initializes
+ * openCryptoki, restores the saved state in a new session, finishes the
+ * digest, and returns it through a pipe.
+ */
+static CK_RV finish_digest_in_child(CK_BYTE *state, CK_ULONG statelen,
+                                    CK_BYTE *data, CK_ULONG len,
+                                    CK_BYTE *hash, CK_ULONG *hlen)
+{
+    CK_C_INITIALIZE_ARGS cinit_args;
+    CK_FLAGS flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+    CK_SESSION_HANDLE sess;
+    CK_BYTE buf[MAX_HASH_SIZE];
+    CK_ULONG buflen = sizeof(buf);
+    int fds[2], status = 0;
+    ssize_t n;
+    pid_t pid;
+    CK_RV rc;
+
+    if (pipe(fds) != 0) {
+        testcase_error("pipe failed");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        testcase_error("fork failed");
+        close(fds[0]);
+        close(fds[1]);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+
+        memset(&cinit_args, 0, sizeof(cinit_args));
+        cinit_args.flags = CKF_OS_LOCKING_OK;
+        rc = funcs->C_Initialize(&cinit_args);
+        if (rc == CKR_OK)
+            rc = funcs->C_OpenSession(SLOT_ID, flags, NULL, NULL, &sess);
+        if (rc == CKR_OK)
+            rc = funcs->C_SetOperationState(sess, state, statelen, 0, 0);
+        if (rc == CKR_OK)
+            rc = funcs->C_DigestUpdate(sess, data, len);
+        if (rc == CKR_OK)
+            rc = funcs->C_DigestFinal(sess, buf, &buflen);
+        if (rc != CKR_OK)
+            buflen = 0;
+
+        if (write(fds[1], &rc, sizeof(rc)) != sizeof(rc) ||
+            write(fds[1], buf, buflen) != (ssize_t)buflen)
+            _exit(1);
+        funcs->C_Finalize(NULL);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    rc = CKR_FUNCTION_FAILED;
+    if (read(fds[0], &rc, sizeof(rc)) != sizeof(rc))
+        rc = CKR_FUNCTION_FAILED;
+    if (rc == CKR_OK) {
+        n = read(fds[0], hash, *hlen);
+        if (n <= 0)
+            rc = CKR_FUNCTION_FAILED;
+        else
+            *hlen = n;
+    }
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    return rc;
+}
+
+int sess_opstate_fork(void)
+{
+    CK_SESSION_HANDLE sess;
+    CK_SLOT_ID slot_id = SLOT_ID;
+    CK_FLAGS flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+    CK_MECHANISM mech = { CKM_SHA256, NULL, 0 };
+    CK_BYTE hash[MAX_HASH_SIZE], ref[MAX_HASH_SIZE];
+    CK_ULONG hlen = sizeof(hash), reflen = sizeof(ref), statelen, split;
+    CK_BYTE *data = NULL, *state = NULL;
+    CK_RV rc;
+
+    testcase_begin("Get/SetOperationState digest across processes");
+
+    rc = funcs->C_OpenSession(slot_id, flags, NULL, NULL, &sess);
+    if (rc != CKR_OK) {
+        testcase_error("C_OpenSession() rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    if (!mech_supported(SLOT_ID, mech.mechanism)) {
+        testcase_skip("Mechanism CKM_SHA256 is not supported with slot %lu",
+                      SLOT_ID);
+        goto out;
+    }
+
+    data = alloc_random_buf(sess, SPLIT_DATA_LEN);
+    if (data == NULL)
+        goto out;
+    split = random() % (SPLIT_DATA_LEN + 1);
+
+    rc = funcs->C_DigestInit(sess, &mech);
+    if (rc == CKR_OK)
+        rc = funcs->C_Digest(sess, data, SPLIT_DATA_LEN, ref, &reflen);
+    if (rc == CKR_OK)
+        rc = funcs->C_DigestInit(sess, &mech);
+    if (rc == CKR_OK)
+        rc = funcs->C_DigestUpdate(sess, data, split);
+    if (rc != CKR_OK) {
+        testcase_error("C_Digest rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    state = get_op_state(sess, &statelen, &rc);
+    if (state == NULL) {
+        if (rc == CKR_STATE_UNSAVEABLE) {
+            testcase_skip("Get/SetOperationState digest across processes: "
+                          "state unsaveable");
+            rc = CKR_OK;
+        }
+        goto out;
+    }
+
+    testcase_new_assertion();
+    rc = finish_digest_in_child(state, statelen, data + split,
+                                SPLIT_DATA_LEN - split, hash, &hlen);
+    if (rc != CKR_OK) {
+        testcase_fail("Digest in child process rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    if (hlen != reflen || memcmp(hash, ref, hlen) != 0) {
+        testcase_fail("Digest finished in child process differs");
+        goto out;
+    }
+
+    testcase_pass("Get/SetOperationState digest across processes");
+
+out:
+    free(state);
+    free(data);
+    funcs->C_CloseAllSessions(slot_id);
+
+    return rc;
+}
+
+/*
+ * Compares the cost of resuming a digest from a saved state with re-hashing
+ * the prefix that the state covers.
+ */
+int sess_opstate_bench(void)
+{
+    CK_SESSION_HANDLE s1, s2;
+    CK_SLOT_ID slot_id = SLOT_ID;
+    CK_FLAGS flags = CKF_SERIAL_SESSION | CKF_RW_SESSION;
+    CK_MECHANISM mech = { CKM_SHA256, NULL, 0 };
+    CK_BYTE hash[MAX_HASH_SIZE];
+    CK_ULONG hlen = sizeof(hash), statelen;
+    CK_BYTE *prefix = NULL, *state = NULL;
+    struct timespec start;
+    double rehash_us, resume_us;
+    int i;
+    CK_RV rc;
+
+    testcase_begin("Get/SetOperationState resume vs. re-hash");
+
+    rc = funcs->C_OpenSession(slot_id, flags, NULL, NULL, &s1);
+    if (rc == CKR_OK)
+        rc = funcs->C_OpenSession(slot_id, flags, NULL, NULL, &s2);
+    if (rc != CKR_OK) {
+        testcase_error("C_OpenSession() rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    if (!mech_supported(SLOT_ID, mech.mechanism)) {
+        testcase_skip("Mechanism CKM_SHA256 is not supported with slot %lu",
+                      SLOT_ID);
+        goto out;
+    }
+
+    prefix = malloc(BENCH_PREFIX_LEN);
+    if (prefix == NULL) {
+        testcase_error("malloc(%d) failed", BENCH_PREFIX_LEN);
+        goto out;
+    }
+    memset(prefix, 0x5a, BENCH_PREFIX_LEN);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rc = funcs->C_DigestInit(s1, &mech);
+    if (rc == CKR_OK)
+        rc = funcs->C_DigestUpdate(s1, prefix, BENCH_PREFIX_LEN);
+    if (rc != CKR_OK) {
+        testcase_error("C_DigestInit/Update rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+    rehash_us = elapsed_us(&start);
+
+    state = get_op_state(s1, &statelen, &rc);
+    if (state == NULL) {
+        if (rc == CKR_STATE_UNSAVEABLE) {
+            testcase_skip("Get/SetOperationState resume vs. re-hash: "
+                          "state unsaveable");
+            rc = CKR_OK;
+        }
+        goto out;
+    }
+
+    testcase_new_assertion();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < BENCH_RESUMES; i++) {
+        rc = funcs->C_SetOperationState(s2, state, statelen, 0, 0);
+        if (rc != CKR_OK) {
+            testcase_fail("C_SetOperationState rc=%s", p11_get_ckr(rc));
+            goto out;
+        }
+    }
+    resume_us = elapsed_us(&start) / BENCH_RESUMES;
+
+    rc = funcs->C_DigestFinal(s2, hash, &hlen);
+    if (rc != CKR_OK) {
+        testcase_fail("C_DigestFinal rc=%s", p11_get_ckr(rc));
+        goto out;
+    }
+
+    printf("Resuming from a %lu byte state: %.2f us, re-hashing the %d MB "
+           "prefix: %.2f us\n", statelen, resume_us,
+           BENCH_PREFIX_LEN / (1024 * 1024), rehash_us);
+    testcase_pass("Get/SetOperationState resume vs. re-hash");
+
+out:
+    free(state);
+    free(prefix);
+    funcs->C_CloseAllSessions(slot_id);
+
+    return rc;
+}
+
 int main(int argc, char **argv)
 {
     CK_C_INITIALIZE_ARGS cinit_args;
@@ -288,6 +844,9 @@ int main(int argc, char **argv)
         return rc;
     }
 
+    /* Use the saveable software digests of the tokens that have them */
+    setenv("OPENCRYPTOKI_SAVEABLE_DIGEST_STATE", "1", 0);
+
     memset(&cinit_args, 0x0, sizeof(cinit_args));
     cinit_args.flags = CKF_OS_LOCKING_OK;
 
@@ -306,6 +865,14 @@ int main(int argc, char **argv)
     }
     testcase_setup();
     rc = sess_opstate_funcs(loops);
+    if (rc == CKR_OK)
+        rc = sess_opstate_split(loops);
+    if (rc == CKR_OK)
+        rc = sess_opstate_hmac_split(loops);
+    if (rc == CKR_OK)
+        rc = sess_opstate_fork();
+    if (rc == CKR_OK)
+        rc = sess_opstate_bench();
     testcase_print_result();
 
     return testcase_return(rc);
@@ -13,6 +13,9 @@ include testcases/pkcs11/pkcs11.mk
 include testcases/build/build.mk
 include testcases/unit/unit.mk
 include testcases/policy/policy.mk
+include testcases/ep11emu/ep11emu.mk
+include testcases/icsfsim/icsfsim.mk
+include testcases/ccaemu/ccaemu.mk
 
 noinst_SCRIPTS += testcases/ock_tests.sh testcases/init_token.sh testcases/init_vhsm.exp testcases/cleanup_vhsm.exp
 CLEANFILES += testcases/ock_tests.sh testcases/init_token.sh testcases/init_vhsm.exp testcases/cleanup_vhsm.exp
@@ -0,0 +1,373 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "pqc_defs.h"
+#include "unittest.h"
+
+/*
+ * Compares the single-pass der_put_* encoders with the ber_encode_* ones for
+ * all key types and a range of component sizes. Integers are generated with
+ * and without the msb of the first byte set, so that both the padded and
+ * the unpadded INTEGER encodings are covered. The length query of the
+ * der_put_* encoders must return the exact length of the encoding.
+ *
+ * Run with -bench to compare the encoding times.
+ */
+
+#define BENCH_LOOPS     20000
+
+/* The decoders of asn1.c need it, the encoders do not */
+CK_RV build_attribute(CK_ATTRIBUTE_TYPE type, CK_BYTE *data, CK_ULONG data_len,
+                      CK_ATTRIBUTE **attrib)
+{
+    CK_ATTRIBUTE *attr;
+
+    attr = malloc(sizeof(CK_ATTRIBUTE) + data_len);
+    if (attr == NULL)
+        return CKR_HOST_MEMORY;
+
+    attr->type = type;
+    attr->ulValueLen = data_len;
+    attr->pValue = (CK_BYTE *)attr + sizeof(CK_ATTRIBUTE);
+    if (data_len > 0)
+        memcpy(attr->pValue, data, data_len);
+    *attrib = attr;
+
+    return CKR_OK;
+}
+
+static CK_BYTE prime256v1[] = {
+    0x06, 0x08, 0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x03, 0x01, 0x07
+};
+static CK_BYTE secp521r1[] = { 0x06, 0x05, 0x2B, 0x81, 0x04, 0x00, 0x23 };
+
+/* Builds an attribute laid out like a template attribute */
+static CK_ATTRIBUTE *rand_attr(CK_ULONG len, int msb)
+{
+    CK_ATTRIBUTE *attr = NULL;
+    CK_BYTE *buf;
+    CK_ULONG i;
+
+    buf = malloc(len);
+    for (i = 0; i < len; i++)
+        buf[i] = random();
+    if (len > 0)
+        buf[0] = msb ? (buf[0] | 0x80) : ((buf[0] & 0x7f) | 0x01);
+    build_attribute(CKA_VALUE, buf, len, &attr);
+    free(buf);
+
+    return attr;
+}
+
+/* Builds a CKA_EC_POINT of an uncompressed point of the given field size */
+static CK_ATTRIBUTE *ec_point_attr(CK_ULONG field_len)
+{
+    CK_ATTRIBUTE *point, *attr = NULL;
+    CK_BYTE *os = NULL;
+    CK_ULONG os_len;
+
+    point = rand_attr(1 + 2 * field_len, 0);
+    ((CK_BYTE *)point->pValue)[0] = 0x04;
+    ber_encode_OCTET_STRING(FALSE, &os, &os_len, point->pValue,
+                            point->ulValueLen);
+    build_attribute(CKA_EC_POINT, os, os_len, &attr);
+    free(os);
+    free(point);
+
+    return attr;
+}
+
+static int compare(const char *name, CK_ULONG size, int msb, CK_RV rc_old,
+                   CK_BYTE *old, CK_ULONG old_len, CK_RV rc_new,
+                   CK_BYTE *new, CK_ULONG new_len, CK_ULONG new_len_only)
+{
+    int errors = 0;
+
+    if (rc_old != CKR_OK || rc_new != CKR_OK) {
+        fprintf(stderr, "%s (%lu, msb %d): rc old 0x%lx new 0x%lx\n",
+                name, size, msb, rc_old, rc_new);
+        errors++;
+    } else if (old_len != new_len || memcmp(old, new, new_len) != 0) {
+        fprintf(stderr, "%s (%lu, msb %d): encoding differs\n", name, size,
+                msb);
+        errors++;
+    } else if (new_len_only != new_len) {
+        fprintf(stderr, "%s (%lu, msb %d): length %lu, length query %lu\n",
+                name, size, msb, new_len, new_len_only);
+        errors++;
+    }
+
+    free(old);
+    free(new);
+
+    return errors;
+}
+
+#define COMPARE(errors, name, size, msb, old_fn, new_fn, ...)              \
+    do {                                                                    \
+        CK_BYTE *_old = NULL, *_new = NULL;                                 \
+        CK_ULONG _old_len = 0, _new_len = 0, _new_lo = 0;                   \
+        CK_RV _rc_old, _rc_new;                                             \
+                                                                            \
+        _rc_old = old_fn(FALSE, &_old, &_old_len, __VA_ARGS__);             \
+        _rc_new = new_fn(TRUE, &_new, &_new_lo, __VA_ARGS__);               \
+        _rc_new |= new_fn(FALSE, &_new, &_new_len, __VA_ARGS__);            \
+        errors += compare(name, size, msb, _rc_old, _old, _old_len,         \
+                          _rc_new, _new, _new_len, _new_lo);                \
+    } while (0)
+
+static int test_rsa(CK_ULONG bits, int msb)
+{
+    CK_ULONG n = bits / 8;
+    CK_ATTRIBUTE *a[8];
+    CK_ULONG lens[8] = { n, 3, n, n / 2, n / 2, n / 2, n / 2, n / 2 };
+    int i, errors = 0;
+
+    for (i = 0; i < 8; i++)
+        a[i] = rand_attr(lens[i], msb);
+
+    COMPARE(errors, "RSAPrivateKey", bits, msb, ber_encode_RSAPrivateKey,
+            der_put_RSAPrivateKey, a[0], a[1], a[2], a[3], a[4], a[5], a[6],
+            a[7]);
+    COMPARE(errors, "RSAPublicKey", bits, msb, ber_encode_RSAPublicKey,
+            der_put_RSAPublicKey, a[0], a[1]);
+
+    for (i = 0; i < 8; i++)
+        free(a[i]);
+
+    return errors;
+}
+
+static int test_dsa(CK_ULONG bits, int msb)
+{
+    CK_ATTRIBUTE *p, *q, *g, *x, *y;
+    int errors = 0;
+
+    p = rand_attr(bits / 8, msb);
+    q = rand_attr(bits <= 1024 ? 20 : 32, msb);
+    g = rand_attr(bits / 8, msb);
+    x = rand_attr(bits <= 1024 ? 20 : 32, msb);
+    y = rand_attr(bits / 8, msb);
+
+    COMPARE(errors, "DSAPrivateKey", bits, msb, ber_encode_DSAPrivateKey,
+            der_put_DSAPrivateKey, p, q, g, x);
+    COMPARE(errors, "DSAPublicKey", bits, msb, ber_encode_DSAPublicKey,
+            der_put_DSAPublicKey, p, q, g, y);
+    COMPARE(errors, "DHPrivateKey", bits, msb, ber_encode_DHPrivateKey,
+            der_put_DHPrivateKey, p, g, x);
+    COMPARE(errors, "DHPublicKey", bits, msb, ber_encode_DHPublicKey,
+            der_put_DHPublicKey, p, g, y);
+
+    free(p);
+    free(q);
+    free(g);
+    free(x);
+    free(y);
+
+    return errors;
+}
+
+static int test_ec(CK_BYTE *oid, CK_ULONG oid_len, CK_ULONG field_len,
+                   int msb)
+{
+    CK_ATTRIBUTE *params = NULL, *d, *point;
+    int errors = 0;
+
+    build_attribute(CKA_EC_PARAMS, oid, oid_len, &params);
+    d = rand_attr(field_len, msb);
+    point = ec_point_attr(field_len);
+
+    COMPARE(errors, "ECPrivateKey", field_len, msb, der_encode_ECPrivateKey,
+            der_put_ECPrivateKey, params, d, point);
+    COMPARE(errors, "ECPrivateKey w/o point", field_len, msb,
+            der_encode_ECPrivateKey, der_put_ECPrivateKey, params, d, NULL);
+    COMPARE(errors, "ECPublicKey", field_len, msb, ber_encode_ECPublicKey,
+            der_put_ECPublicKey, params, point);
+
+    free(params);
+    free(d);
+    free(point);
+
+    return errors;
+}
+
+static int test_dilithium(const struct pqc_oid *oid, int msb)
+{
+    CK_ATTRIBUTE *rho, *seed, *tr, *s1, *s2, *t0, *t1;
+    int errors = 0;
+
+    rho = rand_attr(oid->len_info.dilithium.rho_len, msb);
+    seed = rand_attr(oid->len_info.dilithium.seed_len, msb);
+    tr = rand_attr(oid->len_info.dilithium.tr_len, msb);
+    s1 = rand_attr(oid->len_info.dilithium.s1_len, msb);
+    s2 = rand_attr(oid->len_info.dilithium.s2_len, msb);
+    t0 = rand_attr(oid->len_info.dilithium.t0_len, msb);
+    t1 = rand_attr(oid->len_info.dilithium.t1_len, msb);
+
+    COMPARE(errors, "DilithiumPrivateKey", oid->keyform, msb,
+            ber_encode_IBM_DilithiumPrivateKey, der_put_IBM_DilithiumPrivateKey,
+            oid->oid, oid->oid_len, rho, seed, tr, s1, s2, t0, t1);
+    COMPARE(errors, "DilithiumPrivateKey w/o t1", oid->keyform, msb,
+            ber_encode_IBM_DilithiumPrivateKey, der_put_IBM_DilithiumPrivateKey,
+            oid->oid, oid->oid_len, rho, seed, tr, s1, s2, t0, NULL);
+    COMPARE(errors, "DilithiumPublicKey", oid->keyform, msb,
+            ber_encode_IBM_DilithiumPublicKey, der_put_IBM_DilithiumPublicKey,
+            oid->oid, oid->oid_len, rho, t1);
+
+    free(rho);
+    free(seed);
+    free(tr);
+    free(s1);
+    free(s2);
+    free(t0);
+    free(t1);
+
+    return errors;
+}
+
+static int test_kyber(const struct pqc_oid *oid, int msb)
+{
+    CK_ULONG k = oid->keyform == CK_IBM_KYBER_KEYFORM_ROUND2_768 ? 3 : 4;
+    CK_ATTRIBUTE *sk, *pk;
+    int errors = 0;
+
+    sk = rand_attr(k * 768 + 96, msb);
+    pk = rand_attr(k * 384 + 32, msb);
+
+    COMPARE(errors, "KyberPrivateKey", oid->keyform, msb,
+            ber_encode_IBM_KyberPrivateKey, der_put_IBM_KyberPrivateKey,
+            oid->oid, oid->oid_len, sk, pk);
+    COMPARE(errors, "KyberPrivateKey w/o pk", oid->keyform, msb,
+            ber_encode_IBM_KyberPrivateKey, der_put_IBM_KyberPrivateKey,
+            oid->oid, oid->oid_len, sk, NULL);
+    COMPARE(errors, "KyberPublicKey", oid->keyform, msb,
+            ber_encode_IBM_KyberPublicKey, der_put_IBM_KyberPublicKey, oid->oid,
+            oid->oid_len, pk);
+
+    free(sk);
+    free(pk);
+
+    return errors;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define BENCH(name, old_fn, new_fn, ...)                                    \
+    do {                                                                    \
+        CK_BYTE *_data;                                                     \
+        CK_ULONG _len;                                                      \
+        double _t[2];                                                       \
+        int _i, _j;                                                         \
+                                                                            \
+        for (_j = 0; _j < 2; _j++) {                                        \
+            _t[_j] = now();                                                 \
+            for (_i = 0; _i < BENCH_LOOPS; _i++) {                          \
+                if ((_j == 0 ? old_fn(FALSE, &_data, &_len, __VA_ARGS__) :  \
+                     new_fn(FALSE, &_data, &_len, __VA_ARGS__)) == CKR_OK)  \
+                    free(_data);                                            \
+            }                                                               \
+            _t[_j] = (now() - _t[_j]) * 1e9 / BENCH_LOOPS;                  \
+        }                                                                   \
+        printf("%-20s %8.0f ns %8.0f ns %6.2fx\n", name, _t[0], _t[1],      \
+               _t[0] / _t[1]);                                              \
+    } while (0)
+
+static void bench(void)
+{
+    CK_ATTRIBUTE *a[8], *params = NULL, *d, *point, *t1, *sk, *pk;
+    CK_ULONG lens[8] = { 256, 3, 256, 128, 128, 128, 128, 128 };
+    int i;
+
+    for (i = 0; i < 8; i++)
+        a[i] = rand_attr(lens[i], 1);
+    build_attribute(CKA_EC_PARAMS, prime256v1, sizeof(prime256v1), &params);
+    d = rand_attr(32, 1);
+    point = ec_point_attr(32);
+    t1 = rand_attr(1920, 0);
+    sk = rand_attr(2400, 0);
+    pk = rand_attr(1184, 0);
+
+    printf("%-20s %11s %11s %7s\n", "encoding", "ber_encode", "der_put",
+           "speedup");
+    BENCH("RSA-2048 private", ber_encode_RSAPrivateKey,
+          der_put_RSAPrivateKey, a[0], a[1], a[2], a[3], a[4], a[5], a[6],
+          a[7]);
+    BENCH("RSA-2048 public", ber_encode_RSAPublicKey, der_put_RSAPublicKey,
+          a[0], a[1]);
+    BENCH("EC P-256 private", der_encode_ECPrivateKey, der_put_ECPrivateKey,
+          params, d, point);
+    BENCH("EC P-256 public", ber_encode_ECPublicKey, der_put_ECPublicKey,
+          params, point);
+    BENCH("Dilithium public", ber_encode_IBM_DilithiumPublicKey,
+          der_put_IBM_DilithiumPublicKey, dilithium_oids[3].oid,
+          dilithium_oids[3].oid_len, d, t1);
+    BENCH("Kyber-768 private", ber_encode_IBM_KyberPrivateKey,
+          der_put_IBM_KyberPrivateKey, kyber_oids[0].oid, kyber_oids[0].oid_len,
+          sk, pk);
+
+    for (i = 0; i < 8; i++)
+        free(a[i]);
+    free(params);
+    free(d);
+    free(point);
+    free(t1);
+    free(sk);
+    free(pk);
+}
+
+int main(int argc, char **argv)
+{
+    CK_ULONG rsa_bits[] = { 512, 1024, 1032, 2048, 4096, 8192 };
+    CK_ULONG dsa_bits[] = { 512, 1024, 2048, 3072 };
+    CK_ULONG i;
+    int msb, errors = 0;
+
+    srandom(1);
+
+    if (argc > 1 && strcmp(argv[1], "-bench") == 0) {
+        bench();
+        return TEST_PASS;
+    }
+
+    for (msb = 0; msb <= 1; msb++) {
+        for (i = 0; i < ARRAYSIZE(rsa_bits); i++)
+            errors += test_rsa(rsa_bits[i], msb);
+        for (i = 0; i < ARRAYSIZE(dsa_bits); i++)
+            errors += test_dsa(dsa_bits[i], msb);
+        errors += test_ec(prime256v1, sizeof(prime256v1), 32, msb);
+        errors += test_ec(secp521r1, sizeof(secp521r1), 66, msb);
+        for (i = 0; dilithium_oids[i].oid != NULL; i++)
+            errors += test_dilithium(&dilithium_oids[i], msb);
+        for (i = 0; kyber_oids[i].oid != NULL; i++)
+            errors += test_kyber(&kyber_oids[i], msb);
+    }
+
+    if (errors) {
+        fprintf(stderr, "%d errors\n", errors);
+        return TEST_FAIL;
+    }
+
+    printf("All DER encoding tests passed\n");
+    return TEST_PASS;
+}
@@ -0,0 +1,184 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "pkcs11types.h"
+#include "local_types.h"
+#include "unittest.h"
+
+#define NUM_VALUES  1000
+
+struct test_value {
+    struct bt_ref_hdr hdr;
+    unsigned long id;
+    int deleted;
+};
+
+struct iter_args {
+    struct btree *t;
+    unsigned long last_handle;
+    unsigned long count;
+    int errors;
+    unsigned long free_handle;          /* handle to free in callback */
+    struct test_value *readd_value;     /* value to add after freeing */
+};
+
+static struct test_value values[NUM_VALUES + 1];
+static unsigned long handles[NUM_VALUES + 1];
+
+static void delete_value(void *v)
+{
+    ((struct test_value *)v)->deleted = 1;
+}
+
+static void count_cb(STDLL_TokData_t *tokdata, void *p1, unsigned long p2,
+                     void *p3)
+{
+    struct test_value *v = p1;
+    struct iter_args *ia = p3;
+
+    (void)tokdata;
+
+    if (p2 <= ia->last_handle) {
+        fprintf(stderr, "handle %lu not in ascending order\n", p2);
+        ia->errors++;
+    }
+    ia->last_handle = p2;
+
+    if (v->deleted || handles[v->id] != p2) {
+        fprintf(stderr, "handle %lu has wrong value %lu\n", p2, v->id);
+        ia->errors++;
+    }
+
+    if (bt_get_node_value(ia->t, p2) != v) {
+        fprintf(stderr, "bt_get_node_value(%lu) returned wrong value\n", p2);
+        ia->errors++;
+    }
+    bt_put_node_value(ia->t, v);
+
+    ia->count++;
+}
+
+static void free_cb(STDLL_TokData_t *tokdata, void *p1, unsigned long p2,
+                    void *p3)
+{
+    struct iter_args *ia = p3;
+
+    count_cb(tokdata, p1, p2, p3);
+
+    if (ia->free_handle == 0)
+        return;
+
+    /* Free another node and reuse it, it must not be visited anymore */
+    bt_node_free(ia->t, ia->free_handle, 1);
+    ia->free_handle = 0;
+
+    if (ia->readd_value != NULL)
+        handles[ia->readd_value->id] = bt_node_add(ia->t, ia->readd_value);
+}
+
+static int check_refs(const char *name, unsigned long first,
+                      unsigned long last)
+{
+    unsigned long i;
+    int errors = 0;
+
+    for (i = first; i <= last; i++) {
+        if (!values[i].deleted && values[i].hdr.ref != 1) {
+            fprintf(stderr, "%s: value %lu has ref %lu\n", name, i,
+                    values[i].hdr.ref);
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+int main(void)
+{
+    struct btree t;
+    struct iter_args ia;
+    unsigned long i, in_use;
+    int errors = 0;
+
+    if (bt_init(&t, delete_value) != CKR_OK) {
+        fprintf(stderr, "bt_init failed\n");
+        return TEST_FAIL;
+    }
+
+    /* Iterating an empty tree must not call the callback */
+    memset(&ia, 0, sizeof(ia));
+    ia.t = &t;
+    bt_for_each_node(NULL, &t, count_cb, &ia);
+    if (ia.count != 0) {
+        fprintf(stderr, "callback called for empty tree\n");
+        errors++;
+    }
+
+    for (i = 1; i < NUM_VALUES; i++) {
+        values[i].id = i;
+        handles[i] = bt_node_add(&t, &values[i]);
+        if (handles[i] != i) {
+            fprintf(stderr, "bt_node_add returned %lu, expected %lu\n",
+                    handles[i], i);
+            errors++;
+        }
+    }
+
+    /* Free every third node */
+    for (i = 1; i < NUM_VALUES; i += 3)
+        bt_node_free(&t, handles[i], 1);
+    in_use = bt_nodes_in_use(&t);
+
+    memset(&ia, 0, sizeof(ia));
+    ia.t = &t;
+    bt_for_each_node(NULL, &t, count_cb, &ia);
+    errors += ia.errors;
+    if (ia.count != in_use) {
+        fprintf(stderr, "visited %lu nodes, expected %lu\n", ia.count, in_use);
+        errors++;
+    }
+    errors += check_refs("count", 1, NUM_VALUES - 1);
+
+    /*
+     * Free a node that was not yet visited from within the callback, and
+     * reuse it for a new value. Neither must be visited.
+     */
+    values[NUM_VALUES].id = NUM_VALUES;
+    memset(&ia, 0, sizeof(ia));
+    ia.t = &t;
+    ia.free_handle = handles[NUM_VALUES - 1];
+    ia.readd_value = &values[NUM_VALUES];
+    bt_for_each_node(NULL, &t, free_cb, &ia);
+    errors += ia.errors;
+    if (ia.count != in_use - 1) {
+        fprintf(stderr, "visited %lu nodes, expected %lu\n", ia.count,
+                in_use - 1);
+        errors++;
+    }
+    if (!values[NUM_VALUES - 1].deleted) {
+        fprintf(stderr, "free'd value not deleted\n");
+        errors++;
+    }
+    if (handles[NUM_VALUES] != handles[NUM_VALUES - 1]) {
+        fprintf(stderr, "free'd node not reused\n");
+        errors++;
+    }
+    errors += check_refs("free", 1, NUM_VALUES);
+
+    bt_destroy(&t);
+
+    printf("btreetest: %d errors\n", errors);
+
+    return errors ? TEST_FAIL : TEST_PASS;
+}
@@ -0,0 +1,427 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Checks the key generation pools of the Soft token: the background thread
+ * fills the pools up to their depth, a take from a filled pool is a hit and
+ * triggers a refill, a take from an empty or unconfigured pool is a miss,
+ * the counters are published in the key pool statistics shared memory
+ * segment, and stopping the pools frees all pre-generated keys.
+ *
+ * The OpenSSL key generation functions are replaced by stubs that return
+ * empty EVP_PKEYs, so that the test does not depend on the speed of the
+ * actual key generation. The stub keys carry ex_data whose free function
+ * counts the freed keys.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "statistics.h"
+#include "soft_keygen_pool.h"
+#include "unittest.h"
+
+#define POOL_DEPTH          4
+#define POOL_MOD_BITS       2048
+#define POOL_PUBL_EXP       65537
+#define WAIT_MSECS          5000
+
+static volatile unsigned long keys_generated;
+static volatile unsigned long keys_freed;
+static volatile unsigned long mech_increments;
+static volatile CK_BBOOL fail_keygen;
+static int ex_data_idx = -1;
+
+static void stub_pkey_ex_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad,
+                              int idx, long argl, void *argp)
+{
+    (void)parent;
+    (void)ad;
+    (void)idx;
+    (void)argl;
+    (void)argp;
+
+    if (ptr != NULL)
+        __sync_add_and_fetch(&keys_freed, 1);
+}
+
+CK_RV openssl_specific_rsa_keygen_pkey(CK_ULONG mod_bits,
+                                       const CK_BYTE *publ_exp,
+                                       CK_ULONG publ_exp_len,
+                                       EVP_PKEY **pkey)
+{
+    (void)mod_bits;
+    (void)publ_exp;
+    (void)publ_exp_len;
+
+    if (fail_keygen)
+        return CKR_FUNCTION_FAILED;
+
+    *pkey = EVP_PKEY_new();
+    if (*pkey == NULL)
+        return CKR_HOST_MEMORY;
+
+    /* Any non-NULL pointer marks the key as generated by the stub */
+    if (EVP_PKEY_set_ex_data(*pkey, ex_data_idx, *pkey) != 1) {
+        EVP_PKEY_free(*pkey);
+        *pkey = NULL;
+        return CKR_FUNCTION_FAILED;
+    }
+
+    __sync_add_and_fetch(&keys_generated, 1);
+    return CKR_OK;
+}
+
+CK_RV openssl_specific_ec_keygen_pkey(const CK_BYTE *params,
+                                      CK_ULONG params_len, EVP_PKEY **pkey)
+{
+    (void)params;
+    (void)params_len;
+    (void)pkey;
+
+    return CKR_FUNCTION_FAILED;
+}
+
+CK_RV openssl_specific_ibm_dilithium_keygen_pkey(const struct pqc_oid *oid,
+                                                 EVP_PKEY **pkey)
+{
+    (void)oid;
+    (void)pkey;
+
+    return CKR_FUNCTION_FAILED;
+}
+
+static CK_RV stub_increment(struct statistics *statistics, CK_SLOT_ID slot,
+                            const CK_MECHANISM *mech, CK_ULONG strength_idx)
+{
+    (void)statistics;
+    (void)slot;
+    (void)mech;
+    (void)strength_idx;
+
+    __sync_add_and_fetch(&mech_increments, 1);
+    return CKR_OK;
+}
+
+static void make_stats_shm_name(CK_SLOT_ID slot_id, char *name, size_t len)
+{
+    size_t i;
+
+    snprintf(name, len - 1, STAT_KEYPOOL_SHM_NAME_FMT, CONFIG_PATH,
+             geteuid(), slot_id);
+    for (i = 1; name[i] != '\0'; i++) {
+        if (name[i] == '/')
+            name[i] = '.';
+    }
+    if (name[0] != '/') {
+        memmove(&name[1], &name[0], strlen(name) + 1);
+        name[0] = '/';
+    }
+}
+
+static struct soft_keygen_pool *new_rsa_pool(CK_ULONG mod_bits,
+                                             CK_ULONG publ_exp)
+{
+    struct soft_keygen_pool *pool;
+
+    pool = calloc(1, sizeof(*pool));
+    if (pool == NULL)
+        return NULL;
+
+    pool->keytype = CKK_RSA;
+    pool->mech = CKM_RSA_PKCS_KEY_PAIR_GEN;
+    pool->mod_bits = mod_bits;
+    pool->publ_exp = publ_exp;
+    pool->depth = POOL_DEPTH;
+    pool->keys = calloc(pool->depth, sizeof(EVP_PKEY *));
+    if (pool->keys == NULL) {
+        free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+/* Waits until the pool has the expected number of keys and state */
+static int wait_for_pool(struct soft_keygen_pools *pools,
+                         struct soft_keygen_pool *pool, CK_ULONG count,
+                         CK_BBOOL disabled)
+{
+    struct timespec ts = { 0, 1000000 };
+    CK_BBOOL cur_disabled;
+    CK_ULONG cur;
+    int i;
+
+    for (i = 0; i < WAIT_MSECS; i++) {
+        pthread_mutex_lock(&pools->mutex);
+        cur = pool->count;
+        cur_disabled = pool->disabled;
+        pthread_mutex_unlock(&pools->mutex);
+        if (cur == count && cur_disabled == disabled)
+            return 0;
+        nanosleep(&ts, NULL);
+    }
+
+    fprintf(stderr, "Pool has %lu keys and is %s, expected %lu keys\n",
+            cur, cur_disabled ? "disabled" : "enabled", count);
+    return -1;
+}
+
+static int take_keys(struct soft_keygen_pools *pools, const CK_BYTE *publ_exp,
+                     CK_ULONG publ_exp_len, int num, CK_BBOOL expect_key)
+{
+    EVP_PKEY *pkey;
+    int i;
+
+    for (i = 0; i < num; i++) {
+        pkey = soft_keygen_pool_take_rsa(pools, POOL_MOD_BITS, publ_exp,
+                                         publ_exp_len);
+        if ((pkey != NULL) != expect_key) {
+            fprintf(stderr, "Take %d: %s\n", i, expect_key ?
+                    "no key taken from a filled pool" : "unexpected key");
+            EVP_PKEY_free(pkey);
+            return -1;
+        }
+        EVP_PKEY_free(pkey);
+    }
+
+    return 0;
+}
+
+static int check_counters(const char *what, stat_keypool_t *stats,
+                          struct soft_keygen_pool *pool,
+                          CK_ULONG generated, CK_ULONG hits, CK_ULONG misses)
+{
+    CK_ULONG pool_generated, pool_hits, pool_misses;
+
+    pool_generated = __sync_add_and_fetch(&pool->generated, 0);
+    pool_hits = __sync_add_and_fetch(&pool->hits, 0);
+    pool_misses = __sync_add_and_fetch(&pool->misses, 0);
+
+    if (pool_generated != generated || pool_hits != hits ||
+        pool_misses != misses) {
+        fprintf(stderr, "%s: pool counters %lu/%lu/%lu, expected "
+                "%lu/%lu/%lu\n", what, pool_generated, pool_hits,
+                pool_misses, generated, hits, misses);
+        return -1;
+    }
+
+    if (stats->generated != generated || stats->hits != hits ||
+        stats->misses != misses) {
+        fprintf(stderr, "%s: SHM counters %lu/%lu/%lu, expected "
+                "%lu/%lu/%lu\n", what, stats->generated, stats->hits,
+                stats->misses, generated, hits, misses);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* A token without statistics: the pool works without counting anything */
+static int test_no_statistics(void)
+{
+    CK_BYTE publ_exp[] = { 0x01, 0x00, 0x01 };
+    struct soft_keygen_pools pools;
+    struct soft_keygen_pool *pool;
+    STDLL_TokData_t tokdata;
+    int rc = -1;
+
+    memset(&tokdata, 0, sizeof(tokdata));
+    memset(&pools, 0, sizeof(pools));
+    tokdata.slot_id = 100000 + getpid();
+
+    pool = new_rsa_pool(POOL_MOD_BITS, POOL_PUBL_EXP);
+    if (pool == NULL) {
+        fprintf(stderr, "Failed to allocate the pool\n");
+        return -1;
+    }
+    pools.pools = pool;
+
+    if (soft_keygen_pools_start(&tokdata, &pools) != CKR_OK) {
+        fprintf(stderr, "soft_keygen_pools_start without statistics failed\n");
+        goto out;
+    }
+
+    if (pools.stats_shm != NULL || pool->stats != NULL) {
+        fprintf(stderr, "Key pool statistics SHM set up without statistics\n");
+        goto out;
+    }
+
+    if (wait_for_pool(&pools, pool, POOL_DEPTH, FALSE) != 0)
+        goto out;
+    if (take_keys(&pools, publ_exp, sizeof(publ_exp), 1, TRUE) != 0)
+        goto out;
+    if (wait_for_pool(&pools, pool, POOL_DEPTH, FALSE) != 0)
+        goto out;
+
+    rc = 0;
+
+out:
+    soft_keygen_pools_stop(&pools, FALSE);
+    return rc;
+}
+
+int main(void)
+{
+    CK_BYTE publ_exp[] = { 0x01, 0x00, 0x01 };
+    CK_BYTE other_exp[] = { 0x03 };
+    struct soft_keygen_pools pools;
+    struct soft_keygen_pool *pool;
+    struct statistics statistics;
+    STDLL_TokData_t tokdata;
+    char shm_name[PATH_MAX];
+    stat_keypool_t *shm = MAP_FAILED, *stats;
+    int ret = TEST_FAIL, fd;
+    long idx;
+
+    ex_data_idx = EVP_PKEY_get_ex_new_index(0, NULL, NULL, NULL,
+                                            stub_pkey_ex_free);
+    if (ex_data_idx < 0) {
+        fprintf(stderr, "EVP_PKEY_get_ex_new_index failed\n");
+        return TEST_FAIL;
+    }
+
+    memset(&tokdata, 0, sizeof(tokdata));
+    memset(&statistics, 0, sizeof(statistics));
+    memset(&pools, 0, sizeof(pools));
+
+    statistics.increment_func = stub_increment;
+    statistics.flags = STATISTICS_FLAG_COUNT_INTERNAL;
+    tokdata.statistics = &statistics;
+    /* Use a slot number that no real token uses */
+    tokdata.slot_id = 100000 + getpid();
+
+    make_stats_shm_name(tokdata.slot_id, shm_name, sizeof(shm_name));
+    shm_unlink(shm_name);
+
+    pool = new_rsa_pool(POOL_MOD_BITS, POOL_PUBL_EXP);
+    if (pool == NULL) {
+        fprintf(stderr, "Failed to allocate the pool\n");
+        return TEST_FAIL;
+    }
+    pools.pools = pool;
+
+    if (soft_keygen_pools_start(&tokdata, &pools) != CKR_OK) {
+        fprintf(stderr, "soft_keygen_pools_start failed\n");
+        goto out;
+    }
+
+    if (pools.stats_shm == NULL || pool->stats == NULL) {
+        fprintf(stderr, "Key pool statistics SHM not set up\n");
+        goto out;
+    }
+
+    /* Map the segment independently, as pkcsstats does */
+    fd = shm_open(shm_name, O_RDONLY, 0);
+    if (fd == -1) {
+        fprintf(stderr, "Key pool statistics SHM '%s' not found\n", shm_name);
+        goto out;
+    }
+    shm = mmap(NULL, STAT_KEYPOOL_SHM_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        fprintf(stderr, "Failed to map the key pool statistics SHM\n");
+        goto out;
+    }
+    idx = pool->stats - pools.stats_shm;
+    stats = &shm[idx];
+    if (stats->id == 0 || strcmp(stats->name, "RSA 2048 65537") != 0) {
+        fprintf(stderr, "Wrong key pool statistics entry: '%.*s'\n",
+                STAT_KEYPOOL_NAME_LEN, stats->name);
+        goto out;
+    }
+
+    /* Refill: the thread fills the pool up to its depth */
+    if (wait_for_pool(&pools, pool, POOL_DEPTH, FALSE) != 0)
+        goto out;
+    if (check_counters("refill", stats, pool, POOL_DEPTH, 0, 0) != 0)
+        goto out;
+    if (mech_increments != POOL_DEPTH) {
+        fprintf(stderr, "Mechanism counter %lu, expected %u\n",
+                mech_increments, POOL_DEPTH);
+        goto out;
+    }
+
+    /* Hit: a matching take returns a key, and the pool is refilled */
+    if (take_keys(&pools, publ_exp, sizeof(publ_exp), 1, TRUE) != 0)
+        goto out;
+    if (wait_for_pool(&pools, pool, POOL_DEPTH, FALSE) != 0)
+        goto out;
+    if (check_counters("hit", stats, pool, POOL_DEPTH + 1, 1, 0) != 0)
+        goto out;
+
+    /* Parameters without a pool are neither a hit nor a miss */
+    if (take_keys(&pools, other_exp, sizeof(other_exp), 1, FALSE) != 0)
+        goto out;
+    if (check_counters("no pool", stats, pool, POOL_DEPTH + 1, 1, 0) != 0)
+        goto out;
+
+    /* Miss: drain the pool while the key generation fails */
+    fail_keygen = TRUE;
+    if (take_keys(&pools, publ_exp, sizeof(publ_exp), POOL_DEPTH, TRUE) != 0)
+        goto out;
+    if (take_keys(&pools, publ_exp, sizeof(publ_exp), 1, FALSE) != 0)
+        goto out;
+    if (wait_for_pool(&pools, pool, 0, TRUE) != 0)
+        goto out;
+    if (check_counters("miss", stats, pool, POOL_DEPTH + 1, POOL_DEPTH + 1,
+                       1) != 0)
+        goto out;
+
+    /* Refill again, so that the shutdown has keys to free */
+    pthread_mutex_lock(&pools.mutex);
+    fail_keygen = FALSE;
+    pool->disabled = FALSE;
+    pthread_cond_signal(&pools.cond);
+    pthread_mutex_unlock(&pools.mutex);
+    if (wait_for_pool(&pools, pool, POOL_DEPTH, FALSE) != 0)
+        goto out;
+
+    ret = TEST_PASS;
+
+out:
+    /* Shutdown: the thread is stopped and all pooled keys are freed */
+    soft_keygen_pools_stop(&pools, FALSE);
+
+    if (pools.pools != NULL || pools.stats_shm != NULL ||
+        pools.thread_started) {
+        fprintf(stderr, "Pools not cleaned up on shutdown\n");
+        ret = TEST_FAIL;
+    }
+
+    if (ret == TEST_PASS && test_no_statistics() != 0)
+        ret = TEST_FAIL;
+    if (keys_freed != keys_generated) {
+        fprintf(stderr, "Generated %lu keys, but freed %lu\n",
+                keys_generated, keys_freed);
+        ret = TEST_FAIL;
+    }
+
+    if (shm != MAP_FAILED)
+        munmap(shm, STAT_KEYPOOL_SHM_SIZE);
+    shm_unlink(shm_name);
+
+    printf("Key pool test %s\n", ret == TEST_PASS ? "passed" : "failed");
+    return ret;
+}
@@ -0,0 +1,235 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Checks that the HSM-MK-change lock excludes readers while a writer holds
+ * it, and compares the reader throughput of the lock against a plain shared
+ * pthread rwlock for an increasing number of threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "hsm_mk_change_lock.h"
+#include "unittest.h"
+
+#define MAX_THREADS         16
+#define CHECK_SECONDS       1
+#define BENCH_MSECS         250
+#define WRITER_SLEEP_US     1000
+
+static STDLL_TokData_t *tokdata;
+static volatile int stop;
+static volatile int writer_active;
+static volatile unsigned long readers_inside;
+static volatile unsigned long errors;
+
+struct bench_thread {
+    pthread_t thread;
+    int use_rwlock;
+    unsigned long ops;
+};
+
+static void *check_reader(void *arg)
+{
+    int shard;
+
+    (void)arg;
+
+    while (!stop) {
+        if (hsm_mk_change_lock_shared(tokdata, &shard) != CKR_OK) {
+            __sync_add_and_fetch(&errors, 1);
+            break;
+        }
+
+        __sync_add_and_fetch(&readers_inside, 1);
+        if (writer_active) {
+            fprintf(stderr, "reader inside while writer holds the lock\n");
+            __sync_add_and_fetch(&errors, 1);
+        }
+        __sync_sub_and_fetch(&readers_inside, 1);
+
+        if (hsm_mk_change_unlock_shared(tokdata, shard) != CKR_OK) {
+            __sync_add_and_fetch(&errors, 1);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static void *check_writer(void *arg)
+{
+    unsigned long *count = arg;
+
+    while (!stop) {
+        if (hsm_mk_change_lock_exclusive(tokdata) != CKR_OK) {
+            __sync_add_and_fetch(&errors, 1);
+            break;
+        }
+
+        writer_active = 1;
+        __sync_synchronize();
+        if (readers_inside != 0) {
+            fprintf(stderr, "writer got the lock with %lu readers inside\n",
+                    readers_inside);
+            __sync_add_and_fetch(&errors, 1);
+        }
+        usleep(WRITER_SLEEP_US);
+        writer_active = 0;
+        __sync_synchronize();
+
+        if (hsm_mk_change_unlock_exclusive(tokdata) != CKR_OK) {
+            __sync_add_and_fetch(&errors, 1);
+            break;
+        }
+
+        (*count)++;
+        usleep(WRITER_SLEEP_US);
+    }
+
+    return NULL;
+}
+
+static void *bench_reader(void *arg)
+{
+    struct bench_thread *bt = arg;
+    int shard;
+
+    while (!stop) {
+        if (bt->use_rwlock) {
+            pthread_rwlock_rdlock(&tokdata->hsm_mk_change_rwlock);
+            pthread_rwlock_unlock(&tokdata->hsm_mk_change_rwlock);
+        } else {
+            hsm_mk_change_lock_shared(tokdata, &shard);
+            hsm_mk_change_unlock_shared(tokdata, shard);
+        }
+        bt->ops++;
+    }
+
+    return NULL;
+}
+
+static int run_check(unsigned int num_threads)
+{
+    pthread_t readers[MAX_THREADS], writer;
+    unsigned long writes = 0;
+    unsigned int i;
+
+    stop = 0;
+    for (i = 0; i < num_threads; i++) {
+        if (pthread_create(&readers[i], NULL, check_reader, NULL) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            return -1;
+        }
+    }
+    if (pthread_create(&writer, NULL, check_writer, &writes) != 0) {
+        fprintf(stderr, "pthread_create failed\n");
+        return -1;
+    }
+
+    sleep(CHECK_SECONDS);
+    stop = 1;
+
+    for (i = 0; i < num_threads; i++)
+        pthread_join(readers[i], NULL);
+    pthread_join(writer, NULL);
+
+    printf("check: %u readers, %lu writer cycles, %lu errors\n",
+           num_threads, writes, errors);
+
+    if (writes == 0) {
+        fprintf(stderr, "writer never got the lock\n");
+        return -1;
+    }
+
+    return errors ? -1 : 0;
+}
+
+static double run_bench(unsigned int num_threads, int use_rwlock)
+{
+    struct bench_thread threads[MAX_THREADS];
+    struct timespec ts = { BENCH_MSECS / 1000,
+                           (BENCH_MSECS % 1000) * 1000000L };
+    unsigned long ops = 0;
+    unsigned int i;
+
+    memset(threads, 0, sizeof(threads));
+    stop = 0;
+    for (i = 0; i < num_threads; i++) {
+        threads[i].use_rwlock = use_rwlock;
+        if (pthread_create(&threads[i].thread, NULL, bench_reader,
+                           &threads[i]) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            return -1;
+        }
+    }
+
+    nanosleep(&ts, NULL);
+    stop = 1;
+
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        ops += threads[i].ops;
+    }
+
+    return (double)ops / BENCH_MSECS / 1000.0;
+}
+
+int main(void)
+{
+    unsigned int num_threads, max_threads;
+    double rwlock_mops, gate_mops;
+    long ncpus;
+    int rc = TEST_PASS;
+
+    tokdata = calloc(1, sizeof(*tokdata));
+    if (tokdata == NULL) {
+        fprintf(stderr, "calloc failed\n");
+        return TEST_FAIL;
+    }
+    if (pthread_rwlock_init(&tokdata->hsm_mk_change_rwlock, NULL) != 0) {
+        fprintf(stderr, "pthread_rwlock_init failed\n");
+        free(tokdata);
+        return TEST_FAIL;
+    }
+    tokdata->hsm_mk_change_supported = TRUE;
+
+    ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    max_threads = (ncpus > 1 && ncpus < MAX_THREADS) ? ncpus : MAX_THREADS;
+    if (ncpus == 1)
+        max_threads = 2;
+
+    if (run_check(max_threads) != 0)
+        rc = TEST_FAIL;
+
+    printf("threads  rwlock [Mops/s]  mk-change lock [Mops/s]\n");
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        rwlock_mops = run_bench(num_threads, 1);
+        gate_mops = run_bench(num_threads, 0);
+        if (rwlock_mops < 0 || gate_mops < 0) {
+            rc = TEST_FAIL;
+            break;
+        }
+        printf("%7u  %15.2f  %23.2f\n", num_threads, rwlock_mops, gate_mops);
+    }
+
+    pthread_rwlock_destroy(&tokdata->hsm_mk_change_rwlock);
+    free(tokdata);
+
+    return rc;
+}
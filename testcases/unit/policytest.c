@@ -9,9 +9,12 @@
  */
 #include "policy.h"
 #include "ec_defs.h"
+#include "mechtable.h"
 #include "unittest.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <openssl/obj_mac.h>
 
 #define UNUSED(var)            ((void)(var))
@@ -143,6 +146,9 @@ extern CK_RV policy_load_policy_cfg(struct policy_private *pp,
 extern struct policy_private *policy_private_alloc(void);
 extern struct policy_private *policy_private_free(struct policy_private *pp);
 extern void policy_private_deactivate(struct policy_private *pp);
+extern CK_RV policy_is_mech_allowed_i(struct policy_private *pp,
+                                      CK_MECHANISM_PTR mech,
+                                      struct objstrength *s, int check);
 
 struct keytest {
     CK_ULONG keytype;
@@ -981,10 +987,243 @@ static int runstrengthtests(void)
     return runstrengthdettests() | runstrengthenforcetests();
 }
 
+union cacheparams {
+    CK_RSA_PKCS_PSS_PARAMS pss;
+    CK_RSA_PKCS_OAEP_PARAMS oaep;
+    CK_ECDH1_DERIVE_PARAMS ecdh;
+    CK_IBM_ECDSA_OTHER_PARAMS ecdsaother;
+    CK_IBM_BTC_DERIVE_PARAMS btc;
+    CK_IBM_KYBER_PARAMS kyber;
+    CK_MAC_GENERAL_PARAMS macgeneral;
+};
+
+/*
+ * Set up one of four parameter variants for the mechanism in a table row:
+ * two valid ones, an all zero one and a missing one with a length.
+ */
+static void setcacheparams(CK_MECHANISM *mech, const struct mechrow *row,
+                           union cacheparams *params, int variant)
+{
+    memset(params, 0, sizeof(*params));
+    mech->mechanism = row->numeric;
+    mech->pParameter = params;
+    switch (row->numeric) {
+    case CKM_RSA_PKCS_PSS:
+    case CKM_SHA1_RSA_PKCS_PSS:
+    case CKM_SHA224_RSA_PKCS_PSS:
+    case CKM_SHA256_RSA_PKCS_PSS:
+    case CKM_SHA384_RSA_PKCS_PSS:
+    case CKM_SHA512_RSA_PKCS_PSS:
+    case CKM_SHA3_224_RSA_PKCS_PSS:
+    case CKM_SHA3_256_RSA_PKCS_PSS:
+    case CKM_SHA3_384_RSA_PKCS_PSS:
+    case CKM_SHA3_512_RSA_PKCS_PSS:
+        params->pss.hashAlg = variant ? CKM_SHA_1 : CKM_SHA512;
+        params->pss.mgf = variant ? CKG_MGF1_SHA1 : CKG_MGF1_SHA512;
+        mech->ulParameterLen = sizeof(params->pss);
+        break;
+    case CKM_RSA_PKCS_OAEP:
+        params->oaep.hashAlg = variant ? CKM_SHA_1 : CKM_SHA512;
+        params->oaep.mgf = variant ? CKG_MGF1_SHA1 : CKG_MGF1_SHA512;
+        mech->ulParameterLen = sizeof(params->oaep);
+        break;
+    case CKM_ECDH1_DERIVE:
+        params->ecdh.kdf = variant ? CKD_SHA1_KDF : CKD_SHA256_KDF;
+        mech->ulParameterLen = sizeof(params->ecdh);
+        break;
+    case CKM_IBM_ECDSA_OTHER:
+        params->ecdsaother.submechanism = variant ? CKM_IBM_ECSDSA_RAND :
+                                                    CKM_SHA256;
+        mech->ulParameterLen = sizeof(params->ecdsaother);
+        break;
+    case CKM_IBM_BTC_DERIVE:
+        params->btc.version = CK_IBM_BTC_DERIVE_PARAMS_VERSION_1;
+        params->btc.type = variant ? CK_IBM_BTC_BIP0032_PRV2PRV : 0;
+        mech->ulParameterLen = sizeof(params->btc);
+        break;
+    case CKM_IBM_KYBER:
+        params->kyber.kdf = variant ? CKD_SHA1_KDF : CKD_SHA512_KDF;
+        mech->ulParameterLen = sizeof(params->kyber);
+        break;
+    default:
+        if (row->flags & MCF_MAC_GENERAL) {
+            params->macgeneral = variant ? 4 : 16;
+            mech->ulParameterLen = sizeof(params->macgeneral);
+        } else {
+            mech->pParameter = NULL;
+            mech->ulParameterLen = 0;
+        }
+        break;
+    }
+
+    if (variant == 2)
+        memset(params, 0, sizeof(*params));
+    else if (variant == 3)
+        mech->pParameter = NULL;
+}
+
+/*
+ * Compare cached verdicts with uncached ones for all mechanisms in the
+ * mechanism table.  Each policy is loaded into a new policy_private, which
+ * may well reuse the memory of the previous one, so stale verdicts of an
+ * earlier policy would show up here.
+ */
+static int runpolicycachetests(void)
+{
+    static const struct {
+        const char *policy;
+        size_t policylen;
+    } policies[] = {
+        { policyempty, sizeof(policyempty) },
+        { policystrength128, sizeof(policystrength128) },
+        { policystrength256, sizeof(policystrength256) },
+        { policynomechs, sizeof(policynomechs) },
+        { policyfixedmechs, sizeof(policyfixedmechs) },
+        { policymgfoneeach, sizeof(policymgfoneeach) },
+        { policykdfnosha1, sizeof(policykdfnosha1) },
+    };
+    static const CK_ULONG siglens[] = { 0, 256, 3072 };
+    struct objstrength strength, *s;
+    union cacheparams params;
+    struct policy_private *pp;
+    CK_MECHANISM mech;
+    struct policy p;
+    unsigned int o, i, l, r;
+    int check, variant, res = 0;
+    CK_RV rc1, rc2, exprc;
+
+    fprintf(stderr, "Running policycachetests\n");
+    policy_init_policy(&p);
+    strength.allowed = CK_TRUE;
+    for (o = 0; o < ARRAYSIZE(policies); ++o) {
+        pp = policy_private_alloc();
+        if (pp == NULL) {
+            fprintf(stderr, "Test %u: Failed to allocate policy_private\n", o);
+            return -1;
+        }
+        p.priv = pp;
+        if (test_load_strength_cfg(pp, (void *)niststrength,
+                                   sizeof(niststrength)) ||
+            test_load_policy_cfg(pp, (void *)policies[o].policy,
+                                 policies[o].policylen)) {
+            policy_private_free(pp);
+            fprintf(stderr, "Test %u: Failed to load configuration\n", o);
+            return -1;
+        }
+        for (i = STRENGTH_256; i <= STRENGTH_0; ++i) {
+            strength.strength = i;
+            for (l = 0; l < ARRAYSIZE(siglens); ++l) {
+                strength.siglen = siglens[l];
+                for (check = POLICY_CHECK_DIGEST;
+                     check <= POLICY_CHECK_UNWRAP; ++check) {
+                    s = check == POLICY_CHECK_DIGEST ? NULL : &strength;
+                    for (r = 0; r < MECHTABLE_NUM_ELEMS; ++r) {
+                        for (variant = 0; variant < 4; ++variant) {
+                            setcacheparams(&mech, &mechtable_rows[r], &params,
+                                           variant);
+                            /* First call may fill, second may hit */
+                            rc1 = p.is_mech_allowed(&p, &mech, s, check, NULL);
+                            rc2 = p.is_mech_allowed(&p, &mech, s, check, NULL);
+                            exprc = policy_is_mech_allowed_i(pp, &mech, s,
+                                                             check);
+                            if (rc1 != exprc || rc2 != exprc) {
+                                fprintf(stderr,
+                                        "Test %u: %s, strength %u, siglen %lu, check %d, variant %d: cached 0x%lx/0x%lx, uncached 0x%lx\n",
+                                        o, mechtable_rows[r].string, i,
+                                        siglens[l], check, variant, rc1, rc2,
+                                        exprc);
+                                res = -1;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        p.priv = policy_private_free(pp);
+    }
+    return res;
+}
+
+#define POLICYBENCHNUM 1000000
+
+static double elapsed_ns(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e9 +
+           (now.tv_nsec - start->tv_nsec);
+}
+
+/* Mechanism check latency of a PSS signature init */
+static int runpolicycachebench(void)
+{
+    CK_RSA_PKCS_PSS_PARAMS pssparams = {
+        CKM_SHA256, CKG_MGF1_SHA256, 32
+    };
+    CK_MECHANISM mech = {
+        CKM_SHA256_RSA_PKCS_PSS, &pssparams, sizeof(pssparams)
+    };
+    struct objstrength strength = { STRENGTH_128, 3072, CK_TRUE };
+    struct policy_private *pp;
+    struct timespec start;
+    double disabled, uncached, cached;
+    struct policy p;
+    CK_RV rc = CKR_OK;
+    int i;
+
+    fprintf(stderr, "Running policycachebench\n");
+    policy_init_policy(&p);
+    pp = policy_private_alloc();
+    if (pp == NULL) {
+        fprintf(stderr, "Failed to allocate policy_private\n");
+        return -1;
+    }
+    if (test_load_strength_cfg(pp, (void *)niststrength,
+                               sizeof(niststrength)) ||
+        test_load_policy_cfg(pp, (void *)policystrength128,
+                             sizeof(policystrength128))) {
+        policy_private_free(pp);
+        fprintf(stderr, "Failed to load configuration\n");
+        return -1;
+    }
+
+    p.priv = NULL;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < POLICYBENCHNUM; ++i)
+        rc |= p.is_mech_allowed(&p, &mech, &strength, POLICY_CHECK_SIGNATURE,
+                                NULL);
+    disabled = elapsed_ns(&start) / POLICYBENCHNUM;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < POLICYBENCHNUM; ++i)
+        rc |= policy_is_mech_allowed_i(pp, &mech, &strength,
+                                       POLICY_CHECK_SIGNATURE);
+    uncached = elapsed_ns(&start) / POLICYBENCHNUM;
+
+    p.priv = pp;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < POLICYBENCHNUM; ++i)
+        rc |= p.is_mech_allowed(&p, &mech, &strength, POLICY_CHECK_SIGNATURE,
+                                NULL);
+    cached = elapsed_ns(&start) / POLICYBENCHNUM;
+
+    p.priv = policy_private_free(pp);
+    if (rc != CKR_OK) {
+        fprintf(stderr, "Mechanism not allowed: 0x%lx\n", rc);
+        return -1;
+    }
+    fprintf(stderr, "  policy disabled: %6.1f ns\n", disabled);
+    fprintf(stderr, "  policy uncached: %6.1f ns\n", uncached);
+    fprintf(stderr, "  policy cached:   %6.1f ns\n", cached);
+    return 0;
+}
+
 static int runpolicytests(void)
 {
     return runpolicyenforcetests() | runpolicyhashtests() |
-        runpolicydeepchecktests();
+        runpolicydeepchecktests() | runpolicycachetests() |
+        runpolicycachebench();
 }
 
 int main(void)
@@ -0,0 +1,231 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include "pkcs11types.h"
+#include "sw_crypt.h"
+#include "unittest.h"
+
+#define MAX_DATA_LEN    4096
+#define BATCH_COUNT     333
+
+struct digest {
+    CK_MECHANISM_TYPE mech;
+    const char *name;
+    int sha2;
+};
+
+static const struct digest digests[] = {
+    { CKM_SHA_1, "SHA1", 0 },
+    { CKM_SHA224, "SHA224", 1 },
+    { CKM_SHA256, "SHA256", 1 },
+    { CKM_SHA384, "SHA384", 1 },
+    { CKM_SHA512, "SHA512", 1 },
+    { CKM_SHA512_224, "SHA512-224", 1 },
+    { CKM_SHA512_256, "SHA512-256", 1 },
+    { CKM_SHA3_224, "SHA3-224", 0 },
+    { CKM_SHA3_256, "SHA3-256", 0 },
+    { CKM_SHA3_384, "SHA3-384", 0 },
+    { CKM_SHA3_512, "SHA3-512", 0 },
+};
+
+static CK_BYTE data[MAX_DATA_LEN];
+
+/*
+ * Digests the data in random pieces. The state is copied to a new context
+ * after each piece, like a C_GetOperationState/C_SetOperationState does.
+ */
+static int sw_digest(const struct digest *d, CK_ULONG len, CK_BYTE *out)
+{
+    SW_SHA_CTX ctx, saved;
+    CK_ULONG done = 0, n;
+
+    if (sw_sha_init(&ctx, d->mech) != CKR_OK)
+        return -1;
+
+    while (done < len) {
+        n = 1 + random() % (len - done);
+        if (sw_sha_update(&ctx, data + done, n) != CKR_OK)
+            return -1;
+        done += n;
+
+        memcpy(&saved, &ctx, sizeof(saved));
+        memset(&ctx, 0xff, sizeof(ctx));
+        memcpy(&ctx, &saved, sizeof(ctx));
+    }
+
+    return sw_sha_final(&ctx, out) == CKR_OK ? 0 : -1;
+}
+
+static int test_digest(const struct digest *d)
+{
+    CK_BYTE md1[SW_SHA_MAX_DIGEST_SIZE], md2[EVP_MAX_MD_SIZE];
+    unsigned int md2_len;
+    const EVP_MD *md;
+    CK_ULONG len;
+    int errors = 0;
+
+    md = EVP_get_digestbyname(d->name);
+    if (md == NULL) {
+        fprintf(stderr, "%s not available in OpenSSL, skipped\n", d->name);
+        return 0;
+    }
+
+    for (len = 0; len <= MAX_DATA_LEN; len += (len < 300 ? 1 : 97)) {
+        if (sw_digest(d, len, md1) != 0 ||
+            EVP_Digest(data, len, md2, &md2_len, md, NULL) != 1 ||
+            memcmp(md1, md2, md2_len) != 0) {
+            fprintf(stderr, "%s of %lu bytes differs\n", d->name, len);
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+static int test_hmac(const struct digest *d)
+{
+    CK_BYTE mac1[SW_SHA_MAX_DIGEST_SIZE], mac2[EVP_MAX_MD_SIZE];
+    CK_ULONG key_lens[] = { 0, 16, 32, 64, 72, 136, 144, 200 };
+    unsigned int mac2_len;
+    SW_HMAC_CTX ctx;
+    const EVP_MD *md;
+    CK_ULONG i, len;
+    int errors = 0;
+
+    md = EVP_get_digestbyname(d->name);
+    if (md == NULL)
+        return 0;
+
+    for (i = 0; i < ARRAYSIZE(key_lens); i++) {
+        len = random() % MAX_DATA_LEN;
+
+        if (sw_hmac_init(&ctx, d->mech, data + 1000, key_lens[i]) != CKR_OK ||
+            sw_hmac_update(&ctx, data, len / 3) != CKR_OK ||
+            sw_hmac_update(&ctx, data + len / 3, len - len / 3) != CKR_OK ||
+            sw_hmac_final(&ctx, mac1) != CKR_OK ||
+            HMAC(md, data + 1000, key_lens[i], data, len, mac2,
+                 &mac2_len) == NULL ||
+            memcmp(mac1, mac2, mac2_len) != 0) {
+            fprintf(stderr, "HMAC-%s with a %lu byte key differs\n", d->name,
+                    key_lens[i]);
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+/*
+ * Digests a batch of messages of random lengths, so that the lanes finish
+ * their messages at different blocks, and compares with OpenSSL.
+ */
+static int test_batch(const struct digest *d)
+{
+    CK_BYTE *msgs[BATCH_COUNT], *mds[BATCH_COUNT];
+    CK_BYTE md[EVP_MAX_MD_SIZE];
+    CK_BYTE out[BATCH_COUNT][SW_SHA_MAX_DIGEST_SIZE];
+    CK_ULONG lens[BATCH_COUNT], i;
+    unsigned int md_len;
+    const EVP_MD *evp_md;
+    CK_RV rc;
+    int errors = 0;
+
+    for (i = 0; i < BATCH_COUNT; i++) {
+        lens[i] = (i < 300) ? i : (CK_ULONG)(random() % MAX_DATA_LEN);
+        msgs[i] = data + random() % (MAX_DATA_LEN - lens[i] + 1);
+        mds[i] = out[i];
+    }
+
+    rc = sw_sha_batch(d->mech, BATCH_COUNT, msgs, lens, mds);
+    if (!d->sha2) {
+        /* Only SHA-2 is supported */
+        if (rc != CKR_MECHANISM_INVALID) {
+            fprintf(stderr, "%s batch not rejected\n", d->name);
+            return 1;
+        }
+        return 0;
+    }
+    if (rc != CKR_OK) {
+        fprintf(stderr, "%s batch failed\n", d->name);
+        return 1;
+    }
+
+    evp_md = EVP_get_digestbyname(d->name);
+    if (evp_md == NULL)
+        return 0;
+
+    for (i = 0; i < BATCH_COUNT; i++) {
+        if (EVP_Digest(msgs[i], lens[i], md, &md_len, evp_md, NULL) != 1 ||
+            memcmp(out[i], md, md_len) != 0) {
+            fprintf(stderr, "%s batch message %lu of %lu bytes differs\n",
+                    d->name, i, lens[i]);
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+static int test_invalid_state(void)
+{
+    SW_SHA_CTX ctx;
+    CK_BYTE md[SW_SHA_MAX_DIGEST_SIZE];
+    int errors = 0;
+
+    sw_sha_init(&ctx, CKM_SHA3_256);
+    ctx.buf_len = ctx.block_size;
+    if (sw_sha_update(&ctx, data, 1) != CKR_SAVED_STATE_INVALID)
+        errors++;
+
+    sw_sha_init(&ctx, CKM_SHA3_256);
+    ctx.digest_len = 0;
+    ctx.block_size = 200;
+    if (sw_sha_final(&ctx, md) != CKR_SAVED_STATE_INVALID)
+        errors++;
+
+    if (sw_sha_init(&ctx, CKM_MD5) != CKR_MECHANISM_INVALID)
+        errors++;
+
+    if (errors)
+        fprintf(stderr, "invalid state not detected\n");
+
+    return errors;
+}
+
+int main(void)
+{
+    CK_ULONG i;
+    int errors = 0;
+
+    srandom(1);
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = random();
+
+    for (i = 0; i < ARRAYSIZE(digests); i++) {
+        errors += test_digest(&digests[i]);
+        errors += test_hmac(&digests[i]);
+        errors += test_batch(&digests[i]);
+    }
+    errors += test_invalid_state();
+
+    if (errors) {
+        fprintf(stderr, "%d errors\n", errors);
+        return TEST_FAIL;
+    }
+
+    printf("All software digest tests passed\n");
+    return TEST_PASS;
+}
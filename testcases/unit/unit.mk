@@ -1,12 +1,16 @@
 check_PROGRAMS = testcases/unit/policytest testcases/unit/hashmaptest	\
 	testcases/unit/mechtabletest testcases/unit/configdump		\
 	testcases/unit/buffertest testcases/unit/uritest		\
-	testcases/unit/pintest
+	testcases/unit/pintest testcases/unit/btreetest		\
+	testcases/unit/mkchangelocktest testcases/unit/swshatest	\
+	testcases/unit/asn1test testcases/unit/keygenpooltest
 
 TESTS = testcases/unit/policytest testcases/unit/hashmaptest		\
 	testcases/unit/mechtabletest testcases/unit/configdump		\
 	testcases/unit/buffertest testcases/unit/uritest		\
-	testcases/unit/pintest.sh
+	testcases/unit/pintest.sh testcases/unit/btreetest		\
+	testcases/unit/mkchangelocktest testcases/unit/swshatest	\
+	testcases/unit/asn1test testcases/unit/keygenpooltest
 
 EXTRA_DIST += testcases/unit/pintest.sh
 noinst_HEADERS += testcases/unit/unittest.h
@@ -84,3 +88,48 @@ testcases_unit_pintest_SOURCES=testcases/unit/pintest.c		\
 testcases_unit_pintest_CFLAGS=-I${top_srcdir}/usr/lib/common \
 	-I${top_srcdir}/usr/include
 testcases_unit_pintest_LDFLAGS=-lcrypto
+
+testcases_unit_btreetest_SOURCES=testcases/unit/btreetest.c		\
+	usr/lib/common/btree.c usr/lib/common/trace.c
+
+testcases_unit_btreetest_CFLAGS=-I${top_srcdir}/usr/lib/common	\
+	-I${top_srcdir}/usr/include -I${top_builddir}/usr/lib/api	\
+	-I${top_srcdir}/usr/lib/api -DSTDLL_NAME=\"btreetest\"
+testcases_unit_btreetest_LDFLAGS=-lpthread
+
+testcases_unit_mkchangelocktest_SOURCES=testcases/unit/mkchangelocktest.c	\
+	usr/lib/common/hsm_mk_change_lock.c
+
+testcases_unit_mkchangelocktest_CFLAGS=-I${top_srcdir}/usr/lib/common	\
+	-I${top_srcdir}/usr/include -I${top_builddir}/usr/lib/api	\
+	-I${top_srcdir}/usr/lib/api
+testcases_unit_mkchangelocktest_LDFLAGS=-lpthread
+
+testcases_unit_swshatest_SOURCES=testcases/unit/swshatest.c		\
+	usr/lib/common/sw_sha.c
+
+testcases_unit_swshatest_CFLAGS=-I${top_srcdir}/usr/lib/common	\
+	-I${top_srcdir}/usr/include
+testcases_unit_swshatest_LDFLAGS=-lcrypto
+
+testcases_unit_asn1test_SOURCES=testcases/unit/asn1test.c		\
+	usr/lib/common/asn1.c usr/lib/common/globals.c			\
+	usr/lib/common/trace.c usr/lib/common/pqc_supported.c
+
+testcases_unit_asn1test_CFLAGS=-I${top_srcdir}/usr/lib/common	\
+	-I${top_srcdir}/usr/include -I${top_builddir}/usr/lib/api	\
+	-I${top_srcdir}/usr/lib/api -DSTDLL_NAME=\"asn1test\"
+testcases_unit_asn1test_LDFLAGS=-llber -lcrypto -lpthread
+
+testcases_unit_keygenpooltest_SOURCES=testcases/unit/keygenpooltest.c	\
+	usr/lib/soft_stdll/soft_keygen_pool.c usr/lib/common/trace.c	\
+	usr/lib/common/ec_supported.c usr/lib/common/pqc_supported.c	\
+	usr/lib/config/configuration.c usr/lib/config/cfgparse.y	\
+	usr/lib/config/cfglex.l
+
+testcases_unit_keygenpooltest_CFLAGS=-I${top_srcdir}/usr/lib/common	\
+	-I${top_srcdir}/usr/include -I${top_builddir}/usr/lib/api	\
+	-I${top_srcdir}/usr/lib/api -I${top_srcdir}/usr/lib/soft_stdll	\
+	-I${top_srcdir}/usr/lib/config -I${top_builddir}/usr/lib/config	\
+	-DSTDLL_NAME=\"keygenpooltest\"
+testcases_unit_keygenpooltest_LDFLAGS=-lcrypto -lpthread
@@ -285,6 +285,21 @@ extern "C" {
                                 CK_OBJECT_HANDLE, CK_MECHANISM_PTR,
                                 CK_OBJECT_HANDLE, CK_BYTE_PTR,
                                 CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+
+    CK_RV C_IBM_DigestBatch(CK_SESSION_HANDLE, CK_MECHANISM_PTR, CK_ULONG,
+                            CK_BYTE_PTR *, CK_ULONG_PTR, CK_BYTE_PTR,
+                            CK_ULONG_PTR);
+
+    CK_RV C_IBM_ReencryptBatch(CK_SESSION_HANDLE, CK_MECHANISM_PTR,
+                               CK_OBJECT_HANDLE, CK_MECHANISM_PTR,
+                               CK_OBJECT_HANDLE, CK_ULONG, CK_VOID_PTR *,
+                               CK_VOID_PTR *, CK_BYTE_PTR *, CK_ULONG_PTR,
+                               CK_BYTE_PTR *, CK_ULONG_PTR, CK_RV *);
+
+    CK_RV C_IBM_GetAttributeValueBatch(CK_SESSION_HANDLE, CK_ULONG,
+                                       CK_OBJECT_HANDLE_PTR,
+                                       CK_ATTRIBUTE_PTR *, CK_ULONG_PTR,
+                                       CK_RV *);
 #ifdef __cplusplus
 }
 #endif
@@ -14,6 +14,7 @@
 #include <stdll.h>
 #include <slotmgr.h>
 #include <defs.h>
+#include <hsm_mk_change_lock.h>
 
 #ifndef _APILOCAL_H
 #define _APILOCAL_H
@@ -25,9 +26,10 @@
 
 #define BEGIN_HSM_MK_CHANGE_LOCK(sltp, rv)                                  \
         do {                                                                \
+            int _hsm_mk_change_shard = HSM_MK_CHANGE_LOCK_RWLOCK;           \
             if ((sltp)->TokData->hsm_mk_change_supported) {                 \
-                if (pthread_rwlock_rdlock(                                  \
-                            &(sltp)->TokData->hsm_mk_change_rwlock) != 0) { \
+                if (hsm_mk_change_lock_shared((sltp)->TokData,              \
+                                    &_hsm_mk_change_shard) != CKR_OK) {     \
                     TRACE_DEVEL("HSM-MK-change Read-Lock failed.\n");       \
                     (rv) = CKR_CANT_LOCK;                                   \
                     break;                                                  \
@@ -36,8 +38,8 @@
 
 #define END_HSM_MK_CHANGE_LOCK(sltp, rv)                                    \
             if ((sltp)->TokData->hsm_mk_change_supported) {                 \
-                if (pthread_rwlock_unlock(                                  \
-                            &(sltp)->TokData->hsm_mk_change_rwlock) != 0) { \
+                if (hsm_mk_change_unlock_shared((sltp)->TokData,            \
+                                    _hsm_mk_change_shard) != CKR_OK) {      \
                     TRACE_DEVEL("HSM-MK-change Unlock failed.\n");          \
                     if ((rv) == CKR_OK)                                     \
                         (rv) = CKR_CANT_LOCK;                               \
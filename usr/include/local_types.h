@@ -47,6 +47,7 @@ struct btree {
     struct btnode *top;
     unsigned long size;
     unsigned long free_nodes;
+    unsigned long free_gen;     /* incremented whenever a node is free'd */
     pthread_mutex_t mutex;
     void (*delete_func)(void *);
 };
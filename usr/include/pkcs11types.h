@@ -1758,6 +1758,10 @@ typedef struct CK_IBM_FUNCTION_LIST_1_0 CK_IBM_FUNCTION_LIST_1_0;
 typedef struct CK_IBM_FUNCTION_LIST_1_0 CK_PTR CK_IBM_FUNCTION_LIST_1_0_PTR;
 typedef CK_IBM_FUNCTION_LIST_1_0_PTR CK_PTR CK_IBM_FUNCTION_LIST_1_0_PTR_PTR;
 
+typedef struct CK_IBM_FUNCTION_LIST_1_1 CK_IBM_FUNCTION_LIST_1_1;
+typedef struct CK_IBM_FUNCTION_LIST_1_1 CK_PTR CK_IBM_FUNCTION_LIST_1_1_PTR;
+typedef CK_IBM_FUNCTION_LIST_1_1_PTR CK_PTR CK_IBM_FUNCTION_LIST_1_1_PTR_PTR;
+
 typedef CK_RV (CK_PTR CK_C_Initialize) (CK_VOID_PTR pReserved);
 typedef CK_RV (CK_PTR CK_C_Finalize) (CK_VOID_PTR pReserved);
 typedef CK_RV (CK_PTR CK_C_Terminate) (void);
@@ -2121,6 +2125,59 @@ typedef CK_RV (CK_PTR CK_C_IBM_ReencryptSingle) (CK_SESSION_HANDLE hSession,
                                                  CK_ULONG ulEncryptedDataLen,
                                                  CK_BYTE_PTR pReencryptedData,
                                                  CK_ULONG_PTR pulReencryptedDataLen);
+/*
+ * Digests ulCount independent messages with one mechanism. The digests are
+ * returned back to back in pDigests, each with the digest length of the
+ * mechanism. Length queries and CKR_BUFFER_TOO_SMALL work as for C_Digest.
+ */
+typedef CK_RV (CK_PTR CK_C_IBM_DigestBatch) (CK_SESSION_HANDLE hSession,
+                                             CK_MECHANISM_PTR pMechanism,
+                                             CK_ULONG ulCount,
+                                             CK_BYTE_PTR CK_PTR ppData,
+                                             CK_ULONG_PTR pulDataLen,
+                                             CK_BYTE_PTR pDigests,
+                                             CK_ULONG_PTR pulDigestsLen);
+/*
+ * Re-encrypts ulCount independent ciphertexts from hDecrKey to hEncrKey. The
+ * keys and mechanisms are checked once for the whole batch. If ppDecrParams
+ * or ppEncrParams is not NULL, item i uses ppDecrParams[i] or ppEncrParams[i]
+ * (e.g. its own IV) as mechanism parameter instead of pParameter of the
+ * mechanism, with the same ulParameterLen. On input pulReencryptedDataLen[i]
+ * is the size of ppReencryptedData[i], on output the length of its
+ * re-encrypted data. If ppReencryptedData is NULL, only the lengths are
+ * returned. The result of each item is returned in pResults[i]. Errors that
+ * affect the whole batch are returned by the function, otherwise it returns
+ * CKR_OK, even if single items failed.
+ */
+typedef CK_RV (CK_PTR CK_C_IBM_ReencryptBatch) (CK_SESSION_HANDLE hSession,
+                                                CK_MECHANISM_PTR pDecrMech,
+                                                CK_OBJECT_HANDLE hDecrKey,
+                                                CK_MECHANISM_PTR pEncrMech,
+                                                CK_OBJECT_HANDLE hEncrKey,
+                                                CK_ULONG ulCount,
+                                                CK_VOID_PTR CK_PTR ppDecrParams,
+                                                CK_VOID_PTR CK_PTR ppEncrParams,
+                                                CK_BYTE_PTR CK_PTR ppEncryptedData,
+                                                CK_ULONG_PTR pulEncryptedDataLen,
+                                                CK_BYTE_PTR CK_PTR ppReencryptedData,
+                                                CK_ULONG_PTR pulReencryptedDataLen,
+                                                CK_RV CK_PTR pResults);
+/*
+ * Gets the attribute values of ulCount objects. ppTemplates[i] is the
+ * template of object phObjects[i] with pulAttributeCounts[i] attributes, and
+ * is processed as by C_GetAttributeValue. The object lookups and locks are
+ * done once for the whole batch. The result of C_GetAttributeValue for each
+ * object is returned in pResults[i]. Errors that affect the whole batch are
+ * returned by the function, otherwise it returns CKR_OK, even if single
+ * objects failed.
+ */
+typedef CK_RV (CK_PTR CK_C_IBM_GetAttributeValueBatch) (
+                                        CK_SESSION_HANDLE hSession,
+                                        CK_ULONG ulCount,
+                                        CK_OBJECT_HANDLE_PTR phObjects,
+                                        CK_ATTRIBUTE_PTR CK_PTR ppTemplates,
+                                        CK_ULONG_PTR pulAttributeCounts,
+                                        CK_RV CK_PTR pResults);
 
 struct CK_FUNCTION_LIST {
     CK_VERSION version;
@@ -2296,6 +2353,14 @@ struct CK_IBM_FUNCTION_LIST_1_0 {
     CK_C_IBM_ReencryptSingle C_IBM_ReencryptSingle;
 };
 
+struct CK_IBM_FUNCTION_LIST_1_1 {
+    CK_VERSION version;
+    CK_C_IBM_ReencryptSingle C_IBM_ReencryptSingle;
+    CK_C_IBM_DigestBatch C_IBM_DigestBatch;
+    CK_C_IBM_ReencryptBatch C_IBM_ReencryptBatch;
+    CK_C_IBM_GetAttributeValueBatch C_IBM_GetAttributeValueBatch;
+};
+
 #ifdef __cplusplus
 }
 #endif
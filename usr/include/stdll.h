@@ -354,6 +354,39 @@ typedef CK_RV (CK_PTR ST_C_IBM_ReencryptSingle)(STDLL_TokData_t *tokdata,
                                                 CK_BYTE_PTR pReencryptedData,
                                             CK_ULONG_PTR pulReencryptedDataLen);
 
+typedef CK_RV (CK_PTR ST_C_IBM_DigestBatch)(STDLL_TokData_t *tokdata,
+                                            ST_SESSION_T *hSession,
+                                            CK_MECHANISM_PTR pMechanism,
+                                            CK_ULONG ulCount,
+                                            CK_BYTE_PTR *ppData,
+                                            CK_ULONG_PTR pulDataLen,
+                                            CK_BYTE_PTR pDigests,
+                                            CK_ULONG_PTR pulDigestsLen);
+
+typedef CK_RV (CK_PTR ST_C_IBM_ReencryptBatch)(STDLL_TokData_t *tokdata,
+                                               ST_SESSION_T *hSession,
+                                               CK_MECHANISM_PTR pDecrMech,
+                                               CK_OBJECT_HANDLE hDecrKey,
+                                               CK_MECHANISM_PTR pEncrMech,
+                                               CK_OBJECT_HANDLE hEncrKey,
+                                               CK_ULONG ulCount,
+                                               CK_VOID_PTR *ppDecrParams,
+                                               CK_VOID_PTR *ppEncrParams,
+                                               CK_BYTE_PTR *ppEncryptedData,
+                                               CK_ULONG_PTR pulEncryptedDataLen,
+                                               CK_BYTE_PTR *ppReencryptedData,
+                                            CK_ULONG_PTR pulReencryptedDataLen,
+                                               CK_RV *pResults);
+
+typedef CK_RV (CK_PTR ST_C_IBM_GetAttributeValueBatch)(
+                                            STDLL_TokData_t *tokdata,
+                                            ST_SESSION_T *hSession,
+                                            CK_ULONG ulCount,
+                                            CK_OBJECT_HANDLE_PTR phObjects,
+                                            CK_ATTRIBUTE_PTR *ppTemplates,
+                                            CK_ULONG_PTR pulAttributeCounts,
+                                            CK_RV *pResults);
+
 typedef CK_RV (CK_PTR ST_C_HandleEvent)(STDLL_TokData_t *tokdata,
                                         unsigned int event_type,
                                         unsigned int event_flags,
@@ -434,6 +467,9 @@ struct ST_FCN_LIST {
     ST_C_SessionCancel ST_SessionCancel;
 
     ST_C_IBM_ReencryptSingle ST_IBM_ReencryptSingle;
+    ST_C_IBM_DigestBatch ST_IBM_DigestBatch;
+    ST_C_IBM_ReencryptBatch ST_IBM_ReencryptBatch;
+    ST_C_IBM_GetAttributeValueBatch ST_IBM_GetAttributeValueBatch;
 
     /* The functions defined below are not part of the external API */
     ST_C_HandleEvent ST_HandleEvent;
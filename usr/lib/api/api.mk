@@ -40,7 +40,7 @@ opencryptoki_libopencryptoki_la_SOURCES = usr/lib/api/api_interface.c	\
 	usr/lib/api/supportedstrengths.c				\
 	usr/lib/common/pqc_supported.c					\
 	usr/lib/config/cfgparse.y usr/lib/config/cfglex.l		\
-	usr/lib/common/btree.c
+	usr/lib/common/btree.c usr/lib/common/hsm_mk_change_lock.c
 
 if AIX
 opencryptoki_libopencryptoki_la_SOURCES += usr/lib/common/aix/short_name.c
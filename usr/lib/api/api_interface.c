@@ -110,6 +110,14 @@ static CK_IBM_FUNCTION_LIST_1_0 func_list_ibm_1_0 = {
     C_IBM_ReencryptSingle
 };
 
+static CK_IBM_FUNCTION_LIST_1_1 func_list_ibm_1_1 = {
+    {1, 1},
+    C_IBM_ReencryptSingle,
+    C_IBM_DigestBatch,
+    C_IBM_ReencryptBatch,
+    C_IBM_GetAttributeValueBatch
+};
+
 static CK_FUNCTION_LIST func_list_pkcs11_2_40 = {
     {2, 40},
     C_Initialize,
@@ -300,6 +308,11 @@ static CK_INTERFACE interface_list[] = {
         &func_list_pkcs11_2_40,
         CKF_INTERFACE_FORK_SAFE /*XXX*/
     },
+    {
+        (CK_UTF8CHAR *)"Vendor IBM",
+        &func_list_ibm_1_1,
+        CKF_INTERFACE_FORK_SAFE /*XXX*/
+    },
     {
         (CK_UTF8CHAR *)"Vendor IBM",
         &func_list_ibm_1_0,
@@ -5649,6 +5662,197 @@ CK_RV C_IBM_ReencryptSingle(CK_SESSION_HANDLE hSession,
     return rv;
 }
 
+CK_RV C_IBM_DigestBatch(CK_SESSION_HANDLE hSession,
+                        CK_MECHANISM_PTR pMechanism,
+                        CK_ULONG ulCount,
+                        CK_BYTE_PTR *ppData,
+                        CK_ULONG_PTR pulDataLen,
+                        CK_BYTE_PTR pDigests,
+                        CK_ULONG_PTR pulDigestsLen)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+
+    TRACE_INFO("C_IBM_DigestBatch\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pMechanism) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        return CKR_MECHANISM_INVALID;
+    }
+    if (!pulDigestsLen || (ulCount > 0 && (!ppData || !pulDataLen))) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_DigestBatch) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        BEGIN_HSM_MK_CHANGE_LOCK(sltp, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_DigestBatch(sltp->TokData, &rSession, pMechanism,
+                                     ulCount, ppData, pulDataLen, pDigests,
+                                     pulDigestsLen);
+        TRACE_DEVEL("fcn->ST_IBM_DigestBatch returned: 0x%lx\n", rv);
+        END_HSM_MK_CHANGE_LOCK(sltp, rv)
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
+CK_RV C_IBM_ReencryptBatch(CK_SESSION_HANDLE hSession,
+                           CK_MECHANISM_PTR pDecrMech,
+                           CK_OBJECT_HANDLE hDecrKey,
+                           CK_MECHANISM_PTR pEncrMech,
+                           CK_OBJECT_HANDLE hEncrKey,
+                           CK_ULONG ulCount,
+                           CK_VOID_PTR *ppDecrParams,
+                           CK_VOID_PTR *ppEncrParams,
+                           CK_BYTE_PTR *ppEncryptedData,
+                           CK_ULONG_PTR pulEncryptedDataLen,
+                           CK_BYTE_PTR *ppReencryptedData,
+                           CK_ULONG_PTR pulReencryptedDataLen,
+                           CK_RV *pResults)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+
+    TRACE_INFO("C_IBM_ReencryptBatch\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (!pDecrMech || !pEncrMech) {
+        TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+        return CKR_MECHANISM_INVALID;
+    }
+    if (ulCount > 0 && (!ppEncryptedData || !pulEncryptedDataLen ||
+                        !pulReencryptedDataLen || !pResults)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_ReencryptBatch) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        BEGIN_HSM_MK_CHANGE_LOCK(sltp, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_ReencryptBatch(sltp->TokData, &rSession, pDecrMech,
+                                        hDecrKey, pEncrMech, hEncrKey,
+                                        ulCount, ppDecrParams, ppEncrParams,
+                                        ppEncryptedData, pulEncryptedDataLen,
+                                        ppReencryptedData,
+                                        pulReencryptedDataLen, pResults);
+        TRACE_DEVEL("fcn->ST_IBM_ReencryptBatch returned: 0x%lx\n", rv);
+        END_HSM_MK_CHANGE_LOCK(sltp, rv)
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
+CK_RV C_IBM_GetAttributeValueBatch(CK_SESSION_HANDLE hSession,
+                                   CK_ULONG ulCount,
+                                   CK_OBJECT_HANDLE_PTR phObjects,
+                                   CK_ATTRIBUTE_PTR *ppTemplates,
+                                   CK_ULONG_PTR pulAttributeCounts,
+                                   CK_RV *pResults)
+{
+    CK_RV rv;
+    API_Slot_t *sltp;
+    STDLL_FcnList_t *fcn;
+    ST_SESSION_T rSession;
+
+    TRACE_INFO("C_IBM_GetAttributeValueBatch\n");
+    if (API_Initialized() == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        return CKR_CRYPTOKI_NOT_INITIALIZED;
+    }
+
+    if (ulCount > 0 && (!phObjects || !ppTemplates || !pulAttributeCounts ||
+                        !pResults)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+    if (!Valid_Session(hSession, &rSession)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        TRACE_ERROR("Session handle id: %lu\n", hSession);
+        return CKR_SESSION_HANDLE_INVALID;
+    }
+    TRACE_INFO("Valid Session handle id: %lu\n", rSession.sessionh);
+
+    sltp = &(Anchor->SltList[rSession.slotID]);
+    if (sltp->DLLoaded == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if ((fcn = sltp->FcnList) == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TOKEN_NOT_PRESENT));
+        return CKR_TOKEN_NOT_PRESENT;
+    }
+    if (fcn->ST_IBM_GetAttributeValueBatch) {
+        BEGIN_OPENSSL_LIBCTX(Anchor->openssl_libctx, rv)
+        BEGIN_HSM_MK_CHANGE_LOCK(sltp, rv)
+        // Map the Session to the slot session
+        rv = fcn->ST_IBM_GetAttributeValueBatch(sltp->TokData, &rSession,
+                                                ulCount, phObjects,
+                                                ppTemplates,
+                                                pulAttributeCounts, pResults);
+        TRACE_DEVEL("fcn->ST_IBM_GetAttributeValueBatch returned: 0x%lx\n",
+                    rv);
+        END_HSM_MK_CHANGE_LOCK(sltp, rv)
+        END_OPENSSL_LIBCTX(rv)
+    } else {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_NOT_SUPPORTED));
+        rv = CKR_FUNCTION_NOT_SUPPORTED;
+    }
+
+    return rv;
+}
+
 #if defined(__sun) || defined(_AIX)
 #pragma init(api_init)
 #else
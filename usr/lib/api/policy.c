@@ -47,6 +47,9 @@ extern CK_RV get_sha_size(CK_ULONG mech, CK_ULONG *hsize);
 
 #define OCK_POLICY_PERMS (0640u)
 
+/* Number of cached mechanism verdicts per thread, must be a power of 2 */
+#define POLICY_VERDICT_CACHE_SIZE 64u
+
 struct strength {
     union {
         CK_ULONG arr[5];
@@ -73,13 +76,48 @@ struct policy_private {
     CK_ULONG           allowedvendorkdfs;
     CK_ULONG           allowedprfs;
     CK_ULONG           maxcurvesize;
+    /* Changes whenever the contents change, invalidates cached verdicts */
+    unsigned long      generation;
     /* Strength struct ordered from highest to lowest. */
     struct strength strengths[NUM_SUPPORTED_STRENGTHS];
 };
 
+/*
+ * A mechanism verdict only depends on the loaded policy, the mechanism,
+ * the presence and length of its parameter, the few parameter fields the
+ * policy looks at, the check type and the strength of the key.  Only
+ * allowed verdicts are cached, so that policy violations are still traced.
+ */
+struct policy_verdict {
+    unsigned long      generation; /* 0 if unused */
+    CK_MECHANISM_TYPE  mech;
+    CK_ULONG           paramlen;
+    CK_ULONG           param[2];
+    CK_ULONG           strength;
+    CK_ULONG           siglen;
+    int                check;
+    CK_BBOOL           hasparam;
+    CK_BBOOL           haskey;
+    CK_BBOOL           allowed;
+};
+
+static unsigned long policy_generation;
+static __thread struct policy_verdict
+                        policy_verdicts[POLICY_VERDICT_CACHE_SIZE];
+
+static void policy_private_changed(struct policy_private *pp)
+{
+    pp->generation = __sync_add_and_fetch(&policy_generation, 1);
+}
+
 struct policy_private *policy_private_alloc(void)
 {
-    return calloc(1, sizeof(struct policy_private));
+    struct policy_private *pp;
+
+    pp = calloc(1, sizeof(struct policy_private));
+    if (pp)
+        policy_private_changed(pp);
+    return pp;
 }
 
 struct policy_private *policy_private_free(struct policy_private *pp)
@@ -109,6 +147,7 @@ void policy_private_deactivate(struct policy_private *pp)
     pp->allowedvendorkdfs = ~0lu;
     pp->allowedprfs = ~0lu;
     pp->maxcurvesize = 521u;
+    policy_private_changed(pp);
 }
 
 static void policy_compute_strength(struct policy_private *pp,
@@ -886,11 +925,11 @@ static CK_RV policy_store_object_strength(policy_t p, struct objstrength *s,
     return rv;
 }
 
-static CK_RV policy_is_mech_allowed(policy_t p, CK_MECHANISM_PTR mech,
-                                    struct objstrength *s, int check,
-                                    SESSION *sess)
+/* Uncached mechanism check (externalized for testing purpose) */
+CK_RV policy_is_mech_allowed_i(struct policy_private *pp,
+                               CK_MECHANISM_PTR mech,
+                               struct objstrength *s, int check)
 {
-    struct policy_private *pp = p->priv;
     CK_ULONG size;
     CK_RV rv = CKR_OK;
 
@@ -1064,7 +1103,112 @@ static CK_RV policy_is_mech_allowed(policy_t p, CK_MECHANISM_PTR mech,
         }
     }
  out:
-    if (rv != CKR_OK && sess)
+    return rv;
+}
+
+/*
+ * Extract the parameter fields that policy_is_mech_allowed_i looks at
+ * for a mechanism.  Malformed parameters are rejected there, so their
+ * verdicts are never cached.  A missing parameter gives the same fields as
+ * a zeroed one, the caller therefore also keys on pParameter being set.
+ */
+static void policy_verdict_param(CK_MECHANISM_PTR mech, CK_ULONG param[2])
+{
+    param[0] = param[1] = 0;
+    if (mech->pParameter == NULL)
+        return;
+
+    switch (mech->mechanism) {
+    case CKM_RSA_PKCS_PSS:
+    case CKM_SHA1_RSA_PKCS_PSS:
+    case CKM_SHA224_RSA_PKCS_PSS:
+    case CKM_SHA256_RSA_PKCS_PSS:
+    case CKM_SHA384_RSA_PKCS_PSS:
+    case CKM_SHA512_RSA_PKCS_PSS:
+    case CKM_SHA3_224_RSA_PKCS_PSS:
+    case CKM_SHA3_256_RSA_PKCS_PSS:
+    case CKM_SHA3_384_RSA_PKCS_PSS:
+    case CKM_SHA3_512_RSA_PKCS_PSS:
+        if (mech->ulParameterLen == sizeof(CK_RSA_PKCS_PSS_PARAMS)) {
+            param[0] = ((CK_RSA_PKCS_PSS_PARAMS *)mech->pParameter)->hashAlg;
+            param[1] = ((CK_RSA_PKCS_PSS_PARAMS *)mech->pParameter)->mgf;
+        }
+        break;
+    case CKM_RSA_PKCS_OAEP:
+        if (mech->ulParameterLen == sizeof(CK_RSA_PKCS_OAEP_PARAMS)) {
+            param[0] = ((CK_RSA_PKCS_OAEP_PARAMS *)mech->pParameter)->hashAlg;
+            param[1] = ((CK_RSA_PKCS_OAEP_PARAMS *)mech->pParameter)->mgf;
+        }
+        break;
+    case CKM_ECDH1_DERIVE:
+        if (mech->ulParameterLen == sizeof(CK_ECDH1_DERIVE_PARAMS))
+            param[0] = ((CK_ECDH1_DERIVE_PARAMS *)mech->pParameter)->kdf;
+        break;
+    case CKM_IBM_ECDSA_OTHER:
+        if (mech->ulParameterLen == sizeof(CK_IBM_ECDSA_OTHER_PARAMS))
+            param[0] = ((CK_IBM_ECDSA_OTHER_PARAMS *)
+                                            mech->pParameter)->submechanism;
+        break;
+    case CKM_IBM_BTC_DERIVE:
+        if (mech->ulParameterLen == sizeof(CK_IBM_BTC_DERIVE_PARAMS)) {
+            param[0] = ((CK_IBM_BTC_DERIVE_PARAMS *)mech->pParameter)->type;
+            param[1] = ((CK_IBM_BTC_DERIVE_PARAMS *)mech->pParameter)->version;
+        }
+        break;
+    case CKM_IBM_KYBER:
+        if (mech->ulParameterLen == sizeof(CK_IBM_KYBER_PARAMS)) {
+            param[0] = ((CK_IBM_KYBER_PARAMS *)mech->pParameter)->kdf;
+            param[1] = 1;
+        }
+        break;
+    default:
+        /* General MAC mechanisms use the MAC length for the size check */
+        if (mech->ulParameterLen == sizeof(CK_MAC_GENERAL_PARAMS)) {
+            param[0] = *(CK_MAC_GENERAL_PARAMS *)mech->pParameter;
+            param[1] = 1;
+        }
+        break;
+    }
+}
+
+static CK_RV policy_is_mech_allowed(policy_t p, CK_MECHANISM_PTR mech,
+                                    struct objstrength *s, int check,
+                                    SESSION *sess)
+{
+    struct policy_private *pp = p->priv;
+    struct policy_verdict key, *v;
+    CK_ULONG h;
+    CK_RV rv;
+
+    if (pp == NULL)
+        return CKR_OK;
+
+    memset(&key, 0, sizeof(key));
+    key.generation = pp->generation;
+    key.mech = mech->mechanism;
+    key.hasparam = (mech->pParameter != NULL);
+    key.paramlen = mech->ulParameterLen;
+    policy_verdict_param(mech, key.param);
+    key.check = check;
+    if (s) {
+        key.haskey = CK_TRUE;
+        key.strength = s->strength;
+        key.siglen = s->siglen;
+        key.allowed = s->allowed;
+    }
+
+    h = key.mech ^ (key.mech >> 7) ^ key.param[0] ^ (key.param[1] << 3) ^
+        ((CK_ULONG)check << 5) ^ (key.strength << 9) ^ (key.siglen >> 3) ^
+        (key.paramlen << 11);
+    h ^= h >> 16;
+    v = &policy_verdicts[h & (POLICY_VERDICT_CACHE_SIZE - 1)];
+    if (memcmp(v, &key, sizeof(key)) == 0)
+        return CKR_OK;
+
+    rv = policy_is_mech_allowed_i(pp, mech, s, check);
+    if (rv == CKR_OK)
+        memcpy(v, &key, sizeof(key));
+    else if (sess)
         sess->session_info.ulDeviceError = CKR_POLICY_VIOLATION;
     return rv;
 }
@@ -1829,6 +1973,7 @@ CK_RV policy_load_strength_cfg(struct policy_private *pp,
     if (rc == CKR_OK)
         rc = policy_check_unmarked(cfg);
     confignode_deepfree(cfg);
+    policy_private_changed(pp);
     return rc;
 }
 
@@ -1974,6 +2119,7 @@ CK_RV policy_load_policy_cfg(struct policy_private *pp,
     if (rc == CKR_FUNCTION_FAILED)
         rc = CKR_GENERAL_ERROR;
     confignode_deepfree(cfg);
+    policy_private_changed(pp);
     return rc;
 }
 
@@ -62,6 +62,54 @@ struct statistics {
                   ((OBJECT *)(key))->strength.strength : (no_key_strength));\
     } while (0)
 
+/*
+ * Tokens that balance their requests over multiple crypto adapter APQNs
+ * (e.g. the EP11 token with APQN_LOAD_BALANCING) collect per-APQN statistics
+ * in a separate shared memory segment per user and slot, if statistics are
+ * enabled. The segment contains STAT_APQN_MAX entries of type stat_apqn_t,
+ * unused entries have an apqn value of zero.
+ */
+#define STAT_APQN_MAX               256
+#define STAT_APQN_USED              0x80000000
+#define STAT_APQN(adapter, domain)  (STAT_APQN_USED | ((adapter) << 16) | \
+                                     (domain))
+#define STAT_APQN_ADAPTER(apqn)     (((apqn) >> 16) & 0xff)
+#define STAT_APQN_DOMAIN(apqn)      ((apqn) & 0xffff)
+
+typedef struct {
+    volatile uint32_t apqn;
+    uint32_t reserved;
+    volatile counter_t requests;
+    volatile counter_t errors;
+    volatile counter_t inflight;
+    volatile counter_t latency_total_us;
+    volatile counter_t latency_recent_us;   /* moving average */
+} stat_apqn_t;
+
+#define STAT_APQN_SHM_SIZE          (STAT_APQN_MAX * sizeof(stat_apqn_t))
+#define STAT_APQN_SHM_NAME_FMT      "%s_apqnstats_%u_%lu" /* path, uid, slot */
+
+/*
+ * The soft token collects statistics of its key pair pools (KEYGEN_POOL in
+ * the token configuration) in a separate shared memory segment per user and
+ * slot, if statistics are enabled. The segment contains STAT_KEYPOOL_MAX
+ * entries of type stat_keypool_t, one per pool parameter set, which are
+ * shared by all processes of the user. Unused entries have an id of zero.
+ */
+#define STAT_KEYPOOL_MAX            64
+#define STAT_KEYPOOL_NAME_LEN       48
+
+typedef struct {
+    volatile uint64_t id;                /* hash of the pool name */
+    char name[STAT_KEYPOOL_NAME_LEN];    /* e.g. "RSA 4096 65537" */
+    volatile counter_t generated;
+    volatile counter_t hits;
+    volatile counter_t misses;
+} stat_keypool_t;
+
+#define STAT_KEYPOOL_SHM_SIZE       (STAT_KEYPOOL_MAX * sizeof(stat_keypool_t))
+#define STAT_KEYPOOL_SHM_NAME_FMT   "%s_keypoolstats_%u_%lu" /* path, uid, slot */
+
 CK_RV statistics_init(struct statistics *statistics,
                       Slot_Mgr_Socket_t *slots_infos, CK_ULONG flags,
                       uid_t uid);
@@ -23,6 +23,7 @@
 #include "ock_syslog.h"
 #include "trace.h"
 #include "events.h"
+#include "hsm_mk_change_lock.h"
 #include "cfgparser.h"
 #include "cca_stdll.h"
 
@@ -1569,50 +1570,50 @@ struct reencipher_data {
     struct cca_mk_change_op *mk_change_op;
 };
 
-static CK_RV cca_reencipher_objects_reenc(CK_BYTE *sec_key,
+/* Called concurrently by the re-encipher worker threads */
+static CK_RV cca_reencipher_objects_reenc(STDLL_TokData_t *tokdata,
+                                          OBJECT *obj,
+                                          CK_BYTE *sec_key,
                                           CK_BYTE *reenc_sec_key,
                                           CK_ULONG sec_key_len,
                                           void *private)
 {
     struct reencipher_data *rd = private;
 
-    return cca_reencipher_sec_key(rd->tokdata, rd->mk_change_op,
+    UNUSED(obj);
+
+    return cca_reencipher_sec_key(tokdata, rd->mk_change_op,
                                   sec_key, reenc_sec_key, sec_key_len, FALSE);
 }
 
-static CK_RV cca_reencipher_objects_cb(STDLL_TokData_t *tokdata,
-                                       OBJECT *obj, void *cb_data)
+static void cca_reencipher_progress_cb(STDLL_TokData_t *tokdata,
+                                       unsigned long done,
+                                       unsigned long total,
+                                       void *private)
 {
-    struct reencipher_data *rd = cb_data;
-    CK_RV rc;
+    struct reencipher_data *rd = private;
+    struct hsm_mk_change_progress progress;
 
-    rc = obj_mgr_reencipher_secure_key(tokdata, obj,
-                                       cca_reencipher_objects_reenc, rd);
-    if (rc == CKR_OBJECT_HANDLE_INVALID) /* Obj was deleted by other proc */
-        rc = CKR_OK;
+    progress.total = total;
+    progress.done = done;
 
-    return rc;
+    if (hsm_mk_change_token_progress_save(rd->mk_change_op->mk_change_op,
+                                          tokdata->slot_id,
+                                          &progress) != CKR_OK)
+        TRACE_DEVEL("%s failed to save the progress\n", __func__);
 }
 
 static CK_BBOOL cca_reencipher_filter_cb(STDLL_TokData_t *tokdata,
                                          OBJECT *obj, void *filter_data)
 {
     struct cca_mk_change_op *mk_change_op  = filter_data;
-    CK_ATTRIBUTE *attr;
-    enum cca_token_type keytype;
-    unsigned int keybitsize;
-    const CK_BYTE *mkvp = NULL;
-
-    UNUSED(tokdata);
-
-    if (template_attribute_find(obj->template, CKA_IBM_OPAQUE, &attr) == FALSE)
-        return FALSE;
+    struct cca_key_info key_info;
 
-    if (analyse_cca_key_token(attr->pValue, attr->ulValueLen,
-                              &keytype, &keybitsize, &mkvp) == FALSE)
+    if (cca_get_key_info(tokdata, obj, &key_info) != CKR_OK ||
+        key_info.known == FALSE)
         return FALSE;
 
-    switch (keytype) {
+    switch (key_info.keytype[0]) {
     case sec_des_data_key:
         return mk_change_op->new_sym_mkvp_set;
 
@@ -1631,6 +1632,14 @@ static CK_BBOOL cca_reencipher_filter_cb(STDLL_TokData_t *tokdata,
     }
 }
 
+static CK_BBOOL cca_reencipher_objects_filter(STDLL_TokData_t *tokdata,
+                                              OBJECT *obj, void *private)
+{
+    struct reencipher_data *rd = private;
+
+    return cca_reencipher_filter_cb(tokdata, obj, rd->mk_change_op);
+}
+
 static CK_BBOOL cca_reencipher_cancel_filter_cb(STDLL_TokData_t *tokdata,
                                                 OBJECT *obj, void *filter_data)
 {
@@ -1854,12 +1863,11 @@ static CK_RV cca_mk_change_reencipher(STDLL_TokData_t *tokdata,
         }
     }
 
-    if (pthread_rwlock_wrlock(&tokdata->hsm_mk_change_rwlock) != 0) {
+    if (hsm_mk_change_lock_exclusive(tokdata) != CKR_OK) {
         TRACE_DEVEL("HSM-MK-change Write-Lock failed.\n");
         OCK_SYSLOG(LOG_ERR, "Slot %lu: HSM-MK-change Write-Lock failed\n",
                    tokdata->slot_id);
-        rc = CKR_CANT_LOCK;
-        goto out;
+        return CKR_CANT_LOCK;
     }
 
     mk_change_op = cca_mk_change_find_op(tokdata, op->id, NULL);
@@ -1920,10 +1928,13 @@ static CK_RV cca_mk_change_reencipher(STDLL_TokData_t *tokdata,
     rd.tokdata = tokdata;
     rd.mk_change_op = mk_change_op;
 
-    rc = obj_mgr_iterate_key_objects(tokdata, !token_objs, token_objs,
-                                     cca_reencipher_filter_cb, mk_change_op,
-                                     cca_reencipher_objects_cb, &rd,
-                                     TRUE, "re-encipher");
+    rc = obj_mgr_reencipher_key_objects(tokdata, !token_objs, token_objs,
+                                        cca_reencipher_objects_filter,
+                                        cca_reencipher_objects_reenc,
+                                        cca_reencipher_finalize_is_new_mk_cb,
+                                        token_objs ?
+                                            cca_reencipher_progress_cb : NULL,
+                                        &rd, 0);
     if (rc != CKR_OK) {
         obj_mgr_iterate_key_objects(tokdata, !token_objs, token_objs,
                                     cca_reencipher_cancel_filter_cb, mk_change_op,
@@ -1937,7 +1948,7 @@ static CK_RV cca_mk_change_reencipher(STDLL_TokData_t *tokdata,
     }
 
 out:
-    if (pthread_rwlock_unlock(&tokdata->hsm_mk_change_rwlock) != 0) {
+    if (hsm_mk_change_unlock_exclusive(tokdata) != CKR_OK) {
         TRACE_DEVEL("HSM-MK-change Unlock failed.\n");
         OCK_SYSLOG(LOG_ERR, "Slot %lu: HSM-MK-change unlock failed\n",
                    tokdata->slot_id);
@@ -1980,12 +1991,11 @@ static CK_RV cca_mk_change_finalize_cancel(STDLL_TokData_t *tokdata,
         }
     }
 
-    if (pthread_rwlock_wrlock(&tokdata->hsm_mk_change_rwlock) != 0) {
+    if (hsm_mk_change_lock_exclusive(tokdata) != CKR_OK) {
         TRACE_DEVEL("HSM-MK-change Write-Lock failed.\n");
         OCK_SYSLOG(LOG_ERR, "Slot %lu: HSM-MK-change Write-Lock failed\n",
                    tokdata->slot_id);
-        rc = CKR_CANT_LOCK;
-        goto out;
+        return CKR_CANT_LOCK;
     }
 
     mk_change_op = cca_mk_change_find_op(tokdata, op->id, NULL);
@@ -2066,7 +2076,7 @@ static CK_RV cca_mk_change_finalize_cancel(STDLL_TokData_t *tokdata,
     }
 
 out:
-    if (pthread_rwlock_unlock(&tokdata->hsm_mk_change_rwlock) != 0) {
+    if (hsm_mk_change_unlock_exclusive(tokdata) != CKR_OK) {
         TRACE_DEVEL("HSM-MK-change Unlock failed.\n");
         OCK_SYSLOG(LOG_ERR, "Slot %lu: HSM-MK-change unlock failed\n",
                    tokdata->slot_id);
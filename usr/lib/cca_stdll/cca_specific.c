@@ -95,6 +95,7 @@ const char label[] = "ccatok";
 #else
 #define CCASHAREDLIB "libcsulcca.so"
 #endif
+#define CCASHAREDLIB_NAME "OCK_CCA_LIBRARY"
 
 #define CCA_MIN_VERSION     7
 #define CCA_MIN_RELEASE     1
@@ -691,6 +692,119 @@ CK_RV check_expected_mkvp(STDLL_TokData_t *tokdata,
     return CKR_OK;
 }
 
+typedef struct {
+    struct openssl_ex_data openssl_ex_data; /* This must be the first field ! */
+    CK_BBOOL key_info_valid;
+    struct cca_key_info key_info;
+} cca_ex_data_t;
+
+static CK_BBOOL cca_need_wr_lock_key_info(OBJECT *obj, void *ex_data,
+                                          size_t ex_data_len)
+{
+    cca_ex_data_t *data = ex_data;
+
+    UNUSED(obj);
+
+    if (ex_data == NULL || ex_data_len < sizeof(cca_ex_data_t))
+        return FALSE;
+
+    return data->key_info_valid == FALSE;
+}
+
+static void cca_free_ex_data(OBJECT *obj, void *ex_data, size_t ex_data_len)
+{
+    cca_ex_data_t *data = ex_data;
+
+    if (ex_data == NULL || ex_data_len < sizeof(cca_ex_data_t))
+        return;
+
+    data->key_info_valid = FALSE;
+    memset(&data->key_info, 0, sizeof(data->key_info));
+
+    openssl_free_ex_data(obj, ex_data, ex_data_len);
+}
+
+/*
+ * Analyses the num_tokens concatenated secure key tokens in the CKA_IBM_OPAQUE
+ * attribute opaque_attr.
+ */
+static void cca_analyse_key_tokens(const CK_ATTRIBUTE *opaque_attr,
+                                   unsigned int num_tokens,
+                                   struct cca_key_info *info)
+{
+    const CK_BYTE *mkvp;
+    CK_ULONG token_len;
+    unsigned int i;
+
+    info->num_tokens = num_tokens;
+    token_len = opaque_attr->ulValueLen / info->num_tokens;
+
+    info->mkvp_set = TRUE;
+    for (i = 0; i < info->num_tokens; i++) {
+        mkvp = NULL;
+        if (analyse_cca_key_token((CK_BYTE *)opaque_attr->pValue +
+                                                            i * token_len,
+                                  token_len, &info->keytype[i],
+                                  &info->keybitsize[i], &mkvp) == FALSE)
+            return;
+
+        if (mkvp != NULL)
+            memcpy(info->mkvp[i], mkvp, CCA_MKVP_LENGTH);
+        else
+            info->mkvp_set = FALSE;
+    }
+
+    info->known = TRUE;
+}
+
+static void cca_analyse_key_obj(OBJECT *obj, struct cca_key_info *info)
+{
+    CK_ATTRIBUTE *opaque_attr = NULL;
+    CK_KEY_TYPE key_type = 0;
+
+    memset(info, 0, sizeof(*info));
+
+#ifndef NO_PKEY
+    info->pkey_extractable = object_is_pkey_extractable(obj);
+    info->ec_public_key = pkey_is_ec_public_key(obj->template);
+#endif
+
+    if (template_attribute_get_non_empty(obj->template, CKA_IBM_OPAQUE,
+                                         &opaque_attr) != CKR_OK)
+        return;
+
+    template_attribute_get_ulong(obj->template, CKA_KEY_TYPE, &key_type);
+    cca_analyse_key_tokens(opaque_attr, key_type == CKK_AES_XTS ? 2 : 1, info);
+}
+
+/*
+ * Returns the (cached) facts about the secure key token(s) of a key object.
+ * They are derived on first use and kept in the object's ex_data until the
+ * object's attributes change. The caller must hold the object lock.
+ */
+CK_RV cca_get_key_info(STDLL_TokData_t *tokdata, OBJECT *obj,
+                       struct cca_key_info *info)
+{
+    cca_ex_data_t *ex_data = NULL;
+    CK_RV rc;
+
+    UNUSED(tokdata);
+
+    rc = openssl_get_ex_data(obj, (void **)&ex_data, sizeof(cca_ex_data_t),
+                             cca_need_wr_lock_key_info, cca_free_ex_data);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (ex_data->key_info_valid == FALSE) {
+        cca_analyse_key_obj(obj, &ex_data->key_info);
+        ex_data->key_info_valid = TRUE;
+    }
+
+    *info = ex_data->key_info;
+
+    return object_ex_data_unlock(obj);
+}
+
 /* Helper function: build attribute and update template */
 CK_RV build_update_attribute(TEMPLATE * tmpl,
                              CK_ATTRIBUTE_TYPE type,
@@ -2447,10 +2561,11 @@ done:
 
 /*
  * Creates a protected key from the given secure key object by iterating
- * over all APQNs.
+ * over all APQNs. key_obj may be NULL if the secure key in skey_attr has no
+ * key object, its key token(s) are then analysed without caching.
  */
 static CK_RV ccatok_pkey_skey2pkey(STDLL_TokData_t *tokdata,
-                                   CK_ATTRIBUTE *skey_attr,
+                                   OBJECT *key_obj, CK_ATTRIBUTE *skey_attr,
                                    CK_ATTRIBUTE **pkey_attr, CK_BBOOL aes_xts)
 {
     CK_ATTRIBUTE *tmp_attr = NULL;
@@ -2460,23 +2575,32 @@ static CK_RV ccatok_pkey_skey2pkey(STDLL_TokData_t *tokdata,
     CK_ULONG pkey_buflen2 = sizeof(pkey_buf2);
     pkey_wrap_handler_data_t pkey_wrap_handler_data;
     CK_RV ret;
+    struct cca_key_info key_info;
     enum cca_token_type key_type;
-    unsigned int token_keybitsize;
-    const CK_BYTE *mkvp;
     CK_BBOOL new_mk;
     unsigned int num_retries = 0;
 
     /* Determine CCA key type */
-    if (analyse_cca_key_token(skey_attr->pValue, (aes_xts ?
-                              skey_attr->ulValueLen / 2 :
-                              skey_attr->ulValueLen), &key_type,
-                              &token_keybitsize, &mkvp) != TRUE) {
+    if (key_obj != NULL) {
+        ret = cca_get_key_info(tokdata, key_obj, &key_info);
+        if (ret != CKR_OK)
+            goto done;
+    } else {
+        /* No key object, e.g. for the firmware wkvp at token init */
+        memset(&key_info, 0, sizeof(key_info));
+        cca_analyse_key_tokens(skey_attr, aes_xts ? 2 : 1, &key_info);
+    }
+
+    if (key_info.known == FALSE || key_info.mkvp_set == FALSE ||
+        key_info.num_tokens != (aes_xts ? 2 : 1)) {
        TRACE_ERROR("Invalid/unknown cca token, cannot get key type\n");
        ret = CKR_FUNCTION_FAILED;
        goto done;
     }
+    key_type = key_info.keytype[0];
 
-    if (check_expected_mkvp(tokdata, key_type, mkvp, &new_mk) != CKR_OK) {
+    if (check_expected_mkvp(tokdata, key_type, key_info.mkvp[0],
+                            &new_mk) != CKR_OK) {
         TRACE_ERROR("%s\n", ock_err(ERR_DEVICE_ERROR));
         ret = CKR_DEVICE_ERROR;
         goto done;
@@ -2493,16 +2617,10 @@ static CK_RV ccatok_pkey_skey2pkey(STDLL_TokData_t *tokdata,
     pkey_wrap_handler_data.aes_xts = aes_xts;
 
     if (aes_xts) {
-        if (analyse_cca_key_token((CK_BYTE *)skey_attr->pValue + skey_attr->ulValueLen / 2,
-                                  skey_attr->ulValueLen / 2,
-                                  &key_type, &token_keybitsize,
-                                  &mkvp) != TRUE) {
-            TRACE_ERROR("Invalid/unknown cca token, cannot get key type\n");
-            ret = CKR_FUNCTION_FAILED;
-            goto done;
-        }
+        key_type = key_info.keytype[1];
 
-        if (check_expected_mkvp(tokdata, key_type, mkvp, &new_mk) != CKR_OK) {
+        if (check_expected_mkvp(tokdata, key_type, key_info.mkvp[1],
+                                &new_mk) != CKR_OK) {
             TRACE_ERROR("%s\n", ock_err(ERR_DEVICE_ERROR));
             ret = CKR_DEVICE_ERROR;
             goto done;
@@ -2688,7 +2806,7 @@ static CK_RV ccatok_pkey_get_firmware_wkvp(STDLL_TokData_t *tokdata)
      * this function returns ok, we have a 64 byte pkey value: 32 bytes
      * encrypted key + 32 bytes vp.
      */
-    ret = ccatok_pkey_skey2pkey(tokdata, sec_attr, &pkey_attr, FALSE);
+    ret = ccatok_pkey_skey2pkey(tokdata, NULL, sec_attr, &pkey_attr, FALSE);
     if (ret != CKR_OK) {
         TRACE_ERROR("ccatok_pkey_skey2pkey failed with ret=0x%lx\n", ret);
         goto done;
@@ -2792,7 +2910,8 @@ static CK_RV ccatok_pkey_update(STDLL_TokData_t *tokdata, OBJECT *key_obj,
 
 retry:
     /* Transform the secure key into a protected key */
-    ret = ccatok_pkey_skey2pkey(tokdata, skey_attr, &pkey_attr, aes_xts);
+    ret = ccatok_pkey_skey2pkey(tokdata, key_obj, skey_attr, &pkey_attr,
+                                aes_xts);
     if (ret != CKR_OK) {
         TRACE_ERROR("protected key creation failed with rc=0x%lx\n",ret);
         goto done;
@@ -2945,6 +3064,7 @@ static CK_RV ccatok_pkey_check(STDLL_TokData_t *tokdata, SESSION *session,
 {
     struct cca_private_data *cca_data = tokdata->private_data;
     CK_ATTRIBUTE *opaque_attr = NULL;
+    struct cca_key_info key_info;
     CK_RV ret = CKR_FUNCTION_NOT_SUPPORTED;
 
     /* Check if CPACF supports the operation implied by this key and mech */
@@ -2966,13 +3086,17 @@ static CK_RV ccatok_pkey_check(STDLL_TokData_t *tokdata, SESSION *session,
          * public keys that are pkey-extractable, can always be used via CPACF
          * as there is no protected key involved.
          */
-        if (pkey_is_ec_public_key(key_obj->template) &&
-            object_is_pkey_extractable(key_obj)) {
+        ret = cca_get_key_info(tokdata, key_obj, &key_info);
+        if (ret != CKR_OK)
+            goto done;
+        ret = CKR_FUNCTION_NOT_SUPPORTED;
+
+        if (key_info.ec_public_key && key_info.pkey_extractable) {
             ret = CKR_OK;
             goto done;
         }
 
-        if (!object_is_pkey_extractable(key_obj) ||
+        if (!key_info.pkey_extractable ||
             !cca_data->pkey_wrap_supported) {
             goto done;
         }
@@ -3048,7 +3172,8 @@ static CK_RV ccatok_pkey_convert_key(STDLL_TokData_t *tokdata, SESSION *session,
 
 retry:
     /* Convert secure key to protected key. */
-    rc = ccatok_pkey_skey2pkey(tokdata, skey_attr, &pkey_attr, xts_mode);
+    rc = ccatok_pkey_skey2pkey(tokdata, key_obj, skey_attr, &pkey_attr,
+                               xts_mode);
     if (rc != CKR_OK) {
         TRACE_ERROR("protkey creation failed, rc=0x%lx\n", rc);
         goto unlock;
@@ -4075,6 +4200,8 @@ CK_RV token_specific_init(STDLL_TokData_t * tokdata, CK_SLOT_ID SlotNumber,
                           char *conf_name)
 {
     struct cca_private_data *cca_private;
+    const char *cca_lib_name;
+    char *errstr;
 
     CK_RV rc;
 
@@ -4111,12 +4238,19 @@ CK_RV token_specific_init(STDLL_TokData_t * tokdata, CK_SLOT_ID SlotNumber,
         goto error;
     }
 
-    cca_private->lib_csulcca = dlopen(CCASHAREDLIB, RTLD_GLOBAL | DYNLIB_LDFLAGS);
+    /* The CCA host library can be replaced, e.g. by a test stand-in */
+    cca_lib_name = secure_getenv(CCASHAREDLIB_NAME);
+    if (cca_lib_name == NULL)
+        cca_lib_name = CCASHAREDLIB;
+
+    cca_private->lib_csulcca = dlopen(cca_lib_name,
+                                      RTLD_GLOBAL | DYNLIB_LDFLAGS);
     if (cca_private->lib_csulcca == NULL) {
+        errstr = dlerror();
         OCK_SYSLOG(LOG_ERR, "%s: Error loading library: '%s' [%s]\n",
-                   __func__, CCASHAREDLIB, dlerror());
+                   __func__, cca_lib_name, errstr);
         TRACE_ERROR("%s: Error loading shared library '%s' [%s]\n",
-                    __func__, CCASHAREDLIB, dlerror());
+                    __func__, cca_lib_name, errstr);
         rc = CKR_FUNCTION_FAILED;
         goto error;
     }
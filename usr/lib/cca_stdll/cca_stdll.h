@@ -253,6 +253,22 @@ enum cca_token_type {
     sec_qsa_publ_key
 };
 
+/*
+ * Facts about the secure key token(s) of a key object, derived once and
+ * cached in the object's ex_data by cca_get_key_info(). AES XTS keys have
+ * two concatenated key tokens.
+ */
+struct cca_key_info {
+    CK_BBOOL known;             /* secure key token(s) are valid and known */
+    unsigned int num_tokens;
+    enum cca_token_type keytype[2];
+    unsigned int keybitsize[2];
+    unsigned char mkvp[2][CCA_MKVP_LENGTH];
+    CK_BBOOL mkvp_set;          /* FALSE for public key tokens */
+    CK_BBOOL pkey_extractable;
+    CK_BBOOL ec_public_key;
+};
+
 struct cca_mk_change_op {
     volatile int mk_change_active;
     char mk_change_op[8]; /* set if mk_change_active = 1 */
@@ -417,6 +433,8 @@ CK_BBOOL analyse_cca_key_token(const CK_BYTE *t, CK_ULONG tlen,
 CK_RV check_expected_mkvp(STDLL_TokData_t *tokdata,
                           enum cca_token_type keytype,
                           const CK_BYTE *mkvp, CK_BBOOL *new_mk);
+CK_RV cca_get_key_info(STDLL_TokData_t *tokdata, OBJECT *obj,
+                       struct cca_key_info *info);
 CK_RV cca_get_mkvps(unsigned char *cur_sym, unsigned char *new_sym,
                     unsigned char *cur_aes, unsigned char *new_aes,
                     unsigned char *cur_apka, unsigned char *new_apka);
@@ -52,9 +52,11 @@ opencryptoki_stdll_libpkcs11_cca_la_SOURCES = usr/lib/common/asn1.c	\
 	usr/lib/api/policyhelper.c usr/lib/config/configuration.c	\
 	usr/lib/config/cfgparse.y usr/lib/config/cfglex.l		\
 	usr/lib/common/mech_openssl.c usr/lib/common/pqc_supported.c	\
+	usr/lib/common/sw_sha.c						\
 	usr/lib/hsm_mk_change/hsm_mk_change.c				\
 	usr/lib/common/btree.c usr/lib/common/sess_mgr.c		\
-	usr/lib/cca_stdll/cca_mkchange.c usr/lib/common/mech_pqc.c
+	usr/lib/cca_stdll/cca_mkchange.c usr/lib/common/mech_pqc.c	\
+	usr/lib/common/hsm_mk_change_lock.c
 
 if AIX
 opencryptoki_stdll_libpkcs11_cca_la_SOURCES += usr/lib/common/aix/short_name.c
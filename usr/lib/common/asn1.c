@@ -4964,3 +4964,581 @@ cleanup:
     return rc;
 }
 
+
+/*
+ * Single-pass DER encoding of the key structures
+ *
+ * The ber_encode_* functions above encode each element into its own buffer,
+ * which is then copied into the buffer of the enclosing element. The der_put_*
+ * functions below describe the whole structure as a tree of der_node elements
+ * on the stack instead. The tree is sized once, so that all nested lengths
+ * are known, and then written front to back into a single buffer of the exact
+ * final size. The produced encoding is the same as the one of the respective
+ * ber_encode_* function.
+ */
+
+#define DER_RAW             0x00    /* pre-encoded data, written as is */
+#define DER_INTEGER         0x02
+#define DER_BIT_STRING      0x03
+#define DER_OCTET_STRING    0x04
+#define DER_SEQUENCE        0x30
+#define DER_CHOICE(option)  (0xA0 | (option))
+
+struct der_node {
+    CK_BYTE tag;
+    const CK_BYTE *data;        /* contents, followed by those of children */
+    CK_ULONG data_len;
+    struct der_node *child;
+    struct der_node *last;
+    struct der_node *next;
+    CK_ULONG len;               /* contents length, set by der_node_size() */
+};
+
+static const CK_BYTE der_version0[] = { 0 };
+static const CK_BYTE der_version1[] = { 1 };
+
+static struct der_node *der_node_add(struct der_node *parent,
+                                     struct der_node *node)
+{
+    if (parent->last != NULL)
+        parent->last->next = node;
+    else
+        parent->child = node;
+    parent->last = node;
+
+    return node;
+}
+
+static struct der_node *der_node(struct der_node *node, CK_BYTE tag,
+                                 const CK_BYTE *data, CK_ULONG data_len,
+                                 struct der_node *parent)
+{
+    node->tag = tag;
+    node->data = data;
+    node->data_len = data_len;
+    node->child = NULL;
+    node->last = NULL;
+    node->next = NULL;
+    node->len = 0;
+
+    return parent != NULL ? der_node_add(parent, node) : node;
+}
+
+static struct der_node *der_attr(struct der_node *node, CK_BYTE tag,
+                                 const CK_ATTRIBUTE *attr,
+                                 struct der_node *parent)
+{
+    return der_node(node, tag, attr->pValue, attr->ulValueLen, parent);
+}
+
+static CK_ULONG der_length_len(CK_ULONG len)
+{
+    if (len < 128)
+        return 1;
+    if (len < 256)
+        return 2;
+    if (len < (1 << 16))
+        return 3;
+    return 4;
+}
+
+/*
+ * Computes the contents length of the node and all its children, and returns
+ * the length of the encoded node in *total.
+ */
+static CK_RV der_node_size(struct der_node *node, CK_ULONG *total)
+{
+    struct der_node *child;
+    CK_ULONG len = node->data_len, child_len;
+    CK_RV rc;
+
+    // a BIT STRING starts with the unused bits byte, and an INTEGER with the
+    // msb of the first byte set gets a preceding 0x00 byte to stay positive
+    if (node->tag == DER_BIT_STRING ||
+        (node->tag == DER_INTEGER && node->data_len > 0 &&
+         (node->data[0] & 0x80)))
+        len++;
+
+    for (child = node->child; child != NULL; child = child->next) {
+        rc = der_node_size(child, &child_len);
+        if (rc != CKR_OK)
+            return rc;
+        len += child_len;
+    }
+
+    if (len >= (1 << 24)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    node->len = len;
+    *total = node->tag == DER_RAW ? len : 1 + der_length_len(len) + len;
+
+    return CKR_OK;
+}
+
+static CK_BYTE *der_node_write(const struct der_node *node, CK_BYTE *out)
+{
+    const struct der_node *child;
+    CK_ULONG i, num;
+
+    if (node->tag != DER_RAW) {
+        *out++ = node->tag;
+        num = der_length_len(node->len);
+        if (num == 1) {
+            *out++ = node->len;
+        } else {
+            *out++ = 0x80 | (num - 1);
+            for (i = num - 1; i > 0; i--)
+                *out++ = (node->len >> ((i - 1) * 8)) & 0xFF;
+        }
+        if (node->tag == DER_BIT_STRING ||
+            (node->tag == DER_INTEGER && node->data_len > 0 &&
+             (node->data[0] & 0x80)))
+            *out++ = 0x00;
+    }
+
+    if (node->data_len > 0) {
+        memcpy(out, node->data, node->data_len);
+        out += node->data_len;
+    }
+
+    for (child = node->child; child != NULL; child = child->next)
+        out = der_node_write(child, out);
+
+    return out;
+}
+
+/*
+ * Encodes the tree into the caller's buffer. If buf is NULL, only the
+ * length is returned in *buf_len.
+ */
+static CK_RV der_encode_tree(struct der_node *root, CK_BYTE *buf,
+                             CK_ULONG *buf_len)
+{
+    CK_ULONG len;
+    CK_RV rc;
+
+    rc = der_node_size(root, &len);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (buf == NULL) {
+        *buf_len = len;
+        return CKR_OK;
+    }
+    if (*buf_len < len) {
+        *buf_len = len;
+        TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    der_node_write(root, buf);
+    *buf_len = len;
+
+    return CKR_OK;
+}
+
+/*
+ * Encodes the tree into a newly allocated buffer of the exact size, or
+ * returns only the length if length_only is TRUE.
+ */
+static CK_RV der_put_tree(CK_BBOOL length_only, CK_BYTE **data,
+                          CK_ULONG *data_len, struct der_node *root)
+{
+    CK_BYTE *buf;
+    CK_ULONG len;
+    CK_RV rc;
+
+    rc = der_encode_tree(root, NULL, &len);
+    if (rc != CKR_OK)
+        return rc;
+    if (length_only == TRUE) {
+        *data_len = len;
+        return CKR_OK;
+    }
+
+    buf = (CK_BYTE *) malloc(len);
+    if (buf == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    der_node_write(root, buf);
+    *data = buf;
+    *data_len = len;
+
+    return CKR_OK;
+}
+
+/*
+ * Builds a PrivateKeyInfo with the given AlgorithmIdentifier in n[0..2], and
+ * returns the OCTET STRING node taking the private key.
+ */
+static struct der_node *der_PrivateKeyInfo(struct der_node *n,
+                                           struct der_node *algid)
+{
+    der_node(&n[0], DER_SEQUENCE, NULL, 0, NULL);
+    der_node(&n[1], DER_INTEGER, der_version0, sizeof(der_version0), &n[0]);
+    der_node_add(&n[0], algid);
+    return der_node(&n[2], DER_OCTET_STRING, NULL, 0, &n[0]);
+}
+
+/*
+ * Builds an AlgorithmIdentifier with the OID and the NULL parameter used by
+ * the IBM Dilithium and Kyber keys in n[0..2].
+ */
+static struct der_node *der_AlgIdNULL(struct der_node *n,
+                                      const CK_BYTE *oid, CK_ULONG oid_len)
+{
+    der_node(&n[0], DER_SEQUENCE, NULL, 0, NULL);
+    der_node(&n[1], DER_RAW, oid, oid_len, &n[0]);
+    der_node(&n[2], DER_RAW, ber_NULL, ber_NULLLen, &n[0]);
+    return &n[0];
+}
+
+/*
+ * Builds the AlgorithmIdentifier of an EC key with the given curve
+ * parameters in n[0..2].
+ */
+static struct der_node *der_AlgIdEC(struct der_node *n, CK_ATTRIBUTE *params)
+{
+    der_node(&n[0], DER_SEQUENCE, NULL, 0, NULL);
+    der_node(&n[1], DER_RAW, ber_idEC, ber_idECLen, &n[0]);
+    der_attr(&n[2], DER_RAW, params, &n[0]);
+    return &n[0];
+}
+
+/*
+ * Builds the AlgorithmIdentifier of a DSA (base is not NULL) or DH key in
+ * n[0..5].
+ */
+static struct der_node *der_AlgIdDSS(struct der_node *n,
+                                     const CK_BYTE *oid, CK_ULONG oid_len,
+                                     CK_ATTRIBUTE *prime,
+                                     CK_ATTRIBUTE *subprime,
+                                     CK_ATTRIBUTE *base)
+{
+    der_node(&n[0], DER_SEQUENCE, NULL, 0, NULL);
+    der_node(&n[1], DER_RAW, oid, oid_len, &n[0]);
+    der_node(&n[2], DER_SEQUENCE, NULL, 0, &n[0]);
+    der_attr(&n[3], DER_INTEGER, prime, &n[2]);
+    if (subprime != NULL)
+        der_attr(&n[4], DER_INTEGER, subprime, &n[2]);
+    der_attr(&n[5], DER_INTEGER, base, &n[2]);
+    return &n[0];
+}
+
+/*
+ * Extracts the EC point from the BER encoded OCTET STRING of CKA_EC_POINT.
+ */
+static CK_RV der_ec_point(CK_ATTRIBUTE *point, CK_BYTE **ecpoint,
+                          CK_ULONG *ecpoint_len)
+{
+    CK_ULONG field_len;
+    CK_RV rc;
+
+    rc = ber_decode_OCTET_STRING(point->pValue, ecpoint, ecpoint_len,
+                                 &field_len);
+    if (rc != CKR_OK || point->ulValueLen != field_len) {
+        TRACE_DEVEL("ber_decode_OCTET_STRING failed\n");
+        return CKR_ATTRIBUTE_VALUE_INVALID;
+    }
+
+    return CKR_OK;
+}
+
+/*
+ * Same as ber_encode_RSAPrivateKey()
+ */
+CK_RV der_put_RSAPrivateKey(CK_BBOOL length_only,
+                            CK_BYTE **data,
+                            CK_ULONG *data_len,
+                            CK_ATTRIBUTE *modulus,
+                            CK_ATTRIBUTE *publ_exp,
+                            CK_ATTRIBUTE *priv_exp,
+                            CK_ATTRIBUTE *prime1,
+                            CK_ATTRIBUTE *prime2,
+                            CK_ATTRIBUTE *exponent1,
+                            CK_ATTRIBUTE *exponent2,
+                            CK_ATTRIBUTE *coeff)
+{
+    struct der_node n[15], *key;
+
+    der_node(&n[3], DER_RAW, ber_AlgIdRSAEncryption,
+             ber_AlgIdRSAEncryptionLen, NULL);
+    key = der_PrivateKeyInfo(n, &n[3]);
+
+    der_node(&n[4], DER_SEQUENCE, NULL, 0, key);
+    der_node(&n[5], DER_INTEGER, der_version0, sizeof(der_version0), &n[4]);
+    der_attr(&n[6], DER_INTEGER, modulus, &n[4]);
+    der_attr(&n[7], DER_INTEGER, publ_exp, &n[4]);
+    der_attr(&n[8], DER_INTEGER, priv_exp, &n[4]);
+    der_attr(&n[9], DER_INTEGER, prime1, &n[4]);
+    der_attr(&n[10], DER_INTEGER, prime2, &n[4]);
+    der_attr(&n[11], DER_INTEGER, exponent1, &n[4]);
+    der_attr(&n[12], DER_INTEGER, exponent2, &n[4]);
+    der_attr(&n[13], DER_INTEGER, coeff, &n[4]);
+
+    return der_put_tree(length_only, data, data_len, &n[0]);
+}
+
+/*
+ * Same as ber_encode_RSAPublicKey()
+ */
+CK_RV der_put_RSAPublicKey(CK_BBOOL length_only, CK_BYTE **data,
+                           CK_ULONG *data_len, CK_ATTRIBUTE *modulus,
+                           CK_ATTRIBUTE *publ_exp)
+{
+    struct der_node n[6];
+
+    der_node(&n[0], DER_SEQUENCE, NULL, 0, NULL);
+    der_node(&n[1], DER_RAW, ber_AlgIdRSAEncryption,
+             ber_AlgIdRSAEncryptionLen, &n[0]);
+    der_node(&n[2], DER_BIT_STRING, NULL, 0, &n[0]);
+    der_node(&n[3], DER_SEQUENCE, NULL, 0, &n[2]);
+    der_attr(&n[4], DER_INTEGER, modulus, &n[3]);
+    der_attr(&n[5], DER_INTEGER, publ_exp, &n[3]);
+
+    return der_put_tree(length_only, data, data_len, &n[0]);
+}
+
+/*
+ * Same as ber_encode_DSAPrivateKey()
+ */
+CK_RV der_put_DSAPrivateKey(CK_BBOOL length_only,
+                            CK_BYTE **data,
+                            CK_ULONG *data_len,
+                            CK_ATTRIBUTE *prime1,
+                            CK_ATTRIBUTE *prime2,
+                            CK_ATTRIBUTE *base, CK_ATTRIBUTE *priv_key)
+{
+    struct der_node n[10], *key;
+
+    key = der_PrivateKeyInfo(n, der_AlgIdDSS(&n[3], ber_idDSA, ber_idDSALen,
+                                             prime1, prime2, base));
+    der_attr(&n[9], DER_INTEGER, priv_key, key);
+
+    return der_put_tree(length_only, data, data_len, &n[0]);
+}
+
+/*
+ * Same as ber_encode_DSAPublicKey()
+ */
+CK_RV der_put_DSAPublicKey(CK_BBOOL length_only, CK_BYTE **data,
+                           CK_ULONG *data_len, CK_ATTRIBUTE *prime,
+                           CK_ATTRIBUTE *subprime, CK_ATTRIBUTE *base,
+                           CK_ATTRIBUTE *value)
+{
+    struct der_node n[9];
+
+    der_node(&n[0], DER_SEQUENCE, NULL, 0, NULL);
+    der_node_add(&n[0], der_AlgIdDSS(&n[1], ber_idDSA, ber_idDSALen,
+                                     prime, subprime, base));
+    der_node(&n[7], DER_BIT_STRING, NULL, 0, &n[0]);
+    der_attr(&n[8], DER_INTEGER, value, &n[7]);
+
+    return der_put_tree(length_only, data, data_len, &n[0]);
+}
+
+/*
+ * Same as der_encode_ECPrivateKey()
+ */
+CK_RV der_put_ECPrivateKey(CK_BBOOL length_only,
+                           CK_BYTE **data,
+                           CK_ULONG *data_len,
+                           CK_ATTRIBUTE *params,
+                           CK_ATTRIBUTE *point,
+                           CK_ATTRIBUTE *pubkey)
+{
+    struct der_node n[11], *key;
+    CK_BYTE *ecpoint;
+    CK_ULONG ecpoint_len;
+    CK_RV rc;
+
+    key = der_PrivateKeyInfo(n, der_AlgIdEC(&n[3], params));
+
+    der_node(&n[6], DER_SEQUENCE, NULL, 0, key);
+    der_node(&n[7], DER_INTEGER, der_version1, sizeof(der_version1), &n[6]);
+    der_attr(&n[8], DER_OCTET_STRING, point, &n[6]);
+    if (pubkey != NULL && pubkey->pValue != NULL) {
+        rc = der_ec_point(pubkey, &ecpoint, &ecpoint_len);
+        if (rc != CKR_OK)
+            return rc;
+        der_node(&n[9], DER_CHOICE(1), NULL, 0, &n[6]);
+        der_node(&n[10], DER_BIT_STRING, ecpoint, ecpoint_len, &n[9]);
+    }
+
+    return der_put_tree(length_only, data, data_len, &n[0]);
+}
+
+/*
+ * Same as ber_encode_ECPublicKey()
+ */
+CK_RV der_put_ECPublicKey(CK_BBOOL length_only, CK_BYTE **data,
+                          CK_ULONG *data_len, CK_ATTRIBUTE *params,
+                          CK_ATTRIBUTE *point)
+{
+    struct der_node n[5];
+    CK_BYTE *ecpoint;
+    CK_ULONG ecpoint_len;
+    CK_RV rc;
+
+    rc = der_ec_point(point, &ecpoint, &ecpoint_len);
+    if (rc != CKR_OK)
+        return rc;
+
+    der_node(&n[0], DER_SEQUENCE, NULL, 0, NULL);
+    der_node_add(&n[0], der_AlgIdEC(&n[1], params));
+    der_node(&n[4], DER_BIT_STRING, ecpoint, ecpoint_len, &n[0]);
+
+    return der_put_tree(length_only, data, data_len, &n[0]);
+}
+
+/*
+ * Same as ber_encode_DHPrivateKey()
+ */
+CK_RV der_put_DHPrivateKey(CK_BBOOL length_only,
+                           CK_BYTE **data,
+                           CK_ULONG *data_len,
+                           CK_ATTRIBUTE *prime,
+                           CK_ATTRIBUTE *base, CK_ATTRIBUTE *priv_key)
+{
+    struct der_node n[10], *key;
+
+    key = der_PrivateKeyInfo(n, der_AlgIdDSS(&n[3], ber_idDH, ber_idDHLen,
+                                             prime, NULL, base));
+    der_attr(&n[9], DER_INTEGER, priv_key, key);
+
+    return der_put_tree(length_only, data, data_len, &n[0]);
+}
+
+/*
+ * Same as ber_encode_DHPublicKey()
+ */
+CK_RV der_put_DHPublicKey(CK_BBOOL length_only, CK_BYTE **data,
+                          CK_ULONG *data_len, CK_ATTRIBUTE *prime,
+                          CK_ATTRIBUTE *base, CK_ATTRIBUTE *value)
+{
+    struct der_node n[9];
+
+    der_node(&n[0], DER_SEQUENCE, NULL, 0, NULL);
+    der_node_add(&n[0], der_AlgIdDSS(&n[1], ber_idDH, ber_idDHLen,
+                                     prime, NULL, base));
+    der_node(&n[7], DER_BIT_STRING, NULL, 0, &n[0]);
+    der_attr(&n[8], DER_INTEGER, value, &n[7]);
+
+    return der_put_tree(length_only, data, data_len, &n[0]);
+}
+
+/*
+ * Same as ber_encode_IBM_DilithiumPublicKey()
+ */
+CK_RV der_put_IBM_DilithiumPublicKey(CK_BBOOL length_only,
+                                     CK_BYTE **data, CK_ULONG *data_len,
+                                     const CK_BYTE *oid, CK_ULONG oid_len,
+                                     CK_ATTRIBUTE *rho, CK_ATTRIBUTE *t1)
+{
+    struct der_node n[8];
+
+    der_node(&n[0], DER_SEQUENCE, NULL, 0, NULL);
+    der_node_add(&n[0], der_AlgIdNULL(&n[1], oid, oid_len));
+    der_node(&n[4], DER_BIT_STRING, NULL, 0, &n[0]);
+    der_node(&n[5], DER_SEQUENCE, NULL, 0, &n[4]);
+    der_attr(&n[6], DER_BIT_STRING, rho, &n[5]);
+    der_attr(&n[7], DER_BIT_STRING, t1, &n[5]);
+
+    return der_put_tree(length_only, data, data_len, &n[0]);
+}
+
+/*
+ * Same as ber_encode_IBM_DilithiumPrivateKey()
+ */
+CK_RV der_put_IBM_DilithiumPrivateKey(CK_BBOOL length_only,
+                                      CK_BYTE **data,
+                                      CK_ULONG *data_len,
+                                      const CK_BYTE *oid, CK_ULONG oid_len,
+                                      CK_ATTRIBUTE *rho,
+                                      CK_ATTRIBUTE *seed,
+                                      CK_ATTRIBUTE *tr,
+                                      CK_ATTRIBUTE *s1,
+                                      CK_ATTRIBUTE *s2,
+                                      CK_ATTRIBUTE *t0,
+                                      CK_ATTRIBUTE *t1)
+{
+    struct der_node n[16], *key;
+
+    key = der_PrivateKeyInfo(n, der_AlgIdNULL(&n[3], oid, oid_len));
+
+    der_node(&n[6], DER_SEQUENCE, NULL, 0, key);
+    der_node(&n[7], DER_INTEGER, der_version0, sizeof(der_version0), &n[6]);
+    der_attr(&n[8], DER_BIT_STRING, rho, &n[6]);
+    der_attr(&n[9], DER_BIT_STRING, seed, &n[6]);
+    der_attr(&n[10], DER_BIT_STRING, tr, &n[6]);
+    der_attr(&n[11], DER_BIT_STRING, s1, &n[6]);
+    der_attr(&n[12], DER_BIT_STRING, s2, &n[6]);
+    der_attr(&n[13], DER_BIT_STRING, t0, &n[6]);
+    if (t1 != NULL && t1->pValue != NULL) {
+        der_node(&n[14], DER_CHOICE(0), NULL, 0, &n[6]);
+        der_attr(&n[15], DER_BIT_STRING, t1, &n[14]);
+    }
+
+    return der_put_tree(length_only, data, data_len, &n[0]);
+}
+
+/*
+ * Same as ber_encode_IBM_KyberPublicKey()
+ */
+CK_RV der_put_IBM_KyberPublicKey(CK_BBOOL length_only,
+                                 CK_BYTE **data, CK_ULONG *data_len,
+                                 const CK_BYTE *oid, CK_ULONG oid_len,
+                                 CK_ATTRIBUTE *pk)
+{
+    struct der_node n[7];
+
+    der_node(&n[0], DER_SEQUENCE, NULL, 0, NULL);
+    der_node_add(&n[0], der_AlgIdNULL(&n[1], oid, oid_len));
+    der_node(&n[4], DER_BIT_STRING, NULL, 0, &n[0]);
+    der_node(&n[5], DER_SEQUENCE, NULL, 0, &n[4]);
+    der_attr(&n[6], DER_BIT_STRING, pk, &n[5]);
+
+    return der_put_tree(length_only, data, data_len, &n[0]);
+}
+
+/*
+ * Same as ber_encode_IBM_KyberPrivateKey()
+ */
+CK_RV der_put_IBM_KyberPrivateKey(CK_BBOOL length_only,
+                                  CK_BYTE **data,
+                                  CK_ULONG *data_len,
+                                  const CK_BYTE *oid, CK_ULONG oid_len,
+                                  CK_ATTRIBUTE *sk,
+                                  CK_ATTRIBUTE *pk)
+{
+    /* the 2x32 bytes rs appended to pk, as in ber_encode_IBM_KyberPrivateKey */
+    static const CK_BYTE rs[64] = {
+        0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30,
+        0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30,
+        0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30,
+        0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30,
+        0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30,
+        0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30,
+        0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30,
+        0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30,
+    };
+    struct der_node n[13], *key;
+
+    key = der_PrivateKeyInfo(n, der_AlgIdNULL(&n[3], oid, oid_len));
+
+    der_node(&n[6], DER_SEQUENCE, NULL, 0, key);
+    der_node(&n[7], DER_INTEGER, der_version0, sizeof(der_version0), &n[6]);
+    der_attr(&n[8], DER_BIT_STRING, sk, &n[6]);
+    if (pk != NULL && pk->pValue != NULL) {
+        der_node(&n[9], DER_CHOICE(0), NULL, 0, &n[6]);
+        der_node(&n[10], DER_BIT_STRING, NULL, 0, &n[9]);
+        der_attr(&n[11], DER_RAW, pk, &n[10]);
+        der_node(&n[12], DER_RAW, rs, sizeof(rs), &n[10]);
+    }
+
+    return der_put_tree(length_only, data, data_len, &n[0]);
+}
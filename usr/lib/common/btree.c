@@ -339,6 +339,7 @@ void *bt_node_free(struct btree *t, unsigned long node_num,
         node->value = t->free_list;
         t->free_list = node;
         t->free_nodes++;
+        __sync_add_and_fetch(&t->free_gen, 1);
 
         TRACE_DEBUG("bt_node_free: Btree: %p Value: %p Ref: %lu\n", (void *)t,
                     value, ((struct bt_ref_hdr *)value)->ref);
@@ -390,20 +391,89 @@ unsigned long bt_nodes_in_use(struct btree *t)
     return rc;
 }
 
-/* bt_for_each_node
- *
- * For each non-free'd node in the tree, run @func on it
+/*
+ * One entry of a btree snapshot, indexed by node handle - 1. The value is NULL
+ * for free'd nodes.
+ */
+struct bt_snapshot_entry {
+    struct btnode *node;
+    void *value;
+};
+
+/*
+ * __bt_snapshot() - Low level function, needs proper locking before
+ * invocation.
  *
- * @func:
- *  p1 is the node's value
- *  p2 is the node's handle
- *  p3 is passed through this function for the caller
+ * Walk the subtree starting at @n, which has handle @handle, and record each
+ * non-free'd node and its value in @snap, taking a reference on the value.
+ * A node's handle is made up of the path from the root, with the first
+ * branch in the least significant bit. Thus a child of a node at depth d
+ * adds 2^d (left) or 2^(d+1) (right) to its parent's handle. @step is 2^d.
  */
-void bt_for_each_node(STDLL_TokData_t *tokdata, struct btree *t, void (*func)
-                      (STDLL_TokData_t *tokdata, void *p1, unsigned long p2,
-                      void *p3), void *p3)
+static void __bt_snapshot(struct btnode *n, unsigned long handle,
+                          unsigned long step, struct bt_snapshot_entry *snap,
+                          unsigned long size)
 {
-    unsigned int i;
+    while (n != NULL && handle <= size) {
+        if (!(n->flags & BT_FLAG_FREE)) {
+            snap[handle - 1].node = n;
+            snap[handle - 1].value = n->value;
+            __sync_add_and_fetch(&((struct bt_ref_hdr *)n->value)->ref, 1);
+        }
+
+        __bt_snapshot(n->left, handle + step, step << 1, snap, size);
+
+        /* Continue with the right subtree without recursion */
+        n = n->right;
+        handle += step << 1;
+        step <<= 1;
+    }
+}
+
+/*
+ * Check the remaining @n snapshot entries again after nodes were free'd, and
+ * clear the node of each entry whose node was free'd (and possibly reused).
+ * The value's reference is kept, it is dropped by the caller. Returns the
+ * free generation the entries are now valid for.
+ */
+static unsigned long bt_snapshot_recheck(struct btree *t,
+                                         struct bt_snapshot_entry *snap,
+                                         unsigned long n)
+{
+    unsigned long gen, i;
+    int locked;
+
+    locked = (pthread_mutex_lock(&t->mutex) == 0);
+    if (!locked)
+        TRACE_ERROR("BTree Lock failed.\n");
+
+    for (i = 0; i < n; i++) {
+        if (snap[i].node == NULL)
+            continue;
+        if (!locked || (snap[i].node->flags & BT_FLAG_FREE) ||
+            snap[i].node->value != snap[i].value)
+            snap[i].node = NULL;
+    }
+
+    gen = t->free_gen;
+    if (locked)
+        pthread_mutex_unlock(&t->mutex);
+
+    return gen;
+}
+
+/*
+ * Iterate the tree node by node, looking up each node from the root. Used
+ * when there is not enough memory for a snapshot.
+ */
+static void bt_for_each_node_by_index(STDLL_TokData_t *tokdata,
+                                      struct btree *t,
+                                      void (*func)(STDLL_TokData_t *tokdata,
+                                                   void *p1, unsigned long p2,
+                                                   void *p3),
+                                      void *p3)
+{
+    unsigned long i;
     void *value;
 
     for (i = 1; i < t->size + 1; i++) {
@@ -425,6 +495,73 @@ void bt_for_each_node(STDLL_TokData_t *tokdata, struct btree *t, void (*func)
     }
 }
 
+/* bt_for_each_node
+ *
+ * For each non-free'd node in the tree, run @func on it
+ *
+ * The tree is walked once under the tree lock, taking a reference on each
+ * node's value. The callbacks are then run without holding the lock, in
+ * ascending handle order. Nodes added while iterating are not visited. A node
+ * that was free'd (and possibly reused) by a previous callback or another
+ * thread is skipped. The lock is only taken again if nodes were free'd since
+ * the snapshot, to check all remaining entries at once.
+ *
+ * @func:
+ *  p1 is the node's value
+ *  p2 is the node's handle
+ *  p3 is passed through this function for the caller
+ */
+void bt_for_each_node(STDLL_TokData_t *tokdata, struct btree *t, void (*func)
+                      (STDLL_TokData_t *tokdata, void *p1, unsigned long p2,
+                      void *p3), void *p3)
+{
+    struct bt_snapshot_entry *snap;
+    unsigned long size, gen, i;
+
+    if (pthread_mutex_lock(&t->mutex)) {
+        TRACE_ERROR("BTree Lock failed.\n");
+        return;
+    }
+
+    size = t->size;
+    if (size == 0 || t->free_nodes == size) {
+        pthread_mutex_unlock(&t->mutex);
+        return;
+    }
+
+    snap = calloc(size, sizeof(*snap));
+    if (snap == NULL) {
+        pthread_mutex_unlock(&t->mutex);
+        TRACE_DEVEL("No memory for btree snapshot, iterate by index\n");
+        bt_for_each_node_by_index(tokdata, t, func, p3);
+        return;
+    }
+
+    __bt_snapshot(t->top, 1, 1, snap, size);
+    gen = t->free_gen;
+
+    pthread_mutex_unlock(&t->mutex);
+
+    for (i = 0; i < size; i++) {
+        if (snap[i].value == NULL)
+            continue;
+
+        /*
+         * The nodes themselves are never freed while the tree exists, so
+         * checking them does not require a lookup from the root.
+         */
+        if (__sync_fetch_and_add(&t->free_gen, 0) != gen)
+            gen = bt_snapshot_recheck(t, &snap[i], size - i);
+
+        if (snap[i].node != NULL)
+            (*func) (tokdata, snap[i].value, i + 1, p3);
+
+        bt_put_node_value(t, snap[i].value);
+    }
+
+    free(snap);
+}
+
 /* bt_destroy
  *
  * Walk a binary tree backwards (largest index to smallest), deleting nodes
@@ -496,6 +633,7 @@ CK_RV bt_init(struct btree *t, void (*delete_func)(void *))
     t->top = NULL;
     t->size = 0;
     t->free_nodes = 0;
+    t->free_gen = 0;
     t->delete_func = delete_func;
 
     /*
@@ -14,4 +14,4 @@ noinst_HEADERS +=							\
 	usr/lib/common/stringtranslations.h usr/lib/common/aix/asprintf.h \
 	usr/lib/common/aix/endian.h usr/lib/common/aix/err.h \
 	usr/lib/common/aix/getopt.h usr/lib/common/aix/secure_getenv.h \
-	usr/lib/common/platform.h
+	usr/lib/common/platform.h usr/lib/common/hsm_mk_change_lock.h
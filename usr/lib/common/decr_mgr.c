@@ -27,16 +27,19 @@
 #include "../api/policy.h"
 #include "../api/statistics.h"
 
-//
-//
-CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
-                    SESSION *sess,
-                    ENCR_DECR_CONTEXT *ctx,
-                    CK_ULONG operation,
-                    CK_MECHANISM *mech, CK_OBJECT_HANDLE key_handle,
-                    CK_BBOOL checkpolicy, CK_BBOOL checkauth)
+/*
+ * Initializes a decrypt or unwrap operation with a key object that has
+ * already been looked up. The key object must be READ locked by the caller,
+ * and it is still held and READ locked on return.
+ */
+CK_RV decr_mgr_init_key_obj(STDLL_TokData_t *tokdata,
+                            SESSION *sess,
+                            ENCR_DECR_CONTEXT *ctx,
+                            CK_ULONG operation,
+                            CK_MECHANISM *mech, CK_OBJECT_HANDLE key_handle,
+                            OBJECT *key_obj, CK_BBOOL checkpolicy,
+                            CK_BBOOL checkauth)
 {
-    OBJECT *key_obj = NULL;
     CK_BYTE *ptr = NULL;
     CK_KEY_TYPE keytype;
     CK_BBOOL flag;
@@ -57,14 +60,6 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
     // key usage restrictions
     //
     if (operation == OP_DECRYPT_INIT) {
-        rc = object_mgr_find_in_map1(tokdata, key_handle, &key_obj, READ_LOCK);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("Failed to acquire key from specified handle.\n");
-            if (rc == CKR_OBJECT_HANDLE_INVALID)
-                return CKR_KEY_HANDLE_INVALID;
-            else
-                return rc;
-        }
         // is key allowed to do general decryption?
         //
         rc = template_attribute_get_bool(key_obj->template, CKA_DECRYPT, &flag);
@@ -81,13 +76,6 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
         check = POLICY_CHECK_DECRYPT;
     } else if (operation == OP_UNWRAP) {
-        rc = object_mgr_find_in_map1(tokdata, key_handle, &key_obj, READ_LOCK);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("Failed to acquire  key from specified handle.\n");
-            if (rc == CKR_OBJECT_HANDLE_INVALID)
-                rc = CKR_WRAPPING_KEY_HANDLE_INVALID;
-            goto done;
-        }
         // is key allowed to unwrap other keys?
         //
         rc = template_attribute_get_bool(key_obj->template, CKA_UNWRAP, &flag);
@@ -170,7 +158,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         //       goto done;
 
         ctx->context_len = sizeof(DES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(DES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -209,7 +197,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         //       goto done;
 
         ctx->context_len = sizeof(DES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(DES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -241,7 +229,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(DES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(DES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -278,7 +266,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         //       goto done;
 
         ctx->context_len = sizeof(DES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(DES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -317,7 +305,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         //       goto done;
 
         ctx->context_len = sizeof(DES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(DES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -399,7 +387,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(AES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -432,7 +420,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(AES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -462,7 +450,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(AES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -502,7 +490,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(AES_GCM_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_GCM_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -513,10 +501,15 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         strength = key_obj->strength.strength;
 
         /* Release obj lock, token specific aes-gcm may re-acquire the lock */
-        object_put(tokdata, key_obj, TRUE);
-        key_obj = NULL;
+        object_unlock(key_obj);
 
         rc = aes_gcm_init(tokdata, sess, ctx, mech, key_handle, 0);
+
+        if (object_lock(key_obj, READ_LOCK) != CKR_OK) {
+            TRACE_ERROR("Failed to re-acquire the key object lock.\n");
+            rc = CKR_CANT_LOCK;
+            goto done;
+        }
         if (rc) {
             TRACE_ERROR("Could not initialize AES_GCM parms.\n");
             rc = CKR_FUNCTION_FAILED;
@@ -548,7 +541,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(AES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -578,7 +571,7 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(AES_XTS_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_XTS_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -633,6 +626,47 @@ done:
     if (ctx->count_statistics == TRUE && rc == CKR_OK)
          INC_COUNTER(tokdata, sess, mech, key_obj, strength);
 
+    return rc;
+}
+
+//
+//
+CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
+                    SESSION *sess,
+                    ENCR_DECR_CONTEXT *ctx,
+                    CK_ULONG operation,
+                    CK_MECHANISM *mech, CK_OBJECT_HANDLE key_handle,
+                    CK_BBOOL checkpolicy, CK_BBOOL checkauth)
+{
+    OBJECT *key_obj = NULL;
+    CK_RV rc;
+
+    if (!sess) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+    if (ctx->active != FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        return CKR_OPERATION_ACTIVE;
+    }
+    if (operation != OP_DECRYPT_INIT && operation != OP_UNWRAP) {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    rc = object_mgr_find_in_map1(tokdata, key_handle, &key_obj, READ_LOCK);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Failed to acquire key from specified handle.\n");
+        if (rc == CKR_OBJECT_HANDLE_INVALID)
+            return operation == OP_UNWRAP ? CKR_WRAPPING_KEY_HANDLE_INVALID :
+                                            CKR_KEY_HANDLE_INVALID;
+        else
+            return rc;
+    }
+
+    rc = decr_mgr_init_key_obj(tokdata, sess, ctx, operation, mech, key_handle,
+                               key_obj, checkpolicy, checkauth);
+
     object_put(tokdata, key_obj, TRUE);
     key_obj = NULL;
 
@@ -680,7 +714,8 @@ CK_RV decr_mgr_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
             ctx->context_free_func(tokdata, sess, ctx->context,
                                    ctx->context_len);
         else
-            free(ctx->context);
+            session_mgr_free_context(tokdata, sess, ctx->context,
+                                     ctx->context_len);
         ctx->context = NULL;
     }
     ctx->context_len = 0;
@@ -1014,6 +1049,84 @@ CK_RV decr_mgr_decrypt_update(STDLL_TokData_t *tokdata,
     return CKR_FUNCTION_FAILED;
 }
 
+/*
+ * Decrypts the data and passes the decrypted data to an active digest or
+ * verify operation (C_DecryptDigestUpdate and C_DecryptVerifyUpdate).
+ * Exactly one of digest_ctx and verify_ctx must be specified.
+ *
+ * Large buffers are processed in chunks like in
+ * encr_mgr_encrypt_dual_update(), each decrypted chunk is digested or
+ * verified while it is still cached.
+ */
+CK_RV decr_mgr_decrypt_dual_update(STDLL_TokData_t *tokdata, SESSION *sess,
+                                   ENCR_DECR_CONTEXT *decr_ctx,
+                                   DIGEST_CONTEXT *digest_ctx,
+                                   SIGN_VERIFY_CONTEXT *verify_ctx,
+                                   CK_BYTE *in_data, CK_ULONG in_data_len,
+                                   CK_BYTE *out_data, CK_ULONG *out_data_len)
+{
+    CK_MECHANISM_TYPE mech2;
+    CK_ULONG chunk, len, out_len = 0, total = 0, done = 0;
+    CK_RV rc;
+
+    if (!sess || !decr_ctx || (digest_ctx == NULL) == (verify_ctx == NULL) ||
+        !out_data || !out_data_len) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    rc = decr_mgr_decrypt_update(tokdata, sess, TRUE, decr_ctx,
+                                 in_data, in_data_len, NULL, &out_len);
+    if (rc != CKR_OK)
+        return rc;
+    if (*out_data_len < out_len) {
+        *out_data_len = out_len;
+        TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    mech2 = digest_ctx != NULL ? digest_ctx->mech.mechanism :
+                                 verify_ctx->mech.mechanism;
+    chunk = in_data_len;
+    if (in_data_len > DUAL_FUNCTION_CHUNK_SIZE &&
+        !ock_generic_mechanism_is_hw(tokdata, decr_ctx->mech.mechanism) &&
+        !ock_generic_mechanism_is_hw(tokdata, mech2))
+        chunk = DUAL_FUNCTION_CHUNK_SIZE;
+
+    do {
+        len = MIN(chunk, in_data_len - done);
+
+        out_len = *out_data_len - total;
+        rc = decr_mgr_decrypt_update(tokdata, sess, FALSE, decr_ctx,
+                                     in_data + done, len,
+                                     out_data + total, &out_len);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("decr_mgr_decrypt_update() failed.\n");
+            return rc;
+        }
+
+        if (digest_ctx != NULL) {
+            if (out_len > 0)
+                rc = digest_mgr_digest_update(tokdata, sess, digest_ctx,
+                                              out_data + total, out_len);
+        } else {
+            rc = verify_mgr_verify_update(tokdata, sess, verify_ctx,
+                                          out_data + total, out_len);
+        }
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("Digest or verify update failed.\n");
+            return rc;
+        }
+
+        total += out_len;
+        done += len;
+    } while (done < in_data_len);
+
+    *out_data_len = total;
+
+    return CKR_OK;
+}
+
 //
 //
 CK_RV decr_mgr_decrypt_final(STDLL_TokData_t *tokdata,
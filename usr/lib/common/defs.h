@@ -94,6 +94,12 @@ enum {
 #define ENCRYPT 1
 #define DECRYPT 0
 
+// fused dual-function updates (C_DigestEncryptUpdate etc.) process the
+// data in chunks of this size, so that a chunk is still cached when it is
+// passed to the second operation
+//
+#define DUAL_FUNCTION_CHUNK_SIZE  (64 * 1024)
+
 #define MAX_RSA_KEYLEN  (OPENSSL_RSA_MAX_MODULUS_BITS / 8)
 
 #define AES_KEY_SIZE_256 32
@@ -161,6 +167,13 @@ struct oc_sha_ctx {
 
 #define MAX_TOK_OBJS 2048
 
+/*
+ * Operation contexts of up to SESS_CTX_ARENA_CHUNK_SIZE bytes are taken from
+ * a per-session arena of SESS_CTX_ARENA_CHUNKS chunks (at most 32).
+ */
+#define SESS_CTX_ARENA_CHUNKS       16
+#define SESS_CTX_ARENA_CHUNK_SIZE   256
+
 
 typedef enum {
     ALL = 1,
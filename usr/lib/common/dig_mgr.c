@@ -16,6 +16,7 @@
 #include <pthread.h>
 #include <string.h>             // for memcmp() et al
 #include <stdlib.h>
+#include <limits.h>
 
 #include "pkcs11types.h"
 #include "defs.h"
@@ -90,7 +91,7 @@ CK_RV digest_mgr_init(STDLL_TokData_t *tokdata,
             return CKR_MECHANISM_PARAM_INVALID;
         }
         ctx->context_len = sizeof(MD2_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(MD2_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             digest_mgr_cleanup(tokdata, sess, ctx);    // to de-initialize context above
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
@@ -167,7 +168,8 @@ CK_RV digest_mgr_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
             ctx->context_free_func(tokdata, sess, ctx->context,
                                    ctx->context_len);
         else
-            free(ctx->context);
+            session_mgr_free_context(tokdata, sess, ctx->context,
+                                     ctx->context_len);
         ctx->context = NULL;
     }
     ctx->context_len = 0;
@@ -496,3 +498,104 @@ out:
 
     return rc;
 }
+
+
+//
+// Digests count independent messages with one mechanism. The digests are
+// returned back to back in out_data, each with the digest length of the
+// mechanism. The messages are digested with a temporary context, so that a
+// digest operation active in the session is not affected.
+//
+CK_RV digest_mgr_digest_batch(STDLL_TokData_t *tokdata, SESSION *sess,
+                              CK_BBOOL length_only, CK_MECHANISM *mech,
+                              CK_ULONG count, CK_BYTE **in_data,
+                              CK_ULONG *in_data_len, CK_BYTE *out_data,
+                              CK_ULONG *out_data_len)
+{
+    static CK_BYTE empty;
+    DIGEST_CONTEXT ctx;
+    CK_ULONG hlen, len, i;
+    CK_RV rc;
+
+    if (!sess || !mech || !out_data_len) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    /* Only empty messages may come without a data pointer */
+    for (i = 0; i < count; i++) {
+        if (in_data[i] == NULL && in_data_len[i] != 0) {
+            TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+            return CKR_ARGUMENTS_BAD;
+        }
+    }
+
+    /* The policy is checked once for the batch */
+    rc = tokdata->policy->is_mech_allowed(tokdata->policy, mech, NULL,
+                                          POLICY_CHECK_DIGEST, sess);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("POLICY VIOLATION: digest batch\n");
+        return rc;
+    }
+
+    /* Get the digest length, this also checks the mechanism */
+    memset(&ctx, 0, sizeof(ctx));
+    rc = digest_mgr_init(tokdata, sess, &ctx, mech, FALSE);
+    if (rc != CKR_OK)
+        return rc;
+    rc = digest_mgr_digest(tokdata, sess, TRUE, &ctx, &empty, 0, NULL, &hlen);
+    digest_mgr_cleanup(tokdata, sess, &ctx);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (hlen > 0 && count > ULONG_MAX / hlen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    if (length_only == TRUE) {
+        *out_data_len = count * hlen;
+        return CKR_OK;
+    }
+
+    if (*out_data_len < count * hlen) {
+        *out_data_len = count * hlen;
+        TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    if (count > 0 && token_specific.t_sha_batch != NULL) {
+        rc = token_specific.t_sha_batch(tokdata, mech, count, in_data,
+                                        in_data_len, out_data);
+        if (rc != CKR_MECHANISM_INVALID)
+            goto done;
+    }
+
+    rc = CKR_OK;
+    /* Tokens without a batch function digest the messages one by one */
+    for (i = 0; i < count; i++) {
+        rc = digest_mgr_init(tokdata, sess, &ctx, mech, FALSE);
+        if (rc != CKR_OK)
+            goto done;
+
+        len = hlen;
+        rc = digest_mgr_digest(tokdata, sess, FALSE, &ctx,
+                               in_data[i] != NULL ? in_data[i] : &empty,
+                               in_data_len[i], out_data + i * hlen, &len);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("digest_mgr_digest failed for message %lu.\n", i);
+            goto done;
+        }
+    }
+
+done:
+    if (rc == CKR_OK) {
+        *out_data_len = count * hlen;
+
+        /* Each message counts as one digest operation */
+        for (i = 0; i < count; i++)
+            INC_COUNTER(tokdata, sess, mech, NULL, POLICY_STRENGTH_IDX_0);
+    }
+
+    return rc;
+}
@@ -29,16 +29,18 @@
 
 #include <openssl/crypto.h>
 
-//
-//
-CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
-                    SESSION *sess,
-                    ENCR_DECR_CONTEXT *ctx,
-                    CK_ULONG operation,
-                    CK_MECHANISM *mech, CK_OBJECT_HANDLE key_handle,
-                    CK_BBOOL checkpolicy)
+/*
+ * Initializes an encrypt or wrap operation with a key object that has
+ * already been looked up. The key object must be READ locked by the caller,
+ * and it is still held and READ locked on return.
+ */
+CK_RV encr_mgr_init_key_obj(STDLL_TokData_t *tokdata,
+                            SESSION *sess,
+                            ENCR_DECR_CONTEXT *ctx,
+                            CK_ULONG operation,
+                            CK_MECHANISM *mech, CK_OBJECT_HANDLE key_handle,
+                            OBJECT *key_obj, CK_BBOOL checkpolicy)
 {
-    OBJECT *key_obj = NULL;
     CK_BYTE *ptr = NULL;
     CK_KEY_TYPE keytype;
     CK_BBOOL flag;
@@ -59,14 +61,6 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
     // key usage restrictions
     //
     if (operation == OP_ENCRYPT_INIT) {
-        rc = object_mgr_find_in_map1(tokdata, key_handle, &key_obj, READ_LOCK);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("Failed to acquire key from specified handle.\n");
-            if (rc == CKR_OBJECT_HANDLE_INVALID)
-                return CKR_KEY_HANDLE_INVALID;
-            else
-                return rc;
-        }
         // is key allowed to do general encryption?
         //
         rc = template_attribute_get_bool(key_obj->template, CKA_ENCRYPT, &flag);
@@ -83,14 +77,6 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
         check = POLICY_CHECK_ENCRYPT;
     } else if (operation == OP_WRAP) {
-        rc = object_mgr_find_in_map1(tokdata, key_handle, &key_obj, READ_LOCK);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("Failed to acquire key from specified handle.\n");
-            if (rc == CKR_OBJECT_HANDLE_INVALID)
-                return CKR_WRAPPING_KEY_HANDLE_INVALID;
-            else
-                return rc;
-        }
         // is key allowed to wrap other keys?
         //
         rc = template_attribute_get_bool(key_obj->template, CKA_WRAP, &flag);
@@ -162,7 +148,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         //       goto done;
 
         ctx->context_len = sizeof(DES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(DES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -201,7 +187,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         //       goto done;
 
         ctx->context_len = sizeof(DES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(DES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -233,7 +219,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(DES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(DES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -270,7 +256,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         //       goto done;
 
         ctx->context_len = sizeof(DES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(DES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -309,7 +295,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         //       goto done;
 
         ctx->context_len = sizeof(DES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(DES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -391,7 +377,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(AES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -424,7 +410,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(AES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -454,7 +440,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(AES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -494,7 +480,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(AES_GCM_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_GCM_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -505,10 +491,15 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         strength = key_obj->strength.strength;
 
         /* Release obj lock, token specific aes-gcm may re-acquire the lock */
-        object_put(tokdata, key_obj, TRUE);
-        key_obj = NULL;
+        object_unlock(key_obj);
 
         rc = aes_gcm_init(tokdata, sess, ctx, mech, key_handle, 1);
+
+        if (object_lock(key_obj, READ_LOCK) != CKR_OK) {
+            TRACE_ERROR("Failed to re-acquire the key object lock.\n");
+            rc = CKR_CANT_LOCK;
+            goto done;
+        }
         if (rc != CKR_OK) {
             TRACE_ERROR("Could not initialize AES_GCM parms.\n");
             rc = CKR_FUNCTION_FAILED;
@@ -540,7 +531,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(AES_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -570,7 +561,7 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
         }
 
         ctx->context_len = sizeof(AES_XTS_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_XTS_CONTEXT));
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rc = CKR_HOST_MEMORY;
@@ -625,6 +616,47 @@ done:
     if (ctx->count_statistics == TRUE && rc == CKR_OK)
         INC_COUNTER(tokdata, sess, mech, key_obj, strength);
 
+    return rc;
+}
+
+//
+//
+CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
+                    SESSION *sess,
+                    ENCR_DECR_CONTEXT *ctx,
+                    CK_ULONG operation,
+                    CK_MECHANISM *mech, CK_OBJECT_HANDLE key_handle,
+                    CK_BBOOL checkpolicy)
+{
+    OBJECT *key_obj = NULL;
+    CK_RV rc;
+
+    if (!sess || !ctx || !mech) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+    if (ctx->active != FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        return CKR_OPERATION_ACTIVE;
+    }
+    if (operation != OP_ENCRYPT_INIT && operation != OP_WRAP) {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    rc = object_mgr_find_in_map1(tokdata, key_handle, &key_obj, READ_LOCK);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Failed to acquire key from specified handle.\n");
+        if (rc == CKR_OBJECT_HANDLE_INVALID)
+            return operation == OP_WRAP ? CKR_WRAPPING_KEY_HANDLE_INVALID :
+                                            CKR_KEY_HANDLE_INVALID;
+        else
+            return rc;
+    }
+
+    rc = encr_mgr_init_key_obj(tokdata, sess, ctx, operation, mech, key_handle,
+                               key_obj, checkpolicy);
+
     object_put(tokdata, key_obj, TRUE);
     key_obj = NULL;
 
@@ -671,7 +703,8 @@ CK_RV encr_mgr_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
             ctx->context_free_func(tokdata, sess, ctx->context,
                                    ctx->context_len);
         else
-            free(ctx->context);
+            session_mgr_free_context(tokdata, sess, ctx->context,
+                                     ctx->context_len);
         ctx->context = NULL;
     }
     ctx->context_len = 0;
@@ -974,6 +1007,90 @@ CK_RV encr_mgr_encrypt_update(STDLL_TokData_t *tokdata,
     return CKR_FUNCTION_FAILED;
 }
 
+/*
+ * Encrypts the data and passes the clear data to an active digest or sign
+ * operation (C_DigestEncryptUpdate and C_SignEncryptUpdate). Exactly one of
+ * digest_ctx and sign_ctx must be specified.
+ *
+ * If the token performs both mechanisms in software, large buffers are
+ * processed in chunks of DUAL_FUNCTION_CHUNK_SIZE bytes, each chunk is
+ * digested or signed and then encrypted while it is still cached. Otherwise
+ * the whole buffer is passed to both operations one after the other, to not
+ * increase the number of requests to the hardware.
+ *
+ * The clear data is passed to the second operation before it is encrypted,
+ * so the data can be encrypted in place.
+ */
+CK_RV encr_mgr_encrypt_dual_update(STDLL_TokData_t *tokdata, SESSION *sess,
+                                   ENCR_DECR_CONTEXT *encr_ctx,
+                                   DIGEST_CONTEXT *digest_ctx,
+                                   SIGN_VERIFY_CONTEXT *sign_ctx,
+                                   CK_BYTE *in_data, CK_ULONG in_data_len,
+                                   CK_BYTE *out_data, CK_ULONG *out_data_len)
+{
+    CK_MECHANISM_TYPE mech2;
+    CK_ULONG chunk, len, out_len = 0, total = 0, done = 0;
+    CK_RV rc;
+
+    if (!sess || !encr_ctx || (digest_ctx == NULL) == (sign_ctx == NULL) ||
+        !out_data || !out_data_len) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    /* Check the output buffer before the second operation consumes data */
+    rc = encr_mgr_encrypt_update(tokdata, sess, TRUE, encr_ctx,
+                                 in_data, in_data_len, NULL, &out_len);
+    if (rc != CKR_OK)
+        return rc;
+    if (*out_data_len < out_len) {
+        *out_data_len = out_len;
+        TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
+        return CKR_BUFFER_TOO_SMALL;
+    }
+
+    mech2 = digest_ctx != NULL ? digest_ctx->mech.mechanism :
+                                 sign_ctx->mech.mechanism;
+    chunk = in_data_len;
+    if (in_data_len > DUAL_FUNCTION_CHUNK_SIZE &&
+        !ock_generic_mechanism_is_hw(tokdata, encr_ctx->mech.mechanism) &&
+        !ock_generic_mechanism_is_hw(tokdata, mech2))
+        chunk = DUAL_FUNCTION_CHUNK_SIZE;
+
+    do {
+        len = MIN(chunk, in_data_len - done);
+
+        if (digest_ctx != NULL) {
+            if (len > 0)
+                rc = digest_mgr_digest_update(tokdata, sess, digest_ctx,
+                                              in_data + done, len);
+        } else {
+            rc = sign_mgr_sign_update(tokdata, sess, sign_ctx,
+                                      in_data + done, len);
+        }
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("Digest or sign update failed.\n");
+            return rc;
+        }
+
+        out_len = *out_data_len - total;
+        rc = encr_mgr_encrypt_update(tokdata, sess, FALSE, encr_ctx,
+                                     in_data + done, len,
+                                     out_data + total, &out_len);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("encr_mgr_encrypt_update() failed.\n");
+            return rc;
+        }
+
+        total += out_len;
+        done += len;
+    } while (done < in_data_len);
+
+    *out_data_len = total;
+
+    return CKR_OK;
+}
+
 //
 //
 CK_RV
@@ -1086,6 +1203,201 @@ encr_mgr_encrypt_final(STDLL_TokData_t *tokdata,
     return CKR_FUNCTION_FAILED;
 }
 
+/*
+ * Checks the decryption and the encryption mechanism of a re-encrypt operation
+ * against the policy. The key objects must be READ locked.
+ */
+static CK_RV encr_mgr_reencrypt_check_policy(STDLL_TokData_t *tokdata,
+                                             SESSION *sess,
+                                             CK_MECHANISM *decr_mech,
+                                             OBJECT *decr_key_obj,
+                                             CK_MECHANISM *encr_mech,
+                                             OBJECT *encr_key_obj)
+{
+    CK_RV rc;
+
+    rc = tokdata->policy->is_mech_allowed(tokdata->policy, decr_mech,
+                                          &decr_key_obj->strength,
+                                          POLICY_CHECK_DECRYPT, sess);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("POLICY VIOLATION: Reencrypt_single decryption\n");
+        return rc;
+    }
+    rc = tokdata->policy->is_mech_allowed(tokdata->policy, encr_mech,
+                                          &encr_key_obj->strength,
+                                          POLICY_CHECK_ENCRYPT, sess);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("POLICY VIOLATION: Reencrypt_single encryption\n");
+        return rc;
+    }
+
+    return CKR_OK;
+}
+
+/*
+ * Gets the decryption and the encryption key of a re-encrypt operation and
+ * checks that they may be used with the respective mechanism.
+ */
+static CK_RV encr_mgr_reencrypt_get_keys(STDLL_TokData_t *tokdata,
+                                         SESSION *sess,
+                                         CK_MECHANISM *decr_mech,
+                                         CK_OBJECT_HANDLE decr_key,
+                                         CK_MECHANISM *encr_mech,
+                                         CK_OBJECT_HANDLE encr_key,
+                                         OBJECT **decr_key_obj,
+                                         OBJECT **encr_key_obj)
+{
+    CK_BBOOL flag;
+    CK_RV rc;
+
+    rc = object_mgr_find_in_map1(tokdata, decr_key, decr_key_obj, READ_LOCK);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Failed to acquire decr-key from specified handle.\n");
+        if (rc == CKR_OBJECT_HANDLE_INVALID)
+            return CKR_KEY_HANDLE_INVALID;
+        else
+            return rc;
+    }
+
+    rc = object_mgr_find_in_map1(tokdata, encr_key, encr_key_obj, READ_LOCK);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Failed to acquire encr-key from specified handle.\n");
+        if (rc == CKR_OBJECT_HANDLE_INVALID)
+            rc = CKR_KEY_HANDLE_INVALID;
+        goto error;
+    }
+    rc = encr_mgr_reencrypt_check_policy(tokdata, sess, decr_mech,
+                                         *decr_key_obj, encr_mech,
+                                         *encr_key_obj);
+    if (rc != CKR_OK)
+        goto error;
+
+    if (!key_object_is_mechanism_allowed((*decr_key_obj)->template,
+                                         decr_mech->mechanism)) {
+        TRACE_ERROR("Decrypt mechanism not allwed per "
+                    "CKA_ALLOWED_MECHANISMS.\n");
+        rc = CKR_MECHANISM_INVALID;
+        goto error;
+    }
+
+    if (!key_object_is_mechanism_allowed((*encr_key_obj)->template,
+                                         encr_mech->mechanism)) {
+        TRACE_ERROR("Encrypt mechanism not allwed per "
+                    "CKA_ALLOWED_MECHANISMS.\n");
+        rc = CKR_MECHANISM_INVALID;
+        goto error;
+    }
+
+    rc = template_attribute_get_bool((*decr_key_obj)->template, CKA_DECRYPT,
+                                     &flag);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Could not find CKA_DECRYPT for the key.\n");
+        rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
+        goto error;
+    }
+
+    if (flag != TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_KEY_FUNCTION_NOT_PERMITTED));
+        rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
+        goto error;
+    }
+
+    rc = template_attribute_get_bool((*encr_key_obj)->template, CKA_ENCRYPT,
+                                     &flag);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Could not find CKA_ENCRYPT for the key.\n");
+        rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
+        goto error;
+    }
+
+    if (flag != TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_KEY_FUNCTION_NOT_PERMITTED));
+        rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
+        goto error;
+    }
+
+    return CKR_OK;
+
+error:
+    object_put(tokdata, *decr_key_obj, TRUE);
+    *decr_key_obj = NULL;
+    object_put(tokdata, *encr_key_obj, TRUE);
+    *encr_key_obj = NULL;
+
+    return rc;
+}
+
+/*
+ * Re-encrypts the data with a decrypt and an encrypt operation, for tokens
+ * without a token specific reencrypt_single function. The key objects must be
+ * held by the caller, but not be locked, they are only READ locked while the
+ * operations are initialized. The caller must clean up both contexts.
+ */
+static CK_RV encr_mgr_reencrypt_ops(STDLL_TokData_t *tokdata, SESSION *sess,
+                                    ENCR_DECR_CONTEXT *decr_ctx,
+                                    CK_MECHANISM *decr_mech,
+                                    CK_OBJECT_HANDLE decr_key,
+                                    OBJECT *decr_key_obj,
+                                    ENCR_DECR_CONTEXT *encr_ctx,
+                                    CK_MECHANISM *encr_mech,
+                                    CK_OBJECT_HANDLE encr_key,
+                                    OBJECT *encr_key_obj,
+                                    CK_BBOOL checkpolicy,
+                                    CK_BYTE *in_data, CK_ULONG in_data_len,
+                                    CK_BYTE *out_data, CK_ULONG *out_data_len)
+{
+    CK_ULONG decr_data_len = 0;
+    CK_BYTE *decr_data = NULL;
+    CK_RV rc;
+
+    rc = object_lock(decr_key_obj, READ_LOCK);
+    if (rc != CKR_OK)
+        goto done;
+    rc = decr_mgr_init_key_obj(tokdata, sess, decr_ctx, OP_DECRYPT_INIT,
+                               decr_mech, decr_key, decr_key_obj, checkpolicy,
+                               TRUE);
+    object_unlock(decr_key_obj);
+    if (rc != CKR_OK)
+        goto done;
+
+    rc = object_lock(encr_key_obj, READ_LOCK);
+    if (rc != CKR_OK)
+        goto done;
+    rc = encr_mgr_init_key_obj(tokdata, sess, encr_ctx, OP_ENCRYPT_INIT,
+                               encr_mech, encr_key, encr_key_obj, checkpolicy);
+    object_unlock(encr_key_obj);
+    if (rc != CKR_OK)
+        goto done;
+
+    rc = decr_mgr_decrypt(tokdata, sess, TRUE, decr_ctx, in_data, in_data_len,
+                          NULL, &decr_data_len);
+    if (rc != CKR_OK)
+        goto done;
+
+    decr_data = malloc(decr_data_len);
+    if (decr_data == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    rc = decr_mgr_decrypt(tokdata, sess, FALSE, decr_ctx, in_data, in_data_len,
+                          decr_data, &decr_data_len);
+    if (rc != CKR_OK)
+        goto done;
+
+    rc = encr_mgr_encrypt(tokdata, sess, out_data == NULL, encr_ctx, decr_data,
+                          decr_data_len, out_data, out_data_len);
+
+done:
+    if (decr_data != NULL) {
+        OPENSSL_cleanse(decr_data, decr_data_len);
+        free(decr_data);
+    }
+
+    return rc;
+}
+
 CK_RV encr_mgr_reencrypt_single(STDLL_TokData_t *tokdata, SESSION *sess,
                                 ENCR_DECR_CONTEXT *decr_ctx,
                                 CK_MECHANISM *decr_mech,
@@ -1098,9 +1410,7 @@ CK_RV encr_mgr_reencrypt_single(STDLL_TokData_t *tokdata, SESSION *sess,
 {
     OBJECT *decr_key_obj = NULL;
     OBJECT *encr_key_obj = NULL;
-    CK_ULONG decr_data_len = 0;
-    CK_BYTE *decr_data = NULL;
-    CK_BBOOL flag;
+    CK_BBOOL keys_locked = TRUE;
     CK_RV rc;
 
     if (!sess || !decr_ctx || !encr_ctx || !decr_mech || !encr_mech) {
@@ -1113,84 +1423,13 @@ CK_RV encr_mgr_reencrypt_single(STDLL_TokData_t *tokdata, SESSION *sess,
         return CKR_OPERATION_ACTIVE;
     }
 
-    if (token_specific.t_reencrypt_single != NULL) {
-        rc = object_mgr_find_in_map1(tokdata, decr_key, &decr_key_obj,
-                                     READ_LOCK);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("Failed to acquire decr-key from specified handle.\n");
-            if (rc == CKR_OBJECT_HANDLE_INVALID)
-                return CKR_KEY_HANDLE_INVALID;
-            else
-                return rc;
-        }
-
-        rc = object_mgr_find_in_map1(tokdata, encr_key, &encr_key_obj,
-                                     READ_LOCK);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("Failed to acquire encr-key from specified handle.\n");
-            if (rc == CKR_OBJECT_HANDLE_INVALID)
-                rc = CKR_KEY_HANDLE_INVALID;
-            goto done;
-        }
-        rc = tokdata->policy->is_mech_allowed(tokdata->policy, decr_mech,
-                                              &decr_key_obj->strength,
-                                              POLICY_CHECK_DECRYPT, sess);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("POLICY VIOLATION: Reencrypt_single decryption\n");
-            goto done;
-        }
-        rc = tokdata->policy->is_mech_allowed(tokdata->policy, encr_mech,
-                                              &encr_key_obj->strength,
-                                              POLICY_CHECK_ENCRYPT, sess);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("POLICY VIOLATION: Reencrypt_single encryption\n");
-            goto done;
-        }
-
-        if (!key_object_is_mechanism_allowed(decr_key_obj->template,
-                                             decr_mech->mechanism)) {
-            TRACE_ERROR("Decrypt mechanism not allwed per "
-                        "CKA_ALLOWED_MECHANISMS.\n");
-            rc = CKR_MECHANISM_INVALID;
-            goto done;
-        }
-
-        if (!key_object_is_mechanism_allowed(encr_key_obj->template,
-                                             encr_mech->mechanism)) {
-            TRACE_ERROR("Encrypt mechanism not allwed per "
-                        "CKA_ALLOWED_MECHANISMS.\n");
-            rc = CKR_MECHANISM_INVALID;
-            goto done;
-        }
-
-        rc = template_attribute_get_bool(decr_key_obj->template, CKA_DECRYPT,
-                                         &flag);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("Could not find CKA_DECRYPT for the key.\n");
-            rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
-            goto done;
-        }
-
-        if (flag != TRUE) {
-            TRACE_ERROR("%s\n", ock_err(ERR_KEY_FUNCTION_NOT_PERMITTED));
-            rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
-            goto done;
-        }
-
-        rc = template_attribute_get_bool(encr_key_obj->template, CKA_ENCRYPT,
-                                         &flag);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("Could not find CKA_ENCRYPT for the key.\n");
-            rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
-            goto done;
-        }
-
-        if (flag != TRUE) {
-            TRACE_ERROR("%s\n", ock_err(ERR_KEY_FUNCTION_NOT_PERMITTED));
-            rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
-            goto done;
-        }
+    rc = encr_mgr_reencrypt_get_keys(tokdata, sess, decr_mech, decr_key,
+                                     encr_mech, encr_key, &decr_key_obj,
+                                     &encr_key_obj);
+    if (rc != CKR_OK)
+        goto done;
 
+    if (token_specific.t_reencrypt_single != NULL) {
         rc = token_specific.t_reencrypt_single(tokdata, sess, decr_ctx,
                                                 decr_mech, decr_key_obj,
                                                 encr_ctx, encr_mech,
@@ -1210,51 +1449,160 @@ CK_RV encr_mgr_reencrypt_single(STDLL_TokData_t *tokdata, SESSION *sess,
         goto done;
     }
 
-    /* No token specific reencrypt_single function, perform it manually */
-    /* Enforces policy */
-    rc = decr_mgr_init(tokdata, sess, decr_ctx, OP_DECRYPT_INIT, decr_mech,
-                       decr_key, TRUE, TRUE);
-    if (rc != CKR_OK)
-        goto done;
-    /* Enforces Policy */
-    rc = encr_mgr_init(tokdata, sess, encr_ctx, OP_ENCRYPT_INIT, encr_mech,
-                       encr_key, TRUE);
-    if (rc != CKR_OK)
-        goto done;
+    /*
+     * No token specific reencrypt_single function, perform it manually. The
+     * policy has been checked above, the operations use the held key objects.
+     */
+    object_unlock(decr_key_obj);
+    object_unlock(encr_key_obj);
+    keys_locked = FALSE;
+
+    rc = encr_mgr_reencrypt_ops(tokdata, sess, decr_ctx, decr_mech, decr_key,
+                                decr_key_obj, encr_ctx, encr_mech, encr_key,
+                                encr_key_obj, FALSE, in_data, in_data_len,
+                                out_data, out_data_len);
 
-    rc = decr_mgr_decrypt(tokdata, sess, TRUE, decr_ctx, in_data, in_data_len,
-                          NULL, &decr_data_len);
-    if (rc != CKR_OK)
-        goto done;
+done:
+    object_put(tokdata, decr_key_obj, keys_locked);
+    decr_key_obj = NULL;
+    object_put(tokdata, encr_key_obj, keys_locked);
+    encr_key_obj = NULL;
 
-    decr_data = malloc(decr_data_len);
-    if (decr_data == NULL) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        rc = CKR_HOST_MEMORY;
-        goto done;
+    decr_mgr_cleanup(tokdata, sess, decr_ctx);
+    encr_mgr_cleanup(tokdata, sess, encr_ctx);
+
+    return rc;
+}
+
+/*
+ * Re-encrypts a batch of independent ciphertexts. The keys are looked up and
+ * checked against the policy and the key attributes once. Only items whose
+ * mechanism parameters differ from the ones of the base mechanisms are checked
+ * against the policy again. Items are processed with the token specific
+ * reencrypt_single function if there is one, and with a decrypt and an encrypt
+ * operation on the held key objects otherwise. The result of each item is
+ * returned in results[i], errors that affect the whole batch are returned.
+ */
+CK_RV encr_mgr_reencrypt_batch(STDLL_TokData_t *tokdata, SESSION *sess,
+                               ENCR_DECR_CONTEXT *decr_ctx,
+                               CK_MECHANISM *decr_mech,
+                               CK_OBJECT_HANDLE decr_key,
+                               ENCR_DECR_CONTEXT *encr_ctx,
+                               CK_MECHANISM *encr_mech,
+                               CK_OBJECT_HANDLE encr_key,
+                               CK_ULONG count,
+                               CK_VOID_PTR *decr_params,
+                               CK_VOID_PTR *encr_params,
+                               CK_BYTE **in_data, CK_ULONG *in_data_len,
+                               CK_BYTE **out_data, CK_ULONG *out_data_len,
+                               CK_RV *results)
+{
+    OBJECT *decr_key_obj = NULL;
+    OBJECT *encr_key_obj = NULL;
+    CK_MECHANISM item_decr_mech, item_encr_mech;
+    CK_BBOOL count_statistics, keys_locked = TRUE, checkpolicy;
+    CK_ULONG i;
+    CK_RV rc;
+
+    if (!sess || !decr_ctx || !encr_ctx || !decr_mech || !encr_mech) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_FUNCTION_FAILED;
     }
 
-    rc = decr_mgr_decrypt(tokdata, sess, FALSE, decr_ctx, in_data, in_data_len,
-                          decr_data, &decr_data_len);
-    if (rc != CKR_OK)
-        goto done;
+    if (decr_ctx->active != FALSE || encr_ctx->active != FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        return CKR_OPERATION_ACTIVE;
+    }
 
-    rc = encr_mgr_encrypt(tokdata, sess, out_data == NULL, encr_ctx, decr_data,
-                          decr_data_len, out_data, out_data_len);
+    count_statistics = decr_ctx->count_statistics;
+
+    rc = encr_mgr_reencrypt_get_keys(tokdata, sess, decr_mech, decr_key,
+                                     encr_mech, encr_key, &decr_key_obj,
+                                     &encr_key_obj);
     if (rc != CKR_OK)
         goto done;
 
+    if (token_specific.t_reencrypt_single == NULL) {
+        /*
+         * The decrypt and encrypt operations only lock the held key objects
+         * while they are initialized.
+         */
+        object_unlock(decr_key_obj);
+        object_unlock(encr_key_obj);
+        keys_locked = FALSE;
+    }
+
+    item_decr_mech = *decr_mech;
+    item_encr_mech = *encr_mech;
+
+    for (i = 0; i < count; i++) {
+        checkpolicy = FALSE;
+        if (decr_params != NULL) {
+            item_decr_mech.pParameter = decr_params[i];
+            if (decr_params[i] != decr_mech->pParameter)
+                checkpolicy = TRUE;
+        }
+        if (encr_params != NULL) {
+            item_encr_mech.pParameter = encr_params[i];
+            if (encr_params[i] != encr_mech->pParameter)
+                checkpolicy = TRUE;
+        }
+
+        decr_ctx->count_statistics = count_statistics;
+        encr_ctx->count_statistics = count_statistics;
+
+        if (token_specific.t_reencrypt_single != NULL) {
+            if (checkpolicy) {
+                results[i] = encr_mgr_reencrypt_check_policy(tokdata, sess,
+                                                &item_decr_mech, decr_key_obj,
+                                                &item_encr_mech, encr_key_obj);
+                if (results[i] != CKR_OK) {
+                    TRACE_DEVEL("Reencrypt of batch item %lu failed: 0x%lx\n",
+                                i, results[i]);
+                    continue;
+                }
+            }
+
+            results[i] = token_specific.t_reencrypt_single(tokdata, sess,
+                                            decr_ctx, &item_decr_mech,
+                                            decr_key_obj, encr_ctx,
+                                            &item_encr_mech, encr_key_obj,
+                                            in_data[i], in_data_len[i],
+                                            out_data != NULL ?
+                                                        out_data[i] : NULL,
+                                            &out_data_len[i]);
+
+            if (count_statistics == TRUE && results[i] == CKR_OK) {
+                INC_COUNTER(tokdata, sess, &item_decr_mech, decr_key_obj,
+                            POLICY_STRENGTH_IDX_0);
+                INC_COUNTER(tokdata, sess, &item_encr_mech, encr_key_obj,
+                            POLICY_STRENGTH_IDX_0);
+            }
+        } else {
+            results[i] = encr_mgr_reencrypt_ops(tokdata, sess, decr_ctx,
+                                                &item_decr_mech, decr_key,
+                                                decr_key_obj, encr_ctx,
+                                                &item_encr_mech, encr_key,
+                                                encr_key_obj, checkpolicy,
+                                                in_data[i], in_data_len[i],
+                                                out_data != NULL ?
+                                                        out_data[i] : NULL,
+                                                &out_data_len[i]);
+        }
+        if (results[i] != CKR_OK)
+            TRACE_DEVEL("Reencrypt of batch item %lu failed: 0x%lx\n",
+                        i, results[i]);
+
+        decr_mgr_cleanup(tokdata, sess, decr_ctx);
+        encr_mgr_cleanup(tokdata, sess, encr_ctx);
+    }
+
 done:
-    object_put(tokdata, decr_key_obj, TRUE);
+    object_put(tokdata, decr_key_obj, keys_locked);
     decr_key_obj = NULL;
-    object_put(tokdata, encr_key_obj, TRUE);
+    object_put(tokdata, encr_key_obj, keys_locked);
     encr_key_obj = NULL;
 
-    if (decr_data != NULL) {
-        OPENSSL_cleanse(decr_data, decr_data_len);
-        free(decr_data);
-    }
-
     decr_mgr_cleanup(tokdata, sess, decr_ctx);
     encr_mgr_cleanup(tokdata, sess, encr_ctx);
 
@@ -1931,6 +1931,13 @@ CK_RV encr_mgr_init(STDLL_TokData_t *tokdata,
                     CK_MECHANISM *mech, CK_OBJECT_HANDLE key_handle,
                     CK_BBOOL checkpolicy);
 
+CK_RV encr_mgr_init_key_obj(STDLL_TokData_t *tokdata,
+                            SESSION *sess,
+                            ENCR_DECR_CONTEXT *ctx,
+                            CK_ULONG operation,
+                            CK_MECHANISM *mech, CK_OBJECT_HANDLE key_handle,
+                            OBJECT *key_obj, CK_BBOOL checkpolicy);
+
 CK_RV encr_mgr_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
                        ENCR_DECR_CONTEXT *ctx);
 
@@ -1949,6 +1956,13 @@ CK_RV encr_mgr_encrypt_update(STDLL_TokData_t *tokdata, SESSION *sess,
                               CK_BYTE *in_data, CK_ULONG in_data_len,
                               CK_BYTE *out_data, CK_ULONG *out_data_len);
 
+CK_RV encr_mgr_encrypt_dual_update(STDLL_TokData_t *tokdata, SESSION *sess,
+                                   ENCR_DECR_CONTEXT *encr_ctx,
+                                   DIGEST_CONTEXT *digest_ctx,
+                                   SIGN_VERIFY_CONTEXT *sign_ctx,
+                                   CK_BYTE *in_data, CK_ULONG in_data_len,
+                                   CK_BYTE *out_data, CK_ULONG *out_data_len);
+
 CK_RV encr_mgr_reencrypt_single(STDLL_TokData_t *tokdata, SESSION *sess,
                                 ENCR_DECR_CONTEXT *decr_ctx,
                                 CK_MECHANISM *decr_mech,
@@ -1958,6 +1972,19 @@ CK_RV encr_mgr_reencrypt_single(STDLL_TokData_t *tokdata, SESSION *sess,
                                 CK_OBJECT_HANDLE encr_key,
                                 CK_BYTE *in_data, CK_ULONG in_data_len,
                                 CK_BYTE *out_data, CK_ULONG *out_data_len);
+CK_RV encr_mgr_reencrypt_batch(STDLL_TokData_t *tokdata, SESSION *sess,
+                               ENCR_DECR_CONTEXT *decr_ctx,
+                               CK_MECHANISM *decr_mech,
+                               CK_OBJECT_HANDLE decr_key,
+                               ENCR_DECR_CONTEXT *encr_ctx,
+                               CK_MECHANISM *encr_mech,
+                               CK_OBJECT_HANDLE encr_key,
+                               CK_ULONG count,
+                               CK_VOID_PTR *decr_params,
+                               CK_VOID_PTR *encr_params,
+                               CK_BYTE **in_data, CK_ULONG *in_data_len,
+                               CK_BYTE **out_data, CK_ULONG *out_data_len,
+                               CK_RV *results);
 
 // decryption manager routines
 //
@@ -1968,6 +1995,14 @@ CK_RV decr_mgr_init(STDLL_TokData_t *tokdata,
                     CK_MECHANISM *mech, CK_OBJECT_HANDLE key_handle,
                     CK_BBOOL checkpolicy, CK_BBOOL checkauth);
 
+CK_RV decr_mgr_init_key_obj(STDLL_TokData_t *tokdata,
+                            SESSION *sess,
+                            ENCR_DECR_CONTEXT *ctx,
+                            CK_ULONG operation,
+                            CK_MECHANISM *mech, CK_OBJECT_HANDLE key_handle,
+                            OBJECT *key_obj, CK_BBOOL checkpolicy,
+                            CK_BBOOL checkauth);
+
 CK_RV decr_mgr_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
                        ENCR_DECR_CONTEXT *ctx);
 
@@ -1988,6 +2023,13 @@ CK_RV decr_mgr_decrypt_update(STDLL_TokData_t *tokdata,
                               CK_BYTE *in_data, CK_ULONG in_data_len,
                               CK_BYTE *out_data, CK_ULONG *out_data_len);
 
+CK_RV decr_mgr_decrypt_dual_update(STDLL_TokData_t *tokdata, SESSION *sess,
+                                   ENCR_DECR_CONTEXT *decr_ctx,
+                                   DIGEST_CONTEXT *digest_ctx,
+                                   SIGN_VERIFY_CONTEXT *verify_ctx,
+                                   CK_BYTE *in_data, CK_ULONG in_data_len,
+                                   CK_BYTE *out_data, CK_ULONG *out_data_len);
+
 CK_RV decr_mgr_update_des_ecb(STDLL_TokData_t *tokdata, SESSION *sess,
                               CK_BBOOL length_only, ENCR_DECR_CONTEXT *ctx,
                               CK_BYTE *in_data, CK_ULONG in_data_len,
@@ -2038,6 +2080,12 @@ CK_RV digest_mgr_digest_final(STDLL_TokData_t *tokdata,
                               DIGEST_CONTEXT *ctx,
                               CK_BYTE *hash, CK_ULONG *hash_len);
 
+CK_RV digest_mgr_digest_batch(STDLL_TokData_t *tokdata, SESSION *sess,
+                              CK_BBOOL length_only, CK_MECHANISM *mech,
+                              CK_ULONG count, CK_BYTE **in_data,
+                              CK_ULONG *in_data_len, CK_BYTE *out_data,
+                              CK_ULONG *out_data_len);
+
 
 // key manager routines
 //
@@ -2188,6 +2236,10 @@ SESSION *session_mgr_find(STDLL_TokData_t *tokdata, CK_SESSION_HANDLE handle);
 SESSION *session_mgr_find_reset_error(STDLL_TokData_t *tokdata,
                                       CK_SESSION_HANDLE handle);
 void session_mgr_put(STDLL_TokData_t *tokdata, SESSION *session);
+CK_BYTE *session_mgr_alloc_context(SESSION *sess, CK_ULONG context_len);
+void session_mgr_free_context(STDLL_TokData_t *tokdata, SESSION *sess,
+                              CK_BYTE *context, CK_ULONG context_len);
+void call_session_free(void *ptr);
 CK_RV session_mgr_login_all(STDLL_TokData_t *tokdata, CK_USER_TYPE user_type);
 CK_RV session_mgr_logout_all(STDLL_TokData_t *tokdata);
 
@@ -2308,6 +2360,13 @@ CK_RV object_mgr_get_attribute_values(STDLL_TokData_t *tokdata,
                                       CK_ATTRIBUTE *pTemplate,
                                       CK_ULONG ulCount);
 
+CK_RV object_mgr_get_attribute_values_batch(STDLL_TokData_t *tokdata,
+                                            SESSION *sess, CK_ULONG count,
+                                            CK_OBJECT_HANDLE *handles,
+                                            CK_ATTRIBUTE **templates,
+                                            CK_ULONG *attr_counts,
+                                            CK_RV *results);
+
 CK_RV object_mgr_get_object_size(STDLL_TokData_t *tokdata,
                                  CK_OBJECT_HANDLE handle, CK_ULONG *size);
 
@@ -2326,7 +2385,14 @@ CK_RV object_mgr_restore_obj_withSize(STDLL_TokData_t *tokdata,
                                       int data_size,
                                       const char *fname);
 
+CK_RV object_mgr_restore_obj_withIndex(STDLL_TokData_t *tokdata,
+                                       CK_BYTE *data, OBJECT *oldObj,
+                                       int data_size, const char *fname,
+                                       const CK_ULONG *shm_index);
+
 CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj);
+CK_RV object_mgr_save_token_objects(STDLL_TokData_t *tokdata, OBJECT **objs,
+                                    CK_ULONG num_objs);
 
 CK_RV object_mgr_set_attribute_values(STDLL_TokData_t *tokdata,
                                       SESSION *sess,
@@ -2340,12 +2406,29 @@ CK_BBOOL object_mgr_purge_map(STDLL_TokData_t *tokdata,
 
 CK_RV object_put(STDLL_TokData_t *tokdata, OBJECT *obj, CK_BBOOL unlock);
 
-CK_RV obj_mgr_reencipher_secure_key(STDLL_TokData_t *tokdata, OBJECT *obj,
-                                    CK_RV (*reenc)(CK_BYTE *sec_key,
-                                                   CK_BYTE *reenc_sec_key,
-                                                   CK_ULONG sec_key_len,
-                                                   void *private),
-                                    void *private);
+CK_RV obj_mgr_reencipher_key_objects(STDLL_TokData_t *tokdata,
+                                     CK_BBOOL session_objects,
+                                     CK_BBOOL token_objects,
+                                     CK_BBOOL (*filter)(STDLL_TokData_t *tokdata,
+                                                        OBJECT *obj,
+                                                        void *private),
+                                     CK_RV (*reenc)(STDLL_TokData_t *tokdata,
+                                                    OBJECT *obj,
+                                                    CK_BYTE *sec_key,
+                                                    CK_BYTE *reenc_sec_key,
+                                                    CK_ULONG sec_key_len,
+                                                    void *private),
+                                     CK_BBOOL (*is_blob_new_mk)(
+                                                    STDLL_TokData_t *tokdata,
+                                                    OBJECT *obj,
+                                                    CK_BYTE *sec_key,
+                                                    CK_ULONG sec_key_len,
+                                                    void *private),
+                                     void (*progress)(STDLL_TokData_t *tokdata,
+                                                      unsigned long done,
+                                                      unsigned long total,
+                                                      void *private),
+                                     void *private, unsigned int num_workers);
 
 CK_RV obj_mgr_reencipher_secure_key_finalize(STDLL_TokData_t *tokdata,
                                              OBJECT *obj,
@@ -2460,6 +2543,7 @@ CK_RV object_init_ex_data_lock(OBJECT *obj);
 CK_RV object_destroy_ex_data_lock(OBJECT *obj);
 CK_RV object_ex_data_lock(OBJECT *obj, OBJ_LOCK_TYPE type);
 CK_RV object_ex_data_unlock(OBJECT *obj);
+CK_RV object_ex_data_reload(OBJECT *obj);
 
 // object attribute template routines
 //
@@ -3040,6 +3124,87 @@ CK_RV ber_decode_IBM_KyberPrivateKey(CK_BYTE *data,
                                      CK_ATTRIBUTE **value,
                                      const struct pqc_oid **oid);
 
+// Single-pass DER encoding of the key structures, producing the same output
+// as the respective ber_encode_* function above with a single allocation
+//
+CK_RV der_put_RSAPrivateKey(CK_BBOOL length_only,
+                            CK_BYTE **data,
+                            CK_ULONG *data_len,
+                            CK_ATTRIBUTE *modulus,
+                            CK_ATTRIBUTE *publ_exp,
+                            CK_ATTRIBUTE *priv_exp,
+                            CK_ATTRIBUTE *prime1,
+                            CK_ATTRIBUTE *prime2,
+                            CK_ATTRIBUTE *exponent1,
+                            CK_ATTRIBUTE *exponent2,
+                            CK_ATTRIBUTE *coeff);
+
+CK_RV der_put_RSAPublicKey(CK_BBOOL length_only, CK_BYTE **data,
+                           CK_ULONG *data_len, CK_ATTRIBUTE *modulus,
+                           CK_ATTRIBUTE *publ_exp);
+
+CK_RV der_put_DSAPrivateKey(CK_BBOOL length_only,
+                            CK_BYTE **data,
+                            CK_ULONG *data_len,
+                            CK_ATTRIBUTE *prime1,
+                            CK_ATTRIBUTE *prime2,
+                            CK_ATTRIBUTE *base, CK_ATTRIBUTE *priv_key);
+
+CK_RV der_put_DSAPublicKey(CK_BBOOL length_only, CK_BYTE **data,
+                           CK_ULONG *data_len, CK_ATTRIBUTE *prime,
+                           CK_ATTRIBUTE *subprime, CK_ATTRIBUTE *base,
+                           CK_ATTRIBUTE *value);
+
+CK_RV der_put_ECPrivateKey(CK_BBOOL length_only,
+                           CK_BYTE **data,
+                           CK_ULONG *data_len,
+                           CK_ATTRIBUTE *params,
+                           CK_ATTRIBUTE *point,
+                           CK_ATTRIBUTE *pubkey);
+
+CK_RV der_put_ECPublicKey(CK_BBOOL length_only, CK_BYTE **data,
+                          CK_ULONG *data_len, CK_ATTRIBUTE *params,
+                          CK_ATTRIBUTE *point);
+
+CK_RV der_put_DHPrivateKey(CK_BBOOL length_only,
+                           CK_BYTE **data,
+                           CK_ULONG *data_len,
+                           CK_ATTRIBUTE *prime,
+                           CK_ATTRIBUTE *base, CK_ATTRIBUTE *priv_key);
+
+CK_RV der_put_DHPublicKey(CK_BBOOL length_only, CK_BYTE **data,
+                          CK_ULONG *data_len, CK_ATTRIBUTE *prime,
+                          CK_ATTRIBUTE *base, CK_ATTRIBUTE *value);
+
+CK_RV der_put_IBM_DilithiumPublicKey(CK_BBOOL length_only,
+                                     CK_BYTE **data, CK_ULONG *data_len,
+                                     const CK_BYTE *oid, CK_ULONG oid_len,
+                                     CK_ATTRIBUTE *rho, CK_ATTRIBUTE *t1);
+
+CK_RV der_put_IBM_DilithiumPrivateKey(CK_BBOOL length_only,
+                                      CK_BYTE **data,
+                                      CK_ULONG *data_len,
+                                      const CK_BYTE *oid, CK_ULONG oid_len,
+                                      CK_ATTRIBUTE *rho,
+                                      CK_ATTRIBUTE *seed,
+                                      CK_ATTRIBUTE *tr,
+                                      CK_ATTRIBUTE *s1,
+                                      CK_ATTRIBUTE *s2,
+                                      CK_ATTRIBUTE *t0,
+                                      CK_ATTRIBUTE *t1);
+
+CK_RV der_put_IBM_KyberPublicKey(CK_BBOOL length_only,
+                                 CK_BYTE **data, CK_ULONG *data_len,
+                                 const CK_BYTE *oid, CK_ULONG oid_len,
+                                 CK_ATTRIBUTE *pk);
+
+CK_RV der_put_IBM_KyberPrivateKey(CK_BBOOL length_only,
+                                  CK_BYTE **data,
+                                  CK_ULONG *data_len,
+                                  const CK_BYTE *oid, CK_ULONG oid_len,
+                                  CK_ATTRIBUTE *sk,
+                                  CK_ATTRIBUTE *pk);
+
 typedef CK_RV (*t_rsa_encrypt)(STDLL_TokData_t *, CK_BYTE *in_data,
                                CK_ULONG in_data_len, CK_BYTE *out_data,
                                OBJECT *key_obj);
@@ -3047,8 +3212,22 @@ typedef CK_RV (*t_rsa_decrypt)(STDLL_TokData_t *, CK_BYTE *in_data,
                                CK_ULONG in_data_len, CK_BYTE *out_data,
                                OBJECT *key_obj);
 
+#define OPENSSL_EX_DATA_HMAC_CTXS   12
+
 struct openssl_ex_data {
     EVP_PKEY *pkey;
+    /* Keyed MAC contexts of a secret key, duplicated for each operation */
+    EVP_MD_CTX *hmac_ctx[OPENSSL_EX_DATA_HMAC_CTXS]; /* one per digest */
+    void *cmac_ctx;
+    /* Keyed AES-XTS contexts, indexed by encrypt (1) or decrypt (0) */
+    EVP_CIPHER_CTX *xts_ctx[2];
+    EVP_CIPHER_CTX *xts_tweak_ctx[2]; /* AES-ECB with the tweak key */
+    /*
+     * CRT components (p, q, dp, dq, qinv) recovered for an RSA private key
+     * that was created in modular-exponent format only. They are not added
+     * to the key object, which keeps the attributes it was created with.
+     */
+    CK_ATTRIBUTE *rsa_crt[5];
 };
 
 void openssl_free_ex_data(OBJECT *obj, void *ex_data, size_t ex_data_len);
@@ -3060,7 +3239,22 @@ CK_RV openssl_get_ex_data(OBJECT *obj, void **ex_data, size_t ex_data_len,
                                                void *ex_data,
                                                size_t ex_data_len));
 
+CK_RV openssl_rsa_recover_crt(OBJECT *key_obj,
+                              struct openssl_ex_data *ex_data);
+CK_RV openssl_rsa_priv_wrap_get_data(OBJECT *key_obj, size_t ex_data_len,
+                                     void (*ex_data_free)(struct _OBJECT *obj,
+                                                          void *ex_data,
+                                                          size_t ex_data_len),
+                                     CK_BBOOL length_only, CK_BYTE **data,
+                                     CK_ULONG *data_len);
+
 CK_RV openssl_specific_rsa_keygen(TEMPLATE *publ_tmpl, TEMPLATE *priv_tmpl);
+CK_RV openssl_specific_rsa_keygen_pkey(CK_ULONG mod_bits,
+                                       const CK_BYTE *publ_exp,
+                                       CK_ULONG publ_exp_len, EVP_PKEY **pkey);
+CK_RV openssl_specific_rsa_keygen_from_pkey(EVP_PKEY *pkey,
+                                            TEMPLATE *publ_tmpl,
+                                            TEMPLATE *priv_tmpl);
 CK_RV openssl_specific_rsa_encrypt(STDLL_TokData_t *, CK_BYTE *in_data,
                                    CK_ULONG in_data_len,
                                    CK_BYTE *out_data, OBJECT *key_obj);
@@ -3119,6 +3313,11 @@ CK_RV openssl_make_ec_key_from_template(TEMPLATE *template, EVP_PKEY **pkey);
 CK_RV openssl_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
                                            TEMPLATE *publ_tmpl,
                                            TEMPLATE *priv_tmpl);
+CK_RV openssl_specific_ec_keygen_pkey(const CK_BYTE *params,
+                                      CK_ULONG params_len, EVP_PKEY **pkey);
+CK_RV openssl_specific_ec_keygen_from_pkey(EVP_PKEY *ec_pkey,
+                                           TEMPLATE *publ_tmpl,
+                                           TEMPLATE *priv_tmpl);
 CK_RV openssl_specific_ec_sign(STDLL_TokData_t *tokdata,  SESSION *sess,
                                CK_BYTE *in_data, CK_ULONG in_data_len,
                                CK_BYTE *out_data, CK_ULONG *out_data_len,
@@ -3147,6 +3346,9 @@ CK_RV openssl_specific_sha_update(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
                                   CK_BYTE *in_data, CK_ULONG in_data_len);
 CK_RV openssl_specific_sha_final(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
                                  CK_BYTE *out_data, CK_ULONG *out_data_len);
+CK_RV openssl_specific_sha_batch(STDLL_TokData_t *tokdata, CK_MECHANISM *mech,
+                                 CK_ULONG count, CK_BYTE **in_data,
+                                 CK_ULONG *in_data_len, CK_BYTE *out_data);
 
 CK_RV openssl_specific_shake_key_derive(STDLL_TokData_t *tokdata, SESSION *sess,
                                         CK_MECHANISM *mech,
@@ -3269,6 +3471,35 @@ CK_RV openssl_specific_hmac_update(SIGN_VERIFY_CONTEXT *ctx, CK_BYTE *in_data,
 CK_RV openssl_specific_hmac_final(SIGN_VERIFY_CONTEXT *ctx, CK_BYTE *signature,
                                   CK_ULONG *sig_len, CK_BBOOL sign);
 
+CK_RV openssl_specific_hash_sign_verify_init(STDLL_TokData_t *tokdata,
+                                             SESSION *sess,
+                                             SIGN_VERIFY_CONTEXT *ctx,
+                                             CK_MECHANISM *mech,
+                                             OBJECT *key_obj, CK_BBOOL sign);
+CK_RV openssl_specific_hash_sign(STDLL_TokData_t *tokdata, SESSION *sess,
+                                 SIGN_VERIFY_CONTEXT *ctx,
+                                 CK_BBOOL length_only,
+                                 CK_BYTE *in_data, CK_ULONG in_data_len,
+                                 CK_BYTE *signature, CK_ULONG *sig_len);
+CK_RV openssl_specific_hash_sign_verify_update(STDLL_TokData_t *tokdata,
+                                               SESSION *sess,
+                                               SIGN_VERIFY_CONTEXT *ctx,
+                                               CK_BYTE *in_data,
+                                               CK_ULONG in_data_len);
+CK_RV openssl_specific_hash_sign_final(STDLL_TokData_t *tokdata,
+                                       SESSION *sess,
+                                       SIGN_VERIFY_CONTEXT *ctx,
+                                       CK_BBOOL length_only,
+                                       CK_BYTE *signature, CK_ULONG *sig_len);
+CK_RV openssl_specific_hash_verify(STDLL_TokData_t *tokdata, SESSION *sess,
+                                   SIGN_VERIFY_CONTEXT *ctx,
+                                   CK_BYTE *in_data, CK_ULONG in_data_len,
+                                   CK_BYTE *signature, CK_ULONG sig_len);
+CK_RV openssl_specific_hash_verify_final(STDLL_TokData_t *tokdata,
+                                         SESSION *sess,
+                                         SIGN_VERIFY_CONTEXT *ctx,
+                                         CK_BYTE *signature, CK_ULONG sig_len);
+
 CK_RV openssl_specific_rsa_derive_kdk(STDLL_TokData_t *tokdata, OBJECT *key_obj,
                                       const CK_BYTE *in, CK_ULONG inlen,
                                       CK_BYTE *kdk, CK_ULONG kdklen);
@@ -3288,6 +3519,12 @@ CK_RV openssl_specific_ibm_dilithium_generate_keypair(STDLL_TokData_t *tokdata,
                                                       const struct pqc_oid *oid,
                                                       TEMPLATE *publ_tmpl,
                                                       TEMPLATE *priv_tmpl);
+CK_RV openssl_specific_ibm_dilithium_keygen_pkey(const struct pqc_oid *oid,
+                                                 EVP_PKEY **pkey);
+CK_RV openssl_specific_ibm_dilithium_keygen_from_pkey(EVP_PKEY *pkey,
+                                                      const struct pqc_oid *oid,
+                                                      TEMPLATE *publ_tmpl,
+                                                      TEMPLATE *priv_tmpl);
 CK_RV openssl_make_ibm_dilithium_key_from_template(TEMPLATE *tmpl,
                                                    const struct pqc_oid *oid,
                                                    CK_BBOOL private_key,
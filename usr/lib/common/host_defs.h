@@ -79,9 +79,22 @@ typedef struct _SIGN_VERIFY_CONTEXT {
     CK_BBOOL state_unsaveable;
     CK_BBOOL count_statistics;
     CK_BBOOL auth_required;
+    CK_BBOOL hash_sign_fused;   // token does hash and sign in one pass
 } SIGN_VERIFY_CONTEXT;
 
 
+/*
+ * Per-session arena the operation contexts are carved from. The chunks are
+ * allocated on first use, and are zeroized when released.
+ */
+typedef struct _SESS_CTX_ARENA {
+    CK_BYTE *base;              // SESS_CTX_ARENA_CHUNKS chunks, page aligned
+    uint32_t used;              // bit mask of the chunks in use
+    CK_BBOOL disabled;          // contexts are malloc'ed per operation
+    CK_BBOOL mlock;             // lock the chunks into memory
+    CK_BBOOL locked;            // the chunks are locked into memory
+} SESS_CTX_ARENA;
+
 typedef struct _SESSION {
     struct bt_ref_hdr hdr;
     CK_SESSION_HANDLE handle;
@@ -99,6 +112,8 @@ typedef struct _SESSION {
     SIGN_VERIFY_CONTEXT sign_ctx;
     SIGN_VERIFY_CONTEXT verify_ctx;
 
+    SESS_CTX_ARENA ctx_arena;
+
     void *private_data;
 } SESSION;
 
@@ -372,6 +387,10 @@ CK_RV ock_generic_get_mechanism_info(STDLL_TokData_t * tokdata,
                                                (STDLL_TokData_t *tokdata,
                                                CK_MECHANISM_TYPE mechanism));
 
+/* mech_list.c */
+CK_BBOOL ock_generic_mechanism_is_hw(STDLL_TokData_t *tokdata,
+                                     CK_MECHANISM_TYPE type);
+
 typedef struct _TOK_OBJ_ENTRY {
     CK_BBOOL deleted;
     char name[8];
@@ -395,6 +414,19 @@ struct tokspec_counter {
     void (*decr_tokspec_count)(STDLL_TokData_t *tokdata);
 };
 
+/*
+ * Reader counters of the HSM-MK-change lock are spread over several cache
+ * lines, so that concurrent API calls from different threads do not contend
+ * on a single lock word. See hsm_mk_change_lock.c for details.
+ */
+#define HSM_MK_CHANGE_LOCK_SHARDS       64
+#define HSM_MK_CHANGE_LOCK_CACHE_LINE   256
+
+struct hsm_mk_change_lock_shard {
+    volatile unsigned long readers;
+    char pad[HSM_MK_CHANGE_LOCK_CACHE_LINE - sizeof(unsigned long)];
+};
+
 struct _STDLL_TokData_t {
     CK_SLOT_INFO slot_info;
     CK_SLOT_ID slot_id;
@@ -435,6 +467,9 @@ struct _STDLL_TokData_t {
     struct tokstore_strength store_strength;
     CK_BBOOL hsm_mk_change_supported;
     pthread_rwlock_t hsm_mk_change_rwlock;
+    struct hsm_mk_change_lock_shard
+                        hsm_mk_change_shards[HSM_MK_CHANGE_LOCK_SHARDS];
+    volatile unsigned long hsm_mk_change_writers;
 };
 
 #endif
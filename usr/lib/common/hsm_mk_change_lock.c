@@ -0,0 +1,129 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * The HSM-MK-change lock is taken as reader around every call into a token
+ * that supports concurrent HSM master key changes (i.e. every EP11 and CCA
+ * API call), and as writer only by the event thread while re-enciphering or
+ * finalizing/canceling a master key change operation. Taking a shared
+ * pthread rwlock for every API call makes all threads of an application
+ * bounce the same cache line, even though a writer is almost never active.
+ *
+ * Readers therefore only increment a per-thread reader counter (spread over
+ * HSM_MK_CHANGE_LOCK_SHARDS cache lines) and then check the writer count.
+ * A writer first increments the writer count, then obtains the rwlock as
+ * writer, and waits until all reader counters have drained to zero. Both
+ * sides use full memory barriers between their store and their load, so
+ * either the reader sees the writer count, or the writer sees the reader
+ * counter (or both). A reader that sees a pending writer backs out of its
+ * counter and takes the rwlock as reader instead, which blocks it until the
+ * writer is done.
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "hsm_mk_change_lock.h"
+
+#define HSM_MK_CHANGE_DRAIN_SLEEP_US    100
+
+static unsigned int hsm_mk_change_next_shard = 0;
+/* Shard index + 1 of the current thread, 0 if not yet assigned */
+static __thread unsigned int hsm_mk_change_thread_shard = 0;
+
+static unsigned int hsm_mk_change_get_shard(void)
+{
+    if (hsm_mk_change_thread_shard == 0)
+        hsm_mk_change_thread_shard =
+                (__sync_fetch_and_add(&hsm_mk_change_next_shard, 1) %
+                                            HSM_MK_CHANGE_LOCK_SHARDS) + 1;
+
+    return hsm_mk_change_thread_shard - 1;
+}
+
+/*
+ * Enter the HSM-MK-change lock as reader. On return, *shard contains the
+ * value to pass to hsm_mk_change_unlock_shared().
+ */
+CK_RV hsm_mk_change_lock_shared(STDLL_TokData_t *tokdata, int *shard)
+{
+    unsigned int idx = hsm_mk_change_get_shard();
+
+    /* Full barrier: the increment is visible before the writers check */
+    __sync_add_and_fetch(&tokdata->hsm_mk_change_shards[idx].readers, 1);
+    if (tokdata->hsm_mk_change_writers == 0) {
+        *shard = idx;
+        return CKR_OK;
+    }
+
+    /* A writer is pending or active, wait for it on the rwlock */
+    __sync_sub_and_fetch(&tokdata->hsm_mk_change_shards[idx].readers, 1);
+
+    if (pthread_rwlock_rdlock(&tokdata->hsm_mk_change_rwlock) != 0)
+        return CKR_CANT_LOCK;
+
+    *shard = HSM_MK_CHANGE_LOCK_RWLOCK;
+    return CKR_OK;
+}
+
+CK_RV hsm_mk_change_unlock_shared(STDLL_TokData_t *tokdata, int shard)
+{
+    if (shard != HSM_MK_CHANGE_LOCK_RWLOCK) {
+        __sync_sub_and_fetch(&tokdata->hsm_mk_change_shards[shard].readers, 1);
+        return CKR_OK;
+    }
+
+    if (pthread_rwlock_unlock(&tokdata->hsm_mk_change_rwlock) != 0)
+        return CKR_CANT_LOCK;
+
+    return CKR_OK;
+}
+
+/*
+ * Obtain the HSM-MK-change lock as writer. Returns only after all readers
+ * that entered the lock before have left it. On failure, the lock is not
+ * held and hsm_mk_change_unlock_exclusive() must not be called.
+ */
+CK_RV hsm_mk_change_lock_exclusive(STDLL_TokData_t *tokdata)
+{
+    unsigned int i;
+
+    /* Full barrier: new readers now back off to the rwlock */
+    __sync_add_and_fetch(&tokdata->hsm_mk_change_writers, 1);
+
+    if (pthread_rwlock_wrlock(&tokdata->hsm_mk_change_rwlock) != 0) {
+        __sync_sub_and_fetch(&tokdata->hsm_mk_change_writers, 1);
+        return CKR_CANT_LOCK;
+    }
+
+    /* Wait for in-flight readers that did not see the writer count */
+    for (i = 0; i < HSM_MK_CHANGE_LOCK_SHARDS; i++) {
+        while (__sync_add_and_fetch(&tokdata->hsm_mk_change_shards[i].readers,
+                                    0) != 0)
+            usleep(HSM_MK_CHANGE_DRAIN_SLEEP_US);
+    }
+
+    return CKR_OK;
+}
+
+CK_RV hsm_mk_change_unlock_exclusive(STDLL_TokData_t *tokdata)
+{
+    CK_RV rc = CKR_OK;
+
+    if (pthread_rwlock_unlock(&tokdata->hsm_mk_change_rwlock) != 0)
+        rc = CKR_CANT_LOCK;
+
+    __sync_sub_and_fetch(&tokdata->hsm_mk_change_writers, 1);
+
+    return rc;
+}
@@ -0,0 +1,29 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#ifndef HSM_MK_CHANGE_LOCK_H
+#define HSM_MK_CHANGE_LOCK_H
+
+#include "pkcs11types.h"
+#include "local_types.h"
+
+/*
+ * Value returned in *shard by hsm_mk_change_lock_shared() when the caller
+ * holds the HSM-MK-change rwlock as reader instead of a reader counter.
+ */
+#define HSM_MK_CHANGE_LOCK_RWLOCK       -1
+
+CK_RV hsm_mk_change_lock_shared(STDLL_TokData_t *tokdata, int *shard);
+CK_RV hsm_mk_change_unlock_shared(STDLL_TokData_t *tokdata, int shard);
+
+CK_RV hsm_mk_change_lock_exclusive(STDLL_TokData_t *tokdata);
+CK_RV hsm_mk_change_unlock_exclusive(STDLL_TokData_t *tokdata);
+
+#endif
@@ -2187,9 +2187,9 @@ CK_RV rsa_publ_get_spki(TEMPLATE *tmpl, CK_BBOOL length_only,
         return rc;
     }
 
-    rc = ber_encode_RSAPublicKey(length_only, data,data_len, modulus, publ_exp);
+    rc = der_put_RSAPublicKey(length_only, data,data_len, modulus, publ_exp);
     if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_RSAPublicKey failed.\n");
+        TRACE_ERROR("der_put_RSAPublicKey failed.\n");
         return rc;
     }
 
@@ -2473,11 +2473,11 @@ CK_RV rsa_priv_wrap_get_data(TEMPLATE *tmpl,
         crt_alloced = TRUE;
     }
 
-    rc = ber_encode_RSAPrivateKey(length_only, data, data_len, modulus,
-                                  publ_exp, priv_exp, prime1, prime2,
-                                  exponent1, exponent2, coeff);
+    rc = der_put_RSAPrivateKey(length_only, data, data_len, modulus,
+                               publ_exp, priv_exp, prime1, prime2,
+                               exponent1, exponent2, coeff);
     if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_RSAPrivateKey failed\n");
+        TRACE_DEVEL("der_put_RSAPrivateKey failed\n");
     }
 
     if (crt_alloced) {
@@ -2914,11 +2914,11 @@ CK_RV ibm_dilithium_publ_get_spki(TEMPLATE *tmpl, CK_BBOOL length_only,
         return rc;
     }
 
-    rc = ber_encode_IBM_DilithiumPublicKey(length_only, data, data_len,
-                                           oid->oid, oid->oid_len,
-                                           rho, t1);
+    rc = der_put_IBM_DilithiumPublicKey(length_only, data, data_len,
+                                        oid->oid, oid->oid_len,
+                                        rho, t1);
     if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_IBM_DilithiumPublicKey failed.\n");
+        TRACE_ERROR("der_put_IBM_DilithiumPublicKey failed.\n");
         return rc;
     }
 
@@ -2982,11 +2982,11 @@ CK_RV ibm_dilithium_priv_wrap_get_data(TEMPLATE *tmpl,
         return rc;
     }
 
-    rc = ber_encode_IBM_DilithiumPrivateKey(length_only, data, data_len,
-                                            oid->oid, oid->oid_len,
-                                            rho, seed, tr, s1, s2, t0, t1);
+    rc = der_put_IBM_DilithiumPrivateKey(length_only, data, data_len,
+                                         oid->oid, oid->oid_len,
+                                         rho, seed, tr, s1, s2, t0, t1);
     if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_IBM_DilithiumPrivateKey failed\n");
+        TRACE_DEVEL("der_put_IBM_DilithiumPrivateKey failed\n");
     }
 
     return rc;
@@ -3173,10 +3173,10 @@ CK_RV ibm_kyber_publ_get_spki(TEMPLATE *tmpl, CK_BBOOL length_only,
         return rc;
     }
 
-    rc = ber_encode_IBM_KyberPublicKey(length_only, data, data_len,
-                                       oid->oid, oid->oid_len, pk);
+    rc = der_put_IBM_KyberPublicKey(length_only, data, data_len,
+                                    oid->oid, oid->oid_len, pk);
     if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_IBM_KyberPublicKey failed.\n");
+        TRACE_ERROR("der_put_IBM_KyberPublicKey failed.\n");
         return rc;
     }
 
@@ -3208,10 +3208,10 @@ CK_RV ibm_kyber_priv_wrap_get_data(TEMPLATE *tmpl,
         return rc;
     }
 
-    rc = ber_encode_IBM_KyberPrivateKey(length_only, data, data_len,
-                                        oid->oid, oid->oid_len, sk, pk);
+    rc = der_put_IBM_KyberPrivateKey(length_only, data, data_len,
+                                     oid->oid, oid->oid_len, sk, pk);
     if (rc != CKR_OK) {
-        TRACE_DEVEL("ber_encode_IBM_KyberPrivateKey failed\n");
+        TRACE_DEVEL("der_put_IBM_KyberPrivateKey failed\n");
     }
 
     return rc;
@@ -3616,10 +3616,10 @@ CK_RV dsa_publ_get_spki(TEMPLATE *tmpl, CK_BBOOL length_only,
         return rc;
     }
 
-    rc = ber_encode_DSAPublicKey(length_only, data,data_len, prime, subprime,
-                                 base, value);
+    rc = der_put_DSAPublicKey(length_only, data,data_len, prime, subprime,
+                              base, value);
     if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_DSAPublicKey failed.\n");
+        TRACE_ERROR("der_put_DSAPublicKey failed.\n");
         return rc;
     }
 
@@ -3888,10 +3888,10 @@ CK_RV dsa_priv_wrap_get_data(TEMPLATE *tmpl,
         TRACE_ERROR("Could not find CKA_VALUE for the key.\n");
         return rc;
     }
-    rc = ber_encode_DSAPrivateKey(length_only, data, data_len,
-                                  prime, subprime, base, value);
+    rc = der_put_DSAPrivateKey(length_only, data, data_len,
+                               prime, subprime, base, value);
     if (rc != CKR_OK)
-        TRACE_DEVEL("ber_encode_DSAPrivateKey failed\n");
+        TRACE_DEVEL("der_put_DSAPrivateKey failed\n");
 
     return rc;
 }
@@ -4210,9 +4210,9 @@ CK_RV ec_publ_get_spki(TEMPLATE *tmpl, CK_BBOOL length_only,
         ec_point = &point;
     }
 
-    rc = ber_encode_ECPublicKey(length_only, data,data_len, ec_parms, ec_point);
+    rc = der_put_ECPublicKey(length_only, data,data_len, ec_parms, ec_point);
     if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_ECPublicKey failed.\n");
+        TRACE_ERROR("der_put_ECPublicKey failed.\n");
         goto out;
     }
 
@@ -4426,10 +4426,10 @@ CK_RV ecdsa_priv_wrap_get_data(TEMPLATE *tmpl,
     /* check if optional public-key part was defined */
     template_attribute_get_non_empty(tmpl, CKA_EC_POINT, &pubkey);
 
-    rc = der_encode_ECPrivateKey(length_only, data, data_len, params,
-                                 point, pubkey);
+    rc = der_put_ECPrivateKey(length_only, data, data_len, params,
+                              point, pubkey);
     if (rc != CKR_OK) {
-        TRACE_DEVEL("der_encode_ECPrivateKey failed\n");
+        TRACE_DEVEL("der_put_ECPrivateKey failed\n");
     }
 
     return rc;
@@ -4700,9 +4700,9 @@ CK_RV dh_publ_get_spki(TEMPLATE *tmpl, CK_BBOOL length_only,
         return rc;
     }
 
-    rc = ber_encode_DHPublicKey(length_only, data,data_len, prime, base, value);
+    rc = der_put_DHPublicKey(length_only, data,data_len, prime, base, value);
     if (rc != CKR_OK) {
-        TRACE_ERROR("ber_encode_DHPublicKey failed.\n");
+        TRACE_ERROR("der_put_DHPublicKey failed.\n");
         return rc;
     }
 
@@ -5085,10 +5085,10 @@ CK_RV dh_priv_wrap_get_data(TEMPLATE *tmpl,
         TRACE_ERROR("Could not find CKA_VALUE for the key.\n");
         return rc;
     }
-    rc = ber_encode_DHPrivateKey(length_only, data, data_len,
-                                 prime, base, value);
+    rc = der_put_DHPrivateKey(length_only, data, data_len,
+                              prime, base, value);
     if (rc != CKR_OK)
-        TRACE_DEVEL("ber_encode_DHPrivateKey failed\n");
+        TRACE_DEVEL("der_put_DHPrivateKey failed\n");
 
     return rc;
 }
@@ -967,8 +967,13 @@ CK_RV key_mgr_wrap_key(STDLL_TokData_t *tokdata,
         }
         break;
     case CKK_RSA:
-        rc = rsa_priv_wrap_get_data(key_obj->template, length_only, &data,
-                                    &data_len);
+        if (token_specific.t_rsa_priv_wrap_get_data != NULL)
+            rc = token_specific.t_rsa_priv_wrap_get_data(tokdata, key_obj,
+                                                         length_only, &data,
+                                                         &data_len);
+        else
+            rc = rsa_priv_wrap_get_data(key_obj->template, length_only, &data,
+                                        &data_len);
         if (rc != CKR_OK) {
             TRACE_DEVEL("rsa_priv_wrap_get_data failed.\n");
             goto done;
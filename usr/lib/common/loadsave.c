@@ -41,6 +41,7 @@
 #include "trace.h"
 #include "ock_syslog.h"
 #include "slotmgr.h" // for ock_snprintf
+#include "shared_memory.h"
 
 CK_RV set_perm(int, const char *group);
 
@@ -50,6 +51,7 @@ CK_RV restore_private_token_object_old(STDLL_TokData_t *tokdata, CK_BYTE *data,
 CK_RV reload_token_object_old(STDLL_TokData_t *tokdata, OBJECT *obj);
 CK_RV save_public_token_object_old(STDLL_TokData_t *tokdata, OBJECT *obj);
 CK_RV load_public_token_objects_old(STDLL_TokData_t *tokdata);
+static void publ_obj_cache_remove(STDLL_TokData_t *tokdata);
 
 static int get_token_object_path(char *buf, size_t buflen,
                                  STDLL_TokData_t *tokdata, char *path)
@@ -317,6 +319,10 @@ CK_RV delete_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
     else
         unlink(fname);
 
+    /* A new object might get the same name, so drop the cached objects */
+    if (!object_is_private(obj))
+        publ_obj_cache_remove(tokdata);
+
     return CKR_OK;
 }
 
@@ -340,6 +346,8 @@ CK_RV delete_token_data(STDLL_TokData_t *tokdata)
     if (system(cmd))
         TRACE_ERROR("system() failed.\n");
 
+    publ_obj_cache_remove(tokdata);
+
 done:
     free(cmd);
 
@@ -2928,6 +2936,383 @@ done:
     return rc;
 }
 
+/*
+ * Shared public token object cache
+ *
+ * If enabled via environment variable OPENCRYPTOKI_PUBLIC_OBJECT_CACHE=1, the
+ * process that loads the public token objects from disk stores their
+ * flattened representation in a read-only shared memory segment. Processes
+ * that initialize the token later on restore the objects from that segment
+ * instead of reading every object file.
+ *
+ * A cached object is only used if the token's shared memory segment contains
+ * an entry for it with the same update counters, otherwise the object file is
+ * read. Deleting a public token object removes the cache, since a new object
+ * may get the same name later on. The cache is only accessed while holding
+ * the token lock (XProcLock).
+ *
+ * The cache only saves reading and parsing the object files. Every process
+ * still restores its own OBJECTs from the cached data, since they contain
+ * pointers and locks private to the process.
+ */
+#define PUBL_OBJ_CACHE_ENV          "OPENCRYPTOKI_PUBLIC_OBJECT_CACHE"
+#define PUBL_OBJ_CACHE_NAME         "PUBLIC_OBJECT_CACHE"
+#define PUBL_OBJ_CACHE_MAGIC        0x4f434b43  /* 'OCKC' */
+#define PUBL_OBJ_CACHE_ALIGN(x)     (((x) + 7) & ~((size_t)7))
+#define PUBL_OBJ_CACHE_NO_ENTRY     ((CK_ULONG)-1)
+
+struct publ_obj_cache_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_objs;
+    uint32_t reserved;
+};
+
+struct publ_obj_cache_rec {
+    char name[8];
+    uint32_t count_lo;
+    uint32_t count_hi;
+    uint32_t size;
+    uint32_t reserved;
+    /* Followed by the flattened object, padded to a multiple of 8 bytes */
+};
+
+struct publ_obj_cache {
+    void *addr;
+    uint32_t num_recs;
+    const struct publ_obj_cache_rec **recs;    /* sorted by name */
+    CK_ULONG *shm_idx;  /* per rec: index of the matching entry in the
+                           token's SHM, or PUBL_OBJ_CACHE_NO_ENTRY */
+};
+
+struct publ_obj_cache_build {
+    OBJECT **objs;
+    CK_BYTE **flat;
+    CK_ULONG *flat_len;
+    unsigned long num_objs;
+    unsigned long max_objs;
+    size_t len;
+    CK_RV rc;
+};
+
+static CK_BBOOL publ_obj_cache_enabled(void)
+{
+    const char *env = secure_getenv(PUBL_OBJ_CACHE_ENV);
+
+    return (env != NULL && strcmp(env, "1") == 0) ? TRUE : FALSE;
+}
+
+static char *get_publ_obj_cache_name(STDLL_TokData_t *tokdata, char *buf,
+                                     size_t buflen)
+{
+    char pk_dir[PATH_MAX];
+
+    if (get_pk_dir(tokdata, pk_dir, sizeof(pk_dir)) == NULL)
+        return NULL;
+
+    if (ock_snprintf(buf, buflen, "%s/" PUBL_OBJ_CACHE_NAME, pk_dir) != 0)
+        return NULL;
+
+    return buf;
+}
+
+static void publ_obj_cache_remove(STDLL_TokData_t *tokdata)
+{
+    char name[PATH_MAX];
+
+    if (get_publ_obj_cache_name(tokdata, name, sizeof(name)) == NULL) {
+        TRACE_ERROR("public object cache name buffer overflow\n");
+        return;
+    }
+
+    sm_unlink(name);
+}
+
+static int publ_obj_cache_rec_cmp(const void *a, const void *b)
+{
+    const struct publ_obj_cache_rec *ra =
+                            *(const struct publ_obj_cache_rec **)a;
+    const struct publ_obj_cache_rec *rb =
+                            *(const struct publ_obj_cache_rec **)b;
+
+    return memcmp(ra->name, rb->name, sizeof(ra->name));
+}
+
+static void publ_obj_cache_detach(struct publ_obj_cache *cache)
+{
+    if (cache->recs != NULL)
+        free(cache->recs);
+    if (cache->shm_idx != NULL)
+        free(cache->shm_idx);
+    if (cache->addr != NULL)
+        sm_close_readonly(cache->addr);
+    memset(cache, 0, sizeof(*cache));
+}
+
+/*
+ * Matches the cache records against the entries in the token's shared memory
+ * segment once, so that looking up an object while loading does not need to
+ * scan all entries. A record is only used if the entry has the same update
+ * counters.
+ */
+static CK_RV publ_obj_cache_index(STDLL_TokData_t *tokdata,
+                                  struct publ_obj_cache *cache)
+{
+    const struct publ_obj_cache_rec **found;
+    const struct publ_obj_cache_rec *rec;
+    struct publ_obj_cache_rec key;
+    const TOK_OBJ_ENTRY *entry;
+    CK_ULONG_32 i;
+
+    cache->shm_idx = calloc(cache->num_recs + 1, sizeof(*cache->shm_idx));
+    if (cache->shm_idx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+    for (i = 0; i < cache->num_recs; i++)
+        cache->shm_idx[i] = PUBL_OBJ_CACHE_NO_ENTRY;
+
+    rec = &key;
+    for (i = 0; i < tokdata->global_shm->num_publ_tok_obj; i++) {
+        entry = &tokdata->global_shm->publ_tok_objs[i];
+        if (entry->deleted == TRUE)
+            continue;
+
+        memcpy(key.name, entry->name, sizeof(key.name));
+        found = bsearch(&rec, cache->recs, cache->num_recs,
+                        sizeof(*cache->recs), publ_obj_cache_rec_cmp);
+        if (found == NULL ||
+            (*found)->count_lo != entry->count_lo ||
+            (*found)->count_hi != entry->count_hi)
+            continue;
+
+        cache->shm_idx[found - cache->recs] = i;
+    }
+
+    return CKR_OK;
+}
+
+static CK_RV publ_obj_cache_attach(STDLL_TokData_t *tokdata,
+                                   struct publ_obj_cache *cache)
+{
+    const struct publ_obj_cache_hdr *hdr;
+    const struct publ_obj_cache_rec *rec;
+    char name[PATH_MAX];
+    size_t len, ofs;
+    uint32_t i;
+
+    memset(cache, 0, sizeof(*cache));
+
+    if (get_publ_obj_cache_name(tokdata, name, sizeof(name)) == NULL) {
+        TRACE_ERROR("public object cache name buffer overflow\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (sm_open_readonly(name, 0660, &cache->addr, &len,
+                         tokdata->tokgroup) != 0) {
+        cache->addr = NULL;
+        return CKR_FUNCTION_FAILED;
+    }
+
+    hdr = cache->addr;
+    if (len < sizeof(*hdr) || hdr->magic != PUBL_OBJ_CACHE_MAGIC ||
+        hdr->version != tokdata->version) {
+        TRACE_DEVEL("public object cache is invalid\n");
+        goto error;
+    }
+
+    if (hdr->num_objs > MAX_TOK_OBJS) {
+        TRACE_DEVEL("public object cache has too many objects\n");
+        goto error;
+    }
+
+    cache->recs = calloc(hdr->num_objs + 1, sizeof(*cache->recs));
+    if (cache->recs == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        goto error;
+    }
+
+    for (i = 0, ofs = sizeof(*hdr); i < hdr->num_objs; i++) {
+        if (len - ofs < sizeof(*rec))
+            goto truncated;
+        rec = (const struct publ_obj_cache_rec *)
+                                    ((const CK_BYTE *)cache->addr + ofs);
+        ofs += sizeof(*rec);
+        if (rec->size >= 0x80000000 ||
+            len - ofs < PUBL_OBJ_CACHE_ALIGN(rec->size))
+            goto truncated;
+        ofs += PUBL_OBJ_CACHE_ALIGN(rec->size);
+
+        cache->recs[i] = rec;
+    }
+    cache->num_recs = hdr->num_objs;
+
+    qsort(cache->recs, cache->num_recs, sizeof(*cache->recs),
+          publ_obj_cache_rec_cmp);
+
+    if (publ_obj_cache_index(tokdata, cache) != CKR_OK)
+        goto error;
+
+    return CKR_OK;
+
+truncated:
+    TRACE_DEVEL("public object cache is truncated\n");
+error:
+    publ_obj_cache_detach(cache);
+    return CKR_FUNCTION_FAILED;
+}
+
+/*
+ * Returns the cache record for the object with the specified name, if its
+ * update counters match the ones in the token's shared memory segment. The
+ * index of the object's entry in the shared memory segment is returned in
+ * shm_index.
+ */
+static const struct publ_obj_cache_rec *publ_obj_cache_find(
+                                            struct publ_obj_cache *cache,
+                                            const char *name,
+                                            CK_ULONG *shm_index)
+{
+    const struct publ_obj_cache_rec **found;
+    const struct publ_obj_cache_rec *rec;
+    struct publ_obj_cache_rec key;
+
+    if (strlen(name) != sizeof(key.name))
+        return NULL;
+
+    memcpy(key.name, name, sizeof(key.name));
+    rec = &key;
+    found = bsearch(&rec, cache->recs, cache->num_recs, sizeof(*cache->recs),
+                    publ_obj_cache_rec_cmp);
+    if (found == NULL)
+        return NULL;
+
+    *shm_index = cache->shm_idx[found - cache->recs];
+    if (*shm_index == PUBL_OBJ_CACHE_NO_ENTRY)
+        return NULL;
+
+    return *found;
+}
+
+static void publ_obj_cache_flatten_cb(STDLL_TokData_t *tokdata, void *node,
+                                      unsigned long obj_handle, void *p3)
+{
+    struct publ_obj_cache_build *build = p3;
+    OBJECT *obj = node;
+    CK_BYTE *flat = NULL;
+    CK_ULONG flat_len;
+    CK_RV rc;
+
+    UNUSED(tokdata);
+    UNUSED(obj_handle);
+
+    if (build->rc != CKR_OK)
+        return;
+
+    if (build->num_objs >= build->max_objs) {
+        build->rc = CKR_BUFFER_TOO_SMALL;
+        return;
+    }
+
+    rc = object_flatten(obj, &flat, &flat_len);
+    if (rc != CKR_OK) {
+        build->rc = rc;
+        return;
+    }
+
+    build->objs[build->num_objs] = obj;
+    build->flat[build->num_objs] = flat;
+    build->flat_len[build->num_objs] = flat_len;
+    build->num_objs++;
+    build->len += sizeof(struct publ_obj_cache_rec) +
+                                    PUBL_OBJ_CACHE_ALIGN(flat_len);
+}
+
+/*
+ * (Re-)create the cache from the public token objects currently loaded.
+ */
+static void publ_obj_cache_build(STDLL_TokData_t *tokdata)
+{
+    struct publ_obj_cache_build build = { 0 };
+    struct publ_obj_cache_hdr *hdr;
+    struct publ_obj_cache_rec *rec;
+    char name[PATH_MAX];
+    CK_BYTE *addr = NULL;
+    unsigned long i;
+    size_t ofs;
+
+    if (get_publ_obj_cache_name(tokdata, name, sizeof(name)) == NULL) {
+        TRACE_ERROR("public object cache name buffer overflow\n");
+        return;
+    }
+
+    build.max_objs = bt_nodes_in_use(&tokdata->publ_token_obj_btree);
+    if (build.max_objs == 0 || build.max_objs > MAX_TOK_OBJS) {
+        sm_unlink(name);
+        return;
+    }
+
+    build.objs = calloc(build.max_objs, sizeof(*build.objs));
+    build.flat = calloc(build.max_objs, sizeof(*build.flat));
+    build.flat_len = calloc(build.max_objs, sizeof(*build.flat_len));
+    if (build.objs == NULL || build.flat == NULL || build.flat_len == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        build.rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+    build.len = sizeof(struct publ_obj_cache_hdr);
+
+    bt_for_each_node(tokdata, &tokdata->publ_token_obj_btree,
+                     publ_obj_cache_flatten_cb, &build);
+    if (build.rc != CKR_OK)
+        goto out;
+
+    if (sm_open(name, 0660, (void **)&addr, build.len, 1,
+                tokdata->tokgroup) < 0) {
+        TRACE_DEVEL("sm_open for public object cache failed.\n");
+        build.rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    /* Mark the cache invalid while it is being written */
+    hdr = (struct publ_obj_cache_hdr *)addr;
+    hdr->magic = 0;
+    hdr->version = tokdata->version;
+    hdr->num_objs = build.num_objs;
+    hdr->reserved = 0;
+
+    for (i = 0, ofs = sizeof(*hdr); i < build.num_objs; i++) {
+        rec = (struct publ_obj_cache_rec *)(addr + ofs);
+        memcpy(rec->name, build.objs[i]->name, sizeof(rec->name));
+        rec->count_lo = build.objs[i]->count_lo;
+        rec->count_hi = build.objs[i]->count_hi;
+        rec->size = build.flat_len[i];
+        rec->reserved = 0;
+        ofs += sizeof(*rec);
+
+        memcpy(addr + ofs, build.flat[i], build.flat_len[i]);
+        ofs += PUBL_OBJ_CACHE_ALIGN(build.flat_len[i]);
+    }
+
+    __sync_synchronize();
+    hdr->magic = PUBL_OBJ_CACHE_MAGIC;
+
+    sm_close(addr, 0, 0);
+
+    TRACE_DEVEL("public object cache created with %lu objects\n",
+                build.num_objs);
+
+out:
+    if (build.rc != CKR_OK)
+        sm_unlink(name);
+
+    for (i = 0; i < build.num_objs; i++)
+        free(build.flat[i]);
+    free(build.objs);
+    free(build.flat);
+    free(build.flat_len);
+}
+
 //
 // Note: The token lock (XProcLock) must be held when calling this function.
 //
@@ -2942,13 +3327,30 @@ CK_RV load_public_token_objects(STDLL_TokData_t *tokdata)
     CK_ULONG_32 size;
     unsigned char header[PUB_HEADER_LEN];
     uint32_t ver;
+    struct publ_obj_cache cache = { 0 };
+    const struct publ_obj_cache_rec *rec;
+    CK_ULONG shm_index;
+    CK_BBOOL use_cache, cache_valid = FALSE;
+    CK_ULONG cache_hits = 0, disk_loads = 0;
 
     if (tokdata->version < TOK_NEW_DATA_STORE)
         return load_public_token_objects_old(tokdata);
 
+    use_cache = publ_obj_cache_enabled();
+    /*
+     * The update counters in the shared memory segment start over when the
+     * segment is created, so the cache can only be used once another
+     * process has loaded the public objects into the current segment.
+     */
+    if (use_cache && tokdata->global_shm->publ_loaded == TRUE)
+        cache_valid = (publ_obj_cache_attach(tokdata, &cache) == CKR_OK);
+
     fp1 = open_token_object_index(iname, sizeof(iname), tokdata, "r");
-    if (!fp1)
+    if (!fp1) {
+        if (cache_valid)
+            publ_obj_cache_detach(&cache);
         return CKR_OK;          // no token objects
+    }
 
     while (fgets(tmp, 50, fp1)) {
         tmp[strlen(tmp) - 1] = 0;
@@ -2956,6 +3358,18 @@ CK_RV load_public_token_objects(STDLL_TokData_t *tokdata)
         sprintf(fname, "%s/%s/", tokdata->data_store, PK_LITE_OBJ_DIR);
         strcat(fname, tmp);
 
+        if (cache_valid) {
+            rec = publ_obj_cache_find(&cache, tmp, &shm_index);
+            if (rec != NULL &&
+                object_mgr_restore_obj_withIndex(tokdata,
+                                                 (CK_BYTE *)(rec + 1), NULL,
+                                                 rec->size, fname,
+                                                 &shm_index) == CKR_OK) {
+                cache_hits++;
+                continue;
+            }
+        }
+
         fp2 = fopen(fname, "r");
         if (!fp2)
             continue;
@@ -3013,10 +3427,29 @@ CK_RV load_public_token_objects(STDLL_TokData_t *tokdata)
                        "Cannot restore token object %s "
                        "(ignoring it)", fname);
         }
+        disk_loads++;
         free(buf);
         fclose(fp2);
     }
 
     fclose(fp1);
+
+    if (use_cache) {
+        TRACE_DEVEL("public object cache: %lu hits, %lu objects read from "
+                    "disk\n", cache_hits, disk_loads);
+
+        /* Re-create the cache if it is missing, stale, or incomplete */
+        if (cache_valid == FALSE || disk_loads > 0 ||
+            cache_hits != cache.num_recs) {
+            if (cache_valid)
+                publ_obj_cache_detach(&cache);
+            cache_valid = FALSE;
+            publ_obj_cache_build(tokdata);
+        }
+
+        if (cache_valid)
+            publ_obj_cache_detach(&cache);
+    }
+
     return CKR_OK;
 }
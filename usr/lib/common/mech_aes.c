@@ -1326,7 +1326,7 @@ static CK_RV aes_xts_crypt_update(STDLL_TokData_t *tokdata,
                                out_data_len, ctx->mech.pParameter, key,
                                !context->initialized, FALSE, context->iv,
                                encrypt);
-        if (rc == CKR_OK) {
+        if (rc != CKR_OK) {
             TRACE_ERROR("ckm_aes_xts_crypt failed\n");
             goto out;
         }
@@ -2960,10 +2960,6 @@ CK_RV aes_mac_verify_final(STDLL_TokData_t *tokdata,
 static void aes_cmac_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
                              CK_BYTE *context, CK_ULONG context_len)
 {
-    UNUSED(tokdata);
-    UNUSED(sess);
-    UNUSED(context_len);
-
     if (((AES_CMAC_CONTEXT *)context)->ctx != NULL) {
         token_specific.t_aes_cmac(tokdata, sess, (CK_BYTE *)"", 0, NULL,
                                   ((AES_CMAC_CONTEXT *)context)->iv,
@@ -2972,7 +2968,7 @@ static void aes_cmac_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
         ((AES_CMAC_CONTEXT *)context)->ctx = NULL;
     }
 
-    free(context);
+    session_mgr_free_context(tokdata, sess, context, context_len);
 }
 
 CK_RV aes_cmac_sign(STDLL_TokData_t *tokdata,
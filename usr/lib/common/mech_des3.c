@@ -2337,10 +2337,6 @@ CK_RV des3_mac_verify_final(STDLL_TokData_t *tokdata,
 static void des3_cmac_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
                               CK_BYTE *context, CK_ULONG context_len)
 {
-    UNUSED(tokdata);
-    UNUSED(sess);
-    UNUSED(context_len);
-
     if (((DES_CMAC_CONTEXT *)context)->ctx != NULL) {
         token_specific.t_tdes_cmac(tokdata, (CK_BYTE *)"", 0, NULL,
                                    ((DES_CMAC_CONTEXT *)context)->iv,
@@ -2349,7 +2345,7 @@ static void des3_cmac_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
         ((DES_CMAC_CONTEXT *)context)->ctx = NULL;
     }
 
-    free(context);
+    session_mgr_free_context(tokdata, sess, context, context_len);
 }
 
 CK_RV des3_cmac_sign(STDLL_TokData_t *tokdata,
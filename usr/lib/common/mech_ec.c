@@ -272,6 +272,12 @@ CK_RV ec_hash_sign(STDLL_TokData_t *tokdata,
         TRACE_ERROR("%s received bad argument(s)\n", __func__);
         return CKR_FUNCTION_FAILED;
     }
+
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_sign(tokdata, sess, ctx, length_only,
+                                          in_data, in_data_len, signature,
+                                          sig_len);
+
     memset(&digest_ctx, 0x0, sizeof(digest_ctx));
     memset(&sign_ctx, 0x0, sizeof(sign_ctx));
 
@@ -339,6 +345,11 @@ CK_RV ec_hash_sign_update(STDLL_TokData_t *tokdata,
         TRACE_ERROR("%s received bad argument(s)\n", __func__);
         return CKR_FUNCTION_FAILED;
     }
+
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_sign_verify_update(tokdata, sess, ctx,
+                                                        in_data, in_data_len);
+
     context = (RSA_DIGEST_CONTEXT *) ctx->context;
 
     if (context->flag == FALSE) {
@@ -389,6 +400,11 @@ CK_RV ec_hash_sign_final(STDLL_TokData_t *tokdata,
         return CKR_FUNCTION_FAILED;
     }
 
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_sign_final(tokdata, sess, ctx,
+                                                length_only, signature,
+                                                sig_len);
+
     memset(&sign_ctx, 0x0, sizeof(sign_ctx));
 
     context = (RSA_DIGEST_CONTEXT *) ctx->context;
@@ -460,6 +476,11 @@ CK_RV ec_hash_verify(STDLL_TokData_t *tokdata,
         TRACE_ERROR("%s received bad argument(s)\n", __func__);
         return CKR_FUNCTION_FAILED;
     }
+
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_verify(tokdata, sess, ctx, in_data,
+                                            in_data_len, signature, sig_len);
+
     memset(&digest_ctx, 0x0, sizeof(digest_ctx));
     memset(&verify_ctx, 0x0, sizeof(verify_ctx));
 
@@ -529,6 +550,11 @@ CK_RV ec_hash_verify_update(STDLL_TokData_t *tokdata,
         TRACE_ERROR("%s received bad argument(s)\n", __func__);
         return CKR_FUNCTION_FAILED;
     }
+
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_sign_verify_update(tokdata, sess, ctx,
+                                                        in_data, in_data_len);
+
     context = (RSA_DIGEST_CONTEXT *) ctx->context;
 
     if (context->flag == FALSE) {
@@ -577,6 +603,11 @@ CK_RV ec_hash_verify_final(STDLL_TokData_t *tokdata,
         TRACE_ERROR("%s received bad argument(s)\n", __func__);
         return CKR_FUNCTION_FAILED;
     }
+
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_verify_final(tokdata, sess, ctx,
+                                                  signature, sig_len);
+
     memset(&verify_ctx, 0x0, sizeof(verify_ctx));
 
     context = (RSA_DIGEST_CONTEXT *) ctx->context;
@@ -133,3 +133,21 @@ void mechanism_list_transformations(CK_MECHANISM_TYPE_PTR mech_arr_ptr,
 {
     netscape_hack(mech_arr_ptr, (*count_ptr));
 }
+
+/*
+ * Returns TRUE if the token performs the mechanism in hardware, or if the
+ * mechanism is not in the token's mechanism list.
+ */
+CK_BBOOL ock_generic_mechanism_is_hw(STDLL_TokData_t *tokdata,
+                                     CK_MECHANISM_TYPE type)
+{
+    unsigned int i;
+
+    for (i = 0; i < tokdata->mech_list_len; i++) {
+        if (tokdata->mech_list[i].mech_type == type)
+            return (tokdata->mech_list[i].mech_info.flags & CKF_HW) ?
+                                                            TRUE : FALSE;
+    }
+
+    return TRUE;
+}
@@ -13,15 +13,18 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include <openssl/opensslv.h>
 
+#include "platform.h"
 #include "pkcs11types.h"
 #include "defs.h"
 #include "host_defs.h"
 #include "h_extern.h"
 #include "tok_spec_struct.h"
 #include "trace.h"
+#include "sw_crypt.h"
 
 #include <openssl/crypto.h>
 #include <openssl/err.h>
@@ -40,6 +43,7 @@
 void openssl_free_ex_data(OBJECT *obj, void *ex_data, size_t ex_data_len)
 {
     struct openssl_ex_data *data = ex_data;
+    int i;
 
     if (ex_data == NULL || ex_data_len < sizeof(struct openssl_ex_data))
         return;
@@ -49,6 +53,42 @@ void openssl_free_ex_data(OBJECT *obj, void *ex_data, size_t ex_data_len)
         data->pkey = NULL;
     }
 
+    for (i = 0; i < OPENSSL_EX_DATA_HMAC_CTXS; i++) {
+        if (data->hmac_ctx[i] != NULL) {
+            EVP_MD_CTX_free(data->hmac_ctx[i]);
+            data->hmac_ctx[i] = NULL;
+        }
+    }
+
+    if (data->cmac_ctx != NULL) {
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+        EVP_MD_CTX_free(data->cmac_ctx);
+#else
+        EVP_MAC_CTX_free(data->cmac_ctx);
+#endif
+        data->cmac_ctx = NULL;
+    }
+
+    for (i = 0; i < 2; i++) {
+        if (data->xts_ctx[i] != NULL) {
+            EVP_CIPHER_CTX_free(data->xts_ctx[i]);
+            data->xts_ctx[i] = NULL;
+        }
+        if (data->xts_tweak_ctx[i] != NULL) {
+            EVP_CIPHER_CTX_free(data->xts_tweak_ctx[i]);
+            data->xts_tweak_ctx[i] = NULL;
+        }
+    }
+
+    for (i = 0; i < 5; i++) {
+        if (data->rsa_crt[i] != NULL) {
+            OPENSSL_cleanse(data->rsa_crt[i]->pValue,
+                            data->rsa_crt[i]->ulValueLen);
+            free(data->rsa_crt[i]);
+            data->rsa_crt[i] = NULL;
+        }
+    }
+
     free(data);
     obj->ex_data = NULL;
     obj->ex_data_len = 0;
@@ -132,56 +172,40 @@ static CK_BBOOL openssl_need_wr_lock(OBJECT *obj, void *ex_data,
     return data->pkey == NULL;
 }
 
-CK_RV openssl_specific_rsa_keygen(TEMPLATE *publ_tmpl, TEMPLATE *priv_tmpl)
+static CK_BBOOL openssl_always_wr_lock(OBJECT *obj, void *ex_data,
+                                       size_t ex_data_len)
 {
-    CK_ATTRIBUTE *publ_exp = NULL;
-    CK_ATTRIBUTE *attr = NULL;
-    CK_ULONG mod_bits;
-    CK_BBOOL flag;
+    UNUSED(obj);
+    UNUSED(ex_data);
+    UNUSED(ex_data_len);
+
+    return TRUE;
+}
+
+/*
+ * Generates an RSA key with the specified modulus size and public exponent.
+ * The public exponent is given as big endian byte array.
+ */
+CK_RV openssl_specific_rsa_keygen_pkey(CK_ULONG mod_bits,
+                                       const CK_BYTE *publ_exp,
+                                       CK_ULONG publ_exp_len,
+                                       EVP_PKEY **pkey)
+{
+    BIGNUM *e = NULL;
+    EVP_PKEY_CTX *ctx = NULL;
     CK_RV rc;
-    CK_ULONG BNLength;
-#if !OPENSSL_VERSION_PREREQ(3, 0)
-    const RSA *rsa = NULL;
-    const BIGNUM *bignum = NULL;
-#else
-    BIGNUM *bignum = NULL;
+#if OPENSSL_VERSION_PREREQ(3, 0)
     int try;
 #endif
-    CK_BYTE *ssl_ptr = NULL;
-    BIGNUM *e = NULL;
-    EVP_PKEY *pkey = NULL;
-    EVP_PKEY_CTX *ctx = NULL;
-
-    rc = template_attribute_get_ulong(publ_tmpl, CKA_MODULUS_BITS, &mod_bits);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s\n", ock_err(ERR_TEMPLATE_INCOMPLETE));
-        return CKR_TEMPLATE_INCOMPLETE; // should never happen
-    }
-
-    // we don't support less than 512 bit keys in the sw
-    if (mod_bits < 512 || mod_bits > OPENSSL_RSA_MAX_MODULUS_BITS) {
-        TRACE_ERROR("%s\n", ock_err(ERR_KEY_SIZE_RANGE));
-        return CKR_KEY_SIZE_RANGE;
-    }
-
-    rc = template_attribute_get_non_empty(publ_tmpl, CKA_PUBLIC_EXPONENT,
-                                          &publ_exp);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s\n", ock_err(ERR_TEMPLATE_INCOMPLETE));
-        return CKR_TEMPLATE_INCOMPLETE;
-    }
 
-    if (publ_exp->ulValueLen > sizeof(CK_ULONG)) {
-        TRACE_ERROR("%s\n", ock_err(ERR_ATTRIBUTE_VALUE_INVALID));
-        return CKR_ATTRIBUTE_VALUE_INVALID;
-    }
+    *pkey = NULL;
 
     e = BN_new();
     if (e == NULL) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         return CKR_HOST_MEMORY;
     }
-    BN_bin2bn(publ_exp->pValue, publ_exp->ulValueLen, e);
+    BN_bin2bn(publ_exp, publ_exp_len, e);
 
     ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
     if (ctx == NULL) {
@@ -219,7 +243,7 @@ CK_RV openssl_specific_rsa_keygen(TEMPLATE *publ_tmpl, TEMPLATE *priv_tmpl)
      * fail to generate a key. Retry up to 10 times in such a case.
      */
     for (try = 1; try <= 10; try++) {
-        if (EVP_PKEY_keygen(ctx, &pkey) == 1) {
+        if (EVP_PKEY_keygen(ctx, pkey) == 1) {
             rc = CKR_OK;
             break;
         }
@@ -227,15 +251,87 @@ CK_RV openssl_specific_rsa_keygen(TEMPLATE *publ_tmpl, TEMPLATE *priv_tmpl)
         TRACE_ERROR("%s (try %d)\n", ock_err(ERR_FUNCTION_FAILED), try);
         rc = CKR_FUNCTION_FAILED;
     }
-    if (rc != CKR_OK)
-        goto done;
 #else
-    if (EVP_PKEY_keygen(ctx, &pkey) != 1) {
+    if (EVP_PKEY_keygen(ctx, pkey) != 1) {
         TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
         rc = CKR_FUNCTION_FAILED;
         goto done;
     }
+    rc = CKR_OK;
+#endif
+
+done:
+    if (ctx != NULL)
+        EVP_PKEY_CTX_free(ctx);
+    if (e != NULL)
+        BN_free(e);
+
+    return rc;
+}
+
+CK_RV openssl_specific_rsa_keygen(TEMPLATE *publ_tmpl, TEMPLATE *priv_tmpl)
+{
+    CK_ATTRIBUTE *publ_exp = NULL;
+    CK_ULONG mod_bits;
+    EVP_PKEY *pkey = NULL;
+    CK_RV rc;
+
+    rc = template_attribute_get_ulong(publ_tmpl, CKA_MODULUS_BITS, &mod_bits);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TEMPLATE_INCOMPLETE));
+        return CKR_TEMPLATE_INCOMPLETE; // should never happen
+    }
+
+    // we don't support less than 512 bit keys in the sw
+    if (mod_bits < 512 || mod_bits > OPENSSL_RSA_MAX_MODULUS_BITS) {
+        TRACE_ERROR("%s\n", ock_err(ERR_KEY_SIZE_RANGE));
+        return CKR_KEY_SIZE_RANGE;
+    }
+
+    rc = template_attribute_get_non_empty(publ_tmpl, CKA_PUBLIC_EXPONENT,
+                                          &publ_exp);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TEMPLATE_INCOMPLETE));
+        return CKR_TEMPLATE_INCOMPLETE;
+    }
+
+    if (publ_exp->ulValueLen > sizeof(CK_ULONG)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ATTRIBUTE_VALUE_INVALID));
+        return CKR_ATTRIBUTE_VALUE_INVALID;
+    }
+
+    rc = openssl_specific_rsa_keygen_pkey(mod_bits, publ_exp->pValue,
+                                          publ_exp->ulValueLen, &pkey);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = openssl_specific_rsa_keygen_from_pkey(pkey, publ_tmpl, priv_tmpl);
+
+    EVP_PKEY_free(pkey);
+
+    return rc;
+}
+
+/*
+ * Adds the components of a generated RSA key to the public and private key
+ * templates.
+ */
+CK_RV openssl_specific_rsa_keygen_from_pkey(EVP_PKEY *pkey,
+                                            TEMPLATE *publ_tmpl,
+                                            TEMPLATE *priv_tmpl)
+{
+    CK_ATTRIBUTE *attr = NULL;
+    CK_BBOOL flag;
+    CK_RV rc;
+    CK_ULONG BNLength = 0;
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    const RSA *rsa = NULL;
+    const BIGNUM *bignum = NULL;
+#else
+    BIGNUM *bignum = NULL;
 #endif
+    CK_BYTE *ssl_ptr = NULL;
+
 #if !OPENSSL_VERSION_PREREQ(3, 0)
     if ((rsa = EVP_PKEY_get0_RSA(pkey)) == NULL) {
         TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
@@ -632,12 +728,6 @@ done:
         OPENSSL_cleanse(ssl_ptr, BNLength);
         free(ssl_ptr);
     }
-    if (pkey != NULL)
-        EVP_PKEY_free(pkey);
-    if (ctx != NULL)
-        EVP_PKEY_CTX_free(ctx);
-    if (e != NULL)
-        BN_free(e);
 #if OPENSSL_VERSION_PREREQ(3, 0)
     if (bignum != NULL)
         BN_free(bignum);
@@ -748,7 +838,111 @@ out:
     return pkey;
 }
 
-static EVP_PKEY *rsa_convert_private_key(OBJECT *key_obj)
+/*
+ * Recovers the CRT components of an RSA private key that was created in
+ * modular-exponent format only, and keeps them in the key's ex_data, so that
+ * this is done only once per object. The caller must hold the ex_data lock
+ * for writing if ex_data->rsa_crt is not yet set.
+ */
+CK_RV openssl_rsa_recover_crt(OBJECT *key_obj,
+                              struct openssl_ex_data *ex_data)
+{
+    CK_ATTRIBUTE *modulus = NULL, *pub_exp = NULL, *priv_exp = NULL;
+    CK_RV rc;
+
+    if (ex_data->rsa_crt[0] != NULL)
+        return CKR_OK;
+
+    if (template_attribute_get_non_empty(key_obj->template, CKA_MODULUS,
+                                         &modulus) != CKR_OK ||
+        template_attribute_get_non_empty(key_obj->template,
+                                         CKA_PUBLIC_EXPONENT,
+                                         &pub_exp) != CKR_OK ||
+        template_attribute_get_non_empty(key_obj->template,
+                                         CKA_PRIVATE_EXPONENT,
+                                         &priv_exp) != CKR_OK) {
+        TRACE_ERROR("%s\n", ock_err(ERR_TEMPLATE_INCOMPLETE));
+        return CKR_TEMPLATE_INCOMPLETE;
+    }
+
+    rc = calc_rsa_crt_from_me(modulus, pub_exp, priv_exp, &ex_data->rsa_crt[0],
+                              &ex_data->rsa_crt[1], &ex_data->rsa_crt[2],
+                              &ex_data->rsa_crt[3], &ex_data->rsa_crt[4]);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("calc_rsa_crt_from_me failed\n");
+
+    return rc;
+}
+
+static CK_BBOOL openssl_need_wr_lock_rsa_crt(OBJECT *obj, void *ex_data,
+                                             size_t ex_data_len)
+{
+    struct openssl_ex_data *data = ex_data;
+
+    UNUSED(obj);
+
+    if (ex_data == NULL || ex_data_len < sizeof(struct openssl_ex_data))
+        return FALSE;
+
+    return data->rsa_crt[0] == NULL;
+}
+
+/*
+ * Creates the PKCS #8 encoding of an RSA private key for wrapping, like
+ * rsa_priv_wrap_get_data(). The CRT components of a key created in
+ * modular-exponent format are taken from the key's ex_data, so that they
+ * are recovered only on the first wrap. The ex_data_len and ex_data_free
+ * arguments are those the token uses for its ex_data.
+ */
+CK_RV openssl_rsa_priv_wrap_get_data(OBJECT *key_obj, size_t ex_data_len,
+                                     void (*ex_data_free)(struct _OBJECT *obj,
+                                                          void *ex_data,
+                                                          size_t ex_data_len),
+                                     CK_BBOOL length_only, CK_BYTE **data,
+                                     CK_ULONG *data_len)
+{
+    struct openssl_ex_data *ex_data = NULL;
+    CK_ATTRIBUTE *modulus = NULL, *publ_exp = NULL, *priv_exp = NULL;
+    CK_ATTRIBUTE *prime1 = NULL;
+    CK_RV rc;
+
+    template_attribute_get_non_empty(key_obj->template, CKA_PRIME_1, &prime1);
+    if (prime1 != NULL)
+        return rsa_priv_wrap_get_data(key_obj->template, length_only,
+                                      data, data_len);
+
+    rc = openssl_get_ex_data(key_obj, (void **)&ex_data, ex_data_len,
+                             openssl_need_wr_lock_rsa_crt, ex_data_free);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = openssl_rsa_recover_crt(key_obj, ex_data);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("openssl_rsa_recover_crt failed\n");
+        goto done;
+    }
+
+    template_attribute_get_non_empty(key_obj->template, CKA_MODULUS, &modulus);
+    template_attribute_get_non_empty(key_obj->template, CKA_PUBLIC_EXPONENT,
+                                     &publ_exp);
+    template_attribute_get_non_empty(key_obj->template, CKA_PRIVATE_EXPONENT,
+                                     &priv_exp);
+
+    rc = der_put_RSAPrivateKey(length_only, data, data_len, modulus,
+                               publ_exp, priv_exp, ex_data->rsa_crt[0],
+                               ex_data->rsa_crt[1], ex_data->rsa_crt[2],
+                               ex_data->rsa_crt[3], ex_data->rsa_crt[4]);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("der_put_RSAPrivateKey failed\n");
+
+done:
+    object_ex_data_unlock(key_obj);
+
+    return rc;
+}
+
+static EVP_PKEY *rsa_convert_private_key(OBJECT *key_obj,
+                                         struct openssl_ex_data *ex_data)
 {
     CK_ATTRIBUTE *modulus = NULL;
     CK_ATTRIBUTE *pub_exp = NULL;
@@ -798,6 +992,21 @@ static EVP_PKEY *rsa_convert_private_key(OBJECT *key_obj)
     RSA_set_method(rsa, RSA_PKCS1_OpenSSL());
 #endif
 
+    /*
+     * Keys created in modular-exponent format get their CRT components
+     * recovered into the object's ex_data, so that the private key operations
+     * use CRT.
+     */
+    if (!prime1 && !prime2 && !exp_1 && !exp_2 && !coeff &&
+        modulus && pub_exp && priv_exp &&
+        openssl_rsa_recover_crt(key_obj, ex_data) == CKR_OK) {
+        prime1 = ex_data->rsa_crt[0];
+        prime2 = ex_data->rsa_crt[1];
+        exp_1 = ex_data->rsa_crt[2];
+        exp_2 = ex_data->rsa_crt[3];
+        coeff = ex_data->rsa_crt[4];
+    }
+
     bn_mod = BN_new();
     bn_pub_exp = BN_new();
     bn_priv_exp = BN_new();
@@ -1054,7 +1263,7 @@ CK_RV openssl_specific_rsa_decrypt(STDLL_TokData_t *tokdata, CK_BYTE *in_data,
         return rc;
 
     if (ex_data->pkey == NULL) {
-        ex_data->pkey = rsa_convert_private_key(key_obj);
+        ex_data->pkey = rsa_convert_private_key(key_obj, ex_data);
         if (ex_data->pkey == NULL) {
             TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
             rc = CKR_FUNCTION_FAILED;
@@ -2348,45 +2557,28 @@ out:
     return CKR_OK;
 }
 
-CK_RV openssl_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
-                                           TEMPLATE *publ_tmpl,
-                                           TEMPLATE *priv_tmpl)
+/*
+ * Generates an EC key on the curve specified by the DER encoded EC parameters.
+ */
+CK_RV openssl_specific_ec_keygen_pkey(const CK_BYTE *params,
+                                      CK_ULONG params_len, EVP_PKEY **pkey)
 {
-
-    CK_ATTRIBUTE *attr = NULL, *ec_point_attr, *value_attr, *parms_attr;
-#if !OPENSSL_VERSION_PREREQ(3, 0)
-    const EC_KEY *ec_key = NULL;
-    BN_CTX *bnctx = NULL;
-#else
-    BIGNUM *bn_d = NULL;
-    int len;
-#endif
-    CK_BYTE *ecpoint = NULL, *enc_ecpoint = NULL, *d = NULL;
-    CK_ULONG enc_ecpoint_len, d_len;
-    size_t ecpoint_len;
     EVP_PKEY_CTX *ctx = NULL;
-    EVP_PKEY *ec_pkey = NULL;
     int nid;
     CK_RV rc;
 
-    UNUSED(tokdata);
-
-    rc = template_attribute_get_non_empty(publ_tmpl, CKA_ECDSA_PARAMS, &attr);
-    if (rc != CKR_OK)
-        goto out;
+    *pkey = NULL;
 
-    nid = curve_nid_from_params(attr->pValue, attr->ulValueLen);
+    nid = curve_nid_from_params(params, params_len);
     if (nid == NID_undef) {
         TRACE_ERROR("curve not supported by OpenSSL.\n");
-        rc = CKR_CURVE_NOT_SUPPORTED;
-        goto out;
+        return CKR_CURVE_NOT_SUPPORTED;
     }
 
     ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
     if (ctx == NULL) {
         TRACE_ERROR("EVP_PKEY_CTX_new failed\n");
-        rc = CKR_FUNCTION_FAILED;
-        goto out;
+        return CKR_FUNCTION_FAILED;
     }
 
     if (EVP_PKEY_keygen_init(ctx) <= 0) {
@@ -2401,7 +2593,7 @@ CK_RV openssl_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
         goto out;
     }
 
-    if (EVP_PKEY_keygen(ctx, &ec_pkey) <= 0) {
+    if (EVP_PKEY_keygen(ctx, pkey) <= 0) {
         TRACE_ERROR("EVP_PKEY_keygen failed\n");
         if (ERR_GET_REASON(ERR_peek_last_error()) == EC_R_INVALID_CURVE)
             rc = CKR_CURVE_NOT_SUPPORTED;
@@ -2410,42 +2602,110 @@ CK_RV openssl_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
         goto out;
     }
 
-#if !OPENSSL_VERSION_PREREQ(3, 0)
-    ec_key = EVP_PKEY_get0_EC_KEY(ec_pkey);
-    if (ec_key == NULL) {
-       TRACE_ERROR("EVP_PKEY_get0_EC_KEY failed\n");
-       rc = CKR_FUNCTION_FAILED;
-       goto out;
-   }
-
-    bnctx = BN_CTX_new();
-    if (bnctx == NULL) {
-        rc = CKR_HOST_MEMORY;
-        goto out;
-    }
+    rc = CKR_OK;
 
-    ecpoint_len = EC_KEY_key2buf(ec_key, POINT_CONVERSION_UNCOMPRESSED,
-                                 &ecpoint, bnctx);
-    if (ecpoint_len == 0) {
-        TRACE_ERROR("Failed to get the EC Point compressed.\n");
-        rc = CKR_FUNCTION_FAILED;
-        goto out;
-    }
-#else
-    if (!EVP_PKEY_get_octet_string_param(ec_pkey,
-                                         OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY,
-                                         NULL, 0, &ecpoint_len)) {
-        TRACE_ERROR("EVP_PKEY_get_octet_string_param failed\n");
-        rc = CKR_FUNCTION_FAILED;
-        goto out;
-    }
+out:
+    EVP_PKEY_CTX_free(ctx);
 
-    ecpoint = OPENSSL_zalloc(ecpoint_len);
-    if (ecpoint == NULL) {
-        TRACE_ERROR("OPENSSL_zalloc failed\n");
-        rc = CKR_HOST_MEMORY;
-        goto out;
-    }
+    return rc;
+}
+
+CK_RV openssl_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
+                                           TEMPLATE *publ_tmpl,
+                                           TEMPLATE *priv_tmpl)
+{
+    CK_ATTRIBUTE *attr = NULL;
+    EVP_PKEY *ec_pkey = NULL;
+    CK_RV rc;
+
+    UNUSED(tokdata);
+
+    rc = template_attribute_get_non_empty(publ_tmpl, CKA_ECDSA_PARAMS, &attr);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = openssl_specific_ec_keygen_pkey(attr->pValue, attr->ulValueLen,
+                                         &ec_pkey);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = openssl_specific_ec_keygen_from_pkey(ec_pkey, publ_tmpl, priv_tmpl);
+
+    EVP_PKEY_free(ec_pkey);
+
+    return rc;
+}
+
+/*
+ * Adds the components of a generated EC key to the public and private key
+ * templates. The public key template must contain CKA_ECDSA_PARAMS.
+ */
+CK_RV openssl_specific_ec_keygen_from_pkey(EVP_PKEY *ec_pkey,
+                                           TEMPLATE *publ_tmpl,
+                                           TEMPLATE *priv_tmpl)
+{
+
+    CK_ATTRIBUTE *attr = NULL, *ec_point_attr, *value_attr, *parms_attr;
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    const EC_KEY *ec_key = NULL;
+    BN_CTX *bnctx = NULL;
+#else
+    BIGNUM *bn_d = NULL;
+    int len;
+#endif
+    CK_BYTE *ecpoint = NULL, *enc_ecpoint = NULL, *d = NULL;
+    CK_ULONG enc_ecpoint_len, d_len;
+    size_t ecpoint_len;
+    int nid;
+    CK_RV rc;
+
+    rc = template_attribute_get_non_empty(publ_tmpl, CKA_ECDSA_PARAMS, &attr);
+    if (rc != CKR_OK)
+        goto out;
+
+    nid = curve_nid_from_params(attr->pValue, attr->ulValueLen);
+    if (nid == NID_undef) {
+        TRACE_ERROR("curve not supported by OpenSSL.\n");
+        rc = CKR_CURVE_NOT_SUPPORTED;
+        goto out;
+    }
+
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    ec_key = EVP_PKEY_get0_EC_KEY(ec_pkey);
+    if (ec_key == NULL) {
+       TRACE_ERROR("EVP_PKEY_get0_EC_KEY failed\n");
+       rc = CKR_FUNCTION_FAILED;
+       goto out;
+   }
+
+    bnctx = BN_CTX_new();
+    if (bnctx == NULL) {
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
+
+    ecpoint_len = EC_KEY_key2buf(ec_key, POINT_CONVERSION_UNCOMPRESSED,
+                                 &ecpoint, bnctx);
+    if (ecpoint_len == 0) {
+        TRACE_ERROR("Failed to get the EC Point compressed.\n");
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+#else
+    if (!EVP_PKEY_get_octet_string_param(ec_pkey,
+                                         OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY,
+                                         NULL, 0, &ecpoint_len)) {
+        TRACE_ERROR("EVP_PKEY_get_octet_string_param failed\n");
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    ecpoint = OPENSSL_zalloc(ecpoint_len);
+    if (ecpoint == NULL) {
+        TRACE_ERROR("OPENSSL_zalloc failed\n");
+        rc = CKR_HOST_MEMORY;
+        goto out;
+    }
 
     if (!EVP_PKEY_get_octet_string_param(ec_pkey,
                                          OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY,
@@ -2538,8 +2798,6 @@ CK_RV openssl_specific_ec_generate_keypair(STDLL_TokData_t *tokdata,
     rc = CKR_OK;
 
 out:
-    if (ctx != NULL)
-        EVP_PKEY_CTX_free(ctx);
 #if !OPENSSL_VERSION_PREREQ(3, 0)
     if (bnctx != NULL)
         BN_CTX_free(bnctx);
@@ -2547,8 +2805,6 @@ out:
     if (bn_d != NULL)
         BN_free(bn_d);
 #endif
-    if (ec_pkey != NULL)
-        EVP_PKEY_free(ec_pkey);
     if (ecpoint != NULL)
         OPENSSL_free(ecpoint);
     if (enc_ecpoint != NULL)
@@ -3061,7 +3317,67 @@ static EVP_MD_CTX *md_ctx_from_context(DIGEST_CONTEXT *ctx)
 }
 #endif
 
+/*
+ * The state of an OpenSSL 3 digest or of an HMAC operation can not be saved
+ * with C_GetOperationState. With OPENCRYPTOKI_SAVEABLE_DIGEST_STATE=1 the
+ * SHA digests, and HMACs with non-sensitive, extractable keys, use the
+ * software implementation in sw_crypt.h instead, whose state can be saved,
+ * at the cost of performance.
+ */
+#define SAVEABLE_DIGEST_STATE_ENV   "OPENCRYPTOKI_SAVEABLE_DIGEST_STATE"
+
+static CK_BBOOL saveable_digest_state_enabled(void)
+{
+    const char *env = secure_getenv(SAVEABLE_DIGEST_STATE_ENV);
+
+    return (env != NULL && strcmp(env, "1") == 0) ? TRUE : FALSE;
+}
+
 #if OPENSSL_VERSION_PREREQ(3, 0)
+/* Returns the software digest state, or NULL for an EVP_MD_CTX */
+static SW_SHA_CTX *sw_sha_context(DIGEST_CONTEXT *ctx)
+{
+    if (ctx->context_len != sizeof(SW_SHA_CTX))
+        return NULL;
+
+    return (SW_SHA_CTX *)ctx->context;
+}
+
+static CK_RV sw_sha_context_init(DIGEST_CONTEXT *ctx)
+{
+    SW_SHA_CTX *sw_ctx;
+    CK_RV rc;
+
+    sw_ctx = malloc(sizeof(*sw_ctx));
+    if (sw_ctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    rc = sw_sha_init(sw_ctx, ctx->mech.mechanism);
+    if (rc != CKR_OK) {
+        free(sw_ctx);
+        return rc;
+    }
+
+    /* Plain data, freed with free() and saveable */
+    ctx->context = (CK_BYTE *)sw_ctx;
+    ctx->context_len = sizeof(*sw_ctx);
+    ctx->context_free_func = NULL;
+    ctx->state_unsaveable = CK_FALSE;
+
+    return CKR_OK;
+}
+
+static void sw_sha_context_free(DIGEST_CONTEXT *ctx)
+{
+    OPENSSL_cleanse(ctx->context, ctx->context_len);
+    free(ctx->context);
+    ctx->context = NULL;
+    ctx->context_len = 0;
+    ctx->context_free_func = NULL;
+}
+
 static void openssl_specific_sha_free(STDLL_TokData_t *tokdata, SESSION *sess,
                                       CK_BYTE *context, CK_ULONG context_len)
 {
@@ -3080,6 +3396,7 @@ CK_RV openssl_specific_sha_init(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
     EVP_MD_CTX *md_ctx;
 #else
     const EVP_MD *md;
+    CK_RV rc;
 #endif
 
     UNUSED(tokdata);
@@ -3096,6 +3413,13 @@ CK_RV openssl_specific_sha_init(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
 
     EVP_MD_CTX_free(md_ctx);
 #else
+    /* Digests not implemented in software use OpenSSL */
+    if (saveable_digest_state_enabled()) {
+        rc = sw_sha_context_init(ctx);
+        if (rc != CKR_MECHANISM_INVALID)
+            return rc;
+    }
+
     ctx->context_len = 1;
     ctx->context = (CK_BYTE *)EVP_MD_CTX_new();
     if (ctx->context == NULL) {
@@ -3126,6 +3450,8 @@ CK_RV openssl_specific_sha(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
     CK_RV rc = CKR_OK;
 #if !OPENSSL_VERSION_PREREQ(3, 0)
     EVP_MD_CTX *md_ctx;
+#else
+    SW_SHA_CTX *sw_ctx;
 #endif
 
     UNUSED(tokdata);
@@ -3156,6 +3482,24 @@ CK_RV openssl_specific_sha(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
 
     *out_data_len = len;
 #else
+    sw_ctx = sw_sha_context(ctx);
+    if (sw_ctx != NULL) {
+        if (*out_data_len < sw_ctx->digest_len) {
+            TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
+            return CKR_BUFFER_TOO_SMALL;
+        }
+
+        len = sw_ctx->digest_len;
+        rc = sw_sha_update(sw_ctx, in_data, in_data_len);
+        if (rc == CKR_OK)
+            rc = sw_sha_final(sw_ctx, out_data);
+        if (rc == CKR_OK)
+            *out_data_len = len;
+
+        sw_sha_context_free(ctx);
+        return rc;
+    }
+
     if (*out_data_len < (CK_ULONG)EVP_MD_CTX_size((EVP_MD_CTX *)ctx->context)) {
         TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
         return CKR_BUFFER_TOO_SMALL;
@@ -3223,6 +3567,9 @@ CK_RV openssl_specific_sha_update(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
 
     EVP_MD_CTX_free(md_ctx);
 #else
+    if (sw_sha_context(ctx) != NULL)
+        return sw_sha_update(sw_sha_context(ctx), in_data, in_data_len);
+
     if (!EVP_DigestUpdate((EVP_MD_CTX *)ctx->context, in_data, in_data_len)) {
         TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
         return CKR_FUNCTION_FAILED;
@@ -3239,6 +3586,8 @@ CK_RV openssl_specific_sha_final(STDLL_TokData_t *tokdata, DIGEST_CONTEXT *ctx,
     CK_RV rc = CKR_OK;
 #if !OPENSSL_VERSION_PREREQ(3, 0)
     EVP_MD_CTX *md_ctx;
+#else
+    SW_SHA_CTX *sw_ctx;
 #endif
 
     UNUSED(tokdata);
@@ -3273,6 +3622,22 @@ out:
     ctx->context_len = 0;
     ctx->context_free_func = NULL;
 #else
+    sw_ctx = sw_sha_context(ctx);
+    if (sw_ctx != NULL) {
+        if (*out_data_len < sw_ctx->digest_len) {
+            TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
+            return CKR_BUFFER_TOO_SMALL;
+        }
+
+        len = sw_ctx->digest_len;
+        rc = sw_sha_final(sw_ctx, out_data);
+        if (rc == CKR_OK)
+            *out_data_len = len;
+
+        sw_sha_context_free(ctx);
+        return rc;
+    }
+
     if (*out_data_len < (CK_ULONG)EVP_MD_CTX_size((EVP_MD_CTX *)ctx->context)) {
         TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
         return CKR_BUFFER_TOO_SMALL;
@@ -3295,6 +3660,74 @@ out:
     return rc;
 }
 
+/*
+ * Digests a batch of independent messages. Where the multi-buffer SHA-2 of
+ * sw_sha_batch is faster on this CPU it is used, otherwise all messages are
+ * digested with one EVP_MD_CTX that is re-initialized for each message.
+ */
+CK_RV openssl_specific_sha_batch(STDLL_TokData_t *tokdata, CK_MECHANISM *mech,
+                                 CK_ULONG count, CK_BYTE **in_data,
+                                 CK_ULONG *in_data_len, CK_BYTE *out_data)
+{
+    static CK_BYTE empty;
+    const EVP_MD *md;
+    EVP_MD_CTX *md_ctx;
+    CK_BYTE **digests;
+    CK_ULONG hlen, i;
+    CK_RV rc;
+
+    UNUSED(tokdata);
+
+    rc = get_sha_size(mech->mechanism, &hlen);
+    if (rc != CKR_OK)
+        return CKR_MECHANISM_INVALID;
+
+    if (sw_sha_batch_preferred(mech->mechanism)) {
+        if (count > ULONG_MAX / sizeof(*digests)) {
+            TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+            return CKR_ARGUMENTS_BAD;
+        }
+
+        digests = malloc(count * sizeof(*digests));
+        if (digests == NULL) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            return CKR_HOST_MEMORY;
+        }
+        for (i = 0; i < count; i++)
+            digests[i] = out_data + i * hlen;
+
+        rc = sw_sha_batch(mech->mechanism, count, in_data, in_data_len,
+                          digests);
+        free(digests);
+        return rc;
+    }
+
+    md = md_from_mech(mech);
+    if (md == NULL)
+        return CKR_MECHANISM_INVALID;
+
+    md_ctx = EVP_MD_CTX_new();
+    if (md_ctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!EVP_DigestInit_ex(md_ctx, md, NULL) ||
+            !EVP_DigestUpdate(md_ctx, in_data[i] != NULL ? in_data[i] : &empty,
+                              in_data_len[i]) ||
+            !EVP_DigestFinal_ex(md_ctx, out_data + i * hlen, NULL)) {
+            TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+            rc = CKR_FUNCTION_FAILED;
+            break;
+        }
+    }
+
+    EVP_MD_CTX_free(md_ctx);
+
+    return rc;
+}
+
 CK_RV openssl_specific_shake_key_derive(STDLL_TokData_t *tokdata, SESSION *sess,
                                         CK_MECHANISM *mech,
                                         OBJECT *base_key_obj,
@@ -3670,129 +4103,209 @@ done:
     return rc;
 }
 
-CK_RV openssl_cmac_perform(CK_MECHANISM_TYPE mech, CK_BYTE *message,
-                           CK_ULONG message_len, OBJECT *key, CK_BYTE *mac,
-                           CK_BBOOL first, CK_BBOOL last, CK_VOID_PTR *ctx)
+/*
+ * Creates a keyed CMAC context. It is not used for an operation itself, but
+ * duplicated for each operation.
+ */
+static void *openssl_cmac_new_ctx(const EVP_CIPHER *cipher,
+                                  CK_ATTRIBUTE *key_attr)
 {
-    int rc;
-    size_t maclen;
-    CK_RV rv = CKR_OK;
-    CK_ATTRIBUTE *key_attr = NULL;
-    const EVP_CIPHER *cipher;
-    CK_KEY_TYPE keytype = 0;
-    struct cmac_ctx {
 #if !OPENSSL_VERSION_PREREQ(3, 0)
-        EVP_MD_CTX *mctx;
-        EVP_PKEY_CTX *pctx;
-        EVP_PKEY *pkey;
+    EVP_MD_CTX *mctx = NULL;
+    EVP_PKEY *pkey = NULL;
+
+    mctx = EVP_MD_CTX_new();
+    if (mctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return NULL;
+    }
+
+    pkey = EVP_PKEY_new_CMAC_key(NULL, key_attr->pValue,
+                                 key_attr->ulValueLen, cipher);
+    if (pkey == NULL) {
+        TRACE_ERROR("EVP_PKEY_new_CMAC_key failed\n");
+        EVP_MD_CTX_free(mctx);
+        return NULL;
+    }
+
+    if (EVP_DigestSignInit(mctx, NULL, NULL, NULL, pkey) != 1) {
+        TRACE_ERROR("EVP_DigestSignInit failed\n");
+        EVP_MD_CTX_free(mctx);
+        mctx = NULL;
+    }
+
+    EVP_PKEY_free(pkey); /* the context holds its own reference */
+
+    return mctx;
 #else
-        EVP_MAC *mac;
-        EVP_MAC_CTX *mctx;
-#endif
-        int macsize;
-    };
-    struct cmac_ctx *cmac = NULL;
-#if OPENSSL_VERSION_PREREQ(3, 0)
+    EVP_MAC *mac;
+    EVP_MAC_CTX *mctx = NULL;
     OSSL_PARAM params[2];
-#endif
 
-    if (first) {
-        if (key == NULL)
-            return CKR_ARGUMENTS_BAD;
+    mac = EVP_MAC_fetch(NULL, "CMAC", NULL);
+    if (mac == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+        return NULL;
+    }
 
-        rv = template_attribute_get_ulong(key->template, CKA_KEY_TYPE,
-                                          &keytype);
-        if (rv != CKR_OK) {
-            TRACE_ERROR("Could not find CKA_KEY_TYPE for the key\n");
-            goto err;
-        }
+    mctx = EVP_MAC_CTX_new(mac);
+    EVP_MAC_free(mac); /* the context holds its own reference */
+    if (mctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return NULL;
+    }
 
-        rv = template_attribute_get_non_empty(key->template, CKA_VALUE,
-                                              &key_attr);
-        if (rv != CKR_OK) {
-            TRACE_ERROR("Could not find CKA_VALUE for the key.\n");
-            goto err;
-        }
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_CIPHER,
+                                  (char *)EVP_CIPHER_get0_name(cipher), 0);
+    params[1] = OSSL_PARAM_construct_end();
 
-        switch (mech) {
-        case CKM_AES_CMAC:
-            cipher = openssl_cipher_from_mech(CKM_AES_CBC,
-                                              key_attr->ulValueLen, keytype);
-            break;
-        case CKM_DES3_CMAC:
-            cipher = openssl_cipher_from_mech(CKM_DES3_CBC,
-                                              key_attr->ulValueLen,
-                                              keytype);
-            break;
-         default:
-            TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
-            rv = CKR_MECHANISM_INVALID;
-            goto err;
-        }
+    if (!EVP_MAC_init(mctx, key_attr->pValue, key_attr->ulValueLen,
+                      params)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+        EVP_MAC_CTX_free(mctx);
+        return NULL;
+    }
 
-        if (cipher == NULL) {
-            TRACE_ERROR("Cipher not supported.\n");
-            rv = CKR_MECHANISM_INVALID;
-            goto err;
-        }
+    return mctx;
+#endif
+}
 
-        cmac = calloc(1, sizeof(*cmac));
-        if (cmac == NULL) {
-            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-            rv = CKR_HOST_MEMORY;
-            goto err;
+/*
+ * Returns a new CMAC context for an operation with the specified key. It is
+ * duplicated from a keyed context cached in the key object's ex_data, so that
+ * the cipher key schedule and the CMAC subkeys are only computed once per key.
+ */
+static CK_RV openssl_cmac_dup_ctx(OBJECT *key, const EVP_CIPHER *cipher,
+                                  CK_ATTRIBUTE *key_attr, void **mctx)
+{
+    struct openssl_ex_data *ex_data = NULL;
+    CK_RV rc;
+
+    rc = openssl_get_ex_data(key, (void **)&ex_data,
+                             sizeof(struct openssl_ex_data), NULL, NULL);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (ex_data->cmac_ctx == NULL) {
+        object_ex_data_unlock(key);
+
+        rc = openssl_get_ex_data(key, (void **)&ex_data,
+                                 sizeof(struct openssl_ex_data),
+                                 openssl_always_wr_lock, NULL);
+        if (rc != CKR_OK)
+            return rc;
+
+        if (ex_data->cmac_ctx == NULL) {
+            ex_data->cmac_ctx = openssl_cmac_new_ctx(cipher, key_attr);
+            if (ex_data->cmac_ctx == NULL) {
+                rc = CKR_FUNCTION_FAILED;
+                goto done;
+            }
         }
+    }
 
-        cmac->macsize = EVP_CIPHER_block_size(cipher);
+#if !OPENSSL_VERSION_PREREQ(3, 0)
+    *mctx = EVP_MD_CTX_new();
+    if (*mctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    if (EVP_MD_CTX_copy_ex(*mctx, ex_data->cmac_ctx) != 1) {
+        TRACE_ERROR("EVP_MD_CTX_copy_ex failed\n");
+        EVP_MD_CTX_free(*mctx);
+        *mctx = NULL;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
+    }
+#else
+    *mctx = EVP_MAC_CTX_dup(ex_data->cmac_ctx);
+    if (*mctx == NULL) {
+        TRACE_ERROR("EVP_MAC_CTX_dup failed\n");
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
+    }
+#endif
+
+done:
+    object_ex_data_unlock(key);
+    return rc;
+}
 
+CK_RV openssl_cmac_perform(CK_MECHANISM_TYPE mech, CK_BYTE *message,
+                           CK_ULONG message_len, OBJECT *key, CK_BYTE *mac,
+                           CK_BBOOL first, CK_BBOOL last, CK_VOID_PTR *ctx)
+{
+    int rc;
+    size_t maclen;
+    CK_RV rv = CKR_OK;
+    CK_ATTRIBUTE *key_attr = NULL;
+    const EVP_CIPHER *cipher;
+    CK_KEY_TYPE keytype = 0;
+    struct cmac_ctx {
 #if !OPENSSL_VERSION_PREREQ(3, 0)
-        cmac->mctx = EVP_MD_CTX_new();
-        if (cmac->mctx == NULL) {
-            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-            rv = CKR_HOST_MEMORY;
+        EVP_MD_CTX *mctx;
+#else
+        EVP_MAC_CTX *mctx;
+#endif
+        int macsize;
+    };
+    struct cmac_ctx *cmac = NULL;
+
+    if (first) {
+        if (key == NULL)
+            return CKR_ARGUMENTS_BAD;
+
+        rv = template_attribute_get_ulong(key->template, CKA_KEY_TYPE,
+                                          &keytype);
+        if (rv != CKR_OK) {
+            TRACE_ERROR("Could not find CKA_KEY_TYPE for the key\n");
             goto err;
         }
 
-        cmac->pkey = EVP_PKEY_new_CMAC_key(NULL, key_attr->pValue,
-                                           key_attr->ulValueLen, cipher);
-        if (cmac->pkey == NULL) {
-            TRACE_ERROR("EVP_DigestSignInit failed\n");
-            rv = CKR_FUNCTION_FAILED;
+        rv = template_attribute_get_non_empty(key->template, CKA_VALUE,
+                                              &key_attr);
+        if (rv != CKR_OK) {
+            TRACE_ERROR("Could not find CKA_VALUE for the key.\n");
             goto err;
         }
 
-        if (EVP_DigestSignInit(cmac->mctx, &cmac->pctx,
-                               NULL, NULL, cmac->pkey) != 1) {
-            TRACE_ERROR("EVP_DigestSignInit failed\n");
-            rv = CKR_FUNCTION_FAILED;
+        switch (mech) {
+        case CKM_AES_CMAC:
+            cipher = openssl_cipher_from_mech(CKM_AES_CBC,
+                                              key_attr->ulValueLen, keytype);
+            break;
+        case CKM_DES3_CMAC:
+            cipher = openssl_cipher_from_mech(CKM_DES3_CBC,
+                                              key_attr->ulValueLen,
+                                              keytype);
+            break;
+         default:
+            TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
+            rv = CKR_MECHANISM_INVALID;
             goto err;
         }
-#else
-        cmac->mac = EVP_MAC_fetch(NULL, "CMAC", NULL);
-        if (cmac->mac == NULL) {
-            TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-            rv = CKR_FUNCTION_FAILED;
+
+        if (cipher == NULL) {
+            TRACE_ERROR("Cipher not supported.\n");
+            rv = CKR_MECHANISM_INVALID;
             goto err;
         }
 
-        cmac->mctx = EVP_MAC_CTX_new(cmac->mac);
-        if (cmac->mctx == NULL) {
+        cmac = calloc(1, sizeof(*cmac));
+        if (cmac == NULL) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
             rv = CKR_HOST_MEMORY;
             goto err;
         }
 
-        params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_CIPHER,
-                                      (char *)EVP_CIPHER_get0_name(cipher), 0);
-        params[1] = OSSL_PARAM_construct_end();
+        cmac->macsize = EVP_CIPHER_block_size(cipher);
 
-        if (!EVP_MAC_init(cmac->mctx, key_attr->pValue, key_attr->ulValueLen,
-                          params)) {
-            TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
-            rv = CKR_FUNCTION_FAILED;
+        rv = openssl_cmac_dup_ctx(key, cipher, key_attr,
+                                  (void **)&cmac->mctx);
+        if (rv != CKR_OK)
             goto err;
-        }
-#endif
 
         *ctx = cmac;
     }
@@ -3837,11 +4350,9 @@ CK_RV openssl_cmac_perform(CK_MECHANISM_TYPE mech, CK_BYTE *message,
         }
 
 #if !OPENSSL_VERSION_PREREQ(3, 0)
-        EVP_MD_CTX_free(cmac->mctx); /* frees pctx */
-        EVP_PKEY_free(cmac->pkey);
+        EVP_MD_CTX_free(cmac->mctx);
 #else
         EVP_MAC_CTX_free(cmac->mctx);
-        EVP_MAC_free(cmac->mac);
 #endif
         free(cmac);
         *ctx = NULL;
@@ -3852,14 +4363,10 @@ err:
     if (cmac != NULL) {
 #if !OPENSSL_VERSION_PREREQ(3, 0)
         if (cmac->mctx != NULL)
-            EVP_MD_CTX_free(cmac->mctx); /* frees pctx */
-        if (cmac->pkey != NULL)
-            EVP_PKEY_free(cmac->pkey);
+            EVP_MD_CTX_free(cmac->mctx);
 #else
         if (cmac->mctx != NULL)
             EVP_MAC_CTX_free(cmac->mctx);
-        if (cmac->mac != NULL)
-            EVP_MAC_free(cmac->mac);
 #endif
         free(cmac);
     }
@@ -3982,17 +4489,13 @@ static void openssl_specific_aes_gcm_free(STDLL_TokData_t *tokdata,
 {
     AES_GCM_CONTEXT *ctx = (AES_GCM_CONTEXT *)context;
 
-    UNUSED(tokdata);
-    UNUSED(sess);
-    UNUSED(context_len);
-
     if (ctx == NULL)
         return;
 
     if ((EVP_CIPHER_CTX *)ctx->ulClen != NULL)
         EVP_CIPHER_CTX_free((EVP_CIPHER_CTX *)ctx->ulClen);
 
-    free(context);
+    session_mgr_free_context(tokdata, sess, context, context_len);
 }
 
 CK_RV openssl_specific_aes_gcm_init(STDLL_TokData_t *tokdata, SESSION *sess,
@@ -4406,28 +4909,12 @@ CK_RV openssl_specific_aes_cmac(STDLL_TokData_t *tokdata, CK_BYTE *message,
                                 first, last, ctx);
 }
 
-static EVP_CIPHER_CTX *aes_xts_init_ecb_cipher_ctx(const CK_BYTE *key,
-                                                   CK_ULONG keylen,
-                                                   CK_BBOOL encrypt)
+static EVP_CIPHER_CTX *aes_xts_new_cipher_ctx(const EVP_CIPHER *cipher,
+                                              const CK_BYTE *key,
+                                              CK_BBOOL encrypt)
 {
-    const EVP_CIPHER *cipher;
     EVP_CIPHER_CTX *ctx = NULL;
 
-    if (key == NULL)
-        return NULL;
-
-    switch (keylen) {
-    case AES_KEY_SIZE_128:
-        cipher = EVP_aes_128_ecb();
-        break;
-    case AES_KEY_SIZE_256:
-        cipher = EVP_aes_256_ecb();
-        break;
-    default:
-        TRACE_ERROR("Key size wrong: %lu.\n", keylen);
-        return NULL;
-    }
-
     ctx = EVP_CIPHER_CTX_new();
     if (ctx == NULL) {
         TRACE_ERROR("EVP_CIPHER_CTX_new failed\n");
@@ -4435,7 +4922,8 @@ static EVP_CIPHER_CTX *aes_xts_init_ecb_cipher_ctx(const CK_BYTE *key,
     }
 
     if (EVP_CipherInit_ex(ctx, cipher, NULL, key, NULL,
-                  encrypt ? 1 : 0) != 1) {
+                          encrypt ? 1 : 0) != 1 ||
+        EVP_CIPHER_CTX_set_padding(ctx, 0) != 1) {
         EVP_CIPHER_CTX_free(ctx);
         TRACE_ERROR("EVP_CipherInit_ex failed\n");
         return NULL;
@@ -4444,71 +4932,175 @@ static EVP_CIPHER_CTX *aes_xts_init_ecb_cipher_ctx(const CK_BYTE *key,
     return ctx;
 }
 
-static void aes_xts_xor_block(const CK_BYTE *in1, const CK_BYTE *in2,
-                              CK_BYTE *out)
+/*
+ * Creates the keyed AES-XTS context and the AES-ECB contexts with the tweak
+ * key (2nd half of the key) for the specified direction in the key object's
+ * ex_data, if not already there. Must be called with the ex_data write lock.
+ */
+static CK_RV aes_xts_create_ctxs(OBJECT *key_obj,
+                                 struct openssl_ex_data *ex_data,
+                                 CK_BBOOL encrypt)
 {
-    CK_ULONG i;
+    const EVP_CIPHER *xts_cipher, *ecb_cipher;
+    CK_ATTRIBUTE *key_attr;
+    CK_ULONG half;
+    CK_RV rc;
 
-    for (i = 0; i < AES_BLOCK_SIZE; i++)
-        out[i] = in1[i] ^ in2[i];
-}
+    rc = template_attribute_get_non_empty(key_obj->template, CKA_VALUE,
+                                          &key_attr);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Could not find CKA_VALUE for the key.\n");
+        return rc;
+    }
 
-static void aes_xts_mult(CK_BYTE *iv)
-{
-    CK_ULONG c, i;
+    half = key_attr->ulValueLen / 2;
+    switch (half) {
+    case AES_KEY_SIZE_128:
+        xts_cipher = EVP_aes_128_xts();
+        ecb_cipher = EVP_aes_128_ecb();
+        break;
+    case AES_KEY_SIZE_256:
+        xts_cipher = EVP_aes_256_xts();
+        ecb_cipher = EVP_aes_256_ecb();
+        break;
+    default:
+        TRACE_ERROR("Key size wrong: %lu.\n", key_attr->ulValueLen);
+        return CKR_KEY_SIZE_RANGE;
+    }
 
-    for (c = 0, i = 0; i < AES_BLOCK_SIZE; ++i) {
-        c += ((CK_ULONG)iv[i]) << 1;
-        iv[i] = (CK_BYTE)c;
-        c = c >> 8;
+    if (ex_data->xts_ctx[encrypt] == NULL) {
+        ex_data->xts_ctx[encrypt] =
+                aes_xts_new_cipher_ctx(xts_cipher, key_attr->pValue, encrypt);
+        if (ex_data->xts_ctx[encrypt] == NULL)
+            return CKR_FUNCTION_FAILED;
     }
 
-    iv[0] ^= (CK_BYTE)(0x87 & (0 - c));
-}
+    if (ex_data->xts_tweak_ctx[encrypt] == NULL) {
+        ex_data->xts_tweak_ctx[encrypt] =
+                aes_xts_new_cipher_ctx(ecb_cipher,
+                                       (CK_BYTE *)key_attr->pValue + half,
+                                       encrypt);
+        if (ex_data->xts_tweak_ctx[encrypt] == NULL)
+            return CKR_FUNCTION_FAILED;
+    }
 
-struct aes_xts_cb_data {
-    EVP_CIPHER_CTX *tweak_ctx;
-    EVP_CIPHER_CTX *cipher_ctx;
-};
+    return CKR_OK;
+}
 
-static CK_RV aes_xts_iv_from_tweak(CK_BYTE *tweak, CK_BYTE* iv, void * cb_data)
+/*
+ * Returns copies of the keyed AES-XTS context, and of the AES-ECB encrypt and
+ * decrypt contexts with the tweak key. The keyed contexts are cached in the
+ * key object's ex_data, so that the key schedules are computed only once per
+ * key and not on every update call.
+ */
+static CK_RV aes_xts_dup_ctxs(OBJECT *key_obj, CK_BBOOL encrypt,
+                              EVP_CIPHER_CTX **xts_ctx,
+                              EVP_CIPHER_CTX **tweak_enc_ctx,
+                              EVP_CIPHER_CTX **tweak_dec_ctx)
 {
-    struct aes_xts_cb_data *data = cb_data;
+    struct openssl_ex_data *ex_data = NULL;
+    EVP_CIPHER_CTX **ctxs[3] = { xts_ctx, tweak_enc_ctx, tweak_dec_ctx };
+    EVP_CIPHER_CTX *src[3];
+    CK_RV rc;
+    int i;
 
-    if (EVP_Cipher(data->tweak_ctx, iv, tweak, AES_BLOCK_SIZE) <= 0) {
-        TRACE_ERROR("EVP_Cipher failed\n");
-        return CKR_FUNCTION_FAILED;
+    encrypt = encrypt ? 1 : 0;
+
+    rc = openssl_get_ex_data(key_obj, (void **)&ex_data,
+                             sizeof(struct openssl_ex_data), NULL, NULL);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (ex_data->xts_ctx[encrypt] == NULL ||
+        ex_data->xts_tweak_ctx[0] == NULL ||
+        ex_data->xts_tweak_ctx[1] == NULL) {
+        object_ex_data_unlock(key_obj);
+
+        rc = openssl_get_ex_data(key_obj, (void **)&ex_data,
+                                 sizeof(struct openssl_ex_data),
+                                 openssl_always_wr_lock, NULL);
+        if (rc != CKR_OK)
+            return rc;
+
+        rc = aes_xts_create_ctxs(key_obj, ex_data, encrypt);
+        if (rc == CKR_OK)
+            rc = aes_xts_create_ctxs(key_obj, ex_data, !encrypt);
+        if (rc != CKR_OK)
+            goto done;
     }
 
-    return CKR_OK;
-}
+    src[0] = ex_data->xts_ctx[encrypt];
+    src[1] = ex_data->xts_tweak_ctx[1];
+    src[2] = ex_data->xts_tweak_ctx[0];
 
-static CK_RV aes_xts_cipher_blocks(CK_BYTE *in, CK_BYTE *out, CK_ULONG len,
-                                   CK_BYTE *iv, void * cb_data)
-{
-    struct aes_xts_cb_data *data = cb_data;
-    CK_BYTE buf[AES_INIT_VECTOR_SIZE];
+    for (i = 0; i < 3; i++) {
+        *ctxs[i] = EVP_CIPHER_CTX_new();
+        if (*ctxs[i] == NULL) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            rc = CKR_HOST_MEMORY;
+            goto done;
+        }
+
+        if (EVP_CIPHER_CTX_copy(*ctxs[i], src[i]) != 1) {
+            TRACE_ERROR("EVP_CIPHER_CTX_copy failed\n");
+            rc = CKR_FUNCTION_FAILED;
+            goto done;
+        }
+    }
 
-    while (len >= AES_BLOCK_SIZE) {
-        aes_xts_xor_block(in, iv, buf);
+done:
+    object_ex_data_unlock(key_obj);
 
-        if (EVP_Cipher(data->cipher_ctx, out, buf, AES_BLOCK_SIZE) <= 0) {
-            TRACE_ERROR("EVP_Cipher failed\n");
-            return CKR_FUNCTION_FAILED;
+    if (rc != CKR_OK) {
+        for (i = 0; i < 3; i++) {
+            EVP_CIPHER_CTX_free(*ctxs[i]);
+            *ctxs[i] = NULL;
         }
+    }
 
-        aes_xts_xor_block(out, iv, out);
+    return rc;
+}
 
-        in += AES_BLOCK_SIZE;
-        out += AES_BLOCK_SIZE;
-        len -= AES_BLOCK_SIZE;
+/*
+ * Multiplies the tweak value by alpha^n in GF(2^128). The tweak value is
+ * little endian, as specified by IEEE Std 1619.
+ */
+static void aes_xts_mult_n(CK_BYTE *iv, CK_ULONG n)
+{
+    uint64_t lo = 0, hi = 0, carry;
+    int i;
 
-        aes_xts_mult(iv);
+    for (i = 7; i >= 0; i--) {
+        lo = (lo << 8) | iv[i];
+        hi = (hi << 8) | iv[i + 8];
     }
 
-    return CKR_OK;
+    while (n-- > 0) {
+        carry = hi >> 63;
+        hi = (hi << 1) | (lo >> 63);
+        lo = (lo << 1) ^ (0x87 & (0 - carry));
+    }
+
+    for (i = 0; i < 8; i++) {
+        iv[i] = (CK_BYTE)(lo >> (8 * i));
+        iv[i + 8] = (CK_BYTE)(hi >> (8 * i));
+    }
 }
 
+/*
+ * OpenSSL's AES-XTS accepts at most 2^20 blocks per data unit (IEEE Std
+ * 1619-2018).
+ */
+#define AES_XTS_MAX_DATA_UNIT_LEN   ((1UL << 20) * AES_BLOCK_SIZE)
+
+/*
+ * Multi-part AES-XTS. The IV passed between the calls is the encrypted tweak
+ * value for the next block (see aes_xts_cipher()). Instead of processing the
+ * data block by block, the IV is decrypted with the tweak key to get an
+ * equivalent tweak, and the whole chunk is then processed by OpenSSL's native
+ * AES-XTS implementation with that tweak. Non-final chunks are always a
+ * multiple of the block size, so no ciphertext stealing occurs for them.
+ */
 CK_RV openssl_specific_aes_xts(STDLL_TokData_t *tokdata,
                                CK_BYTE *in_data, CK_ULONG in_data_len,
                                CK_BYTE *out_data, CK_ULONG *out_data_len,
@@ -4516,8 +5108,11 @@ CK_RV openssl_specific_aes_xts(STDLL_TokData_t *tokdata,
                                CK_BOOL encrypt, CK_BBOOL initial,
                                CK_BBOOL final, CK_BYTE* iv)
 {
-    struct aes_xts_cb_data data = { 0 };
-    CK_ATTRIBUTE *key_attr;
+    EVP_CIPHER_CTX *xts_ctx = NULL;
+    EVP_CIPHER_CTX *tweak_enc_ctx = NULL, *tweak_dec_ctx = NULL;
+    CK_BYTE cur_tweak[AES_INIT_VECTOR_SIZE];
+    CK_ULONG len, done = 0;
+    int outlen;
     CK_RV rc;
 
     UNUSED(tokdata);
@@ -4528,44 +5123,74 @@ CK_RV openssl_specific_aes_xts(STDLL_TokData_t *tokdata,
                                       out_data, out_data_len,
                                       tweak, NULL, encrypt);
 
-    rc = template_attribute_get_non_empty(key_obj->template, CKA_VALUE,
-                                          &key_attr);
+    /* Full block size unless final call */
+    if (!final && (in_data_len % AES_BLOCK_SIZE) != 0)
+        return CKR_DATA_LEN_RANGE;
+    /* Final block must be at least one full block */
+    if (final && in_data_len < AES_BLOCK_SIZE)
+        return CKR_DATA_LEN_RANGE;
+
+    if (out_data == NULL) {
+        *out_data_len = in_data_len;
+        return CKR_OK;
+    }
+
+    if (*out_data_len < in_data_len)
+        return CKR_BUFFER_TOO_SMALL;
+
+    rc = aes_xts_dup_ctxs(key_obj, encrypt, &xts_ctx, &tweak_enc_ctx,
+                          &tweak_dec_ctx);
     if (rc != CKR_OK) {
-        TRACE_ERROR("Could not find CKA_VALUE for the key.\n");
+        TRACE_ERROR("aes_xts_dup_ctxs failed\n");
         return rc;
     }
 
     if (initial) {
-        data.tweak_ctx = aes_xts_init_ecb_cipher_ctx(
-                        (CK_BYTE *)key_attr->pValue + key_attr->ulValueLen / 2,
-                        key_attr->ulValueLen / 2, TRUE);
-        if (data.tweak_ctx == NULL) {
-            TRACE_ERROR("aes_xts_init_ecb_cipher_ctx failed\n");
+        /* Calculate IV from tweak */
+        memcpy(cur_tweak, tweak, AES_INIT_VECTOR_SIZE);
+        if (EVP_Cipher(tweak_enc_ctx, iv, tweak, AES_BLOCK_SIZE) <= 0) {
+            TRACE_ERROR("EVP_Cipher failed\n");
             rc = CKR_FUNCTION_FAILED;
             goto out;
         }
     }
 
-    data.cipher_ctx = aes_xts_init_ecb_cipher_ctx((CK_BYTE *)key_attr->pValue,
-                                                  key_attr->ulValueLen / 2,
-                                                  encrypt);
-    if (data.cipher_ctx == NULL) {
-        TRACE_ERROR("aes_xts_init_ecb_cipher_ctx failed\n");
-        rc = CKR_FUNCTION_FAILED;
-        goto out;
+    while (done < in_data_len) {
+        len = in_data_len - done;
+        if (len > AES_XTS_MAX_DATA_UNIT_LEN) {
+            len = AES_XTS_MAX_DATA_UNIT_LEN;
+            /* Leave at least one full block for the final chunk */
+            if (in_data_len - done - len < AES_BLOCK_SIZE)
+                len -= AES_BLOCK_SIZE;
+        }
+
+        if ((!initial || done > 0) &&
+            EVP_Cipher(tweak_dec_ctx, cur_tweak, iv, AES_BLOCK_SIZE) <= 0) {
+            TRACE_ERROR("EVP_Cipher failed\n");
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+
+        if (EVP_CipherInit_ex(xts_ctx, NULL, NULL, NULL, cur_tweak, -1) != 1 ||
+            EVP_CipherUpdate(xts_ctx, out_data + done, &outlen,
+                             in_data + done, len) != 1) {
+            TRACE_ERROR("%s\n", ock_err(ERR_GENERAL_ERROR));
+            rc = CKR_GENERAL_ERROR;
+            goto out;
+        }
+
+        done += len;
+
+        if (!final || done < in_data_len)
+            aes_xts_mult_n(iv, len / AES_BLOCK_SIZE);
     }
 
-    rc = aes_xts_cipher(in_data, in_data_len, out_data, out_data_len,
-                        tweak, encrypt, initial, final, iv,
-                        aes_xts_iv_from_tweak,
-                        aes_xts_cipher_blocks,
-                        &data);
+    *out_data_len = in_data_len;
 
 out:
-    if (data.tweak_ctx != NULL)
-        EVP_CIPHER_CTX_free(data.tweak_ctx);
-    if (data.cipher_ctx != NULL)
-        EVP_CIPHER_CTX_free(data.cipher_ctx);
+    EVP_CIPHER_CTX_free(xts_ctx);
+    EVP_CIPHER_CTX_free(tweak_enc_ctx);
+    EVP_CIPHER_CTX_free(tweak_dec_ctx);
 
     return rc;
 }
@@ -4716,318 +5341,1013 @@ static void openssl_specific_hmac_free(STDLL_TokData_t *tokdata, SESSION *sess,
     EVP_MD_CTX_destroy((EVP_MD_CTX *)context);
 }
 
-CK_RV openssl_specific_hmac_init(STDLL_TokData_t *tokdata,
-                                 SIGN_VERIFY_CONTEXT *ctx,
-                                 CK_MECHANISM_PTR mech,
-                                 CK_OBJECT_HANDLE Hkey)
+/*
+ * Returns the digest for an HMAC mechanism, and the index of the keyed HMAC
+ * context for that digest in the key's ex_data.
+ */
+static const EVP_MD *openssl_hmac_md(CK_MECHANISM_TYPE mech, int *idx)
 {
-    int rc;
-    OBJECT *key = NULL;
-    CK_ATTRIBUTE *attr = NULL;
-    EVP_MD_CTX *mdctx = NULL;
-    EVP_PKEY *pkey = NULL;
-
-    rc = object_mgr_find_in_map1(tokdata, Hkey, &key, READ_LOCK);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("Failed to find specified object.\n");
-        return rc;
-    }
-
-    rc = template_attribute_get_non_empty(key->template, CKA_VALUE, &attr);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("Could not find CKA_VALUE for the key.\n");
-        goto done;
-    }
-
-    pkey = EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, NULL, attr->pValue,
-                                attr->ulValueLen);
-    if (pkey == NULL) {
-        TRACE_ERROR("EVP_PKEY_new_mac_key() failed.\n");
-        rc = CKR_FUNCTION_FAILED;
-        goto done;
-    }
-
-    mdctx = EVP_MD_CTX_create();
-    if (mdctx == NULL) {
-        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-        rc = CKR_HOST_MEMORY;
-        goto done;
-    }
-
-    switch (mech->mechanism) {
+    switch (mech) {
     case CKM_MD5_HMAC_GENERAL:
     case CKM_MD5_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_md5(), NULL, pkey);
-        break;
+        *idx = 0;
+        return EVP_md5();
     case CKM_SHA_1_HMAC_GENERAL:
     case CKM_SHA_1_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha1(), NULL, pkey);
-        break;
+        *idx = 1;
+        return EVP_sha1();
     case CKM_SHA224_HMAC_GENERAL:
     case CKM_SHA224_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha224(), NULL, pkey);
-        break;
+        *idx = 2;
+        return EVP_sha224();
     case CKM_SHA256_HMAC_GENERAL:
     case CKM_SHA256_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha256(), NULL, pkey);
-        break;
+        *idx = 3;
+        return EVP_sha256();
     case CKM_SHA384_HMAC_GENERAL:
     case CKM_SHA384_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha384(), NULL, pkey);
-        break;
+        *idx = 4;
+        return EVP_sha384();
     case CKM_SHA512_HMAC_GENERAL:
     case CKM_SHA512_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha512(), NULL, pkey);
-        break;
+        *idx = 5;
+        return EVP_sha512();
 #ifdef NID_sha512_224WithRSAEncryption
     case CKM_SHA512_224_HMAC_GENERAL:
     case CKM_SHA512_224_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha512_224(), NULL, pkey);
-        break;
+        *idx = 6;
+        return EVP_sha512_224();
 #endif
 #ifdef NID_sha512_256WithRSAEncryption
     case CKM_SHA512_256_HMAC_GENERAL:
     case CKM_SHA512_256_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha512_256(), NULL, pkey);
-        break;
+        *idx = 7;
+        return EVP_sha512_256();
 #endif
 #ifdef NID_sha3_224
     case CKM_SHA3_224_HMAC:
     case CKM_SHA3_224_HMAC_GENERAL:
     case CKM_IBM_SHA3_224_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha3_224(), NULL, pkey);
-        break;
+        *idx = 8;
+        return EVP_sha3_224();
 #endif
 #ifdef NID_sha3_256
     case CKM_SHA3_256_HMAC:
     case CKM_SHA3_256_HMAC_GENERAL:
     case CKM_IBM_SHA3_256_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha3_256(), NULL, pkey);
-        break;
+        *idx = 9;
+        return EVP_sha3_256();
 #endif
 #ifdef NID_sha3_384
     case CKM_SHA3_384_HMAC:
     case CKM_SHA3_384_HMAC_GENERAL:
     case CKM_IBM_SHA3_384_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha3_384(), NULL, pkey);
-        break;
+        *idx = 10;
+        return EVP_sha3_384();
 #endif
 #ifdef NID_sha3_512
     case CKM_SHA3_512_HMAC:
     case CKM_SHA3_512_HMAC_GENERAL:
     case CKM_IBM_SHA3_512_HMAC:
-        rc = EVP_DigestSignInit(mdctx, NULL, EVP_sha3_512(), NULL, pkey);
-        break;
+        *idx = 11;
+        return EVP_sha3_512();
 #endif
     default:
+        return NULL;
+    }
+}
+
+/*
+ * Creates a keyed HMAC context. It is not used for an operation itself, but
+ * duplicated for each operation.
+ */
+static EVP_MD_CTX *openssl_hmac_new_ctx(const EVP_MD *md,
+                                        CK_ATTRIBUTE *key_attr)
+{
+    EVP_MD_CTX *mdctx = NULL;
+    EVP_PKEY *pkey = NULL;
+
+    pkey = EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, NULL, key_attr->pValue,
+                                key_attr->ulValueLen);
+    if (pkey == NULL) {
+        TRACE_ERROR("EVP_PKEY_new_mac_key() failed.\n");
+        return NULL;
+    }
+
+    mdctx = EVP_MD_CTX_create();
+    if (mdctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        goto done;
+    }
+
+    if (EVP_DigestSignInit(mdctx, NULL, md, NULL, pkey) != 1) {
+        TRACE_ERROR("EVP_DigestSignInit failed.\n");
         EVP_MD_CTX_destroy(mdctx);
+        mdctx = NULL;
+    }
+
+done:
+    EVP_PKEY_free(pkey); /* the context holds its own reference */
+
+    return mdctx;
+}
+
+/*
+ * Returns a new HMAC context for an operation with the specified key and
+ * digest. It is duplicated from a keyed context cached in the key object's
+ * ex_data, so that the inner and outer padded key digests are only computed
+ * once per key and digest.
+ */
+static CK_RV openssl_hmac_dup_ctx(OBJECT *key, const EVP_MD *md, int md_idx,
+                                  EVP_MD_CTX **mdctx)
+{
+    struct openssl_ex_data *ex_data = NULL;
+    CK_ATTRIBUTE *attr = NULL;
+    CK_RV rc;
+
+    rc = openssl_get_ex_data(key, (void **)&ex_data,
+                             sizeof(struct openssl_ex_data), NULL, NULL);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (ex_data->hmac_ctx[md_idx] == NULL) {
+        object_ex_data_unlock(key);
+
+        rc = openssl_get_ex_data(key, (void **)&ex_data,
+                                 sizeof(struct openssl_ex_data),
+                                 openssl_always_wr_lock, NULL);
+        if (rc != CKR_OK)
+            return rc;
+
+        if (ex_data->hmac_ctx[md_idx] == NULL) {
+            rc = template_attribute_get_non_empty(key->template, CKA_VALUE,
+                                                  &attr);
+            if (rc != CKR_OK) {
+                TRACE_ERROR("Could not find CKA_VALUE for the key.\n");
+                goto done;
+            }
+
+            ex_data->hmac_ctx[md_idx] = openssl_hmac_new_ctx(md, attr);
+            if (ex_data->hmac_ctx[md_idx] == NULL) {
+                rc = CKR_FUNCTION_FAILED;
+                goto done;
+            }
+        }
+    }
+
+    *mdctx = EVP_MD_CTX_create();
+    if (*mdctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    if (EVP_MD_CTX_copy_ex(*mdctx, ex_data->hmac_ctx[md_idx]) != 1) {
+        TRACE_ERROR("EVP_MD_CTX_copy_ex failed.\n");
+        EVP_MD_CTX_destroy(*mdctx);
+        *mdctx = NULL;
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
+    }
+
+done:
+    object_ex_data_unlock(key);
+    return rc;
+}
+
+/* Returns the software HMAC state, or NULL for an EVP_MD_CTX */
+static SW_HMAC_CTX *sw_hmac_context(SIGN_VERIFY_CONTEXT *ctx)
+{
+    if (ctx->context_len != sizeof(SW_HMAC_CTX))
+        return NULL;
+
+    return (SW_HMAC_CTX *)ctx->context;
+}
+
+/*
+ * Sets up a software HMAC with a saveable state. A saved state allows to
+ * compute MACs without the key object, so this is only done for keys whose
+ * value can be extracted in the clear anyway. Returns CKR_MECHANISM_INVALID
+ * if the HMAC must be done by OpenSSL.
+ */
+static CK_RV sw_hmac_context_init(SIGN_VERIFY_CONTEXT *ctx,
+                                  CK_MECHANISM_TYPE mech, OBJECT *key)
+{
+    CK_BBOOL general, sensitive = FALSE, extractable = TRUE;
+    CK_MECHANISM_TYPE digest_mech;
+    CK_ATTRIBUTE *attr = NULL;
+    SW_HMAC_CTX *sw_ctx;
+    CK_RV rc;
+
+    if (get_hmac_digest(mech, &digest_mech, &general) != CKR_OK)
+        return CKR_MECHANISM_INVALID;
+
+    template_attribute_get_bool(key->template, CKA_SENSITIVE, &sensitive);
+    template_attribute_get_bool(key->template, CKA_EXTRACTABLE, &extractable);
+    if (sensitive || !extractable)
+        return CKR_MECHANISM_INVALID;
+
+    rc = template_attribute_get_non_empty(key->template, CKA_VALUE, &attr);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Could not find CKA_VALUE for the key.\n");
+        return rc;
+    }
+
+    sw_ctx = malloc(sizeof(*sw_ctx));
+    if (sw_ctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    rc = sw_hmac_init(sw_ctx, digest_mech, attr->pValue, attr->ulValueLen);
+    if (rc != CKR_OK) {
+        free(sw_ctx);
+        return rc;
+    }
+
+    /* Plain data, freed with free() and saveable */
+    ctx->context = (CK_BYTE *)sw_ctx;
+    ctx->context_len = sizeof(*sw_ctx);
+    ctx->context_free_func = NULL;
+    ctx->state_unsaveable = FALSE;
+
+    return CKR_OK;
+}
+
+static void sw_hmac_context_free(SIGN_VERIFY_CONTEXT *ctx)
+{
+    OPENSSL_cleanse(ctx->context, ctx->context_len);
+    free(ctx->context);
+    ctx->context = NULL;
+    ctx->context_len = 0;
+    ctx->context_free_func = NULL;
+}
+
+CK_RV openssl_specific_hmac_init(STDLL_TokData_t *tokdata,
+                                 SIGN_VERIFY_CONTEXT *ctx,
+                                 CK_MECHANISM_PTR mech,
+                                 CK_OBJECT_HANDLE Hkey)
+{
+    CK_RV rc;
+    OBJECT *key = NULL;
+    EVP_MD_CTX *mdctx = NULL;
+    const EVP_MD *md;
+    int md_idx;
+
+    md = openssl_hmac_md(mech->mechanism, &md_idx);
+    if (md == NULL) {
         TRACE_ERROR("%s\n", ock_err(ERR_MECHANISM_INVALID));
-        rc = CKR_MECHANISM_INVALID;
+        return CKR_MECHANISM_INVALID;
+    }
+
+    rc = object_mgr_find_in_map1(tokdata, Hkey, &key, READ_LOCK);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Failed to find specified object.\n");
+        return rc;
+    }
+
+    /* Digests not implemented in software and sensitive keys use OpenSSL */
+    if (saveable_digest_state_enabled()) {
+        rc = sw_hmac_context_init(ctx, mech->mechanism, key);
+        if (rc != CKR_MECHANISM_INVALID)
+            goto done;
+    }
+
+    rc = openssl_hmac_dup_ctx(key, md, md_idx, &mdctx);
+    if (rc != CKR_OK) {
+        ctx->context = NULL;
         goto done;
     }
 
-    if (rc != 1) {
-        EVP_MD_CTX_destroy(mdctx);
-        ctx->context = NULL;
-        TRACE_ERROR("EVP_DigestSignInit failed.\n");
-        rc = CKR_FUNCTION_FAILED;
-        goto done;
+    ctx->context = (CK_BYTE *) mdctx;
+    ctx->context_free_func = openssl_specific_hmac_free;
+    ctx->state_unsaveable = TRUE;
+
+done:
+    object_put(tokdata, key, TRUE);
+    key = NULL;
+    return rc;
+}
+
+CK_RV openssl_specific_hmac(SIGN_VERIFY_CONTEXT *ctx, CK_BYTE *in_data,
+                            CK_ULONG in_data_len, CK_BYTE *signature,
+                            CK_ULONG *sig_len, CK_BBOOL sign)
+{
+    int rc;
+    size_t mac_len, len;
+    unsigned char mac[MAX_SHA_HASH_SIZE];
+    EVP_MD_CTX *mdctx = NULL;
+    CK_RV rv = CKR_OK;
+    CK_BBOOL general = FALSE;
+    CK_MECHANISM_TYPE digest_mech;
+    CK_ULONG mac_len2;
+
+    if (!ctx || !ctx->context) {
+        TRACE_ERROR("%s received bad argument(s)\n", __func__);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (sign && !sig_len) {
+        TRACE_ERROR("%s received bad argument(s)\n", __func__);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    rc = get_hmac_digest(ctx->mech.mechanism, &digest_mech, &general);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s get_hmac_digest failed\n", __func__);
+        return rc;
+    }
+
+    rc = get_sha_size(digest_mech, &mac_len2);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s get_sha_size failed\n", __func__);
+        return rc;
+    }
+    mac_len = mac_len2;
+
+    if (sw_hmac_context(ctx) != NULL) {
+        rv = sw_hmac_update(sw_hmac_context(ctx), in_data, in_data_len);
+        if (rv == CKR_OK)
+            rv = sw_hmac_final(sw_hmac_context(ctx), mac);
+        if (rv != CKR_OK) {
+            TRACE_ERROR("Software HMAC failed.\n");
+            goto done;
+        }
+    } else {
+        mdctx = (EVP_MD_CTX *) ctx->context;
+
+        rc = EVP_DigestSignUpdate(mdctx, in_data, in_data_len);
+        if (rc != 1) {
+            TRACE_ERROR("EVP_DigestSignUpdate failed.\n");
+            rv = CKR_FUNCTION_FAILED;
+            goto done;
+        }
+
+        rc = EVP_DigestSignFinal(mdctx, mac, &mac_len);
+        if (rc != 1) {
+            TRACE_ERROR("EVP_DigestSignFinal failed.\n");
+            rv = CKR_FUNCTION_FAILED;
+            goto done;
+        }
+    }
+
+    if (sign) {
+        if (general)
+            *sig_len = *(CK_ULONG *) ctx->mech.pParameter;
+        else
+            *sig_len = mac_len;
+
+        memcpy(signature, mac, *sig_len);
+
+    } else {
+        if (general)
+            len = *(CK_ULONG *) ctx->mech.pParameter;
+        else
+            len = mac_len;
+
+        if (CRYPTO_memcmp(signature, mac, len) != 0) {
+            TRACE_ERROR("%s\n", ock_err(ERR_SIGNATURE_INVALID));
+            rv = CKR_SIGNATURE_INVALID;
+        }
+    }
+done:
+    if (sw_hmac_context(ctx) != NULL)
+        sw_hmac_context_free(ctx);
+    else
+        EVP_MD_CTX_destroy(mdctx);
+    ctx->context = NULL;
+
+    return rv;
+}
+
+CK_RV openssl_specific_hmac_update(SIGN_VERIFY_CONTEXT *ctx, CK_BYTE *in_data,
+                                   CK_ULONG in_data_len, CK_BBOOL sign)
+{
+    int rc;
+    EVP_MD_CTX *mdctx = NULL;
+    CK_RV rv = CKR_OK;
+
+    UNUSED(sign);
+
+    if (!ctx || !ctx->context)
+        return CKR_OPERATION_NOT_INITIALIZED;
+
+    if (sw_hmac_context(ctx) != NULL) {
+        rv = sw_hmac_update(sw_hmac_context(ctx), in_data, in_data_len);
+        if (rv == CKR_OK)
+            return CKR_OK;
+
+        TRACE_ERROR("Software HMAC update failed.\n");
+        sw_hmac_context_free(ctx);
+        return rv;
+    }
+
+    mdctx = (EVP_MD_CTX *) ctx->context;
+
+    rc = EVP_DigestSignUpdate(mdctx, in_data, in_data_len);
+    if (rc != 1) {
+        TRACE_ERROR("EVP_DigestSignUpdate failed.\n");
+        rv = CKR_FUNCTION_FAILED;
+    } else {
+        return CKR_OK;
+    }
+
+    EVP_MD_CTX_destroy(mdctx);
+    ctx->context = NULL;
+    return rv;
+}
+
+CK_RV openssl_specific_hmac_final(SIGN_VERIFY_CONTEXT *ctx, CK_BYTE *signature,
+                                  CK_ULONG *sig_len, CK_BBOOL sign)
+{
+    int rc;
+    size_t mac_len, len;
+    unsigned char mac[MAX_SHA_HASH_SIZE];
+    EVP_MD_CTX *mdctx = NULL;
+    CK_RV rv = CKR_OK;
+    CK_BBOOL general = FALSE;
+    CK_MECHANISM_TYPE digest_mech;
+    CK_ULONG mac_len2;
+
+    if (!ctx || !ctx->context)
+        return CKR_OPERATION_NOT_INITIALIZED;
+
+    if (sign && !sig_len) {
+        TRACE_ERROR("%s received bad argument(s)\n", __func__);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    rc = get_hmac_digest(ctx->mech.mechanism, &digest_mech, &general);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s get_hmac_digest failed\n", __func__);
+        return rc;
+    }
+
+    rc = get_sha_size(digest_mech, &mac_len2);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s get_sha_size failed\n", __func__);
+        return rc;
+    }
+    mac_len = mac_len2;
+
+    if (signature == NULL) {
+        if (sign) {
+            if (general)
+                *sig_len = *(CK_ULONG *) ctx->mech.pParameter;
+            else
+                *sig_len = (CK_ULONG) mac_len;
+        }
+        return CKR_OK;
+    }
+
+    if (sw_hmac_context(ctx) != NULL) {
+        rv = sw_hmac_final(sw_hmac_context(ctx), mac);
+        if (rv != CKR_OK) {
+            TRACE_ERROR("Software HMAC final failed.\n");
+            goto done;
+        }
+    } else {
+        mdctx = (EVP_MD_CTX *) ctx->context;
+
+        rc = EVP_DigestSignFinal(mdctx, mac, &mac_len);
+        if (rc != 1) {
+            TRACE_ERROR("EVP_DigestSignFinal failed.\n");
+            rv = CKR_FUNCTION_FAILED;
+            goto done;
+        }
+    }
+
+    if (sign) {
+        if (general)
+            *sig_len = *(CK_ULONG *) ctx->mech.pParameter;
+        else
+            *sig_len = mac_len;
+
+        memcpy(signature, mac, *sig_len);
+
+    } else {
+        if (general)
+            len = *(CK_ULONG *) ctx->mech.pParameter;
+        else
+            len = mac_len;
+
+        if (CRYPTO_memcmp(signature, mac, len) != 0) {
+            TRACE_ERROR("%s\n", ock_err(ERR_SIGNATURE_INVALID));
+            rv = CKR_SIGNATURE_INVALID;
+        }
+    }
+done:
+    if (sw_hmac_context(ctx) != NULL)
+        sw_hmac_context_free(ctx);
+    else
+        EVP_MD_CTX_destroy(mdctx);
+    ctx->context = NULL;
+    return rv;
+}
+
+/*
+ * Fused hash-and-sign/verify for the digest based RSA and ECDSA signature
+ * mechanisms. The message is fed into an EVP_DigestSign/EVP_DigestVerify
+ * context set up on the cached EVP_PKEY of the key object, so that no
+ * separate digest and sign operations need to be set up per call.
+ */
+struct openssl_hash_sign_ctx {
+    EVP_MD_CTX *md_ctx;
+    CK_KEY_TYPE keytype;
+    CK_ULONG sig_len;       /* PKCS#11 signature length */
+    size_t max_der_len;     /* max. OpenSSL signature length */
+    CK_BBOOL sign;
+};
+
+static void openssl_hash_sign_free(STDLL_TokData_t *tokdata, SESSION *sess,
+                                   CK_BYTE *context, CK_ULONG context_len)
+{
+    struct openssl_hash_sign_ctx *hctx =
+                                (struct openssl_hash_sign_ctx *)context;
+
+    UNUSED(tokdata);
+    UNUSED(sess);
+    UNUSED(context_len);
+
+    if (hctx == NULL)
+        return;
+
+    if (hctx->md_ctx != NULL)
+        EVP_MD_CTX_free(hctx->md_ctx);
+    free(hctx);
+}
+
+/*
+ * Returns an up-ref'ed EVP_PKEY for the key object, using the one cached in
+ * the object's ex_data if available. The caller must free it.
+ */
+static EVP_PKEY *openssl_hash_sign_get_pkey(OBJECT *key_obj,
+                                            CK_KEY_TYPE keytype,
+                                            CK_OBJECT_CLASS class)
+{
+    struct openssl_ex_data *ex_data = NULL;
+    EVP_PKEY *pkey = NULL;
+
+    if (openssl_get_ex_data(key_obj, (void **)&ex_data,
+                            sizeof(struct openssl_ex_data),
+                            openssl_need_wr_lock, NULL) != CKR_OK)
+        return NULL;
+
+    if (ex_data->pkey == NULL) {
+        switch (keytype) {
+        case CKK_RSA:
+            if (class == CKO_PRIVATE_KEY)
+                ex_data->pkey = rsa_convert_private_key(key_obj, ex_data);
+            else
+                ex_data->pkey = rsa_convert_public_key(key_obj);
+            break;
+#ifndef NO_EC
+        case CKK_EC:
+            if (openssl_make_ec_key_from_template(key_obj->template,
+                                                  &ex_data->pkey) != CKR_OK)
+                ex_data->pkey = NULL;
+            break;
+#endif
+        default:
+            break;
+        }
+    }
+
+    if (ex_data->pkey != NULL && EVP_PKEY_up_ref(ex_data->pkey) == 1)
+        pkey = ex_data->pkey;
+
+    object_ex_data_unlock(key_obj);
+
+    return pkey;
+}
+
+CK_RV openssl_specific_hash_sign_verify_init(STDLL_TokData_t *tokdata,
+                                             SESSION *sess,
+                                             SIGN_VERIFY_CONTEXT *ctx,
+                                             CK_MECHANISM *mech,
+                                             OBJECT *key_obj, CK_BBOOL sign)
+{
+    struct openssl_hash_sign_ctx *hctx = NULL;
+    CK_RSA_PKCS_PSS_PARAMS *pss_params = NULL;
+    CK_MECHANISM digest_mech;
+    CK_OBJECT_CLASS class;
+    CK_ATTRIBUTE *attr = NULL;
+    EVP_PKEY_CTX *pctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    const EVP_MD *md;
+    CK_ULONG hlen;
+    CK_RV rc;
+
+    UNUSED(tokdata);
+    UNUSED(sess);
+
+    rc = get_digest_from_mech(mech->mechanism, &digest_mech.mechanism);
+    if (rc != CKR_OK)
+        return CKR_MECHANISM_INVALID;
+
+    digest_mech.ulParameterLen = 0;
+    digest_mech.pParameter = NULL;
+
+    /* Digests not available via EVP (e.g. MD2, MD5) use the generic path */
+    md = md_from_mech(&digest_mech);
+    if (md == NULL)
+        return CKR_MECHANISM_INVALID;
+
+    hctx = calloc(1, sizeof(*hctx));
+    if (hctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+    hctx->sign = sign;
+
+    rc = template_attribute_get_ulong(key_obj->template, CKA_KEY_TYPE,
+                                      &hctx->keytype);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Could not find CKA_KEY_TYPE for the key.\n");
+        goto done;
+    }
+
+    rc = template_attribute_get_ulong(key_obj->template, CKA_CLASS, &class);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Could not find CKA_CLASS for the key.\n");
+        goto done;
+    }
+
+    switch (hctx->keytype) {
+    case CKK_RSA:
+        rc = template_attribute_get_non_empty(key_obj->template, CKA_MODULUS,
+                                              &attr);
+        if (rc != CKR_OK) {
+            TRACE_ERROR("Could not find CKA_MODULUS for the key.\n");
+            goto done;
+        }
+        hctx->sig_len = attr->ulValueLen;
+
+        /* Only the PSS mechanisms have a parameter (checked by caller) */
+        if (mech->ulParameterLen == sizeof(CK_RSA_PKCS_PSS_PARAMS))
+            pss_params = (CK_RSA_PKCS_PSS_PARAMS *)mech->pParameter;
+
+        /*
+         * Let the generic path report CKR_DATA_LEN_RANGE if the DigestInfo
+         * does not fit into the modulus. 19 bytes is the largest DigestInfo
+         * prefix of the supported digests.
+         */
+        rc = get_sha_size(digest_mech.mechanism, &hlen);
+        if (rc != CKR_OK)
+            goto done;
+        if (pss_params == NULL &&
+            (hctx->sig_len < 11 || hlen + 19 > hctx->sig_len - 11)) {
+            rc = CKR_MECHANISM_INVALID;
+            goto done;
+        }
+        break;
+#ifndef NO_EC
+    case CKK_EC:
+        rc = get_ecsiglen(key_obj, &hctx->sig_len);
+        if (rc != CKR_OK) {
+            TRACE_DEVEL("get_ecsiglen failed.\n");
+            goto done;
+        }
+        break;
+#endif
+    default:
+        rc = CKR_MECHANISM_INVALID;
+        goto done;
+    }
+
+    pkey = openssl_hash_sign_get_pkey(key_obj, hctx->keytype, class);
+    if (pkey == NULL ||
+        (hctx->keytype == CKK_EC && EVP_PKEY_base_id(pkey) != EVP_PKEY_EC)) {
+        rc = CKR_MECHANISM_INVALID;
+        goto done;
+    }
+    hctx->max_der_len = EVP_PKEY_size(pkey);
+
+    hctx->md_ctx = EVP_MD_CTX_new();
+    if (hctx->md_ctx == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    if ((sign ? EVP_DigestSignInit(hctx->md_ctx, &pctx, md, NULL, pkey) :
+                EVP_DigestVerifyInit(hctx->md_ctx, &pctx, md, NULL,
+                                     pkey)) != 1) {
+        TRACE_DEVEL("EVP_DigestSignInit/EVP_DigestVerifyInit failed\n");
+        rc = CKR_MECHANISM_INVALID;
+        goto done;
+    }
+
+    if (hctx->keytype == CKK_RSA) {
+        if (pss_params != NULL) {
+            if (EVP_PKEY_CTX_set_rsa_padding(pctx,
+                                             RSA_PKCS1_PSS_PADDING) != 1 ||
+                EVP_PKEY_CTX_set_rsa_pss_saltlen(pctx,
+                                                 (int)pss_params->sLen) != 1 ||
+                EVP_PKEY_CTX_set_rsa_mgf1_md(pctx, md) != 1) {
+                TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+                rc = CKR_FUNCTION_FAILED;
+                goto done;
+            }
+        } else {
+            if (EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PADDING) != 1) {
+                TRACE_ERROR("%s\n", ock_err(ERR_FUNCTION_FAILED));
+                rc = CKR_FUNCTION_FAILED;
+                goto done;
+            }
+        }
+    }
+
+    ctx->context = (CK_BYTE *)hctx;
+    ctx->context_len = sizeof(*hctx);
+    ctx->context_free_func = openssl_hash_sign_free;
+    ctx->state_unsaveable = CK_TRUE;
+    hctx = NULL;
+
+    rc = CKR_OK;
+
+done:
+    if (pkey != NULL)
+        EVP_PKEY_free(pkey);
+    if (hctx != NULL)
+        openssl_hash_sign_free(tokdata, sess, (CK_BYTE *)hctx, 0);
+
+    return rc;
+}
+
+static CK_RV openssl_hash_sign_finish(struct openssl_hash_sign_ctx *hctx,
+                                      CK_BBOOL one_shot,
+                                      CK_BYTE *in_data, CK_ULONG in_data_len,
+                                      CK_BYTE *signature, CK_ULONG *sig_len)
+{
+    CK_BYTE *sigbuf = NULL;
+    size_t siglen;
+    CK_RV rc = CKR_OK;
+#ifndef NO_EC
+    ECDSA_SIG *sig = NULL;
+    const BIGNUM *r, *s;
+    const unsigned char *p;
+    CK_ULONG n, privlen;
+#endif
+
+    if (hctx->keytype == CKK_RSA) {
+        sigbuf = signature;
+        siglen = *sig_len;
+    } else {
+        siglen = hctx->max_der_len;
+        sigbuf = malloc(siglen);
+        if (sigbuf == NULL) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            return CKR_HOST_MEMORY;
+        }
+    }
+
+    if ((one_shot ? EVP_DigestSign(hctx->md_ctx, sigbuf, &siglen,
+                                   in_data, in_data_len) :
+                    EVP_DigestSignFinal(hctx->md_ctx, sigbuf, &siglen)) != 1) {
+        TRACE_ERROR("EVP_DigestSign/EVP_DigestSignFinal failed\n");
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    if (hctx->keytype == CKK_RSA) {
+        *sig_len = siglen;
+        return CKR_OK;
+    }
+
+#ifndef NO_EC
+    /* Convert the DER encoded ECDSA signature into r || s */
+    p = sigbuf;
+    sig = d2i_ECDSA_SIG(NULL, &p, siglen);
+    if (sig == NULL) {
+        TRACE_ERROR("d2i_ECDSA_SIG failed\n");
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    ECDSA_SIG_get0(sig, &r, &s);
+    privlen = hctx->sig_len / 2;
+
+    n = privlen - BN_num_bytes(r);
+    memset(signature, 0, n);
+    BN_bn2bin(r, &signature[n]);
+
+    n = privlen - BN_num_bytes(s);
+    memset(signature + privlen, 0x00, n);
+    BN_bn2bin(s, &signature[privlen + n]);
+
+    *sig_len = 2 * privlen;
+#endif
+
+out:
+#ifndef NO_EC
+    if (sig != NULL)
+        ECDSA_SIG_free(sig);
+#endif
+    if (sigbuf != signature)
+        free(sigbuf);
+
+    return rc;
+}
+
+static CK_RV openssl_hash_verify_finish(struct openssl_hash_sign_ctx *hctx,
+                                        CK_BBOOL one_shot,
+                                        CK_BYTE *in_data,
+                                        CK_ULONG in_data_len,
+                                        CK_BYTE *signature, CK_ULONG sig_len)
+{
+    CK_BYTE *sigbuf = signature;
+    size_t siglen = sig_len;
+    CK_RV rc;
+#ifndef NO_EC
+    ECDSA_SIG *sig = NULL;
+    BIGNUM *r = NULL, *s = NULL;
+    CK_ULONG privlen;
+    int len;
+#endif
+
+    if (sig_len != hctx->sig_len) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SIGNATURE_LEN_RANGE));
+        return CKR_SIGNATURE_LEN_RANGE;
+    }
+
+#ifndef NO_EC
+    if (hctx->keytype == CKK_EC) {
+        /* Convert r || s into a DER encoded ECDSA signature */
+        privlen = hctx->sig_len / 2;
+
+        sig = ECDSA_SIG_new();
+        r = BN_bin2bn(signature, privlen, NULL);
+        s = BN_bin2bn(signature + privlen, privlen, NULL);
+        if (sig == NULL || r == NULL || s == NULL ||
+            !ECDSA_SIG_set0(sig, r, s)) {
+            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+            BN_free(r);
+            BN_free(s);
+            rc = CKR_HOST_MEMORY;
+            goto out;
+        }
+
+        sigbuf = NULL;
+        len = i2d_ECDSA_SIG(sig, &sigbuf);
+        if (len <= 0) {
+            TRACE_ERROR("i2d_ECDSA_SIG failed\n");
+            rc = CKR_FUNCTION_FAILED;
+            goto out;
+        }
+        siglen = len;
+    }
+#endif
+
+    if ((one_shot ? EVP_DigestVerify(hctx->md_ctx, sigbuf, siglen,
+                                     in_data, in_data_len) :
+                    EVP_DigestVerifyFinal(hctx->md_ctx, sigbuf,
+                                          siglen)) != 1) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SIGNATURE_INVALID));
+        rc = CKR_SIGNATURE_INVALID;
     } else {
-        ctx->context = (CK_BYTE *) mdctx;
-        ctx->context_free_func = openssl_specific_hmac_free;
-        ctx->state_unsaveable = TRUE;
+        rc = CKR_OK;
     }
 
-    rc = CKR_OK;
-done:
-    if (pkey != NULL)
-        EVP_PKEY_free(pkey);
+#ifndef NO_EC
+out:
+    if (sig != NULL)
+        ECDSA_SIG_free(sig);
+#endif
+    if (sigbuf != signature)
+        OPENSSL_free(sigbuf);
 
-    object_put(tokdata, key, TRUE);
-    key = NULL;
     return rc;
 }
 
-CK_RV openssl_specific_hmac(SIGN_VERIFY_CONTEXT *ctx, CK_BYTE *in_data,
-                            CK_ULONG in_data_len, CK_BYTE *signature,
-                            CK_ULONG *sig_len, CK_BBOOL sign)
+CK_RV openssl_specific_hash_sign(STDLL_TokData_t *tokdata, SESSION *sess,
+                                 SIGN_VERIFY_CONTEXT *ctx,
+                                 CK_BBOOL length_only,
+                                 CK_BYTE *in_data, CK_ULONG in_data_len,
+                                 CK_BYTE *signature, CK_ULONG *sig_len)
 {
-    int rc;
-    size_t mac_len, len;
-    unsigned char mac[MAX_SHA_HASH_SIZE];
-    EVP_MD_CTX *mdctx = NULL;
-    CK_RV rv = CKR_OK;
-    CK_BBOOL general = FALSE;
-    CK_MECHANISM_TYPE digest_mech;
-    CK_ULONG mac_len2;
+    struct openssl_hash_sign_ctx *hctx;
 
-    if (!ctx || !ctx->context) {
-        TRACE_ERROR("%s received bad argument(s)\n", __func__);
-        return CKR_FUNCTION_FAILED;
-    }
+    UNUSED(tokdata);
+    UNUSED(sess);
 
-    if (sign && !sig_len) {
+    if (!sig_len) {
         TRACE_ERROR("%s received bad argument(s)\n", __func__);
         return CKR_FUNCTION_FAILED;
     }
 
-    rc = get_hmac_digest(ctx->mech.mechanism, &digest_mech, &general);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s get_hmac_digest failed\n", __func__);
-        return rc;
-    }
-
-    rc = get_sha_size(digest_mech, &mac_len2);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s get_sha_size failed\n", __func__);
-        return rc;
-    }
-    mac_len = mac_len2;
-
-    mdctx = (EVP_MD_CTX *) ctx->context;
-
-    rc = EVP_DigestSignUpdate(mdctx, in_data, in_data_len);
-    if (rc != 1) {
-        TRACE_ERROR("EVP_DigestSignUpdate failed.\n");
-        rv = CKR_FUNCTION_FAILED;
-        goto done;
-    }
+    hctx = (struct openssl_hash_sign_ctx *)ctx->context;
+    if (hctx == NULL)
+        return CKR_OPERATION_NOT_INITIALIZED;
 
-    rc = EVP_DigestSignFinal(mdctx, mac, &mac_len);
-    if (rc != 1) {
-        TRACE_ERROR("EVP_DigestSignFinal failed.\n");
-        rv = CKR_FUNCTION_FAILED;
-        goto done;
+    if (length_only == TRUE) {
+        *sig_len = hctx->sig_len;
+        return CKR_OK;
     }
 
-    if (sign) {
-        if (general)
-            *sig_len = *(CK_ULONG *) ctx->mech.pParameter;
-        else
-            *sig_len = mac_len;
-
-        memcpy(signature, mac, *sig_len);
-
-    } else {
-        if (general)
-            len = *(CK_ULONG *) ctx->mech.pParameter;
-        else
-            len = mac_len;
-
-        if (CRYPTO_memcmp(signature, mac, len) != 0) {
-            TRACE_ERROR("%s\n", ock_err(ERR_SIGNATURE_INVALID));
-            rv = CKR_SIGNATURE_INVALID;
-        }
+    if (*sig_len < hctx->sig_len) {
+        *sig_len = hctx->sig_len;
+        TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
+        return CKR_BUFFER_TOO_SMALL;
     }
-done:
-    EVP_MD_CTX_destroy(mdctx);
-    ctx->context = NULL;
 
-    return rv;
+    return openssl_hash_sign_finish(hctx, TRUE, in_data, in_data_len,
+                                    signature, sig_len);
 }
 
-CK_RV openssl_specific_hmac_update(SIGN_VERIFY_CONTEXT *ctx, CK_BYTE *in_data,
-                                   CK_ULONG in_data_len, CK_BBOOL sign)
+CK_RV openssl_specific_hash_sign_verify_update(STDLL_TokData_t *tokdata,
+                                               SESSION *sess,
+                                               SIGN_VERIFY_CONTEXT *ctx,
+                                               CK_BYTE *in_data,
+                                               CK_ULONG in_data_len)
 {
-    int rc;
-    EVP_MD_CTX *mdctx = NULL;
-    CK_RV rv = CKR_OK;
+    struct openssl_hash_sign_ctx *hctx;
 
-    UNUSED(sign);
+    UNUSED(tokdata);
+    UNUSED(sess);
 
-    if (!ctx || !ctx->context)
+    hctx = (struct openssl_hash_sign_ctx *)ctx->context;
+    if (hctx == NULL)
         return CKR_OPERATION_NOT_INITIALIZED;
 
-    mdctx = (EVP_MD_CTX *) ctx->context;
-
-    rc = EVP_DigestSignUpdate(mdctx, in_data, in_data_len);
-    if (rc != 1) {
-        TRACE_ERROR("EVP_DigestSignUpdate failed.\n");
-        rv = CKR_FUNCTION_FAILED;
-    } else {
-        return CKR_OK;
+    if ((hctx->sign ?
+            EVP_DigestSignUpdate(hctx->md_ctx, in_data, in_data_len) :
+            EVP_DigestVerifyUpdate(hctx->md_ctx, in_data, in_data_len)) != 1) {
+        TRACE_ERROR("EVP_DigestSignUpdate/EVP_DigestVerifyUpdate failed\n");
+        return CKR_FUNCTION_FAILED;
     }
 
-    EVP_MD_CTX_destroy(mdctx);
-    ctx->context = NULL;
-    return rv;
+    return CKR_OK;
 }
 
-CK_RV openssl_specific_hmac_final(SIGN_VERIFY_CONTEXT *ctx, CK_BYTE *signature,
-                                  CK_ULONG *sig_len, CK_BBOOL sign)
+CK_RV openssl_specific_hash_sign_final(STDLL_TokData_t *tokdata,
+                                       SESSION *sess,
+                                       SIGN_VERIFY_CONTEXT *ctx,
+                                       CK_BBOOL length_only,
+                                       CK_BYTE *signature, CK_ULONG *sig_len)
 {
-    int rc;
-    size_t mac_len, len;
-    unsigned char mac[MAX_SHA_HASH_SIZE];
-    EVP_MD_CTX *mdctx = NULL;
-    CK_RV rv = CKR_OK;
-    CK_BBOOL general = FALSE;
-    CK_MECHANISM_TYPE digest_mech;
-    CK_ULONG mac_len2;
+    struct openssl_hash_sign_ctx *hctx;
 
-    if (!ctx || !ctx->context)
-        return CKR_OPERATION_NOT_INITIALIZED;
+    UNUSED(tokdata);
+    UNUSED(sess);
 
-    if (sign && !sig_len) {
+    if (!sig_len) {
         TRACE_ERROR("%s received bad argument(s)\n", __func__);
         return CKR_FUNCTION_FAILED;
     }
 
-    rc = get_hmac_digest(ctx->mech.mechanism, &digest_mech, &general);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s get_hmac_digest failed\n", __func__);
-        return rc;
-    }
+    hctx = (struct openssl_hash_sign_ctx *)ctx->context;
+    if (hctx == NULL)
+        return CKR_OPERATION_NOT_INITIALIZED;
 
-    rc = get_sha_size(digest_mech, &mac_len2);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("%s get_sha_size failed\n", __func__);
-        return rc;
+    if (length_only == TRUE) {
+        *sig_len = hctx->sig_len;
+        return CKR_OK;
     }
-    mac_len = mac_len2;
 
-    if (signature == NULL) {
-        if (sign) {
-            if (general)
-                *sig_len = *(CK_ULONG *) ctx->mech.pParameter;
-            else
-                *sig_len = (CK_ULONG) mac_len;
-        }
-        return CKR_OK;
+    if (*sig_len < hctx->sig_len) {
+        *sig_len = hctx->sig_len;
+        TRACE_ERROR("%s\n", ock_err(ERR_BUFFER_TOO_SMALL));
+        return CKR_BUFFER_TOO_SMALL;
     }
 
-    mdctx = (EVP_MD_CTX *) ctx->context;
+    return openssl_hash_sign_finish(hctx, FALSE, NULL, 0, signature, sig_len);
+}
 
-    rc = EVP_DigestSignFinal(mdctx, mac, &mac_len);
-    if (rc != 1) {
-        TRACE_ERROR("EVP_DigestSignFinal failed.\n");
-        rv = CKR_FUNCTION_FAILED;
-        goto done;
-    }
+CK_RV openssl_specific_hash_verify(STDLL_TokData_t *tokdata, SESSION *sess,
+                                   SIGN_VERIFY_CONTEXT *ctx,
+                                   CK_BYTE *in_data, CK_ULONG in_data_len,
+                                   CK_BYTE *signature, CK_ULONG sig_len)
+{
+    struct openssl_hash_sign_ctx *hctx;
 
-    if (sign) {
-        if (general)
-            *sig_len = *(CK_ULONG *) ctx->mech.pParameter;
-        else
-            *sig_len = mac_len;
+    UNUSED(tokdata);
+    UNUSED(sess);
 
-        memcpy(signature, mac, *sig_len);
+    hctx = (struct openssl_hash_sign_ctx *)ctx->context;
+    if (hctx == NULL)
+        return CKR_OPERATION_NOT_INITIALIZED;
 
-    } else {
-        if (general)
-            len = *(CK_ULONG *) ctx->mech.pParameter;
-        else
-            len = mac_len;
+    return openssl_hash_verify_finish(hctx, TRUE, in_data, in_data_len,
+                                      signature, sig_len);
+}
 
-        if (CRYPTO_memcmp(signature, mac, len) != 0) {
-            TRACE_ERROR("%s\n", ock_err(ERR_SIGNATURE_INVALID));
-            rv = CKR_SIGNATURE_INVALID;
-        }
-    }
-done:
-    EVP_MD_CTX_destroy(mdctx);
-    ctx->context = NULL;
-    return rv;
+CK_RV openssl_specific_hash_verify_final(STDLL_TokData_t *tokdata,
+                                         SESSION *sess,
+                                         SIGN_VERIFY_CONTEXT *ctx,
+                                         CK_BYTE *signature, CK_ULONG sig_len)
+{
+    struct openssl_hash_sign_ctx *hctx;
+
+    UNUSED(tokdata);
+    UNUSED(sess);
+
+    hctx = (struct openssl_hash_sign_ctx *)ctx->context;
+    if (hctx == NULL)
+        return CKR_OPERATION_NOT_INITIALIZED;
+
+    return openssl_hash_verify_finish(hctx, FALSE, NULL, 0, signature,
+                                      sig_len);
 }
 
 CK_RV calc_rsa_crt_from_me(CK_ATTRIBUTE *modulus, CK_ATTRIBUTE *pub_exp,
@@ -5038,7 +6358,7 @@ CK_RV calc_rsa_crt_from_me(CK_ATTRIBUTE *modulus, CK_ATTRIBUTE *pub_exp,
     BN_CTX *bn_ctx;
     BIGNUM *n, *e, *d, *k, *r, *t, *two, *g, *y, *n_minus_1, *j, *x;
     BIGNUM *p, *q, *dp, *dq, *invq;
-    int i, prime_len;
+    int i, prime_len, len;
     CK_BYTE *buff = NULL;
     CK_RV rc;
 
@@ -5251,65 +6571,70 @@ step5_success:
         goto done;
     }
 
-    if (BN_bn2bin(p, buff) != prime_len) {
+    len = BN_bn2bin(p, buff);
+    if (len <= 0) {
         TRACE_DEVEL("BN_bn2bin failed for p\n");
         rc = CKR_FUNCTION_FAILED;
         goto done;
     }
 
-    rc = build_attribute(CKA_PRIME_1, buff, prime_len, prime1);
+    rc = build_attribute(CKA_PRIME_1, buff, len, prime1);
     if (rc != CKR_OK) {
         TRACE_DEVEL("build_attribute failed for CKA_PRIME_1\n");
         goto done;
     }
 
     memset(buff, 0, prime_len);
-    if (BN_bn2bin(q, buff) != prime_len) {
+    len = BN_bn2bin(q, buff);
+    if (len <= 0) {
         TRACE_DEVEL("BN_bn2bin failed for q\n");
         rc = CKR_FUNCTION_FAILED;
         goto done;
     }
 
-    rc = build_attribute(CKA_PRIME_2, buff, prime_len, prime2);
+    rc = build_attribute(CKA_PRIME_2, buff, len, prime2);
     if (rc != CKR_OK) {
         TRACE_DEVEL("build_attribute failed for CKA_PRIME_2\n");
         goto done;
     }
 
     memset(buff, 0, prime_len);
-    if (BN_bn2bin(dp, buff) != prime_len) {
+    len = BN_bn2bin(dp, buff);
+    if (len <= 0) {
         TRACE_DEVEL("BN_bn2bin failed for dp\n");
         rc = CKR_FUNCTION_FAILED;
         goto done;
     }
 
-    rc = build_attribute(CKA_EXPONENT_1, buff, prime_len, exponent1);
+    rc = build_attribute(CKA_EXPONENT_1, buff, len, exponent1);
     if (rc != CKR_OK) {
         TRACE_DEVEL("build_attribute failed for CKA_EXPONENT_1\n");
         goto done;
     }
 
     memset(buff, 0, prime_len);
-    if (BN_bn2bin(dq, buff) != prime_len) {
+    len = BN_bn2bin(dq, buff);
+    if (len <= 0) {
         TRACE_DEVEL("BN_bn2bin failed for dq\n");
         rc = CKR_FUNCTION_FAILED;
         goto done;
     }
 
-    rc = build_attribute(CKA_EXPONENT_2, buff, prime_len, exponent2);
+    rc = build_attribute(CKA_EXPONENT_2, buff, len, exponent2);
     if (rc != CKR_OK) {
         TRACE_DEVEL("build_attribute failed for CKA_EXPONENT_2\n");
         goto done;
     }
 
     memset(buff, 0, prime_len);
-    if (BN_bn2bin(invq, buff) != prime_len) {
+    len = BN_bn2bin(invq, buff);
+    if (len <= 0) {
         TRACE_DEVEL("BN_bn2bin failed for qinv\n");
         rc = CKR_FUNCTION_FAILED;
         goto done;
     }
 
-    rc = build_attribute(CKA_COEFFICIENT, buff, prime_len, coef);
+    rc = build_attribute(CKA_COEFFICIENT, buff, len, coef);
     if (rc != CKR_OK) {
         TRACE_DEVEL("build_attribute failed for CKA_COEFFICIENT\n");
         goto done;
@@ -5782,36 +7107,30 @@ static CK_RV get_key_from_pkey(EVP_PKEY *pkey, const char *param,
     return CKR_OK;
 }
 
-CK_RV openssl_specific_ibm_dilithium_generate_keypair(STDLL_TokData_t *tokdata,
-                                                      const struct pqc_oid *oid,
-                                                      TEMPLATE *publ_tmpl,
-                                                      TEMPLATE *priv_tmpl)
+/*
+ * Generates a Dilithium key of the specified key form via the oqsprovider.
+ */
+CK_RV openssl_specific_ibm_dilithium_keygen_pkey(const struct pqc_oid *oid,
+                                                 EVP_PKEY **pkey)
 {
     EVP_PKEY_CTX *ctx = NULL;
-    EVP_PKEY *pkey = NULL;
     const char *alg_name;
-    CK_BYTE *spki = NULL, *pkcs8 = NULL;
-    CK_ULONG spki_len = 0, pkcs8_len = 0;
-    size_t priv_len = 0, pub_len = 0;
-    CK_BYTE *priv_key = NULL, *pub_key = NULL;
     CK_RV rc = CKR_OK;
 
-    UNUSED(tokdata);
+    *pkey = NULL;
 
     alg_name = openssl_get_pqc_oid_name(oid);
     if (alg_name == NULL) {
         TRACE_ERROR("Dilithium key form '%lu' not supported by oqsprovider\n",
                     oid->keyform);
-        rc = CKR_KEY_SIZE_RANGE;
-        goto out;
+        return CKR_KEY_SIZE_RANGE;
     }
 
     /* Generate key via oqsprovider */
     ctx = EVP_PKEY_CTX_new_from_name(NULL, alg_name, NULL);
     if (ctx == NULL) {
         TRACE_ERROR("EVP_PKEY_CTX_new_from_name failed for '%s'\n", alg_name);
-        rc = CKR_FUNCTION_FAILED;
-        goto out;
+        return CKR_FUNCTION_FAILED;
     }
 
     if (EVP_PKEY_keygen_init(ctx) != 1) {
@@ -5820,12 +7139,55 @@ CK_RV openssl_specific_ibm_dilithium_generate_keypair(STDLL_TokData_t *tokdata,
         goto out;
     }
 
-    if (EVP_PKEY_generate(ctx, &pkey) != 1) {
+    if (EVP_PKEY_generate(ctx, pkey) != 1) {
         TRACE_ERROR("EVP_PKEY_generate failed for '%s'\n", alg_name);
         rc = CKR_FUNCTION_FAILED;
         goto out;
     }
 
+out:
+    EVP_PKEY_CTX_free(ctx);
+
+    return rc;
+}
+
+CK_RV openssl_specific_ibm_dilithium_generate_keypair(STDLL_TokData_t *tokdata,
+                                                      const struct pqc_oid *oid,
+                                                      TEMPLATE *publ_tmpl,
+                                                      TEMPLATE *priv_tmpl)
+{
+    EVP_PKEY *pkey = NULL;
+    CK_RV rc;
+
+    UNUSED(tokdata);
+
+    rc = openssl_specific_ibm_dilithium_keygen_pkey(oid, &pkey);
+    if (rc != CKR_OK)
+        return rc;
+
+    rc = openssl_specific_ibm_dilithium_keygen_from_pkey(pkey, oid, publ_tmpl,
+                                                         priv_tmpl);
+
+    EVP_PKEY_free(pkey);
+
+    return rc;
+}
+
+/*
+ * Adds the components of a generated Dilithium key to the public and private
+ * key templates.
+ */
+CK_RV openssl_specific_ibm_dilithium_keygen_from_pkey(EVP_PKEY *pkey,
+                                                      const struct pqc_oid *oid,
+                                                      TEMPLATE *publ_tmpl,
+                                                      TEMPLATE *priv_tmpl)
+{
+    CK_BYTE *spki = NULL, *pkcs8 = NULL;
+    CK_ULONG spki_len = 0, pkcs8_len = 0;
+    size_t priv_len = 0, pub_len = 0;
+    CK_BYTE *priv_key = NULL, *pub_key = NULL;
+    CK_RV rc = CKR_OK;
+
     /* Get private and public key */
     rc = get_key_from_pkey(pkey, OSSL_PKEY_PARAM_PRIV_KEY,
                            &priv_key, &priv_len);
@@ -5903,10 +7265,6 @@ CK_RV openssl_specific_ibm_dilithium_generate_keypair(STDLL_TokData_t *tokdata,
     }
 
 out:
-    if (ctx != NULL)
-        EVP_PKEY_CTX_free(ctx);
-    if (pkey != NULL)
-        EVP_PKEY_free(pkey);
     if (priv_key != NULL) {
         OPENSSL_cleanse(priv_key, priv_len);
         free(priv_key);
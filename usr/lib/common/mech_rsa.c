@@ -1571,6 +1571,11 @@ CK_RV rsa_hash_pss_sign(STDLL_TokData_t *tokdata, SESSION *sess,
         return CKR_FUNCTION_FAILED;
     }
 
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_sign(tokdata, sess, ctx, length_only,
+                                          in_data, in_data_len, sig,
+                                          sig_len);
+
     memset(&digest_ctx, 0x0, sizeof(digest_ctx));
     memset(&sign_ctx, 0x0, sizeof(sign_ctx));
 
@@ -1639,6 +1644,10 @@ CK_RV rsa_hash_pss_update(STDLL_TokData_t *tokdata, SESSION *sess,
         return CKR_FUNCTION_FAILED;
     }
 
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_sign_verify_update(tokdata, sess, ctx,
+                                                        in_data, in_data_len);
+
     /* see if digest has already been through init */
     digest_ctx = (DIGEST_CONTEXT *) ctx->context;
     if (digest_ctx->active == FALSE) {
@@ -1683,6 +1692,11 @@ CK_RV rsa_hash_pss_sign_final(STDLL_TokData_t *tokdata, SESSION *sess,
         return CKR_FUNCTION_FAILED;
     }
 
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_sign_final(tokdata, sess, ctx,
+                                                length_only, signature,
+                                                sig_len);
+
     memset(&sign_ctx, 0x0, sizeof(sign_ctx));
 
     digest_ctx = (DIGEST_CONTEXT *) ctx->context;
@@ -1746,6 +1760,11 @@ CK_RV rsa_hash_pss_verify(STDLL_TokData_t *tokdata, SESSION *sess,
         TRACE_ERROR("%s received bad argument(s)\n", __func__);
         return CKR_FUNCTION_FAILED;
     }
+
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_verify(tokdata, sess, ctx, in_data,
+                                            in_data_len, signature, sig_len);
+
     memset(&digest_ctx, 0x0, sizeof(digest_ctx));
     memset(&verify_ctx, 0x0, sizeof(verify_ctx));
 
@@ -1817,6 +1836,10 @@ CK_RV rsa_hash_pss_verify_final(STDLL_TokData_t *tokdata, SESSION *sess,
         return CKR_FUNCTION_FAILED;
     }
 
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_verify_final(tokdata, sess, ctx,
+                                                  signature, sig_len);
+
     memset(&verify_ctx, 0x0, sizeof(verify_ctx));
 
     digest_ctx = (DIGEST_CONTEXT *) ctx->context;
@@ -1950,6 +1973,12 @@ CK_RV rsa_hash_pkcs_sign(STDLL_TokData_t *tokdata,
         TRACE_ERROR("%s received bad argument(s)\n", __func__);
         return CKR_FUNCTION_FAILED;
     }
+
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_sign(tokdata, sess, ctx, length_only,
+                                          in_data, in_data_len, signature,
+                                          sig_len);
+
     memset(&digest_ctx, 0x0, sizeof(digest_ctx));
     memset(&sign_ctx, 0x0, sizeof(sign_ctx));
 
@@ -2043,6 +2072,11 @@ CK_RV rsa_hash_pkcs_sign_update(STDLL_TokData_t *tokdata,
         TRACE_ERROR("%s received bad argument(s)\n", __func__);
         return CKR_FUNCTION_FAILED;
     }
+
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_sign_verify_update(tokdata, sess, ctx,
+                                                        in_data, in_data_len);
+
     context = (RSA_DIGEST_CONTEXT *) ctx->context;
 
     if (context->flag == FALSE) {
@@ -2103,6 +2137,11 @@ CK_RV rsa_hash_pkcs_verify(STDLL_TokData_t *tokdata,
         TRACE_ERROR("%s received bad argument(s)\n", __func__);
         return CKR_FUNCTION_FAILED;
     }
+
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_verify(tokdata, sess, ctx, in_data,
+                                            in_data_len, signature, sig_len);
+
     memset(&digest_ctx, 0x0, sizeof(digest_ctx));
     memset(&verify_ctx, 0x0, sizeof(verify_ctx));
 
@@ -2193,6 +2232,11 @@ CK_RV rsa_hash_pkcs_verify_update(STDLL_TokData_t *tokdata,
         TRACE_ERROR("%s received bad argument(s)\n", __func__);
         return CKR_FUNCTION_FAILED;
     }
+
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_sign_verify_update(tokdata, sess, ctx,
+                                                        in_data, in_data_len);
+
     context = (RSA_DIGEST_CONTEXT *) ctx->context;
 
     if (context->flag == FALSE) {
@@ -2253,6 +2297,11 @@ CK_RV rsa_hash_pkcs_sign_final(STDLL_TokData_t *tokdata,
         return CKR_FUNCTION_FAILED;
     }
 
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_sign_final(tokdata, sess, ctx,
+                                                length_only, signature,
+                                                sig_len);
+
     rc = rsa_pkcs_alg_oid_from_mech(ctx->mech.mechanism, &oid, &oid_len);
     if (rc != CKR_OK) {
         TRACE_ERROR("%s rsa_pkcs_alg_oid_from_mech failed\n", __func__);
@@ -2353,6 +2402,10 @@ CK_RV rsa_hash_pkcs_verify_final(STDLL_TokData_t *tokdata,
         return CKR_FUNCTION_FAILED;
     }
 
+    if (ctx->hash_sign_fused)
+        return token_specific.t_hash_verify_final(tokdata, sess, ctx,
+                                                  signature, sig_len);
+
     rc = rsa_pkcs_alg_oid_from_mech(ctx->mech.mechanism, &oid, &oid_len);
     if (rc != CKR_OK) {
         TRACE_ERROR("%s rsa_pkcs_alg_oid_from_mech failed\n", __func__);
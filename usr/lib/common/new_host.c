@@ -89,7 +89,7 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     /* set trace info */
     set_trace(t);
 
-    rc = bt_init(&sltp->TokData->sess_btree, free);
+    rc = bt_init(&sltp->TokData->sess_btree, call_session_free);
     rc |= bt_init(&sltp->TokData->object_map_btree, free);
     rc |= bt_init(&sltp->TokData->sess_obj_btree, call_object_free);
     rc |= bt_init(&sltp->TokData->priv_token_obj_btree, call_object_free);
@@ -3581,16 +3581,62 @@ CK_RV SC_DigestEncryptUpdate(STDLL_TokData_t *tokdata,
                              CK_ULONG ulPartLen, CK_BYTE_PTR pEncryptedPart,
                              CK_ULONG_PTR pulEncryptedPartLen)
 {
-    CK_RV rc;
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
 
-    rc = SC_EncryptUpdate(tokdata, sSession, pPart, ulPartLen,
-                          pEncryptedPart, pulEncryptedPartLen);
-    if (rc != CKR_OK || pEncryptedPart == NULL)
-        goto out;
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
 
-    rc = SC_DigestUpdate(tokdata, sSession, pPart, ulPartLen);
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if ((!pPart && ulPartLen != 0) || !pulEncryptedPartLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (sess->encr_ctx.active == FALSE || sess->digest_ctx.active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        rc = CKR_OPERATION_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pEncryptedPart) {
+        rc = encr_mgr_encrypt_update(tokdata, sess, TRUE, &sess->encr_ctx,
+                                     pPart, ulPartLen, NULL,
+                                     pulEncryptedPartLen);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("encr_mgr_encrypt_update() failed.\n");
+        goto done;
+    }
+
+    rc = encr_mgr_encrypt_dual_update(tokdata, sess, &sess->encr_ctx,
+                                      &sess->digest_ctx, NULL, pPart, ulPartLen,
+                                      pEncryptedPart, pulEncryptedPartLen);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("encr_mgr_encrypt_dual_update() failed.\n");
+
+done:
+    if (rc != CKR_OK && rc != CKR_BUFFER_TOO_SMALL && sess != NULL) {
+        encr_mgr_cleanup(tokdata, sess, &sess->encr_ctx);
+        digest_mgr_cleanup(tokdata, sess, &sess->digest_ctx);
+    }
+
+    TRACE_INFO("C_DigestEncryptUpdate: rc = 0x%08lx, sess = %ld, "
+               "amount = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulPartLen);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
 
-out:
     return rc;
 }
 
@@ -3601,16 +3647,63 @@ CK_RV SC_DecryptDigestUpdate(STDLL_TokData_t *tokdata,
                              CK_ULONG ulEncryptedPartLen, CK_BYTE_PTR pPart,
                              CK_ULONG_PTR pulPartLen)
 {
-    CK_RV rc;
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
 
-    rc = SC_DecryptUpdate(tokdata, sSession, pEncryptedPart,
-                          ulEncryptedPartLen, pPart, pulPartLen);
-    if (rc != CKR_OK || pPart == NULL)
-        goto out;
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
 
-    rc = SC_DigestUpdate(tokdata, sSession, pPart, *pulPartLen);
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if ((!pEncryptedPart && ulEncryptedPartLen != 0) || !pulPartLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (sess->decr_ctx.active == FALSE || sess->digest_ctx.active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        rc = CKR_OPERATION_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pPart) {
+        rc = decr_mgr_decrypt_update(tokdata, sess, TRUE, &sess->decr_ctx,
+                                     pEncryptedPart, ulEncryptedPartLen,
+                                     NULL, pulPartLen);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("decr_mgr_decrypt_update() failed.\n");
+        goto done;
+    }
+
+    rc = decr_mgr_decrypt_dual_update(tokdata, sess, &sess->decr_ctx,
+                                      &sess->digest_ctx, NULL, pEncryptedPart,
+                                      ulEncryptedPartLen, pPart, pulPartLen);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("decr_mgr_decrypt_dual_update() failed.\n");
+
+done:
+    if (rc != CKR_OK && rc != CKR_BUFFER_TOO_SMALL && sess != NULL) {
+        decr_mgr_cleanup(tokdata, sess, &sess->decr_ctx);
+        digest_mgr_cleanup(tokdata, sess, &sess->digest_ctx);
+    }
+
+    TRACE_INFO("C_DecryptDigestUpdate: rc = 0x%08lx, sess = %ld, "
+               "amount = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               ulEncryptedPartLen);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
 
-out:
     return rc;
 }
 
@@ -3620,16 +3713,62 @@ CK_RV SC_SignEncryptUpdate(STDLL_TokData_t *tokdata,
                            CK_ULONG ulPartLen, CK_BYTE_PTR pEncryptedPart,
                            CK_ULONG_PTR pulEncryptedPartLen)
 {
-    CK_RV rc;
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
 
-    rc = SC_EncryptUpdate(tokdata, sSession, pPart, ulPartLen,
-                          pEncryptedPart, pulEncryptedPartLen);
-    if (rc != CKR_OK || pEncryptedPart == NULL)
-        goto out;
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
 
-    rc = SC_SignUpdate(tokdata, sSession, pPart, ulPartLen);
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    if ((!pPart && ulPartLen != 0) || !pulEncryptedPartLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (sess->encr_ctx.active == FALSE || sess->sign_ctx.active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        rc = CKR_OPERATION_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pEncryptedPart) {
+        rc = encr_mgr_encrypt_update(tokdata, sess, TRUE, &sess->encr_ctx,
+                                     pPart, ulPartLen, NULL,
+                                     pulEncryptedPartLen);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("encr_mgr_encrypt_update() failed.\n");
+        goto done;
+    }
+
+    rc = encr_mgr_encrypt_dual_update(tokdata, sess, &sess->encr_ctx,
+                                      NULL, &sess->sign_ctx, pPart, ulPartLen,
+                                      pEncryptedPart, pulEncryptedPartLen);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("encr_mgr_encrypt_dual_update() failed.\n");
+
+done:
+    if (rc != CKR_OK && rc != CKR_BUFFER_TOO_SMALL && sess != NULL) {
+        encr_mgr_cleanup(tokdata, sess, &sess->encr_ctx);
+        sign_mgr_cleanup(tokdata, sess, &sess->sign_ctx);
+    }
+
+    TRACE_INFO("C_SignEncryptUpdate: rc = 0x%08lx, sess = %ld, "
+               "amount = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle, ulPartLen);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
 
-out:
     return rc;
 }
 
@@ -3639,16 +3778,63 @@ CK_RV SC_DecryptVerifyUpdate(STDLL_TokData_t *tokdata,
                              CK_ULONG ulEncryptedPartLen, CK_BYTE_PTR pPart,
                              CK_ULONG_PTR pulPartLen)
 {
-    CK_RV rc;
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
 
-    rc = SC_DecryptUpdate(tokdata, sSession, pEncryptedPart,
-                          ulEncryptedPartLen, pPart, pulPartLen);
-    if (rc != CKR_OK || pPart == NULL)
-        goto out;
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
 
-    rc = SC_VerifyUpdate(tokdata, sSession, pPart, *pulPartLen);
+    if ((!pEncryptedPart && ulEncryptedPartLen != 0) || !pulPartLen) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (sess->decr_ctx.active == FALSE || sess->verify_ctx.active == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_NOT_INITIALIZED));
+        rc = CKR_OPERATION_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pPart) {
+        rc = decr_mgr_decrypt_update(tokdata, sess, TRUE, &sess->decr_ctx,
+                                     pEncryptedPart, ulEncryptedPartLen,
+                                     NULL, pulPartLen);
+        if (rc != CKR_OK)
+            TRACE_DEVEL("decr_mgr_decrypt_update() failed.\n");
+        goto done;
+    }
+
+    rc = decr_mgr_decrypt_dual_update(tokdata, sess, &sess->decr_ctx,
+                                      NULL, &sess->verify_ctx, pEncryptedPart,
+                                      ulEncryptedPartLen, pPart, pulPartLen);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("decr_mgr_decrypt_dual_update() failed.\n");
+
+done:
+    if (rc != CKR_OK && rc != CKR_BUFFER_TOO_SMALL && sess != NULL) {
+        decr_mgr_cleanup(tokdata, sess, &sess->decr_ctx);
+        verify_mgr_cleanup(tokdata, sess, &sess->verify_ctx);
+    }
+
+    TRACE_INFO("C_DecryptVerifyUpdate: rc = 0x%08lx, sess = %ld, "
+               "amount = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               ulEncryptedPartLen);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
 
-out:
     return rc;
 }
 
@@ -4232,6 +4418,201 @@ done:
     return rc;
 }
 
+CK_RV SC_IBM_ReencryptBatch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                            CK_MECHANISM_PTR pDecrMech,
+                            CK_OBJECT_HANDLE hDecrKey,
+                            CK_MECHANISM_PTR pEncrMech,
+                            CK_OBJECT_HANDLE hEncrKey,
+                            CK_ULONG ulCount,
+                            CK_VOID_PTR *ppDecrParams,
+                            CK_VOID_PTR *ppEncrParams,
+                            CK_BYTE_PTR *ppEncryptedData,
+                            CK_ULONG_PTR pulEncryptedDataLen,
+                            CK_BYTE_PTR *ppReencryptedData,
+                            CK_ULONG_PTR pulReencryptedDataLen,
+                            CK_RV *pResults)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pDecrMech || !pEncrMech) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (ulCount > 0 && (!ppEncryptedData || !pulEncryptedDataLen ||
+                        !pulReencryptedDataLen || !pResults)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pDecrMech, CKF_DECRYPT);
+    if (rc != CKR_OK)
+        goto done;
+    rc = valid_mech(tokdata, pEncrMech, CKF_ENCRYPT);
+    if (rc != CKR_OK)
+        goto done;
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    if (sess->decr_ctx.active == TRUE || sess->encr_ctx.active == TRUE) {
+        rc = CKR_OPERATION_ACTIVE;
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        goto done;
+    }
+
+    sess->decr_ctx.count_statistics = TRUE;
+    sess->encr_ctx.count_statistics = TRUE;
+    rc = encr_mgr_reencrypt_batch(tokdata, sess, &sess->decr_ctx, pDecrMech,
+                                  hDecrKey, &sess->encr_ctx, pEncrMech,
+                                  hEncrKey, ulCount, ppDecrParams,
+                                  ppEncrParams, ppEncryptedData,
+                                  pulEncryptedDataLen, ppReencryptedData,
+                                  pulReencryptedDataLen, pResults);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("encr_mgr_reencrypt_batch() failed.\n");
+
+done:
+    TRACE_INFO("SC_IBM_ReencryptBatch: rc = 0x%08lx, sess = %ld, "
+               "decrmech = 0x%lx, encrmech = 0x%lx, count = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               (pDecrMech ? pDecrMech->mechanism : (CK_ULONG)-1),
+               (pEncrMech ? pEncrMech->mechanism : (CK_ULONG)-1), ulCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_DigestBatch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                         CK_MECHANISM_PTR pMechanism, CK_ULONG ulCount,
+                         CK_BYTE_PTR *ppData, CK_ULONG_PTR pulDataLen,
+                         CK_BYTE_PTR pDigests, CK_ULONG_PTR pulDigestsLen)
+{
+    SESSION *sess = NULL;
+    CK_BBOOL length_only = FALSE;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pMechanism || !pulDigestsLen ||
+        (ulCount > 0 && (!ppData || !pulDataLen))) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism, CKF_DIGEST);
+    if (rc != CKR_OK)
+        goto done;
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    if (!pDigests)
+        length_only = TRUE;
+
+    rc = digest_mgr_digest_batch(tokdata, sess, length_only, pMechanism,
+                                 ulCount, ppData, pulDataLen, pDigests,
+                                 pulDigestsLen);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("digest_mgr_digest_batch() failed.\n");
+
+done:
+    TRACE_INFO("SC_IBM_DigestBatch: rc = 0x%08lx, sess = %ld, mech = 0x%lx, "
+               "count = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               (pMechanism ? pMechanism->mechanism : (CK_ULONG)-1), ulCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_GetAttributeValueBatch(STDLL_TokData_t *tokdata,
+                                    ST_SESSION_T *sSession,
+                                    CK_ULONG ulCount,
+                                    CK_OBJECT_HANDLE_PTR phObjects,
+                                    CK_ATTRIBUTE_PTR *ppTemplates,
+                                    CK_ULONG_PTR pulAttributeCounts,
+                                    CK_RV *pResults)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (ulCount > 0 && (!phObjects || !ppTemplates || !pulAttributeCounts ||
+                        !pResults)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = object_mgr_get_attribute_values_batch(tokdata, sess, ulCount,
+                                               phObjects, ppTemplates,
+                                               pulAttributeCounts, pResults);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("object_mgr_get_attribute_values_batch() failed.\n");
+
+done:
+    TRACE_INFO("C_IBM_GetAttributeValueBatch: rc = 0x%08lx, count = %lu\n",
+               rc, ulCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
 CK_RV SC_HandleEvent(STDLL_TokData_t *tokdata, unsigned int event_type,
                      unsigned int event_flags, const char *payload,
                      unsigned int payload_len)
@@ -4316,6 +4697,9 @@ void SC_SetFunctionList(void)
     function_list.ST_SessionCancel = SC_SessionCancel;
 
     function_list.ST_IBM_ReencryptSingle = SC_IBM_ReencryptSingle;
+    function_list.ST_IBM_DigestBatch = SC_IBM_DigestBatch;
+    function_list.ST_IBM_ReencryptBatch = SC_IBM_ReencryptBatch;
+    function_list.ST_IBM_GetAttributeValueBatch = SC_IBM_GetAttributeValueBatch;
 
     function_list.ST_HandleEvent = SC_HandleEvent;
 }
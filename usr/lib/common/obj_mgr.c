@@ -20,6 +20,7 @@
 #include <strings.h>
 #include <errno.h>
 #include <unistd.h>
+#include <time.h>
 
 #include "pkcs11types.h"
 #include "defs.h"
@@ -915,19 +916,16 @@ CK_RV object_mgr_find_in_map_nocache(STDLL_TokData_t *tokdata,
 // The returned object is locked (depending on lock_type), and must be unlocked
 // by the caller!
 //
-CK_RV object_mgr_find_in_map1(STDLL_TokData_t *tokdata,
-                              CK_OBJECT_HANDLE handle, OBJECT **ptr,
-                              OBJ_LOCK_TYPE lock_type)
+/*
+ * Gets the object of an external handle, without locking it and without
+ * checking the shared memory. The caller must put the object.
+ */
+static CK_RV object_mgr_lookup_handle(STDLL_TokData_t *tokdata,
+                                      CK_OBJECT_HANDLE handle, OBJECT **ptr,
+                                      CK_BBOOL *session_obj)
 {
     OBJECT_MAP *map = NULL;
     OBJECT *obj = NULL;
-    CK_RV rc = CKR_OK;
-    CK_BBOOL session_obj, locked = FALSE;
-
-    if (!ptr) {
-        TRACE_ERROR("Invalid function arguments.\n");
-        return CKR_FUNCTION_FAILED;
-    }
 
     map = bt_get_node_value(&tokdata->object_map_btree, handle);
     if (!map) {
@@ -936,7 +934,7 @@ CK_RV object_mgr_find_in_map1(STDLL_TokData_t *tokdata,
         return CKR_OBJECT_HANDLE_INVALID;
     }
 
-    session_obj = map->is_session_obj;
+    *session_obj = map->is_session_obj;
     if (map->is_session_obj)
         obj = bt_get_node_value(&tokdata->sess_obj_btree, map->obj_handle);
     else if (map->is_private)
@@ -953,6 +951,28 @@ CK_RV object_mgr_find_in_map1(STDLL_TokData_t *tokdata,
         return CKR_OBJECT_HANDLE_INVALID;
     }
 
+    *ptr = obj;
+
+    return CKR_OK;
+}
+
+CK_RV object_mgr_find_in_map1(STDLL_TokData_t *tokdata,
+                              CK_OBJECT_HANDLE handle, OBJECT **ptr,
+                              OBJ_LOCK_TYPE lock_type)
+{
+    OBJECT *obj = NULL;
+    CK_RV rc = CKR_OK;
+    CK_BBOOL session_obj, locked = FALSE;
+
+    if (!ptr) {
+        TRACE_ERROR("Invalid function arguments.\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    rc = object_mgr_lookup_handle(tokdata, handle, &obj, &session_obj);
+    if (rc != CKR_OK)
+        return rc;
+
     /* SAB XXX Fix me.. need to make it more efficient than just looking
      * for the object to be changed. set a global flag that contains the
      * ref count to all objects.. if the shm ref count changes, then we
@@ -1348,6 +1368,214 @@ done:
 }
 
 
+struct getattr_batch_obj {
+    OBJECT *obj;
+    CK_BBOOL session_obj;
+    CK_BBOOL stale;
+    CK_BBOOL locked;
+    CK_RV rc;
+};
+
+static int getattr_batch_obj_cmp(const void *a, const void *b)
+{
+    uintptr_t obj_a = (uintptr_t)((const struct getattr_batch_obj *)a)->obj;
+    uintptr_t obj_b = (uintptr_t)((const struct getattr_batch_obj *)b)->obj;
+
+    return (obj_a > obj_b) - (obj_a < obj_b);
+}
+
+/*
+ * Gets the attribute values of a batch of objects. All objects are looked up
+ * first. An object whose handle is given several times is locked only once,
+ * and the objects are locked in address order, so that batches with
+ * overlapping objects can not deadlock each other. The shared memory is
+ * checked for all token objects under a single XProcLock. Objects that have
+ * been changed by another process are then reloaded one by one, while no
+ * other object of the batch is locked, because the reload needs the WRITE
+ * lock. Finally all objects are READ locked to get the attribute values.
+ * The result of each object is returned in results[i].
+ */
+CK_RV object_mgr_get_attribute_values_batch(STDLL_TokData_t *tokdata,
+                                            SESSION *sess, CK_ULONG count,
+                                            CK_OBJECT_HANDLE *handles,
+                                            CK_ATTRIBUTE **templates,
+                                            CK_ULONG *attr_counts,
+                                            CK_RV *results)
+{
+    TOK_OBJ_ENTRY *entry = NULL;
+    OBJECT **objs = NULL;
+    struct getattr_batch_obj *uobjs = NULL, key, *uobj;
+    CK_BBOOL session_obj, token_objs = FALSE;
+    CK_ULONG num_uobjs = 0, n, i;
+    CK_RV rc;
+
+    if (count == 0)
+        return CKR_OK;
+
+    objs = calloc(count, sizeof(OBJECT *));
+    uobjs = calloc(count, sizeof(*uobjs));
+    if (objs == NULL || uobjs == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    /* Each item holds its own reference on its object */
+    for (i = 0; i < count; i++) {
+        if (templates[i] == NULL) {
+            TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+            results[i] = CKR_ARGUMENTS_BAD;
+            continue;
+        }
+
+        results[i] = object_mgr_lookup_handle(tokdata, handles[i], &objs[i],
+                                              &session_obj);
+        if (results[i] != CKR_OK)
+            continue;
+
+        uobjs[num_uobjs].obj = objs[i];
+        uobjs[num_uobjs].session_obj = session_obj;
+        num_uobjs++;
+        if (!session_obj)
+            token_objs = TRUE;
+    }
+
+    /* Sort by address and drop the duplicates */
+    qsort(uobjs, num_uobjs, sizeof(*uobjs), getattr_batch_obj_cmp);
+    if (num_uobjs > 1) {
+        n = 1;
+        for (i = 1; i < num_uobjs; i++) {
+            if (uobjs[i].obj != uobjs[n - 1].obj)
+                uobjs[n++] = uobjs[i];
+        }
+        num_uobjs = n;
+    }
+
+    if (token_objs) {
+        /* The objects must hold the READ lock for the shm checking */
+        for (i = 0; i < num_uobjs; i++) {
+            if (uobjs[i].session_obj)
+                continue;
+
+            uobjs[i].rc = object_lock(uobjs[i].obj, READ_LOCK);
+            uobjs[i].locked = (uobjs[i].rc == CKR_OK);
+        }
+
+        rc = XProcLock(tokdata);
+        if (rc != CKR_OK) {
+            TRACE_ERROR("Failed to get Process Lock.\n");
+            goto done;
+        }
+
+        for (i = 0; i < num_uobjs; i++) {
+            if (!uobjs[i].locked)
+                continue;
+
+            uobjs[i].rc = object_mgr_get_shm_entry_for_obj(tokdata,
+                                                           uobjs[i].obj,
+                                                           &entry);
+            if (uobjs[i].rc != CKR_OK)
+                continue;
+
+            uobjs[i].stale = (uobjs[i].obj->count_hi != entry->count_hi ||
+                              uobjs[i].obj->count_lo != entry->count_lo);
+        }
+
+        rc = XProcUnLock(tokdata);
+        if (rc != CKR_OK) {
+            TRACE_ERROR("Failed to release Process Lock.\n");
+            goto done;
+        }
+
+        for (i = 0; i < num_uobjs; i++) {
+            if (uobjs[i].locked) {
+                object_unlock(uobjs[i].obj);
+                uobjs[i].locked = FALSE;
+            }
+        }
+
+        /* Reload the stale objects, one object locked at a time */
+        for (i = 0; i < num_uobjs; i++) {
+            if (!uobjs[i].stale || uobjs[i].rc != CKR_OK)
+                continue;
+
+            uobjs[i].rc = object_lock(uobjs[i].obj, READ_LOCK);
+            if (uobjs[i].rc != CKR_OK)
+                continue;
+
+            uobjs[i].rc = object_mgr_check_shm(tokdata, uobjs[i].obj,
+                                               READ_LOCK);
+            if (uobjs[i].rc != CKR_OK)
+                TRACE_DEVEL("object_mgr_check_shm failed.\n");
+
+            object_unlock(uobjs[i].obj);
+        }
+    }
+
+    for (i = 0; i < num_uobjs; i++) {
+        if (uobjs[i].rc != CKR_OK)
+            continue;
+
+        uobjs[i].rc = object_lock(uobjs[i].obj, READ_LOCK);
+        uobjs[i].locked = (uobjs[i].rc == CKR_OK);
+    }
+
+    for (i = 0; i < count; i++) {
+        if (objs[i] == NULL)
+            continue;
+
+        key.obj = objs[i];
+        uobj = bsearch(&key, uobjs, num_uobjs, sizeof(*uobjs),
+                       getattr_batch_obj_cmp);
+        if (uobj == NULL || uobj->rc != CKR_OK) {
+            results[i] = (uobj == NULL) ? CKR_FUNCTION_FAILED : uobj->rc;
+            continue;
+        }
+
+        if (token_specific.t_check_obj_access != NULL) {
+            results[i] = token_specific.t_check_obj_access(tokdata, objs[i],
+                                                           FALSE);
+            if (results[i] != CKR_OK) {
+                TRACE_DEVEL("check_obj_access rejected access to object.\n");
+                continue;
+            }
+        }
+
+        if (object_is_private(objs[i]) &&
+            (sess->session_info.state == CKS_RO_PUBLIC_SESSION ||
+             sess->session_info.state == CKS_RW_PUBLIC_SESSION)) {
+            TRACE_ERROR("%s\n", ock_err(ERR_USER_NOT_LOGGED_IN));
+            results[i] = CKR_USER_NOT_LOGGED_IN;
+            continue;
+        }
+
+        results[i] = object_get_attribute_values(objs[i], templates[i],
+                                                 attr_counts[i]);
+        if (results[i] != CKR_OK)
+            TRACE_DEVEL("object_get_attribute_values failed.\n");
+    }
+
+    rc = CKR_OK;
+
+done:
+    if (uobjs != NULL) {
+        for (i = 0; i < num_uobjs; i++) {
+            if (uobjs[i].locked)
+                object_unlock(uobjs[i].obj);
+        }
+        free(uobjs);
+    }
+    if (objs != NULL) {
+        for (i = 0; i < count; i++) {
+            if (objs[i] != NULL)
+                object_put(tokdata, objs[i], FALSE);
+        }
+        free(objs);
+    }
+
+    return rc;
+}
+
 //
 //
 CK_RV object_mgr_get_object_size(STDLL_TokData_t *tokdata,
@@ -1483,6 +1711,20 @@ CK_RV object_mgr_restore_obj(STDLL_TokData_t *tokdata, CK_BYTE *data,
 CK_RV object_mgr_restore_obj_withSize(STDLL_TokData_t *tokdata, CK_BYTE *data,
                                       OBJECT *oldObj, int data_size,
                                       const char *fname)
+{
+    return object_mgr_restore_obj_withIndex(tokdata, data, oldObj, data_size,
+                                            fname, NULL);
+}
+
+//
+// Same as object_mgr_restore_obj_withSize, but if the caller already knows
+// the index of the object's entry in the shared memory segment, it is used
+// instead of searching all entries for the object.
+//
+CK_RV object_mgr_restore_obj_withIndex(STDLL_TokData_t *tokdata,
+                                       CK_BYTE *data, OBJECT *oldObj,
+                                       int data_size, const char *fname,
+                                       const CK_ULONG *shm_index)
 {
     OBJECT *obj = NULL;
     CK_BBOOL priv;
@@ -1504,6 +1746,10 @@ CK_RV object_mgr_restore_obj_withSize(STDLL_TokData_t *tokdata, CK_BYTE *data,
         return rc;
     }
 
+    /* object_mgr_search_shm_for_obj() checks this index first */
+    if (shm_index != NULL)
+        obj->index = *shm_index;
+
     rc = XProcLock(tokdata);
     if (rc != CKR_OK) {
         TRACE_ERROR("Failed to get Process Lock.\n");
@@ -1587,28 +1833,20 @@ unlock:
 /**
  * Save the token object to disk and update the shared memory segment.
  */
-CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
+/*
+ * Finds the shared memory entry of a token object.
+ * Note: The token lock (XProcLock) must be held when calling this function.
+ */
+static CK_RV object_mgr_find_shm_entry(STDLL_TokData_t *tokdata, OBJECT *obj,
+                                       TOK_OBJ_ENTRY **entry)
 {
-    TOK_OBJ_ENTRY *entry = NULL;
     CK_ULONG index;
     CK_RV rc;
 
-    obj->count_lo++;
-    if (obj->count_lo == 0)
-        obj->count_hi++;
-
-    rc = XProcLock(tokdata);
-    if (rc != CKR_OK) {
-        TRACE_ERROR("Failed to get Process Lock.\n");
-        goto done;
-    }
-
     if (object_is_private(obj)) {
         if (tokdata->global_shm->num_priv_tok_obj == 0) {
             TRACE_DEVEL("%s\n", ock_err(ERR_OBJECT_HANDLE_INVALID));
-            rc = CKR_OBJECT_HANDLE_INVALID;
-            XProcUnLock(tokdata);
-            goto done;
+            return CKR_OBJECT_HANDLE_INVALID;
         }
         rc = object_mgr_search_shm_for_obj(tokdata->global_shm->
                                            priv_tok_objs, 0,
@@ -1618,17 +1856,14 @@ CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
 
         if (rc != CKR_OK) {
             TRACE_DEVEL("object_mgr_search_shm_for_obj failed.\n");
-            XProcUnLock(tokdata);
-            goto done;
+            return rc;
         }
 
-        entry = &tokdata->global_shm->priv_tok_objs[index];
+        *entry = &tokdata->global_shm->priv_tok_objs[index];
     } else {
         if (tokdata->global_shm->num_publ_tok_obj == 0) {
             TRACE_DEVEL("%s\n", ock_err(ERR_OBJECT_HANDLE_INVALID));
-            rc = CKR_OBJECT_HANDLE_INVALID;
-            XProcUnLock(tokdata);
-            goto done;
+            return CKR_OBJECT_HANDLE_INVALID;
         }
         rc = object_mgr_search_shm_for_obj(tokdata->global_shm->
                                            publ_tok_objs, 0,
@@ -1637,11 +1872,34 @@ CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
                                            &index);
         if (rc != CKR_OK) {
             TRACE_DEVEL("object_mgr_search_shm_for_obj failed.\n");
-            XProcUnLock(tokdata);
-            goto done;
+            return rc;
         }
 
-        entry = &tokdata->global_shm->publ_tok_objs[index];
+        *entry = &tokdata->global_shm->publ_tok_objs[index];
+    }
+
+    return CKR_OK;
+}
+
+CK_RV object_mgr_save_token_object(STDLL_TokData_t *tokdata, OBJECT *obj)
+{
+    TOK_OBJ_ENTRY *entry = NULL;
+    CK_RV rc;
+
+    obj->count_lo++;
+    if (obj->count_lo == 0)
+        obj->count_hi++;
+
+    rc = XProcLock(tokdata);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Failed to get Process Lock.\n");
+        goto done;
+    }
+
+    rc = object_mgr_find_shm_entry(tokdata, obj, &entry);
+    if (rc != CKR_OK) {
+        XProcUnLock(tokdata);
+        goto done;
     }
 
     rc = save_token_object(tokdata, obj);
@@ -1664,6 +1922,61 @@ done:
     return rc;
 }
 
+/*
+ * Saves multiple existing token objects under a single token lock. Unlike
+ * object_mgr_save_token_object(), the object index file is not scanned and
+ * updated, the objects must already be listed in it.
+ * The objects must hold the WRITE lock when this function is called!
+ */
+CK_RV object_mgr_save_token_objects(STDLL_TokData_t *tokdata, OBJECT **objs,
+                                    CK_ULONG num_objs)
+{
+    TOK_OBJ_ENTRY *entry = NULL;
+    CK_ULONG i;
+    CK_RV rc;
+
+    rc = XProcLock(tokdata);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Failed to get Process Lock.\n");
+        return rc;
+    }
+
+    for (i = 0; i < num_objs; i++) {
+        rc = object_mgr_find_shm_entry(tokdata, objs[i], &entry);
+        if (rc == CKR_OBJECT_HANDLE_INVALID) {
+            /* Object was deleted by another process */
+            rc = CKR_OK;
+            continue;
+        }
+        if (rc != CKR_OK)
+            break;
+
+        objs[i]->count_lo++;
+        if (objs[i]->count_lo == 0)
+            objs[i]->count_hi++;
+
+        if (object_is_private(objs[i]))
+            rc = save_private_token_object(tokdata, objs[i]);
+        else
+            rc = save_public_token_object(tokdata, objs[i]);
+        if (rc != CKR_OK) {
+            TRACE_ERROR("Failed to save token object, rc=0x%lx.\n", rc);
+            break;
+        }
+
+        entry->count_lo = objs[i]->count_lo;
+        entry->count_hi = objs[i]->count_hi;
+    }
+
+    if (XProcUnLock(tokdata) != CKR_OK) {
+        TRACE_ERROR("Failed to release Process Lock.\n");
+        if (rc == CKR_OK)
+            rc = CKR_CANT_LOCK;
+    }
+
+    return rc;
+}
+
 //
 //
 CK_RV object_mgr_set_attribute_values(STDLL_TokData_t *tokdata,
@@ -1712,6 +2025,12 @@ CK_RV object_mgr_set_attribute_values(STDLL_TokData_t *tokdata,
         TRACE_DEVEL("object_set_attribute_values failed.\n");
         goto done;
     }
+
+    /* Attributes the ex_data was derived from may have changed */
+    rc = object_ex_data_reload(obj);
+    if (rc != CKR_OK)
+        goto done;
+
     // okay.  the object has been updated.  if it's a session object,
     // we're finished.  if it's a token object, we need to update
     // non-volatile storage.
@@ -1997,20 +2316,7 @@ retry:
     if (rc != CKR_OK)
         goto done;
 
-    rc = object_ex_data_lock(obj, WRITE_LOCK);
-    if (rc != CKR_OK)
-        goto done;
-
-    if (obj->ex_data != NULL && obj->ex_data_reload != NULL) {
-        rc = obj->ex_data_reload(obj, obj->ex_data, obj->ex_data_len);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("ex_data_reload failed 0x%lx\n", rc);
-            object_ex_data_unlock(obj);
-            goto done;
-        }
-    }
-
-    rc = object_ex_data_unlock(obj);
+    rc = object_ex_data_reload(obj);
     if (rc != CKR_OK)
         goto done;
 
@@ -2344,23 +2650,107 @@ void dump_shm(LW_SHM_TYPE *global_shm, const char *s)
 }
 #endif
 
+#define OBJ_MGR_REENC_WORKERS           8
+#define OBJ_MGR_REENC_BATCH             32
+#define OBJ_MGR_REENC_PROGRESS_SECS     10
+
+struct reenc_key_object {
+    struct btree *tree;
+    unsigned long node;
+};
+
+struct reenc_objects_data {
+    STDLL_TokData_t *tokdata;
+    CK_BBOOL (*filter)(STDLL_TokData_t *tokdata, OBJECT *obj, void *private);
+    CK_RV (*reenc)(STDLL_TokData_t *tokdata, OBJECT *obj, CK_BYTE *sec_key,
+                   CK_BYTE *reenc_sec_key, CK_ULONG sec_key_len,
+                   void *private);
+    CK_BBOOL (*is_blob_new_mk)(STDLL_TokData_t *tokdata, OBJECT *obj,
+                               CK_BYTE *sec_key, CK_ULONG sec_key_len,
+                               void *private);
+    void (*progress)(STDLL_TokData_t *tokdata, unsigned long done,
+                     unsigned long total, void *private);
+    void *private;
+    struct btree *tree; /* tree currently collected from */
+    struct reenc_key_object *objs;
+    unsigned long num_objs;
+    unsigned long max_objs;
+    volatile unsigned long next;
+    volatile CK_RV error;
+    pthread_mutex_t mutex; /* protects the following fields */
+    unsigned long done;
+    unsigned long skipped;
+    time_t start;
+    time_t last_report;
+};
+
+static void obj_mgr_reencipher_collect_cb(STDLL_TokData_t *tokdata, void *p1,
+                                          unsigned long p2, void *p3)
+{
+    struct reenc_objects_data *rod = p3;
+    struct reenc_key_object *tmp;
+    OBJECT *obj = p1;
+    CK_OBJECT_CLASS class;
+    CK_ATTRIBUTE *attr;
+    CK_BBOOL match;
+
+    if (rod->error != CKR_OK)
+        return;
+
+    if (object_lock(obj, READ_LOCK) != CKR_OK) {
+        OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to get the object lock\n",
+                   tokdata->slot_id);
+        rod->error = CKR_CANT_LOCK;
+        return;
+    }
+
+    match = template_attribute_get_ulong(obj->template, CKA_CLASS,
+                                         &class) == CKR_OK &&
+            (class == CKO_PUBLIC_KEY || class == CKO_PRIVATE_KEY ||
+             class == CKO_SECRET_KEY) &&
+            template_attribute_find(obj->template, CKA_IBM_OPAQUE, &attr) &&
+            (rod->filter == NULL || rod->filter(tokdata, obj, rod->private));
+
+    object_unlock(obj);
+
+    if (!match)
+        return;
+
+    if (rod->num_objs >= rod->max_objs) {
+        tmp = realloc(rod->objs, (rod->max_objs + 1024) * sizeof(*tmp));
+        if (tmp == NULL) {
+            TRACE_ERROR("%s Memory allocation failed\n", __func__);
+            rod->error = CKR_HOST_MEMORY;
+            return;
+        }
+        rod->objs = tmp;
+        rod->max_objs += 1024;
+    }
+
+    rod->objs[rod->num_objs].tree = rod->tree;
+    rod->objs[rod->num_objs].node = p2;
+    rod->num_objs++;
+}
+
 /*
- * Re-enciphers a key that has a secure key in attribute CKA_IBM_OPAQUE by
- * calling the reenc callback function.
- * Returns CKR_ATTRIBUTE_TYPE_INVALID if the key does not contain a secure key.
+ * Re-enciphers the secure key in attribute CKA_IBM_OPAQUE of a key object
+ * into attribute CKA_IBM_OPAQUE_REENC. A key that already has a secure key
+ * enciphered with the new master key in CKA_IBM_OPAQUE_REENC (i.e. from a
+ * previous, interrupted run) is skipped. *changed is set to TRUE if the
+ * object has been updated and must be saved.
  * The object must hold the WRITE lock when this function is called!
  */
-CK_RV obj_mgr_reencipher_secure_key(STDLL_TokData_t *tokdata, OBJECT *obj,
-                                    CK_RV (*reenc)(CK_BYTE *sec_key,
-                                                   CK_BYTE *reenc_sec_key,
-                                                   CK_ULONG sec_key_len,
-                                                   void *private),
-                                    void *private)
+static CK_RV obj_mgr_reencipher_secure_key(struct reenc_objects_data *rod,
+                                           OBJECT *obj, CK_BBOOL *changed)
 {
+    STDLL_TokData_t *tokdata = rod->tokdata;
     CK_ATTRIBUTE *opaque_attr = NULL, *reenc_attr = NULL;
+    CK_ULONG sec_key_len;
     CK_KEY_TYPE key_type;
     CK_RV rc;
 
+    *changed = FALSE;
+
     /* Update token object from SHM, if needed */
     if (object_is_token_object(obj)) {
         rc = object_mgr_check_shm(tokdata, obj, WRITE_LOCK);
@@ -2381,55 +2771,402 @@ CK_RV obj_mgr_reencipher_secure_key(STDLL_TokData_t *tokdata, OBJECT *obj,
         goto out;
     }
 
+    /* AES-XTS has 2 secure keys concatenated to each other */
+    sec_key_len = key_type == CKK_AES_XTS ? opaque_attr->ulValueLen / 2 :
+                                            opaque_attr->ulValueLen;
+
+    if (rod->is_blob_new_mk != NULL &&
+        template_attribute_find(obj->template, CKA_IBM_OPAQUE_REENC,
+                                &reenc_attr) &&
+        reenc_attr->ulValueLen == opaque_attr->ulValueLen &&
+        rod->is_blob_new_mk(tokdata, obj, reenc_attr->pValue, sec_key_len,
+                            rod->private)) {
+        TRACE_DEVEL("%s secure key is already re-enciphered\n", __func__);
+        rc = CKR_OK;
+        goto out;
+    }
+    reenc_attr = NULL;
+
     rc = build_attribute(CKA_IBM_OPAQUE_REENC, opaque_attr->pValue,
                          opaque_attr->ulValueLen, &reenc_attr);
     if (rc != CKR_OK)
         goto out;
 
+    rc = rod->reenc(tokdata, obj, opaque_attr->pValue, reenc_attr->pValue,
+                    sec_key_len, rod->private);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("Reencipher callback has failed, rc=0x%lx.\n", rc);
+        goto out;
+    }
+
     if (key_type == CKK_AES_XTS) {
-        /*
-         * AES-XTS has 2 secure keys concatenated to each other.
-         * Re-encipher both keys separately.
-         */
-        rc = reenc(opaque_attr->pValue, reenc_attr->pValue,
-                   reenc_attr->ulValueLen / 2, private);
+        rc = rod->reenc(tokdata, obj,
+                        (CK_BYTE *)opaque_attr->pValue + sec_key_len,
+                        (CK_BYTE *)reenc_attr->pValue + sec_key_len,
+                        sec_key_len, rod->private);
         if (rc != CKR_OK) {
-            TRACE_ERROR("Reencipher callback has failed, rc=0x%lx.\n",rc);
+            TRACE_ERROR("Reencipher callback has failed, rc=0x%lx.\n", rc);
             goto out;
         }
+    }
+
+    rc = template_update_attribute(obj->template, reenc_attr);
+    if (rc != CKR_OK)
+        goto out;
+    reenc_attr = NULL;
+
+    *changed = TRUE;
+
+out:
+    if (reenc_attr != NULL)
+        free(reenc_attr);
+
+    return rc;
+}
+
+/*
+ * Accounts for processed key objects, logs the progress periodically, and
+ * reports the progress to the caller as checkpoint if requested.
+ */
+static void obj_mgr_reencipher_progress(struct reenc_objects_data *rod,
+                                        unsigned long done,
+                                        unsigned long skipped,
+                                        CK_BBOOL checkpoint)
+{
+    STDLL_TokData_t *tokdata = rod->tokdata;
+    unsigned long remaining;
+    time_t now;
+
+    if (pthread_mutex_lock(&rod->mutex) != 0)
+        return;
+
+    rod->done += done;
+    rod->skipped += skipped;
+
+    now = time(NULL);
+    if (now - rod->last_report >= OBJ_MGR_REENC_PROGRESS_SECS ||
+        rod->done == rod->num_objs) {
+        rod->last_report = now;
+
+        remaining = 0;
+        if (rod->done > rod->skipped)
+            remaining = (unsigned long)(now - rod->start) *
+                            (rod->num_objs - rod->done) /
+                            (rod->done - rod->skipped);
+
+        TRACE_INFO("%s %lu of %lu key objects processed (%lu already "
+                   "re-enciphered), about %lu seconds remaining\n", __func__,
+                   rod->done, rod->num_objs, rod->skipped, remaining);
+        OCK_SYSLOG(LOG_INFO, "Slot %lu: Re-enciphered %lu of %lu key objects "
+                   "(%lu already re-enciphered), about %lu seconds "
+                   "remaining\n", tokdata->slot_id, rod->done, rod->num_objs,
+                   rod->skipped, remaining);
+    }
+
+    if (checkpoint && rod->progress != NULL)
+        rod->progress(tokdata, rod->done, rod->num_objs, rod->private);
+
+    pthread_mutex_unlock(&rod->mutex);
+}
+
+/*
+ * Saves a batch of re-enciphered token objects and releases them. The
+ * objects are locked before the token lock is taken (as done by all other
+ * code paths), and are counted as processed only once they are saved.
+ * Another process may have changed an object after it has been re-enciphered
+ * and unlocked. Thus each object is updated from the shared memory and
+ * re-enciphered again, if needed, while it holds the WRITE lock for the save.
+ */
+static CK_RV obj_mgr_reencipher_save_batch(struct reenc_objects_data *rod,
+                                           struct reenc_key_object *keys,
+                                           OBJECT **objs, CK_ULONG num_objs)
+{
+    STDLL_TokData_t *tokdata = rod->tokdata;
+    OBJECT *save_objs[OBJ_MGR_REENC_BATCH];
+    CK_ULONG i, locked = 0, num_save = 0;
+    CK_BBOOL changed;
+    CK_RV rc = CKR_OK;
+
+    if (num_objs == 0)
+        return CKR_OK;
+
+    for (i = 0; i < num_objs; i++) {
+        rc = object_lock(objs[i], WRITE_LOCK);
+        if (rc != CKR_OK) {
+            OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to get the object lock\n",
+                       tokdata->slot_id);
+            break;
+        }
+        locked++;
+
+        rc = obj_mgr_reencipher_secure_key(rod, objs[i], &changed);
+        /* Obj was deleted by other proc */
+        if (rc == CKR_OBJECT_HANDLE_INVALID) {
+            rc = CKR_OK;
+            continue;
+        }
+        if (rc != CKR_OK) {
+            TRACE_ERROR("%s failed to re-encipher token object %s: "
+                        "0x%lx\n", __func__, objs[i]->name, rc);
+            OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to re-encipher token "
+                       "object '%s': 0x%lx\n", tokdata->slot_id,
+                       objs[i]->name, rc);
+            break;
+        }
+
+        save_objs[num_save++] = objs[i];
+    }
+
+    if (rc == CKR_OK && num_save > 0) {
+        rc = object_mgr_save_token_objects(tokdata, save_objs, num_save);
+        if (rc != CKR_OK) {
+            TRACE_ERROR("Failed to save token objects, rc=%lx.\n", rc);
+            OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to save re-enciphered "
+                       "token objects: 0x%lx\n", tokdata->slot_id, rc);
+        }
+    }
+
+    for (i = 0; i < num_objs; i++) {
+        if (i < locked)
+            object_unlock(objs[i]);
+        bt_put_node_value(keys[i].tree, objs[i]);
+    }
+
+    if (rc == CKR_OK)
+        obj_mgr_reencipher_progress(rod, num_objs, 0, TRUE);
+
+    return rc;
+}
+
+static void *obj_mgr_reencipher_worker(void *arg)
+{
+    struct reenc_objects_data *rod = arg;
+    STDLL_TokData_t *tokdata = rod->tokdata;
+    struct reenc_key_object keys[OBJ_MGR_REENC_BATCH];
+    OBJECT *objs[OBJ_MGR_REENC_BATCH];
+    CK_ULONG num = 0;
+    struct reenc_key_object *key;
+    unsigned long idx;
+    CK_BBOOL changed;
+    OBJECT *obj;
+    CK_RV rc;
+
+    while (rod->error == CKR_OK) {
+        idx = __sync_fetch_and_add(&rod->next, 1);
+        if (idx >= rod->num_objs)
+            break;
+
+        key = &rod->objs[idx];
+        obj = bt_get_node_value(key->tree, key->node);
+        if (obj == NULL) {
+            /* Object was destroyed in the meantime */
+            obj_mgr_reencipher_progress(rod, 1, 0, FALSE);
+            continue;
+        }
+
+        rc = object_lock(obj, WRITE_LOCK);
+        if (rc != CKR_OK) {
+            OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to get the object lock\n",
+                       tokdata->slot_id);
+            bt_put_node_value(key->tree, obj);
+            __sync_bool_compare_and_swap(&rod->error, CKR_OK, rc);
+            break;
+        }
+
+        if (obj->session != NULL)
+            TRACE_INFO("%s re-encipher session object 0x%lx of session "
+                       "0x%lx\n", __func__, key->node, obj->session->handle);
+        else
+            TRACE_INFO("%s re-encipher token object %s\n", __func__,
+                       obj->name);
+
+        rc = obj_mgr_reencipher_secure_key(rod, obj, &changed);
+        if (rc == CKR_OBJECT_HANDLE_INVALID) /* Obj was deleted by other proc */
+            rc = CKR_OK;
+        if (rc != CKR_OK) {
+            if (obj->session != NULL) {
+                TRACE_ERROR("%s failed to re-encipher session object: "
+                            "0x%lx\n", __func__, rc);
+                OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to re-encipher session "
+                           "object 0x%lx of session 0x%lx: 0x%lx\n",
+                           tokdata->slot_id, key->node,
+                           obj->session->handle, rc);
+            } else {
+                TRACE_ERROR("%s failed to re-encipher token object %s: "
+                            "0x%lx\n", __func__, obj->name, rc);
+                OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to re-encipher token "
+                           "object '%s': 0x%lx\n", tokdata->slot_id,
+                           obj->name, rc);
+            }
+        }
+
+        object_unlock(obj);
 
-        rc = reenc((CK_BYTE *)opaque_attr->pValue + reenc_attr->ulValueLen / 2,
-                   reenc_attr->pValue, reenc_attr->ulValueLen / 2,
-                   private);
         if (rc != CKR_OK) {
-            TRACE_ERROR("Reencipher callback has failed, rc=0x%lx.\n",rc);
+            bt_put_node_value(key->tree, obj);
+            __sync_bool_compare_and_swap(&rod->error, CKR_OK, rc);
+            break;
+        }
+
+        if (!changed || object_is_session_object(obj)) {
+            bt_put_node_value(key->tree, obj);
+            obj_mgr_reencipher_progress(rod, 1, changed ? 0 : 1, FALSE);
+            continue;
+        }
+
+        keys[num] = *key;
+        objs[num] = obj;
+        num++;
+        if (num < OBJ_MGR_REENC_BATCH)
+            continue;
+
+        rc = obj_mgr_reencipher_save_batch(rod, keys, objs, num);
+        num = 0;
+        if (rc != CKR_OK) {
+            __sync_bool_compare_and_swap(&rod->error, CKR_OK, rc);
+            break;
+        }
+    }
+
+    /* Save what has been re-enciphered, also on errors for a later resume */
+    rc = obj_mgr_reencipher_save_batch(rod, keys, objs, num);
+    if (rc != CKR_OK)
+        __sync_bool_compare_and_swap(&rod->error, CKR_OK, rc);
+
+    return NULL;
+}
+
+/*
+ * Re-enciphers the secure keys of all key objects (that pass the filter) by
+ * calling the reenc callback function. The re-enciphered secure key is stored
+ * in attribute CKA_IBM_OPAQUE_REENC.
+ *
+ * The key objects are processed by up to num_workers threads in parallel
+ * (OBJ_MGR_REENC_WORKERS if 0), so the reenc callback must be thread-safe.
+ * Re-enciphered token objects are saved in batches under a single token
+ * lock. Keys that already have a secure key enciphered with the new master
+ * key in CKA_IBM_OPAQUE_REENC (as determined by the optional is_blob_new_mk
+ * callback) are skipped, so that an interrupted re-encipherment can be
+ * resumed. The optional progress callback is called after each saved batch
+ * of token objects, with the number of processed and total key objects.
+ */
+CK_RV obj_mgr_reencipher_key_objects(STDLL_TokData_t *tokdata,
+                                     CK_BBOOL session_objects,
+                                     CK_BBOOL token_objects,
+                                     CK_BBOOL (*filter)(STDLL_TokData_t *tokdata,
+                                                        OBJECT *obj,
+                                                        void *private),
+                                     CK_RV (*reenc)(STDLL_TokData_t *tokdata,
+                                                    OBJECT *obj,
+                                                    CK_BYTE *sec_key,
+                                                    CK_BYTE *reenc_sec_key,
+                                                    CK_ULONG sec_key_len,
+                                                    void *private),
+                                     CK_BBOOL (*is_blob_new_mk)(
+                                                    STDLL_TokData_t *tokdata,
+                                                    OBJECT *obj,
+                                                    CK_BYTE *sec_key,
+                                                    CK_ULONG sec_key_len,
+                                                    void *private),
+                                     void (*progress)(STDLL_TokData_t *tokdata,
+                                                      unsigned long done,
+                                                      unsigned long total,
+                                                      void *private),
+                                     void *private, unsigned int num_workers)
+{
+    struct reenc_objects_data rod;
+    pthread_t threads[OBJ_MGR_REENC_WORKERS];
+    unsigned int i, num_threads = 0;
+    CK_RV rc;
+
+    memset(&rod, 0, sizeof(rod));
+    rod.tokdata = tokdata;
+    rod.filter = filter;
+    rod.reenc = reenc;
+    rod.is_blob_new_mk = is_blob_new_mk;
+    rod.progress = progress;
+    rod.private = private;
+    rod.error = CKR_OK;
+
+    if (pthread_mutex_init(&rod.mutex, NULL) != 0) {
+        TRACE_ERROR("Initializing the re-encipher lock failed.\n");
+        return CKR_CANT_LOCK;
+    }
+
+    if (session_objects) {
+        rod.tree = &tokdata->sess_obj_btree;
+        bt_for_each_node(tokdata, rod.tree, obj_mgr_reencipher_collect_cb,
+                         &rod);
+    }
+
+    if (token_objects) {
+        rc = XProcLock(tokdata);
+        if (rc != CKR_OK) {
+            TRACE_ERROR("Failed to get Process Lock.\n");
+            OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to get Process Lock\n",
+                       tokdata->slot_id);
             goto out;
         }
-    } else {
-        rc = reenc(opaque_attr->pValue, reenc_attr->pValue, reenc_attr->ulValueLen,
-                   private);
+
+        object_mgr_update_from_shm(tokdata);
+
+        rc = XProcUnLock(tokdata);
         if (rc != CKR_OK) {
-            TRACE_ERROR("Reencipher callback has failed, rc=0x%lx.\n",rc);
+            TRACE_ERROR("Failed to release Process Lock.\n");
+            OCK_SYSLOG(LOG_ERR, "Slot %lu: Failed to release Process Lock\n",
+                       tokdata->slot_id);
             goto out;
         }
+
+        rod.tree = &tokdata->publ_token_obj_btree;
+        bt_for_each_node(tokdata, rod.tree, obj_mgr_reencipher_collect_cb,
+                         &rod);
+        rod.tree = &tokdata->priv_token_obj_btree;
+        bt_for_each_node(tokdata, rod.tree, obj_mgr_reencipher_collect_cb,
+                         &rod);
     }
 
-    rc = template_update_attribute(obj->template, reenc_attr);
+    rc = rod.error;
     if (rc != CKR_OK)
         goto out;
-    reenc_attr = NULL;
 
-    if (!object_is_session_object(obj)) {
-        rc = object_mgr_save_token_object(tokdata, obj);
-        if (rc != CKR_OK) {
-            TRACE_ERROR("Failed to save token object, rc=%lx.\n",rc);
-            goto out;
+    TRACE_INFO("%s re-encipher %lu key objects\n", __func__, rod.num_objs);
+    if (rod.num_objs == 0)
+        goto out;
+
+    OCK_SYSLOG(LOG_INFO, "Slot %lu: Re-enciphering %lu key objects\n",
+               tokdata->slot_id, rod.num_objs);
+
+    rod.start = time(NULL);
+    rod.last_report = rod.start;
+    if (progress != NULL)
+        progress(tokdata, 0, rod.num_objs, private);
+
+    if (num_workers == 0 || num_workers > OBJ_MGR_REENC_WORKERS)
+        num_workers = OBJ_MGR_REENC_WORKERS;
+    if (num_workers > rod.num_objs)
+        num_workers = rod.num_objs;
+
+    /* The calling thread is one of the workers */
+    for (i = 1; i < num_workers; i++) {
+        if (pthread_create(&threads[num_threads], NULL,
+                           obj_mgr_reencipher_worker, &rod) != 0) {
+            TRACE_DEVEL("Failed to create re-encipher worker thread\n");
+            break;
         }
+        num_threads++;
     }
 
+    obj_mgr_reencipher_worker(&rod);
+
+    for (i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    rc = rod.error;
+
 out:
-    if (reenc_attr != NULL)
-        free(reenc_attr);
+    free(rod.objs);
+    pthread_mutex_destroy(&rod.mutex);
 
     return rc;
 }
@@ -2523,6 +3260,11 @@ CK_RV obj_mgr_reencipher_secure_key_finalize(STDLL_TokData_t *tokdata,
         goto out;
     new_opaque_attr = NULL;
 
+    /* The ex_data may have been derived from the old secure key */
+    rc = object_ex_data_reload(obj);
+    if (rc != CKR_OK)
+        goto out;
+
 remove:
     rc = template_remove_attribute(obj->template, CKA_IBM_OPAQUE_REENC);
     if (rc == CKR_ATTRIBUTE_TYPE_INVALID)
@@ -1039,3 +1039,27 @@ CK_RV object_ex_data_unlock(OBJECT *obj)
 
     return CKR_OK;
 }
+
+/*
+ * Lets the token drop or rebuild the ex_data attached to the object, because
+ * the object's attributes have changed. The caller must hold the object's
+ * WRITE lock.
+ */
+CK_RV object_ex_data_reload(OBJECT *obj)
+{
+    CK_RV rc, rc2;
+
+    rc = object_ex_data_lock(obj, WRITE_LOCK);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (obj->ex_data != NULL && obj->ex_data_reload != NULL) {
+        rc = obj->ex_data_reload(obj, obj->ex_data, obj->ex_data_len);
+        if (rc != CKR_OK)
+            TRACE_ERROR("ex_data_reload failed 0x%lx\n", rc);
+    }
+
+    rc2 = object_ex_data_unlock(obj);
+
+    return rc != CKR_OK ? rc : rc2;
+}
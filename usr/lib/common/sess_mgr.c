@@ -15,6 +15,12 @@
 #include <stdlib.h>
 #include <string.h>             // for memcmp() et al
 #include <pthread.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <openssl/crypto.h>
 
 #include "pkcs11types.h"
 #include "local_types.h"
@@ -73,6 +79,181 @@ void session_mgr_put(STDLL_TokData_t *tokdata, SESSION *session)
     bt_put_node_value(&tokdata->sess_btree, session);
 }
 
+/*
+ * With OPENCRYPTOKI_OP_CONTEXT_ARENA=0 the operation contexts are malloc'ed
+ * per operation instead, e.g. for memory checkers. With
+ * OPENCRYPTOKI_OP_CONTEXT_ARENA=mlock the arena is locked into memory, so
+ * that key-derived state in the contexts is never swapped out. If it can not
+ * be locked, e.g. due to RLIMIT_MEMLOCK, the session does not use an arena.
+ */
+#define OP_CONTEXT_ARENA_ENV    "OPENCRYPTOKI_OP_CONTEXT_ARENA"
+
+#define CTX_ARENA_ALL_CHUNKS \
+            ((uint32_t)((1ULL << SESS_CTX_ARENA_CHUNKS) - 1))
+
+static void ctx_arena_init(SESS_CTX_ARENA *arena)
+{
+    const char *env = secure_getenv(OP_CONTEXT_ARENA_ENV);
+
+    if (env == NULL)
+        return;
+
+    if (strcmp(env, "0") == 0)
+        arena->disabled = TRUE;
+    else if (strcmp(env, "mlock") == 0)
+        arena->mlock = TRUE;
+}
+
+static size_t ctx_arena_page_size(void)
+{
+    long page = sysconf(_SC_PAGESIZE);
+
+    return page > 0 ? (size_t)page : 4096;
+}
+
+static size_t ctx_arena_size(void)
+{
+    size_t len = SESS_CTX_ARENA_CHUNKS * SESS_CTX_ARENA_CHUNK_SIZE;
+    size_t page = ctx_arena_page_size();
+
+    return (len + page - 1) / page * page;
+}
+
+static void ctx_arena_release(CK_BYTE *base, CK_BBOOL locked)
+{
+    size_t len = ctx_arena_size();
+
+    OPENSSL_cleanse(base, len);
+    if (locked)
+        munlock(base, len);
+    free(base);
+}
+
+/*
+ * Returns the chunks of the arena, allocating them on first use. The arena is
+ * page aligned and has a size of whole pages, so that locking and unlocking
+ * it does not affect other allocations.
+ */
+static CK_BYTE *ctx_arena_base(SESS_CTX_ARENA *arena)
+{
+    CK_BYTE *base;
+    CK_BBOOL locked = FALSE;
+    size_t len;
+
+    if (arena->base != NULL)
+        return arena->base;
+
+    len = ctx_arena_size();
+    if (posix_memalign((void **)&base, ctx_arena_page_size(), len) != 0) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return NULL;
+    }
+    memset(base, 0, len);
+
+    if (arena->mlock) {
+        if (mlock(base, len) != 0) {
+            TRACE_ERROR("Failed to lock the operation context arena: %s\n",
+                        strerror(errno));
+            ctx_arena_release(base, FALSE);
+            arena->disabled = TRUE;
+            return NULL;
+        }
+        locked = TRUE;
+    }
+
+    /* Another thread may use the same session for another operation */
+    if (!__sync_bool_compare_and_swap(&arena->base, NULL, base)) {
+        ctx_arena_release(base, locked);
+        return arena->base;
+    }
+    arena->locked = locked;
+
+    return base;
+}
+
+// session_mgr_alloc_context()
+//
+// Returns a zeroed operation context of context_len bytes for the session.
+// It is carved from the session's arena, unless it is larger than a chunk or
+// all chunks are in use, e.g. by nested and dual-function operations. Then it
+// is malloc'ed. Free it with session_mgr_free_context().
+//
+CK_BYTE *session_mgr_alloc_context(SESSION *sess, CK_ULONG context_len)
+{
+    SESS_CTX_ARENA *arena;
+    CK_BYTE *base;
+    uint32_t used, prev;
+    unsigned int i;
+
+    if (sess == NULL || sess->ctx_arena.disabled ||
+        context_len > SESS_CTX_ARENA_CHUNK_SIZE)
+        return calloc(1, context_len);
+
+    arena = &sess->ctx_arena;
+    base = ctx_arena_base(arena);
+    if (base == NULL)
+        return calloc(1, context_len);
+
+    used = arena->used;
+    while ((used & CTX_ARENA_ALL_CHUNKS) != CTX_ARENA_ALL_CHUNKS) {
+        i = __builtin_ctz(~used);
+        prev = __sync_val_compare_and_swap(&arena->used, used,
+                                           used | (1U << i));
+        if (prev == used)
+            return base + i * SESS_CTX_ARENA_CHUNK_SIZE;
+        used = prev;
+    }
+
+    return calloc(1, context_len);
+}
+
+// session_mgr_free_context()
+//
+// Frees an operation context allocated with session_mgr_alloc_context(). A
+// chunk of the session's arena is zeroized before it can be reused.
+//
+void session_mgr_free_context(STDLL_TokData_t *tokdata, SESSION *sess,
+                              CK_BYTE *context, CK_ULONG context_len)
+{
+    uintptr_t base, ptr = (uintptr_t)context;
+    unsigned int i;
+
+    UNUSED(tokdata);
+    UNUSED(context_len);
+
+    if (context == NULL)
+        return;
+
+    base = sess != NULL ? (uintptr_t)sess->ctx_arena.base : 0;
+    if (base == 0 || ptr < base ||
+        ptr >= base + SESS_CTX_ARENA_CHUNKS * SESS_CTX_ARENA_CHUNK_SIZE) {
+        free(context);
+        return;
+    }
+
+    i = (ptr - base) / SESS_CTX_ARENA_CHUNK_SIZE;
+    OPENSSL_cleanse((CK_BYTE *)base + i * SESS_CTX_ARENA_CHUNK_SIZE,
+                    SESS_CTX_ARENA_CHUNK_SIZE);
+    __sync_fetch_and_and(&sess->ctx_arena.used, ~(1U << i));
+}
+
+// call_session_free()
+//
+// Delete function of the session btree. Releases the session's operation
+// context arena when the last reference to the session is gone.
+//
+void call_session_free(void *ptr)
+{
+    SESSION *sess = (SESSION *)ptr;
+
+    if (sess == NULL)
+        return;
+
+    if (sess->ctx_arena.base != NULL)
+        ctx_arena_release(sess->ctx_arena.base, sess->ctx_arena.locked);
+    free(sess);
+}
+
 // session_mgr_new()
 //
 // creates a new session structure and adds it to the process's list
@@ -100,6 +281,7 @@ CK_RV session_mgr_new(STDLL_TokData_t *tokdata, CK_ULONG flags,
     }
 
     memset(new_session, 0x0, sizeof(SESSION));
+    ctx_arena_init(&new_session->ctx_arena);
 
     // find an unused session handle. session handles will wrap automatically...
     //
@@ -303,7 +485,8 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
                                              sess->encr_ctx.context,
                                              sess->encr_ctx.context_len);
         else
-            free(sess->encr_ctx.context);
+            session_mgr_free_context(tokdata, sess, sess->encr_ctx.context,
+                                     sess->encr_ctx.context_len);
     }
 
     if (sess->encr_ctx.mech.pParameter)
@@ -315,7 +498,8 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
                                              sess->decr_ctx.context,
                                              sess->decr_ctx.context_len);
         else
-            free(sess->decr_ctx.context);
+            session_mgr_free_context(tokdata, sess, sess->decr_ctx.context,
+                                     sess->decr_ctx.context_len);
     }
 
     if (sess->decr_ctx.mech.pParameter)
@@ -327,7 +511,8 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
                                                sess->digest_ctx.context,
                                                sess->digest_ctx.context_len);
         else
-            free(sess->digest_ctx.context);
+            session_mgr_free_context(tokdata, sess, sess->digest_ctx.context,
+                                     sess->digest_ctx.context_len);
     }
 
     if (sess->digest_ctx.mech.pParameter)
@@ -339,7 +524,8 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
                                              sess->sign_ctx.context,
                                              sess->sign_ctx.context_len);
         else
-            free(sess->sign_ctx.context);
+            session_mgr_free_context(tokdata, sess, sess->sign_ctx.context,
+                                     sess->sign_ctx.context_len);
     }
 
     if (sess->sign_ctx.mech.pParameter)
@@ -351,7 +537,8 @@ CK_RV session_mgr_close_session(STDLL_TokData_t *tokdata,
                                                sess->verify_ctx.context,
                                                sess->verify_ctx.context_len);
         else
-            free(sess->verify_ctx.context);
+            session_mgr_free_context(tokdata, sess, sess->verify_ctx.context,
+                                     sess->verify_ctx.context_len);
     }
 
     if (sess->verify_ctx.mech.pParameter)
@@ -411,7 +598,8 @@ void session_free(STDLL_TokData_t *tokdata, void *node_value,
                                              sess->encr_ctx.context,
                                              sess->encr_ctx.context_len);
         else
-            free(sess->encr_ctx.context);
+            session_mgr_free_context(tokdata, sess, sess->encr_ctx.context,
+                                     sess->encr_ctx.context_len);
     }
 
     if (sess->encr_ctx.mech.pParameter)
@@ -423,7 +611,8 @@ void session_free(STDLL_TokData_t *tokdata, void *node_value,
                                              sess->decr_ctx.context,
                                              sess->decr_ctx.context_len);
         else
-            free(sess->decr_ctx.context);
+            session_mgr_free_context(tokdata, sess, sess->decr_ctx.context,
+                                     sess->decr_ctx.context_len);
     }
 
     if (sess->decr_ctx.mech.pParameter)
@@ -435,7 +624,8 @@ void session_free(STDLL_TokData_t *tokdata, void *node_value,
                                                sess->digest_ctx.context,
                                                sess->digest_ctx.context_len);
         else
-            free(sess->digest_ctx.context);
+            session_mgr_free_context(tokdata, sess, sess->digest_ctx.context,
+                                     sess->digest_ctx.context_len);
     }
 
     if (sess->digest_ctx.mech.pParameter)
@@ -447,7 +637,8 @@ void session_free(STDLL_TokData_t *tokdata, void *node_value,
                                              sess->sign_ctx.context,
                                              sess->sign_ctx.context_len);
         else
-            free(sess->sign_ctx.context);
+            session_mgr_free_context(tokdata, sess, sess->sign_ctx.context,
+                                     sess->sign_ctx.context_len);
     }
 
     if (sess->sign_ctx.mech.pParameter)
@@ -459,7 +650,8 @@ void session_free(STDLL_TokData_t *tokdata, void *node_value,
                                                sess->verify_ctx.context,
                                                sess->verify_ctx.context_len);
         else
-            free(sess->verify_ctx.context);
+            session_mgr_free_context(tokdata, sess, sess->verify_ctx.context,
+                                     sess->verify_ctx.context_len);
     }
 
     if (sess->verify_ctx.mech.pParameter)
@@ -470,3 +470,135 @@ int sm_get_count(void *addr)
 
     return ctx->ref;
 }
+
+/*
+ * Map an existing shared memory region identified by `sm_name` read-only,
+ * without changing its reference count. The length of the region is returned
+ * in `p_len`. Returns -ENOENT if the shared memory does not exist.
+ *
+ * The same gid/mode checks as in sm_open are performed, so that a region not
+ * created via sm_open with the same `mode` and `group` is never used.
+ */
+int sm_open_readonly(const char *sm_name, int mode, void **p_addr,
+                     size_t *p_len, const char *group)
+{
+    int rc;
+    int fd = -1;
+    void *addr = MAP_FAILED;
+    struct stat stat_buf;
+    char *name = NULL;
+    struct shm_context *ctx;
+    struct group *grp;
+
+    if ((name = convert_path_to_shm_name(sm_name)) == NULL) {
+        rc = -EINVAL;
+        goto done;
+    }
+
+    if (group == NULL || group[0] == '\0')
+        group = PKCS_GROUP;
+
+    grp = getgrnam(group);
+    if (!grp) {
+        rc = -errno;
+        SYS_ERROR(errno, "getgrname(\"%s\"): %s\n", group,
+                  strerror(errno));
+        goto done;
+    }
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        rc = -errno;
+        TRACE_DEVEL("Shared memory \"%s\" can not be opened: %s\n", name,
+                    strerror(errno));
+        goto done;
+    }
+
+    if (fstat(fd, &stat_buf)) {
+        rc = -errno;
+        SYS_ERROR(errno, "Cannot stat \"%s\".\n", name);
+        goto done;
+    }
+
+    if (stat_buf.st_gid != grp->gr_gid ||
+        (stat_buf.st_mode & ~S_IFMT) != (unsigned int)mode) {
+        TRACE_ERROR("SHM segment '%s' has wrong gid/mode combination "
+                    "(expected: %u/0%o; got: %u/0%o)\n",
+                    name, grp->gr_gid, mode, stat_buf.st_gid, stat_buf.st_mode);
+        rc = -EINVAL;
+        goto done;
+    }
+
+    if ((size_t)stat_buf.st_size <= sizeof(*ctx)) {
+        TRACE_DEVEL("Shared memory \"%s\" is empty.\n", name);
+        rc = -EINVAL;
+        goto done;
+    }
+
+    addr = mmap(NULL, stat_buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        rc = -errno;
+        SYS_ERROR(errno, "Failed to map \"%s\" to memory.\n", name);
+        goto done;
+    }
+
+    ctx = addr;
+    if (ctx->data_len < 0 ||
+        sizeof(*ctx) + ctx->data_len != (size_t)stat_buf.st_size) {
+        TRACE_ERROR("Error: shared memory \"%s\" has an invalid length.\n",
+                    name);
+        munmap(addr, stat_buf.st_size);
+        rc = -EINVAL;
+        goto done;
+    }
+
+    *p_addr = ctx->data;
+    *p_len = ctx->data_len;
+    rc = 0;
+
+done:
+    if (fd >= 0)
+        close(fd);
+    if (name)
+        free(name);
+
+    return rc;
+}
+
+/*
+ * Unmap a shared memory region mapped by sm_open_readonly.
+ */
+int sm_close_readonly(void *addr)
+{
+    int rc;
+    struct shm_context *ctx = get_shm_context(addr);
+
+    if (munmap(ctx, sizeof(*ctx) + ctx->data_len)) {
+        rc = -errno;
+        SYS_ERROR(errno, "Failed to unmap %p.\n", (void *)ctx);
+        return rc;
+    }
+
+    return 0;
+}
+
+/*
+ * Destroy the shared memory region identified by `sm_name`, if it exists.
+ */
+int sm_unlink(const char *sm_name)
+{
+    char *name;
+    int rc = 0;
+
+    if ((name = convert_path_to_shm_name(sm_name)) == NULL)
+        return -EINVAL;
+
+    if (shm_unlink(name) != 0 && errno != ENOENT) {
+        rc = -errno;
+        SYS_ERROR(errno, "Failed to delete shared memory \"%s\".\n", name);
+    }
+
+    free(name);
+
+    return rc;
+}
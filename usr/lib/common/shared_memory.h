@@ -39,4 +39,11 @@ int sm_copy_name(void *addr, char *buffer, size_t len);
 
 int sm_get_count(void *addr);
 
+int sm_open_readonly(const char *sm_name, int mode, void **p_addr,
+                     size_t *p_len, const char *group);
+
+int sm_close_readonly(void *addr);
+
+int sm_unlink(const char *sm_name);
+
 #endif
@@ -11,6 +11,8 @@
 #ifndef __SW_CRYPT_H__
 #define __SW_CRYPT_H__
 
+#include <stdint.h>
+
 #define sw_des3_cbc_encrypt(clear, len, cipher, len2, iv, key) \
  sw_des3_cbc(clear, len, cipher, len2, iv, key, 1)
 
@@ -36,4 +38,52 @@ CK_RV sw_aes_cbc(CK_BYTE *in_data,
                   CK_BYTE *init_v, CK_BYTE *key_value, CK_ULONG keylen,
                   CK_BYTE encrypt);
 
+#define SW_SHA_MAX_BLOCK_SIZE   144     /* SHA3-224 rate */
+#define SW_SHA_MAX_DIGEST_SIZE  64
+
+/*
+ * Software digest state, plain data so that it can be saved and restored
+ * with the operation state (see sw_sha.c).
+ */
+typedef struct _SW_SHA_CTX {
+    CK_ULONG alg;
+    CK_ULONG digest_len;
+    CK_ULONG block_size;
+    CK_ULONG buf_len;
+    uint64_t count;                 /* bytes processed */
+    union {
+        uint32_t h32[8];
+        uint64_t h64[8];
+        uint64_t keccak[25];
+    } state;
+    CK_BYTE buf[SW_SHA_MAX_BLOCK_SIZE];
+} SW_SHA_CTX;
+
+typedef struct _SW_HMAC_CTX {
+    SW_SHA_CTX inner;
+    SW_SHA_CTX outer;
+} SW_HMAC_CTX;
+
+CK_RV sw_sha_init(SW_SHA_CTX *ctx, CK_MECHANISM_TYPE mech);
+CK_RV sw_sha_update(SW_SHA_CTX *ctx, const CK_BYTE *data, CK_ULONG len);
+CK_RV sw_sha_final(SW_SHA_CTX *ctx, CK_BYTE *out);
+
+CK_RV sw_hmac_init(SW_HMAC_CTX *ctx, CK_MECHANISM_TYPE digest_mech,
+                   const CK_BYTE *key, CK_ULONG key_len);
+CK_RV sw_hmac_update(SW_HMAC_CTX *ctx, const CK_BYTE *data, CK_ULONG len);
+CK_RV sw_hmac_final(SW_HMAC_CTX *ctx, CK_BYTE *out);
+
+/*
+ * Digests count independent messages with a SHA-2 mechanism, the digest of
+ * data[i] is written to digests[i]. Returns CKR_MECHANISM_INVALID for other
+ * mechanisms.
+ */
+CK_RV sw_sha_batch(CK_MECHANISM_TYPE mech, CK_ULONG count, CK_BYTE **data,
+                   const CK_ULONG *data_len, CK_BYTE **digests);
+/*
+ * Returns TRUE if sw_sha_batch is faster for the mechanism on this CPU than
+ * digesting the messages one by one with OpenSSL.
+ */
+CK_BBOOL sw_sha_batch_preferred(CK_MECHANISM_TYPE mech);
+
 #endif
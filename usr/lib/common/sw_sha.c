@@ -0,0 +1,951 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Software SHA-1, SHA-2 and SHA-3 digests and HMAC.
+ *
+ * Unlike an OpenSSL 3 EVP_MD_CTX, the state of these digests is plain data
+ * without any pointers. It can be saved with C_GetOperationState and
+ * restored with C_SetOperationState, also by another process.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "pkcs11types.h"
+#include "sw_crypt.h"
+
+#include <openssl/crypto.h>
+
+enum sw_sha_alg {
+    SW_SHA_ALG_SHA1 = 1,
+    SW_SHA_ALG_SHA256,
+    SW_SHA_ALG_SHA512,
+    SW_SHA_ALG_SHA3,
+};
+
+#define ROTL32(x, n)    (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROTR32(x, n)    (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTL64(x, n)    (((x) << (n)) | ((x) >> (64 - (n))))
+#define ROTR64(x, n)    (((x) >> (n)) | ((x) << (64 - (n))))
+
+static inline uint32_t load_be32(const CK_BYTE *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline uint64_t load_be64(const CK_BYTE *p)
+{
+    return ((uint64_t)load_be32(p) << 32) | load_be32(p + 4);
+}
+
+static inline uint64_t load_le64(const CK_BYTE *p)
+{
+    uint64_t v = 0;
+    int i;
+
+    for (i = 7; i >= 0; i--)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static inline void store_be32(CK_BYTE *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline void store_be64(CK_BYTE *p, uint64_t v)
+{
+    store_be32(p, v >> 32);
+    store_be32(p + 4, (uint32_t)v);
+}
+
+static const uint32_t sha1_iv[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0,
+};
+
+static const uint32_t sha224_iv[8] = {
+    0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939,
+    0xffc00b31, 0x68581511, 0x64f98fa7, 0xbefa4fa4,
+};
+
+static const uint32_t sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static const uint64_t sha384_iv[8] = {
+    0xcbbb9d5dc1059ed8ULL, 0x629a292a367cd507ULL,
+    0x9159015a3070dd17ULL, 0x152fecd8f70e5939ULL,
+    0x67332667ffc00b31ULL, 0x8eb44a8768581511ULL,
+    0xdb0c2e0d64f98fa7ULL, 0x47b5481dbefa4fa4ULL,
+};
+
+static const uint64_t sha512_iv[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+    0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL,
+};
+
+static const uint64_t sha512_224_iv[8] = {
+    0x8c3d37c819544da2ULL, 0x73e1996689dcd4d6ULL,
+    0x1dfab7ae32ff9c82ULL, 0x679dd514582f9fcfULL,
+    0x0f6d2b697bd44da8ULL, 0x77e36f7304c48942ULL,
+    0x3f9d85a86a1d36c8ULL, 0x1112e6ad91d692a1ULL,
+};
+
+static const uint64_t sha512_256_iv[8] = {
+    0x22312194fc2bf72cULL, 0x9f555fa3c84c64c2ULL,
+    0x2393b86b6f53b151ULL, 0x963877195940eabdULL,
+    0x96283ee2a88effe3ULL, 0xbe5e1e2553863992ULL,
+    0x2b0199fc2c85b8aaULL, 0x0eb72ddc81c52ca2ULL,
+};
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint64_t sha512_k[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+    0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+    0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+    0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+    0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+    0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+    0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+    0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+    0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+    0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+    0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+    0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+    0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+    0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+    0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+    0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+    0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+    0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+    0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+    0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+    0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+static const uint64_t keccak_rc[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+    0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+    0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+    0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+    0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+    0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+    0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL,
+};
+
+static const unsigned int keccak_rotc[24] = {
+    1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14,
+    27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44,
+};
+
+static const unsigned int keccak_piln[24] = {
+    10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4,
+    15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1,
+};
+
+#define SHA1_ROUND(f, k)                                                \
+    do {                                                                \
+        t = ROTL32(a, 5) + (f) + e + (k) + w[i];                        \
+        e = d;                                                          \
+        d = c;                                                          \
+        c = ROTL32(b, 30);                                              \
+        b = a;                                                          \
+        a = t;                                                          \
+    } while (0)
+
+static void sha1_block(uint32_t *h, const CK_BYTE *p)
+{
+    uint32_t w[80], a, b, c, d, e, t;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = load_be32(p + 4 * i);
+    for (i = 16; i < 80; i++)
+        w[i] = ROTL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    a = h[0];
+    b = h[1];
+    c = h[2];
+    d = h[3];
+    e = h[4];
+
+    for (i = 0; i < 20; i++)
+        SHA1_ROUND((b & c) | (~b & d), 0x5a827999);
+    for (; i < 40; i++)
+        SHA1_ROUND(b ^ c ^ d, 0x6ed9eba1);
+    for (; i < 60; i++)
+        SHA1_ROUND((b & c) | (b & d) | (c & d), 0x8f1bbcdc);
+    for (; i < 80; i++)
+        SHA1_ROUND(b ^ c ^ d, 0xca62c1d6);
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+static void sha256_block(uint32_t *h, const CK_BYTE *p)
+{
+    uint32_t w[64], a, b, c, d, e, f, g, hh, s0, s1, t1, t2;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = load_be32(p + 4 * i);
+    for (i = 16; i < 64; i++) {
+        s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = h[0];
+    b = h[1];
+    c = h[2];
+    d = h[3];
+    e = h[4];
+    f = h[5];
+    g = h[6];
+    hh = h[7];
+
+    for (i = 0; i < 64; i++) {
+        t1 = hh + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) +
+             ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) +
+             ((a & b) ^ (a & c) ^ (b & c));
+        hh = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += hh;
+}
+
+static void sha512_block(uint64_t *h, const CK_BYTE *p)
+{
+    uint64_t w[80], a, b, c, d, e, f, g, hh, s0, s1, t1, t2;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = load_be64(p + 8 * i);
+    for (i = 16; i < 80; i++) {
+        s0 = ROTR64(w[i - 15], 1) ^ ROTR64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+        s1 = ROTR64(w[i - 2], 19) ^ ROTR64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = h[0];
+    b = h[1];
+    c = h[2];
+    d = h[3];
+    e = h[4];
+    f = h[5];
+    g = h[6];
+    hh = h[7];
+
+    for (i = 0; i < 80; i++) {
+        t1 = hh + (ROTR64(e, 14) ^ ROTR64(e, 18) ^ ROTR64(e, 41)) +
+             ((e & f) ^ (~e & g)) + sha512_k[i] + w[i];
+        t2 = (ROTR64(a, 28) ^ ROTR64(a, 34) ^ ROTR64(a, 39)) +
+             ((a & b) ^ (a & c) ^ (b & c));
+        hh = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += hh;
+}
+
+static void keccak_f1600(uint64_t *st)
+{
+    uint64_t bc0, bc1, bc2, bc3, bc4, t;
+    int i, j, r;
+
+    for (r = 0; r < 24; r++) {
+        /* Theta */
+        bc0 = st[0] ^ st[5] ^ st[10] ^ st[15] ^ st[20];
+        bc1 = st[1] ^ st[6] ^ st[11] ^ st[16] ^ st[21];
+        bc2 = st[2] ^ st[7] ^ st[12] ^ st[17] ^ st[22];
+        bc3 = st[3] ^ st[8] ^ st[13] ^ st[18] ^ st[23];
+        bc4 = st[4] ^ st[9] ^ st[14] ^ st[19] ^ st[24];
+        for (j = 0; j < 25; j += 5) {
+            st[j] ^= bc4 ^ ROTL64(bc1, 1);
+            st[j + 1] ^= bc0 ^ ROTL64(bc2, 1);
+            st[j + 2] ^= bc1 ^ ROTL64(bc3, 1);
+            st[j + 3] ^= bc2 ^ ROTL64(bc4, 1);
+            st[j + 4] ^= bc3 ^ ROTL64(bc0, 1);
+        }
+
+        /* Rho and pi */
+        t = st[1];
+        for (i = 0; i < 24; i++) {
+            j = keccak_piln[i];
+            bc0 = st[j];
+            st[j] = ROTL64(t, keccak_rotc[i]);
+            t = bc0;
+        }
+
+        /* Chi */
+        for (j = 0; j < 25; j += 5) {
+            bc0 = st[j];
+            bc1 = st[j + 1];
+            bc2 = st[j + 2];
+            bc3 = st[j + 3];
+            bc4 = st[j + 4];
+            st[j] ^= ~bc1 & bc2;
+            st[j + 1] ^= ~bc2 & bc3;
+            st[j + 2] ^= ~bc3 & bc4;
+            st[j + 3] ^= ~bc4 & bc0;
+            st[j + 4] ^= ~bc0 & bc1;
+        }
+
+        /* Iota */
+        st[0] ^= keccak_rc[r];
+    }
+}
+
+static void sw_sha_block(SW_SHA_CTX *ctx, const CK_BYTE *p)
+{
+    CK_ULONG i;
+
+    switch (ctx->alg) {
+    case SW_SHA_ALG_SHA1:
+        sha1_block(ctx->state.h32, p);
+        break;
+    case SW_SHA_ALG_SHA256:
+        sha256_block(ctx->state.h32, p);
+        break;
+    case SW_SHA_ALG_SHA512:
+        sha512_block(ctx->state.h64, p);
+        break;
+    case SW_SHA_ALG_SHA3:
+        for (i = 0; i < ctx->block_size / 8; i++)
+            ctx->state.keccak[i] ^= load_le64(p + 8 * i);
+        keccak_f1600(ctx->state.keccak);
+        break;
+    }
+}
+
+/*
+ * A saved state is passed back in by the application, so check it before
+ * using the length fields to access the buffer.
+ */
+static CK_RV sw_sha_check(const SW_SHA_CTX *ctx)
+{
+    switch (ctx->alg) {
+    case SW_SHA_ALG_SHA1:
+    case SW_SHA_ALG_SHA256:
+        if (ctx->block_size != 64 || ctx->digest_len == 0 ||
+            ctx->digest_len > 32)
+            return CKR_SAVED_STATE_INVALID;
+        break;
+    case SW_SHA_ALG_SHA512:
+        if (ctx->block_size != 128 || ctx->digest_len == 0 ||
+            ctx->digest_len > 64)
+            return CKR_SAVED_STATE_INVALID;
+        break;
+    case SW_SHA_ALG_SHA3:
+        if (ctx->digest_len < 28 || ctx->digest_len > 64 ||
+            ctx->block_size != 200 - 2 * ctx->digest_len)
+            return CKR_SAVED_STATE_INVALID;
+        break;
+    default:
+        return CKR_SAVED_STATE_INVALID;
+    }
+
+    if (ctx->buf_len >= ctx->block_size)
+        return CKR_SAVED_STATE_INVALID;
+
+    return CKR_OK;
+}
+
+CK_RV sw_sha_init(SW_SHA_CTX *ctx, CK_MECHANISM_TYPE mech)
+{
+    memset(ctx, 0, sizeof(*ctx));
+
+    switch (mech) {
+    case CKM_SHA_1:
+        ctx->alg = SW_SHA_ALG_SHA1;
+        ctx->digest_len = 20;
+        memcpy(ctx->state.h32, sha1_iv, sizeof(sha1_iv));
+        break;
+    case CKM_SHA224:
+        ctx->alg = SW_SHA_ALG_SHA256;
+        ctx->digest_len = 28;
+        memcpy(ctx->state.h32, sha224_iv, sizeof(sha224_iv));
+        break;
+    case CKM_SHA256:
+        ctx->alg = SW_SHA_ALG_SHA256;
+        ctx->digest_len = 32;
+        memcpy(ctx->state.h32, sha256_iv, sizeof(sha256_iv));
+        break;
+    case CKM_SHA384:
+        ctx->alg = SW_SHA_ALG_SHA512;
+        ctx->digest_len = 48;
+        memcpy(ctx->state.h64, sha384_iv, sizeof(sha384_iv));
+        break;
+    case CKM_SHA512:
+        ctx->alg = SW_SHA_ALG_SHA512;
+        ctx->digest_len = 64;
+        memcpy(ctx->state.h64, sha512_iv, sizeof(sha512_iv));
+        break;
+    case CKM_SHA512_224:
+        ctx->alg = SW_SHA_ALG_SHA512;
+        ctx->digest_len = 28;
+        memcpy(ctx->state.h64, sha512_224_iv, sizeof(sha512_224_iv));
+        break;
+    case CKM_SHA512_256:
+        ctx->alg = SW_SHA_ALG_SHA512;
+        ctx->digest_len = 32;
+        memcpy(ctx->state.h64, sha512_256_iv, sizeof(sha512_256_iv));
+        break;
+    case CKM_SHA3_224:
+    case CKM_IBM_SHA3_224:
+        ctx->alg = SW_SHA_ALG_SHA3;
+        ctx->digest_len = 28;
+        break;
+    case CKM_SHA3_256:
+    case CKM_IBM_SHA3_256:
+        ctx->alg = SW_SHA_ALG_SHA3;
+        ctx->digest_len = 32;
+        break;
+    case CKM_SHA3_384:
+    case CKM_IBM_SHA3_384:
+        ctx->alg = SW_SHA_ALG_SHA3;
+        ctx->digest_len = 48;
+        break;
+    case CKM_SHA3_512:
+    case CKM_IBM_SHA3_512:
+        ctx->alg = SW_SHA_ALG_SHA3;
+        ctx->digest_len = 64;
+        break;
+    default:
+        return CKR_MECHANISM_INVALID;
+    }
+
+    switch (ctx->alg) {
+    case SW_SHA_ALG_SHA512:
+        ctx->block_size = 128;
+        break;
+    case SW_SHA_ALG_SHA3:
+        ctx->block_size = 200 - 2 * ctx->digest_len;
+        break;
+    default:
+        ctx->block_size = 64;
+        break;
+    }
+
+    return CKR_OK;
+}
+
+CK_RV sw_sha_update(SW_SHA_CTX *ctx, const CK_BYTE *data, CK_ULONG len)
+{
+    CK_ULONG n;
+    CK_RV rc;
+
+    rc = sw_sha_check(ctx);
+    if (rc != CKR_OK)
+        return rc;
+
+    ctx->count += len;
+
+    if (ctx->buf_len > 0) {
+        n = ctx->block_size - ctx->buf_len;
+        if (n > len)
+            n = len;
+        memcpy(ctx->buf + ctx->buf_len, data, n);
+        ctx->buf_len += n;
+        data += n;
+        len -= n;
+        if (ctx->buf_len < ctx->block_size)
+            return CKR_OK;
+        sw_sha_block(ctx, ctx->buf);
+        ctx->buf_len = 0;
+    }
+
+    while (len >= ctx->block_size) {
+        sw_sha_block(ctx, data);
+        data += ctx->block_size;
+        len -= ctx->block_size;
+    }
+
+    if (len > 0) {
+        memcpy(ctx->buf, data, len);
+        ctx->buf_len = len;
+    }
+
+    return CKR_OK;
+}
+
+CK_RV sw_sha_final(SW_SHA_CTX *ctx, CK_BYTE *out)
+{
+    CK_BYTE md[SW_SHA_MAX_DIGEST_SIZE];
+    CK_ULONG i, len_size;
+    CK_RV rc;
+
+    rc = sw_sha_check(ctx);
+    if (rc != CKR_OK)
+        return rc;
+
+    if (ctx->alg == SW_SHA_ALG_SHA3) {
+        memset(ctx->buf + ctx->buf_len, 0, ctx->block_size - ctx->buf_len);
+        ctx->buf[ctx->buf_len] = 0x06;
+        ctx->buf[ctx->block_size - 1] |= 0x80;
+        sw_sha_block(ctx, ctx->buf);
+
+        for (i = 0; i < ctx->digest_len; i++)
+            out[i] = ctx->state.keccak[i / 8] >> (8 * (i % 8));
+        goto done;
+    }
+
+    /* Padding and message bit length, 64 or 128 bits big endian */
+    len_size = (ctx->alg == SW_SHA_ALG_SHA512) ? 16 : 8;
+
+    ctx->buf[ctx->buf_len++] = 0x80;
+    if (ctx->buf_len > ctx->block_size - len_size) {
+        memset(ctx->buf + ctx->buf_len, 0, ctx->block_size - ctx->buf_len);
+        sw_sha_block(ctx, ctx->buf);
+        ctx->buf_len = 0;
+    }
+    memset(ctx->buf + ctx->buf_len, 0, ctx->block_size - ctx->buf_len);
+    if (len_size == 16)
+        store_be64(ctx->buf + ctx->block_size - 16, ctx->count >> 61);
+    store_be64(ctx->buf + ctx->block_size - 8, ctx->count << 3);
+    sw_sha_block(ctx, ctx->buf);
+
+    if (ctx->alg == SW_SHA_ALG_SHA512) {
+        for (i = 0; i < 8; i++)
+            store_be64(md + 8 * i, ctx->state.h64[i]);
+    } else {
+        for (i = 0; i < 8; i++)
+            store_be32(md + 4 * i, ctx->state.h32[i]);
+    }
+    memcpy(out, md, ctx->digest_len);
+    OPENSSL_cleanse(md, sizeof(md));
+
+done:
+    OPENSSL_cleanse(ctx, sizeof(*ctx));
+    return CKR_OK;
+}
+
+CK_RV sw_hmac_init(SW_HMAC_CTX *ctx, CK_MECHANISM_TYPE digest_mech,
+                   const CK_BYTE *key, CK_ULONG key_len)
+{
+    CK_BYTE pad[SW_SHA_MAX_BLOCK_SIZE];
+    CK_BYTE key_md[SW_SHA_MAX_DIGEST_SIZE];
+    CK_ULONG i, block_size;
+    CK_RV rc;
+
+    rc = sw_sha_init(&ctx->inner, digest_mech);
+    if (rc != CKR_OK)
+        return rc;
+    block_size = ctx->inner.block_size;
+
+    /* Keys longer than the block size are replaced by their digest */
+    if (key_len > block_size) {
+        rc = sw_sha_update(&ctx->inner, key, key_len);
+        if (rc == CKR_OK)
+            rc = sw_sha_final(&ctx->inner, key_md);
+        if (rc != CKR_OK)
+            return rc;
+        rc = sw_sha_init(&ctx->inner, digest_mech);
+        if (rc != CKR_OK)
+            return rc;
+        key = key_md;
+        key_len = ctx->inner.digest_len;
+    }
+
+    memcpy(&ctx->outer, &ctx->inner, sizeof(ctx->outer));
+
+    memset(pad, 0, block_size);
+    memcpy(pad, key, key_len);
+    for (i = 0; i < block_size; i++)
+        pad[i] ^= 0x36;
+    rc = sw_sha_update(&ctx->inner, pad, block_size);
+    if (rc != CKR_OK)
+        goto out;
+
+    for (i = 0; i < block_size; i++)
+        pad[i] ^= 0x36 ^ 0x5c;
+    rc = sw_sha_update(&ctx->outer, pad, block_size);
+
+out:
+    OPENSSL_cleanse(pad, sizeof(pad));
+    OPENSSL_cleanse(key_md, sizeof(key_md));
+    return rc;
+}
+
+CK_RV sw_hmac_update(SW_HMAC_CTX *ctx, const CK_BYTE *data, CK_ULONG len)
+{
+    return sw_sha_update(&ctx->inner, data, len);
+}
+
+CK_RV sw_hmac_final(SW_HMAC_CTX *ctx, CK_BYTE *out)
+{
+    CK_BYTE md[SW_SHA_MAX_DIGEST_SIZE];
+    CK_ULONG md_len = ctx->inner.digest_len;
+    CK_RV rc;
+
+    rc = sw_sha_check(&ctx->outer);
+    if (rc == CKR_OK)
+        rc = sw_sha_final(&ctx->inner, md);
+    if (rc == CKR_OK)
+        rc = sw_sha_update(&ctx->outer, md, md_len);
+    if (rc == CKR_OK)
+        rc = sw_sha_final(&ctx->outer, out);
+
+    OPENSSL_cleanse(md, sizeof(md));
+    return rc;
+}
+
+/*
+ * Multi-buffer SHA-2 for batches of independent messages. The compression
+ * function processes one block of several messages (lanes) at once, with the
+ * working variables of all lanes in arrays, so that the compiler can use
+ * vector instructions for each step. A lane that finished its message
+ * continues with the next message of the batch.
+ */
+#define SHA256_LANES    8
+#define SHA512_LANES    4
+#define MAX_LANES       8
+
+/*
+ * Without 256 bit vectors the lanes are slower than OpenSSL's assembler
+ * code, so an AVX2 variant of the lane functions is built on x86_64 and
+ * selected at load time.
+ */
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__) && \
+    !defined(__clang__)
+#define LANES_TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#define have_lane_vectors() __builtin_cpu_supports("avx2")
+#define have_sha256_insn()  __builtin_cpu_supports("sha")
+#else
+#define LANES_TARGET_CLONES
+#define have_lane_vectors() 0
+#define have_sha256_insn()  0
+#endif
+
+#define SHA256_LANES_ROUND(a, b, c, d, e, f, g, h, i)                   \
+    for (l = 0; l < SHA256_LANES; l++) {                                \
+        t1 = h[l] + (ROTR32(e[l], 6) ^ ROTR32(e[l], 11) ^               \
+                     ROTR32(e[l], 25)) +                                \
+             ((e[l] & f[l]) ^ (~e[l] & g[l])) + sha256_k[i] + w[i][l];  \
+        d[l] += t1;                                                     \
+        h[l] = t1 + (ROTR32(a[l], 2) ^ ROTR32(a[l], 13) ^               \
+                     ROTR32(a[l], 22)) +                                \
+               ((a[l] & b[l]) ^ (a[l] & c[l]) ^ (b[l] & c[l]));         \
+    }
+
+#define SHA512_LANES_ROUND(a, b, c, d, e, f, g, h, i)                   \
+    for (l = 0; l < SHA512_LANES; l++) {                                \
+        t1 = h[l] + (ROTR64(e[l], 14) ^ ROTR64(e[l], 18) ^              \
+                     ROTR64(e[l], 41)) +                                \
+             ((e[l] & f[l]) ^ (~e[l] & g[l])) + sha512_k[i] + w[i][l];  \
+        d[l] += t1;                                                     \
+        h[l] = t1 + (ROTR64(a[l], 28) ^ ROTR64(a[l], 34) ^              \
+                     ROTR64(a[l], 39)) +                                \
+               ((a[l] & b[l]) ^ (a[l] & c[l]) ^ (b[l] & c[l]));         \
+    }
+
+/*
+ * The rounds are unrolled by 8, so that the working variables rotate by
+ * renaming instead of moving data between the lane arrays.
+ */
+LANES_TARGET_CLONES
+static void sha256_lanes_block(uint32_t h[8][SHA256_LANES],
+                               const CK_BYTE *p[MAX_LANES])
+{
+    uint32_t w[64][SHA256_LANES], s[8][SHA256_LANES], s0, s1, t1;
+    int i, l;
+
+    for (i = 0; i < 16; i++)
+        for (l = 0; l < SHA256_LANES; l++)
+            w[i][l] = load_be32(p[l] + 4 * i);
+    for (i = 16; i < 64; i++) {
+        for (l = 0; l < SHA256_LANES; l++) {
+            s0 = ROTR32(w[i - 15][l], 7) ^ ROTR32(w[i - 15][l], 18) ^
+                 (w[i - 15][l] >> 3);
+            s1 = ROTR32(w[i - 2][l], 17) ^ ROTR32(w[i - 2][l], 19) ^
+                 (w[i - 2][l] >> 10);
+            w[i][l] = w[i - 16][l] + s0 + w[i - 7][l] + s1;
+        }
+    }
+
+    memcpy(s, h, sizeof(s));
+    for (i = 0; i < 64; i += 8) {
+        SHA256_LANES_ROUND(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], i);
+        SHA256_LANES_ROUND(s[7], s[0], s[1], s[2], s[3], s[4], s[5], s[6],
+                           i + 1);
+        SHA256_LANES_ROUND(s[6], s[7], s[0], s[1], s[2], s[3], s[4], s[5],
+                           i + 2);
+        SHA256_LANES_ROUND(s[5], s[6], s[7], s[0], s[1], s[2], s[3], s[4],
+                           i + 3);
+        SHA256_LANES_ROUND(s[4], s[5], s[6], s[7], s[0], s[1], s[2], s[3],
+                           i + 4);
+        SHA256_LANES_ROUND(s[3], s[4], s[5], s[6], s[7], s[0], s[1], s[2],
+                           i + 5);
+        SHA256_LANES_ROUND(s[2], s[3], s[4], s[5], s[6], s[7], s[0], s[1],
+                           i + 6);
+        SHA256_LANES_ROUND(s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[0],
+                           i + 7);
+    }
+
+    for (i = 0; i < 8; i++)
+        for (l = 0; l < SHA256_LANES; l++)
+            h[i][l] += s[i][l];
+}
+
+LANES_TARGET_CLONES
+static void sha512_lanes_block(uint64_t h[8][SHA512_LANES],
+                               const CK_BYTE *p[MAX_LANES])
+{
+    uint64_t w[80][SHA512_LANES], s[8][SHA512_LANES], s0, s1, t1;
+    int i, l;
+
+    for (i = 0; i < 16; i++)
+        for (l = 0; l < SHA512_LANES; l++)
+            w[i][l] = load_be64(p[l] + 8 * i);
+    for (i = 16; i < 80; i++) {
+        for (l = 0; l < SHA512_LANES; l++) {
+            s0 = ROTR64(w[i - 15][l], 1) ^ ROTR64(w[i - 15][l], 8) ^
+                 (w[i - 15][l] >> 7);
+            s1 = ROTR64(w[i - 2][l], 19) ^ ROTR64(w[i - 2][l], 61) ^
+                 (w[i - 2][l] >> 6);
+            w[i][l] = w[i - 16][l] + s0 + w[i - 7][l] + s1;
+        }
+    }
+
+    memcpy(s, h, sizeof(s));
+    for (i = 0; i < 80; i += 8) {
+        SHA512_LANES_ROUND(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], i);
+        SHA512_LANES_ROUND(s[7], s[0], s[1], s[2], s[3], s[4], s[5], s[6],
+                           i + 1);
+        SHA512_LANES_ROUND(s[6], s[7], s[0], s[1], s[2], s[3], s[4], s[5],
+                           i + 2);
+        SHA512_LANES_ROUND(s[5], s[6], s[7], s[0], s[1], s[2], s[3], s[4],
+                           i + 3);
+        SHA512_LANES_ROUND(s[4], s[5], s[6], s[7], s[0], s[1], s[2], s[3],
+                           i + 4);
+        SHA512_LANES_ROUND(s[3], s[4], s[5], s[6], s[7], s[0], s[1], s[2],
+                           i + 5);
+        SHA512_LANES_ROUND(s[2], s[3], s[4], s[5], s[6], s[7], s[0], s[1],
+                           i + 6);
+        SHA512_LANES_ROUND(s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[0],
+                           i + 7);
+    }
+
+    for (i = 0; i < 8; i++)
+        for (l = 0; l < SHA512_LANES; l++)
+            h[i][l] += s[i][l];
+}
+
+struct sha_lane {
+    const CK_BYTE *data;
+    CK_ULONG full_blocks;       /* blocks read from the message */
+    CK_ULONG blocks;            /* including the padding blocks */
+    CK_ULONG next;              /* next block to process */
+    CK_BYTE *out;               /* NULL if the lane is idle */
+    CK_BYTE pad[2 * 128];       /* message tail with the padding */
+};
+
+/*
+ * Starts a message in a lane. The tail of the message, the padding and the
+ * message bit length are put into one or two blocks of the lane's buffer.
+ */
+static void sha_lane_start(struct sha_lane *lane, const CK_BYTE *data,
+                           CK_ULONG len, CK_BYTE *out, const SW_SHA_CTX *ctx)
+{
+    CK_ULONG tail = len % ctx->block_size;
+    CK_ULONG len_size = (ctx->alg == SW_SHA_ALG_SHA512) ? 16 : 8;
+    CK_ULONG end;
+
+    lane->data = data;
+    lane->full_blocks = len / ctx->block_size;
+    lane->blocks = lane->full_blocks +
+                   (tail + 1 + len_size > ctx->block_size ? 2 : 1);
+    lane->next = 0;
+    lane->out = out;
+
+    end = (lane->blocks - lane->full_blocks) * ctx->block_size;
+    memset(lane->pad, 0, end);
+    if (tail > 0)
+        memcpy(lane->pad, data + lane->full_blocks * ctx->block_size, tail);
+    lane->pad[tail] = 0x80;
+    if (len_size == 16)
+        store_be64(lane->pad + end - 16, (uint64_t)len >> 61);
+    store_be64(lane->pad + end - 8, (uint64_t)len << 3);
+}
+
+static const CK_BYTE *sha_lane_block(const struct sha_lane *lane,
+                                     CK_ULONG block_size)
+{
+    if (lane->next < lane->full_blocks)
+        return lane->data + lane->next * block_size;
+
+    return lane->pad + (lane->next - lane->full_blocks) * block_size;
+}
+
+CK_BBOOL sw_sha_batch_preferred(CK_MECHANISM_TYPE mech)
+{
+    switch (mech) {
+    case CKM_SHA224:
+    case CKM_SHA256:
+        /* The SHA-NI instructions beat 8 lanes in AVX2 registers */
+        return (have_lane_vectors() && !have_sha256_insn()) ? TRUE : FALSE;
+    case CKM_SHA384:
+    case CKM_SHA512:
+    case CKM_SHA512_224:
+    case CKM_SHA512_256:
+        return have_lane_vectors() ? TRUE : FALSE;
+    default:
+        return FALSE;
+    }
+}
+
+CK_RV sw_sha_batch(CK_MECHANISM_TYPE mech, CK_ULONG count, CK_BYTE **data,
+                   const CK_ULONG *data_len, CK_BYTE **digests)
+{
+    static const CK_BYTE idle_block[128];
+    struct sha_lane lanes[MAX_LANES];
+    const CK_BYTE *p[MAX_LANES];
+    union {
+        uint32_t h32[8][SHA256_LANES];
+        uint64_t h64[8][SHA512_LANES];
+    } st;
+    CK_BYTE md[SW_SHA_MAX_DIGEST_SIZE];
+    CK_ULONG next = 0, num_lanes, active = 0, i, l;
+    SW_SHA_CTX iv;
+    CK_RV rc;
+
+    /* The initial state, block size and digest length of the mechanism */
+    rc = sw_sha_init(&iv, mech);
+    if (rc != CKR_OK)
+        return rc;
+
+    switch (iv.alg) {
+    case SW_SHA_ALG_SHA256:
+        num_lanes = SHA256_LANES;
+        break;
+    case SW_SHA_ALG_SHA512:
+        num_lanes = SHA512_LANES;
+        break;
+    default:
+        return CKR_MECHANISM_INVALID;
+    }
+
+    for (l = 0; l < num_lanes; l++)
+        lanes[l].out = NULL;
+
+    while (next < count || active > 0) {
+        /* Start the next messages in the idle lanes */
+        for (l = 0; l < num_lanes && next < count; l++) {
+            if (lanes[l].out != NULL)
+                continue;
+
+            sha_lane_start(&lanes[l], data[next], data_len[next],
+                           digests[next], &iv);
+            for (i = 0; i < 8; i++) {
+                if (iv.alg == SW_SHA_ALG_SHA512)
+                    st.h64[i][l] = iv.state.h64[i];
+                else
+                    st.h32[i][l] = iv.state.h32[i];
+            }
+            next++;
+            active++;
+        }
+
+        for (l = 0; l < num_lanes; l++)
+            p[l] = (lanes[l].out != NULL) ?
+                        sha_lane_block(&lanes[l], iv.block_size) : idle_block;
+
+        if (iv.alg == SW_SHA_ALG_SHA512)
+            sha512_lanes_block(st.h64, p);
+        else
+            sha256_lanes_block(st.h32, p);
+
+        /* Output the digests of the lanes that finished their message */
+        for (l = 0; l < num_lanes; l++) {
+            if (lanes[l].out == NULL || ++lanes[l].next < lanes[l].blocks)
+                continue;
+
+            for (i = 0; i < 8; i++) {
+                if (iv.alg == SW_SHA_ALG_SHA512)
+                    store_be64(md + 8 * i, st.h64[i][l]);
+                else
+                    store_be32(md + 4 * i, st.h32[i][l]);
+            }
+            memcpy(lanes[l].out, md, iv.digest_len);
+            lanes[l].out = NULL;
+            active--;
+        }
+    }
+
+    OPENSSL_cleanse(lanes, sizeof(lanes));
+    OPENSSL_cleanse(&st, sizeof(st));
+    OPENSSL_cleanse(md, sizeof(md));
+
+    return CKR_OK;
+}
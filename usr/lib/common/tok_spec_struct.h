@@ -314,6 +314,37 @@ struct token_specific_struct {
 
     CK_RV (*t_check_obj_access) (STDLL_TokData_t *tokdata, OBJECT *obj,
                                  CK_BBOOL create);
+
+    // Token specific fused hash-and-sign/verify for the digest based
+    // ECDSA and RSA signature mechanisms. The init function returns
+    // CKR_MECHANISM_INVALID if the token can not perform the mechanism
+    // with the given key in one pass, the generic digest + sign is used then.
+    CK_RV(*t_hash_sign_verify_init) (STDLL_TokData_t *, SESSION *,
+                                     SIGN_VERIFY_CONTEXT *, CK_MECHANISM *,
+                                     OBJECT *, CK_BBOOL);
+    CK_RV(*t_hash_sign) (STDLL_TokData_t *, SESSION *, SIGN_VERIFY_CONTEXT *,
+                         CK_BBOOL, CK_BYTE *, CK_ULONG, CK_BYTE *, CK_ULONG *);
+    CK_RV(*t_hash_sign_verify_update) (STDLL_TokData_t *, SESSION *,
+                                       SIGN_VERIFY_CONTEXT *, CK_BYTE *,
+                                       CK_ULONG);
+    CK_RV(*t_hash_sign_final) (STDLL_TokData_t *, SESSION *,
+                               SIGN_VERIFY_CONTEXT *, CK_BBOOL, CK_BYTE *,
+                               CK_ULONG *);
+    CK_RV(*t_hash_verify) (STDLL_TokData_t *, SESSION *, SIGN_VERIFY_CONTEXT *,
+                           CK_BYTE *, CK_ULONG, CK_BYTE *, CK_ULONG);
+    CK_RV(*t_hash_verify_final) (STDLL_TokData_t *, SESSION *,
+                                 SIGN_VERIFY_CONTEXT *, CK_BYTE *, CK_ULONG);
+
+    // Token specific digest of a batch of independent messages, the digests
+    // are written back to back. Returns CKR_MECHANISM_INVALID if the token
+    // can not batch the mechanism, the messages are digested one by one then.
+    CK_RV(*t_sha_batch) (STDLL_TokData_t *, CK_MECHANISM *, CK_ULONG,
+                         CK_BYTE **, CK_ULONG *, CK_BYTE *);
+
+    // Token specific encoding of a clear RSA private key for wrapping. If
+    // NULL, rsa_priv_wrap_get_data() is used.
+    CK_RV(*t_rsa_priv_wrap_get_data) (STDLL_TokData_t *, OBJECT *, CK_BBOOL,
+                                      CK_BYTE **, CK_ULONG *);
 };
 
 typedef struct token_specific_struct token_spec_t;
@@ -207,6 +207,9 @@ CK_RV token_specific_sha_update(STDLL_TokData_t *, DIGEST_CONTEXT *, CK_BYTE *,
 CK_RV token_specific_sha_final(STDLL_TokData_t *, DIGEST_CONTEXT *, CK_BYTE *,
                                CK_ULONG *);
 
+CK_RV token_specific_sha_batch(STDLL_TokData_t *, CK_MECHANISM *, CK_ULONG,
+                               CK_BYTE **, CK_ULONG *, CK_BYTE *);
+
 CK_RV token_specific_shake_key_derive(STDLL_TokData_t *, SESSION *,
                                       CK_MECHANISM *,
                                       OBJECT *, CK_KEY_TYPE,
@@ -236,6 +239,31 @@ CK_RV token_specific_hmac_verify_update(STDLL_TokData_t *, SESSION *,
 CK_RV token_specific_hmac_verify_final(STDLL_TokData_t *, SESSION *,
                                        CK_BYTE *, CK_ULONG);
 
+CK_RV token_specific_hash_sign_verify_init(STDLL_TokData_t *, SESSION *,
+                                           SIGN_VERIFY_CONTEXT *,
+                                           CK_MECHANISM *, OBJECT *,
+                                           CK_BBOOL);
+
+CK_RV token_specific_hash_sign(STDLL_TokData_t *, SESSION *,
+                               SIGN_VERIFY_CONTEXT *, CK_BBOOL,
+                               CK_BYTE *, CK_ULONG, CK_BYTE *, CK_ULONG *);
+
+CK_RV token_specific_hash_sign_verify_update(STDLL_TokData_t *, SESSION *,
+                                             SIGN_VERIFY_CONTEXT *,
+                                             CK_BYTE *, CK_ULONG);
+
+CK_RV token_specific_hash_sign_final(STDLL_TokData_t *, SESSION *,
+                                     SIGN_VERIFY_CONTEXT *, CK_BBOOL,
+                                     CK_BYTE *, CK_ULONG *);
+
+CK_RV token_specific_hash_verify(STDLL_TokData_t *, SESSION *,
+                                 SIGN_VERIFY_CONTEXT *,
+                                 CK_BYTE *, CK_ULONG, CK_BYTE *, CK_ULONG);
+
+CK_RV token_specific_hash_verify_final(STDLL_TokData_t *, SESSION *,
+                                       SIGN_VERIFY_CONTEXT *,
+                                       CK_BYTE *, CK_ULONG);
+
 CK_RV token_specific_generic_secret_key_gen(STDLL_TokData_t *,
                                             TEMPLATE *template);
 
@@ -332,6 +360,9 @@ CK_RV token_specific_get_mechanism_info(STDLL_TokData_t *,
 
 CK_RV token_specific_object_add(STDLL_TokData_t *, SESSION *, OBJECT *);
 
+CK_RV token_specific_rsa_priv_wrap_get_data(STDLL_TokData_t *, OBJECT *,
+                                            CK_BBOOL, CK_BYTE **, CK_ULONG *);
+
 CK_RV token_specific_key_wrap(STDLL_TokData_t *, SESSION *, CK_MECHANISM *,
                               CK_BBOOL, OBJECT *, OBJECT *, CK_BYTE *,
                               CK_ULONG *, CK_BBOOL *);
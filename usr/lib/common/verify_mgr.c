@@ -28,6 +28,42 @@
 #include "../api/policy.h"
 #include "../api/statistics.h"
 
+/*
+ * Sets up a digest based signature verification. The token may set up a
+ * fused hash-and-verify operation, else a digest context of context_len
+ * bytes is allocated for the generic digest + verify path.
+ */
+static CK_RV verify_mgr_hash_verify_init(STDLL_TokData_t *tokdata,
+                                         SESSION *sess,
+                                         SIGN_VERIFY_CONTEXT *ctx,
+                                         CK_MECHANISM *mech, OBJECT *key_obj,
+                                         CK_ULONG context_len,
+                                         CK_BBOOL *hash_sign_fused)
+{
+    CK_RV rc;
+
+    if (token_specific.t_hash_sign_verify_init != NULL) {
+        rc = token_specific.t_hash_sign_verify_init(tokdata, sess, ctx, mech,
+                                                    key_obj, FALSE);
+        if (rc == CKR_OK) {
+            *hash_sign_fused = TRUE;
+            return CKR_OK;
+        }
+        if (rc != CKR_MECHANISM_INVALID)
+            return rc;
+    }
+
+    ctx->context_len = context_len;
+    ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
+    if (!ctx->context) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+    memset(ctx->context, 0x0, ctx->context_len);
+
+    return CKR_OK;
+}
+
 //
 //
 CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
@@ -43,6 +79,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
     CK_KEY_TYPE keytype;
     CK_OBJECT_CLASS class;
     CK_BBOOL flag;
+    CK_BBOOL hash_sign_fused = FALSE;
     CK_RV rc;
 
 
@@ -214,14 +251,11 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             ctx->context_len = 0;
             ctx->context = NULL;
         } else {
-            ctx->context_len = sizeof(RSA_DIGEST_CONTEXT);
-            ctx->context = (CK_BYTE *) malloc(sizeof(RSA_DIGEST_CONTEXT));
-            if (!ctx->context) {
-                TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-                rc = CKR_HOST_MEMORY;
+            rc = verify_mgr_hash_verify_init(tokdata, sess, ctx, mech, key_obj,
+                                             sizeof(RSA_DIGEST_CONTEXT),
+                                             &hash_sign_fused);
+            if (rc != CKR_OK)
                 goto done;
-            }
-            memset(ctx->context, 0x0, sizeof(RSA_DIGEST_CONTEXT));
         }
         break;
 #if !(NOMD2)
@@ -269,14 +303,12 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
             goto done;
         }
-        ctx->context_len = sizeof(RSA_DIGEST_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(sizeof(RSA_DIGEST_CONTEXT));
-        if (!ctx->context) {
-            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-            rc = CKR_HOST_MEMORY;
+
+        rc = verify_mgr_hash_verify_init(tokdata, sess, ctx, mech, key_obj,
+                                         sizeof(RSA_DIGEST_CONTEXT),
+                                         &hash_sign_fused);
+        if (rc != CKR_OK)
             goto done;
-        }
-        memset(ctx->context, 0x0, sizeof(RSA_DIGEST_CONTEXT));
         break;
     case CKM_SHA1_RSA_PKCS_PSS:
     case CKM_SHA224_RSA_PKCS_PSS:
@@ -327,14 +359,12 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             rc = CKR_KEY_FUNCTION_NOT_PERMITTED;
             goto done;
         }
-        ctx->context_len = sizeof(DIGEST_CONTEXT);
-        ctx->context = (CK_BYTE *) malloc(ctx->context_len);
-        if (!ctx->context) {
-            TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
-            rc = CKR_HOST_MEMORY;
+
+        rc = verify_mgr_hash_verify_init(tokdata, sess, ctx, mech, key_obj,
+                                         sizeof(DIGEST_CONTEXT),
+                                         &hash_sign_fused);
+        if (rc != CKR_OK)
             goto done;
-        }
-        memset(ctx->context, 0x0, ctx->context_len);
         break;
 #if !(NODSA)
     case CKM_DSA:
@@ -614,7 +644,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             }
 
             ctx->context_len = sizeof(SSL3_MAC_CONTEXT);
-            ctx->context = (CK_BYTE *) malloc(sizeof(SSL3_MAC_CONTEXT));
+            ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
             if (!ctx->context) {
                 TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
                 rc = CKR_HOST_MEMORY;
@@ -650,8 +680,8 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
                 }
             }
 
-            ctx->context = (CK_BYTE *) malloc(sizeof(DES_DATA_CONTEXT));
             ctx->context_len = sizeof(DES_DATA_CONTEXT);
+            ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
 
             if (!ctx->context) {
                 TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
@@ -687,8 +717,8 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             }
         }
 
-        ctx->context = (CK_BYTE *) malloc(sizeof(DES_CMAC_CONTEXT));
         ctx->context_len = sizeof(DES_CMAC_CONTEXT);
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
 
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
@@ -725,8 +755,8 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
                 }
             }
 
-            ctx->context = (CK_BYTE *) malloc(sizeof(AES_DATA_CONTEXT));
             ctx->context_len = sizeof(AES_DATA_CONTEXT);
+            ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
 
             if (!ctx->context) {
                 TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
@@ -763,8 +793,8 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
             }
         }
 
-        ctx->context = (CK_BYTE *) malloc(sizeof(AES_CMAC_CONTEXT));
         ctx->context_len = sizeof(AES_CMAC_CONTEXT);
+        ctx->context = session_mgr_alloc_context(sess, ctx->context_len);
 
         if (!ctx->context) {
             TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
@@ -835,6 +865,7 @@ CK_RV verify_mgr_init(STDLL_TokData_t *tokdata,
     ctx->active = TRUE;
     ctx->recover = recover_mode;
     ctx->pkey_active = FALSE;
+    ctx->hash_sign_fused = hash_sign_fused;
 
     rc = CKR_OK;
 
@@ -869,6 +900,7 @@ CK_RV verify_mgr_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
     ctx->pkey_active = FALSE;
     ctx->state_unsaveable = FALSE;
     ctx->count_statistics = FALSE;
+    ctx->hash_sign_fused = FALSE;
 
     if (ctx->mech.pParameter) {
         free(ctx->mech.pParameter);
@@ -880,7 +912,8 @@ CK_RV verify_mgr_cleanup(STDLL_TokData_t *tokdata, SESSION *sess,
             ctx->context_free_func(tokdata, sess, ctx->context,
                                    ctx->context_len);
         else
-            free(ctx->context);
+            session_mgr_free_context(tokdata, sess, ctx->context,
+                                     ctx->context_len);
         ctx->context = NULL;
     }
     ctx->context_len = 0;
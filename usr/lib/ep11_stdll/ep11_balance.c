@@ -0,0 +1,393 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2025
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * OpenCryptoki EP11 token - load balancing of single-part operations over
+ * the APQNs of the token, and per-APQN statistics.
+ *
+ * The EP11 host library distributes the requests sent to a target group over
+ * the APQNs of the group without considering how busy the APQNs are. With
+ * APQN_LOAD_BALANCING, the token keeps track of the requests in flight and of
+ * the latency of each APQN, and sends single-part operations to the APQN with
+ * the smallest expected completion time via a single APQN target.
+ */
+
+#define OCK_NO_EP11_DEFINES
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "trace.h"
+#include "ock_syslog.h"
+#include "ep11_specific.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+/* Weight of a new latency sample in the moving average: 1/2^EWMA_SHIFT */
+#define EP11_LB_EWMA_SHIFT      3
+/* Every n-th request is sent round-robin to refresh the latency of all APQNs */
+#define EP11_LB_PROBE_INTERVAL  64
+
+struct lb_setup_data {
+    ep11_lb_apqn_t *apqns;
+    unsigned int num_apqns;
+};
+
+static void ep11tok_lb_stats_name(STDLL_TokData_t *tokdata, char *name,
+                                  size_t name_len)
+{
+    size_t i;
+
+    snprintf(name, name_len - 1, STAT_APQN_SHM_NAME_FMT, CONFIG_PATH,
+             geteuid(), tokdata->slot_id);
+    for (i = 1; name[i] != '\0'; i++) {
+        if (name[i] == '/')
+            name[i] = '.';
+    }
+    if (name[0] != '/') {
+        memmove(&name[1], &name[0], strlen(name) + 1);
+        name[0] = '/';
+    }
+}
+
+/*
+ * Opens (and creates if required) the per-APQN statistics shared memory
+ * segment of the current user for the token's slot. Only used if statistics
+ * are enabled in the openCryptoki configuration.
+ */
+CK_RV ep11tok_lb_stats_open(STDLL_TokData_t *tokdata)
+{
+    ep11_private_data_t *ep11_data = tokdata->private_data;
+    char name[PATH_MAX];
+    struct stat stat_buf;
+    int fd, clear = 0;
+    void *data;
+
+    if (!ep11_data->apqn_load_balancing || tokdata->statistics == NULL ||
+        tokdata->statistics->increment_func == NULL)
+        return CKR_OK;
+
+    ep11tok_lb_stats_name(tokdata, name, sizeof(name));
+    TRACE_INFO("APQN statistics SHM name: '%s'\n", name);
+
+    fd = shm_open(name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        TRACE_ERROR("Failed to open SHM '%s': %s\n", name, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (fstat(fd, &stat_buf) != 0) {
+        TRACE_ERROR("Failed to stat SHM '%s': %s\n", name, strerror(errno));
+        close(fd);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    /* Do not use a segment not owned by the current user */
+    if (stat_buf.st_uid != geteuid() ||
+        (stat_buf.st_mode & ~S_IFMT) != (S_IRUSR | S_IWUSR)) {
+        TRACE_ERROR("SHM '%s' has wrong mode/owner\n", name);
+        OCK_SYSLOG(LOG_ERR, "SHM '%s' has wrong mode/owner\n", name);
+        close(fd);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if ((size_t)stat_buf.st_size != STAT_APQN_SHM_SIZE) {
+        if (ftruncate(fd, STAT_APQN_SHM_SIZE) < 0) {
+            TRACE_ERROR("Failed to set size of SHM '%s': %s\n", name,
+                        strerror(errno));
+            close(fd);
+            return CKR_FUNCTION_FAILED;
+        }
+        clear = 1;
+    }
+
+    data = mmap(NULL, STAT_APQN_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        TRACE_ERROR("Failed to memory-map SHM '%s': %s\n", name,
+                    strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (clear)
+        memset(data, 0, STAT_APQN_SHM_SIZE);
+
+    ep11_data->apqn_stats = data;
+    return CKR_OK;
+}
+
+void ep11tok_lb_stats_close(STDLL_TokData_t *tokdata)
+{
+    ep11_private_data_t *ep11_data = tokdata->private_data;
+
+    if (ep11_data->apqn_stats == NULL)
+        return;
+
+    munmap(ep11_data->apqn_stats, STAT_APQN_SHM_SIZE);
+    ep11_data->apqn_stats = NULL;
+}
+
+/*
+ * Returns the statistics entry of an APQN. The entries are shared by all
+ * processes of the user, a free entry is claimed atomically.
+ */
+static stat_apqn_t *ep11tok_lb_stats_entry(ep11_private_data_t *ep11_data,
+                                           uint_32 adapter, uint_32 domain)
+{
+    uint32_t apqn = STAT_APQN(adapter, domain);
+    stat_apqn_t *entry;
+    unsigned int i;
+
+    if (ep11_data->apqn_stats == NULL)
+        return NULL;
+
+    for (i = 0; i < STAT_APQN_MAX; i++) {
+        entry = &ep11_data->apqn_stats[i];
+        if (entry->apqn == apqn)
+            return entry;
+        if (entry->apqn == 0 &&
+            (__sync_bool_compare_and_swap(&entry->apqn, 0, apqn) ||
+             entry->apqn == apqn))
+            return entry;
+    }
+
+    TRACE_WARNING("%s no free APQN statistics entry for %02X.%04X\n",
+                  __func__, adapter, domain);
+    return NULL;
+}
+
+static CK_RV lb_setup_handler(uint_32 adapter, uint_32 domain,
+                              void *handler_data)
+{
+    struct lb_setup_data *data = handler_data;
+
+    if (data->num_apqns >= MAX_APQN)
+        return CKR_OK;
+
+    if (!is_apqn_online(adapter, domain))
+        return CKR_OK;
+
+    data->apqns[data->num_apqns].adapter = adapter;
+    data->apqns[data->num_apqns].domain = domain;
+    data->num_apqns++;
+
+    return CKR_OK;
+}
+
+/*
+ * Sets up a single APQN target for each online APQN of the token. Called when
+ * the target info is refreshed. Load balancing is not used when a concurrent
+ * master key change is active (single APQN mode), or when less than 2 APQNs
+ * are online.
+ */
+CK_RV ep11tok_lb_setup(STDLL_TokData_t *tokdata,
+                       ep11_target_info_t *target_info)
+{
+    ep11_private_data_t *ep11_data = tokdata->private_data;
+    struct lb_setup_data data;
+    unsigned int i;
+    CK_RV rc;
+
+    if (!ep11_data->apqn_load_balancing || target_info->single_apqn)
+        return CKR_OK;
+
+    memset(&data, 0, sizeof(data));
+    data.apqns = calloc(MAX_APQN, sizeof(ep11_lb_apqn_t));
+    if (data.apqns == NULL) {
+        TRACE_ERROR("%s Memory allocation failed\n", __func__);
+        return CKR_HOST_MEMORY;
+    }
+
+    rc = handle_all_ep11_cards(&ep11_data->target_list, lb_setup_handler,
+                               &data);
+    if (rc != CKR_OK) {
+        TRACE_ERROR("%s handle_all_ep11_cards failed: rc=0x%lx\n",
+                    __func__, rc);
+        goto error;
+    }
+
+    if (data.num_apqns < 2) {
+        TRACE_INFO("%s %u APQN(s) online, no load balancing\n", __func__,
+                   data.num_apqns);
+        free(data.apqns);
+        return CKR_OK;
+    }
+
+    for (i = 0; i < data.num_apqns; i++) {
+        rc = get_ep11_target_for_apqn(data.apqns[i].adapter,
+                                      data.apqns[i].domain,
+                                      &data.apqns[i].target, 0);
+        if (rc != CKR_OK) {
+            TRACE_ERROR("%s get_ep11_target_for_apqn (%02X.%04X) failed: "
+                        "rc=0x%lx\n", __func__, data.apqns[i].adapter,
+                        data.apqns[i].domain, rc);
+            data.num_apqns = i;
+            goto error;
+        }
+
+        data.apqns[i].stats = ep11tok_lb_stats_entry(ep11_data,
+                                                     data.apqns[i].adapter,
+                                                     data.apqns[i].domain);
+
+        TRACE_DEVEL("%s APQN %02X.%04X used for load balancing\n", __func__,
+                    data.apqns[i].adapter, data.apqns[i].domain);
+    }
+
+    target_info->lb_apqns = data.apqns;
+    target_info->num_lb_apqns = data.num_apqns;
+
+    return CKR_OK;
+
+error:
+    for (i = 0; i < data.num_apqns; i++)
+        free_ep11_target_for_apqn(data.apqns[i].target);
+    free(data.apqns);
+    return rc;
+}
+
+void ep11tok_lb_free(ep11_target_info_t *target_info)
+{
+    unsigned int i;
+
+    if (target_info->lb_apqns == NULL)
+        return;
+
+    for (i = 0; i < target_info->num_lb_apqns; i++)
+        free_ep11_target_for_apqn(target_info->lb_apqns[i].target);
+    free(target_info->lb_apqns);
+
+    target_info->lb_apqns = NULL;
+    target_info->num_lb_apqns = 0;
+}
+
+/*
+ * Selects the APQN with the smallest expected completion time for the next
+ * request, i.e. the number of requests in flight (including the new one)
+ * times the average latency of the APQN. APQNs without a latency sample yet
+ * are preferred. The scan starts at a rotating index, so that APQNs with the
+ * same score are used alternately. Every EP11_LB_PROBE_INTERVAL-th request
+ * is sent to the next APQN in turn, so that the latency of an APQN that
+ * recovered from a high load is noticed.
+ * Returns NULL if not load balancing, or if all APQNs went offline.
+ */
+ep11_lb_apqn_t *ep11tok_lb_select(ep11_target_info_t *target_info)
+{
+    ep11_lb_apqn_t *apqn, *best = NULL;
+    uint64_t score, best_score = UINT64_MAX;
+    unsigned long next;
+    unsigned int i, start;
+
+    if (target_info == NULL || target_info->lb_apqns == NULL)
+        return NULL;
+
+    next = __sync_fetch_and_add(&target_info->lb_next, 1);
+    start = next % target_info->num_lb_apqns;
+
+    if ((next % EP11_LB_PROBE_INTERVAL) == 0) {
+        /* Probe the APQNs in turn, independent of the number of APQNs */
+        apqn = &target_info->lb_apqns[(next / EP11_LB_PROBE_INTERVAL) %
+                                      target_info->num_lb_apqns];
+        if (!apqn->offline)
+            return apqn;
+    }
+
+    for (i = 0; i < target_info->num_lb_apqns; i++) {
+        apqn = &target_info->lb_apqns[(start + i) %
+                                      target_info->num_lb_apqns];
+        if (apqn->offline)
+            continue;
+
+        score = (apqn->inflight + 1) * apqn->latency_ns;
+        if (best == NULL || score < best_score) {
+            best = apqn;
+            best_score = score;
+        }
+        if (best_score == 0)
+            break;
+    }
+
+    return best;
+}
+
+/*
+ * Accounts a request to the selected APQN (if any), and returns the target to
+ * use for the request.
+ */
+target_t ep11tok_lb_begin(ep11_target_info_t *target_info,
+                          ep11_lb_apqn_t *apqn, struct timespec *start)
+{
+    if (apqn == NULL)
+        return target_info->target;
+
+    __sync_add_and_fetch(&apqn->inflight, 1);
+    if (apqn->stats != NULL)
+        __sync_add_and_fetch(&apqn->stats->inflight, 1);
+
+    clock_gettime(CLOCK_MONOTONIC, start);
+
+    return apqn->target;
+}
+
+/*
+ * Completes the accounting of a request started with ep11tok_lb_begin().
+ * Returns TRUE if the APQN went offline, the request should then be retried
+ * without load balancing. The APQN is not used anymore until the target info
+ * is refreshed.
+ */
+CK_BBOOL ep11tok_lb_end(ep11_lb_apqn_t *apqn, const struct timespec *start,
+                        CK_RV rc)
+{
+    uint64_t sample, old, new;
+    struct timespec end;
+    CK_BBOOL offline;
+
+    if (apqn == NULL)
+        return CK_FALSE;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sample = (uint64_t)(end.tv_sec - start->tv_sec) * 1000000000ULL +
+                                            end.tv_nsec - start->tv_nsec;
+
+    __sync_sub_and_fetch(&apqn->inflight, 1);
+
+    offline = (rc == CKR_IBM_TARGET_INVALID ||
+               (rc == CKR_FUNCTION_FAILED &&
+                !is_apqn_online(apqn->adapter, apqn->domain)));
+    if (offline) {
+        if (__sync_bool_compare_and_swap(&apqn->offline, 0, 1))
+            TRACE_WARNING("APQN %02X.%04X went offline, not used for load "
+                          "balancing anymore\n", apqn->adapter, apqn->domain);
+    } else {
+        do {
+            old = apqn->latency_ns;
+            if (old == 0)
+                new = sample;
+            else
+                new = old - (old >> EP11_LB_EWMA_SHIFT) +
+                                        (sample >> EP11_LB_EWMA_SHIFT);
+        } while (!__sync_bool_compare_and_swap(&apqn->latency_ns, old, new));
+    }
+
+    if (apqn->stats != NULL) {
+        __sync_sub_and_fetch(&apqn->stats->inflight, 1);
+        __sync_add_and_fetch(&apqn->stats->requests, 1);
+        if (rc != CKR_OK)
+            __sync_add_and_fetch(&apqn->stats->errors, 1);
+        __sync_add_and_fetch(&apqn->stats->latency_total_us, sample / 1000);
+        apqn->stats->latency_recent_us = apqn->latency_ns / 1000;
+    }
+
+    return offline;
+}
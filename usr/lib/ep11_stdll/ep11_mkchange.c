@@ -20,6 +20,7 @@
 
 #include "events.h"
 #include "hsm_mk_change.h"
+#include "hsm_mk_change_lock.h"
 #include "cfgparser.h"
 #include "ep11_specific.h"
 
@@ -488,36 +489,66 @@ struct reencipher_data {
     STDLL_TokData_t *tokdata;
     SESSION *session;
     ep11_target_info_t *target_info;
+    const char *op_id;
 };
 
-static CK_RV ep11tok_reencipher_objects_reenc(CK_BYTE *sec_key,
+/*
+ * Called concurrently by the re-encipher worker threads. Each call uses its
+ * own target info, because a retry may switch the target info.
+ */
+static CK_RV ep11tok_reencipher_objects_reenc(STDLL_TokData_t *tokdata,
+                                              OBJECT *obj,
+                                              CK_BYTE *sec_key,
                                               CK_BYTE *reenc_sec_key,
                                               CK_ULONG sec_key_len,
                                               void *private)
 {
     struct reencipher_data *rd = private;
+    ep11_target_info_t *target_info;
+    SESSION *session;
+    CK_RV rc;
+
+    /* session is NULL for token objects */
+    session = obj->session != NULL ? obj->session : rd->session;
+
+    target_info = get_target_info(tokdata);
+    if (target_info == NULL)
+        return CKR_FUNCTION_FAILED;
+
+    rc = ep11tok_reencipher_blob(tokdata, session, &target_info,
+                                 sec_key, sec_key_len, reenc_sec_key);
+
+    put_target_info(tokdata, target_info);
 
-    return ep11tok_reencipher_blob(rd->tokdata, rd->session, &rd->target_info,
-                                   sec_key, sec_key_len, reenc_sec_key);
+    return rc;
 }
 
-static CK_RV ep11tok_reencipher_objects_cb(STDLL_TokData_t *tokdata,
-                                           OBJECT *obj, void *cb_data)
+static CK_BBOOL ep11tok_reencipher_is_new_wk_cb(STDLL_TokData_t *tokdata,
+                                                OBJECT *obj,
+                                                CK_BYTE *sec_key,
+                                                CK_ULONG sec_key_len,
+                                                void *private)
 {
-    struct reencipher_data *rd = cb_data;
-    SESSION *session_save;
-    CK_RV rc;
+    UNUSED(obj);
+    UNUSED(private);
 
-    session_save = rd->session;
-    if (obj->session != NULL) /* session is NULL for token objects */
-        rd->session = obj->session;
-    rc = obj_mgr_reencipher_secure_key(tokdata, obj,
-                                       ep11tok_reencipher_objects_reenc, rd);
-    if (rc == CKR_OBJECT_HANDLE_INVALID) /* Obj was deleted by other proc */
-        rc = CKR_OK;
-    rd->session = session_save;
+    return ep11tok_is_blob_new_wkid(tokdata, sec_key, sec_key_len);
+}
 
-    return rc;
+static void ep11tok_reencipher_progress_cb(STDLL_TokData_t *tokdata,
+                                           unsigned long done,
+                                           unsigned long total,
+                                           void *private)
+{
+    struct reencipher_data *rd = private;
+    struct hsm_mk_change_progress progress;
+
+    progress.total = total;
+    progress.done = done;
+
+    if (hsm_mk_change_token_progress_save(rd->op_id, tokdata->slot_id,
+                                          &progress) != CKR_OK)
+        TRACE_DEVEL("%s failed to save the progress\n", __func__);
 }
 
 static CK_BBOOL ep11tok_reencipher_filter_cb(STDLL_TokData_t *tokdata,
@@ -547,19 +578,6 @@ static CK_RV ep11tok_reencipher_cancel_objects_cb(STDLL_TokData_t *tokdata,
     return rc;
 }
 
-static CK_BBOOL ep11tok_reencipher_finalize_is_new_wk_cb(
-                                                 STDLL_TokData_t *tokdata,
-                                                 OBJECT *obj,
-                                                 CK_BYTE *sec_key,
-                                                 CK_ULONG sec_key_len,
-                                                 void *cb_private)
-{
-    UNUSED(cb_private);
-    UNUSED(obj);
-
-    return ep11tok_is_blob_new_wkid(tokdata, sec_key, sec_key_len);
-}
-
 static CK_RV ep11tok_reencipher_finalize_objects_cb(STDLL_TokData_t *tokdata,
                                                     OBJECT *obj, void *cb_data)
 {
@@ -568,7 +586,7 @@ static CK_RV ep11tok_reencipher_finalize_objects_cb(STDLL_TokData_t *tokdata,
     UNUSED(cb_data);
 
     rc = obj_mgr_reencipher_secure_key_finalize(tokdata, obj,
-                                ep11tok_reencipher_finalize_is_new_wk_cb, NULL);
+                                ep11tok_reencipher_is_new_wk_cb, NULL);
     if (rc == CKR_ATTRIBUTE_TYPE_INVALID)
         rc = CKR_OK;
     if (rc == CKR_OBJECT_HANDLE_INVALID) /* Obj was deleted by other proc */
@@ -845,12 +863,13 @@ static CK_RV ep11tok_mk_change_reencipher(STDLL_TokData_t *tokdata,
         }
     }
 
-    if (pthread_rwlock_wrlock(&tokdata->hsm_mk_change_rwlock) != 0) {
+    if (hsm_mk_change_lock_exclusive(tokdata) != CKR_OK) {
         TRACE_DEVEL("HSM-MK-change Write-Lock failed.\n");
         OCK_SYSLOG(LOG_ERR, "Slot %lu: HSM-MK-change Write-Lock failed\n",
                    tokdata->slot_id);
-        rc = CKR_CANT_LOCK;
-        goto out;
+        if (rd.session != NULL)
+            session_mgr_put(tokdata, rd.session);
+        return CKR_CANT_LOCK;
     }
 
     if (token_objs == TRUE && ep11_data->mk_change_active == FALSE) {
@@ -920,11 +939,18 @@ static CK_RV ep11tok_mk_change_reencipher(STDLL_TokData_t *tokdata,
         goto out;
     }
 
-    /* Re-encipher key objects */
-    rc = obj_mgr_iterate_key_objects(tokdata, !token_objs, token_objs,
-                                     NULL, NULL,
-                                     ep11tok_reencipher_objects_cb, &rd,
-                                     TRUE, "re-encipher");
+    /*
+     * Re-encipher key objects. Relogin in strict session mode is not
+     * serialized per session, so use a single worker in that case.
+     */
+    rd.op_id = ep11_data->mk_change_op;
+    rc = obj_mgr_reencipher_key_objects(tokdata, !token_objs, token_objs,
+                                        NULL, ep11tok_reencipher_objects_reenc,
+                                        ep11tok_reencipher_is_new_wk_cb,
+                                        token_objs ?
+                                            ep11tok_reencipher_progress_cb :
+                                            NULL,
+                                        &rd, ep11_data->strict_mode ? 1 : 0);
     if (rc != CKR_OK)
         goto out;
 
@@ -982,7 +1008,7 @@ out:
     if (rd.session != NULL)
         session_mgr_put(tokdata, rd.session);
 
-    if (pthread_rwlock_unlock(&tokdata->hsm_mk_change_rwlock) != 0) {
+    if (hsm_mk_change_unlock_exclusive(tokdata) != CKR_OK) {
         TRACE_DEVEL("HSM-MK-change Unlock failed.\n");
         OCK_SYSLOG(LOG_ERR, "Slot %lu: HSM-MK-change unlock failed\n",
                    tokdata->slot_id);
@@ -1258,12 +1284,11 @@ static CK_RV ep11tok_mk_change_finalize_cancel(STDLL_TokData_t *tokdata,
         }
     }
 
-    if (pthread_rwlock_wrlock(&tokdata->hsm_mk_change_rwlock) != 0) {
+    if (hsm_mk_change_lock_exclusive(tokdata) != CKR_OK) {
         TRACE_DEVEL("HSM-MK-change Write-Lock failed.\n");
         OCK_SYSLOG(LOG_ERR, "Slot %lu: HSM-MK-change Write-Lock failed\n",
                    tokdata->slot_id);
-        rc = CKR_CANT_LOCK;
-        goto out;
+        return CKR_CANT_LOCK;
     }
 
     if (ep11_data->mk_change_active == FALSE)
@@ -1358,7 +1383,7 @@ static CK_RV ep11tok_mk_change_finalize_cancel(STDLL_TokData_t *tokdata,
     }
 
 out:
-    if (pthread_rwlock_unlock(&tokdata->hsm_mk_change_rwlock) != 0) {
+    if (hsm_mk_change_unlock_exclusive(tokdata) != CKR_OK) {
         TRACE_DEVEL("HSM-MK-change Unlock failed.\n");
         OCK_SYSLOG(LOG_ERR, "Slot %lu: HSM-MK-change unlock failed\n",
                    tokdata->slot_id);
@@ -167,7 +167,12 @@ static CK_RV get_control_points(STDLL_TokData_t * tokdata,
 
 static CK_RV ep11tok_get_ep11_library_version(CK_VERSION *lib_version);
 static void free_card_versions(ep11_card_version_t *card_version);
-static int check_card_version(STDLL_TokData_t *tokdata, CK_ULONG card_type,
+static void free_target_info(ep11_target_info_t *target_info);
+static void ep11tok_target_reader_release(void *ptr);
+static void reclaim_target_infos(ep11_private_data_t *ep11_data);
+static int check_card_version(STDLL_TokData_t *tokdata,
+                              ep11_target_info_t *target_info,
+                              CK_ULONG card_type,
                               const CK_VERSION *ep11_lib_version,
                               const CK_VERSION *firmware_version,
                               const CK_ULONG *firmware_API_version);
@@ -176,6 +181,10 @@ static int compare_ck_version(const CK_VERSION *v1, const CK_VERSION *v2);
 static int check_required_versions(STDLL_TokData_t *tokdata,
                                    const version_req_t req[],
                                    CK_ULONG num_req);
+static int check_target_versions(STDLL_TokData_t *tokdata,
+                                 ep11_target_info_t *target_info,
+                                 const version_req_t req[],
+                                 CK_ULONG num_req);
 
 static CK_RV h_opaque_2_blob(STDLL_TokData_t * tokdata, CK_OBJECT_HANDLE handle,
                              CK_BYTE ** blob, size_t * blob_len,
@@ -2992,6 +3001,20 @@ CK_RV ep11tok_init(STDLL_TokData_t * tokdata, CK_SLOT_ID SlotNumber,
 
     tokdata->private_data = ep11_data;
 
+    if (pthread_mutex_init(&ep11_data->target_retire_mutex, NULL) != 0) {
+        TRACE_ERROR("Initializing target retire lock failed.\n");
+        rc = CKR_CANT_LOCK;
+        goto error;
+    }
+
+    if (pthread_key_create(&ep11_data->target_reader_key,
+                           ep11tok_target_reader_release) != 0) {
+        TRACE_ERROR("Creating the target reader key failed.\n");
+        rc = CKR_FUNCTION_FAILED;
+        goto error;
+    }
+    ep11_data->target_reader_key_created = 1;
+
     /* read ep11 specific config file with user specified
      * adapter/domain pairs */
     rc = read_adapter_config_file(tokdata, conf_name);
@@ -3063,6 +3086,16 @@ CK_RV ep11tok_init(STDLL_TokData_t * tokdata, CK_SLOT_ID SlotNumber,
         goto error;
     }
 
+    rc = ep11tok_lb_stats_open(tokdata);
+    if (rc != CKR_OK) {
+        /* Not fatal, load balancing works without statistics */
+        TRACE_WARNING("%s Failed to open the APQN statistics rc=0x%lx\n",
+                      __func__, rc);
+        OCK_SYSLOG(LOG_WARNING, "Slot %lu: Failed to open the APQN "
+                   "statistics, no per-APQN statistics are collected\n",
+                   tokdata->slot_id);
+    }
+
     rc = refresh_target_info(tokdata, FALSE);
     if (rc != CKR_OK) {
         TRACE_ERROR("%s Failed to get the target info (refresh_target_info "
@@ -3128,17 +3161,29 @@ error:
 CK_RV ep11tok_final(STDLL_TokData_t * tokdata, CK_BBOOL in_fork_initializer)
 {
     ep11_private_data_t *ep11_data = tokdata->private_data;
+    ep11_target_info_t *target_info;
+    ep11_target_reader_t *reader;
 
     TRACE_INFO("ep11 %s running\n", __func__);
 
     if (ep11_data != NULL) {
-        if (ep11_data->target_info != NULL) {
-            if (dll_m_rm_module != NULL)
-                dll_m_rm_module(NULL, ep11_data->target_info->target);
-            free_card_versions(ep11_data->target_info->card_versions);
-            free((void* )ep11_data->target_info);
-        }
+        if (ep11_data->target_info != NULL)
+            free_target_info((ep11_target_info_t *)ep11_data->target_info);
+        while (ep11_data->target_retired != NULL) {
+            target_info = ep11_data->target_retired;
+            ep11_data->target_retired = target_info->retired_next;
+            free_target_info(target_info);
+        }
+        if (ep11_data->target_reader_key_created)
+            pthread_key_delete(ep11_data->target_reader_key);
+        while (ep11_data->target_readers != NULL) {
+            reader = ep11_data->target_readers;
+            ep11_data->target_readers = reader->next;
+            free(reader);
+        }
+        ep11tok_lb_stats_close(tokdata);
         pthread_rwlock_destroy(&ep11_data->target_rwlock);
+        pthread_mutex_destroy(&ep11_data->target_retire_mutex);
         pthread_mutex_destroy(&ep11_data->raw2key_wrap_blob_mutex);
         if (ep11_data->vhsm_mode || ep11_data->fips_session_mode)
             pthread_mutex_destroy(&ep11_data->session_mutex);
@@ -5939,6 +5984,7 @@ CK_RV token_specific_rsa_sign(STDLL_TokData_t *tokdata, SESSION *session,
                               CK_BYTE *out_data, CK_ULONG *out_data_len,
                               OBJECT *key_obj)
 {
+    target_t target;
     CK_RV rc;
     size_t keyblobsize = 0;
     CK_BYTE *keyblob;
@@ -5959,9 +6005,11 @@ CK_RV token_specific_rsa_sign(STDLL_TokData_t *tokdata, SESSION *session,
     RETRY_SESSION_SINGLE_APQN_START(rc, tokdata)
     RETRY_REENC_BLOB_START(tokdata, target_info, key_obj, keyblob, keyblobsize,
                            useblob, useblobsize, rc)
-        rc = dll_m_SignSingle(useblob, useblobsize, &mech,
-                              in_data, in_data_len,
-                              out_data, out_data_len, target_info->target);
+        LOAD_BALANCE_START(target_info, target)
+            rc = dll_m_SignSingle(useblob, useblobsize, &mech,
+                                  in_data, in_data_len,
+                                  out_data, out_data_len, target);
+        LOAD_BALANCE_END(rc)
     RETRY_REENC_BLOB_END(tokdata, target_info, useblob, useblobsize, rc)
     RETRY_SESSION_SINGLE_APQN_END(rc, tokdata, session)
     if (rc != CKR_OK) {
@@ -5979,6 +6027,7 @@ CK_RV token_specific_rsa_verify(STDLL_TokData_t *tokdata, SESSION *session,
                                 CK_BYTE *signature, CK_ULONG sig_len,
                                 OBJECT *key_obj)
 {
+    target_t target;
     CK_RV rc;
     CK_BYTE *spki;
     size_t spki_len = 0;
@@ -5999,9 +6048,11 @@ CK_RV token_specific_rsa_verify(STDLL_TokData_t *tokdata, SESSION *session,
     RETRY_SESSION_SINGLE_APQN_START(rc, tokdata)
     RETRY_REENC_BLOB_START(tokdata, target_info, key_obj, spki, spki_len,
                            useblob, useblob_len, rc)
-        rc = dll_m_VerifySingle(useblob, useblob_len, &mech,
-                                in_data, in_data_len,
-                                signature, sig_len, target_info->target);
+        LOAD_BALANCE_START(target_info, target)
+            rc = dll_m_VerifySingle(useblob, useblob_len, &mech,
+                                    in_data, in_data_len,
+                                    signature, sig_len, target);
+        LOAD_BALANCE_END(rc)
     RETRY_REENC_BLOB_END(tokdata, target_info, useblob, useblob_len, rc)
     RETRY_SESSION_SINGLE_APQN_END(rc, tokdata, session)
     if (rc != CKR_OK) {
@@ -6019,6 +6070,7 @@ CK_RV token_specific_rsa_pss_sign(STDLL_TokData_t *tokdata, SESSION *session,
                                   CK_BYTE *in_data, CK_ULONG in_data_len,
                                   CK_BYTE *sig, CK_ULONG *sig_len)
 {
+    target_t target;
     CK_RV rc;
     size_t keyblobsize = 0;
     CK_BYTE *keyblob;
@@ -6041,8 +6093,10 @@ CK_RV token_specific_rsa_pss_sign(STDLL_TokData_t *tokdata, SESSION *session,
     RETRY_SESSION_SINGLE_APQN_START(rc, tokdata)
     RETRY_REENC_BLOB_START(tokdata, target_info, key_obj, keyblob, keyblobsize,
                            useblob, useblobsize, rc)
-        rc = dll_m_SignSingle(useblob, useblobsize, &mech, in_data, in_data_len,
-                              sig, sig_len, target_info->target);
+        LOAD_BALANCE_START(target_info, target)
+            rc = dll_m_SignSingle(useblob, useblobsize, &mech, in_data, in_data_len,
+                                  sig, sig_len, target);
+        LOAD_BALANCE_END(rc)
     RETRY_REENC_BLOB_END(tokdata, target_info, useblob, useblobsize, rc)
     RETRY_SESSION_SINGLE_APQN_END(rc, tokdata, session)
     if (rc != CKR_OK) {
@@ -6063,6 +6117,7 @@ CK_RV token_specific_rsa_pss_verify(STDLL_TokData_t *tokdata, SESSION *session,
                                     CK_BYTE *in_data, CK_ULONG in_data_len,
                                     CK_BYTE *signature, CK_ULONG sig_len)
 {
+    target_t target;
     CK_RV rc;
     CK_BYTE *spki;
     size_t spki_len = 0;
@@ -6085,9 +6140,11 @@ CK_RV token_specific_rsa_pss_verify(STDLL_TokData_t *tokdata, SESSION *session,
     RETRY_SESSION_SINGLE_APQN_START(rc, tokdata)
     RETRY_REENC_BLOB_START(tokdata, target_info, key_obj, spki, spki_len,
                            useblob, useblob_len, rc)
-        rc = dll_m_VerifySingle(useblob, useblob_len, &mech,
-                                in_data, in_data_len,
-                                signature, sig_len, target_info->target);
+        LOAD_BALANCE_START(target_info, target)
+            rc = dll_m_VerifySingle(useblob, useblob_len, &mech,
+                                    in_data, in_data_len,
+                                    signature, sig_len, target);
+        LOAD_BALANCE_END(rc)
     RETRY_REENC_BLOB_END(tokdata, target_info, useblob, useblob_len, rc)
     RETRY_SESSION_SINGLE_APQN_END(rc, tokdata, session)
     if (rc != CKR_OK) {
@@ -6111,6 +6168,7 @@ CK_RV token_specific_ec_sign(STDLL_TokData_t *tokdata, SESSION  *session,
 #ifndef NO_PKEY
     SIGN_VERIFY_CONTEXT *ctx = &(session->sign_ctx);
 #endif
+    target_t target;
     CK_RV rc;
     size_t keyblobsize = 0;
     CK_BYTE *keyblob;
@@ -6146,8 +6204,10 @@ CK_RV token_specific_ec_sign(STDLL_TokData_t *tokdata, SESSION  *session,
     RETRY_SESSION_SINGLE_APQN_START(rc, tokdata)
     RETRY_REENC_BLOB_START(tokdata, target_info, key_obj, keyblob, keyblobsize,
                            useblob, useblobsize, rc)
-        rc = dll_m_SignSingle(useblob, useblobsize, &mech, in_data, in_data_len,
-                              out_data, out_data_len, target_info->target);
+        LOAD_BALANCE_START(target_info, target)
+            rc = dll_m_SignSingle(useblob, useblobsize, &mech, in_data, in_data_len,
+                                  out_data, out_data_len, target);
+        LOAD_BALANCE_END(rc)
     RETRY_REENC_BLOB_END(tokdata, target_info, useblob, useblobsize, rc)
     RETRY_SESSION_SINGLE_APQN_END(rc, tokdata, session)
     if (rc != CKR_OK) {
@@ -6172,6 +6232,7 @@ CK_RV token_specific_ec_verify(STDLL_TokData_t *tokdata, SESSION  *session,
 #ifndef NO_PKEY
     SIGN_VERIFY_CONTEXT *ctx = &(session->verify_ctx);
 #endif
+    target_t target;
     CK_RV rc;
     CK_BYTE *spki;
     size_t spki_len = 0;
@@ -6206,9 +6267,11 @@ CK_RV token_specific_ec_verify(STDLL_TokData_t *tokdata, SESSION  *session,
     RETRY_SESSION_SINGLE_APQN_START(rc, tokdata)
     RETRY_REENC_BLOB_START(tokdata, target_info, key_obj, spki, spki_len,
                            useblob, useblob_len, rc)
-        rc = dll_m_VerifySingle(useblob, useblob_len, &mech,
-                                in_data, in_data_len,
-                                out_data, out_data_len, target_info->target);
+        LOAD_BALANCE_START(target_info, target)
+            rc = dll_m_VerifySingle(useblob, useblob_len, &mech,
+                                    in_data, in_data_len,
+                                    out_data, out_data_len, target);
+        LOAD_BALANCE_END(rc)
     RETRY_REENC_BLOB_END(tokdata, target_info, useblob, useblob_len, rc)
     RETRY_SESSION_SINGLE_APQN_END(rc, tokdata, session)
     if (rc != CKR_OK) {
@@ -9731,6 +9794,7 @@ CK_RV ep11tok_sign(STDLL_TokData_t * tokdata, SESSION * session,
     OBJECT *key_obj = NULL;
     CK_BYTE *state;
     size_t state_len;
+    target_t target;
 
     rc = h_opaque_2_blob(tokdata, ctx->key, &keyblob, &keyblobsize, &key_obj,
                           READ_LOCK);
@@ -9766,9 +9830,11 @@ CK_RV ep11tok_sign(STDLL_TokData_t * tokdata, SESSION * session,
                             ctx->context, ctx->context_len / 2,
                             ctx->context + (ctx->context_len / 2),
                             ctx->context_len / 2, state, state_len)
-        rc = dll_m_Sign(state, state_len,
-                        in_data, in_data_len,
-                        signature, sig_len, target_info->target);
+        LOAD_BALANCE_START(target_info, target)
+            rc = dll_m_Sign(state, state_len,
+                            in_data, in_data_len,
+                            signature, sig_len, target);
+        LOAD_BALANCE_END(rc)
     RETRY_UPDATE_BLOB_END(tokdata, session, target_info,
                           ctx->context, ctx->context_len / 2,
                           ctx->context + (ctx->context_len / 2),
@@ -9906,6 +9972,7 @@ CK_RV ep11tok_sign_single(STDLL_TokData_t *tokdata, SESSION *session,
                           CK_ULONG in_data_len, CK_BYTE *signature,
                           CK_ULONG *sig_len)
 {
+    target_t target;
     CK_RV rc;
     size_t keyblobsize = 0;
     CK_BYTE *keyblob;
@@ -9953,12 +10020,15 @@ CK_RV ep11tok_sign_single(STDLL_TokData_t *tokdata, SESSION *session,
     RETRY_REENC_BLOB_START(tokdata, target_info, key_obj, keyblob, keyblobsize,
                            useblob, useblobsize, rc)
         if (ep11_pqc_obj_strength_supported(target_info, ep11_mech.mechanism,
-                                            key_obj))
-            rc = dll_m_SignSingle(useblob, useblobsize, &ep11_mech,
-                                  in_data, in_data_len,
-                                  signature, sig_len, target_info->target);
-        else
+                                            key_obj)) {
+            LOAD_BALANCE_START(target_info, target)
+                rc = dll_m_SignSingle(useblob, useblobsize, &ep11_mech,
+                                      in_data, in_data_len,
+                                      signature, sig_len, target);
+            LOAD_BALANCE_END(rc)
+        } else {
             rc = CKR_KEY_SIZE_RANGE;
+        }
     RETRY_REENC_BLOB_END(tokdata, target_info, useblob, useblobsize, rc)
     RETRY_SESSION_SINGLE_APQN_END(rc, tokdata, session)
     if (rc != CKR_OK) {
@@ -10182,6 +10252,7 @@ CK_RV ep11tok_verify(STDLL_TokData_t * tokdata, SESSION * session,
     OBJECT *key_obj = NULL;
     CK_BYTE *state;
     size_t state_len;
+    target_t target;
 
     rc = h_opaque_2_blob(tokdata, ctx->key, &keyblob, &keyblobsize, &key_obj,
                          READ_LOCK);
@@ -10216,9 +10287,11 @@ CK_RV ep11tok_verify(STDLL_TokData_t * tokdata, SESSION * session,
                             ctx->context, ctx->context_len / 2,
                             ctx->context + (ctx->context_len / 2),
                             ctx->context_len / 2, state, state_len)
-        rc = dll_m_Verify(state, state_len,
-                          in_data, in_data_len,
-                          signature, sig_len, target_info->target);
+        LOAD_BALANCE_START(target_info, target)
+            rc = dll_m_Verify(state, state_len,
+                              in_data, in_data_len,
+                              signature, sig_len, target);
+        LOAD_BALANCE_END(rc)
     RETRY_UPDATE_BLOB_END(tokdata, session, target_info,
                           ctx->context, ctx->context_len / 2,
                           ctx->context + (ctx->context_len / 2),
@@ -10354,6 +10427,7 @@ CK_RV ep11tok_verify_single(STDLL_TokData_t *tokdata, SESSION *session,
                             CK_BYTE *in_data, CK_ULONG in_data_len,
                             CK_BYTE *signature, CK_ULONG sig_len)
 {
+    target_t target;
     CK_RV rc;
     CK_BYTE *spki;
     size_t spki_len = 0;
@@ -10408,12 +10482,15 @@ CK_RV ep11tok_verify_single(STDLL_TokData_t *tokdata, SESSION *session,
     RETRY_REENC_BLOB_START(tokdata, target_info, key_obj, spki, spki_len,
                            useblob, useblob_len, rc)
         if (ep11_pqc_obj_strength_supported(target_info, ep11_mech.mechanism,
-                                            key_obj))
-            rc = dll_m_VerifySingle(useblob, useblob_len, &ep11_mech,
-                                    in_data, in_data_len,
-                                    signature, sig_len, target_info->target);
-        else
+                                            key_obj)) {
+            LOAD_BALANCE_START(target_info, target)
+                rc = dll_m_VerifySingle(useblob, useblob_len, &ep11_mech,
+                                        in_data, in_data_len,
+                                        signature, sig_len, target);
+            LOAD_BALANCE_END(rc)
+        } else {
             rc = CKR_KEY_SIZE_RANGE;
+        }
     RETRY_REENC_BLOB_END(tokdata, target_info, useblob, useblob_len, rc)
     RETRY_SESSION_SINGLE_APQN_END(rc, tokdata, session)
     if (rc != CKR_OK) {
@@ -10502,6 +10579,7 @@ CK_RV ep11tok_decrypt(STDLL_TokData_t * tokdata, SESSION * session,
     OBJECT *key_obj = NULL;
     CK_BYTE *state;
     size_t state_len;
+    target_t target;
 
     if (ctx->pkey_active) {
         rc = decr_mgr_decrypt(tokdata, session, length_only, ctx,
@@ -10522,9 +10600,11 @@ CK_RV ep11tok_decrypt(STDLL_TokData_t * tokdata, SESSION * session,
                             ctx->context, ctx->context_len / 2,
                             ctx->context + (ctx->context_len / 2),
                             ctx->context_len / 2, state, state_len)
-        rc = dll_m_Decrypt(state, state_len, input_data,
-                           input_data_len, output_data, p_output_data_len,
-                           target_info->target);
+        LOAD_BALANCE_START(target_info, target)
+            rc = dll_m_Decrypt(state, state_len, input_data,
+                               input_data_len, output_data, p_output_data_len,
+                               target);
+        LOAD_BALANCE_END(rc)
     RETRY_UPDATE_BLOB_END(tokdata, session, target_info,
                           ctx->context, ctx->context_len / 2,
                           ctx->context + (ctx->context_len / 2),
@@ -10623,6 +10703,7 @@ CK_RV ep11tok_decrypt_single(STDLL_TokData_t *tokdata, SESSION *session,
                              CK_ULONG input_data_len, CK_BYTE_PTR output_data,
                              CK_ULONG_PTR p_output_data_len)
 {
+    target_t target;
     CK_RV rc;
     size_t keyblobsize = 0;
     CK_BYTE *keyblob;
@@ -10665,13 +10746,15 @@ CK_RV ep11tok_decrypt_single(STDLL_TokData_t *tokdata, SESSION *session,
     RETRY_REENC_BLOB_START(tokdata, target_info, key_obj, keyblob, keyblobsize,
                            useblob, useblobsize, rc)
         if (ep11_pqc_obj_strength_supported(target_info, mech->mechanism,
-                                            key_obj))
-            rc = dll_m_DecryptSingle(useblob, useblobsize, mech, input_data,
-                                     input_data_len, output_data,
-                                     p_output_data_len,
-                                     target_info->target);
-        else
+                                            key_obj)) {
+            LOAD_BALANCE_START(target_info, target)
+                rc = dll_m_DecryptSingle(useblob, useblobsize, mech, input_data,
+                                         input_data_len, output_data,
+                                         p_output_data_len, target);
+            LOAD_BALANCE_END(rc)
+        } else {
             rc = CKR_KEY_SIZE_RANGE;
+        }
     RETRY_REENC_BLOB_END(tokdata, target_info, useblob, useblobsize, rc)
     RETRY_SESSION_SINGLE_APQN_END(rc, tokdata, session)
 
@@ -10759,6 +10842,7 @@ CK_RV ep11tok_encrypt(STDLL_TokData_t * tokdata, SESSION * session,
     OBJECT *key_obj = NULL;
     CK_BYTE *state;
     size_t state_len;
+    target_t target;
 
     if (ctx->pkey_active) {
         rc = encr_mgr_encrypt(tokdata, session, length_only, ctx,
@@ -10779,9 +10863,11 @@ CK_RV ep11tok_encrypt(STDLL_TokData_t * tokdata, SESSION * session,
                             ctx->context, ctx->context_len / 2,
                             ctx->context + (ctx->context_len / 2),
                             ctx->context_len / 2, state, state_len)
-        rc = dll_m_Encrypt(state, state_len, input_data,
-                           input_data_len, output_data, p_output_data_len,
-                           target_info->target);
+        LOAD_BALANCE_START(target_info, target)
+            rc = dll_m_Encrypt(state, state_len, input_data,
+                               input_data_len, output_data, p_output_data_len,
+                               target);
+        LOAD_BALANCE_END(rc)
     RETRY_UPDATE_BLOB_END(tokdata, session, target_info,
                           ctx->context, ctx->context_len / 2,
                           ctx->context + (ctx->context_len / 2),
@@ -10872,6 +10958,7 @@ CK_RV ep11tok_encrypt_single(STDLL_TokData_t *tokdata, SESSION *session,
                              CK_ULONG input_data_len, CK_BYTE_PTR output_data,
                              CK_ULONG_PTR p_output_data_len)
 {
+    target_t target;
     CK_RV rc;
     size_t keyblobsize = 0;
     CK_BYTE *keyblob;
@@ -10925,13 +11012,15 @@ CK_RV ep11tok_encrypt_single(STDLL_TokData_t *tokdata, SESSION *session,
     RETRY_REENC_BLOB_START(tokdata, target_info, key_obj, keyblob, keyblobsize,
                            useblob, useblobsize, rc)
         if (ep11_pqc_obj_strength_supported(target_info, mech->mechanism,
-                                            key_obj))
-            rc = dll_m_EncryptSingle(useblob, useblobsize, mech, input_data,
-                                     input_data_len, output_data,
-                                     p_output_data_len,
-                                     target_info->target);
-        else
+                                            key_obj)) {
+            LOAD_BALANCE_START(target_info, target)
+                rc = dll_m_EncryptSingle(useblob, useblobsize, mech, input_data,
+                                         input_data_len, output_data,
+                                         p_output_data_len, target);
+            LOAD_BALANCE_END(rc)
+        } else {
             rc = CKR_KEY_SIZE_RANGE;
+        }
     RETRY_REENC_BLOB_END(tokdata, target_info, useblob, useblobsize, rc)
     RETRY_SESSION_SINGLE_APQN_END(rc, tokdata, session)
     if (rc != CKR_OK) {
@@ -12352,29 +12441,28 @@ out:
 }
 
 
-CK_RV ep11tok_is_mechanism_supported(STDLL_TokData_t *tokdata,
-                                     CK_MECHANISM_TYPE type)
+/*
+ * Checks if a mechanism is supported by the APQNs of the specified target info.
+ * SHA3 combined libica-only mechanisms and PKCS#11 v3.0 SHA3 mechanisms must
+ * already be resolved by the caller. Capability flags that must be evaluated
+ * at usage time are returned in *flags.
+ */
+static CK_RV ep11tok_check_mech_for_target(STDLL_TokData_t *tokdata,
+                                           ep11_target_info_t *target_info,
+                                           CK_MECHANISM_TYPE type,
+                                           CK_FLAGS *flags)
 {
     ep11_private_data_t *ep11_data = tokdata->private_data;
     CK_VERSION ver1_3 = { .major = 1, .minor = 3 };
     CK_VERSION ver3 = { .major = 3, .minor = 0 };
     CK_VERSION ver3_1 = { .major = 3, .minor = 0x10 };
     CK_VERSION ver4 = { .major = 4, .minor = 0 };
+    CK_FLAGS dep_flags = 0;
     CK_BBOOL found = FALSE;
     CK_ULONG i;
     int status;
-    CK_RV rc = CKR_OK;
-    ep11_target_info_t* target_info;
-    CK_MECHANISM_TYPE orig_mech = type;
-    const struct sha_combined *comb_mech;
 
-    comb_mech = ep11tok_find_sha3_combined_libica_only_mech(tokdata, type);
-    if (comb_mech != NULL &&
-        ep11tok_is_mechanism_supported(tokdata,
-                                       comb_mech->hash_mech) == CKR_OK)
-        type = comb_mech->base_mech;
-
-    ep11tok_pkcs11_mech_translate(tokdata, type, &type);
+    *flags = 0;
 
     for (i = 0; i < supported_mech_list_len; i++) {
         if (type == ep11_supported_mech_list[i]) {
@@ -12389,18 +12477,13 @@ CK_RV ep11tok_is_mechanism_supported(STDLL_TokData_t *tokdata,
         return CKR_MECHANISM_INVALID;
     }
 
-    target_info = get_target_info(tokdata);
-    if (target_info == NULL)
-        return CKR_FUNCTION_FAILED;
-
     if (check_cps_for_mechanism(tokdata, ep11_data->cp_config,
                                 type, target_info->control_points,
                                 target_info->control_points_len,
                                 target_info->max_control_point_index) != CKR_OK) {
         TRACE_INFO("%s Mech '%s' banned due to control point\n",
-                   __func__, ep11_get_ckm(tokdata, orig_mech));
-        rc = CKR_MECHANISM_INVALID;
-        goto out;
+                   __func__, ep11_get_ckm(tokdata, type));
+        return CKR_MECHANISM_INVALID;
     }
 
     switch(type) {
@@ -12425,31 +12508,34 @@ CK_RV ep11tok_is_mechanism_supported(STDLL_TokData_t *tokdata,
          * HMAC mechanisms are only supported when all configured EP11
          * crypto adapters either have the fix, or all don't have the fix.
          */
-        status = check_required_versions(tokdata, hmac_req_versions,
-                                         NUM_HMAC_REQ);
+        status = check_target_versions(tokdata, target_info,
+                                       hmac_req_versions, NUM_HMAC_REQ);
         if (status == -1) {
             TRACE_INFO("%s Mech '%s' banned due to old card or mixed firmware versions\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
         break;
 
     case CKM_RSA_PKCS_OAEP:
         /* CKM_RSA_PKCS_OAEP is not supported with EP11 host library <= 1.3 */
-        if (compare_ck_version(&ep11_data->ep11_lib_version, &ver1_3) <= 0) {
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
-        }
+        if (compare_ck_version(&ep11_data->ep11_lib_version, &ver1_3) <= 0)
+            return CKR_MECHANISM_INVALID;
 
-        status = check_required_versions(tokdata, oaep_req_versions,
-                                         NUM_OAEP_REQ);
+        status = check_target_versions(tokdata, target_info,
+                                       oaep_req_versions, NUM_OAEP_REQ);
         if (status != 1) {
             TRACE_INFO("%s Mech '%s' banned due to old card or mixed firmware versions\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
+
+        /* SHA-2 hashing for OAEP requires all APQNs at the newer level */
+        status = check_target_versions(tokdata, target_info,
+                                       oaep_sha2_req_versions,
+                                       NUM_OAEP_SHA2_REQ);
+        if (status != 1)
+            *flags |= EP11_MECH_CAP_OAEP_SHA1;
         break;
 
     case CKM_IBM_SHA3_224:
@@ -12460,13 +12546,12 @@ CK_RV ep11tok_is_mechanism_supported(STDLL_TokData_t *tokdata,
     case CKM_IBM_SHA3_256_HMAC:
     case CKM_IBM_SHA3_384_HMAC:
     case CKM_IBM_SHA3_512_HMAC:
-        status = check_required_versions(tokdata, ibm_sha3_req_versions,
-                                         NUM_IBM_SHA3_REQ);
+        status = check_target_versions(tokdata, target_info,
+                                       ibm_sha3_req_versions, NUM_IBM_SHA3_REQ);
         if (status != 1) {
             TRACE_INFO("%s Mech '%s' banned due to old card or mixed firmware versions\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
         break;
 
@@ -12474,13 +12559,12 @@ CK_RV ep11tok_is_mechanism_supported(STDLL_TokData_t *tokdata,
     case CKM_DES3_CMAC_GENERAL:
     case CKM_AES_CMAC:
     case CKM_AES_CMAC_GENERAL:
-        status = check_required_versions(tokdata, cmac_req_versions,
-                                         NUM_CMAC_REQ);
+        status = check_target_versions(tokdata, target_info,
+                                       cmac_req_versions, NUM_CMAC_REQ);
         if (status != 1) {
             TRACE_INFO("%s Mech '%s' banned due to old card or mixed firmware versions\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
         break;
 
@@ -12490,52 +12574,47 @@ CK_RV ep11tok_is_mechanism_supported(STDLL_TokData_t *tokdata,
     case CKM_IBM_ED448_SHA3:
         if (compare_ck_version(&ep11_data->ep11_lib_version, &ver3) < 0) {
             TRACE_INFO("%s Mech '%s' banned due to host library version\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
 
-        status = check_required_versions(tokdata, edwards_req_versions,
-                                         NUM_EDWARDS_REQ);
+        status = check_target_versions(tokdata, target_info,
+                                       edwards_req_versions, NUM_EDWARDS_REQ);
         if (status != 1) {
             TRACE_INFO("%s Mech '%s' banned due to old card or mixed firmware versions\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
         break;
 
     case CKM_IBM_DILITHIUM:
         if (compare_ck_version(&ep11_data->ep11_lib_version, &ver3) <= 0) {
             TRACE_INFO("%s Mech '%s' banned due to host library version\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
-        status = check_required_versions(tokdata, ibm_dilithium_req_versions,
-                                         NUM_DILITHIUM_REQ);
+        status = check_target_versions(tokdata, target_info,
+                                       ibm_dilithium_req_versions,
+                                       NUM_DILITHIUM_REQ);
         if (status != 1) {
             TRACE_INFO("%s Mech '%s' banned due to old card or mixed firmware versions\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
         break;
 
     case CKM_IBM_KYBER:
         if (compare_ck_version(&ep11_data->ep11_lib_version, &ver4) < 0) {
             TRACE_INFO("%s Mech '%s' banned due to host library version\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
-        status = check_required_versions(tokdata, ibm_kyber_req_versions,
-                                         NUM_KYBER_REQ);
+        status = check_target_versions(tokdata, target_info,
+                                       ibm_kyber_req_versions, NUM_KYBER_REQ);
         if (status != 1) {
             TRACE_INFO("%s Mech '%s' banned due to old card or mixed firmware versions\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
         break;
 
@@ -12543,18 +12622,16 @@ CK_RV ep11tok_is_mechanism_supported(STDLL_TokData_t *tokdata,
     case CKM_IBM_CPACF_WRAP:
         if (compare_ck_version(&ep11_data->ep11_lib_version, &ver3) <= 0) {
             TRACE_INFO("%s Mech '%s' banned due to host library version\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
-        status = check_required_versions(tokdata, ibm_cpacf_wrap_req_versions,
-                                         NUM_CPACF_WRAP_REQ);
+        status = check_target_versions(tokdata, target_info,
+                                       ibm_cpacf_wrap_req_versions,
+                                       NUM_CPACF_WRAP_REQ);
         if (status != 1) {
             TRACE_INFO("%s Mech '%s' banned due to old card or mixed firmware versions\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
         break;
 #endif /* NO_PKEY */
@@ -12562,64 +12639,228 @@ CK_RV ep11tok_is_mechanism_supported(STDLL_TokData_t *tokdata,
     case CKM_IBM_BTC_DERIVE:
         if (compare_ck_version(&ep11_data->ep11_lib_version, &ver3_1) < 0) {
             TRACE_INFO("%s Mech '%s' banned due to host library version\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
-        status = check_required_versions(tokdata, ibm_btc_req_versions,
-                                         NUM_BTC_REQ);
+        status = check_target_versions(tokdata, target_info,
+                                       ibm_btc_req_versions, NUM_BTC_REQ);
         if (status != 1) {
             TRACE_INFO("%s Mech '%s' banned due to old card or mixed firmware versions\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
         break;
 
     case CKM_IBM_ECDSA_OTHER:
         if (compare_ck_version(&ep11_data->ep11_lib_version, &ver3_1) < 0) {
             TRACE_INFO("%s Mech '%s' banned due to host library version\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
-        status = check_required_versions(tokdata, ibm_ecdsa_other_req_versions,
-                                         NUM_ECDSA_OTHER_REQ);
+        status = check_target_versions(tokdata, target_info,
+                                       ibm_ecdsa_other_req_versions,
+                                       NUM_ECDSA_OTHER_REQ);
         if (status != 1) {
             TRACE_INFO("%s Mech '%s' banned due to old card or mixed firmware versions\n",
-                       __func__, ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       __func__, ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
         break;
 
     case CKM_AES_XTS:
     case CKM_AES_XTS_KEY_GEN:
-        if ((ep11_data->pkey_wrap_support_checked && !ep11_data->pkey_wrap_supported) ||
-            ep11tok_pkey_option_disabled(tokdata) || ep11_data->msa_level < 4 ||
-            ep11tok_is_mechanism_supported(tokdata, CKM_IBM_CPACF_WRAP) != CKR_OK ||
-            ep11tok_is_mechanism_supported(tokdata, CKM_AES_KEY_GEN) != CKR_OK) {
+        /*
+         * The protected key support state may change later on, it is
+         * checked by ep11tok_is_mechanism_supported() on every call.
+         */
+        if (ep11tok_check_mech_for_target(tokdata, target_info,
+                                          CKM_IBM_CPACF_WRAP,
+                                          &dep_flags) != CKR_OK ||
+            ep11tok_check_mech_for_target(tokdata, target_info,
+                                          CKM_AES_KEY_GEN, &dep_flags) != CKR_OK) {
             TRACE_INFO("%s Mech '%s' not suppported\n", __func__,
-                       ep11_get_ckm(tokdata, orig_mech));
-            rc = CKR_MECHANISM_INVALID;
-            goto out;
+                       ep11_get_ckm(tokdata, type));
+            return CKR_MECHANISM_INVALID;
         }
+        *flags |= EP11_MECH_CAP_PKEY;
         break;
     }
 
+
+    return CKR_OK;
+}
+
+static CK_ULONG ep11tok_mech_cap_hash(CK_MECHANISM_TYPE mech, CK_ULONG size)
+{
+    return ((mech ^ (mech >> 16)) * 2654435761UL) & (size - 1);
+}
+
+static ep11_mech_cap_t *ep11tok_find_mech_cap(ep11_target_info_t *target_info,
+                                              CK_MECHANISM_TYPE mech)
+{
+    CK_ULONG idx;
+
+    if (target_info->mech_caps == NULL)
+        return NULL;
+
+    idx = ep11tok_mech_cap_hash(mech, target_info->mech_caps_size);
+    while (target_info->mech_caps[idx].flags & EP11_MECH_CAP_USED) {
+        if (target_info->mech_caps[idx].mech == mech)
+            return &target_info->mech_caps[idx];
+        idx = (idx + 1) & (target_info->mech_caps_size - 1);
+    }
+
+    return NULL;
+}
+
+static ep11_mech_cap_t *ep11tok_add_mech_cap(ep11_target_info_t *target_info,
+                                             CK_MECHANISM_TYPE mech)
+{
+    ep11_mech_cap_t *cap;
+    CK_ULONG idx;
+
+    idx = ep11tok_mech_cap_hash(mech, target_info->mech_caps_size);
+    while (target_info->mech_caps[idx].flags & EP11_MECH_CAP_USED) {
+        if (target_info->mech_caps[idx].mech == mech)
+            return &target_info->mech_caps[idx];
+        idx = (idx + 1) & (target_info->mech_caps_size - 1);
+    }
+
+    cap = &target_info->mech_caps[idx];
+    cap->mech = mech;
+    cap->rc = CKR_MECHANISM_INVALID;
+    cap->flags = EP11_MECH_CAP_USED;
+    return cap;
+}
+
+/*
+ * Builds the mechanism capability table of a target info. It contains all
+ * mechanisms that can possibly be supported by the token: the EP11 mechanisms,
+ * the PKCS#11 v3.0 SHA3 mechanisms and the SHA3 combined libica-only
+ * mechanisms. Mechanisms not contained are not supported.
+ */
+static CK_RV ep11tok_build_mech_caps(STDLL_TokData_t *tokdata,
+                                     ep11_target_info_t *target_info)
+{
+    ep11_mech_cap_t *cap, *hash_cap, *base_cap;
+    CK_ULONG i, num, size = 1;
+    CK_FLAGS flags;
+
+    num = supported_mech_list_len + pkcs11_mechanism_translation_len +
+                                    sha3_combined_libica_only_mechs_len;
+    /* Keep the load factor below 50% to keep the probe sequences short */
+    while (size < 2 * num)
+        size <<= 1;
+
+    target_info->mech_caps = calloc(size, sizeof(ep11_mech_cap_t));
+    if (target_info->mech_caps == NULL) {
+        TRACE_ERROR("%s Memory allocation failed\n", __func__);
+        return CKR_HOST_MEMORY;
+    }
+    target_info->mech_caps_size = size;
+
+    for (i = 0; i < supported_mech_list_len; i++) {
+        cap = ep11tok_add_mech_cap(target_info, ep11_supported_mech_list[i]);
+        cap->rc = ep11tok_check_mech_for_target(tokdata, target_info,
+                                                ep11_supported_mech_list[i],
+                                                &flags);
+        cap->flags |= flags;
+    }
+
+    for (i = 0; i < pkcs11_mechanism_translation_len; i++) {
+        base_cap = ep11tok_find_mech_cap(target_info,
+                                pkcs11_mechanism_translation[i].ep11_mech);
+        cap = ep11tok_add_mech_cap(target_info,
+                                pkcs11_mechanism_translation[i].pkcs11_mech);
+        if (base_cap != NULL) {
+            cap->rc = base_cap->rc;
+            cap->flags |= base_cap->flags;
+        }
+    }
+
+    /*
+     * Whether the hash mechanism is available via libica is only known after
+     * libica has been loaded, so this is checked at usage time.
+     */
+    for (i = 0; i < sha3_combined_libica_only_mechs_len; i++) {
+        hash_cap = ep11tok_find_mech_cap(target_info,
+                                sha3_combined_libica_only_mechs[i].hash_mech);
+        base_cap = ep11tok_find_mech_cap(target_info,
+                                sha3_combined_libica_only_mechs[i].base_mech);
+        cap = ep11tok_add_mech_cap(target_info,
+                                sha3_combined_libica_only_mechs[i].combined_mech);
+        cap->flags |= EP11_MECH_CAP_COMBINED;
+        cap->hash_mech = sha3_combined_libica_only_mechs[i].hash_mech;
+        if (hash_cap != NULL && hash_cap->rc == CKR_OK && base_cap != NULL) {
+            cap->rc = base_cap->rc;
+            cap->flags |= base_cap->flags;
+        }
+    }
+
+    return CKR_OK;
+}
+
+static CK_RV ep11tok_mech_supported(STDLL_TokData_t *tokdata,
+                                    CK_MECHANISM_TYPE type, CK_FLAGS *flags)
+{
+    ep11_private_data_t *ep11_data = tokdata->private_data;
+    ep11_target_info_t* target_info;
+    ep11_mech_cap_t *cap;
+    CK_RV rc;
+
+    target_info = get_target_info(tokdata);
+    if (target_info == NULL)
+        return CKR_FUNCTION_FAILED;
+
+    cap = ep11tok_find_mech_cap(target_info, type);
+    if (cap == NULL || cap->rc != CKR_OK) {
+        TRACE_INFO("%s Mech '%s' not suppported\n", __func__,
+                   ep11_get_ckm(tokdata, type));
+        rc = CKR_MECHANISM_INVALID;
+        goto out;
+    }
+
+    if ((cap->flags & EP11_MECH_CAP_COMBINED) &&
+        !ep11tok_libica_digest_available(tokdata, ep11_data, cap->hash_mech)) {
+        TRACE_INFO("%s Mech '%s' not suppported\n", __func__,
+                   ep11_get_ckm(tokdata, type));
+        rc = CKR_MECHANISM_INVALID;
+        goto out;
+    }
+
+    if ((cap->flags & EP11_MECH_CAP_PKEY) &&
+        ((ep11_data->pkey_wrap_support_checked &&
+          !ep11_data->pkey_wrap_supported) ||
+         ep11tok_pkey_option_disabled(tokdata) || ep11_data->msa_level < 4)) {
+        TRACE_INFO("%s Mech '%s' not suppported\n", __func__,
+                   ep11_get_ckm(tokdata, type));
+        rc = CKR_MECHANISM_INVALID;
+        goto out;
+    }
+
+    if (flags != NULL)
+        *flags = cap->flags;
+    rc = CKR_OK;
+
 out:
     put_target_info(tokdata, target_info);
     return rc;
 }
 
+CK_RV ep11tok_is_mechanism_supported(STDLL_TokData_t *tokdata,
+                                     CK_MECHANISM_TYPE type)
+{
+    return ep11tok_mech_supported(tokdata, type, NULL);
+}
+
 CK_RV ep11tok_is_mechanism_supported_ex(STDLL_TokData_t *tokdata,
                                         CK_MECHANISM_PTR mech)
 {
     CK_RSA_PKCS_OAEP_PARAMS *params;
-    int status;
+    CK_FLAGS flags = 0;
     CK_RV rc;
 
-    rc = ep11tok_is_mechanism_supported(tokdata, mech->mechanism);
+    rc = ep11tok_mech_supported(tokdata, mech->mechanism, &flags);
     if (rc != CKR_OK)
         return rc;
 
@@ -12631,9 +12872,7 @@ CK_RV ep11tok_is_mechanism_supported_ex(STDLL_TokData_t *tokdata,
 
         params = (CK_RSA_PKCS_OAEP_PARAMS *)mech->pParameter;
 
-        status = check_required_versions(tokdata, oaep_sha2_req_versions,
-                                         NUM_OAEP_SHA2_REQ);
-        if (status == 1)
+        if ((flags & EP11_MECH_CAP_OAEP_SHA1) == 0)
             return CKR_OK;
 
         /*
@@ -12658,6 +12897,7 @@ CK_RV ep11tok_get_mechanism_info(STDLL_TokData_t * tokdata,
     int status;
     ep11_target_info_t* target_info;
     const struct sha_combined *comb_mech;
+    ep11_mech_cap_t *cap;
 
     rc = ep11tok_is_mechanism_supported(tokdata, type);
     if (rc != CKR_OK) {
@@ -12677,6 +12917,15 @@ CK_RV ep11tok_get_mechanism_info(STDLL_TokData_t * tokdata,
     if (target_info == NULL)
         return CKR_FUNCTION_FAILED;
 
+    /* The mechanism info does not change as long as the APQNs don't change */
+    cap = ep11tok_find_mech_cap(target_info, type);
+    if (cap != NULL && cap->info_state == EP11_MECH_INFO_VALID) {
+        __sync_synchronize();
+        *pInfo = cap->info;
+        put_target_info(tokdata, target_info);
+        return tokdata->policy->update_mech_info(tokdata->policy, type, pInfo);
+    }
+
     switch (type) {
         case CKM_AES_XTS:
             pInfo->ulMinKeySize = 32;
@@ -12696,9 +12945,8 @@ CK_RV ep11tok_get_mechanism_info(STDLL_TokData_t * tokdata,
             break;
         }
 
-    put_target_info(tokdata, target_info);
-
     if (rc != CKR_OK) {
+        put_target_info(tokdata, target_info);
         rc = ep11_error_to_pkcs11_error(rc, NULL);
         TRACE_ERROR("%s m_GetMechanismInfo(0x%lx) failed with rc=0x%lx\n",
                     __func__, type, rc);
@@ -12766,10 +13014,12 @@ CK_RV ep11tok_get_mechanism_info(STDLL_TokData_t * tokdata,
          * ulMaxKeySize in bytes. Adjust both, so that both are in bits, as
          * required by the PKCS#11 standard.
          */
-        status = check_required_versions(tokdata, hmac_req_versions,
-                                         NUM_HMAC_REQ);
-        if (status == -1)
+        status = check_target_versions(tokdata, target_info,
+                                       hmac_req_versions, NUM_HMAC_REQ);
+        if (status == -1) {
+            put_target_info(tokdata, target_info);
             return CKR_MECHANISM_INVALID;
+        }
 
         pInfo->ulMinKeySize *= 8;
         if (status == 1)
@@ -12812,6 +13062,18 @@ CK_RV ep11tok_get_mechanism_info(STDLL_TokData_t * tokdata,
     }
 #endif                          /* DEFENSIVE_MECHLIST */
 
+    /* The target info may have been refreshed when the single APQN failed */
+    cap = ep11tok_find_mech_cap(target_info, type);
+    if (cap != NULL &&
+        __sync_bool_compare_and_swap(&cap->info_state, EP11_MECH_INFO_NONE,
+                                     EP11_MECH_INFO_BUSY)) {
+        cap->info = *pInfo;
+        __sync_synchronize();
+        cap->info_state = EP11_MECH_INFO_VALID;
+    }
+
+    put_target_info(tokdata, target_info);
+
     return tokdata->policy->update_mech_info(tokdata->policy, type, pInfo);
 }
 
@@ -13278,6 +13540,11 @@ static CK_RV read_adapter_config_file(STDLL_TokData_t * tokdata,
             continue;
         }
 
+        if (strcmp(bare->base.key, "APQN_LOAD_BALANCING") == 0) {
+            ep11_data->apqn_load_balancing = 1;
+            continue;
+        }
+
         if (strcmp(bare->base.key, "PKEY_MODE") == 0) {
             rc = ep11_config_next(&c, CT_BARECONST, fname, "PKEY mode");
             if (rc != CKR_OK)
@@ -14932,10 +15199,6 @@ static int check_required_versions(STDLL_TokData_t *tokdata,
                                    const version_req_t req[],
                                    CK_ULONG num_req)
 {
-    CK_ULONG i, max_card_type = 0, min_card_type = 0xFFFFFFFF;
-    CK_BBOOL req_not_fullfilled = CK_FALSE;
-    CK_BBOOL req_fullfilled = CK_FALSE;
-    ep11_card_version_t *card_version;
     ep11_target_info_t* target_info;
     int status;
 
@@ -14943,8 +15206,29 @@ static int check_required_versions(STDLL_TokData_t *tokdata,
     if (target_info == NULL)
         return CKR_FUNCTION_FAILED;
 
+    status = check_target_versions(tokdata, target_info, req, num_req);
+
+    put_target_info(tokdata, target_info);
+    return status;
+}
+
+/**
+ * Same as check_required_versions(), but checks the APQNs of the specified
+ * target info instead of the current one.
+ */
+static int check_target_versions(STDLL_TokData_t *tokdata,
+                                 ep11_target_info_t *target_info,
+                                 const version_req_t req[],
+                                 CK_ULONG num_req)
+{
+    CK_ULONG i, max_card_type = 0, min_card_type = 0xFFFFFFFF;
+    CK_BBOOL req_not_fullfilled = CK_FALSE;
+    CK_BBOOL req_fullfilled = CK_FALSE;
+    ep11_card_version_t *card_version;
+    int status;
+
     for (i = 0; i < num_req; i++) {
-        status = check_card_version(tokdata, req[i].card_type,
+        status = check_card_version(tokdata, target_info, req[i].card_type,
                                            req[i].min_lib_version,
                                            req[i].min_firmware_version,
                                            req[i].min_firmware_API_version);
@@ -14999,7 +15283,6 @@ static int check_required_versions(STDLL_TokData_t *tokdata,
     }
 
 out:
-    put_target_info(tokdata, target_info);
     return status;
 }
 
@@ -15009,15 +15292,15 @@ out:
  * then -1 is returned.
  * Those parameters that are NULL are not checked.
  */
-static int check_card_version(STDLL_TokData_t *tokdata, CK_ULONG card_type,
+static int check_card_version(STDLL_TokData_t *tokdata,
+                              ep11_target_info_t *target_info,
+                              CK_ULONG card_type,
                               const CK_VERSION *ep11_lib_version,
                               const CK_VERSION *firmware_version,
                               const CK_ULONG *firmware_API_version)
 {
     ep11_private_data_t *ep11_data = tokdata->private_data;
     ep11_card_version_t *card_version;
-    ep11_target_info_t* target_info;
-    int status = 1;
 
     TRACE_DEBUG("%s checking versions for CEX%luP cards.\n", __func__, card_type);
 
@@ -15029,10 +15312,6 @@ static int check_card_version(STDLL_TokData_t *tokdata, CK_ULONG card_type,
         }
     }
 
-    target_info = get_target_info(tokdata);
-    if (target_info == NULL)
-        return -1;
-
     card_version = target_info->card_versions;
     while (card_version != NULL) {
         if (card_version->card_type == card_type)
@@ -15040,17 +15319,14 @@ static int check_card_version(STDLL_TokData_t *tokdata, CK_ULONG card_type,
         card_version = card_version->next;
     }
 
-    if (card_version == NULL) {
-        status = -1;
-        goto out;
-    }
+    if (card_version == NULL)
+        return -1;
 
     if (firmware_version != NULL) {
         if (compare_ck_version(&card_version->firmware_version,
                                firmware_version) < 0) {
             TRACE_DEBUG("%s firmware_version is less than required\n", __func__);
-            status = 0;
-            goto out;
+            return 0;
         }
     }
 
@@ -15058,14 +15334,11 @@ static int check_card_version(STDLL_TokData_t *tokdata, CK_ULONG card_type,
         if (card_version->firmware_API_version < *firmware_API_version) {
             TRACE_DEBUG("%s firmware_API_version is less than required\n",
                        __func__);
-            status = 0;
-            goto out;
+            return 0;
         }
     }
 
- out:
-    put_target_info(tokdata, target_info);
-    return status;
+    return 1;
 }
 
 static CK_RV ep11tok_setup_target(STDLL_TokData_t *tokdata,
@@ -15733,6 +16006,11 @@ CK_RV refresh_target_info(STDLL_TokData_t *tokdata, CK_BBOOL wait_for_new_wk)
     if (rc != CKR_OK)
         goto error;
 
+    /* Evaluate the mechanism capabilities with the current set of APQNs */
+    rc = ep11tok_build_mech_caps(tokdata, target_info);
+    if (rc != CKR_OK)
+        goto error;
+
     if (ep11_data->mk_change_active) {
         /* MK change active: Setup a single APQN target */
         rc = ep11tok_setup_single_target(tokdata, target_info, wait_for_new_wk);
@@ -15743,9 +16021,20 @@ CK_RV refresh_target_info(STDLL_TokData_t *tokdata, CK_BBOOL wait_for_new_wk)
         rc = ep11tok_setup_target(tokdata, target_info);
         if (rc != CKR_OK)
             goto error;
+
+        /* Setup the single APQN targets used for load balancing */
+        rc = ep11tok_lb_setup(tokdata, target_info);
+        if (rc != CKR_OK) {
+            if (dll_m_rm_module != NULL)
+                dll_m_rm_module(NULL, target_info->target);
+            goto error;
+        }
     }
 
-    /* Set the new one as the current one (locked against concurrent get's) */
+    /*
+     * Set the new one as the current one. The write lock serializes against
+     * get_target_info() callers that fall back to the reference count.
+     */
     if (pthread_rwlock_wrlock(&ep11_data->target_rwlock) != 0) {
         TRACE_DEVEL("Target Write-Lock failed.\n");
         rc = CKR_CANT_LOCK;
@@ -15760,33 +16049,190 @@ CK_RV refresh_target_info(STDLL_TokData_t *tokdata, CK_BBOOL wait_for_new_wk)
         return CKR_CANT_LOCK;
     }
 
-    /* Release the previous one */
-    if (prev_info != NULL)
-        put_target_info(tokdata, (ep11_target_info_t *)prev_info);
+    /* Retire the previous one, it is freed once no thread uses it anymore */
+    if (prev_info != NULL) {
+        if (pthread_mutex_lock(&ep11_data->target_retire_mutex) != 0) {
+            TRACE_DEVEL("Target retire Lock failed.\n");
+            return CKR_CANT_LOCK;
+        }
+
+        __sync_sub_and_fetch(&prev_info->ref_count, 1);
+        prev_info->retired_next = ep11_data->target_retired;
+        ep11_data->target_retired = (ep11_target_info_t *)prev_info;
+        reclaim_target_infos(ep11_data);
+
+        pthread_mutex_unlock(&ep11_data->target_retire_mutex);
+    }
 
     return CKR_OK;
 
 error:
+    ep11tok_lb_free(target_info);
     free_card_versions(target_info->card_versions);
+    free(target_info->mech_caps);
     free((void *)target_info);
     return rc;
 }
 
+static void free_target_info(ep11_target_info_t *target_info)
+{
+    TRACE_DEBUG("%s: target_info: %p is freed\n", __func__,
+                (void *)target_info);
+
+    if (dll_m_rm_module != NULL)
+        dll_m_rm_module(NULL, target_info->target);
+    ep11tok_lb_free(target_info);
+    free_card_versions(target_info->card_versions);
+    free(target_info->mech_caps);
+    free(target_info);
+}
+
+/*
+ * Thread exit handler of the target reader key: the reader record of the
+ * exiting thread can be reused by another thread.
+ */
+static void ep11tok_target_reader_release(void *ptr)
+{
+    ep11_target_reader_t *reader = ptr;
+
+    __sync_lock_release(&reader->in_use);
+}
+
+/*
+ * Returns the hazard pointer record of the calling thread, or NULL if none
+ * could be allocated. Records of exited threads are reused, otherwise a new
+ * one is allocated and added to the list of readers. Records are only freed
+ * at token finalization.
+ */
+static ep11_target_reader_t *get_target_reader(ep11_private_data_t *ep11_data)
+{
+    ep11_target_reader_t *reader;
+
+    reader = pthread_getspecific(ep11_data->target_reader_key);
+    if (reader != NULL)
+        return reader;
+
+    for (reader = ep11_data->target_readers; reader != NULL;
+         reader = reader->next) {
+        if (reader->in_use == 0 &&
+            __sync_lock_test_and_set(&reader->in_use, 1) == 0)
+            break;
+    }
+
+    if (reader == NULL) {
+        if (posix_memalign((void **)&reader, EP11_TARGET_READER_CACHE_LINE,
+                           sizeof(*reader)) != 0) {
+            TRACE_ERROR("%s Memory allocation failed\n", __func__);
+            return NULL;
+        }
+        memset(reader, 0, sizeof(*reader));
+        reader->in_use = 1;
+
+        do {
+            reader->next = ep11_data->target_readers;
+        } while (!__sync_bool_compare_and_swap(&ep11_data->target_readers,
+                                               reader->next, reader));
+    }
+
+    if (pthread_setspecific(ep11_data->target_reader_key, reader) != 0) {
+        TRACE_ERROR("%s pthread_setspecific failed\n", __func__);
+        __sync_lock_release(&reader->in_use);
+        return NULL;
+    }
+
+    return reader;
+}
+
+static CK_BBOOL target_info_in_use(ep11_private_data_t *ep11_data,
+                                   ep11_target_info_t *target_info)
+{
+    ep11_target_reader_t *reader;
+    unsigned int i;
+
+    if (target_info->ref_count != 0)
+        return TRUE;
+
+    for (reader = ep11_data->target_readers; reader != NULL;
+         reader = reader->next) {
+        for (i = 0; i < EP11_TARGET_HAZARDS; i++) {
+            if (reader->hazards[i] == target_info)
+                return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * Frees all retired target infos that are no longer referenced, neither by a
+ * hazard pointer nor by the reference count.
+ * Must be called with the target_retire_mutex held.
+ */
+static void reclaim_target_infos(ep11_private_data_t *ep11_data)
+{
+    ep11_target_info_t **prev, *target_info;
+
+    /* Full barrier: the new current target info is visible to all readers */
+    __sync_synchronize();
+
+    prev = &ep11_data->target_retired;
+    while ((target_info = *prev) != NULL) {
+        if (target_info_in_use(ep11_data, target_info)) {
+            prev = &target_info->retired_next;
+            continue;
+        }
+
+        *prev = target_info->retired_next;
+        free_target_info(target_info);
+    }
+}
+
 /*
  * Get the current EP11 target info.
  * Do NOT use the ep11_data->target_info directly, always get a copy using
- * this function. This will increment the reference count of the target info,
- * and return the current target info in a thread save way.
- * When no longer needed, put it back using put_target_info().
+ * this function, and return the current target info in a thread save way.
+ * When no longer needed, put it back using put_target_info() from the same
+ * thread.
+ *
+ * The target info is protected by a hazard pointer of the calling thread,
+ * so that the steady state does not write to any shared memory: the pointer
+ * is published, and then the current target info is read again. If it has
+ * changed in between, refresh_target_info() may not have seen the hazard
+ * pointer, and it is retried. If all hazard pointers of the thread are in
+ * use (nested calls), the reference count of the target info is incremented
+ * under the target read lock instead.
  */
 ep11_target_info_t *get_target_info(STDLL_TokData_t *tokdata)
 {
     ep11_private_data_t *ep11_data = tokdata->private_data;
     volatile ep11_target_info_t *target_info;
+    ep11_target_reader_t *reader;
+    unsigned int i;
 #ifdef DEBUG
     unsigned long ref_count;
 #endif
 
+    reader = get_target_reader(ep11_data);
+    for (i = 0; reader != NULL && i < EP11_TARGET_HAZARDS; i++) {
+        if (reader->hazards[i] != NULL)
+            continue;
+
+        do {
+            target_info = *((void * volatile *)&ep11_data->target_info);
+            reader->hazards[i] = (ep11_target_info_t *)target_info;
+            /* Full barrier: the hazard is visible before the re-check */
+            __sync_synchronize();
+        } while (target_info != *((void * volatile *)&ep11_data->target_info));
+
+        if (target_info == NULL) {
+            TRACE_ERROR("%s: target_info is NULL\n", __func__);
+            reader->hazards[i] = NULL;
+            return NULL;
+        }
+
+        return (ep11_target_info_t *)target_info;
+    }
+
     /*
      * Lock until we have obtained the current target info and have
      * increased the reference counter
@@ -15822,37 +16268,58 @@ ep11_target_info_t *get_target_info(STDLL_TokData_t *tokdata)
 }
 
 /*
- * Give back an EP11 target info. This will decrement the reference count,
- * and will free it if the reference count reaches zero.
+ * Give back an EP11 target info. This clears the hazard pointer or decrements
+ * the reference count, and frees it if it has been retired by
+ * refresh_target_info() and is no longer used.
  */
 void put_target_info(STDLL_TokData_t *tokdata, ep11_target_info_t *target_info)
 {
     ep11_private_data_t *ep11_data = tokdata->private_data;
+    ep11_target_reader_t *reader;
+    unsigned int i;
+#ifdef DEBUG
     unsigned long ref_count;
+#endif
 
     if (target_info == NULL)
         return;
 
-    if (target_info->ref_count > 0) {
-        ref_count = __sync_sub_and_fetch(&target_info->ref_count, 1);
+    reader = pthread_getspecific(ep11_data->target_reader_key);
+    for (i = 0; reader != NULL && i < EP11_TARGET_HAZARDS; i++) {
+        if (reader->hazards[i] == target_info) {
+            reader->hazards[i] = NULL;
+            break;
+        }
+    }
 
-        TRACE_DEBUG("%s: target_info: %p ref_count: %lu\n", __func__,
-                    (void *)target_info, ref_count);
-    } else {
-        TRACE_WARNING("%s: target_info: %p ref_count already 0.\n", __func__,
-                      (void *)target_info);
-        ref_count = 0;
+    if (reader == NULL || i >= EP11_TARGET_HAZARDS) {
+        if (target_info->ref_count > 0) {
+#ifdef DEBUG
+            ref_count = __sync_sub_and_fetch(&target_info->ref_count, 1);
+
+            TRACE_DEBUG("%s: target_info: %p ref_count: %lu\n", __func__,
+                        (void *)target_info, ref_count);
+#else
+            __sync_sub_and_fetch(&target_info->ref_count, 1);
+#endif
+        } else {
+            TRACE_WARNING("%s: target_info: %p ref_count already 0.\n",
+                          __func__, (void *)target_info);
+        }
     }
 
-    if (ref_count == 0 && target_info != ep11_data->target_info) {
-        TRACE_DEBUG("%s: target_info: %p is freed\n", __func__,
-                    (void *)target_info);
+    /* Only the current target info is used in the steady state */
+    if (target_info == *((void * volatile *)&ep11_data->target_info))
+        return;
 
-        if (dll_m_rm_module != NULL)
-            dll_m_rm_module(NULL, target_info->target);
-        free_card_versions(target_info->card_versions);
-        free(target_info);
+    if (pthread_mutex_lock(&ep11_data->target_retire_mutex) != 0) {
+        TRACE_DEVEL("Target retire Lock failed.\n");
+        return;
     }
+
+    reclaim_target_infos(ep11_data);
+
+    pthread_mutex_unlock(&ep11_data->target_retire_mutex);
 }
 
 /*
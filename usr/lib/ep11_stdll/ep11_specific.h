@@ -249,8 +249,44 @@ typedef struct {
 #define PQC_BIT_MASK(idx)           (0x80 >> PQC_BIT_IN_BYTE(idx))
 #define PQC_BYTES                   ((((XCP_PQC_MAX / 32) * 32) + 32) / 8)
 
+/* Flags of a mechanism capability entry */
+#define EP11_MECH_CAP_USED          0x01 /* slot is in use */
+#define EP11_MECH_CAP_COMBINED      0x02 /* libica-only combined mech */
+#define EP11_MECH_CAP_PKEY          0x04 /* requires protected key support */
+#define EP11_MECH_CAP_OAEP_SHA1     0x08 /* RSA-OAEP with SHA-1 only */
+
+/* States of the cached mechanism info of a mechanism capability entry */
+#define EP11_MECH_INFO_NONE         0
+#define EP11_MECH_INFO_BUSY         1
+#define EP11_MECH_INFO_VALID        2
+
+/*
+ * Capability of a mechanism with a set of APQNs, evaluated once when the
+ * target info is built. The mechanism info is filled on first use.
+ */
+typedef struct {
+    CK_MECHANISM_TYPE mech;
+    CK_MECHANISM_TYPE hash_mech; /* set if EP11_MECH_CAP_COMBINED */
+    CK_RV rc;
+    CK_FLAGS flags;
+    volatile int info_state;
+    CK_MECHANISM_INFO info;
+} ep11_mech_cap_t;
+
+/* Per-APQN state for load balancing single-part operations */
 typedef struct {
+    uint_32 adapter;
+    uint_32 domain;
+    target_t target;
+    volatile unsigned long inflight;
+    volatile uint64_t latency_ns; /* exponentially weighted moving average */
+    volatile int offline;
+    stat_apqn_t *stats; /* NULL if statistics are not enabled */
+} ep11_lb_apqn_t;
+
+typedef struct ep11_target_info {
     volatile unsigned long ref_count;
+    struct ep11_target_info *retired_next; /* in list of retired infos */
     target_t target;
     ep11_card_version_t *card_versions;
     CK_ULONG used_firmware_API_version;
@@ -263,8 +299,27 @@ typedef struct {
     uint_32 adapter; /* set if single_apqn = 1 */
     uint_32 domain; /* set if single_apqn = 1 */
     volatile int single_apqn_has_new_wk;
+    ep11_mech_cap_t *mech_caps; /* hash table, mech_caps_size is power of 2 */
+    CK_ULONG mech_caps_size;
+    ep11_lb_apqn_t *lb_apqns; /* NULL if not load balancing */
+    unsigned int num_lb_apqns;
+    volatile unsigned long lb_next;
 } ep11_target_info_t;
 
+/*
+ * Per-thread hazard pointers to the target infos a thread currently uses.
+ * Each record is on its own cache line, so that get_target_info() and
+ * put_target_info() only write to memory of the calling thread.
+ */
+#define EP11_TARGET_HAZARDS             4
+#define EP11_TARGET_READER_CACHE_LINE   256
+
+typedef struct ep11_target_reader {
+    struct ep11_target_reader *next;
+    volatile int in_use;
+    ep11_target_info_t *volatile hazards[EP11_TARGET_HAZARDS];
+} __attribute__((aligned(EP11_TARGET_READER_CACHE_LINE))) ep11_target_reader_t;
+
 typedef struct {
     char token_config_filename[PATH_MAX];
     ep11_target_t target_list;
@@ -279,6 +334,8 @@ typedef struct {
     int vhsm_mode;
     int fips_session_mode;
     int optimize_single_ops;
+    int apqn_load_balancing;
+    stat_apqn_t *apqn_stats; /* NULL if statistics are not enabled */
     int pkey_mode;
     volatile int pkey_combined_extract_supported;
     volatile int pkey_wrap_supported;
@@ -301,6 +358,11 @@ typedef struct {
     CK_VERSION ep11_lib_version;
     volatile ep11_target_info_t *target_info;
     pthread_rwlock_t target_rwlock;
+    pthread_key_t target_reader_key;
+    int target_reader_key_created;
+    ep11_target_reader_t *volatile target_readers;
+    ep11_target_info_t *target_retired; /* protected by target_retire_mutex */
+    pthread_mutex_t target_retire_mutex;
     CK_BYTE vhsm_pin[XCP_MAX_PINBYTES];
     CK_BBOOL vhsm_pin_valid;
     CK_BYTE vhsm_pin_blob[XCP_PINBLOB_BYTES];
@@ -400,6 +462,17 @@ CK_RV get_ep11_target_for_apqn(uint_32 adapter, uint_32 domain,
                                target_t *target, uint64_t flags);
 void free_ep11_target_for_apqn(target_t target);
 
+CK_RV ep11tok_lb_stats_open(STDLL_TokData_t *tokdata);
+void ep11tok_lb_stats_close(STDLL_TokData_t *tokdata);
+CK_RV ep11tok_lb_setup(STDLL_TokData_t *tokdata,
+                       ep11_target_info_t *target_info);
+void ep11tok_lb_free(ep11_target_info_t *target_info);
+ep11_lb_apqn_t *ep11tok_lb_select(ep11_target_info_t *target_info);
+target_t ep11tok_lb_begin(ep11_target_info_t *target_info,
+                          ep11_lb_apqn_t *apqn, struct timespec *start);
+CK_BBOOL ep11tok_lb_end(ep11_lb_apqn_t *apqn, const struct timespec *start,
+                        CK_RV rc);
+
 CK_RV ep11_error_to_pkcs11_error(CK_RV rc, SESSION *session);
 
 CK_BBOOL ep11tok_libica_digest_available(STDLL_TokData_t *tokdata,
@@ -720,6 +793,36 @@ CK_RV do_LogoutExtended(XCP_LoginAlgorithm_t alg,
                     }                                                    \
                 } while (0);
 
+/*
+ * Macros to enclose EP11 library calls of single-part operations, that can be
+ * performed on any APQN of the target. With APQN_LOAD_BALANCING, the call is
+ * routed to the least loaded APQN via its single APQN target, otherwise the
+ * target of the target_info is used. If the selected APQN went offline, the
+ * library call is retried once with the target of the target_info.
+ */
+#define LOAD_BALANCE_START(target_info, target)                          \
+                {                                                        \
+                    ep11_lb_apqn_t *lb_apqn;                             \
+                    struct timespec lb_start;                            \
+                    int lb_retry = 0;                                    \
+                    do {                                                 \
+                        lb_apqn = lb_retry == 0 ?                        \
+                                    ep11tok_lb_select((target_info)) :   \
+                                    NULL;                                \
+                        (target) = ep11tok_lb_begin((target_info),       \
+                                                    lb_apqn, &lb_start);
+
+#define LOAD_BALANCE_END(rc)                                             \
+                        if (ep11tok_lb_end(lb_apqn, &lb_start, (rc)) &&  \
+                            lb_retry++ == 0) {                           \
+                            TRACE_DEVEL("%s APQN went offline, retry\n", \
+                                        __func__);                       \
+                            continue;                                    \
+                        }                                                \
+                        break;                                           \
+                    } while (1);                                         \
+                }
+
 /*
  * Macros to enclose EP11 library calls with 1, 2 or 3 key blobs as argument.
  * If a master key change is active, and the single APQN has the new WK,
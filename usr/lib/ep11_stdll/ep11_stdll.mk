@@ -43,16 +43,19 @@ opencryptoki_stdll_libpkcs11_ep11_la_SOURCES = usr/lib/common/asn1.c	\
 	usr/lib/common/sw_crypt.c usr/lib/common/profile_obj.c		\
 	usr/lib/common/dlist.c usr/lib/common/mech_pqc.c		\
 	usr/lib/ep11_stdll/new_host.c usr/lib/common/mech_openssl.c	\
+	usr/lib/common/sw_sha.c						\
 	usr/lib/ep11_stdll/ep11_specific.c 				\
 	usr/lib/ep11_stdll/ep11_session.c				\
 	usr/lib/ep11_stdll/ep11_login.c					\
 	usr/lib/ep11_stdll/ep11_mkchange.c				\
+	usr/lib/ep11_stdll/ep11_balance.c				\
 	usr/lib/common/utility_common.c usr/lib/common/ec_supported.c	\
 	usr/lib/api/policyhelper.c usr/lib/config/configuration.c	\
 	usr/lib/config/cfgparse.y usr/lib/config/cfglex.l		\
 	usr/lib/common/pqc_supported.c					\
 	usr/lib/hsm_mk_change/hsm_mk_change.c				\
-	usr/lib/common/btree.c usr/lib/common/sess_mgr.c
+	usr/lib/common/btree.c usr/lib/common/sess_mgr.c		\
+	usr/lib/common/hsm_mk_change_lock.c
 
 if !NO_PKEY
 opencryptoki_stdll_libpkcs11_ep11_la_SOURCES +=				\
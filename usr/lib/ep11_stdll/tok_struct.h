@@ -157,6 +157,14 @@ token_spec_t token_specific = {
     &token_specific_set_attrs_for_new_object,
     &token_specific_handle_event,
     &token_specific_check_obj_access,
+    NULL,                       // hash_sign_verify_init
+    NULL,                       // hash_sign
+    NULL,                       // hash_sign_verify_update
+    NULL,                       // hash_sign_final
+    NULL,                       // hash_verify
+    NULL,                       // hash_verify_final
+    NULL,                       // sha_batch
+    NULL,                       // rsa_priv_wrap_get_data
 };
 
 #endif
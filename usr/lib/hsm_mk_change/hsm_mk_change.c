@@ -35,6 +35,11 @@ struct hsm_mk_change_op_hdr {
     uint32_t state; /* stored in big endian */
 };
 
+struct hsm_mk_change_progress_hdr {
+    uint64_t total; /* stored in big endian */
+    uint64_t done; /* stored in big endian */
+};
+
 struct hsm_mkvp_hdr {
     uint32_t type; /* stored in big endian */
     uint32_t mkvp_len; /* stored in big endian */
@@ -894,6 +899,85 @@ out:
     return rc;
 }
 
+/*
+ * Saves the re-encipherment progress of a token. The file is replaced
+ * atomically, so that a reader always sees a complete checkpoint.
+ */
+CK_RV hsm_mk_change_token_progress_save(const char *id, CK_SLOT_ID slot_id,
+                            const struct hsm_mk_change_progress *progress)
+{
+    char progress_file[PATH_MAX], tmp_file[PATH_MAX];
+    struct hsm_mk_change_progress_hdr hdr;
+    FILE *fp;
+
+    if (ock_snprintf(progress_file, PATH_MAX, "%s/%s-%lu.progress",
+                     OCK_HSM_MK_CHANGE_PATH, id, slot_id) != 0 ||
+        ock_snprintf(tmp_file, PATH_MAX, "%s.tmp", progress_file) != 0) {
+        TRACE_ERROR("HSM_MK_CHANGE file path buffer overflow\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    fp = fopen(tmp_file, "w");
+    if (fp == NULL) {
+        TRACE_ERROR("fopen(%s): %s\n", tmp_file, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    hsm_mk_change_op_set_perm(fileno(fp));
+
+    hdr.total = htobe64(progress->total);
+    hdr.done = htobe64(progress->done);
+
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+        TRACE_ERROR("fwrite(%s): %s\n", tmp_file, strerror(errno));
+        fclose(fp);
+        remove(tmp_file);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (fclose(fp) != 0 || rename(tmp_file, progress_file) != 0) {
+        TRACE_ERROR("rename(%s): %s\n", tmp_file, strerror(errno));
+        remove(tmp_file);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
+
+CK_RV hsm_mk_change_token_progress_load(const char *id, CK_SLOT_ID slot_id,
+                                  struct hsm_mk_change_progress *progress)
+{
+    char progress_file[PATH_MAX];
+    struct hsm_mk_change_progress_hdr hdr;
+    FILE *fp;
+    CK_RV rc = CKR_OK;
+
+    if (ock_snprintf(progress_file, PATH_MAX, "%s/%s-%lu.progress",
+                     OCK_HSM_MK_CHANGE_PATH, id, slot_id) != 0) {
+        TRACE_ERROR("HSM_MK_CHANGE file path buffer overflow\n");
+        return CKR_FUNCTION_FAILED;
+    }
+
+    fp = fopen(progress_file, "r");
+    if (fp == NULL) {
+        TRACE_DEVEL("fopen(%s): %s\n", progress_file, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1) {
+        TRACE_ERROR("fread(%s): %s\n", progress_file, strerror(errno));
+        rc = CKR_FUNCTION_FAILED;
+        goto out;
+    }
+
+    progress->total = be64toh(hdr.total);
+    progress->done = be64toh(hdr.done);
+
+out:
+    fclose(fp);
+    return rc;
+}
+
 CK_RV hsm_mk_change_op_remove(const char *id)
 {
     char hsm_mk_change_file[PATH_MAX];
@@ -3362,17 +3362,13 @@ static void new_gcm_specific_aes_gcm_free(STDLL_TokData_t *tokdata,
 {
     AES_GCM_CONTEXT *ctx = (AES_GCM_CONTEXT *)context;
 
-    UNUSED(tokdata);
-    UNUSED(sess);
-    UNUSED(context_len);
-
     if (ctx == NULL)
         return;
 
     if ((kma_ctx *)ctx->ulClen != NULL)
         ica_aes_gcm_kma_ctx_free((kma_ctx *)ctx->ulClen);
 
-    free(context);
+    session_mgr_free_context(tokdata, sess, context, context_len);
 }
 
 CK_RV new_gcm_specific_aes_gcm_init(STDLL_TokData_t *tokdata, SESSION *sess,
@@ -3705,6 +3701,18 @@ CK_RV token_specific_rsa_decrypt(STDLL_TokData_t *tokdata, CK_BYTE *in_data,
                                              os_specific_rsa_decrypt);
 }
 
+CK_RV token_specific_rsa_priv_wrap_get_data(STDLL_TokData_t *tokdata,
+                                            OBJECT *key_obj,
+                                            CK_BBOOL length_only,
+                                            CK_BYTE **data, CK_ULONG *data_len)
+{
+    UNUSED(tokdata);
+
+    return openssl_rsa_priv_wrap_get_data(key_obj, sizeof(ica_ex_data_t),
+                                          ica_free_ex_data, length_only,
+                                          data, data_len);
+}
+
 CK_RV token_specific_rsa_sign(STDLL_TokData_t *tokdata, SESSION *sess,
                               CK_BYTE *in_data, CK_ULONG in_data_len,
                               CK_BYTE *out_data, CK_ULONG *out_data_len,
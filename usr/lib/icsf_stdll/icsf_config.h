@@ -18,6 +18,9 @@
 #define ICSF_CFG_MECH_SIMPLE 0
 #define ICSF_CFG_MECH_SASL   1
 
+#define ICSF_CFG_DEFAULT_LDAP_CONNECTIONS   0
+#define ICSF_CFG_DEFAULT_ATTR_CACHE_TTL     0
+
 /* ICSF specific slot data */
 struct icsf_config {
     char name[ICSF_TOKEN_NAME_LEN + 1];
@@ -30,6 +33,8 @@ struct icsf_config {
     char cert_file[PATH_MAX + 1];
     char key_file[PATH_MAX + 1];
     int mech;
+    unsigned long ldap_connections;
+    unsigned long attr_cache_ttl;
 };
 
 static CK_RV parse_config_file(const char *conf_name, CK_SLOT_ID slot_id,
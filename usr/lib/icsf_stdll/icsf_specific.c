@@ -27,6 +27,7 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <errno.h>
+#include <time.h>
 #include "pkcs11types.h"
 #include "defs.h"
 #include "host_defs.h"
@@ -46,6 +47,7 @@
 #include "../api/policy.h"
 #include "cfgparser.h"
 #include "configuration.h"
+#include "hashmap.h"
 
 /* Default token attributes */
 const char manuf[] = "IBM";
@@ -145,15 +147,50 @@ static const MECH_LIST_ELEMENT icsf_mech_list[] = {
 static const CK_ULONG icsf_mech_list_len =
                 (sizeof(icsf_mech_list) / sizeof(MECH_LIST_ELEMENT));
 
+/*
+ * Connections can only be shared between sessions (and so between threads)
+ * when libldap is thread-safe, which is always the case starting with
+ * OpenLDAP 2.5. Otherwise each session uses a connection exclusively and the
+ * pool only avoids re-binding for every new session.
+ */
+#if defined(LDAP_API_FEATURE_X_OPENLDAP_THREAD_SAFE) && \
+    defined(LDAP_VENDOR_VERSION) && LDAP_VENDOR_VERSION >= 20500
+#define ICSF_LDAP_SHARED_CONNECTIONS 1
+#else
+#define ICSF_LDAP_SHARED_CONNECTIONS 0
+#endif
+
+/* Each element of the list ldap_pool should have this type: */
+struct icsf_ldap_conn {
+    LDAP *ld;
+    /* Number of sessions using this connection */
+    unsigned long users;
+
+    /* List element */
+    list_entry_t pool;
+};
+
 /* Each element of the list sessions should have this type: */
 struct session_state {
     CK_SESSION_HANDLE session_id;
     LDAP *ld;
+    struct icsf_ldap_conn *conn;
 
     /* List element */
     list_entry_t sessions;
 };
 
+/*
+ * Result of a get attribute value call, kept for an object so that following
+ * C_GetAttributeValue calls do not need a round trip to ICSF. Entries are
+ * reference counted, since the BER buffer is still read by the holders after
+ * the entry has been replaced or invalidated.
+ */
+struct icsf_attr_cache {
+    unsigned long refs;
+    time_t created;
+    BerElement *result;
+};
 
 /* Each element of the btree objects should have this type: */
 struct icsf_object_mapping {
@@ -161,6 +198,10 @@ struct icsf_object_mapping {
     CK_SESSION_HANDLE session_id;
     struct icsf_object_record icsf_object;
     struct objstrength strength;
+
+    /* Protected by attr_cache_mutex */
+    struct icsf_attr_cache *attr_cache;
+    unsigned long attr_cache_gen;
 };
 
 /*
@@ -265,7 +306,7 @@ static struct session_state *get_session_state(STDLL_TokData_t * tokdata,
 {
     icsf_private_data_t *icsf_data = tokdata->private_data;
     struct session_state *found = NULL;
-    struct session_state *s;
+    union hashmap_value val;
 
     /* Lock sessions list */
     if (pthread_mutex_lock(&icsf_data->sess_list_mutex)) {
@@ -273,14 +314,9 @@ static struct session_state *get_session_state(STDLL_TokData_t * tokdata,
         return NULL;
     }
 
-    for_each_list_entry(&icsf_data->sessions, struct session_state, s, sessions) {
-        if (s->session_id == session_id) {
-            found = s;
-            goto done;
-        }
-    }
+    if (hashmap_find(icsf_data->sess_map, session_id, &val))
+        found = val.pVal;
 
-done:
     /* Unlock */
     if (pthread_mutex_unlock(&icsf_data->sess_list_mutex)) {
         TRACE_ERROR("Mutex Unlock failed.\n");
@@ -315,6 +351,153 @@ static CK_RV purge_object_mapping(STDLL_TokData_t * tokdata)
     return CKR_OK;
 }
 
+/*
+ * Drop a reference to a cached get attribute value result.
+ */
+static void attr_cache_put(icsf_private_data_t *icsf_data,
+                           struct icsf_attr_cache *cache)
+{
+    unsigned long refs;
+
+    if (pthread_mutex_lock(&icsf_data->attr_cache_mutex)) {
+        TRACE_ERROR("Failed to lock mutex.\n");
+        return;
+    }
+    refs = --cache->refs;
+    pthread_mutex_unlock(&icsf_data->attr_cache_mutex);
+
+    if (refs == 0) {
+        ber_free(cache->result, 1);
+        free(cache);
+    }
+}
+
+/*
+ * Get a reference to the cached attributes of an object, if there are any
+ * that are still valid. The generation of the object's cache is returned in
+ * gen and must be passed to attr_cache_set() when the caller fetched the
+ * attributes from ICSF itself.
+ */
+static struct icsf_attr_cache *attr_cache_get(icsf_private_data_t *icsf_data,
+                                      struct icsf_object_mapping *mapping,
+                                      unsigned long *gen)
+{
+    struct icsf_attr_cache *cache, *expired = NULL;
+
+    *gen = 0;
+    if (pthread_mutex_lock(&icsf_data->attr_cache_mutex)) {
+        TRACE_ERROR("Failed to lock mutex.\n");
+        return NULL;
+    }
+
+    *gen = mapping->attr_cache_gen;
+    cache = mapping->attr_cache;
+    if (cache != NULL && mapping->icsf_object.id != ICSF_SESSION_OBJECT &&
+        (unsigned long)(time(NULL) - cache->created) >=
+                                            icsf_data->attr_cache_ttl) {
+        mapping->attr_cache = NULL;
+        expired = cache;
+        cache = NULL;
+    }
+    if (cache != NULL)
+        cache->refs++;
+
+    pthread_mutex_unlock(&icsf_data->attr_cache_mutex);
+
+    if (expired != NULL)
+        attr_cache_put(icsf_data, expired);
+
+    return cache;
+}
+
+/*
+ * Keep the result of a get attribute value call for an object, unless the
+ * object's cache was invalidated after attr_cache_get() was called.
+ * Ownership of result is taken over in any case.
+ *
+ * Session objects can only be changed through this process, so their
+ * attributes are cached until they are changed or destroyed. Token objects
+ * may be changed by other processes and are only cached for attr_cache_ttl
+ * seconds, if configured.
+ */
+static void attr_cache_set(icsf_private_data_t *icsf_data,
+                           struct icsf_object_mapping *mapping,
+                           unsigned long gen, BerElement *result)
+{
+    struct icsf_attr_cache *cache, *old;
+
+    if (mapping->icsf_object.id != ICSF_SESSION_OBJECT &&
+        icsf_data->attr_cache_ttl == 0)
+        goto out;
+
+    cache = malloc(sizeof(*cache));
+    if (cache == NULL)
+        goto out;
+    cache->refs = 1;
+    cache->created = time(NULL);
+    cache->result = result;
+
+    if (pthread_mutex_lock(&icsf_data->attr_cache_mutex)) {
+        TRACE_ERROR("Failed to lock mutex.\n");
+        free(cache);
+        goto out;
+    }
+
+    if (mapping->attr_cache_gen != gen) {
+        pthread_mutex_unlock(&icsf_data->attr_cache_mutex);
+        free(cache);
+        goto out;
+    }
+    old = mapping->attr_cache;
+    mapping->attr_cache = cache;
+
+    pthread_mutex_unlock(&icsf_data->attr_cache_mutex);
+
+    if (old != NULL)
+        attr_cache_put(icsf_data, old);
+    return;
+
+out:
+    ber_free(result, 1);
+}
+
+/*
+ * Forget the cached attributes of an object, e.g. because they are changed.
+ */
+static void attr_cache_invalidate(icsf_private_data_t *icsf_data,
+                                  struct icsf_object_mapping *mapping)
+{
+    struct icsf_attr_cache *old;
+
+    if (pthread_mutex_lock(&icsf_data->attr_cache_mutex)) {
+        TRACE_ERROR("Failed to lock mutex.\n");
+        return;
+    }
+    mapping->attr_cache_gen++;
+    old = mapping->attr_cache;
+    mapping->attr_cache = NULL;
+    pthread_mutex_unlock(&icsf_data->attr_cache_mutex);
+
+    if (old != NULL)
+        attr_cache_put(icsf_data, old);
+}
+
+/*
+ * Called by the btree when the last reference to an object mapping is gone.
+ * Any user of the cached attributes also holds a reference to the mapping,
+ * so the mapping's own cache reference is the last one.
+ */
+static void free_object_mapping(void *value)
+{
+    struct icsf_object_mapping *mapping = value;
+
+    if (mapping->attr_cache != NULL) {
+        ber_free(mapping->attr_cache->result, 1);
+        free(mapping->attr_cache);
+    }
+    free(mapping);
+}
+
 /* Store ICSF specific data for each slot*/
 struct slot_data {
     int initialized;
@@ -396,6 +579,7 @@ CK_RV icsftok_init(STDLL_TokData_t * tokdata, CK_SLOT_ID slot_id,
     CK_RV rc;
     struct slot_data *data;
     icsf_private_data_t *icsf_data;
+    struct icsf_config config;
 
     TRACE_INFO("icsf %s slot=%lu running\n", __func__, slot_id);
 
@@ -419,19 +603,50 @@ CK_RV icsftok_init(STDLL_TokData_t * tokdata, CK_SLOT_ID slot_id,
     if (icsf_data == NULL)
         return CKR_HOST_MEMORY;
     list_init(&icsf_data->sessions);
+    list_init(&icsf_data->ldap_pool);
+    icsf_data->sess_map = hashmap_new();
+    if (icsf_data->sess_map == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        free(icsf_data);
+        return CKR_HOST_MEMORY;
+    }
     if (pthread_mutex_init(&icsf_data->sess_list_mutex, NULL) != 0) {
         TRACE_ERROR("Initializing session list lock failed.\n");
+        hashmap_free(icsf_data->sess_map, NULL);
+        free(icsf_data);
+        return CKR_CANT_LOCK;
+    }
+    if (pthread_mutex_init(&icsf_data->attr_cache_mutex, NULL) != 0) {
+        TRACE_ERROR("Initializing attribute cache lock failed.\n");
+        pthread_mutex_destroy(&icsf_data->sess_list_mutex);
+        hashmap_free(icsf_data->sess_map, NULL);
         free(icsf_data);
         return CKR_CANT_LOCK;
     }
-    if (bt_init(&icsf_data->objects, free) != CKR_OK) {
+    if (bt_init(&icsf_data->objects, free_object_mapping) != CKR_OK) {
         TRACE_ERROR("BTree init failed.\n");
+        pthread_mutex_destroy(&icsf_data->attr_cache_mutex);
         pthread_mutex_destroy(&icsf_data->sess_list_mutex);
+        hashmap_free(icsf_data->sess_map, NULL);
         free(icsf_data);
         return CKR_FUNCTION_FAILED;
     }
     tokdata->private_data = icsf_data;
 
+    /*
+     * The connection pool and attribute cache settings are process local,
+     * so they are not kept in the slot data but read here. The other settings
+     * are checked when the token data is initialized.
+     */
+    icsf_data->ldap_pool_max = ICSF_CFG_DEFAULT_LDAP_CONNECTIONS;
+    icsf_data->attr_cache_ttl = ICSF_CFG_DEFAULT_ATTR_CACHE_TTL;
+    if (parse_config_file(conf_name, slot_id, &config) == CKR_OK) {
+        icsf_data->ldap_pool_max = config.ldap_connections;
+        icsf_data->attr_cache_ttl = config.attr_cache_ttl;
+    }
+    TRACE_DEVEL("LDAP connections: %lu, attribute cache TTL: %lu\n",
+                icsf_data->ldap_pool_max, icsf_data->attr_cache_ttl);
+
     rc = XProcLock(tokdata);
     if (rc != CKR_OK)
         return CKR_FUNCTION_FAILED;
@@ -486,6 +701,17 @@ static struct ref refs[] = {
 };
 static const size_t refs_len = sizeof(refs)/sizeof(*refs);
 
+struct num_ref {
+    char *key;
+    unsigned long *addr;
+};
+
+static struct num_ref num_refs[] = {
+    { "ldap_connections",  &out_config.ldap_connections },
+    { "attr_cache_ttl",    &out_config.attr_cache_ttl },
+};
+static const size_t num_refs_len = sizeof(num_refs)/sizeof(*num_refs);
+
 static int check_keys(const char *conf_name)
 {
     size_t i;
@@ -533,6 +759,22 @@ found:
             continue;
         }
 
+        if (confignode_hastype(c, CT_INTVAL)) {
+            for (k = 0; k < num_refs_len; k++) {
+                if (!strcasecmp(num_refs[k].key, c->key)) {
+                    *num_refs[k].addr = confignode_to_intval(c)->value;
+                    goto found_num;
+                }
+            }
+
+            TRACE_ERROR("Error parsing config file '%s': unexpected token '%s' "
+                        "at line %d: \n", config_file, c->key, c->line);
+            return CKR_FUNCTION_FAILED;
+
+found_num:
+            continue;
+        }
+
         TRACE_ERROR("Error parsing config file '%s': unexpected token '%s' "
                     "at line %d: \n", config_file, c->key, c->line);
         return CKR_FUNCTION_FAILED;
@@ -557,6 +799,9 @@ static CK_RV parse_config_file(const char *conf_name, CK_SLOT_ID slot_id,
        return CKR_FUNCTION_FAILED;
     }
 
+    out_config.ldap_connections = ICSF_CFG_DEFAULT_LDAP_CONNECTIONS;
+    out_config.attr_cache_ttl = ICSF_CFG_DEFAULT_ATTR_CACHE_TTL;
+
     ret = parse_configlib_file(file, &config, config_parse_error, 0);
     fclose(file);
     if (ret != 0) {
@@ -621,6 +866,10 @@ static CK_RV parse_config_file(const char *conf_name, CK_SLOT_ID slot_id,
             TRACE_DEVEL(" %s = \"%s\"\n", refs[i].key,
                         refs[i].addr);
         }
+        for (i = 0; i < num_refs_len; i++) {
+            TRACE_DEVEL(" %s = %lu\n", num_refs[i].key,
+                        *num_refs[i].addr);
+        }
     }
     #endif
 
@@ -1355,6 +1604,108 @@ LDAP *getLDAPhandle(STDLL_TokData_t * tokdata, CK_SLOT_ID slot_id)
     return new_ld;
 }
 
+/*
+ * Get a connection from the LDAP pool for a session. An idle connection is
+ * preferred, otherwise a new one is bound as long as the pool is not full.
+ * When the pool is full, the connection with the fewest sessions is shared
+ * (if the LDAP library allows it) by several sessions. A pool size of 0 (the
+ * default) disables pooling, every session then binds its own connection.
+ *
+ * Must be called with sess_list_mutex locked.
+ */
+static struct icsf_ldap_conn *ldap_pool_get(STDLL_TokData_t * tokdata,
+                                            CK_SLOT_ID slot_id)
+{
+    icsf_private_data_t *icsf_data = tokdata->private_data;
+    struct icsf_ldap_conn *conn, *best = NULL;
+    LDAP *ld;
+
+    for_each_list_entry(&icsf_data->ldap_pool, struct icsf_ldap_conn, conn,
+                        pool) {
+        if (icsf_data->ldap_pool_max == 0)
+            break;
+        if (conn->users == 0) {
+            best = conn;
+            break;
+        }
+#if ICSF_LDAP_SHARED_CONNECTIONS
+        if (best == NULL || conn->users < best->users)
+            best = conn;
+#endif
+    }
+
+    if (best == NULL ||
+        (best->users > 0 &&
+         icsf_data->ldap_pool_size < icsf_data->ldap_pool_max)) {
+        ld = getLDAPhandle(tokdata, slot_id);
+        if (ld != NULL) {
+            conn = calloc(1, sizeof(*conn));
+            if (conn == NULL) {
+                TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+                icsf_logout(ld);
+            } else {
+                conn->ld = ld;
+                list_insert_head(&icsf_data->ldap_pool, &conn->pool);
+                icsf_data->ldap_pool_size++;
+                best = conn;
+            }
+        }
+
+        /* Fall back to share a connection if a new one can't be bound */
+        if (best == NULL)
+            return NULL;
+    }
+
+    best->users++;
+
+    TRACE_DEVEL("Using LDAP connection %p (%lu users, %lu connections)\n",
+                (void *)best->ld, best->users, icsf_data->ldap_pool_size);
+
+    return best;
+}
+
+/*
+ * Remove a connection from the LDAP pool and unbind it. After a fork the
+ * connection belongs to the parent process, so it is just forgotten.
+ *
+ * Must be called with sess_list_mutex locked.
+ */
+static CK_RV ldap_pool_remove(icsf_private_data_t *icsf_data,
+                              struct icsf_ldap_conn *conn,
+                              CK_BBOOL in_fork_initializer)
+{
+    CK_RV rc = CKR_OK;
+
+    list_remove(&conn->pool);
+    icsf_data->ldap_pool_size--;
+
+    if (!in_fork_initializer && icsf_logout(conn->ld)) {
+        TRACE_DEVEL("Failed to disconnect from LDAP server.\n");
+        rc = CKR_FUNCTION_FAILED;
+    }
+    free(conn);
+
+    return rc;
+}
+
+/*
+ * Give a session's connection back to the LDAP pool. Idle connections stay
+ * bound for later sessions, unless the pool has more connections than
+ * configured.
+ *
+ * Must be called with sess_list_mutex locked.
+ */
+static CK_RV ldap_pool_put(icsf_private_data_t *icsf_data,
+                           struct icsf_ldap_conn *conn,
+                           CK_BBOOL in_fork_initializer)
+{
+    if (--conn->users > 0 ||
+        icsf_data->ldap_pool_size <= icsf_data->ldap_pool_max)
+        return CKR_OK;
+
+    return ldap_pool_remove(icsf_data, conn, in_fork_initializer);
+}
+
 CK_RV icsf_get_handles(STDLL_TokData_t * tokdata, CK_SLOT_ID slot_id)
 {
     icsf_private_data_t *icsf_data = tokdata->private_data;
@@ -1369,8 +1720,11 @@ CK_RV icsf_get_handles(STDLL_TokData_t * tokdata, CK_SLOT_ID slot_id)
 
     for_each_list_entry(&icsf_data->sessions, struct session_state, s,
                         sessions) {
-        if (s->ld == NULL)
-            s->ld = getLDAPhandle(tokdata, slot_id);
+        if (s->ld == NULL) {
+            s->conn = ldap_pool_get(tokdata, slot_id);
+            if (s->conn != NULL)
+                s->ld = s->conn->ld;
+        }
     }
 
     if (pthread_mutex_unlock(&icsf_data->sess_list_mutex)) {
@@ -1385,8 +1739,8 @@ CK_RV icsftok_open_session(STDLL_TokData_t * tokdata, SESSION * sess)
 {
     icsf_private_data_t *icsf_data = tokdata->private_data;
     CK_RV rc = CKR_OK;
-    LDAP *ld;
     struct session_state *session_state;
+    union hashmap_value val;
 
     /* Sanity */
     if (sess == NULL) {
@@ -1402,6 +1756,7 @@ CK_RV icsftok_open_session(STDLL_TokData_t * tokdata, SESSION * sess)
     }
     session_state->session_id = sess->handle;
     session_state->ld = NULL;
+    session_state->conn = NULL;
 
     if (pthread_mutex_lock(&icsf_data->sess_list_mutex)) {
         TRACE_ERROR("Failed to lock mutex.\n");
@@ -1413,17 +1768,26 @@ CK_RV icsftok_open_session(STDLL_TokData_t * tokdata, SESSION * sess)
      * same login state.
      */
     if (session_mgr_user_session_exists(tokdata)) {
-        ld = getLDAPhandle(tokdata, sess->session_info.slotID);
-        if (ld == NULL) {
+        session_state->conn = ldap_pool_get(tokdata,
+                                            sess->session_info.slotID);
+        if (session_state->conn == NULL) {
             TRACE_DEVEL("Failed to get LDAP handle for session.\n");
             rc = CKR_FUNCTION_FAILED;
             goto done;
         }
-        /* put the new ldap handle into the session state. */
-        session_state->ld = ld;
+        /* put the ldap handle into the session state. */
+        session_state->ld = session_state->conn->ld;
     }
 
     /* put new session_state into the list */
+    val.pVal = session_state;
+    if (hashmap_add(icsf_data->sess_map, sess->handle, val, NULL)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        if (session_state->conn != NULL)
+            ldap_pool_put(icsf_data, session_state->conn, FALSE);
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
     list_insert_head(&icsf_data->sessions, &session_state->sessions);
 
 done:
@@ -1496,21 +1860,21 @@ static CK_RV close_session(STDLL_TokData_t * tokdata,
     if (rc)
         return rc;
 
-    /* Log off from LDAP server */
-    if (session_state->ld) {
-        if (!in_fork_initializer && icsf_logout(session_state->ld)) {
-            TRACE_DEVEL("Failed to disconnect from LDAP server.\n");
-            return CKR_FUNCTION_FAILED;
-        }
-        session_state->ld = NULL;
-    }
-
     if (pthread_mutex_lock(&icsf_data->sess_list_mutex)) {
         TRACE_ERROR("Failed to lock mutex.\n");
         return CKR_FUNCTION_FAILED;
     }
 
+    /* Give the LDAP connection back to the pool */
+    if (session_state->conn) {
+        rc = ldap_pool_put(icsf_data, session_state->conn,
+                           in_fork_initializer);
+        session_state->conn = NULL;
+        session_state->ld = NULL;
+    }
+
     /* Remove session */
+    hashmap_delete(icsf_data->sess_map, session_state->session_id, NULL);
     list_remove(&session_state->sessions);
     if (list_is_empty(&icsf_data->sessions)) {
         if (purge_object_mapping(tokdata)) {
@@ -1559,6 +1923,7 @@ CK_RV icsftok_final(STDLL_TokData_t * tokdata, CK_BBOOL finalize,
     icsf_private_data_t *icsf_data = tokdata->private_data;
     CK_RV rc = CKR_OK;
     struct session_state *session_state;
+    struct icsf_ldap_conn *conn;
     list_entry_t *e;
 
     /* Lock to add a new session in the list */
@@ -1573,6 +1938,15 @@ CK_RV icsftok_final(STDLL_TokData_t * tokdata, CK_BBOOL finalize,
             break;
     }
 
+    /* Unbind the pooled LDAP connections */
+    if (finalize) {
+        for_each_list_entry_safe(&icsf_data->ldap_pool, struct icsf_ldap_conn,
+                                 conn, pool, e) {
+            if (ldap_pool_remove(icsf_data, conn, in_fork_initializer))
+                TRACE_DEVEL("Failed to remove pooled LDAP connection.\n");
+        }
+    }
+
     /* Unlock */
     if (pthread_mutex_unlock(&icsf_data->sess_list_mutex)) {
         TRACE_ERROR("Mutex Unlock Failed.\n");
@@ -1581,6 +1955,8 @@ CK_RV icsftok_final(STDLL_TokData_t * tokdata, CK_BBOOL finalize,
 
     if (finalize) {
         bt_destroy(&icsf_data->objects);
+        hashmap_free(icsf_data->sess_map, NULL);
+        pthread_mutex_destroy(&icsf_data->attr_cache_mutex);
         pthread_mutex_destroy(&icsf_data->sess_list_mutex);
         free(icsf_data);
         tokdata->private_data = NULL;
@@ -1812,7 +2188,7 @@ CK_RV icsftok_copy_object(STDLL_TokData_t * tokdata,
     }
 
     /* Allocate structure for new object */
-    if (!(mapping_dst = malloc(sizeof(*mapping_dst)))) {
+    if (!(mapping_dst = calloc(1, sizeof(*mapping_dst)))) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         rc = CKR_HOST_MEMORY;
         goto done;
@@ -2165,8 +2541,8 @@ CK_RV icsftok_generate_key_pair(STDLL_TokData_t * tokdata, SESSION * session,
     }
 
     /* Allocate structure to keep ICSF objects information */
-    if (!(pub_key_mapping = malloc(sizeof(*pub_key_mapping))) ||
-        !(priv_key_mapping = malloc(sizeof(*priv_key_mapping)))) {
+    if (!(pub_key_mapping = calloc(1, sizeof(*pub_key_mapping))) ||
+        !(priv_key_mapping = calloc(1, sizeof(*priv_key_mapping)))) {
         TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
         rc = CKR_HOST_MEMORY;
         goto done;
@@ -3537,6 +3913,8 @@ CK_RV icsftok_get_attribute_value(STDLL_TokData_t * tokdata,
     CK_BBOOL priv_obj;
     struct session_state *session_state;
     struct icsf_object_mapping *mapping = NULL;
+    struct icsf_attr_cache *cache = NULL;
+    unsigned long cache_gen = 0;
     BerElement *cached_result = NULL;
     int reason = 0;
 
@@ -3566,6 +3944,11 @@ CK_RV icsftok_get_attribute_value(STDLL_TokData_t * tokdata,
         goto done;
     }
 
+    /* use the attributes of a previous call, if still valid */
+    cache = attr_cache_get(icsf_data, mapping, &cache_gen);
+    if (cache != NULL)
+        cached_result = cache->result;
+
     /* get the private attribute so we can check the permissions */
     rc = icsf_get_attribute(session_state->ld, &reason, &cached_result,
                             &mapping->icsf_object, priv_attr, 1);
@@ -3605,14 +3988,16 @@ CK_RV icsftok_get_attribute_value(STDLL_TokData_t * tokdata,
     }
 
 done:
+    if (cache != NULL)
+        attr_cache_put(icsf_data, cache);
+    else if (cached_result != NULL)
+        attr_cache_set(icsf_data, mapping, cache_gen, cached_result);
+
     if (mapping) {
         bt_put_node_value(&icsf_data->objects, mapping);
         mapping = NULL;
     }
 
-    if (cached_result != NULL)
-        ber_free(cached_result, 1);
-
     return rc;
 }
 
@@ -3681,6 +4066,7 @@ CK_RV icsftok_set_attribute_value(STDLL_TokData_t * tokdata,
     /* Now call into icsf to set the attribute values */
     rc = icsf_set_attribute(session_state->ld, &reason,
                             &mapping->icsf_object, pTemplate, ulCount);
+    attr_cache_invalidate(icsf_data, mapping);
     if (rc != CKR_OK) {
         TRACE_ERROR("icsf_set_attribute failed\n");
         rc = icsf_to_ock_err(rc, reason);
@@ -3827,7 +4213,7 @@ CK_RV icsftok_find_objects_init(STDLL_TokData_t * tokdata, SESSION * sess,
             if (!node_number) {
                 struct icsf_object_mapping *new_mapping;
 
-                if (!(new_mapping = malloc(sizeof(*new_mapping)))) {
+                if (!(new_mapping = calloc(1, sizeof(*new_mapping)))) {
                     TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
                     rv = CKR_HOST_MEMORY;
                     goto done;
@@ -3919,6 +4305,7 @@ CK_RV icsftok_destroy_object(STDLL_TokData_t * tokdata, SESSION * sess,
     }
 
     /* Now remove the object from ICSF */
+    attr_cache_invalidate(icsf_data, mapping);
     rc = icsf_destroy_object(session_state->ld, &reason, &mapping->icsf_object);
     if (rc != 0) {
         TRACE_DEVEL("icsf_destroy_object failed\n");
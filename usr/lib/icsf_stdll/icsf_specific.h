@@ -33,6 +33,31 @@ typedef struct {
     list_t sessions;
     pthread_mutex_t sess_list_mutex;
 
+    /*
+     * Maps session handles to their session_state, so that the session
+     * specific data can be found without walking the list. Protected by
+     * sess_list_mutex as well.
+     */
+    struct hashmap *sess_map;
+
+    /*
+     * Pool of bound LDAP connections used by the sessions, if enabled with
+     * LDAP_CONNECTIONS. Sessions share the pooled connections when the LDAP
+     * library is thread-safe, so that concurrent sessions need a bounded
+     * number of binds. Protected by sess_list_mutex.
+     */
+    list_t ldap_pool;
+    unsigned long ldap_pool_size;
+    unsigned long ldap_pool_max;
+
+    /*
+     * Protects the per-object attribute caches. Token objects are only
+     * cached when attr_cache_ttl (in seconds) is not zero, since they can be
+     * changed by other processes.
+     */
+    pthread_mutex_t attr_cache_mutex;
+    unsigned long attr_cache_ttl;
+
     /*
      * This binary tree keeps the mapping between ICSF object handles and PKCS#11
      * object handles. The tree index is used as the PKCS#11 handle.
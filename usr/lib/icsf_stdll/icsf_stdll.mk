@@ -46,6 +46,8 @@ opencryptoki_stdll_libpkcs11_icsf_la_SOURCES = usr/lib/common/asn1.c	\
 	usr/lib/config/configuration.c usr/lib/common/pqc_supported.c	\
 	usr/lib/config/cfgparse.y usr/lib/config/cfglex.l		\
 	usr/lib/common/mech_openssl.c					\
-	usr/lib/common/btree.c usr/lib/common/sess_mgr.c
+	usr/lib/common/sw_sha.c						\
+	usr/lib/common/btree.c usr/lib/common/sess_mgr.c		\
+	usr/lib/api/hashmap.c
 
 usr/lib/icsf_stdll/icsf_specific.$(OBJEXT): usr/lib/config/cfgparse.h
@@ -78,7 +78,7 @@ CK_RV ST_Initialize(API_Slot_t *sltp, CK_SLOT_ID SlotNumber,
     /* set trace info */
     set_trace(t);
 
-    rc = bt_init(&sltp->TokData->sess_btree, free);
+    rc = bt_init(&sltp->TokData->sess_btree, call_session_free);
     rc |= bt_init(&sltp->TokData->object_map_btree, free);
     rc |= bt_init(&sltp->TokData->sess_obj_btree, call_object_free);
     rc |= bt_init(&sltp->TokData->priv_token_obj_btree, call_object_free);
@@ -3382,6 +3382,210 @@ done:
     return rc;
 }
 
+CK_RV SC_IBM_ReencryptBatch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                            CK_MECHANISM_PTR pDecrMech,
+                            CK_OBJECT_HANDLE hDecrKey,
+                            CK_MECHANISM_PTR pEncrMech,
+                            CK_OBJECT_HANDLE hEncrKey,
+                            CK_ULONG ulCount,
+                            CK_VOID_PTR *ppDecrParams,
+                            CK_VOID_PTR *ppEncrParams,
+                            CK_BYTE_PTR *ppEncryptedData,
+                            CK_ULONG_PTR pulEncryptedDataLen,
+                            CK_BYTE_PTR *ppReencryptedData,
+                            CK_ULONG_PTR pulReencryptedDataLen,
+                            CK_RV *pResults)
+{
+    SESSION *sess = NULL;
+    CK_RV rc = CKR_OK;
+
+    UNUSED(hDecrKey);
+    UNUSED(hEncrKey);
+    UNUSED(ppDecrParams);
+    UNUSED(ppEncrParams);
+    UNUSED(ppReencryptedData);
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pDecrMech || !pEncrMech) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    if (ulCount > 0 && (!ppEncryptedData || !pulEncryptedDataLen ||
+                        !pulReencryptedDataLen || !pResults)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pDecrMech, CKF_DECRYPT);
+    if (rc != CKR_OK)
+        goto done;
+    rc = valid_mech(tokdata, pEncrMech, CKF_ENCRYPT);
+    if (rc != CKR_OK)
+        goto done;
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    if (sess->decr_ctx.active == TRUE || sess->encr_ctx.active == TRUE) {
+        rc = CKR_OPERATION_ACTIVE;
+        TRACE_ERROR("%s\n", ock_err(ERR_OPERATION_ACTIVE));
+        goto done;
+    }
+
+    rc = CKR_FUNCTION_NOT_SUPPORTED;
+
+done:
+    TRACE_INFO("SC_IBM_ReencryptBatch: rc = 0x%08lx, sess = %ld, "
+               "decrmech = 0x%lx, encrmech = 0x%lx, count = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               (pDecrMech ? pDecrMech->mechanism : (CK_ULONG)-1),
+               (pEncrMech ? pEncrMech->mechanism : (CK_ULONG)-1), ulCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_DigestBatch(STDLL_TokData_t *tokdata, ST_SESSION_T *sSession,
+                         CK_MECHANISM_PTR pMechanism, CK_ULONG ulCount,
+                         CK_BYTE_PTR *ppData, CK_ULONG_PTR pulDataLen,
+                         CK_BYTE_PTR pDigests, CK_ULONG_PTR pulDigestsLen)
+{
+    SESSION *sess = NULL;
+    CK_BBOOL length_only = FALSE;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (!pMechanism || !pulDigestsLen ||
+        (ulCount > 0 && (!ppData || !pulDataLen))) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    rc = valid_mech(tokdata, pMechanism, CKF_DIGEST);
+    if (rc != CKR_OK)
+        goto done;
+
+    if (pin_expired(&sess->session_info,
+                    tokdata->nv_token_data->token_info.flags) == TRUE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_PIN_EXPIRED));
+        rc = CKR_PIN_EXPIRED;
+        goto done;
+    }
+
+    if (!pDigests)
+        length_only = TRUE;
+
+    rc = digest_mgr_digest_batch(tokdata, sess, length_only, pMechanism,
+                                 ulCount, ppData, pulDataLen, pDigests,
+                                 pulDigestsLen);
+    if (rc != CKR_OK)
+        TRACE_DEVEL("digest_mgr_digest_batch() failed.\n");
+
+done:
+    TRACE_INFO("SC_IBM_DigestBatch: rc = 0x%08lx, sess = %ld, mech = 0x%lx, "
+               "count = %lu\n",
+               rc, (sess == NULL) ? -1 : (CK_LONG) sess->handle,
+               (pMechanism ? pMechanism->mechanism : (CK_ULONG)-1), ulCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
+CK_RV SC_IBM_GetAttributeValueBatch(STDLL_TokData_t *tokdata,
+                                    ST_SESSION_T *sSession,
+                                    CK_ULONG ulCount,
+                                    CK_OBJECT_HANDLE_PTR phObjects,
+                                    CK_ATTRIBUTE_PTR *ppTemplates,
+                                    CK_ULONG_PTR pulAttributeCounts,
+                                    CK_RV *pResults)
+{
+    SESSION *sess = NULL;
+    CK_ULONG i;
+    CK_RV rc = CKR_OK;
+
+    if (tokdata->initialized == FALSE) {
+        TRACE_ERROR("%s\n", ock_err(ERR_CRYPTOKI_NOT_INITIALIZED));
+        rc = CKR_CRYPTOKI_NOT_INITIALIZED;
+        goto done;
+    }
+
+    if (ulCount > 0 && (!phObjects || !ppTemplates || !pulAttributeCounts ||
+                        !pResults)) {
+        TRACE_ERROR("%s\n", ock_err(ERR_ARGUMENTS_BAD));
+        rc = CKR_ARGUMENTS_BAD;
+        goto done;
+    }
+
+    sess = session_mgr_find_reset_error(tokdata, sSession->sessionh);
+    if (!sess) {
+        TRACE_ERROR("%s\n", ock_err(ERR_SESSION_HANDLE_INVALID));
+        rc = CKR_SESSION_HANDLE_INVALID;
+        goto done;
+    }
+
+    //set the handle into the session.
+    sess->handle = sSession->sessionh;
+
+    /* ICSF has no batch interface, get the objects one by one */
+    for (i = 0; i < ulCount; i++) {
+        if (ppTemplates[i] == NULL) {
+            pResults[i] = CKR_ARGUMENTS_BAD;
+            continue;
+        }
+
+        pResults[i] = icsftok_get_attribute_value(tokdata, sess,
+                                                  phObjects[i],
+                                                  ppTemplates[i],
+                                                  pulAttributeCounts[i],
+                                                  NULL);
+    }
+
+done:
+    TRACE_INFO("C_IBM_GetAttributeValueBatch: rc = 0x%08lx, count = %lu\n",
+               rc, ulCount);
+
+    if (sess != NULL)
+        session_mgr_put(tokdata, sess);
+
+    return rc;
+}
+
 CK_RV SC_HandleEvent(STDLL_TokData_t *tokdata, unsigned int event_type,
                      unsigned int event_flags, const char *payload,
                      unsigned int payload_len)
@@ -3466,6 +3670,9 @@ void SC_SetFunctionList(void)
     function_list.ST_SessionCancel = SC_SessionCancel;
 
     function_list.ST_IBM_ReencryptSingle = SC_IBM_ReencryptSingle;
+    function_list.ST_IBM_DigestBatch = SC_IBM_DigestBatch;
+    function_list.ST_IBM_ReencryptBatch = SC_IBM_ReencryptBatch;
+    function_list.ST_IBM_GetAttributeValueBatch = SC_IBM_GetAttributeValueBatch;
 
     function_list.ST_HandleEvent = SC_HandleEvent;
 }
@@ -0,0 +1,766 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+/*
+ * Key pair pre-generation for the soft token.
+ *
+ * Generating RSA keys with large moduli or Dilithium keys can take from
+ * hundreds of milliseconds up to seconds. The token configuration file can
+ * define pools of key pairs for specific key generation parameters. A
+ * background thread keeps these pools filled with freshly generated keys, so
+ * that C_GenerateKeyPair for a pooled parameter set only needs to take a key
+ * from the pool and add its components to the key templates.
+ *
+ * If statistics are enabled, the number of generated keys, hits and misses of
+ * each pool are published in a shared memory segment per user and slot, and
+ * can be displayed with pkcsstats --keygen-pools.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <syslog.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <openssl/evp.h>
+#include <openssl/err.h>
+#include <openssl/objects.h>
+#include <openssl/rsa.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "h_extern.h"
+#include "trace.h"
+#include "ock_syslog.h"
+#include "supportedstrengths.h"
+#include "soft_keygen_pool.h"
+
+static void soft_keygen_pool_free(struct soft_keygen_pool *pool)
+{
+    CK_ULONG i;
+
+    if (pool->keys != NULL) {
+        for (i = 0; i < pool->count; i++)
+            EVP_PKEY_free(pool->keys[i]);
+        free(pool->keys);
+    }
+    free(pool);
+}
+
+static const char *soft_keygen_pool_keytype_name(CK_KEY_TYPE keytype)
+{
+    switch (keytype) {
+    case CKK_RSA:
+        return "RSA";
+    case CKK_EC:
+        return "EC";
+    case CKK_IBM_PQC_DILITHIUM:
+        return "IBM_DILITHIUM";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+static CK_RV soft_keygen_pool_set_keytype(struct soft_keygen_pool *pool,
+                                          const char *fname,
+                                          struct ConfigBaseNode *c)
+{
+    const char *strval = confignode_getstr(c);
+
+    if (strval != NULL && strcasecmp(strval, "RSA") == 0) {
+        pool->keytype = CKK_RSA;
+        pool->mech = CKM_RSA_PKCS_KEY_PAIR_GEN;
+        return CKR_OK;
+    }
+#ifndef NO_EC
+    if (strval != NULL && strcasecmp(strval, "EC") == 0) {
+        pool->keytype = CKK_EC;
+        pool->mech = CKM_EC_KEY_PAIR_GEN;
+        return CKR_OK;
+    }
+#endif
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    if (strval != NULL && strcasecmp(strval, "IBM_DILITHIUM") == 0) {
+        pool->keytype = CKK_IBM_PQC_DILITHIUM;
+        pool->mech = CKM_IBM_DILITHIUM;
+        return CKR_OK;
+    }
+#endif
+
+    OCK_SYSLOG(LOG_ERR, "Error parsing config file '%s': unsupported key "
+               "type '%s' at line %d\n", fname, strval != NULL ? strval : "",
+               c->line);
+    TRACE_ERROR("Error parsing config file '%s': unsupported key type '%s' "
+                "at line %d\n", fname, strval != NULL ? strval : "", c->line);
+    return CKR_FUNCTION_FAILED;
+}
+
+static CK_RV soft_keygen_pool_set_curve(struct soft_keygen_pool *pool,
+                                        const char *fname,
+                                        struct ConfigBaseNode *c)
+{
+    const char *strval = confignode_getstr(c);
+    int nid = NID_undef;
+    CK_ULONG i;
+
+    if (strval != NULL)
+        nid = OBJ_txt2nid(strval);
+
+    for (i = 0; nid != NID_undef && i < NUMEC; i++) {
+        if (der_ec_supported[i].nid == nid) {
+            pool->curve = &der_ec_supported[i];
+            return CKR_OK;
+        }
+    }
+
+    OCK_SYSLOG(LOG_ERR, "Error parsing config file '%s': unsupported curve "
+               "'%s' at line %d\n", fname, strval != NULL ? strval : "",
+               c->line);
+    TRACE_ERROR("Error parsing config file '%s': unsupported curve '%s' at "
+                "line %d\n", fname, strval != NULL ? strval : "", c->line);
+    return CKR_FUNCTION_FAILED;
+}
+
+static CK_RV soft_keygen_pool_check(struct soft_keygen_pool *pool,
+                                    const char *fname, int line)
+{
+    const char *msg = NULL;
+
+    if (pool->depth == 0 || pool->depth > SOFT_KEYGEN_POOL_MAX_DEPTH)
+        msg = "invalid or missing " SOFT_CFG_DEPTH;
+
+    switch (pool->keytype) {
+    case CKK_RSA:
+        if (pool->mod_bits < 512 ||
+            pool->mod_bits > OPENSSL_RSA_MAX_MODULUS_BITS)
+            msg = "invalid or missing " SOFT_CFG_MODULUS_BITS;
+        else if (pool->publ_exp == 0)
+            msg = "invalid " SOFT_CFG_PUBLIC_EXPONENT;
+        break;
+    case CKK_EC:
+        if (pool->curve == NULL)
+            msg = "missing " SOFT_CFG_CURVE;
+        break;
+    case CKK_IBM_PQC_DILITHIUM:
+        if (pool->oid == NULL)
+            msg = "invalid or missing " SOFT_CFG_KEYFORM;
+        break;
+    default:
+        msg = "missing " SOFT_CFG_KEY_TYPE;
+        break;
+    }
+
+    if (msg != NULL) {
+        OCK_SYSLOG(LOG_ERR, "Error parsing config file '%s': %s for %s at "
+                   "line %d\n", fname, msg, SOFT_CFG_KEYGEN_POOL, line);
+        TRACE_ERROR("Error parsing config file '%s': %s for %s at line %d\n",
+                    fname, msg, SOFT_CFG_KEYGEN_POOL, line);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    return CKR_OK;
+}
+
+/*
+ * Parses a KEYGEN_POOL structure of the token configuration file and adds
+ * the pool to the list of pools.
+ */
+CK_RV soft_keygen_pool_parse_config(struct soft_keygen_pools *pools,
+                                    const char *fname,
+                                    struct ConfigStructNode *pool_node)
+{
+    struct soft_keygen_pool *pool;
+    struct ConfigBaseNode *c;
+    CK_RV rc = CKR_OK;
+    int i;
+
+    pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        return CKR_HOST_MEMORY;
+    }
+
+    pool->keytype = (CK_KEY_TYPE)-1;
+    pool->publ_exp = 65537;
+
+    confignode_foreach(c, pool_node->value, i) {
+        TRACE_DEBUG("Config node: '%s' type: %u line: %u\n",
+                    c->key, c->type, c->line);
+
+        if (strcasecmp(c->key, SOFT_CFG_KEY_TYPE) == 0 &&
+            confignode_hastype(c, CT_BAREVAL | CT_STRINGVAL)) {
+            rc = soft_keygen_pool_set_keytype(pool, fname, c);
+            if (rc != CKR_OK)
+                break;
+            continue;
+        }
+
+        if (strcasecmp(c->key, SOFT_CFG_CURVE) == 0 &&
+            confignode_hastype(c, CT_BAREVAL | CT_STRINGVAL)) {
+            rc = soft_keygen_pool_set_curve(pool, fname, c);
+            if (rc != CKR_OK)
+                break;
+            continue;
+        }
+
+        if (confignode_hastype(c, CT_INTVAL)) {
+            if (strcasecmp(c->key, SOFT_CFG_MODULUS_BITS) == 0) {
+                pool->mod_bits = confignode_to_intval(c)->value;
+                continue;
+            }
+            if (strcasecmp(c->key, SOFT_CFG_PUBLIC_EXPONENT) == 0) {
+                pool->publ_exp = confignode_to_intval(c)->value;
+                continue;
+            }
+            if (strcasecmp(c->key, SOFT_CFG_KEYFORM) == 0) {
+                pool->oid = find_pqc_by_keyform(dilithium_oids,
+                                                confignode_to_intval(c)->value);
+                continue;
+            }
+            if (strcasecmp(c->key, SOFT_CFG_DEPTH) == 0) {
+                pool->depth = confignode_to_intval(c)->value;
+                continue;
+            }
+        }
+
+        OCK_SYSLOG(LOG_ERR, "Error parsing config file '%s': unexpected token "
+                   "'%s' at line %d\n", fname, c->key, c->line);
+        TRACE_ERROR("Error parsing config file '%s': unexpected token '%s' "
+                    "at line %d\n", fname, c->key, c->line);
+        rc = CKR_FUNCTION_FAILED;
+        break;
+    }
+
+    if (rc == CKR_OK)
+        rc = soft_keygen_pool_check(pool, fname, pool_node->base.line);
+    if (rc != CKR_OK)
+        goto error;
+
+    pool->keys = calloc(pool->depth, sizeof(EVP_PKEY *));
+    if (pool->keys == NULL) {
+        TRACE_ERROR("%s\n", ock_err(ERR_HOST_MEMORY));
+        rc = CKR_HOST_MEMORY;
+        goto error;
+    }
+
+    TRACE_INFO("Key pool: type: %s mod_bits: %lu curve nid: %d keyform: %lu "
+               "depth: %lu\n", soft_keygen_pool_keytype_name(pool->keytype),
+               pool->mod_bits, pool->curve != NULL ? pool->curve->nid : 0,
+               pool->oid != NULL ? pool->oid->keyform : 0, pool->depth);
+
+    pool->next = pools->pools;
+    pools->pools = pool;
+
+    return CKR_OK;
+
+error:
+    soft_keygen_pool_free(pool);
+    return rc;
+}
+
+static CK_RV soft_keygen_pool_generate(struct soft_keygen_pool *pool,
+                                       EVP_PKEY **pkey)
+{
+    CK_BYTE publ_exp[sizeof(CK_ULONG)];
+    CK_ULONG i;
+
+    switch (pool->keytype) {
+    case CKK_RSA:
+        for (i = 0; i < sizeof(publ_exp); i++)
+            publ_exp[i] = (pool->publ_exp >> (8 * (sizeof(publ_exp) - 1 - i)))
+                                                                        & 0xff;
+        return openssl_specific_rsa_keygen_pkey(pool->mod_bits, publ_exp,
+                                                sizeof(publ_exp), pkey);
+#ifndef NO_EC
+    case CKK_EC:
+        return openssl_specific_ec_keygen_pkey(pool->curve->data,
+                                               pool->curve->data_size, pkey);
+#endif
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    case CKK_IBM_PQC_DILITHIUM:
+        return openssl_specific_ibm_dilithium_keygen_pkey(pool->oid, pkey);
+#endif
+    default:
+        return CKR_KEY_TYPE_INCONSISTENT;
+    }
+}
+
+/*
+ * Returns the pool that is filled the least, relative to its depth, or NULL
+ * if all pools are full. Must be called with the pools mutex held.
+ */
+static struct soft_keygen_pool *soft_keygen_pool_next_to_fill(
+                                            struct soft_keygen_pools *pools)
+{
+    struct soft_keygen_pool *pool, *best = NULL;
+
+    for (pool = pools->pools; pool != NULL; pool = pool->next) {
+        if (pool->disabled || pool->count >= pool->depth)
+            continue;
+        if (best == NULL ||
+            pool->count * best->depth < best->count * pool->depth)
+            best = pool;
+    }
+
+    return best;
+}
+
+static void soft_keygen_pool_stats_name(STDLL_TokData_t *tokdata, char *name,
+                                        size_t name_len)
+{
+    size_t i;
+
+    snprintf(name, name_len - 1, STAT_KEYPOOL_SHM_NAME_FMT, CONFIG_PATH,
+             geteuid(), tokdata->slot_id);
+    for (i = 1; name[i] != '\0'; i++) {
+        if (name[i] == '/')
+            name[i] = '.';
+    }
+    if (name[0] != '/') {
+        memmove(&name[1], &name[0], strlen(name) + 1);
+        name[0] = '/';
+    }
+}
+
+/*
+ * Opens (and creates if required) the key pool statistics shared memory
+ * segment of the current user for the token's slot. Only used if statistics
+ * are enabled in the openCryptoki configuration.
+ */
+static CK_RV soft_keygen_pools_stats_open(STDLL_TokData_t *tokdata,
+                                          struct soft_keygen_pools *pools)
+{
+    char name[PATH_MAX];
+    struct stat stat_buf;
+    int fd, clear = 0;
+    void *data;
+
+    if (tokdata->statistics == NULL ||
+        tokdata->statistics->increment_func == NULL)
+        return CKR_OK;
+
+    soft_keygen_pool_stats_name(tokdata, name, sizeof(name));
+    TRACE_INFO("Key pool statistics SHM name: '%s'\n", name);
+
+    fd = shm_open(name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        TRACE_ERROR("Failed to open SHM '%s': %s\n", name, strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (fstat(fd, &stat_buf) != 0) {
+        TRACE_ERROR("Failed to stat SHM '%s': %s\n", name, strerror(errno));
+        close(fd);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    /* Do not use a segment not owned by the current user */
+    if (stat_buf.st_uid != geteuid() ||
+        (stat_buf.st_mode & ~S_IFMT) != (S_IRUSR | S_IWUSR)) {
+        TRACE_ERROR("SHM '%s' has wrong mode/owner\n", name);
+        OCK_SYSLOG(LOG_ERR, "SHM '%s' has wrong mode/owner\n", name);
+        close(fd);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if ((size_t)stat_buf.st_size != STAT_KEYPOOL_SHM_SIZE) {
+        if (ftruncate(fd, STAT_KEYPOOL_SHM_SIZE) < 0) {
+            TRACE_ERROR("Failed to set size of SHM '%s': %s\n", name,
+                        strerror(errno));
+            close(fd);
+            return CKR_FUNCTION_FAILED;
+        }
+        clear = 1;
+    }
+
+    data = mmap(NULL, STAT_KEYPOOL_SHM_SIZE, PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        TRACE_ERROR("Failed to memory-map SHM '%s': %s\n", name,
+                    strerror(errno));
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (clear)
+        memset(data, 0, STAT_KEYPOOL_SHM_SIZE);
+
+    pools->stats_shm = data;
+    return CKR_OK;
+}
+
+static void soft_keygen_pools_stats_close(struct soft_keygen_pools *pools)
+{
+    struct soft_keygen_pool *pool;
+
+    if (pools->stats_shm == NULL)
+        return;
+
+    for (pool = pools->pools; pool != NULL; pool = pool->next)
+        pool->stats = NULL;
+
+    munmap(pools->stats_shm, STAT_KEYPOOL_SHM_SIZE);
+    pools->stats_shm = NULL;
+}
+
+/*
+ * Returns the statistics entry of a pool. The entries are shared by all
+ * processes of the user and identified by a hash of the pool name, a free
+ * entry is claimed atomically.
+ */
+static stat_keypool_t *soft_keygen_pool_stats_entry(
+                                            struct soft_keygen_pools *pools,
+                                            struct soft_keygen_pool *pool)
+{
+    char name[STAT_KEYPOOL_NAME_LEN];
+    stat_keypool_t *entry;
+    uint64_t id = 0xcbf29ce484222325ULL; /* FNV-1a */
+    unsigned int i;
+
+    switch (pool->keytype) {
+    case CKK_RSA:
+        snprintf(name, sizeof(name), "RSA %lu %lu", pool->mod_bits,
+                 pool->publ_exp);
+        break;
+    case CKK_EC:
+        snprintf(name, sizeof(name), "EC %s", OBJ_nid2sn(pool->curve->nid));
+        break;
+    default:
+        snprintf(name, sizeof(name), "%s %lu",
+                 soft_keygen_pool_keytype_name(pool->keytype),
+                 pool->oid != NULL ? pool->oid->keyform : 0);
+        break;
+    }
+
+    for (i = 0; name[i] != '\0'; i++) {
+        id ^= (unsigned char)name[i];
+        id *= 0x100000001b3ULL;
+    }
+    if (id == 0)
+        id = 1;
+
+    for (i = 0; i < STAT_KEYPOOL_MAX; i++) {
+        entry = &pools->stats_shm[i];
+        if (entry->id != id &&
+            (entry->id != 0 ||
+             (!__sync_bool_compare_and_swap(&entry->id, 0, id) &&
+              entry->id != id)))
+            continue;
+
+        /* All processes write the same name */
+        memcpy(entry->name, name, sizeof(entry->name));
+        return entry;
+    }
+
+    TRACE_WARNING("%s no free key pool statistics entry for '%s'\n",
+                  __func__, name);
+    return NULL;
+}
+
+static void *soft_keygen_pool_thread(void *arg)
+{
+    struct soft_keygen_pools *pools = arg;
+    STDLL_TokData_t *tokdata = pools->tokdata;
+    struct soft_keygen_pool *pool;
+    CK_MECHANISM mech = { 0, NULL, 0 };
+    EVP_PKEY *pkey;
+    CK_RV rc;
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    if (OSSL_LIB_CTX_set0_default(pools->libctx) == NULL) {
+        TRACE_ERROR("OSSL_LIB_CTX_set0_default failed\n");
+        return NULL;
+    }
+#endif
+
+    pthread_mutex_lock(&pools->mutex);
+
+    while (!pools->stop) {
+        pool = soft_keygen_pool_next_to_fill(pools);
+        if (pool == NULL) {
+            pthread_cond_wait(&pools->cond, &pools->mutex);
+            continue;
+        }
+
+        /* The pool parameters are not modified while the thread runs */
+        pthread_mutex_unlock(&pools->mutex);
+        rc = soft_keygen_pool_generate(pool, &pkey);
+        pthread_mutex_lock(&pools->mutex);
+
+        if (rc != CKR_OK) {
+            ERR_clear_error();
+            OCK_SYSLOG(LOG_ERR, "%s: Key generation for %s key pool failed "
+                       "with rc=0x%lx, the pool is disabled\n", __func__,
+                       soft_keygen_pool_keytype_name(pool->keytype), rc);
+            TRACE_ERROR("Key generation for %s key pool failed with "
+                        "rc=0x%lx, the pool is disabled\n",
+                        soft_keygen_pool_keytype_name(pool->keytype), rc);
+            pool->disabled = TRUE;
+            continue;
+        }
+
+        if (pools->stop || pool->count >= pool->depth) {
+            EVP_PKEY_free(pkey);
+            continue;
+        }
+
+        pool->keys[pool->count++] = pkey;
+        pool->generated++;
+        if (pool->stats != NULL)
+            __sync_add_and_fetch(&pool->stats->generated, 1);
+
+        if (tokdata->statistics != NULL &&
+            tokdata->statistics->increment_func != NULL &&
+            (tokdata->statistics->flags & STATISTICS_FLAG_COUNT_INTERNAL) != 0) {
+            mech.mechanism = pool->mech;
+            tokdata->statistics->increment_func(tokdata->statistics,
+                                                tokdata->slot_id, &mech,
+                                                POLICY_STRENGTH_IDX_0);
+        }
+    }
+
+    pthread_mutex_unlock(&pools->mutex);
+
+    return NULL;
+}
+
+/*
+ * Starts the background thread that fills the key pools. Nothing is done if
+ * no key pools are configured.
+ */
+CK_RV soft_keygen_pools_start(STDLL_TokData_t *tokdata,
+                              struct soft_keygen_pools *pools)
+{
+    struct soft_keygen_pool *pool;
+    CK_RV rc;
+    int ret;
+
+    if (pools->pools == NULL)
+        return CKR_OK;
+
+    pools->tokdata = tokdata;
+    pools->stop = FALSE;
+
+    rc = soft_keygen_pools_stats_open(tokdata, pools);
+    if (rc != CKR_OK) {
+        /* Not fatal, the pools work without statistics */
+        TRACE_WARNING("%s Failed to open the key pool statistics rc=0x%lx\n",
+                      __func__, rc);
+        OCK_SYSLOG(LOG_WARNING, "Slot %lu: Failed to open the key pool "
+                   "statistics, no key pool statistics are collected\n",
+                   tokdata->slot_id);
+    }
+    for (pool = pools->pools;
+         pool != NULL && pools->stats_shm != NULL; pool = pool->next)
+        pool->stats = soft_keygen_pool_stats_entry(pools, pool);
+
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    /*
+     * The thread must use the same OpenSSL library context as the calling
+     * thread. OSSL_LIB_CTX_set0_default(NULL) returns the current default
+     * library context without changing it.
+     */
+    pools->libctx = OSSL_LIB_CTX_set0_default(NULL);
+    if (pools->libctx == NULL) {
+        TRACE_ERROR("OSSL_LIB_CTX_set0_default failed\n");
+        return CKR_FUNCTION_FAILED;
+    }
+#endif
+
+    ret = pthread_mutex_init(&pools->mutex, NULL);
+    if (ret != 0) {
+        TRACE_ERROR("pthread_mutex_init failed: %s\n", strerror(ret));
+        soft_keygen_pools_stats_close(pools);
+        return CKR_CANT_LOCK;
+    }
+
+    ret = pthread_cond_init(&pools->cond, NULL);
+    if (ret != 0) {
+        TRACE_ERROR("pthread_cond_init failed: %s\n", strerror(ret));
+        pthread_mutex_destroy(&pools->mutex);
+        soft_keygen_pools_stats_close(pools);
+        return CKR_CANT_LOCK;
+    }
+
+    ret = pthread_create(&pools->thread, NULL, soft_keygen_pool_thread, pools);
+    if (ret != 0) {
+        TRACE_ERROR("pthread_create failed: %s\n", strerror(ret));
+        pthread_cond_destroy(&pools->cond);
+        pthread_mutex_destroy(&pools->mutex);
+        soft_keygen_pools_stats_close(pools);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    pools->thread_started = TRUE;
+
+    return CKR_OK;
+}
+
+/*
+ * Stops the background thread and frees all key pools. When called in a
+ * forked child, the thread does not exist and the mutex state is undefined,
+ * so the pools are only freed.
+ */
+void soft_keygen_pools_stop(struct soft_keygen_pools *pools,
+                            CK_BBOOL in_fork_initializer)
+{
+    struct soft_keygen_pool *pool;
+
+    if (pools->thread_started && !in_fork_initializer) {
+        pthread_mutex_lock(&pools->mutex);
+        pools->stop = TRUE;
+        pthread_cond_signal(&pools->cond);
+        pthread_mutex_unlock(&pools->mutex);
+
+        pthread_join(pools->thread, NULL);
+
+        pthread_cond_destroy(&pools->cond);
+        pthread_mutex_destroy(&pools->mutex);
+    }
+    pools->thread_started = FALSE;
+
+    soft_keygen_pools_stats_close(pools);
+
+    while (pools->pools != NULL) {
+        pool = pools->pools;
+        pools->pools = pool->next;
+
+        TRACE_INFO("Key pool: type: %s generated: %lu hits: %lu misses: %lu\n",
+                   soft_keygen_pool_keytype_name(pool->keytype),
+                   pool->generated, pool->hits, pool->misses);
+
+        soft_keygen_pool_free(pool);
+    }
+}
+
+/*
+ * Takes a pre-generated key from the first pool for which match() returns
+ * TRUE. Returns NULL if no such pool exists or the pool is currently empty.
+ */
+static EVP_PKEY *soft_keygen_pool_take(struct soft_keygen_pools *pools,
+                                       CK_BBOOL (*match)(
+                                            const struct soft_keygen_pool *pool,
+                                            const void *arg),
+                                       const void *arg)
+{
+    struct soft_keygen_pool *pool;
+    EVP_PKEY *pkey = NULL;
+
+    if (!pools->thread_started)
+        return NULL;
+
+    pthread_mutex_lock(&pools->mutex);
+
+    for (pool = pools->pools; pool != NULL; pool = pool->next) {
+        if (!match(pool, arg))
+            continue;
+
+        if (pool->count > 0) {
+            pkey = pool->keys[--pool->count];
+            pool->keys[pool->count] = NULL;
+            pool->hits++;
+            if (pool->stats != NULL)
+                __sync_add_and_fetch(&pool->stats->hits, 1);
+        } else {
+            pool->misses++;
+            if (pool->stats != NULL)
+                __sync_add_and_fetch(&pool->stats->misses, 1);
+        }
+
+        TRACE_DEBUG("Key pool: type: %s %s, %lu keys left\n",
+                    soft_keygen_pool_keytype_name(pool->keytype),
+                    pkey != NULL ? "hit" : "miss", pool->count);
+
+        /* Wake up the thread to refill the pool */
+        pthread_cond_signal(&pools->cond);
+        break;
+    }
+
+    pthread_mutex_unlock(&pools->mutex);
+
+    return pkey;
+}
+
+struct soft_keygen_rsa_params {
+    CK_ULONG mod_bits;
+    CK_ULONG publ_exp;
+};
+
+static CK_BBOOL soft_keygen_pool_match_rsa(const struct soft_keygen_pool *pool,
+                                           const void *arg)
+{
+    const struct soft_keygen_rsa_params *params = arg;
+
+    return pool->keytype == CKK_RSA && pool->mod_bits == params->mod_bits &&
+           pool->publ_exp == params->publ_exp;
+}
+
+EVP_PKEY *soft_keygen_pool_take_rsa(struct soft_keygen_pools *pools,
+                                    CK_ULONG mod_bits,
+                                    const CK_BYTE *publ_exp,
+                                    CK_ULONG publ_exp_len)
+{
+    struct soft_keygen_rsa_params params;
+    CK_ULONG i;
+
+    if (publ_exp_len > sizeof(CK_ULONG))
+        return NULL;
+
+    params.mod_bits = mod_bits;
+    params.publ_exp = 0;
+    for (i = 0; i < publ_exp_len; i++)
+        params.publ_exp = (params.publ_exp << 8) | publ_exp[i];
+
+    return soft_keygen_pool_take(pools, soft_keygen_pool_match_rsa, &params);
+}
+
+struct soft_keygen_ec_params {
+    const CK_BYTE *params;
+    CK_ULONG params_len;
+};
+
+static CK_BBOOL soft_keygen_pool_match_ec(const struct soft_keygen_pool *pool,
+                                          const void *arg)
+{
+    const struct soft_keygen_ec_params *params = arg;
+
+    return pool->keytype == CKK_EC &&
+           pool->curve->data_size == params->params_len &&
+           memcmp(pool->curve->data, params->params, params->params_len) == 0;
+}
+
+EVP_PKEY *soft_keygen_pool_take_ec(struct soft_keygen_pools *pools,
+                                   const CK_BYTE *params, CK_ULONG params_len)
+{
+    struct soft_keygen_ec_params ec_params = { params, params_len };
+
+    return soft_keygen_pool_take(pools, soft_keygen_pool_match_ec, &ec_params);
+}
+
+static CK_BBOOL soft_keygen_pool_match_dilithium(
+                                        const struct soft_keygen_pool *pool,
+                                        const void *arg)
+{
+    return pool->keytype == CKK_IBM_PQC_DILITHIUM && pool->oid == arg;
+}
+
+EVP_PKEY *soft_keygen_pool_take_dilithium(struct soft_keygen_pools *pools,
+                                          const struct pqc_oid *oid)
+{
+    return soft_keygen_pool_take(pools, soft_keygen_pool_match_dilithium, oid);
+}
@@ -0,0 +1,96 @@
+/*
+ * COPYRIGHT (c) International Business Machines Corp. 2024
+ *
+ * This program is provided under the terms of the Common Public License,
+ * version 1.0 (CPL-1.0). Any use, reproduction or distribution for this
+ * software constitutes recipient's acceptance of CPL-1.0 terms which can be
+ * found in the file LICENSE file or at
+ * https://opensource.org/licenses/cpl1.0.php
+ */
+
+#ifndef SOFT_KEYGEN_POOL_H
+#define SOFT_KEYGEN_POOL_H
+
+#include <pthread.h>
+
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+
+#include "pkcs11types.h"
+#include "defs.h"
+#include "host_defs.h"
+#include "ec_defs.h"
+#include "pqc_defs.h"
+#include "configuration.h"
+#include "statistics.h"
+
+#define SOFT_CFG_KEYGEN_POOL        "KEYGEN_POOL"
+#define SOFT_CFG_KEY_TYPE           "KEY_TYPE"
+#define SOFT_CFG_MODULUS_BITS       "MODULUS_BITS"
+#define SOFT_CFG_PUBLIC_EXPONENT    "PUBLIC_EXPONENT"
+#define SOFT_CFG_CURVE              "CURVE"
+#define SOFT_CFG_KEYFORM            "KEYFORM"
+#define SOFT_CFG_DEPTH              "DEPTH"
+
+#define SOFT_KEYGEN_POOL_MAX_DEPTH  1024
+
+/*
+ * A pool of pre-generated key pairs for one specific set of key generation
+ * parameters.
+ */
+struct soft_keygen_pool {
+    struct soft_keygen_pool *next;
+    CK_KEY_TYPE keytype;
+    CK_MECHANISM_TYPE mech;         /* key generation mechanism */
+    CK_ULONG mod_bits;              /* RSA only */
+    CK_ULONG publ_exp;              /* RSA only */
+    const struct _ec *curve;        /* EC only */
+    const struct pqc_oid *oid;      /* Dilithium only */
+    CK_ULONG depth;
+    CK_ULONG count;
+    EVP_PKEY **keys;
+    CK_BBOOL disabled;              /* set if key generation failed */
+    /* counters */
+    CK_ULONG generated;
+    CK_ULONG hits;
+    CK_ULONG misses;
+    stat_keypool_t *stats;          /* NULL if statistics are not enabled */
+};
+
+/*
+ * All key pools of a token, plus the background thread that keeps them
+ * filled.
+ */
+struct soft_keygen_pools {
+    struct soft_keygen_pool *pools;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    CK_BBOOL thread_started;
+    CK_BBOOL stop;
+    STDLL_TokData_t *tokdata;
+    stat_keypool_t *stats_shm;      /* NULL if statistics are not enabled */
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    OSSL_LIB_CTX *libctx;
+#endif
+};
+
+CK_RV soft_keygen_pool_parse_config(struct soft_keygen_pools *pools,
+                                    const char *fname,
+                                    struct ConfigStructNode *pool_node);
+
+CK_RV soft_keygen_pools_start(STDLL_TokData_t *tokdata,
+                              struct soft_keygen_pools *pools);
+void soft_keygen_pools_stop(struct soft_keygen_pools *pools,
+                            CK_BBOOL in_fork_initializer);
+
+EVP_PKEY *soft_keygen_pool_take_rsa(struct soft_keygen_pools *pools,
+                                    CK_ULONG mod_bits,
+                                    const CK_BYTE *publ_exp,
+                                    CK_ULONG publ_exp_len);
+EVP_PKEY *soft_keygen_pool_take_ec(struct soft_keygen_pools *pools,
+                                   const CK_BYTE *params, CK_ULONG params_len);
+EVP_PKEY *soft_keygen_pool_take_dilithium(struct soft_keygen_pools *pools,
+                                          const struct pqc_oid *oid);
+
+#endif
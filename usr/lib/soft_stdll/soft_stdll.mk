@@ -1,6 +1,9 @@
 nobase_lib_LTLIBRARIES += opencryptoki/stdll/libpkcs11_sw.la
 
-noinst_HEADERS += usr/lib/soft_stdll/tok_struct.h
+EXTRA_DIST += usr/lib/soft_stdll/softtok.conf
+
+noinst_HEADERS += usr/lib/soft_stdll/tok_struct.h			\
+	usr/lib/soft_stdll/soft_keygen_pool.h
 
 opencryptoki_stdll_libpkcs11_sw_la_CFLAGS =				\
 	-DDEV -D_THREAD_SAFE -DSHALLOW=0 -DSWTOK=1 -DLITE=0		\
@@ -8,7 +11,8 @@ opencryptoki_stdll_libpkcs11_sw_la_CFLAGS =				\
 	-DTOK_NEW_DATA_STORE=0x0003000c					\
 	-I${srcdir}/usr/lib/common -I${srcdir}/usr/include		\
 	-DSTDLL_NAME=\"swtok\" -I${top_builddir}/usr/lib/api		\
-	-I${srcdir}/usr/lib/api
+	-I${srcdir}/usr/lib/api -I${top_builddir}/usr/lib/config	\
+	-I${srcdir}/usr/lib/config
 
 if AIX
 opencryptoki_stdll_libpkcs11_sw_la_LDFLAGS = -qmkshrobj -lc \
@@ -41,7 +45,10 @@ opencryptoki_stdll_libpkcs11_sw_la_SOURCES =				\
 	usr/lib/common/shared_memory.c usr/lib/common/profile_obj.c	\
 	usr/lib/soft_stdll/soft_specific.c usr/lib/common/attributes.c	\
 	usr/lib/common/dlist.c usr/lib/common/mech_openssl.c		\
+	usr/lib/common/sw_sha.c						\
 	usr/lib/common/utility_common.c usr/lib/common/ec_supported.c	\
 	usr/lib/api/policyhelper.c usr/lib/common/pqc_supported.c	\
 	usr/lib/common/btree.c usr/lib/common/sess_mgr.c		\
-	usr/lib/common/mech_pqc.c
+	usr/lib/common/mech_pqc.c usr/lib/soft_stdll/soft_keygen_pool.c	\
+	usr/lib/config/configuration.c usr/lib/config/cfgparse.y	\
+	usr/lib/config/cfglex.l
@@ -177,6 +177,14 @@ token_spec_t token_specific = {
     &token_specific_set_attrs_for_new_object,
     NULL,                       // handle_event
     NULL,                       // check_obj_access
+    &token_specific_hash_sign_verify_init,
+    &token_specific_hash_sign,
+    &token_specific_hash_sign_verify_update,
+    &token_specific_hash_sign_final,
+    &token_specific_hash_verify,
+    &token_specific_hash_verify_final,
+    &token_specific_sha_batch,
+    &token_specific_rsa_priv_wrap_get_data,
 };
 
 #endif
@@ -37,6 +37,7 @@ opencryptoki_stdll_libpkcs11_tpm_la_SOURCES =				\
 	usr/lib/tpm_stdll/tpm_specific.c usr/lib/common/attributes.c	\
 	usr/lib/tpm_stdll/tpm_openssl.c usr/lib/tpm_stdll/tpm_util.c	\
 	usr/lib/common/dlist.c usr/lib/common/mech_openssl.c		\
+	usr/lib/common/sw_sha.c						\
 	usr/lib/common/utility_common.c usr/lib/common/ec_supported.c	\
 	usr/lib/api/policyhelper.c usr/lib/common/pqc_supported.c	\
 	usr/lib/common/btree.c usr/lib/common/sess_mgr.c		\
@@ -32,6 +32,9 @@
 #include <fnmatch.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <openssl/obj_mac.h>
 #include <openssl/evp.h>
@@ -79,15 +82,18 @@ static CK_RV p11sak_copy_cert(void);
 static CK_RV p11sak_import_cert(void);
 static CK_RV p11sak_export_cert(void);
 static CK_RV p11sak_extract_cert_pubkey(void);
+static CK_RV p11sak_import_bulk(void);
 static void print_import_cert_attr_help(void);
 static void print_list_cert_attr_help(void);
 static void print_set_copy_cert_attr_help(void);
 static void print_remove_cert_help(void);
 static void print_extract_cert_pubkey_help(void);
+static void print_import_bulk_help(void);
 
 static void *pkcs11_lib = NULL;
 static bool pkcs11_initialized = false;
 static CK_FUNCTION_LIST *pkcs11_funcs = NULL;
+static CK_C_IBM_GetAttributeValueBatch pkcs11_get_attr_batch = NULL;
 static CK_SESSION_HANDLE pkcs11_session = CK_INVALID_HANDLE;
 static CK_INFO pkcs11_info;
 static CK_TOKEN_INFO pkcs11_tokeninfo;
@@ -136,6 +142,9 @@ static bool opt_uri_pin_value = false;
 static char *opt_uri_pin_source = NULL;
 static bool opt_oqsprovider_pem = false;
 static bool opt_hsm_mkvp = false;
+static char *opt_directory = NULL;
+static char *opt_manifest = NULL;
+static CK_ULONG opt_threads = 0;
 
 static bool opt_slot_is_set(const struct p11sak_arg *arg);
 static CK_RV generic_get_key_size(const struct p11sak_objtype *keytype,
@@ -216,7 +225,8 @@ static CK_RV p11sak_import_sym_clear_des_3des_aes_generic(
                                     CK_BYTE *data, CK_ULONG data_len,
                                     CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs);
 static CK_RV p11sak_import_rsa_pkey(const struct p11sak_objtype *keytype,
-                                    EVP_PKEY *pkey, bool private,
+                                    const char *file, EVP_PKEY *pkey,
+                                    bool private,
                                     CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs);
 static CK_RV p11sak_import_cert_attrs(const struct p11sak_objtype *certtype,
                                       X509 *x509, CK_ATTRIBUTE **attrs,
@@ -225,13 +235,16 @@ static CK_RV p11sak_import_x509_attrs(const struct p11sak_objtype *certtype,
                                       X509 *x509, CK_ATTRIBUTE **attrs,
                                       CK_ULONG *num_attrs);
 static CK_RV p11sak_import_dh_pkey(const struct p11sak_objtype *keytype,
-                                    EVP_PKEY *pkey, bool private,
+                                    const char *file, EVP_PKEY *pkey,
+                                    bool private,
                                     CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs);
 static CK_RV p11sak_import_dsa_pkey(const struct p11sak_objtype *keytype,
-                                    EVP_PKEY *pkey, bool private,
+                                    const char *file, EVP_PKEY *pkey,
+                                    bool private,
                                     CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs);
 static CK_RV p11sak_import_ec_pkey(const struct p11sak_objtype *keytype,
-                                   EVP_PKEY *pkey, bool private,
+                                   const char *file, EVP_PKEY *pkey,
+                                   bool private,
                                    CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs);
 static CK_RV p11sak_import_dilithium_kyber_pem_data(
                                         const struct p11sak_objtype *keytype,
@@ -240,7 +253,8 @@ static CK_RV p11sak_import_dilithium_kyber_pem_data(
                                         CK_ATTRIBUTE **attrs,
                                         CK_ULONG *num_attrs);
 static CK_RV p11sak_import_dilithium_pkey(const struct p11sak_objtype *keytype,
-                                          EVP_PKEY *pkey, bool private,
+                                          const char *file, EVP_PKEY *pkey,
+                                          bool private,
                                           CK_ATTRIBUTE **attrs,
                                           CK_ULONG *num_attrs);
 static CK_RV p11sak_export_sym_clear_des_3des_aes_generic(
@@ -1813,6 +1827,46 @@ static const struct p11sak_opt p11sak_import_cert_opts[] = {
     { .short_opt = 0, .long_opt = NULL, },
 };
 
+static const struct p11sak_opt p11sak_import_bulk_opts[] = {
+    PKCS11_OPTS,
+    { .short_opt = 'd', .long_opt = "directory", .required = false,
+      .arg =  { .type = ARG_TYPE_STRING, .required = true,
+                .value.string = &opt_directory, .name = "DIRECTORY", },
+      .description = "The directory containing the keys and certificates to "
+                     "be imported. The object type is derived from each "
+                     "file: files with extension '.aes', '.aes-xts', '.des', "
+                     "'.3des', or '.generic' contain a symmetric key in clear, "
+                     "files with extension '.crt', '.cer', or '.der' contain "
+                     "an x509 certificate, and for files with extension "
+                     "'.pem' the key type and kind, or certificate, is "
+                     "detected from the PEM contents. The file name without "
+                     "the extension is used as label. Other files are "
+                     "skipped. Either this option or the '-m'/'--manifest' "
+                     "option must be specified.", },
+    { .short_opt = 'm', .long_opt = "manifest", .required = false,
+      .arg =  { .type = ARG_TYPE_STRING, .required = true,
+                .value.string = &opt_manifest, .name = "FILENAME", },
+      .description = "A manifest file listing the keys and certificates to be "
+                     "imported, one per line. See below for the manifest "
+                     "format. Either this option or the '-d'/'--directory' "
+                     "option must be specified.", },
+    { .short_opt = 't', .long_opt = "threads", .required = false,
+      .arg =  { .type = ARG_TYPE_NUMBER, .required = true,
+                .value.number = &opt_threads, .name = "NUMBER", },
+      .description = "The number of worker threads used to import the objects "
+                     "concurrently (optional). Each worker thread uses its own "
+                     "session. Default is the number of online CPUs.", },
+    { .short_opt = 'P', .long_opt = "pem-password", .required = false,
+      .arg =  { .type = ARG_TYPE_STRING, .required = true,
+                .value.string = &opt_pem_password, .name = "PASSWORD", },
+      .description = "The password of the password protected PEM files to be "
+                     "imported. If a PEM file is password protected, but this "
+                     "option is not specified, nor environment variable "
+                     "P11SAK_PEM_PASSWORD is set, you will be prompted for "
+                     "the PEM password.", },
+    { .short_opt = 0, .long_opt = NULL, },
+};
+
 static const struct p11sak_enum_value p11sak_import_asym_types[] = {
     { .value = "public", .args = NULL, .private = { .num = false }, },
     { .value = "private", .args = NULL, .private = { .num = true }, },
@@ -1881,6 +1935,10 @@ static const struct p11sak_arg p11sak_import_cert_args[] = {
     { .name = NULL },
 };
 
+static const struct p11sak_arg p11sak_import_bulk_args[] = {
+    { .name = NULL },
+};
+
 static const struct p11sak_opt p11sak_export_key_opts[] = {
     PKCS11_OPTS,
     KEY_FILTER_OPTS,
@@ -2217,6 +2275,13 @@ static const struct p11sak_cmd p11sak_commands[] = {
       .description = "Extract the public key from certificates in the repository.",
       .help = print_extract_cert_pubkey_help,
       .session_flags = CKF_SERIAL_SESSION | CKF_RW_SESSION, },
+    { .cmd = "import-bulk", .cmd_short1 = "importb", .cmd_short2 = "impb",
+      .func = p11sak_import_bulk,
+      .opts = p11sak_import_bulk_opts, .args = p11sak_import_bulk_args,
+      .description = "Import keys and certificates from a directory or "
+                     "manifest file using multiple threads.",
+      .help = print_import_bulk_help,
+      .session_flags = CKF_SERIAL_SESSION | CKF_RW_SESSION, },
     { .cmd = NULL, .func = NULL },
 };
 
@@ -3103,6 +3168,47 @@ static void print_extract_cert_pubkey_help(void)
     printf("\n");
 }
 
+static void print_import_bulk_help(void)
+{
+    printf("MANIFEST FORMAT:\n");
+    printf("    ");
+    print_indented("Each line of the manifest file describes one key or "
+                   "certificate to import, as a list of KEYWORD=VALUE pairs "
+                   "separated by blanks. Values containing blanks can be "
+                   "enclosed in double quotes. Empty lines and lines starting "
+                   "with '#' are ignored.\n", 4);
+    printf("    %-20s ", "type=TYPE");
+    print_indented("The key type (one of the KEYTYPE values of the "
+                   "'import-key' command), or the certificate type (x509). "
+                   "Required.", 25);
+    printf("    %-20s ", "kind=KIND");
+    print_indented("The kind of an asymmetric key: public or private. "
+                   "Required for asymmetric key types.", 25);
+    printf("    %-20s ", "file=FILENAME");
+    print_indented("The file containing the key or certificate. Relative file "
+                   "names are relative to the directory of the manifest file. "
+                   "Required.", 25);
+    printf("    %-20s ", "label=LABEL");
+    print_indented("The label of the object. Required.", 25);
+    printf("    %-20s ", "attr=ATTRS");
+    print_indented("The boolean attributes to set, as for the 'import-key' "
+                   "and 'import-cert' commands.", 25);
+    printf("    %-20s ", "id=ID");
+    print_indented("The ID of the object as hex string.", 25);
+    printf("    %-20s ", "opaque");
+    print_indented("The key file contains an opaque secure key blob.", 25);
+    printf("    %-20s ", "oqsprovider-pem");
+    print_indented("The PEM file is in the 'oqsprovider' format.", 25);
+    printf("    %-20s ", "ca-cert");
+    print_indented("The certificate is a CA certificate.", 25);
+    printf("\n");
+    printf("    Example:\n");
+    printf("        type=aes file=aes.key label=\"my aes key\" attr=sX\n");
+    printf("        type=rsa kind=private file=rsa.pem label=rsa id=0102\n");
+    printf("        type=x509 file=ca.crt label=ca ca-cert\n");
+    printf("\n");
+}
+
 static void print_version(void)
 {
     printf("p11sak version %s\n", PACKAGE_VERSION);
@@ -4468,46 +4574,6 @@ done:
     return rc;
 }
 
-static CK_RV get_keysize_value(CK_OBJECT_HANDLE obj, char *label,
-                              const struct p11sak_objtype *objtype_val,
-                              CK_ULONG *keysize_val)
-{
-    CK_ATTRIBUTE keysize_attr;
-    CK_RV rc;
-
-    if (objtype_val->keysize_attr == (CK_ATTRIBUTE_TYPE)-1) {
-        *keysize_val = 0;
-        return CKR_OK;
-    }
-
-    keysize_attr.type = objtype_val->keysize_attr;
-    if (!objtype_val->keysize_attr_value_len) {
-        keysize_attr.ulValueLen = sizeof(*keysize_val);
-        keysize_attr.pValue = keysize_val;
-    } else {
-        /* Query attribute length only */
-        keysize_attr.ulValueLen = 0;
-        keysize_attr.pValue = NULL;
-    }
-
-    rc = pkcs11_funcs->C_GetAttributeValue(pkcs11_session, obj,
-                                           &keysize_attr, 1);
-    if (rc != CKR_OK) {
-        warnx("Attribute %s is not available in object \"%s\"",
-              p11_get_cka(keysize_attr.type), label);
-        return rc;
-    }
-
-    if (objtype_val->keysize_attr_value_len)
-        *keysize_val = keysize_attr.ulValueLen;
-
-    if (objtype_val->key_keysize_adjust != NULL)
-        *keysize_val = objtype_val->key_keysize_adjust(objtype_val,
-                                                       *keysize_val);
-
-    return CKR_OK;
-}
-
 static CK_RV get_typestr_value(CK_OBJECT_CLASS class_val, CK_ULONG keysize_val,
                                const struct p11sak_objtype *objtype_val,
                                char *label, char **typestr)
@@ -4551,50 +4617,6 @@ static CK_RV get_typestr_value(CK_OBJECT_CLASS class_val, CK_ULONG keysize_val,
     return CKR_OK;
 }
 
-static CK_RV get_class_and_type_values(CK_OBJECT_HANDLE obj, char *label,
-                                       CK_OBJECT_CLASS *class_val,
-                                       CK_ULONG *otype_val)
-{
-    CK_RV rc;
-    CK_KEY_TYPE ktype_val = 0;
-    CK_CERTIFICATE_TYPE ctype_val = 0;
-    CK_ATTRIBUTE attrs[] = {
-        { CKA_CLASS, class_val, sizeof(class_val) },
-        { CKA_KEY_TYPE, &ktype_val, sizeof(ktype_val) },
-        { CKA_CERTIFICATE_TYPE, &ctype_val, sizeof(ctype_val) },
-    };
-    const CK_ULONG num_attrs = sizeof(attrs) / sizeof(CK_ATTRIBUTE);
-
-    rc = pkcs11_funcs->C_GetAttributeValue(pkcs11_session, obj,
-                                           attrs, num_attrs);
-    if (rc != CKR_OK && rc != CKR_ATTRIBUTE_TYPE_INVALID &&
-        rc != CKR_ATTRIBUTE_SENSITIVE) {
-        warnx("Failed to get attributes: C_GetAttributeValue: 0x%lX: %s",
-              rc, p11_get_ckr(rc));
-        return rc;
-    }
-
-    /* Class attribute must be available in any case. Others
-       depend on object type: key or certificate */
-    if (attrs[0].ulValueLen == CK_UNAVAILABLE_INFORMATION) {
-        warnx("Class attribute %s is not available in object \"%s\"",
-              p11_get_cka(attrs[0].type), label);
-        return CKR_TEMPLATE_INCOMPLETE;
-    }
-
-    if (attrs[1].ulValueLen != CK_UNAVAILABLE_INFORMATION)
-        *otype_val = ktype_val;
-    else if (attrs[2].ulValueLen != CK_UNAVAILABLE_INFORMATION)
-        *otype_val = ctype_val;
-    else {
-        warnx("At least one of CKA_KEY_TYPE or CKA_CERTIFICATE_TYPE must "
-              "be available in object \"%s\"", label);
-        return CKR_TEMPLATE_INCOMPLETE;
-    }
-
-    return CKR_OK;
-}
-
 static CK_RV get_label_value(CK_OBJECT_HANDLE obj, char** label_value)
 {
     CK_ATTRIBUTE attr = { CKA_LABEL, NULL, 0 };
@@ -4642,99 +4664,240 @@ done:
     return CKR_OK;
 }
 
-static CK_RV get_obj_infos(CK_OBJECT_HANDLE obj, CK_OBJECT_CLASS *class,
-                           CK_ULONG *otype, CK_ULONG *keysize,
-                           char** label, char** typestr,
-                           const struct p11sak_objtype **objtype,
-                           char **common_name)
+/*
+ * Gets the attributes of a batch of objects with C_IBM_GetAttributeValueBatch,
+ * if the PKCS#11 library provides it, or with one C_GetAttributeValue call per
+ * object otherwise. The result of each object is returned in results[i].
+ */
+static CK_RV get_attributes_batch(CK_ULONG num_objs, CK_OBJECT_HANDLE *objs,
+                                  CK_ATTRIBUTE **templates,
+                                  CK_ULONG *num_attrs, CK_RV *results)
 {
+    CK_ULONG i;
     CK_RV rc;
-    CK_OBJECT_CLASS class_val = 0;
-    CK_ULONG otype_val = 0;
-    const struct p11sak_objtype *objtype_val;
-    CK_ULONG keysize_val = 0;
-    char *label_val = NULL;
-    char *common_name_val = NULL;
-
-    rc = get_label_value(obj, &label_val);
-    if (rc != CKR_OK)
-        return rc;
 
-    rc = get_class_and_type_values(obj, label_val, &class_val, &otype_val);
-    if (rc != CKR_OK) {
-        free(label_val);
-        return rc;
+    if (pkcs11_get_attr_batch != NULL) {
+        rc = pkcs11_get_attr_batch(pkcs11_session, num_objs, objs, templates,
+                                   num_attrs, results);
+        if (rc != CKR_FUNCTION_NOT_SUPPORTED)
+            return rc;
     }
 
-    switch (class_val) {
-    case CKO_SECRET_KEY:
-    case CKO_PUBLIC_KEY:
-    case CKO_PRIVATE_KEY:
-        objtype_val = find_keytype(otype_val);
-        if (objtype_val == NULL) {
-            warnx("Object \"%s\" has an unsupported type: %lu",
-                  label_val, otype_val);
-            free(label_val);
-            return CKR_KEY_TYPE_INCONSISTENT;
-        }
-        if (keysize != NULL) {
-            rc = get_keysize_value(obj, label_val, objtype_val, &keysize_val);
-            if (rc != CKR_OK) {
-                free(label_val);
-                return rc;
-            }
-            *keysize = keysize_val;
+    for (i = 0; i < num_objs; i++) {
+        if (num_attrs[i] == 0) {
+            results[i] = CKR_OK;
+            continue;
         }
-        break;
-    case CKO_CERTIFICATE:
-        objtype_val = find_certtype(otype_val);
-        if (objtype_val == NULL) {
+
+        results[i] = pkcs11_funcs->C_GetAttributeValue(pkcs11_session,
+                                                       objs[i], templates[i],
+                                                       num_attrs[i]);
+    }
+
+    return CKR_OK;
+}
+
+static void free_obj_infos(struct p11sak_obj_info *infos, CK_ULONG num)
+{
+    CK_ULONG i;
+
+    for (i = 0; i < num; i++) {
+        free(infos[i].label);
+        infos[i].label = NULL;
+        free(infos[i].typestr);
+        infos[i].typestr = NULL;
+        free(infos[i].common_name);
+        infos[i].common_name = NULL;
+    }
+}
+
+static CK_RV check_obj_info(struct p11sak_obj_info *info,
+                            CK_ATTRIBUTE *attrs)
+{
+    CK_RV rc;
+
+    /* Class attribute must be available in any case. Others
+       depend on object type: key or certificate */
+    if (attrs[1].ulValueLen == CK_UNAVAILABLE_INFORMATION) {
+        warnx("Class attribute %s is not available in object \"%s\"",
+              p11_get_cka(attrs[1].type), info->label);
+        return CKR_TEMPLATE_INCOMPLETE;
+    }
+
+    if (attrs[2].ulValueLen == CK_UNAVAILABLE_INFORMATION &&
+        attrs[3].ulValueLen == CK_UNAVAILABLE_INFORMATION) {
+        warnx("At least one of CKA_KEY_TYPE or CKA_CERTIFICATE_TYPE must "
+              "be available in object \"%s\"", info->label);
+        return CKR_TEMPLATE_INCOMPLETE;
+    }
+
+    if (info->objtype == NULL) {
+        if (info->class == CKO_SECRET_KEY || info->class == CKO_PUBLIC_KEY ||
+            info->class == CKO_PRIVATE_KEY || info->class == CKO_CERTIFICATE)
             warnx("Object \"%s\" has an unsupported type: %lu",
-                  label_val, otype_val);
-            free(label_val);
-            return CKR_KEY_TYPE_INCONSISTENT;
-        }
-        if (common_name != NULL) {
-            rc = get_common_name_value(obj, label_val, &common_name_val);
-            if (rc != CKR_OK) {
-                free(label_val);
-                free(common_name_val);
-                return rc;
-            }
-            *common_name = common_name_val;
-        }
-        break;
-    default:
-        /* Should not occur */
-        warnx("Object \"%s\" has an unsupported class: %lu",
-              label_val, class_val);
-        free(label_val);
+                  info->label, info->otype);
+        else
+            /* Should not occur */
+            warnx("Object \"%s\" has an unsupported class: %lu",
+                  info->label, info->class);
         return CKR_KEY_TYPE_INCONSISTENT;
-        break;
     }
 
-    if (class != NULL)
-        *class = class_val;
+    if (info->class == CKO_CERTIFICATE) {
+        rc = get_common_name_value(info->obj, info->label,
+                                   &info->common_name);
+        if (rc != CKR_OK)
+            return rc;
+    } else if (info->objtype->key_keysize_adjust != NULL) {
+        info->keysize = info->objtype->key_keysize_adjust(info->objtype,
+                                                          info->keysize);
+    }
 
-    if (otype != NULL)
-        *otype = otype_val;
+    return get_typestr_value(info->class, info->keysize, info->objtype,
+                             info->label, &info->typestr);
+}
 
-    if (objtype != NULL)
-        *objtype = objtype_val;
+/*
+ * Gets the label, class, type, key size, type string, and for certificates
+ * the common name of the objects in infos[i].obj. The attributes of up to
+ * FIND_OBJECTS_COUNT objects are retrieved with one batch call.
+ */
+static CK_RV get_obj_infos_batch(struct p11sak_obj_info *infos, CK_ULONG num)
+{
+    CK_OBJECT_HANDLE objs[FIND_OBJECTS_COUNT];
+    CK_ATTRIBUTE attrs[FIND_OBJECTS_COUNT][4];
+    CK_ATTRIBUTE attrs2[FIND_OBJECTS_COUNT][2];
+    CK_ATTRIBUTE *templates[FIND_OBJECTS_COUNT];
+    CK_ULONG num_attrs[FIND_OBJECTS_COUNT];
+    CK_RV results[FIND_OBJECTS_COUNT];
+    CK_KEY_TYPE ktypes[FIND_OBJECTS_COUNT];
+    CK_CERTIFICATE_TYPE ctypes[FIND_OBJECTS_COUNT];
+    struct p11sak_obj_info *info;
+    CK_ULONG i, k, n;
+    CK_RV rc;
 
-    if (typestr != NULL) {
-        rc = get_typestr_value(class_val, keysize_val, objtype_val,
-                               label_val, typestr);
+    for (k = 0; k < num; k += n) {
+        n = MIN(num - k, FIND_OBJECTS_COUNT);
+
+        /* Get the label length, class and type of the objects */
+        for (i = 0; i < n; i++) {
+            info = &infos[k + i];
+            objs[i] = info->obj;
+            ktypes[i] = 0;
+            ctypes[i] = 0;
+            attrs[i][0] = (CK_ATTRIBUTE){ CKA_LABEL, NULL, 0 };
+            attrs[i][1] = (CK_ATTRIBUTE){ CKA_CLASS, &info->class,
+                                          sizeof(info->class) };
+            attrs[i][2] = (CK_ATTRIBUTE){ CKA_KEY_TYPE, &ktypes[i],
+                                          sizeof(ktypes[i]) };
+            attrs[i][3] = (CK_ATTRIBUTE){ CKA_CERTIFICATE_TYPE, &ctypes[i],
+                                          sizeof(ctypes[i]) };
+            templates[i] = attrs[i];
+            num_attrs[i] = 4;
+        }
+
+        rc = get_attributes_batch(n, objs, templates, num_attrs, results);
         if (rc != CKR_OK) {
-            free(label_val);
+            warnx("Failed to get attributes: C_IBM_GetAttributeValueBatch: "
+                  "0x%lX: %s", rc, p11_get_ckr(rc));
             return rc;
         }
-    }
 
-    if (label != NULL)
-        *label = label_val;
-    else
-        free(label_val);
+        /* Get the label and the key size of the objects */
+        for (i = 0; i < n; i++) {
+            info = &infos[k + i];
+            if (results[i] != CKR_OK &&
+                results[i] != CKR_ATTRIBUTE_TYPE_INVALID &&
+                results[i] != CKR_ATTRIBUTE_SENSITIVE) {
+                warnx("Failed to get attributes: C_GetAttributeValue: "
+                      "0x%lX: %s", results[i], p11_get_ckr(results[i]));
+                return results[i];
+            }
+
+            info->objtype = NULL;
+            if (attrs[i][2].ulValueLen != CK_UNAVAILABLE_INFORMATION)
+                info->otype = ktypes[i];
+            else if (attrs[i][3].ulValueLen != CK_UNAVAILABLE_INFORMATION)
+                info->otype = ctypes[i];
+            if (attrs[i][1].ulValueLen != CK_UNAVAILABLE_INFORMATION) {
+                switch (info->class) {
+                case CKO_SECRET_KEY:
+                case CKO_PUBLIC_KEY:
+                case CKO_PRIVATE_KEY:
+                    info->objtype = find_keytype(info->otype);
+                    break;
+                case CKO_CERTIFICATE:
+                    info->objtype = find_certtype(info->otype);
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            templates[i] = attrs2[i];
+            num_attrs[i] = 0;
+
+            if (attrs[i][0].ulValueLen == 0 ||
+                attrs[i][0].ulValueLen == CK_UNAVAILABLE_INFORMATION) {
+                info->label = strdup("");
+            } else {
+                info->label = calloc(attrs[i][0].ulValueLen + 1, 1);
+                attrs2[i][num_attrs[i]++] =
+                    (CK_ATTRIBUTE){ CKA_LABEL, info->label,
+                                    attrs[i][0].ulValueLen };
+            }
+            if (info->label == NULL) {
+                warnx("Failed to allocate memory for label attribute");
+                return CKR_HOST_MEMORY;
+            }
+
+            info->keysize = 0;
+            if (info->objtype != NULL && info->class != CKO_CERTIFICATE &&
+                info->objtype->keysize_attr != (CK_ATTRIBUTE_TYPE)-1) {
+                if (info->objtype->keysize_attr_value_len)
+                    /* Query attribute length only */
+                    attrs2[i][num_attrs[i]++] =
+                        (CK_ATTRIBUTE){ info->objtype->keysize_attr, NULL, 0 };
+                else
+                    attrs2[i][num_attrs[i]++] =
+                        (CK_ATTRIBUTE){ info->objtype->keysize_attr,
+                                        &info->keysize,
+                                        sizeof(info->keysize) };
+            }
+        }
+
+        rc = get_attributes_batch(n, objs, templates, num_attrs, results);
+        if (rc != CKR_OK) {
+            warnx("Failed to get attributes: C_IBM_GetAttributeValueBatch: "
+                  "0x%lX: %s", rc, p11_get_ckr(rc));
+            return rc;
+        }
+
+        for (i = 0; i < n; i++) {
+            info = &infos[k + i];
+            if (results[i] != CKR_OK) {
+                if (num_attrs[i] > 0 &&
+                    attrs2[i][num_attrs[i] - 1].type != CKA_LABEL)
+                    warnx("Attribute %s is not available in object \"%s\"",
+                          p11_get_cka(attrs2[i][num_attrs[i] - 1].type),
+                          info->label);
+                else
+                    warnx("Failed to get CKA_LABEL attribute: "
+                          "C_GetAttributeValue: 0x%lX: %s", results[i],
+                          p11_get_ckr(results[i]));
+                return results[i];
+            }
+
+            if (num_attrs[i] > 0 &&
+                attrs2[i][num_attrs[i] - 1].type != CKA_LABEL &&
+                info->objtype->keysize_attr_value_len)
+                info->keysize = attrs2[i][num_attrs[i] - 1].ulValueLen;
+
+            rc = check_obj_info(info, attrs[i]);
+            if (rc != CKR_OK)
+                return rc;
+        }
+    }
 
     return CKR_OK;
 }
@@ -4742,15 +4905,15 @@ static CK_RV get_obj_infos(CK_OBJECT_HANDLE obj, CK_OBJECT_CLASS *class,
 static int iterate_compare(const void *a, const void *b, void *private)
 {
     struct p11sak_iterate_compare_data *data = private;
-    const CK_OBJECT_HANDLE *obj1 = a;
-    const CK_OBJECT_HANDLE *obj2 = b;
+    const struct p11sak_obj_info *obj1 = a;
+    const struct p11sak_obj_info *obj2 = b;
     int result = 0;
     CK_RV rc;
 
     if (data->rc != CKR_OK)
         return 0;
 
-    rc = data->compare_obj(*obj1, *obj2, &result, data->private);
+    rc = data->compare_obj(obj1, obj2, &result, data->private);
     if (rc != CKR_OK)
         data->rc = rc;
 
@@ -4764,19 +4927,9 @@ static int iterate_compare_aix(const void *a, const void *b)
 }
 #endif
 
-static CK_BBOOL objclass_expected(CK_OBJECT_HANDLE obj, enum p11sak_objclass objclass)
+static CK_BBOOL objclass_expected(CK_OBJECT_CLASS class_val,
+                                  enum p11sak_objclass objclass)
 {
-    CK_OBJECT_CLASS class_val = 0;
-    CK_ATTRIBUTE attr = { CKA_CLASS, &class_val, sizeof(class_val) };
-    CK_RV rv;
-
-    rv = get_attribute(obj, &attr);
-    if (rv != CKR_OK) {
-        warnx("Failed to get CKA_CLASS attribute: get_attribute: 0x%lX: %s",
-              rv, p11_get_ckr(rv));
-        return rv;
-    }
-
     switch (objclass) {
     case OBJCLASS_KEY:
         if (class_val == CKO_SECRET_KEY || class_val == CKO_PUBLIC_KEY ||
@@ -4799,10 +4952,11 @@ static CK_RV iterate_objects(const struct p11sak_objtype *objtype,
                              const char *id_filter,
                              const char *attr_filter,
                              enum p11sak_objclass objclass,
-                             CK_RV (*compare_obj)(CK_OBJECT_HANDLE obj1,
-                                                  CK_OBJECT_HANDLE obj2,
-                                                  int *result,
-                                                  void *private),
+                             CK_RV (*compare_obj)(
+                                        const struct p11sak_obj_info *obj1,
+                                        const struct p11sak_obj_info *obj2,
+                                        int *result,
+                                        void *private),
                              CK_RV (*handle_obj)(CK_OBJECT_HANDLE obj,
                                                  CK_OBJECT_CLASS class,
                                                  const struct p11sak_objtype *objtype,
@@ -4818,16 +4972,15 @@ static CK_RV iterate_objects(const struct p11sak_objtype *objtype,
     CK_ULONG num_attrs = 0;
     const CK_BBOOL ck_true = CK_TRUE;
     CK_OBJECT_HANDLE objs[FIND_OBJECTS_COUNT];
+    CK_OBJECT_CLASS classes[FIND_OBJECTS_COUNT];
+    CK_ATTRIBUTE class_attrs[FIND_OBJECTS_COUNT];
+    CK_ATTRIBUTE *templates[FIND_OBJECTS_COUNT];
+    CK_ULONG counts[FIND_OBJECTS_COUNT];
+    CK_RV results[FIND_OBJECTS_COUNT];
     CK_ULONG i, num_objs;
     bool manual_filtering = false;
-    CK_OBJECT_CLASS class;
-    CK_KEY_TYPE ktype;
-    CK_ULONG keysize = 0;
     char *label = NULL;
-    char *typestr = NULL;
-    char *common_name = NULL;
-    const struct p11sak_objtype *type;
-    CK_OBJECT_HANDLE *matched_objs = NULL, *tmp;
+    struct p11sak_obj_info *matched_objs = NULL, *tmp;
     CK_ULONG num_matched_objs = 0;
     CK_ULONG alloc_matched_objs = 0;
     struct p11sak_iterate_compare_data data;
@@ -4890,13 +5043,37 @@ static CK_RV iterate_objects(const struct p11sak_objtype *objtype,
             break;
 
         for (i = 0; i < num_objs; i++) {
-            if (!objclass_expected(objs[i], objclass))
+            class_attrs[i].type = CKA_CLASS;
+            class_attrs[i].pValue = &classes[i];
+            class_attrs[i].ulValueLen = sizeof(classes[i]);
+            templates[i] = &class_attrs[i];
+            counts[i] = 1;
+        }
+
+        rc = get_attributes_batch(num_objs, objs, templates, counts, results);
+        if (rc != CKR_OK) {
+            warnx("Failed to get CKA_CLASS attributes: "
+                  "C_IBM_GetAttributeValueBatch: 0x%lX: %s",
+                  rc, p11_get_ckr(rc));
+            goto done_find;
+        }
+
+        for (i = 0; i < num_objs; i++) {
+            if (results[i] != CKR_OK) {
+                warnx("Failed to get CKA_CLASS attribute: "
+                      "C_GetAttributeValue: 0x%lX: %s",
+                      results[i], p11_get_ckr(results[i]));
+                rc = results[i];
+                goto done_find;
+            }
+
+            if (!objclass_expected(classes[i], objclass))
                 continue;
 
             if (manual_filtering) {
                 rc = get_label_value(objs[i], &label);
                 if (rc != CKR_OK)
-                    break;
+                    goto done_find;
 
                 if (fnmatch(label_filter, label, 0) != 0)
                     goto next;
@@ -4905,7 +5082,7 @@ static CK_RV iterate_objects(const struct p11sak_objtype *objtype,
             if (num_matched_objs >= alloc_matched_objs) {
                 tmp = realloc(matched_objs,
                               (alloc_matched_objs + FIND_OBJECTS_COUNT) *
-                                                  sizeof(CK_OBJECT_HANDLE));
+                                              sizeof(struct p11sak_obj_info));
                 if (tmp == NULL) {
                     warnx("Failed to allocate a list of matched objects.");
                     rc = CKR_HOST_MEMORY;
@@ -4916,7 +5093,9 @@ static CK_RV iterate_objects(const struct p11sak_objtype *objtype,
                 alloc_matched_objs += FIND_OBJECTS_COUNT;
             }
 
-            matched_objs[num_matched_objs++] = objs[i];
+            memset(&matched_objs[num_matched_objs], 0,
+                   sizeof(struct p11sak_obj_info));
+            matched_objs[num_matched_objs++].obj = objs[i];
 
 next:
             if (label != NULL)
@@ -4934,6 +5113,10 @@ done_find:
             rc = rc2;
     }
 
+    if (rc != CKR_OK)
+        goto done;
+
+    rc = get_obj_infos_batch(matched_objs, num_matched_objs);
     if (rc != CKR_OK)
         goto done;
 
@@ -4944,10 +5127,10 @@ done_find:
 
 #if defined(_AIX)
         global_private = &data;
-        qsort(matched_objs, num_matched_objs, sizeof(CK_OBJECT_HANDLE),
+        qsort(matched_objs, num_matched_objs, sizeof(struct p11sak_obj_info),
                 iterate_compare_aix);
 #else
-        qsort_r(matched_objs, num_matched_objs, sizeof(CK_OBJECT_HANDLE),
+        qsort_r(matched_objs, num_matched_objs, sizeof(struct p11sak_obj_info),
                 iterate_compare, &data);
 #endif
         rc = data.rc;
@@ -4956,25 +5139,12 @@ done_find:
     }
 
     for (i = 0; i < num_matched_objs; i++) {
-        rc = get_obj_infos(matched_objs[i], &class, &ktype, &keysize,
-                           &label, &typestr, &type, &common_name);
+        rc = handle_obj(matched_objs[i].obj, matched_objs[i].class,
+                        matched_objs[i].objtype, matched_objs[i].keysize,
+                        matched_objs[i].typestr, matched_objs[i].label,
+                        matched_objs[i].common_name, private);
         if (rc != CKR_OK)
             break;
-
-        rc = handle_obj(matched_objs[i], class, type, keysize, typestr, label,
-                        common_name, private);
-        if (rc != CKR_OK)
-            break;
-
-        if (label != NULL)
-            free(label);
-        label = NULL;
-        if (typestr != NULL)
-            free(typestr);
-        typestr = NULL;
-        if (common_name != NULL)
-            free(common_name);
-        common_name = NULL;
     }
 
 done:
@@ -4982,12 +5152,10 @@ done:
 
     if (label != NULL)
         free(label);
-    if (typestr != NULL)
-        free(typestr);
-    if (common_name != NULL)
-        free(common_name);
-    if (matched_objs != NULL)
+    if (matched_objs != NULL) {
+        free_obj_infos(matched_objs, num_matched_objs);
         free(matched_objs);
+    }
 
     return rc;
 }
@@ -6252,49 +6420,35 @@ done:
     return rc;
 }
 
-static CK_RV p11sak_list_obj_compare(CK_OBJECT_HANDLE obj1,
-                                     CK_OBJECT_HANDLE obj2,
+static CK_RV p11sak_list_obj_compare(const struct p11sak_obj_info *obj1,
+                                     const struct p11sak_obj_info *obj2,
                                      int *result, void *private)
 {
     struct p11sak_list_data *data = private;
-    CK_OBJECT_CLASS class1, class2;
-    CK_KEY_TYPE ktype1, ktype2;
-    CK_ULONG keysize1 = 0, keysize2 = 0;
-    char *label1 = NULL, *label2 = NULL;
-    char *cn1 = NULL, *cn2 = NULL;
-    CK_RV rc;
     int i;
 
     *result = 0;
 
-    rc = get_obj_infos(obj1, &class1, &ktype1, &keysize1, &label1, NULL, NULL, &cn1);
-    if (rc != CKR_OK)
-        goto done;
-
-    rc = get_obj_infos(obj2, &class2, &ktype2, &keysize2, &label2, NULL, NULL, &cn2);
-    if (rc != CKR_OK)
-        goto done;
-
     for (i = 0; i < MAX_SORT_FIELDS; i++) {
         switch (data->sort_info[i].field) {
         case SORT_LABEL:
-            if (label1 == NULL || label2 == NULL)
+            if (obj1->label == NULL || obj2->label == NULL)
                 break;
-            *result = strcmp(label1, label2);
+            *result = strcmp(obj1->label, obj2->label);
             break;
         case SORT_KEYTYPE:
-            *result = (long)ktype1 - (long)ktype2;
+            *result = (long)obj1->otype - (long)obj2->otype;
             break;
         case SORT_CLASS:
-            *result = (long)class1 - (long)class2;
+            *result = (long)obj1->class - (long)obj2->class;
             break;
         case SORT_KEYSIZE:
-            *result = (long)keysize1 - (long)keysize2;
+            *result = (long)obj1->keysize - (long)obj2->keysize;
             break;
         case SORT_CN:
-            if (cn1 == NULL || cn2 == NULL)
+            if (obj1->common_name == NULL || obj2->common_name == NULL)
                 break;
-            *result = strcmp(cn1, cn2);
+            *result = strcmp(obj1->common_name, obj2->common_name);
             break;
         case SORT_NONE:
         default:
@@ -6308,17 +6462,7 @@ static CK_RV p11sak_list_obj_compare(CK_OBJECT_HANDLE obj1,
             break;
     }
 
-done:
-    if (label1 != NULL)
-        free(label1);
-    if (label2 != NULL)
-        free(label2);
-    if (cn1 != NULL)
-        free(cn1);
-    if (cn2 != NULL)
-        free(cn2);
-
-    return rc;
+    return CKR_OK;
 }
 
 static CK_RV parse_sort_specification(const char *sort_spec,
@@ -7506,7 +7650,8 @@ static CK_RV p11sak_extract_x509_pk(const struct p11sak_objtype *certtype,
         goto done;
     }
 
-    rc = keytype->import_asym_pkey(keytype, pkey, CK_FALSE, attrs, num_attrs);
+    rc = keytype->import_asym_pkey(keytype, opt_file, pkey, CK_FALSE, attrs,
+                                   num_attrs);
     if (rc != CKR_OK) {
         warnx("Failed to import %s public key from %s certificate "
               "object \"%s\": 0x%lX: %s", keytype->name, certtype->name, label,
@@ -7568,7 +7713,8 @@ done:
 }
 
 static CK_RV p11sak_import_rsa_pkey(const struct p11sak_objtype *keytype,
-                                    EVP_PKEY *pkey, bool private,
+                                    const char *file, EVP_PKEY *pkey,
+                                    bool private,
                                     CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs)
 {
     CK_RV rc = CKR_OK;
@@ -7585,7 +7731,7 @@ static CK_RV p11sak_import_rsa_pkey(const struct p11sak_objtype *keytype,
 
     if (EVP_PKEY_base_id(pkey) != EVP_PKEY_RSA &&
         EVP_PKEY_base_id(pkey) != EVP_PKEY_RSA_PSS) {
-        warnx("PEM file '%s' does not contain an %s %s key.", opt_file,
+        warnx("PEM file '%s' does not contain an %s %s key.", file,
               keytype->name, private ? "private" : "public");
         return CKR_FUNCTION_FAILED;
     }
@@ -7704,7 +7850,8 @@ done:
 }
 
 static CK_RV p11sak_import_dh_pkey(const struct p11sak_objtype *keytype,
-                                   EVP_PKEY *pkey, bool private,
+                                   const char *file, EVP_PKEY *pkey,
+                                   bool private,
                                    CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs)
 {
     CK_RV rc = CKR_OK;
@@ -7716,7 +7863,7 @@ static CK_RV p11sak_import_dh_pkey(const struct p11sak_objtype *keytype,
 #endif
 
     if (EVP_PKEY_base_id(pkey) != EVP_PKEY_DH) {
-        warnx("PEM file '%s' does not contain an %s %s key.", opt_file,
+        warnx("PEM file '%s' does not contain an %s %s key.", file,
               keytype->name, private ? "private" : "public");
         return CKR_FUNCTION_FAILED;
     }
@@ -7790,7 +7937,8 @@ done:
 }
 
 static CK_RV p11sak_import_dsa_pkey(const struct p11sak_objtype *keytype,
-                                    EVP_PKEY *pkey, bool private,
+                                    const char *file, EVP_PKEY *pkey,
+                                    bool private,
                                     CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs)
 {
     CK_RV rc = CKR_OK;
@@ -7804,7 +7952,7 @@ static CK_RV p11sak_import_dsa_pkey(const struct p11sak_objtype *keytype,
 #endif
 
     if (EVP_PKEY_base_id(pkey) != EVP_PKEY_DSA) {
-        warnx("PEM file '%s' does not contain an %s %s key.", opt_file,
+        warnx("PEM file '%s' does not contain an %s %s key.", file,
               keytype->name, private ? "private" : "public");
         return CKR_FUNCTION_FAILED;
     }
@@ -7973,7 +8121,8 @@ done:
 #endif
 
 static CK_RV p11sak_import_ec_pkey(const struct p11sak_objtype *keytype,
-                                   EVP_PKEY *pkey, bool private,
+                                   const char *file, EVP_PKEY *pkey,
+                                   bool private,
                                    CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs)
 {
     CK_RV rc = CKR_OK;
@@ -8013,7 +8162,7 @@ static CK_RV p11sak_import_ec_pkey(const struct p11sak_objtype *keytype,
                                       attrs, num_attrs);
 #endif
     default:
-        warnx("PEM file '%s' does not contain an %s %s key.", opt_file,
+        warnx("PEM file '%s' does not contain an %s %s key.", file,
               keytype->name, private ? "private" : "public");
         return CKR_FUNCTION_FAILED;
     }
@@ -8213,7 +8362,8 @@ static CK_RV get_octet_string_param_from_pkey(EVP_PKEY *pkey, const char *param,
 #endif
 
 static CK_RV p11sak_import_dilithium_pkey(const struct p11sak_objtype *keytype,
-                                          EVP_PKEY *pkey, bool private,
+                                          const char *file, EVP_PKEY *pkey,
+                                          bool private,
                                           CK_ATTRIBUTE **attrs,
                                           CK_ULONG *num_attrs)
 {
@@ -8225,6 +8375,7 @@ static CK_RV p11sak_import_dilithium_pkey(const struct p11sak_objtype *keytype,
     CK_RV rc;
 
     UNUSED(keytype);
+    UNUSED(file);
 
     oid = pqc_oid_from_pkey(pkey, dilithium_oids);
     if (oid == NULL)
@@ -8334,6 +8485,7 @@ out:
     return rc;
 #else
     UNUSED(keytype);
+    UNUSED(file);
     UNUSED(pkey);
     UNUSED(private);
     UNUSED(attrs);
@@ -8345,27 +8497,32 @@ out:
 #endif
 }
 
+static pthread_mutex_t pem_password_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static int p11sak_pem_password_cb(char *buf, int size, int rwflag,
                                   void *userdata)
 {
     const char *pem_password = opt_pem_password;
+    const char *file = userdata;
     char *buf_pem_password = NULL;
     char *msg = NULL;
     int len;
 
     UNUSED(rwflag);
-    UNUSED(userdata);
 
     if (pem_password == NULL)
         pem_password = getenv(PKCS11_PEM_PASSWORD_ENV_NAME);
 
     if (opt_force_pem_pwd_prompt || pem_password == NULL) {
         if (asprintf(&msg, "Please enter PEM password for '%s': ",
-                     opt_file) <= 0) {
+                     file) <= 0) {
             warnx("Failed to allocate memory for message");
             return -1;
         }
+        /* Worker threads of the import-bulk command may prompt concurrently */
+        pthread_mutex_lock(&pem_password_mutex);
         pem_password = pin_prompt(&buf_pem_password, msg);
+        pthread_mutex_unlock(&pem_password_mutex);
         free(msg);
         if (pem_password == NULL) {
             warnx("Failed to prompt for PEM password");
@@ -8386,21 +8543,21 @@ static int p11sak_pem_password_cb(char *buf, int size, int rwflag,
     return len;
 }
 
-static CK_RV p11sak_x509_from_pem_file(X509 **x509)
+static CK_RV p11sak_x509_from_pem_file(const char *file, X509 **x509)
 {
     BIO *bio = NULL;
     X509 *x = NULL;
     CK_RV rc;
 
-    bio = BIO_new_file(opt_file, "r");
+    bio = BIO_new_file(file, "r");
     if (bio == NULL) {
-        warnx("Failed to open file '%s'", opt_file);
+        warnx("Failed to open file '%s'", file);
         ERR_print_errors_cb(openssl_err_cb, NULL);
         rc = CKR_ARGUMENTS_BAD;
         goto done;
     }
 
-    x = PEM_read_bio_X509(bio, NULL, p11sak_pem_password_cb, NULL);
+    x = PEM_read_bio_X509(bio, NULL, p11sak_pem_password_cb, (void *)file);
     if (x == NULL) {
         rc = CKR_FUNCTION_FAILED;
         goto done;
@@ -8416,7 +8573,7 @@ done:
     return rc;
 }
 
-static CK_RV p11sak_x509_from_der_file(X509 **x509)
+static CK_RV p11sak_x509_from_der_file(const char *file, X509 **x509)
 {
     CK_BYTE *value;
     CK_ULONG value_len;
@@ -8426,8 +8583,8 @@ static CK_RV p11sak_x509_from_der_file(X509 **x509)
     FILE *fp = NULL;
     CK_RV rc;
 
-    if (stat(opt_file, &sb) != 0) {
-        warnx("Failed to access file '%s': %s", opt_file, strerror(errno));
+    if (stat(file, &sb) != 0) {
+        warnx("Failed to access file '%s': %s", file, strerror(errno));
         return CKR_ARGUMENTS_BAD;
     }
 
@@ -8438,15 +8595,15 @@ static CK_RV p11sak_x509_from_der_file(X509 **x509)
         return CKR_HOST_MEMORY;
     }
 
-    fp = fopen(opt_file, "r");
+    fp = fopen(file, "r");
     if (fp == NULL) {
-        warnx("Failed to open file '%s': %s", opt_file, strerror(errno));
+        warnx("Failed to open file '%s': %s", file, strerror(errno));
         rc = CKR_ARGUMENTS_BAD;
         goto done;
     }
 
     if (fread(value, value_len, 1, fp) != 1) {
-        warnx("Failed to read from file '%s': %s", opt_file, strerror(errno));
+        warnx("Failed to read from file '%s': %s", file, strerror(errno));
         rc = CKR_FUNCTION_FAILED;
         goto done;
     }
@@ -8454,7 +8611,7 @@ static CK_RV p11sak_x509_from_der_file(X509 **x509)
     tmp_value = (CK_BYTE *)value;
     x = d2i_X509(NULL, &tmp_value, value_len);
     if (x == NULL) {
-        warnx("d2i_X509 failed to decode contents from file '%s'", opt_file);
+        warnx("d2i_X509 failed to decode contents from file '%s'", file);
         ERR_print_errors_cb(openssl_err_cb, NULL);
         rc = CKR_FUNCTION_FAILED;
         goto done;
@@ -8473,6 +8630,7 @@ done:
 }
 
 static CK_RV p11sak_import_opaque_key(const struct p11sak_objtype *keytype,
+                                      const struct p11sak_import_item *item,
                                       CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs)
 {
     CK_BYTE *value;
@@ -8483,8 +8641,8 @@ static CK_RV p11sak_import_opaque_key(const struct p11sak_objtype *keytype,
 
     UNUSED(keytype);
 
-    if (stat(opt_file, &sb) != 0) {
-        warnx("Failed to access file '%s': %s", opt_file, strerror(errno));
+    if (stat(item->file, &sb) != 0) {
+        warnx("Failed to access file '%s': %s", item->file, strerror(errno));
         return CKR_FUNCTION_FAILED;
     }
     value_len = sb.st_size;
@@ -8495,15 +8653,15 @@ static CK_RV p11sak_import_opaque_key(const struct p11sak_objtype *keytype,
         return CKR_FUNCTION_FAILED;
     }
 
-    fp = fopen(opt_file, "r");
+    fp = fopen(item->file, "r");
     if (fp == NULL) {
-        warnx("Failed to open file '%s': %s", opt_file, strerror(errno));
+        warnx("Failed to open file '%s': %s", item->file, strerror(errno));
         rc = CKR_FUNCTION_FAILED;
         goto done;
     }
 
     if (fread(value, value_len, 1, fp) != 1) {
-        warnx("Failed to read from file '%s': %s", opt_file, strerror(errno));
+        warnx("Failed to read from file '%s': %s", item->file, strerror(errno));
         rc = CKR_FUNCTION_FAILED;
         goto done;
     }
@@ -8524,6 +8682,7 @@ done:
 }
 
 static CK_RV p11sak_import_asym_key(const struct p11sak_objtype *keytype,
+                                    const struct p11sak_import_item *item,
                                     CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs)
 {
     EVP_PKEY *pkey = NULL;
@@ -8534,57 +8693,58 @@ static CK_RV p11sak_import_asym_key(const struct p11sak_objtype *keytype,
     BIO *bio;
     int ret;
 
-    bio = BIO_new_file(opt_file, "r");
+    bio = BIO_new_file(item->file, "r");
     if (bio == NULL) {
-        warnx("Failed to open PEM file '%s'.", opt_file);
+        warnx("Failed to open PEM file '%s'.", item->file);
         ERR_print_errors_cb(openssl_err_cb, NULL);
         return CKR_FUNCTION_FAILED;
     }
 
     if (keytype->import_asym_pkey != NULL &&
         (!keytype->supports_oqsprovider_pem ||
-         (opt_oqsprovider_pem && keytype->supports_oqsprovider_pem))) {
-        if (opt_asym_kind->private.num)
+         (item->oqsprovider_pem && keytype->supports_oqsprovider_pem))) {
+        if (item->pkey != NULL && EVP_PKEY_up_ref(item->pkey) == 1)
+            pkey = item->pkey;
+        else if (item->private)
             pkey = PEM_read_bio_PrivateKey(bio, NULL, p11sak_pem_password_cb,
-                                           NULL);
+                                           item->file);
         else
-            pkey = PEM_read_bio_PUBKEY(bio, NULL, p11sak_pem_password_cb, NULL);
+            pkey = PEM_read_bio_PUBKEY(bio, NULL, p11sak_pem_password_cb,
+                                       item->file);
 
         if (pkey == NULL) {
-            warnx("Failed to read PEM file '%s'.%s", opt_file,
-                  opt_oqsprovider_pem ?
+            warnx("Failed to read PEM file '%s'.%s", item->file,
+                  item->oqsprovider_pem ?
                           " Is the 'oqsprovider' configured?" : "");
             ERR_print_errors_cb(openssl_err_cb, NULL);
             rc = CKR_FUNCTION_FAILED;
             goto done;
         }
 
-        rc = keytype->import_asym_pkey(keytype, pkey,
-                                       opt_asym_kind->private.num,
-                                       attrs, num_attrs);
+        rc = keytype->import_asym_pkey(keytype, item->file, pkey,
+                                       item->private, attrs, num_attrs);
         if (rc != CKR_OK)
             goto done;
     } else if (keytype->import_asym_pem_data != NULL) {
         ret = PEM_bytes_read_bio(&data, &data_len, &header,
-                                 opt_asym_kind->private.num ?
+                                 item->private ?
                                      keytype->pem_name_private :
                                      keytype->pem_name_public,
-                                 bio, p11sak_pem_password_cb, NULL);
+                                 bio, p11sak_pem_password_cb, item->file);
         if (ret != 1) {
-            warnx("Failed to read PEM file '%s'.", opt_file);
+            warnx("Failed to read PEM file '%s'.", item->file);
             ERR_print_errors_cb(openssl_err_cb, NULL);
             rc = CKR_FUNCTION_FAILED;
             goto done;
         }
 
         rc = keytype->import_asym_pem_data(keytype, data, data_len,
-                                           opt_asym_kind->private.num,
-                                           attrs, num_attrs);
+                                           item->private, attrs, num_attrs);
         if (rc != CKR_OK)
             goto done;
     } else {
         warnx("No support for importing %s key from PEM file '%s'",
-              keytype->name, opt_file);
+              keytype->name, item->file);
         rc = CKR_ARGUMENTS_BAD;
         goto done;
     }
@@ -8602,6 +8762,7 @@ done:
 }
 
 static CK_RV p11sak_import_sym_key(const struct p11sak_objtype *keytype,
+                                   const struct p11sak_import_item *item,
                                    CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs)
 {
     CK_BYTE data[MAX_SYM_CLEAR_KEY_SIZE];
@@ -8612,12 +8773,12 @@ static CK_RV p11sak_import_sym_key(const struct p11sak_objtype *keytype,
 
     if (keytype->import_sym_clear == NULL) {
         warnx("No support for importing %s key from file '%s'",
-              keytype->name, opt_file);
+              keytype->name, item->file);
         return CKR_ARGUMENTS_BAD;
     }
 
-    if (stat(opt_file, &sb) != 0) {
-        warnx("Failed to access file '%s': %s", opt_file, strerror(errno));
+    if (stat(item->file, &sb) != 0) {
+        warnx("Failed to access file '%s': %s", item->file, strerror(errno));
         return CKR_FUNCTION_FAILED;
     }
     data_len = sb.st_size;
@@ -8633,14 +8794,14 @@ static CK_RV p11sak_import_sym_key(const struct p11sak_objtype *keytype,
         return CKR_ARGUMENTS_BAD;
     }
 
-    fp = fopen(opt_file, "r");
+    fp = fopen(item->file, "r");
     if (fp == NULL) {
-        warnx("Failed to open file '%s': %s", opt_file, strerror(errno));
+        warnx("Failed to open file '%s': %s", item->file, strerror(errno));
         return CKR_FUNCTION_FAILED;
     }
 
     if (fread(data, data_len, 1, fp) != 1) {
-        warnx("Failed to read from file '%s': %s", opt_file, strerror(errno));
+        warnx("Failed to read from file '%s': %s", item->file, strerror(errno));
         fclose(fp);
         return CKR_FUNCTION_FAILED;
     }
@@ -8655,28 +8816,24 @@ static CK_RV p11sak_import_sym_key(const struct p11sak_objtype *keytype,
     return rc;
 }
 
-static CK_RV p11sak_import_key(void)
+static CK_RV p11sak_import_key_item(CK_SESSION_HANDLE session,
+                                    const struct p11sak_import_item *item)
 {
-    const struct p11sak_objtype *keytype;
+    const struct p11sak_objtype *keytype = item->objtype;
     CK_ATTRIBUTE *attrs = NULL;
     CK_ULONG num_attrs = 0;
     CK_OBJECT_CLASS class;
     CK_OBJECT_HANDLE key;
     CK_RV rc;
 
-    if (opt_keytype == NULL || opt_keytype->private.ptr == NULL)
-        return CKR_ARGUMENTS_BAD;
-
-    keytype = opt_keytype->private.ptr;
-
-    if (opt_oqsprovider_pem && !keytype->supports_oqsprovider_pem) {
+    if (item->oqsprovider_pem && !keytype->supports_oqsprovider_pem) {
         warnx("Option '--oqsprovider-pem' is not supported for keytype '%s'.",
               keytype->name);
         return CKR_ARGUMENTS_BAD;
     }
 
     class = keytype->is_asymmetric ?
-            (opt_asym_kind->private.num ? CKO_PRIVATE_KEY : CKO_PUBLIC_KEY) :
+            (item->private ? CKO_PRIVATE_KEY : CKO_PUBLIC_KEY) :
             CKO_SECRET_KEY;
     rc = add_attribute(CKA_CLASS, &class, sizeof(class), &attrs, &num_attrs);
     if (rc != CKR_OK)
@@ -8688,30 +8845,30 @@ static CK_RV p11sak_import_key(void)
         goto done;
 
     rc = add_attributes(keytype, &attrs, &num_attrs,
-                        opt_label, opt_attr, opt_id,
+                        item->label, item->attr, item->id,
                         !keytype->is_asymmetric ||
-                        (keytype->is_asymmetric && opt_asym_kind->private.num),
+                        (keytype->is_asymmetric && item->private),
                         NULL, NULL,
                         keytype->is_asymmetric ?
-                                (opt_asym_kind->private.num ?
+                                (item->private ?
                                         private_attr_applicable :
                                         public_attr_applicable) :
                                 secret_attr_applicable);
     if (rc != CKR_OK)
         goto done;
 
-    if (opt_opaque)
-        rc = p11sak_import_opaque_key(keytype, &attrs, &num_attrs);
+    if (item->opaque)
+        rc = p11sak_import_opaque_key(keytype, item, &attrs, &num_attrs);
     else if (keytype->is_asymmetric)
-        rc = p11sak_import_asym_key(keytype, &attrs, &num_attrs);
+        rc = p11sak_import_asym_key(keytype, item, &attrs, &num_attrs);
     else
-        rc = p11sak_import_sym_key(keytype, &attrs, &num_attrs);
+        rc = p11sak_import_sym_key(keytype, item, &attrs, &num_attrs);
     if (rc != CKR_OK)
         goto done;
 
-    rc = pkcs11_funcs->C_CreateObject(pkcs11_session, attrs, num_attrs, &key);
+    rc = pkcs11_funcs->C_CreateObject(session, attrs, num_attrs, &key);
     if (rc != CKR_OK) {
-       if (is_rejected_by_policy(rc, pkcs11_session))
+       if (is_rejected_by_policy(rc, session))
            warnx("Key import of a %s key is rejected by policy", keytype->name);
        else
            warnx("Key import of a %s key failed: 0x%lX: %s", keytype->name,
@@ -8719,15 +8876,39 @@ static CK_RV p11sak_import_key(void)
        goto done;
     }
 
-    printf("Successfully imported a %s key with label \"%s\".\n",
-           keytype->name, opt_label);
-
 done:
     free_attributes(attrs, num_attrs);
 
     return rc;
 }
 
+static CK_RV p11sak_import_key(void)
+{
+    struct p11sak_import_item item = { 0 };
+    CK_RV rc;
+
+    if (opt_keytype == NULL || opt_keytype->private.ptr == NULL)
+        return CKR_ARGUMENTS_BAD;
+
+    item.objtype = opt_keytype->private.ptr;
+    item.private = item.objtype->is_asymmetric && opt_asym_kind->private.num;
+    item.opaque = opt_opaque;
+    item.oqsprovider_pem = opt_oqsprovider_pem;
+    item.file = opt_file;
+    item.label = opt_label;
+    item.attr = opt_attr;
+    item.id = opt_id;
+
+    rc = p11sak_import_key_item(pkcs11_session, &item);
+    if (rc != CKR_OK)
+        return rc;
+
+    printf("Successfully imported a %s key with label \"%s\".\n",
+           item.objtype->name, opt_label);
+
+    return CKR_OK;
+}
+
 static bool has_ibm_opaque_attr(CK_OBJECT_HANDLE key)
 {
     CK_RV rc;
@@ -10493,7 +10674,7 @@ static CK_RV p11sak_key_extract_pubkey(const struct p11sak_objtype *keytype,
             goto done;
         }
 
-        rc = keytype->import_asym_pkey(keytype, pkey, false,
+        rc = keytype->import_asym_pkey(keytype, opt_file, pkey, false,
                                        &attrs, &num_attrs);
     } else {
         warnx("No support for extracting %s public key", keytype->name);
@@ -11252,9 +11433,10 @@ static CK_RV p11sak_export_cert(void)
     return data.num_failed == 0 ? CKR_OK : CKR_FUNCTION_FAILED;
 }
 
-static CK_RV p11sak_import_cert(void)
+static CK_RV p11sak_import_cert_item(CK_SESSION_HANDLE session,
+                                     const struct p11sak_import_item *item)
 {
-    const struct p11sak_objtype *certtype;
+    const struct p11sak_objtype *certtype = item->objtype;
     CK_ATTRIBUTE *attrs = NULL;
     CK_ULONG num_attrs = 0;
     CK_OBJECT_CLASS class;
@@ -11263,19 +11445,14 @@ static CK_RV p11sak_import_cert(void)
     X509 *x509 = NULL;
     CK_CERTIFICATE_CATEGORY cert_category;
 
-    if (opt_certtype == NULL || opt_certtype->private.ptr == NULL)
-        return CKR_ARGUMENTS_BAD;
-
-    certtype = opt_certtype->private.ptr;
-
-    rc = p11sak_x509_from_pem_file(&x509);
+    rc = p11sak_x509_from_pem_file(item->file, &x509);
     switch (rc) {
     case CKR_OK:
         break;
     case CKR_ARGUMENTS_BAD:
         return rc;
     default:
-        rc = p11sak_x509_from_der_file(&x509);
+        rc = p11sak_x509_from_der_file(item->file, &x509);
         if (rc != CKR_OK)
             return rc;
         break;
@@ -11287,7 +11464,7 @@ static CK_RV p11sak_import_cert(void)
         goto done;
 
     rc = add_attributes(certtype, &attrs, &num_attrs,
-                        opt_label, opt_attr, opt_id,
+                        item->label, item->attr, item->id,
                         FALSE, NULL, NULL,
                         cert_attr_applicable);
     if (rc != CKR_OK)
@@ -11297,7 +11474,7 @@ static CK_RV p11sak_import_cert(void)
      * Set CA-cert attribute dependent on input option or BasicConstraints CA
      * flag of the certificate
      */
-    if (opt_cacert ||
+    if (item->cacert ||
         (X509_get_extension_flags(x509) & EXFLAG_CA) != 0) {
         cert_category = CK_CERTIFICATE_CATEGORY_AUTHORITY;
         rc = add_attribute(CKA_CERTIFICATE_CATEGORY, &cert_category,
@@ -11321,9 +11498,9 @@ static CK_RV p11sak_import_cert(void)
             goto done;
     }
 
-    rc = pkcs11_funcs->C_CreateObject(pkcs11_session, attrs, num_attrs, &cert);
+    rc = pkcs11_funcs->C_CreateObject(session, attrs, num_attrs, &cert);
     if (rc != CKR_OK) {
-       if (is_rejected_by_policy(rc, pkcs11_session))
+       if (is_rejected_by_policy(rc, session))
            warnx("Certificate import of a %s certificate is rejected by policy", certtype->name);
        else
            warnx("Certificate import of a %s certificate failed: 0x%lX: %s", certtype->name,
@@ -11331,9 +11508,6 @@ static CK_RV p11sak_import_cert(void)
        goto done;
     }
 
-    printf("Successfully imported a %s certificate with label \"%s\".\n",
-           certtype->name, opt_label);
-
 done:
     free_attributes(attrs, num_attrs);
     X509_free(x509);
@@ -11341,29 +11515,725 @@ done:
     return rc;
 }
 
-static CK_RV p11sak_extract_cert_pubkey(void)
+static CK_RV p11sak_import_cert(void)
 {
-    const struct p11sak_objtype *certtype = NULL;
-    struct p11sak_export_data data = { 0 };
+    struct p11sak_import_item item = { 0 };
     CK_RV rc;
 
-    if (opt_certtype != NULL)
-        certtype = opt_certtype->private.ptr;
+    if (opt_certtype == NULL || opt_certtype->private.ptr == NULL)
+        return CKR_ARGUMENTS_BAD;
 
-    data.export_all = opt_force;
+    item.objtype = opt_certtype->private.ptr;
+    item.is_cert = true;
+    item.cacert = opt_cacert;
+    item.file = opt_file;
+    item.label = opt_label;
+    item.attr = opt_attr;
+    item.id = opt_id;
 
-    rc = iterate_objects(certtype, opt_label, opt_id, opt_attr,
-                         OBJCLASS_CERTIFICATE, NULL,
-                         handle_cert_pubkey_extract, &data);
-    if (rc != CKR_OK) {
-        warnx("Failed to iterate over certificate objects for type %s: 0x%lX: %s",
-                certtype != NULL ? certtype->name : "All", rc, p11_get_ckr(rc));
+    rc = p11sak_import_cert_item(pkcs11_session, &item);
+    if (rc != CKR_OK)
         return rc;
-    }
 
-    printf("%lu public key object(s) extracted.\n", data.num_exported);
-    if (data.num_skipped > 0)
-        printf("%lu certificate object(s) skipped.\n", data.num_skipped);
+    printf("Successfully imported a %s certificate with label \"%s\".\n",
+           item.objtype->name, opt_label);
+
+    return CKR_OK;
+}
+
+static double import_bulk_elapsed(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) +
+           (now.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+static void import_bulk_free_item(struct p11sak_import_item *item)
+{
+    free(item->file);
+    free(item->label);
+    free(item->attr);
+    free(item->id);
+    EVP_PKEY_free(item->pkey);
+}
+
+static CK_RV import_bulk_add_item(struct p11sak_import_bulk_data *data,
+                                  const struct p11sak_import_item *item)
+{
+    struct p11sak_import_item *tmp;
+
+    if (data->num_items % 64 == 0) {
+        tmp = realloc(data->items,
+                      (data->num_items + 64) * sizeof(*data->items));
+        if (tmp == NULL) {
+            warnx("Failed to allocate memory for the import list");
+            return CKR_HOST_MEMORY;
+        }
+        data->items = tmp;
+    }
+
+    data->items[data->num_items++] = *item;
+
+    return CKR_OK;
+}
+
+static const struct p11sak_enum_value *import_bulk_find_type(const char *name,
+                                                             bool *is_cert)
+{
+    const struct p11sak_enum_value *val;
+
+    for (val = p11sak_import_key_keytypes; val->value != NULL; val++) {
+        if (strcasecmp(val->value, name) == 0) {
+            *is_cert = false;
+            return val;
+        }
+    }
+
+    for (val = p11sak_import_cert_certtypes; val->value != NULL; val++) {
+        if (strcasecmp(val->value, name) == 0) {
+            *is_cert = true;
+            return val;
+        }
+    }
+
+    return NULL;
+}
+
+static CK_RV import_bulk_scan_directory(struct p11sak_import_bulk_data *data,
+                                        const char *directory)
+{
+    struct p11sak_import_item item;
+    const struct p11sak_enum_value *val;
+    struct dirent **namelist = NULL;
+    const char *name, *ext;
+    struct stat sb;
+    bool is_cert;
+    int i, num;
+    CK_RV rc = CKR_OK;
+
+    num = scandir(directory, &namelist, NULL, alphasort);
+    if (num < 0) {
+        warnx("Failed to read directory '%s': %s", directory, strerror(errno));
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    for (i = 0; i < num; i++) {
+        name = namelist[i]->d_name;
+        if (rc != CKR_OK || name[0] == '.')
+            continue;
+
+        memset(&item, 0, sizeof(item));
+        if (asprintf(&item.file, "%s/%s", directory, name) < 0) {
+            warnx("Failed to allocate memory for the file name");
+            item.file = NULL;
+            rc = CKR_HOST_MEMORY;
+            continue;
+        }
+
+        ext = strrchr(name, '.');
+        if (stat(item.file, &sb) != 0 || !S_ISREG(sb.st_mode) ||
+            ext == NULL || ext == name) {
+            printf("Skipping '%s': not a key or certificate file.\n",
+                   item.file);
+            data->num_skipped++;
+            import_bulk_free_item(&item);
+            continue;
+        }
+        ext++;
+
+        if (strcasecmp(ext, "pem") == 0) {
+            /* Key type and kind, or certificate, detected at import time */
+        } else if (strcasecmp(ext, "crt") == 0 || strcasecmp(ext, "cer") == 0 ||
+                   strcasecmp(ext, "der") == 0) {
+            item.objtype = &p11sak_x509_certtype;
+            item.is_cert = true;
+        } else if ((val = import_bulk_find_type(ext, &is_cert)) != NULL &&
+                   !is_cert && val->args == NULL) {
+            item.objtype = val->private.ptr;
+        } else {
+            printf("Skipping '%s': unknown file extension '%s'.\n",
+                   item.file, ext);
+            data->num_skipped++;
+            import_bulk_free_item(&item);
+            continue;
+        }
+
+        item.label = strndup(name, ext - 1 - name);
+        if (item.label == NULL) {
+            warnx("Failed to allocate memory for the label");
+            import_bulk_free_item(&item);
+            rc = CKR_HOST_MEMORY;
+            continue;
+        }
+
+        rc = import_bulk_add_item(data, &item);
+        if (rc != CKR_OK)
+            import_bulk_free_item(&item);
+    }
+
+    for (i = 0; i < num; i++)
+        free(namelist[i]);
+    free(namelist);
+
+    return rc;
+}
+
+static CK_RV import_bulk_next_token(char **pos, char **token)
+{
+    char *p = *pos, *out;
+    bool quoted = false;
+
+    while (isspace((unsigned char)*p))
+        p++;
+
+    if (*p == '\0' || *p == '#') {
+        *pos = p;
+        *token = NULL;
+        return CKR_OK;
+    }
+
+    *token = out = p;
+    for (; *p != '\0'; p++) {
+        if (*p == '"') {
+            quoted = !quoted;
+            continue;
+        }
+        if (!quoted && isspace((unsigned char)*p)) {
+            p++;
+            break;
+        }
+        *out++ = *p;
+    }
+    *out = '\0';
+    *pos = p;
+
+    return quoted ? CKR_ARGUMENTS_BAD : CKR_OK;
+}
+
+static CK_RV import_bulk_parse_line(const char *manifest, unsigned long line_no,
+                                    const char *basedir, char *line,
+                                    struct p11sak_import_item *item,
+                                    bool *empty)
+{
+    const struct p11sak_enum_value *type = NULL, *val;
+    char *pos = line, *token, *value;
+    const char *kind = NULL, *file = NULL;
+    bool is_cert = false;
+    CK_RV rc;
+
+    memset(item, 0, sizeof(*item));
+    *empty = true;
+
+    while (1) {
+        rc = import_bulk_next_token(&pos, &token);
+        if (rc != CKR_OK) {
+            warnx("Manifest '%s' line %lu: unterminated quoted value",
+                  manifest, line_no);
+            goto error;
+        }
+        if (token == NULL)
+            break;
+        *empty = false;
+
+        value = strchr(token, '=');
+        if (value != NULL)
+            *value++ = '\0';
+
+        if (value == NULL && strcasecmp(token, "opaque") == 0) {
+            item->opaque = true;
+        } else if (value == NULL && strcasecmp(token, "oqsprovider-pem") == 0) {
+            item->oqsprovider_pem = true;
+        } else if (value == NULL && strcasecmp(token, "ca-cert") == 0) {
+            item->cacert = true;
+        } else if (value != NULL && strcasecmp(token, "type") == 0) {
+            type = import_bulk_find_type(value, &is_cert);
+            if (type == NULL) {
+                warnx("Manifest '%s' line %lu: unknown type '%s'",
+                      manifest, line_no, value);
+                rc = CKR_ARGUMENTS_BAD;
+                goto error;
+            }
+        } else if (value != NULL && strcasecmp(token, "kind") == 0) {
+            kind = value;
+        } else if (value != NULL && strcasecmp(token, "file") == 0) {
+            file = value;
+        } else if (value != NULL && strcasecmp(token, "label") == 0) {
+            free(item->label);
+            item->label = strdup(value);
+            if (item->label == NULL)
+                goto nomem;
+        } else if (value != NULL && strcasecmp(token, "attr") == 0) {
+            free(item->attr);
+            item->attr = strdup(value);
+            if (item->attr == NULL)
+                goto nomem;
+        } else if (value != NULL && strcasecmp(token, "id") == 0) {
+            free(item->id);
+            item->id = strdup(value);
+            if (item->id == NULL)
+                goto nomem;
+        } else {
+            warnx("Manifest '%s' line %lu: invalid keyword '%s'",
+                  manifest, line_no, token);
+            rc = CKR_ARGUMENTS_BAD;
+            goto error;
+        }
+    }
+
+    if (*empty)
+        return CKR_OK;
+
+    if (type == NULL || file == NULL || item->label == NULL) {
+        warnx("Manifest '%s' line %lu: keywords 'type', 'file', and 'label' "
+              "are required", manifest, line_no);
+        rc = CKR_ARGUMENTS_BAD;
+        goto error;
+    }
+
+    item->objtype = type->private.ptr;
+    item->is_cert = is_cert;
+
+    if (type->args != NULL) {
+        for (val = p11sak_import_asym_types; val->value != NULL; val++) {
+            if (kind != NULL && strcasecmp(val->value, kind) == 0)
+                break;
+        }
+        if (val->value == NULL) {
+            warnx("Manifest '%s' line %lu: keyword 'kind' must be 'public' or "
+                  "'private' for type '%s'", manifest, line_no, type->value);
+            rc = CKR_ARGUMENTS_BAD;
+            goto error;
+        }
+        item->private = val->private.num;
+    } else if (kind != NULL) {
+        warnx("Manifest '%s' line %lu: keyword 'kind' is not valid for type "
+              "'%s'", manifest, line_no, type->value);
+        rc = CKR_ARGUMENTS_BAD;
+        goto error;
+    }
+
+    if ((is_cert && (item->opaque || item->oqsprovider_pem)) ||
+        (!is_cert && item->cacert)) {
+        warnx("Manifest '%s' line %lu: keywords 'opaque' and 'oqsprovider-pem' "
+              "are only valid for keys, 'ca-cert' only for certificates",
+              manifest, line_no);
+        rc = CKR_ARGUMENTS_BAD;
+        goto error;
+    }
+
+    if (file[0] != '/' && basedir != NULL) {
+        if (asprintf(&item->file, "%s/%s", basedir, file) < 0) {
+            item->file = NULL;
+            goto nomem;
+        }
+    } else {
+        item->file = strdup(file);
+        if (item->file == NULL)
+            goto nomem;
+    }
+
+    return CKR_OK;
+
+nomem:
+    warnx("Failed to allocate memory for the import list");
+    rc = CKR_HOST_MEMORY;
+error:
+    import_bulk_free_item(item);
+    memset(item, 0, sizeof(*item));
+
+    return rc;
+}
+
+static CK_RV import_bulk_read_manifest(struct p11sak_import_bulk_data *data,
+                                       const char *manifest)
+{
+    struct p11sak_import_item item;
+    char *line = NULL, *basedir = NULL, *slash;
+    unsigned long line_no = 0;
+    size_t line_size = 0;
+    bool empty;
+    FILE *fp;
+    CK_RV rc = CKR_OK;
+
+    fp = fopen(manifest, "r");
+    if (fp == NULL) {
+        warnx("Failed to open manifest file '%s': %s", manifest,
+              strerror(errno));
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    /* Relative file names in the manifest are relative to its directory */
+    slash = strrchr(manifest, '/');
+    if (slash != NULL) {
+        basedir = strndup(manifest, slash == manifest ? 1 : slash - manifest);
+        if (basedir == NULL) {
+            warnx("Failed to allocate memory for the manifest directory");
+            rc = CKR_HOST_MEMORY;
+            goto done;
+        }
+    }
+
+    while (getline(&line, &line_size, fp) != -1) {
+        line_no++;
+
+        rc = import_bulk_parse_line(manifest, line_no, basedir, line,
+                                    &item, &empty);
+        if (rc != CKR_OK)
+            goto done;
+        if (empty)
+            continue;
+
+        rc = import_bulk_add_item(data, &item);
+        if (rc != CKR_OK) {
+            import_bulk_free_item(&item);
+            goto done;
+        }
+    }
+
+    if (ferror(fp)) {
+        warnx("Failed to read manifest file '%s': %s", manifest,
+              strerror(errno));
+        rc = CKR_FUNCTION_FAILED;
+    }
+
+done:
+    free(line);
+    free(basedir);
+    fclose(fp);
+
+    return rc;
+}
+
+/*
+ * Derive the key type and kind, or certificate, from the first PEM block of a
+ * file imported via the '-d'/'--directory' option. Only the PEM type and the
+ * algorithm identifier are parsed here, the key itself is read when importing.
+ * An encrypted PKCS#8 private key must be decrypted to get its algorithm, it
+ * is kept in the item so that the PEM password is asked for only once.
+ */
+static CK_RV import_bulk_detect_pem(struct p11sak_import_item *item)
+{
+    const struct p11sak_enum_value *val;
+    const struct p11sak_objtype *keytype;
+    PKCS8_PRIV_KEY_INFO *p8inf = NULL;
+    const ASN1_OBJECT *p8_alg = NULL;
+    X509_PUBKEY *pubkey = NULL;
+    ASN1_OBJECT *pub_alg = NULL;
+    unsigned char *data = NULL;
+    const unsigned char *ptr;
+    char *name = NULL, *header = NULL;
+    int pkey_type = NID_undef;
+    long data_len = 0;
+    BIO *bio;
+    CK_RV rc = CKR_OK;
+
+    bio = BIO_new_file(item->file, "r");
+    if (bio == NULL) {
+        warnx("Failed to open PEM file '%s'.", item->file);
+        ERR_print_errors_cb(openssl_err_cb, NULL);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if (PEM_read_bio(bio, &name, &header, &data, &data_len) != 1) {
+        warnx("Failed to read PEM file '%s'.", item->file);
+        ERR_print_errors_cb(openssl_err_cb, NULL);
+        rc = CKR_FUNCTION_FAILED;
+        goto done;
+    }
+
+    if (strcmp(name, PEM_STRING_X509) == 0 ||
+        strcmp(name, PEM_STRING_X509_OLD) == 0) {
+        item->objtype = &p11sak_x509_certtype;
+        item->is_cert = true;
+        goto done;
+    }
+
+    for (val = p11sak_import_key_keytypes; val->value != NULL; val++) {
+        keytype = val->private.ptr;
+        if (keytype->pem_name_private != NULL &&
+            strcmp(name, keytype->pem_name_private) == 0) {
+            item->objtype = keytype;
+            item->private = true;
+            goto done;
+        }
+        if (keytype->pem_name_public != NULL &&
+            strcmp(name, keytype->pem_name_public) == 0) {
+            item->objtype = keytype;
+            goto done;
+        }
+    }
+
+    ptr = data;
+    if (strcmp(name, PEM_STRING_PUBLIC) == 0) {
+        pubkey = d2i_X509_PUBKEY(NULL, &ptr, data_len);
+        if (pubkey != NULL &&
+            X509_PUBKEY_get0_param(&pub_alg, NULL, NULL, NULL, pubkey) == 1)
+            pkey_type = OBJ_obj2nid(pub_alg);
+    } else if (strcmp(name, PEM_STRING_PKCS8INF) == 0) {
+        p8inf = d2i_PKCS8_PRIV_KEY_INFO(NULL, &ptr, data_len);
+        if (p8inf != NULL &&
+            PKCS8_pkey_get0(&p8_alg, NULL, NULL, NULL, p8inf) == 1)
+            pkey_type = OBJ_obj2nid(p8_alg);
+        item->private = true;
+    } else if (strcmp(name, PEM_STRING_PKCS8) == 0) {
+        if (BIO_reset(bio) < 0) {
+            warnx("Failed to read PEM file '%s'.", item->file);
+            rc = CKR_FUNCTION_FAILED;
+            goto done;
+        }
+        item->pkey = PEM_read_bio_PrivateKey(bio, NULL, p11sak_pem_password_cb,
+                                             item->file);
+        if (item->pkey == NULL) {
+            warnx("Failed to read PEM file '%s'.", item->file);
+            ERR_print_errors_cb(openssl_err_cb, NULL);
+            rc = CKR_FUNCTION_FAILED;
+            goto done;
+        }
+        pkey_type = EVP_PKEY_base_id(item->pkey);
+        item->private = true;
+    } else if (strcmp(name, PEM_STRING_RSA) == 0) {
+        pkey_type = EVP_PKEY_RSA;
+        item->private = true;
+    } else if (strcmp(name, PEM_STRING_DSA) == 0) {
+        pkey_type = EVP_PKEY_DSA;
+        item->private = true;
+    } else if (strcmp(name, PEM_STRING_ECPRIVATEKEY) == 0) {
+        pkey_type = EVP_PKEY_EC;
+        item->private = true;
+    }
+
+    switch (pkey_type) {
+    case EVP_PKEY_RSA_PSS:
+        pkey_type = EVP_PKEY_RSA;
+        break;
+#if OPENSSL_VERSION_PREREQ(3, 0)
+    case EVP_PKEY_X25519:
+    case EVP_PKEY_ED25519:
+    case EVP_PKEY_X448:
+    case EVP_PKEY_ED448:
+        pkey_type = EVP_PKEY_EC;
+        break;
+#endif
+    default:
+        break;
+    }
+
+    item->objtype = find_keytype_by_pkey(pkey_type);
+    if (item->objtype == NULL) {
+        warnx("Cannot detect the key type of PEM file '%s' (%s), use a "
+              "manifest file to import it.", item->file, name);
+        rc = CKR_ARGUMENTS_BAD;
+    }
+
+done:
+    BIO_free(bio);
+    X509_PUBKEY_free(pubkey);
+    PKCS8_PRIV_KEY_INFO_free(p8inf);
+    if (data != NULL)
+        OPENSSL_clear_free(data, data_len);
+    OPENSSL_free(header);
+    OPENSSL_free(name);
+
+    return rc;
+}
+
+static void import_bulk_report(struct p11sak_import_bulk_data *data,
+                               const struct p11sak_import_item *item,
+                               CK_RV rc, double elapsed)
+{
+    pthread_mutex_lock(&data->mutex);
+
+    data->num_done++;
+    if (rc == CKR_OK) {
+        data->num_imported++;
+        printf("[%lu/%lu] Imported %s %s%s \"%s\" from '%s' (%.3f ms).\n",
+               data->num_done, data->num_items, item->objtype->name,
+               item->objtype->is_asymmetric ?
+                       (item->private ? "private " : "public ") : "",
+               item->objtype->obj_typestr, item->label, item->file,
+               elapsed * 1000);
+    } else {
+        data->num_failed++;
+        printf("[%lu/%lu] Failed to import \"%s\" from '%s': 0x%lX: %s\n",
+               data->num_done, data->num_items, item->label, item->file,
+               rc, p11_get_ckr(rc));
+    }
+
+    pthread_mutex_unlock(&data->mutex);
+}
+
+static void *import_bulk_thread(void *arg)
+{
+    struct p11sak_import_bulk_data *data = arg;
+    struct p11sak_import_item *item;
+    CK_SESSION_HANDLE session;
+    struct timespec start;
+    unsigned long i;
+    CK_RV rc;
+
+    /* Each worker uses its own session, the login state is shared */
+    rc = pkcs11_funcs->C_OpenSession(opt_slot,
+                                     CKF_SERIAL_SESSION | CKF_RW_SESSION,
+                                     NULL, NULL, &session);
+    if (rc != CKR_OK) {
+        warnx("Opening a session failed: C_OpenSession: 0x%lX: %s", rc,
+              p11_get_ckr(rc));
+        return NULL;
+    }
+
+    while ((i = __sync_fetch_and_add(&data->next_item, 1)) < data->num_items) {
+        item = &data->items[i];
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        rc = CKR_OK;
+        if (item->objtype == NULL)
+            rc = import_bulk_detect_pem(item);
+        if (rc == CKR_OK)
+            rc = item->is_cert ? p11sak_import_cert_item(session, item) :
+                                 p11sak_import_key_item(session, item);
+
+        item->done = true;
+        import_bulk_report(data, item, rc, import_bulk_elapsed(&start));
+    }
+
+    rc = pkcs11_funcs->C_CloseSession(session);
+    if (rc != CKR_OK)
+        warnx("C_CloseSession failed: 0x%lX: %s", rc, p11_get_ckr(rc));
+
+    return NULL;
+}
+
+static CK_RV p11sak_import_bulk(void)
+{
+    struct p11sak_import_bulk_data data = { 0 };
+    unsigned long num_threads, num_started = 0, num_unprocessed = 0, i;
+    pthread_t *threads = NULL;
+    struct timespec start;
+    double elapsed;
+    long cpus;
+    int ret;
+    CK_RV rc;
+
+    if ((opt_directory == NULL) == (opt_manifest == NULL)) {
+        warnx("Exactly one of the options '-d'/'--directory' or "
+              "'-m'/'--manifest' must be specified.");
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    if (opt_threads > IMPORT_BULK_MAX_THREADS) {
+        warnx("The number of threads must not be larger than %d.",
+              IMPORT_BULK_MAX_THREADS);
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    num_threads = opt_threads;
+    if (num_threads == 0) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cpus > 0 ? (unsigned long)cpus : 1;
+        if (num_threads > IMPORT_BULK_MAX_THREADS)
+            num_threads = IMPORT_BULK_MAX_THREADS;
+    }
+
+    pthread_mutex_init(&data.mutex, NULL);
+
+    if (opt_directory != NULL)
+        rc = import_bulk_scan_directory(&data, opt_directory);
+    else
+        rc = import_bulk_read_manifest(&data, opt_manifest);
+    if (rc != CKR_OK)
+        goto done;
+
+    if (data.num_items == 0) {
+        printf("No keys or certificates found to import.\n");
+        goto done;
+    }
+
+    if (num_threads > data.num_items)
+        num_threads = data.num_items;
+
+    threads = calloc(num_threads, sizeof(*threads));
+    if (threads == NULL) {
+        warnx("Failed to allocate memory for the worker threads");
+        rc = CKR_HOST_MEMORY;
+        goto done;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < num_threads; i++) {
+        ret = pthread_create(&threads[i], NULL, import_bulk_thread, &data);
+        if (ret != 0) {
+            warnx("Failed to create a worker thread: %s", strerror(ret));
+            break;
+        }
+        num_started++;
+    }
+
+    if (num_started == 0)
+        import_bulk_thread(&data);
+
+    for (i = 0; i < num_started; i++)
+        pthread_join(threads[i], NULL);
+
+    elapsed = import_bulk_elapsed(&start);
+
+    for (i = 0; i < data.num_items; i++) {
+        if (!data.items[i].done)
+            num_unprocessed++;
+    }
+    if (num_unprocessed > 0) {
+        warnx("%lu object(s) were not processed, because no session could "
+              "be opened.", num_unprocessed);
+        data.num_failed += num_unprocessed;
+    }
+
+    printf("%lu object(s) imported.\n", data.num_imported);
+    if (data.num_skipped > 0)
+        printf("%lu file(s) skipped.\n", data.num_skipped);
+    if (data.num_failed > 0)
+        printf("%lu object(s) failed to import.\n", data.num_failed);
+    printf("Elapsed time: %.3f seconds using %lu thread(s), %.1f objects/s.\n",
+           elapsed, num_started > 0 ? num_started : 1,
+           elapsed > 0 ? data.num_imported / elapsed : 0.0);
+
+    rc = data.num_failed == 0 ? CKR_OK : CKR_FUNCTION_FAILED;
+
+done:
+    for (i = 0; i < data.num_items; i++)
+        import_bulk_free_item(&data.items[i]);
+    free(data.items);
+    free(threads);
+    pthread_mutex_destroy(&data.mutex);
+
+    return rc;
+}
+
+static CK_RV p11sak_extract_cert_pubkey(void)
+{
+    const struct p11sak_objtype *certtype = NULL;
+    struct p11sak_export_data data = { 0 };
+    CK_RV rc;
+
+    if (opt_certtype != NULL)
+        certtype = opt_certtype->private.ptr;
+
+    data.export_all = opt_force;
+
+    rc = iterate_objects(certtype, opt_label, opt_id, opt_attr,
+                         OBJCLASS_CERTIFICATE, NULL,
+                         handle_cert_pubkey_extract, &data);
+    if (rc != CKR_OK) {
+        warnx("Failed to iterate over certificate objects for type %s: 0x%lX: %s",
+                certtype != NULL ? certtype->name : "All", rc, p11_get_ckr(rc));
+        return rc;
+    }
+
+    printf("%lu public key object(s) extracted.\n", data.num_exported);
+    if (data.num_skipped > 0)
+        printf("%lu certificate object(s) skipped.\n", data.num_skipped);
     if (data.num_failed > 0)
         printf("%lu certificate object(s) failed to export the public key.\n", data.num_failed);
 
@@ -11405,6 +12275,10 @@ static CK_RV load_pkcs11_lib(void)
         return CKR_FUNCTION_FAILED;
     }
 
+    /* Optional, other PKCS#11 libraries do not provide it */
+    *(void **)(&pkcs11_get_attr_batch) = dlsym(pkcs11_lib,
+                                               "C_IBM_GetAttributeValueBatch");
+
     return CKR_OK;
 }
 
@@ -11472,6 +12346,7 @@ static void close_pkcs11_session(void)
 
 static CK_RV init_pkcs11(const struct p11sak_cmd *command)
 {
+    CK_C_INITIALIZE_ARGS init_args = { .flags = CKF_OS_LOCKING_OK };
     CK_RV rc;
     char *buf_user_pin = NULL;
     const char *pin = opt_pin;
@@ -11518,7 +12393,8 @@ static CK_RV init_pkcs11(const struct p11sak_cmd *command)
     if (rc != CKR_OK)
         goto done;
 
-    rc = pkcs11_funcs->C_Initialize(NULL);
+    /* The import-bulk command calls into the library from multiple threads */
+    rc = pkcs11_funcs->C_Initialize(&init_args);
     if (rc != CKR_OK) {
         warnx("C_Initialize failed: 0x%lX: %s", rc, p11_get_ckr(rc));
         goto done;
@@ -11556,6 +12432,7 @@ static void term_pkcs11(void)
 
     pkcs11_lib = NULL;
     pkcs11_funcs = NULL;
+    pkcs11_get_attr_batch = NULL;
 
     if (uri_pin != NULL) {
         OPENSSL_cleanse(uri_pin,  strlen(uri_pin));
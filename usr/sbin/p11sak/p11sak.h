@@ -170,7 +170,7 @@ struct p11sak_objtype {
                               CK_BYTE *data, CK_ULONG data_len,
                               CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs);
     CK_RV (*import_asym_pkey)(const struct p11sak_objtype *keytype,
-                              EVP_PKEY *pkey, bool private,
+                              const char *file, EVP_PKEY *pkey, bool private,
                               CK_ATTRIBUTE **attrs, CK_ULONG *num_attrs);
     CK_RV (*import_asym_pem_data)(const struct p11sak_objtype *keytype,
                                   unsigned char *data, size_t data_len,
@@ -212,9 +212,20 @@ struct p11sak_custom_attr_type {
                        int indent, bool sensitive);
 };
 
+struct p11sak_obj_info {
+    CK_OBJECT_HANDLE obj;
+    CK_OBJECT_CLASS class;
+    CK_ULONG otype;
+    CK_ULONG keysize;
+    char *label;
+    char *typestr;
+    const struct p11sak_objtype *objtype;
+    char *common_name;
+};
+
 struct p11sak_iterate_compare_data {
-    CK_RV (*compare_obj)(CK_OBJECT_HANDLE obj1,
-                         CK_OBJECT_HANDLE obj2,
+    CK_RV (*compare_obj)(const struct p11sak_obj_info *obj1,
+                         const struct p11sak_obj_info *obj2,
                          int *result,
                          void *private);
     void *private;
@@ -285,6 +296,34 @@ struct p11sak_export_data {
     bool last_was_binary;
 };
 
+struct p11sak_import_item {
+    const struct p11sak_objtype *objtype; /* NULL: detect from PEM file */
+    bool is_cert;
+    bool private;
+    bool opaque;
+    bool oqsprovider_pem;
+    bool cacert;
+    char *file;
+    char *label;
+    char *attr;
+    char *id;
+    EVP_PKEY *pkey; /* encrypted private key, decrypted during detection */
+    bool done;
+};
+
+struct p11sak_import_bulk_data {
+    struct p11sak_import_item *items;
+    unsigned long num_items;
+    unsigned long next_item;
+    unsigned long num_done;
+    unsigned long num_imported;
+    unsigned long num_failed;
+    unsigned long num_skipped;
+    pthread_mutex_t mutex;
+};
+
+#define IMPORT_BULK_MAX_THREADS     256
+
 struct curve_info {
     const CK_BYTE *oid;
     CK_ULONG oid_len;
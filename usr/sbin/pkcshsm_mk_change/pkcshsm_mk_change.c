@@ -90,7 +90,9 @@ static void usage(char *progname)
     printf(" reencipher               initiate a master key change operation for the\n"
            "                          specified APQNs and master key types and re-encipher\n"
            "                          all session and token key objects of the affected\n"
-           "                          tokens.\n");
+           "                          tokens. With option -i/--id, resume the\n"
+           "                          re-enciphering of an interrupted master key change\n"
+           "                          operation.\n");
     printf(" finalize                 finalize a master key change operation when the\n"
            "                          new master key has been activated on the APQNs.\n");
     printf(" cancel                   cancel a master key change operation.\n");
@@ -124,7 +126,7 @@ static void usage(char *progname)
            "                          8 bytes hex string.\n"
            "                          Only valid with the 'reencipher' command.\n");
     printf(" -i, --id OPERATION-ID    specifies the ID of the master key change operation\n"
-           "                          to finalize, cancel, or list.\n");
+           "                          to resume, finalize, cancel, or list.\n");
     printf(" -v, --verbose LEVEL      set verbose level (optional):\n");
     printf("                          none (default), error, warn, info, devel, debug\n");
     printf(" -h, --help               display help information.\n");
@@ -933,6 +935,79 @@ error:
     return rc;
 }
 
+static int perform_resume_reencipher(void)
+{
+    unsigned int i, k;
+    int rc;
+
+    TRACE_DEVEL("ID: '%s'\n", id);
+
+    rc = load_mk_change_op(id);
+    if (rc != 0) {
+        warnx("HSM master key change operation '%s' not found.", id);
+        return ENOENT;
+    }
+
+    if (op.state != HSM_MK_CH_STATE_REENCIPHERING) {
+        warnx("The HSM master key change operation '%s' is in a state where\n"
+              "it can not be resumed.", id);
+        return EINVAL;
+    }
+
+    /* The affected tokens are those recorded when initiating the operation */
+    for (k = 0; k < op.num_slots; k++) {
+        for (i = 0; i < num_tokens; i++) {
+            if (tokens[i].present && tokens[i].id == op.slots[k])
+                break;
+        }
+        if (i >= num_tokens) {
+            warnx("Slot %lu affected by this master key change is not present.",
+                  op.slots[k]);
+            return EINVAL;
+        }
+        tokens[i].affected = true;
+    }
+
+    printf("The following tokens are affected by this master key change:\n");
+    for (i = 0; i < num_tokens; i++) {
+        if (tokens[i].affected == true)
+            printf("  Slot %lu: Label: %.32s\n", tokens[i].id, tokens[i].info.label);
+    }
+
+    /* Prompt for pin, login and open R/W session for each affected token */
+    rc = login_tokens();
+    if (rc != 0)
+        return rc;
+
+    printf("Resuming re-enciphering, please wait...\n");
+
+    /*
+     * Let each affected token reencipher its keys. Keys that have already
+     * been re-enciphered before the interruption are skipped by the tokens.
+     */
+    rc =  reencipher_tokens();
+    if (rc != 0)
+        return rc;
+
+    printf("Completed.\n");
+
+    /* Update MK operation state */
+    op.state = HSM_MK_CH_STATE_REENCIPHERED;
+
+    rc = save_mk_change_op();
+    if (rc != 0)
+        return rc;
+
+    printf("\nMaster key change operation '%s' re-enciphered.\n\n", op.id);
+    printf("Once the new master keys have been set/activated:\n");
+    printf(" - If you specified EXPECTED_MKVPS in your token configuration file(s),\n"
+           "   you must now replace the old MKVPs with the new MKVPs.");
+    printf(" - Run 'pkcshsm_mk_change finalize --id %s' when the new master\n"
+           "   keys have been set/activated.\n", op.id);
+
+    return 0;
+}
+
 static int finalize_cancel_tokens(unsigned int event,
                                   enum hsm_mk_change_state state,
                                   const char *msg_cmd)
@@ -1161,6 +1236,7 @@ static CK_RV perform_list_cb(struct hsm_mk_change_op *op, void *private)
     int *first = private;
     struct hsm_mkvp *mkvps = NULL;
     unsigned int num_mkvps = 0;
+    struct hsm_mk_change_progress progress;
     CK_RV rc;
 
     if (*first)
@@ -1237,6 +1313,12 @@ static CK_RV perform_list_cb(struct hsm_mk_change_op *op, void *private)
         }
         printf("\n");
 
+        if (op->state == HSM_MK_CH_STATE_REENCIPHERING &&
+            hsm_mk_change_token_progress_load(op->id, op->slots[i],
+                                              &progress) == CKR_OK)
+            printf("            Re-enciphered: %lu of %lu token key objects\n",
+                   progress.done, progress.total);
+
         rc = hsm_mk_change_token_mkvps_load(op->id, op->slots[i],
                                             &mkvps, &num_mkvps);
         if (rc == CKR_OK && num_mkvps > 0) {
@@ -1649,8 +1731,9 @@ int main(int argc, char **argv)
             break;
 
         case 'i':
-            if (cmd != CMD_FINALIZE && cmd != CMD_CANCEL && cmd != CMD_LIST) {
-                warnx("option -i/--id is only valid for the 'finalize', 'cancel or 'list' command");
+            if (cmd != CMD_REENCIPHER && cmd != CMD_FINALIZE &&
+                cmd != CMD_CANCEL && cmd != CMD_LIST) {
+                warnx("option -i/--id is only valid for the 'reencipher', 'finalize', 'cancel or 'list' command");
                 exit(EXIT_FAILURE);
             }
             id = optarg;
@@ -1686,6 +1769,18 @@ int main(int argc, char **argv)
     case CMD_REENCIPHER:
         TRACE_DEVEL("Command: reencipher\n");
 
+        if (id != NULL) {
+            if (apqns != NULL || ep11_wkvp_set || cca_sym_mkvp_set ||
+                cca_asym_mkvp_set || cca_aes_mkvp_set || cca_apka_mkvp_set) {
+                warnx("option -i/--id can not be combined with options "
+                      "specifying APQNs or master key verification patterns");
+                exit(EXIT_FAILURE);
+            }
+
+            rc = perform_resume_reencipher();
+            break;
+        }
+
         if (apqns == NULL || num_apqns == 0) {
             warnx("option -a/--apqns is required for the 'reencipher' command");
             exit(EXIT_FAILURE);
@@ -58,6 +58,8 @@ static void usage(char *progname)
     printf(" -d, --delete       delete your own statistics.\n");
     printf(" -D, --delete-all   delete the statistics from all users. (root user only)\n");
     printf(" -j, --json         output the statistics in JSON format.\n");
+    printf(" -p, --apqns        show the per-APQN statistics of tokens using APQN load balancing.\n");
+    printf(" -k, --keygen-pools show the statistics of the key generation pools of the Soft token.\n");
     printf(" -h, --help         display help information.\n");
 
     return;
@@ -83,6 +85,25 @@ static void make_shm_name(char *shm_name, size_t max_shm_len, int user_id)
     }
 }
 
+static void make_slot_shm_name(char *shm_name, size_t max_shm_len,
+                               const char *fmt, int user_id,
+                               CK_SLOT_ID slot_id)
+{
+    int i;
+
+    snprintf(shm_name, max_shm_len - 1, fmt, CONFIG_PATH,
+             (unsigned int)user_id, slot_id);
+
+    for (i = 1; shm_name[i] != '\0'; i++) {
+        if (shm_name[i] == '/')
+            shm_name[i] = '.';
+    }
+    if (shm_name[0] != '/') {
+        memmove(&shm_name[1], &shm_name[0], strlen(shm_name) + 1);
+        shm_name[0] = '/';
+    }
+}
+
 static int open_shm(uid_t user_id, const char *user_name,
                     CK_ULONG num_slots, CK_BYTE **shm_data,
                     CK_ULONG *shm_size)
@@ -272,11 +293,49 @@ static int for_each_mech(mech_f mech_cb, void *cb_private,
     return rc;
 }
 
+static void delete_slot_shms(uid_t user_id, const char *fmt)
+{
+#if !defined(_AIX)
+    char shm_prefix[PATH_MAX], shm_name[PATH_MAX + 1];
+    struct dirent *direntp;
+    DIR *shmDir;
+    char *p;
+
+    /* Strip the slot number to get the prefix of all slots of the user */
+    make_slot_shm_name(shm_prefix, sizeof(shm_prefix), fmt, user_id, 0);
+    p = strrchr(shm_prefix, '_');
+    if (p == NULL)
+        return;
+    *(p + 1) = '\0';
+
+    shmDir = opendir("/dev/shm");
+    if (shmDir == NULL)
+        return;
+
+    while ((direntp = readdir(shmDir)) != NULL) {
+        if (strncmp(direntp->d_name, &shm_prefix[1],
+                    strlen(&shm_prefix[1])) != 0)
+            continue;
+
+        snprintf(shm_name, sizeof(shm_name), "/%s", direntp->d_name);
+        shm_unlink(shm_name);
+    }
+
+    closedir(shmDir);
+#else
+    UNUSED(user_id);
+    UNUSED(fmt);
+#endif
+}
+
 static int delete_shm(uid_t user_id, const char *user_name)
 {
     char shm_name[PATH_MAX];
     int rc;
 
+    delete_slot_shms(user_id, STAT_APQN_SHM_NAME_FMT);
+    delete_slot_shms(user_id, STAT_KEYPOOL_SHM_NAME_FMT);
+
     make_shm_name(shm_name, sizeof(shm_name), user_id);
     rc = shm_unlink(shm_name);
     if (rc != 0) {
@@ -608,6 +667,263 @@ static int display_all_cb(int user_id, const char *user_name, void *private)
     return display_stats(user_id, user_name, (struct display_data *)private);
 }
 
+static int display_slot_apqn_stats(int user_id, CK_SLOT_ID slot,
+                                   bool json, bool *first)
+{
+    char shm_name[PATH_MAX];
+    struct stat stat_buf;
+    stat_apqn_t *apqns;
+    int shm_fd, i, num = 0;
+
+    make_slot_shm_name(shm_name, sizeof(shm_name), STAT_APQN_SHM_NAME_FMT,
+                       user_id, slot);
+
+    shm_fd = shm_open(shm_name, O_RDONLY, 0);
+    if (shm_fd == -1) {
+        if (errno == ENOENT)
+            return 0; /* Slot does not collect per-APQN statistics */
+        warnx("Failed to open APQN statistics for slot %lu: shm_open('%s'): %s",
+              slot, shm_name, strerror(errno));
+        return 1;
+    }
+
+    if (fstat(shm_fd, &stat_buf)) {
+        warnx("Failed to open APQN statistics for slot %lu: stat('%s'): %s",
+              slot, shm_name, strerror(errno));
+        close(shm_fd);
+        return 1;
+    }
+
+    if (stat_buf.st_uid != (uid_t)user_id ||
+        (stat_buf.st_mode & ~S_IFMT) != (S_IRUSR | S_IWUSR) ||
+        (CK_ULONG)stat_buf.st_size != STAT_APQN_SHM_SIZE) {
+        warnx("Failed to open APQN statistics for slot %lu: SHM '%s' has wrong mode/owner/size",
+              slot, shm_name);
+        close(shm_fd);
+        return 1;
+    }
+
+    apqns = mmap(NULL, STAT_APQN_SHM_SIZE, PROT_READ, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+    if (apqns == MAP_FAILED) {
+        warnx("Failed to open APQN statistics for slot %lu: mmap('%s'): %s",
+              slot, shm_name,  strerror(errno));
+        return 1;
+    }
+
+    if (json) {
+        if (*first == false)
+            printf(",");
+        printf("\n\t\t\t\t{\n\t\t\t\t\t\"slot\": %lu,\n", slot);
+        printf("\t\t\t\t\t\"apqns\": [");
+    } else {
+        printf("Slot: %lu\n\n", slot);
+        printf("---------+-----------------+-----------------+-----------+"
+               "-----------------+-----------------\n");
+        printf("APQN     | requests        | errors          | in flight |"
+               " avg lat. (us)   | recent lat. (us)\n");
+        printf("---------+-----------------+-----------------+-----------+"
+               "-----------------+-----------------\n");
+    }
+
+    for (i = 0; i < STAT_APQN_MAX; i++) {
+        if ((apqns[i].apqn & STAT_APQN_USED) == 0)
+            continue;
+
+        if (json) {
+            printf("%s\n\t\t\t\t\t\t{\n", num > 0 ? "," : "");
+            printf("\t\t\t\t\t\t\t\"adapter\": %u,\n",
+                   STAT_APQN_ADAPTER(apqns[i].apqn));
+            printf("\t\t\t\t\t\t\t\"domain\": %u,\n",
+                   STAT_APQN_DOMAIN(apqns[i].apqn));
+            printf("\t\t\t\t\t\t\t\"requests\": %lu,\n", apqns[i].requests);
+            printf("\t\t\t\t\t\t\t\"errors\": %lu,\n", apqns[i].errors);
+            printf("\t\t\t\t\t\t\t\"in-flight\": %lu,\n", apqns[i].inflight);
+            printf("\t\t\t\t\t\t\t\"latency-total-us\": %lu,\n",
+                   apqns[i].latency_total_us);
+            printf("\t\t\t\t\t\t\t\"latency-recent-us\": %lu\n",
+                   apqns[i].latency_recent_us);
+            printf("\t\t\t\t\t\t}");
+        } else {
+            printf("%02x.%04x  | %15lu | %15lu | %9lu | %15lu | %15lu\n",
+                   STAT_APQN_ADAPTER(apqns[i].apqn),
+                   STAT_APQN_DOMAIN(apqns[i].apqn),
+                   apqns[i].requests, apqns[i].errors, apqns[i].inflight,
+                   apqns[i].requests > 0 ?
+                        apqns[i].latency_total_us / apqns[i].requests : 0,
+                   apqns[i].latency_recent_us);
+        }
+        num++;
+    }
+
+    if (json) {
+        printf("\n\t\t\t\t\t]\n\t\t\t\t}");
+    } else {
+        if (num == 0)
+            printf("[no APQNs were used]\n");
+        printf("---------+-----------------+-----------------+-----------+"
+               "-----------------+-----------------\n\n");
+    }
+
+    *first = false;
+
+    munmap(apqns, STAT_APQN_SHM_SIZE);
+    return 0;
+}
+
+static int display_slot_keypool_stats(int user_id, CK_SLOT_ID slot,
+                                      bool json, bool *first)
+{
+    char shm_name[PATH_MAX];
+    struct stat stat_buf;
+    stat_keypool_t *pools;
+    int shm_fd, i, num = 0;
+
+    make_slot_shm_name(shm_name, sizeof(shm_name), STAT_KEYPOOL_SHM_NAME_FMT,
+                       user_id, slot);
+
+    shm_fd = shm_open(shm_name, O_RDONLY, 0);
+    if (shm_fd == -1) {
+        if (errno == ENOENT)
+            return 0; /* Slot does not use key generation pools */
+        warnx("Failed to open key pool statistics for slot %lu: shm_open('%s'): %s",
+              slot, shm_name, strerror(errno));
+        return 1;
+    }
+
+    if (fstat(shm_fd, &stat_buf)) {
+        warnx("Failed to open key pool statistics for slot %lu: stat('%s'): %s",
+              slot, shm_name, strerror(errno));
+        close(shm_fd);
+        return 1;
+    }
+
+    if (stat_buf.st_uid != (uid_t)user_id ||
+        (stat_buf.st_mode & ~S_IFMT) != (S_IRUSR | S_IWUSR) ||
+        (CK_ULONG)stat_buf.st_size != STAT_KEYPOOL_SHM_SIZE) {
+        warnx("Failed to open key pool statistics for slot %lu: SHM '%s' has wrong mode/owner/size",
+              slot, shm_name);
+        close(shm_fd);
+        return 1;
+    }
+
+    pools = mmap(NULL, STAT_KEYPOOL_SHM_SIZE, PROT_READ, MAP_SHARED,
+                 shm_fd, 0);
+    close(shm_fd);
+    if (pools == MAP_FAILED) {
+        warnx("Failed to open key pool statistics for slot %lu: mmap('%s'): %s",
+              slot, shm_name,  strerror(errno));
+        return 1;
+    }
+
+    if (json) {
+        if (*first == false)
+            printf(",");
+        printf("\n\t\t\t\t{\n\t\t\t\t\t\"slot\": %lu,\n", slot);
+        printf("\t\t\t\t\t\"keygen-pools\": [");
+    } else {
+        printf("Slot: %lu\n\n", slot);
+        printf("--------------------------------+-----------------+"
+               "-----------------+-----------------\n");
+        printf("key pool                        | generated       |"
+               " hits            | misses\n");
+        printf("--------------------------------+-----------------+"
+               "-----------------+-----------------\n");
+    }
+
+    for (i = 0; i < STAT_KEYPOOL_MAX; i++) {
+        if (pools[i].id == 0 || pools[i].name[0] == '\0')
+            continue;
+
+        if (json) {
+            printf("%s\n\t\t\t\t\t\t{\n", num > 0 ? "," : "");
+            printf("\t\t\t\t\t\t\t\"pool\": \"%.*s\",\n",
+                   STAT_KEYPOOL_NAME_LEN, pools[i].name);
+            printf("\t\t\t\t\t\t\t\"generated\": %lu,\n",
+                   pools[i].generated);
+            printf("\t\t\t\t\t\t\t\"hits\": %lu,\n", pools[i].hits);
+            printf("\t\t\t\t\t\t\t\"misses\": %lu\n", pools[i].misses);
+            printf("\t\t\t\t\t\t}");
+        } else {
+            printf("%-31.*s | %15lu | %15lu | %15lu\n",
+                   STAT_KEYPOOL_NAME_LEN, pools[i].name, pools[i].generated,
+                   pools[i].hits, pools[i].misses);
+        }
+        num++;
+    }
+
+    if (json) {
+        printf("\n\t\t\t\t\t]\n\t\t\t\t}");
+    } else {
+        if (num == 0)
+            printf("[no key pools were used]\n");
+        printf("--------------------------------+-----------------+"
+               "-----------------+-----------------\n\n");
+    }
+
+    *first = false;
+
+    munmap(pools, STAT_KEYPOOL_SHM_SIZE);
+    return 0;
+}
+
+static int display_slot_shm_stats(int user_id, const char *user_name,
+                                  struct display_data* dd,
+                                  int (*slot_func)(int user_id,
+                                                   CK_SLOT_ID slot,
+                                                   bool json, bool *first))
+{
+    CK_ULONG i;
+    bool slot_found = false;
+    int rc = 0;
+
+    if (dd->json) {
+        if (!dd->first_user)
+            printf(",\n");
+        printf("\t\t{\n\t\t\t\"user\": \"%s\",\n\t\t\t\"slots\": [", user_name);
+    } else {
+        printf("User: %s\n\n", user_name);
+    }
+
+    dd->first_slot = true;
+    for (i = 0; i < dd->num_slots; i++) {
+        if (dd->slot_id_specified && dd->slots[i] != dd->slot_id)
+            continue;
+
+        slot_found = true;
+        rc = slot_func(user_id, dd->slots[i], dd->json, &dd->first_slot);
+        if (rc != 0)
+            break;
+    }
+
+    if (dd->json)
+        printf("\n\t\t\t]\n\t\t}");
+    dd->first_user = false;
+
+    if (dd->slot_id_specified && !slot_found) {
+        warnx("Slot %lu is not available", dd->slot_id);
+        return 1;
+    }
+
+    return rc;
+}
+
+static int display_apqn_all_cb(int user_id, const char *user_name,
+                               void *private)
+{
+    return display_slot_shm_stats(user_id, user_name,
+                                  (struct display_data *)private,
+                                  display_slot_apqn_stats);
+}
+
+static int display_keypool_all_cb(int user_id, const char *user_name,
+                                  void *private)
+{
+    return display_slot_shm_stats(user_id, user_name,
+                                  (struct display_data *)private,
+                                  display_slot_keypool_stats);
+}
+
 struct summary_data {
     CK_ULONG num_slots;
     CK_SLOT_ID *slots;
@@ -797,6 +1113,7 @@ int main(int argc, char **argv)
     bool delete = false, delete_all = false;
     bool slot_id_specified = false;
     bool json = false, json_started = false;
+    bool apqns = false, keygen_pools = false;
     CK_SLOT_ID slot_id = 0;
     void *dll = NULL;
     CK_FUNCTION_LIST *func_list = NULL;
@@ -818,11 +1135,13 @@ int main(int argc, char **argv)
         {"delete", no_argument, NULL, 'd'},
         {"delete-all", no_argument, NULL, 'D'},
         {"json", no_argument, NULL, 'j'},
+        {"apqns", no_argument, NULL, 'p'},
+        {"keygen-pools", no_argument, NULL, 'k'},
         {"help", no_argument, NULL, 'h'},
         {0, 0, 0, 0}
     };
 
-    while ((opt = getopt_long(argc, argv, "U:SAas:rRdDjh", long_opts, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "U:SAas:rRdDjpkh", long_opts, NULL)) != -1) {
         switch (opt) {
         case 'U':
             if ((pswd = getpwnam(optarg)) == NULL) {
@@ -901,6 +1220,12 @@ int main(int argc, char **argv)
         case 'j':
             json = true;
             break;
+        case 'p':
+            apqns = true;
+            break;
+        case 'k':
+            keygen_pools = true;
+            break;
         case 'h':
             usage(basename(argv[0]));
             exit(EXIT_SUCCESS);
@@ -919,6 +1244,19 @@ int main(int argc, char **argv)
         exit(EXIT_FAILURE);
     }
 
+    if (apqns && (summary || reset || reset_all || delete || delete_all)) {
+        warnx("Option -p/--apqns can only be combined with -U/--user, "
+              "-A/--all, -s/--slot, and -j/--json");
+        exit(EXIT_FAILURE);
+    }
+
+    if (keygen_pools &&
+        (apqns || summary || reset || reset_all || delete || delete_all)) {
+        warnx("Option -k/--keygen-pools can only be combined with -U/--user, "
+              "-A/--all, -s/--slot, and -j/--json");
+        exit(EXIT_FAILURE);
+    }
+
     if (user_id == -1) {
         user_id = geteuid();
         pswd = getpwuid(user_id);
@@ -994,7 +1332,21 @@ int main(int argc, char **argv)
     dd.all_mechs = all_mechs;
     dd.json = json;
     dd.first_user = true;
-    if (all_users) {
+    if (apqns) {
+        if (all_users)
+            rc = for_all_users(display_apqn_all_cb, &dd);
+        else
+            rc = display_slot_shm_stats(user_id, user_name, &dd,
+                                        display_slot_apqn_stats);
+        goto done;
+    } else if (keygen_pools) {
+        if (all_users)
+            rc = for_all_users(display_keypool_all_cb, &dd);
+        else
+            rc = display_slot_shm_stats(user_id, user_name, &dd,
+                                        display_slot_keypool_stats);
+        goto done;
+    } else if (all_users) {
         rc = for_all_users(display_all_cb, &dd);
         goto done;
     } else if (summary) {